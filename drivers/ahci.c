@@ -0,0 +1,425 @@
+/**
+ * ClaudeOS AHCI Driver - ahci.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: AHCI SATA ports with Native Command Queuing
+ *
+ * Requests are issued straight from submit() into a free command slot;
+ * with NCQ up to the drive's queue depth run at once and the device
+ * reorders them itself. Commands that cannot be queued (cache flushes,
+ * or everything on a drive without NCQ) wait until the port is idle:
+ * submit() refuses them and the block layer retries after the next
+ * completion, which keeps them ordered after earlier writes.
+ */
+
+#include "types.h"
+#include "ahci.h"
+#include "ata.h"
+#include "block.h"
+#include "pci.h"
+#include "pmm.h"
+#include "paging.h"
+#include "idt.h"
+#include "vga.h"
+#include "../fs/devfs.h"
+
+#define AHCI_MAX_PORTS      8       /* Disks we drive */
+#define AHCI_TIMEOUT        1000000
+
+#define REG(base, off)      (*(volatile uint32_t*)((base) + (off)))
+
+typedef struct {
+    block_device_t blk;
+    volatile uint8_t* regs;         /* Port register block */
+    ahci_cmd_header_t* clist;
+    uint8_t* fis;                   /* Received FIS area */
+    ahci_cmd_table_t* tables;       /* One per slot */
+    uint32_t slots;                 /* Slots we use */
+    bool ncq;
+    bool lba48;
+    uint32_t issued;                /* Slots with a command outstanding */
+    bool exclusive;                 /* A non-queued command is outstanding */
+    request_t* reqs[AHCI_MAX_SLOTS];
+} ahci_port_t;
+
+static volatile uint8_t* hba = NULL;
+static ahci_port_t ports[AHCI_MAX_PORTS];
+static uint32_t port_count = 0;
+
+/*
+ * ===========================================================================
+ * Command Construction
+ * ===========================================================================
+ */
+
+static void fis_lba(fis_reg_h2d_t* fis, uint64_t lba) {
+    fis->lba0 = (uint8_t)lba;
+    fis->lba1 = (uint8_t)(lba >> 8);
+    fis->lba2 = (uint8_t)(lba >> 16);
+    fis->lba3 = (uint8_t)(lba >> 24);
+    fis->lba4 = (uint8_t)(lba >> 32);
+    fis->lba5 = (uint8_t)(lba >> 40);
+}
+
+/* Fill slot 'slot' for a request; false if its buffers cannot be described */
+static bool build_command(ahci_port_t* port, uint32_t slot, request_t* req) {
+    ahci_cmd_table_t* table = &port->tables[slot];
+    ahci_cmd_header_t* header = &port->clist[slot];
+    bool write = req->op == BIO_WRITE;
+
+    uint32_t n = 0;
+    bio_t* bio;
+    bio_seg_t* seg;
+    uint32_t i;
+    REQ_FOR_EACH_SEG(req, seg, bio, i) {
+        if ((seg->addr & 1) || seg->addr + seg->len > PAGING_IDENTITY_END) return false;
+        /* Physically contiguous segments share an entry */
+        if (n > 0 && table->prdt[n - 1].dba + (table->prdt[n - 1].dbc & 0x3FFFFF) + 1 == seg->addr &&
+            (table->prdt[n - 1].dbc & 0x3FFFFF) + seg->len < 0x400000) {
+            table->prdt[n - 1].dbc += seg->len;
+            continue;
+        }
+        if (n == AHCI_MAX_PRDS) return false;
+        table->prdt[n].dba = seg->addr;
+        table->prdt[n].dbau = 0;
+        table->prdt[n].reserved = 0;
+        table->prdt[n].dbc = seg->len - 1;
+        n++;
+    }
+
+    fis_reg_h2d_t* fis = (fis_reg_h2d_t*)table->cfis;
+    for (uint32_t b = 0; b < sizeof(fis_reg_h2d_t); b++) {
+        ((uint8_t*)fis)[b] = 0;
+    }
+    fis->type = FIS_TYPE_REG_H2D;
+    fis->flags = 0x80;
+    fis->device = 0x40;                             /* LBA mode */
+
+    if (req->op == BIO_FLUSH) {
+        fis->command = port->lba48 ? ATA_CMD_FLUSH_EXT : ATA_CMD_FLUSH;
+    } else if (port->ncq) {
+        /* Sector count goes in the features register, the tag in count */
+        fis->command = write ? ATA_CMD_WRITE_FPDMA : ATA_CMD_READ_FPDMA;
+        fis->feature_lo = (uint8_t)req->sectors;
+        fis->feature_hi = (uint8_t)(req->sectors >> 8);
+        fis->count_lo = (uint8_t)(slot << 3);
+        fis_lba(fis, req->sector);
+    } else {
+        fis->command = write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+        fis->count_lo = (uint8_t)req->sectors;
+        fis->count_hi = (uint8_t)(req->sectors >> 8);
+        fis_lba(fis, req->sector);
+    }
+
+    header->flags = (uint16_t)(sizeof(fis_reg_h2d_t) / 4) | (write ? AHCI_CMD_WRITE : 0);
+    header->prdtl = (uint16_t)n;
+    header->prdbc = 0;
+    return true;
+}
+
+/*
+ * ===========================================================================
+ * Issue and Completion
+ * ===========================================================================
+ */
+
+static int ahci_submit(block_device_t* dev, request_t* req) {
+    ahci_port_t* port = (ahci_port_t*)dev->priv;
+    bool queued = port->ncq && req->op != BIO_FLUSH;
+
+    uint32_t irq = irq_save();
+    if (port->exclusive || (!queued && port->issued)) {
+        irq_restore(irq);
+        return -1;
+    }
+
+    uint32_t slot = 0;
+    while (slot < port->slots && (port->issued & (1u << slot))) {
+        slot++;
+    }
+    if (slot == port->slots) {
+        irq_restore(irq);
+        return -1;
+    }
+
+    if (!build_command(port, slot, req)) {
+        irq_restore(irq);
+        block_complete(req, -1);
+        return 0;
+    }
+
+    port->issued |= 1u << slot;
+    port->exclusive = !queued;
+    port->reqs[slot] = req;
+    if (queued) {
+        REG(port->regs, AHCI_PxSACT) = 1u << slot;
+    }
+    REG(port->regs, AHCI_PxCI) = 1u << slot;
+    irq_restore(irq);
+    return 0;
+}
+
+static void port_stop(ahci_port_t* port) {
+    REG(port->regs, AHCI_PxCMD) &= ~AHCI_PxCMD_ST;
+    for (uint32_t i = 0; i < AHCI_TIMEOUT && (REG(port->regs, AHCI_PxCMD) & AHCI_PxCMD_CR); i++) {
+        __asm__ volatile ("pause");
+    }
+    REG(port->regs, AHCI_PxCMD) &= ~AHCI_PxCMD_FRE;
+    for (uint32_t i = 0; i < AHCI_TIMEOUT && (REG(port->regs, AHCI_PxCMD) & AHCI_PxCMD_FR); i++) {
+        __asm__ volatile ("pause");
+    }
+}
+
+static void port_start(ahci_port_t* port) {
+    REG(port->regs, AHCI_PxCMD) |= AHCI_PxCMD_FRE;
+    for (uint32_t i = 0; i < AHCI_TIMEOUT && (REG(port->regs, AHCI_PxTFD) & (ATA_SR_BSY | ATA_SR_DRQ)); i++) {
+        __asm__ volatile ("pause");
+    }
+    REG(port->regs, AHCI_PxCMD) |= AHCI_PxCMD_ST;
+}
+
+/*
+ * Handle a port interrupt. Interrupts off. Completed slots are those we
+ * issued that the device no longer lists in PxSACT (queued) or PxCI.
+ */
+static uint32_t port_service(ahci_port_t* port) {
+    uint32_t is = REG(port->regs, AHCI_PxIS);
+    REG(port->regs, AHCI_PxIS) = is;
+
+    uint32_t done;
+    int status = 0;
+    if (is & AHCI_PxIS_ERRORS) {
+        /*
+         * A failed queued command aborts every outstanding one; fail
+         * them all and restart the port rather than reading the NCQ
+         * error log to find the culprit.
+         */
+        done = port->issued;
+        status = -1;
+        port_stop(port);
+        REG(port->regs, AHCI_PxSERR) = 0xFFFFFFFF;
+        REG(port->regs, AHCI_PxIS) = 0xFFFFFFFF;
+        port_start(port);
+    } else {
+        uint32_t active = REG(port->regs, AHCI_PxSACT) | REG(port->regs, AHCI_PxCI);
+        done = port->issued & ~active;
+    }
+    if (!done) return 0;
+
+    request_t* finished[AHCI_MAX_SLOTS];
+    uint32_t count = 0;
+    for (uint32_t slot = 0; slot < port->slots; slot++) {
+        if (done & (1u << slot)) {
+            finished[count++] = port->reqs[slot];
+            port->reqs[slot] = NULL;
+        }
+    }
+    port->issued &= ~done;
+    if (!port->issued) port->exclusive = false;
+
+    /* Completing may submit more, so the bookkeeping is settled first */
+    for (uint32_t i = 0; i < count; i++) {
+        if (status) port->blk.stats.errors++;
+        block_complete(finished[i], status);
+    }
+    return count;
+}
+
+static void ahci_irq(void) {
+    uint32_t pending = REG(hba, AHCI_IS);
+    for (uint32_t p = 0; p < port_count; p++) {
+        ahci_port_t* port = &ports[p];
+        uint32_t bit = 1u << ((uint32_t)(port->regs - hba - AHCI_PORT_BASE) / AHCI_PORT_SIZE);
+        if (pending & bit) {
+            if (port_service(port) > 0) {
+                port->blk.stats.irqs++;
+            }
+        }
+    }
+    REG(hba, AHCI_IS) = pending;
+}
+
+static void ahci_poll(block_device_t* dev) {
+    uint32_t irq = irq_save();
+    port_service((ahci_port_t*)dev->priv);
+    irq_restore(irq);
+}
+
+static const block_ops_t ahci_ops = {
+    .submit = ahci_submit,
+    .poll   = ahci_poll,
+};
+
+/*
+ * ===========================================================================
+ * Port Setup
+ * ===========================================================================
+ */
+
+/* IDENTIFY DEVICE on slot 0, polled, before interrupts are enabled */
+static bool identify(ahci_port_t* port, uint16_t* id) {
+    ahci_cmd_table_t* table = &port->tables[0];
+    ahci_cmd_header_t* header = &port->clist[0];
+
+    fis_reg_h2d_t* fis = (fis_reg_h2d_t*)table->cfis;
+    for (uint32_t b = 0; b < sizeof(fis_reg_h2d_t); b++) {
+        ((uint8_t*)fis)[b] = 0;
+    }
+    fis->type = FIS_TYPE_REG_H2D;
+    fis->flags = 0x80;
+    fis->command = ATA_CMD_IDENTIFY;
+
+    table->prdt[0].dba = (uint32_t)id;
+    table->prdt[0].dbau = 0;
+    table->prdt[0].dbc = 512 - 1;
+    header->flags = sizeof(fis_reg_h2d_t) / 4;
+    header->prdtl = 1;
+    header->prdbc = 0;
+
+    REG(port->regs, AHCI_PxIS) = 0xFFFFFFFF;
+    REG(port->regs, AHCI_PxCI) = 1;
+    for (uint32_t i = 0; i < AHCI_TIMEOUT; i++) {
+        if (REG(port->regs, AHCI_PxIS) & AHCI_PxIS_TFES) break;
+        if (!(REG(port->regs, AHCI_PxCI) & 1)) {
+            REG(port->regs, AHCI_PxIS) = 0xFFFFFFFF;
+            return true;
+        }
+    }
+    REG(port->regs, AHCI_PxIS) = 0xFFFFFFFF;
+    return false;
+}
+
+static void print_dec(uint32_t n) {
+    char buf[12];
+    int i = 0;
+    do {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    } while (n > 0);
+    while (i > 0) vga_putchar(buf[--i]);
+}
+
+static void setup_port(uint32_t index, uint32_t cap) {
+    volatile uint8_t* regs = hba + AHCI_PORT_BASE + index * AHCI_PORT_SIZE;
+
+    /* A device present with the link up, and an ATA (not ATAPI) signature */
+    uint32_t ssts = REG(regs, AHCI_PxSSTS);
+    if ((ssts & 0x0F) != 3 || ((ssts >> 8) & 0x0F) != 1) return;
+    if (REG(regs, AHCI_PxSIG) != AHCI_SIG_ATA) return;
+    if (port_count == AHCI_MAX_PORTS) return;
+
+    ahci_port_t* port = &ports[port_count];
+    port->regs = regs;
+    port->slots = ((cap >> AHCI_CAP_NCS_SHIFT) & 0x1F) + 1;
+    port_stop(port);
+
+    /* Command list (1KB) and FIS area (256B) share a page; tables follow */
+    uint32_t table_pages = (port->slots * sizeof(ahci_cmd_table_t) + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t mem = pmm_alloc_pages(1 + table_pages);
+    if (!mem) return;
+    for (uint32_t i = 0; i < 1 + table_pages; i++) {
+        pmm_zero_page(mem + i * PAGE_SIZE);
+    }
+    port->clist = (ahci_cmd_header_t*)mem;
+    port->fis = (uint8_t*)(mem + 1024);
+    port->tables = (ahci_cmd_table_t*)(mem + PAGE_SIZE);
+    for (uint32_t s = 0; s < port->slots; s++) {
+        port->clist[s].ctba = (uint32_t)&port->tables[s];
+        port->clist[s].ctbau = 0;
+    }
+
+    REG(regs, AHCI_PxCLB) = (uint32_t)port->clist;
+    REG(regs, AHCI_PxCLBU) = 0;
+    REG(regs, AHCI_PxFB) = (uint32_t)port->fis;
+    REG(regs, AHCI_PxFBU) = 0;
+    REG(regs, AHCI_PxSERR) = 0xFFFFFFFF;
+    REG(regs, AHCI_PxIS) = 0xFFFFFFFF;
+    if (cap & AHCI_CAP_SSS) {
+        REG(regs, AHCI_PxCMD) |= AHCI_PxCMD_SUD | AHCI_PxCMD_POD;
+    }
+    port_start(port);
+
+    static uint16_t id[256];
+    if (!identify(port, id)) {
+        port_stop(port);
+        pmm_free_pages(mem, 1 + table_pages);
+        return;
+    }
+
+    port->lba48 = (id[83] & (1 << 10)) != 0;
+    uint64_t sectors = port->lba48
+        ? (uint64_t)id[100] | ((uint64_t)id[101] << 16) | ((uint64_t)id[102] << 32) |
+          ((uint64_t)id[103] << 48)
+        : (uint64_t)id[60] | ((uint64_t)id[61] << 16);
+    uint32_t depth = (id[75] & 0x1F) + 1;
+    port->ncq = (cap & AHCI_CAP_SNCQ) && (id[76] & (1 << 8)) && port->lba48;
+    if (port->ncq && depth < port->slots) port->slots = depth;
+    port->issued = 0;
+    port->exclusive = false;
+
+    block_device_t* blk = &port->blk;
+    blk->name[0] = 's';
+    blk->name[1] = 'd';
+    blk->name[2] = (char)('a' + port_count);
+    blk->sectors = sectors;
+    blk->max_sectors = port->lba48 ? 1024 : 256;
+    blk->max_segs = AHCI_MAX_PRDS;
+    blk->queue_depth = port->ncq ? port->slots : 1;
+    blk->major = DEV_MAJOR_SCSI;
+    blk->minor = port_count * 16;
+    blk->ops = &ahci_ops;
+    blk->priv = port;
+
+    REG(regs, AHCI_PxIE) = AHCI_PxIS_DHRS | AHCI_PxIS_PSS | AHCI_PxIS_DSS | AHCI_PxIS_SDBS |
+                           AHCI_PxIS_ERRORS;
+    port_count++;
+    block_register(blk);
+
+    vga_puts("[KERNEL] AHCI ");
+    vga_puts(blk->name);
+    vga_puts(": ");
+    print_dec((uint32_t)(sectors / 2048));
+    vga_puts(" MB, ");
+    if (port->ncq) {
+        vga_puts("NCQ depth ");
+        print_dec(port->slots);
+        vga_putchar('\n');
+    } else {
+        vga_puts("no NCQ\n");
+    }
+}
+
+void ahci_init(void) {
+    pci_device_t* pci = NULL;
+    while ((pci = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, pci)) != NULL) {
+        if (pci->prog_if == 0x01) break;
+    }
+    if (!pci || pci_bar_is_io(pci, 5)) return;
+
+    uint32_t abar = pci_bar_addr(pci, 5);
+    if (!abar || paging_map_mmio(abar, AHCI_PORT_BASE + 32 * AHCI_PORT_SIZE) != 0) return;
+    pci_enable(pci);
+    hba = (volatile uint8_t*)abar;
+
+    /* Reset the HBA into AHCI mode with interrupts off */
+    REG(hba, AHCI_GHC) |= AHCI_GHC_AE;
+    REG(hba, AHCI_GHC) |= AHCI_GHC_HR;
+    for (uint32_t i = 0; i < AHCI_TIMEOUT && (REG(hba, AHCI_GHC) & AHCI_GHC_HR); i++) {
+        __asm__ volatile ("pause");
+    }
+    REG(hba, AHCI_GHC) |= AHCI_GHC_AE;
+
+    uint32_t cap = REG(hba, AHCI_CAP);
+    uint32_t implemented = REG(hba, AHCI_PI);
+    for (uint32_t p = 0; p < 32; p++) {
+        if (implemented & (1u << p)) {
+            setup_port(p, cap);
+        }
+    }
+    if (port_count == 0) return;
+
+    if (pci->irq < 16) {
+        register_interrupt_handler(IRQ_BASE + pci->irq, ahci_irq);
+    }
+    REG(hba, AHCI_IS) = 0xFFFFFFFF;
+    REG(hba, AHCI_GHC) |= AHCI_GHC_IE;
+}
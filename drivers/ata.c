@@ -0,0 +1,559 @@
+/**
+ * ClaudeOS ATA/IDE Driver - ata.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: PIO and bus-master DMA transfers for parallel ATA disks
+ *
+ * A channel runs one command at a time for both of its drives, so each
+ * channel keeps its own list of requests accepted from the block layer.
+ * A DMA request is started and left to the interrupt handler; PIO
+ * requests (and cache flushes) run to completion with the device
+ * interrupt masked and are completed on the spot.
+ */
+
+#include "types.h"
+#include "ata.h"
+#include "block.h"
+#include "pci.h"
+#include "pmm.h"
+#include "paging.h"
+#include "idt.h"
+#include "timer.h"
+#include "vga.h"
+#include "../fs/devfs.h"
+
+/* I/O helpers */
+static inline void outb(uint16_t port, uint8_t value) {
+    __asm__ volatile ("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outl(uint16_t port, uint32_t value) {
+    __asm__ volatile ("outl %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline void insw(uint16_t port, void* buf, uint32_t count) {
+    __asm__ volatile ("cld; rep insw" : "+D"(buf), "+c"(count) : "d"(port) : "memory");
+}
+
+static inline void outsw(uint16_t port, const void* buf, uint32_t count) {
+    __asm__ volatile ("cld; rep outsw" : "+S"(buf), "+c"(count) : "d"(port));
+}
+
+#define ATA_TIMEOUT     1000000     /* Status polls before giving up */
+#define LBA28_LIMIT     0x0FFFFFFF
+
+typedef struct {
+    uint16_t base;
+    uint16_t ctrl;
+    uint16_t bmide;                 /* 0 if there is no bus master */
+    uint8_t irq;
+    ata_prd_t* prdt;
+    request_t* active;              /* Command in progress */
+    bool active_dma;
+    request_t* pending;             /* Accepted, waiting for the channel */
+    request_t* pending_tail;
+} ata_channel_t;
+
+typedef struct ata_drive {
+    block_device_t blk;
+    ata_channel_t* ch;
+    uint8_t slave;
+    bool lba48;
+    bool dma_capable;
+    bool dma;                       /* Currently allowed to use DMA */
+    char model[41];
+} ata_drive_t;
+
+static ata_channel_t channels[2];
+static ata_drive_t drives[4];
+static ata_stats_t stats;
+
+static const char* drive_names[4] = { "hda", "hdb", "hdc", "hdd" };
+
+/*
+ * ===========================================================================
+ * Register Access
+ * ===========================================================================
+ */
+
+/* ~400ns: four reads of the alternate status register */
+static void ata_delay(ata_channel_t* ch) {
+    for (int i = 0; i < 4; i++) {
+        inb(ch->ctrl);
+    }
+}
+
+static int wait_not_busy(ata_channel_t* ch) {
+    for (uint32_t i = 0; i < ATA_TIMEOUT; i++) {
+        uint8_t status = inb(ch->ctrl);
+        if (!(status & ATA_SR_BSY)) return status;
+    }
+    return -1;
+}
+
+/* Wait for DRQ; -1 on error or timeout */
+static int wait_drq(ata_channel_t* ch) {
+    for (uint32_t i = 0; i < ATA_TIMEOUT; i++) {
+        uint8_t status = inb(ch->ctrl);
+        if (status & ATA_SR_BSY) continue;
+        if (status & (ATA_SR_ERR | ATA_SR_DF)) return -1;
+        if (status & ATA_SR_DRQ) return 0;
+    }
+    return -1;
+}
+
+static void select_drive(ata_drive_t* drive, uint8_t head) {
+    outb(drive->ch->base + ATA_REG_DRIVE, 0xE0 | (drive->slave << 4) | (head & 0x0F));
+    ata_delay(drive->ch);
+}
+
+/* Load the task file for a transfer; true if it needs the EXT commands */
+static bool setup_lba(ata_drive_t* drive, uint64_t lba, uint32_t count) {
+    ata_channel_t* ch = drive->ch;
+    bool ext = drive->lba48 && (lba + count > LBA28_LIMIT || count > 256);
+
+    if (ext) {
+        select_drive(drive, 0);
+        outb(ch->base + ATA_REG_SECCOUNT, (uint8_t)(count >> 8));
+        outb(ch->base + ATA_REG_LBA0, (uint8_t)(lba >> 24));
+        outb(ch->base + ATA_REG_LBA1, (uint8_t)(lba >> 32));
+        outb(ch->base + ATA_REG_LBA2, (uint8_t)(lba >> 40));
+    } else {
+        select_drive(drive, (uint8_t)(lba >> 24));
+    }
+    outb(ch->base + ATA_REG_SECCOUNT, (uint8_t)count);     /* 0 = 256 */
+    outb(ch->base + ATA_REG_LBA0, (uint8_t)lba);
+    outb(ch->base + ATA_REG_LBA1, (uint8_t)(lba >> 8));
+    outb(ch->base + ATA_REG_LBA2, (uint8_t)(lba >> 16));
+    return ext;
+}
+
+/*
+ * ===========================================================================
+ * PIO
+ * ===========================================================================
+ */
+
+static int pio_flush(ata_drive_t* drive) {
+    ata_channel_t* ch = drive->ch;
+    if (wait_not_busy(ch) < 0) return -1;
+    select_drive(drive, 0);
+    outb(ch->base + ATA_REG_COMMAND, drive->lba48 ? ATA_CMD_FLUSH_EXT : ATA_CMD_FLUSH);
+    int status = wait_not_busy(ch);
+    return status < 0 || (status & (ATA_SR_ERR | ATA_SR_DF)) ? -1 : 0;
+}
+
+/* Run a whole request by programmed I/O, one sector per DRQ */
+static int pio_transfer(ata_drive_t* drive, request_t* req) {
+    ata_channel_t* ch = drive->ch;
+    bool write = req->op == BIO_WRITE;
+
+    if (wait_not_busy(ch) < 0) return -1;
+    bool ext = setup_lba(drive, req->sector, req->sectors);
+    uint8_t cmd = write ? (ext ? ATA_CMD_WRITE_PIO_EXT : ATA_CMD_WRITE_PIO)
+                        : (ext ? ATA_CMD_READ_PIO_EXT : ATA_CMD_READ_PIO);
+    outb(ch->base + ATA_REG_COMMAND, cmd);
+
+    bio_t* bio;
+    bio_seg_t* seg;
+    uint32_t i;
+    REQ_FOR_EACH_SEG(req, seg, bio, i) {
+        for (uint32_t off = 0; off < seg->len; off += BLOCK_SECTOR_SIZE) {
+            ata_delay(ch);
+            if (wait_drq(ch) < 0) return -1;
+            void* p = (void*)(seg->addr + off);
+            if (write) {
+                outsw(ch->base + ATA_REG_DATA, p, BLOCK_SECTOR_SIZE / 2);
+            } else {
+                insw(ch->base + ATA_REG_DATA, p, BLOCK_SECTOR_SIZE / 2);
+            }
+        }
+    }
+
+    ata_delay(ch);
+    int status = wait_not_busy(ch);
+    return status < 0 || (status & (ATA_SR_ERR | ATA_SR_DF)) ? -1 : 0;
+}
+
+/*
+ * ===========================================================================
+ * Bus-Master DMA
+ * ===========================================================================
+ */
+
+/*
+ * Describe a request in the PRD table. Regions must be word aligned,
+ * reachable by the device (our identity map is physical memory) and may
+ * not cross a 64KB boundary.
+ */
+static bool build_prdt(ata_channel_t* ch, request_t* req) {
+    uint32_t n = 0;
+    bio_t* bio;
+    bio_seg_t* seg;
+    uint32_t i;
+
+    REQ_FOR_EACH_SEG(req, seg, bio, i) {
+        uint32_t addr = seg->addr;
+        uint32_t left = seg->len;
+        if ((addr & 1) || addr + left > PAGING_IDENTITY_END) return false;
+
+        while (left > 0) {
+            uint32_t room = 0x10000 - (addr & 0xFFFF);
+            uint32_t len = left < room ? left : room;
+            if (n == PRD_MAX) return false;
+            ch->prdt[n].addr = addr;
+            ch->prdt[n].bytes = (uint16_t)len;     /* 64KB wraps to 0 */
+            ch->prdt[n].flags = 0;
+            n++;
+            addr += len;
+            left -= len;
+        }
+    }
+    if (n == 0) return false;
+    ch->prdt[n - 1].flags = PRD_EOT;
+    return true;
+}
+
+static void dma_start(ata_drive_t* drive, request_t* req) {
+    ata_channel_t* ch = drive->ch;
+    bool write = req->op == BIO_WRITE;
+
+    outb(ch->bmide + BMIDE_CMD, 0);
+    outl(ch->bmide + BMIDE_PRDT, (uint32_t)ch->prdt);
+    outb(ch->bmide + BMIDE_STATUS, inb(ch->bmide + BMIDE_STATUS) | BMIDE_SR_IRQ | BMIDE_SR_ERR);
+    outb(ch->bmide + BMIDE_CMD, write ? 0 : BMIDE_CMD_READ);
+
+    wait_not_busy(ch);
+    outb(ch->ctrl, 0);                              /* Interrupt on completion */
+    bool ext = setup_lba(drive, req->sector, req->sectors);
+    uint8_t cmd = write ? (ext ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_WRITE_DMA)
+                        : (ext ? ATA_CMD_READ_DMA_EXT : ATA_CMD_READ_DMA);
+    outb(ch->base + ATA_REG_COMMAND, cmd);
+    outb(ch->bmide + BMIDE_CMD, (write ? 0 : BMIDE_CMD_READ) | BMIDE_CMD_START);
+}
+
+/*
+ * ===========================================================================
+ * Channel Queue
+ * ===========================================================================
+ */
+
+/* Start the next pending request; DMA ones finish in the interrupt */
+static void channel_kick(ata_channel_t* ch) {
+    for (;;) {
+        uint32_t irq = irq_save();
+        request_t* req = ch->pending;
+        if (ch->active || !req) {
+            irq_restore(irq);
+            return;
+        }
+        ch->pending = (request_t*)req->driver_data;
+        if (!ch->pending) ch->pending_tail = NULL;
+        ch->active = req;
+
+        ata_drive_t* drive = (ata_drive_t*)req->dev->priv;
+        uint64_t start = timer_read_tsc();
+        if (req->op != BIO_FLUSH && drive->dma && build_prdt(ch, req)) {
+            ch->active_dma = true;
+            stats.dma_requests++;
+            dma_start(drive, req);
+            stats.cpu_cycles += timer_read_tsc() - start;
+            irq_restore(irq);
+            return;
+        }
+        ch->active_dma = false;
+        irq_restore(irq);
+
+        /* Synchronous: keep the device quiet while we poll it */
+        outb(ch->ctrl, ATA_CTL_NIEN);
+        int status = req->op == BIO_FLUSH ? pio_flush(drive) : pio_transfer(drive, req);
+        if (req->op != BIO_FLUSH) stats.pio_requests++;
+        if (status) stats.errors++;
+        stats.cpu_cycles += timer_read_tsc() - start;
+
+        irq = irq_save();
+        ch->active = NULL;
+        irq_restore(irq);
+        block_complete(req, status);
+    }
+}
+
+/* Finish the DMA command in progress, if it is done. Interrupts off. */
+static void channel_service(ata_channel_t* ch) {
+    request_t* req = ch->active;
+    if (!req || !ch->active_dma) {
+        inb(ch->base + ATA_REG_STATUS);             /* Acknowledge anyway */
+        return;
+    }
+
+    uint64_t start = timer_read_tsc();
+    uint8_t bm = inb(ch->bmide + BMIDE_STATUS);
+    if (!(bm & BMIDE_SR_IRQ)) return;               /* Not ours yet */
+
+    outb(ch->bmide + BMIDE_CMD, 0);
+    uint8_t status = inb(ch->base + ATA_REG_STATUS);
+    outb(ch->bmide + BMIDE_STATUS, bm | BMIDE_SR_IRQ | BMIDE_SR_ERR);
+
+    int result = (bm & BMIDE_SR_ERR) || (status & (ATA_SR_ERR | ATA_SR_DF)) ? -1 : 0;
+    if (result) stats.errors++;
+    req->dev->stats.irqs++;
+    ch->active = NULL;
+    stats.cpu_cycles += timer_read_tsc() - start;
+
+    block_complete(req, result);
+    channel_kick(ch);
+}
+
+static void ata_irq14(void) {
+    channel_service(&channels[0]);
+}
+
+static void ata_irq15(void) {
+    channel_service(&channels[1]);
+}
+
+/* PCI native mode: both channels share the controller's line */
+static void ata_irq_native(void) {
+    channel_service(&channels[0]);
+    channel_service(&channels[1]);
+}
+
+/*
+ * ===========================================================================
+ * Block Device Operations
+ * ===========================================================================
+ */
+
+static int ata_submit(block_device_t* dev, request_t* req) {
+    ata_channel_t* ch = ((ata_drive_t*)dev->priv)->ch;
+
+    uint32_t irq = irq_save();
+    req->driver_data = NULL;
+    if (ch->pending_tail) {
+        ch->pending_tail->driver_data = req;
+    } else {
+        ch->pending = req;
+    }
+    ch->pending_tail = req;
+    irq_restore(irq);
+
+    channel_kick(ch);
+    return 0;
+}
+
+static void ata_poll(block_device_t* dev) {
+    ata_channel_t* ch = ((ata_drive_t*)dev->priv)->ch;
+    uint32_t irq = irq_save();
+    channel_service(ch);
+    irq_restore(irq);
+}
+
+static const block_ops_t ata_ops = {
+    .submit = ata_submit,
+    .poll   = ata_poll,
+};
+
+int ata_set_dma(block_device_t* dev, bool enable) {
+    if (!dev || dev->ops != &ata_ops) return -1;
+    ata_drive_t* drive = (ata_drive_t*)dev->priv;
+    if (enable && !(drive->dma_capable && drive->ch->bmide)) return -1;
+    drive->dma = enable;
+    return 0;
+}
+
+void ata_get_stats(ata_stats_t* out) {
+    uint32_t irq = irq_save();
+    *out = stats;
+    irq_restore(irq);
+}
+
+void ata_reset_stats(void) {
+    uint32_t irq = irq_save();
+    stats.dma_requests = 0;
+    stats.pio_requests = 0;
+    stats.errors = 0;
+    stats.cpu_cycles = 0;
+    irq_restore(irq);
+}
+
+/*
+ * ===========================================================================
+ * Probing
+ * ===========================================================================
+ */
+
+/* IDENTIFY one drive; false if there is no ATA disk there */
+static bool identify(ata_drive_t* drive) {
+    ata_channel_t* ch = drive->ch;
+    static uint16_t id[256];
+
+    select_drive(drive, 0);
+    outb(ch->base + ATA_REG_SECCOUNT, 0);
+    outb(ch->base + ATA_REG_LBA0, 0);
+    outb(ch->base + ATA_REG_LBA1, 0);
+    outb(ch->base + ATA_REG_LBA2, 0);
+    outb(ch->base + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+    ata_delay(ch);
+
+    uint8_t status = inb(ch->base + ATA_REG_STATUS);
+    if (status == 0 || status == 0xFF) return false;
+    if (wait_not_busy(ch) < 0) return false;
+
+    /* ATAPI and SATA bridges report a signature here instead */
+    if (inb(ch->base + ATA_REG_LBA1) || inb(ch->base + ATA_REG_LBA2)) return false;
+    if (wait_drq(ch) < 0) return false;
+    insw(ch->base + ATA_REG_DATA, id, 256);
+
+    drive->lba48 = (id[83] & (1 << 10)) != 0;
+    uint64_t sectors = drive->lba48
+        ? (uint64_t)id[100] | ((uint64_t)id[101] << 16) | ((uint64_t)id[102] << 32) |
+          ((uint64_t)id[103] << 48)
+        : (uint64_t)id[60] | ((uint64_t)id[61] << 16);
+    if (sectors == 0) return false;
+    drive->blk.sectors = sectors;
+    drive->dma_capable = (id[49] & (1 << 8)) != 0;
+
+    /* Model string: byte-swapped words, space padded */
+    for (int i = 0; i < 20; i++) {
+        drive->model[i * 2] = (char)(id[27 + i] >> 8);
+        drive->model[i * 2 + 1] = (char)id[27 + i];
+    }
+    int end = 40;
+    while (end > 0 && drive->model[end - 1] == ' ') end--;
+    drive->model[end] = '\0';
+
+    /* Select the fastest Ultra DMA (or multiword DMA) mode offered */
+    if (drive->dma_capable) {
+        uint8_t mode = 0;
+        if ((id[53] & (1 << 2)) && (id[88] & 0x7F)) {
+            for (int m = 6; m >= 0; m--) {
+                if (id[88] & (1 << m)) { mode = 0x40 | m; break; }
+            }
+        } else if (id[63] & 0x07) {
+            for (int m = 2; m >= 0; m--) {
+                if (id[63] & (1 << m)) { mode = 0x20 | m; break; }
+            }
+        }
+        if (mode) {
+            select_drive(drive, 0);
+            outb(ch->base + ATA_REG_FEATURES, 0x03);    /* Set transfer mode */
+            outb(ch->base + ATA_REG_SECCOUNT, mode);
+            outb(ch->base + ATA_REG_COMMAND, ATA_CMD_SET_FEATURES);
+            ata_delay(ch);
+            int st = wait_not_busy(ch);
+            if (st < 0 || (st & ATA_SR_ERR)) drive->dma_capable = false;
+        }
+    }
+    return true;
+}
+
+static void print_dec(uint32_t n) {
+    char buf[12];
+    int i = 0;
+    do {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    } while (n > 0);
+    while (i > 0) vga_putchar(buf[--i]);
+}
+
+static void probe_channel(int c) {
+    ata_channel_t* ch = &channels[c];
+
+    /* A floating bus reads 0xFF */
+    if (inb(ch->base + ATA_REG_STATUS) == 0xFF) return;
+
+    outb(ch->ctrl, ATA_CTL_SRST | ATA_CTL_NIEN);
+    ata_delay(ch);
+    outb(ch->ctrl, ATA_CTL_NIEN);
+    wait_not_busy(ch);
+
+    for (int d = 0; d < 2; d++) {
+        ata_drive_t* drive = &drives[c * 2 + d];
+        drive->ch = ch;
+        drive->slave = (uint8_t)d;
+        if (!identify(drive)) continue;
+
+        if (drive->dma_capable && ch->bmide) {
+            outb(ch->bmide + BMIDE_STATUS,
+                 inb(ch->bmide + BMIDE_STATUS) | (d ? BMIDE_SR_DMA1 : BMIDE_SR_DMA0));
+            drive->dma = true;
+        }
+
+        block_device_t* blk = &drive->blk;
+        const char* name = drive_names[c * 2 + d];
+        for (int i = 0; name[i]; i++) blk->name[i] = name[i];
+        blk->max_sectors = 256;
+        blk->max_segs = REQ_MAX_SEGS;
+        blk->queue_depth = 1;
+        blk->major = DEV_MAJOR_IDE0;
+        blk->minor = (uint32_t)(c * 2 + d) * 64;
+        blk->ops = &ata_ops;
+        blk->priv = drive;
+        if (block_register(blk) != 0) continue;
+
+        vga_puts("[KERNEL] ATA ");
+        vga_puts(name);
+        vga_puts(": ");
+        vga_puts(drive->model);
+        vga_puts(", ");
+        print_dec((uint32_t)(blk->sectors / 2048));
+        vga_puts(drive->dma ? " MB, DMA" : " MB, PIO");
+        vga_puts(drive->lba48 ? ", LBA48\n" : ", LBA28\n");
+    }
+}
+
+void ata_init(void) {
+    static const uint16_t legacy_io[2] = { ATA_PRIMARY_IO, ATA_SECONDARY_IO };
+    static const uint16_t legacy_ctrl[2] = { ATA_PRIMARY_CTRL, ATA_SECONDARY_CTRL };
+
+    pci_device_t* pci = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, NULL);
+    uint16_t bmide = 0;
+    if (pci) {
+        pci_enable(pci);
+        /* Bus mastering is advertised in prog-if bit 7 */
+        if ((pci->prog_if & 0x80) && pci_bar_is_io(pci, 4)) {
+            bmide = (uint16_t)pci_bar_addr(pci, 4);
+        }
+    }
+
+    bool native_irq = false;
+    for (int c = 0; c < 2; c++) {
+        ata_channel_t* ch = &channels[c];
+        /* Prog-if bit 0 (primary) / bit 2 (secondary): PCI native mode */
+        bool native = pci && (pci->prog_if & (1 << (c * 2)));
+        if (native && pci_bar_addr(pci, c * 2)) {
+            ch->base = (uint16_t)pci_bar_addr(pci, c * 2);
+            ch->ctrl = (uint16_t)pci_bar_addr(pci, c * 2 + 1) + 2;
+            ch->irq = pci->irq;
+            native_irq = true;
+        } else {
+            ch->base = legacy_io[c];
+            ch->ctrl = legacy_ctrl[c];
+            ch->irq = (uint8_t)(14 + c);
+        }
+        /* DMA completes by interrupt, so it needs a usable line */
+        ch->bmide = bmide && ch->irq < 16 ? (uint16_t)(bmide + c * 8) : 0;
+        if (ch->bmide) {
+            ch->prdt = (ata_prd_t*)pmm_alloc_page();
+            if (!ch->prdt) ch->bmide = 0;
+        }
+    }
+
+    register_interrupt_handler(IRQ14, ata_irq14);
+    register_interrupt_handler(IRQ15, ata_irq15);
+    if (native_irq && pci->irq < 16 && pci->irq != 14 && pci->irq != 15) {
+        register_interrupt_handler(IRQ_BASE + pci->irq, ata_irq_native);
+    }
+
+    for (int c = 0; c < 2; c++) {
+        probe_channel(c);
+        /* Device interrupts on: DMA completions arrive on the channel IRQ */
+        outb(channels[c].ctrl, 0);
+    }
+}
@@ -9,6 +9,8 @@
 
 #include "../include/io.h"
 #include "../include/vga.h"
+#include "../include/syscall.h"
+#include "../fs/vfs.h"
 
 /*
  * ===========================================================================
@@ -17,10 +19,21 @@
  */
 
 void display_print(const char *str) {
+    /* A pipeline stage's stdout may be redirected into a pipe */
+    if (vfs_stdio_node(STDOUT_FD)) {
+        uint32_t len = 0;
+        while (str[len]) len++;
+        vfs_write(STDOUT_FD, str, len);
+        return;
+    }
     vga_puts(str);
 }
 
 void display_putchar(char c) {
+    if (vfs_stdio_node(STDOUT_FD)) {
+        vfs_write(STDOUT_FD, &c, 1);
+        return;
+    }
     vga_putchar(c);
 }
 
@@ -8,6 +8,7 @@
 #include "keyboard.h"
 #include "idt.h"
 #include "vga.h"
+#include "process.h"
 
 /* I/O helpers */
 static inline uint8_t inb(uint16_t port) {
@@ -28,6 +29,9 @@ static char kb_buffer[KB_BUFFER_SIZE];
 static volatile uint32_t kb_buffer_head = 0;
 static volatile uint32_t kb_buffer_tail = 0;
 
+/* Processes waiting for (or polling for) input */
+static wait_queue_t kb_wait;
+
 /* External function from Shell's io_stubs.c */
 extern void keyboard_irq_handler(char c);
 
@@ -123,9 +127,10 @@ static void keyboard_handler(void) {
                     c = 3;  /* ASCII ETX (Ctrl+C) */
                 }
 
-                /* Add to buffer and notify shell */
+                /* Add to buffer and notify shell and readers */
                 kb_buffer_put(c);
                 keyboard_irq_handler(c);
+                wait_queue_wake_all(&kb_wait);
             }
         }
     }
@@ -135,6 +140,8 @@ static void keyboard_handler(void) {
  * Initialize keyboard driver
  */
 void keyboard_init(void) {
+    wait_queue_init(&kb_wait);
+
     /* Register IRQ1 handler */
     register_interrupt_handler(IRQ1, keyboard_handler);
 
@@ -157,12 +164,27 @@ bool keyboard_haschar(void) {
  * Get next character from buffer (blocking)
  */
 char keyboard_getchar(void) {
+    uint32_t flags = irq_save();
+
     /* Wait for character */
     while (kb_buffer_head == kb_buffer_tail) {
-        __asm__ volatile ("hlt");
+        if (process_current()) {
+            wait_queue_sleep(&kb_wait);
+        } else {
+            __asm__ volatile ("sti; hlt; cli");
+        }
     }
 
     char c = kb_buffer[kb_buffer_tail];
     kb_buffer_tail = (kb_buffer_tail + 1) % KB_BUFFER_SIZE;
+
+    irq_restore(flags);
     return c;
 }
+
+/**
+ * Wait queue woken on every keystroke
+ */
+wait_queue_t* keyboard_wait_queue(void) {
+    return &kb_wait;
+}
@@ -0,0 +1,572 @@
+/**
+ * ClaudeOS NVMe Driver - nvme.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: NVMe admin bring-up, I/O queue pairs and PRP lists
+ *
+ * Each command slot owns a PRP list big enough for the largest request
+ * we accept, so building a command never allocates. A request whose
+ * segments cannot be described by one PRP chain (a segment ending or
+ * starting mid-page next to another) is split into several commands
+ * and completed when the last of them finishes.
+ *
+ * The INTx line is edge-triggered through the PIC, so the handler masks
+ * the controller's interrupt while it reaps and unmasks it afterwards;
+ * completions that arrive meanwhile raise a fresh edge.
+ */
+
+#include "types.h"
+#include "nvme.h"
+#include "block.h"
+#include "pci.h"
+#include "pmm.h"
+#include "kmalloc.h"
+#include "paging.h"
+#include "idt.h"
+#include "vga.h"
+#include "../fs/devfs.h"
+
+#define NVME_MAX_NAMESPACES 4
+#define NVME_ADMIN_DEPTH    32
+#define NVME_IO_DEPTH       64      /* Entries per I/O queue (one page of SQEs) */
+#define NVME_IO_QUEUES      1       /* One pair per CPU */
+#define NVME_PRP_ENTRIES    128     /* Per slot: 512KB past the first page */
+#define NVME_MAX_SECTORS    1024
+#define NVME_TIMEOUT        10000000
+
+#define REG32(ctrl, off)    (*(volatile uint32_t*)((ctrl)->regs + (off)))
+
+typedef struct {
+    request_t* req;
+    uint64_t* prp;                  /* NVME_PRP_ENTRIES, DMA-able */
+    uint32_t prp1;
+    uint32_t pages;                 /* Pages the transfer touches */
+    uint32_t bytes;
+} nvme_slot_t;
+
+typedef struct {
+    uint16_t qid;
+    uint16_t depth;
+    nvme_sqe_t* sq;
+    volatile nvme_cqe_t* cq;
+    volatile uint32_t* sq_doorbell;
+    volatile uint32_t* cq_doorbell;
+    uint16_t sq_tail;
+    uint16_t cq_head;
+    uint16_t phase;
+    bool added;                     /* Entries written since the last doorbell */
+    nvme_slot_t* slots;             /* depth - 1 usable */
+    uint64_t free;                  /* Bitmap of free slots */
+} nvme_queue_t;
+
+typedef struct nvme_ns {
+    block_device_t blk;
+    struct nvme_ctrl* ctrl;
+    uint32_t nsid;
+    uint32_t lba_shift;             /* Sectors of 512 bytes per LBA, as a shift */
+} nvme_ns_t;
+
+typedef struct nvme_ctrl {
+    volatile uint8_t* regs;
+    uint32_t stride;                /* Doorbell stride in bytes */
+    nvme_queue_t admin;
+    nvme_queue_t io[NVME_IO_QUEUES];
+    uint32_t nio;
+    nvme_ns_t ns[NVME_MAX_NAMESPACES];
+    uint32_t nns;
+    bool polled;
+} nvme_ctrl_t;
+
+static nvme_ctrl_t controller;
+static bool present = false;
+
+/*
+ * ===========================================================================
+ * Queues
+ * ===========================================================================
+ */
+
+static int queue_init(nvme_ctrl_t* ctrl, nvme_queue_t* q, uint16_t qid, uint16_t depth) {
+    q->qid = qid;
+    q->depth = depth;
+    q->sq = (nvme_sqe_t*)pmm_alloc_page();
+    q->cq = (volatile nvme_cqe_t*)pmm_alloc_page();
+    if (!q->sq || !q->cq) return -1;
+    pmm_zero_page((uint32_t)q->sq);
+    pmm_zero_page((uint32_t)q->cq);
+    q->sq_doorbell = (volatile uint32_t*)(ctrl->regs + NVME_REG_DOORBELL + (2 * qid) * ctrl->stride);
+    q->cq_doorbell = (volatile uint32_t*)(ctrl->regs + NVME_REG_DOORBELL + (2 * qid + 1) * ctrl->stride);
+    q->sq_tail = 0;
+    q->cq_head = 0;
+    q->phase = 1;
+    q->added = false;
+    q->slots = NULL;
+    q->free = 0;
+    return 0;
+}
+
+/* Give an I/O queue its slots and their PRP lists (1KB each) */
+static int queue_init_slots(nvme_queue_t* q) {
+    uint32_t count = q->depth - 1u;
+    uint32_t per_page = PAGE_SIZE / (NVME_PRP_ENTRIES * sizeof(uint64_t));
+    uint32_t pages = (count + per_page - 1) / per_page;
+    uint32_t lists = pmm_alloc_pages(pages);
+    q->slots = (nvme_slot_t*)kmalloc(count * sizeof(nvme_slot_t));
+    if (!lists || !q->slots) return -1;
+
+    for (uint32_t i = 0; i < count; i++) {
+        q->slots[i].req = NULL;
+        q->slots[i].prp = (uint64_t*)(lists + i * NVME_PRP_ENTRIES * sizeof(uint64_t));
+    }
+    q->free = count == 64 ? ~0ULL : (1ULL << count) - 1;
+    return 0;
+}
+
+static void queue_push(nvme_queue_t* q, const nvme_sqe_t* cmd) {
+    q->sq[q->sq_tail] = *cmd;
+    q->sq_tail = (uint16_t)((q->sq_tail + 1) % q->depth);
+    q->added = true;
+}
+
+static void queue_ring(nvme_queue_t* q) {
+    if (q->added) {
+        q->added = false;
+        *q->sq_doorbell = q->sq_tail;
+    }
+}
+
+/* Next completion, or NULL; the caller rings the head doorbell after */
+static volatile nvme_cqe_t* queue_next_cqe(nvme_queue_t* q) {
+    volatile nvme_cqe_t* cqe = &q->cq[q->cq_head];
+    if ((cqe->status & 1) != q->phase) return NULL;
+    if (++q->cq_head == q->depth) {
+        q->cq_head = 0;
+        q->phase ^= 1;
+    }
+    return cqe;
+}
+
+/* Run one admin command to completion (boot time, polled) */
+static int admin_command(nvme_ctrl_t* ctrl, nvme_sqe_t* cmd, uint32_t* result) {
+    nvme_queue_t* q = &ctrl->admin;
+    cmd->cid = q->sq_tail;
+    queue_push(q, cmd);
+    queue_ring(q);
+
+    for (uint32_t i = 0; i < NVME_TIMEOUT; i++) {
+        volatile nvme_cqe_t* cqe = queue_next_cqe(q);
+        if (cqe) {
+            *q->cq_doorbell = q->cq_head;
+            if (result) *result = cqe->result;
+            return (cqe->status >> 1) == 0 ? 0 : -1;
+        }
+        __asm__ volatile ("pause");
+    }
+    return -1;
+}
+
+/*
+ * ===========================================================================
+ * I/O
+ * ===========================================================================
+ */
+
+/*
+ * Cut a request into PRP-describable commands. Counts them, and when
+ * 'slots' is given also fills each one's PRP1 and list.
+ * @return Commands needed, or 0 if a buffer is not dword aligned
+ */
+static uint32_t map_request(request_t* req, nvme_slot_t** slots) {
+    nvme_slot_t* cur = NULL;
+    uint32_t cmds = 0;
+    uint32_t pages = 0;
+    uint32_t end = 0;
+
+    bio_t* bio;
+    bio_seg_t* seg;
+    uint32_t i;
+    REQ_FOR_EACH_SEG(req, seg, bio, i) {
+        if (seg->addr & 3) return 0;
+        for (uint32_t off = 0; off < seg->len; ) {
+            uint32_t addr = seg->addr + off;
+            uint32_t len = PAGE_SIZE - (addr & (PAGE_SIZE - 1));
+            if (len > seg->len - off) len = seg->len - off;
+
+            if (cmds > 0 && addr == end && (addr & (PAGE_SIZE - 1))) {
+                /* Continues within the same page */
+            } else if (cmds > 0 && !(end & (PAGE_SIZE - 1)) && !(addr & (PAGE_SIZE - 1)) &&
+                       pages <= NVME_PRP_ENTRIES) {
+                if (cur) cur->prp[pages - 1] = addr;
+                pages++;
+            } else {
+                if (cur) cur->pages = pages;
+                cur = slots ? slots[cmds] : NULL;
+                cmds++;
+                pages = 1;
+                if (cur) {
+                    cur->prp1 = addr;
+                    cur->bytes = 0;
+                }
+            }
+            if (cur) cur->bytes += len;
+            end = addr + len;
+            off += len;
+        }
+    }
+    if (cur) cur->pages = pages;
+    return cmds;
+}
+
+static void build_rw(nvme_ns_t* ns, nvme_slot_t* slot, uint16_t cid, uint64_t sector,
+                     bool write, nvme_sqe_t* cmd) {
+    uint64_t lba = sector >> ns->lba_shift;
+    uint32_t blocks = (slot->bytes >> BLOCK_SECTOR_SHIFT) >> ns->lba_shift;
+
+    for (uint32_t i = 0; i < sizeof(*cmd); i++) ((uint8_t*)cmd)[i] = 0;
+    cmd->opcode = write ? NVME_CMD_WRITE : NVME_CMD_READ;
+    cmd->cid = cid;
+    cmd->nsid = ns->nsid;
+    cmd->prp1 = slot->prp1;
+    if (slot->pages == 2) {
+        cmd->prp2 = slot->prp[0];
+    } else if (slot->pages > 2) {
+        cmd->prp2 = (uint32_t)slot->prp;
+    }
+    cmd->cdw10 = (uint32_t)lba;
+    cmd->cdw11 = (uint32_t)(lba >> 32);
+    cmd->cdw12 = blocks - 1;
+}
+
+static int nvme_submit(block_device_t* dev, request_t* req) {
+    nvme_ns_t* ns = (nvme_ns_t*)dev->priv;
+    nvme_queue_t* q = &ns->ctrl->io[0];
+    uint32_t align = (1u << ns->lba_shift) - 1;
+    nvme_sqe_t cmd;
+
+    uint32_t cmds = 1;
+    if (req->op != BIO_FLUSH) {
+        cmds = map_request(req, NULL);
+        if (cmds == 0 || (req->sector & align) || (req->sectors & align)) {
+            block_complete(req, -1);
+            return 0;
+        }
+    }
+
+    uint32_t irq = irq_save();
+    nvme_slot_t* slots[REQ_MAX_SEGS];
+    uint16_t cids[REQ_MAX_SEGS];
+    uint64_t free = q->free;
+    for (uint32_t c = 0; c < cmds; c++) {
+        if (!free) {
+            irq_restore(irq);
+            return -1;
+        }
+        uint32_t low = (uint32_t)free;
+        cids[c] = (uint16_t)(low ? __builtin_ctz(low) : 32 + __builtin_ctz((uint32_t)(free >> 32)));
+        free &= free - 1;
+        slots[c] = &q->slots[cids[c]];
+    }
+    q->free = free;
+
+    /* Parts still outstanding, kept in the request while it is in flight */
+    req->driver_data = (void*)(cmds << 1);
+
+    if (req->op == BIO_FLUSH) {
+        for (uint32_t i = 0; i < sizeof(cmd); i++) ((uint8_t*)&cmd)[i] = 0;
+        cmd.opcode = NVME_CMD_FLUSH;
+        cmd.cid = cids[0];
+        cmd.nsid = ns->nsid;
+        slots[0]->req = req;
+        queue_push(q, &cmd);
+    } else {
+        map_request(req, slots);
+        bool whole = true;
+        for (uint32_t c = 0; c < cmds; c++) {
+            if ((slots[c]->bytes >> BLOCK_SECTOR_SHIFT) & align) whole = false;
+        }
+        if (!whole) {
+            /* A piece is not a whole number of blocks: give the slots back */
+            for (uint32_t c = 0; c < cmds; c++) q->free |= 1ULL << cids[c];
+            irq_restore(irq);
+            block_complete(req, -1);
+            return 0;
+        }
+        uint64_t sector = req->sector;
+        for (uint32_t c = 0; c < cmds; c++) {
+            build_rw(ns, slots[c], cids[c], sector, req->op == BIO_WRITE, &cmd);
+            slots[c]->req = req;
+            sector += slots[c]->bytes >> BLOCK_SECTOR_SHIFT;
+            queue_push(q, &cmd);
+        }
+    }
+    irq_restore(irq);
+    return 0;
+}
+
+/* One tail doorbell write for the whole dispatch pass */
+static void nvme_commit(block_device_t* dev) {
+    nvme_ctrl_t* ctrl = ((nvme_ns_t*)dev->priv)->ctrl;
+    uint32_t irq = irq_save();
+    for (uint32_t i = 0; i < ctrl->nio; i++) {
+        queue_ring(&ctrl->io[i]);
+    }
+    irq_restore(irq);
+}
+
+/*
+ * Complete everything the controller has posted. Interrupts off.
+ * @return A device that had a request completed, or NULL
+ */
+static block_device_t* nvme_reap(nvme_ctrl_t* ctrl) {
+    block_device_t* last = NULL;
+    for (uint32_t i = 0; i < ctrl->nio; i++) {
+        nvme_queue_t* q = &ctrl->io[i];
+        volatile nvme_cqe_t* cqe;
+        bool reaped = false;
+        while ((cqe = queue_next_cqe(q)) != NULL) {
+            nvme_slot_t* slot = &q->slots[cqe->cid];
+            request_t* req = slot->req;
+            uint32_t parts = (uint32_t)req->driver_data;
+            if (cqe->status >> 1) parts |= 1;       /* Low bit: a part failed */
+
+            slot->req = NULL;
+            q->free |= 1ULL << cqe->cid;
+            reaped = true;
+            parts -= 2;
+            req->driver_data = (void*)parts;
+            if (parts >> 1) continue;
+
+            last = req->dev;
+            if (parts & 1) req->dev->stats.errors++;
+            block_complete(req, (parts & 1) ? -1 : 0);
+        }
+        if (reaped) *q->cq_doorbell = q->cq_head;
+    }
+    return last;
+}
+
+static void nvme_irq(void) {
+    nvme_ctrl_t* ctrl = &controller;
+    if (!present || ctrl->polled) return;
+
+    REG32(ctrl, NVME_REG_INTMS) = 1;
+    block_device_t* dev = nvme_reap(ctrl);
+    if (dev) {
+        dev->stats.irqs++;
+    }
+    REG32(ctrl, NVME_REG_INTMC) = 1;
+}
+
+static void nvme_poll(block_device_t* dev) {
+    uint32_t irq = irq_save();
+    nvme_reap(((nvme_ns_t*)dev->priv)->ctrl);
+    irq_restore(irq);
+}
+
+static const block_ops_t nvme_ops = {
+    .submit = nvme_submit,
+    .poll   = nvme_poll,
+    .commit = nvme_commit,
+};
+
+int nvme_set_polled(block_device_t* dev, bool polled) {
+    if (!dev || dev->ops != &nvme_ops) return -1;
+    nvme_ctrl_t* ctrl = ((nvme_ns_t*)dev->priv)->ctrl;
+
+    uint32_t irq = irq_save();
+    ctrl->polled = polled;
+    REG32(ctrl, polled ? NVME_REG_INTMS : NVME_REG_INTMC) = 1;
+    for (uint32_t i = 0; i < ctrl->nns; i++) {
+        ctrl->ns[i].blk.polled = polled;
+    }
+    irq_restore(irq);
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Controller Bring-up
+ * ===========================================================================
+ */
+
+static bool wait_ready(nvme_ctrl_t* ctrl, bool ready) {
+    for (uint32_t i = 0; i < NVME_TIMEOUT; i++) {
+        uint32_t csts = REG32(ctrl, NVME_REG_CSTS);
+        if (csts & NVME_CSTS_CFS) return false;
+        if (((csts & NVME_CSTS_RDY) != 0) == ready) return true;
+        __asm__ volatile ("pause");
+    }
+    return false;
+}
+
+static int identify(nvme_ctrl_t* ctrl, uint32_t cns, uint32_t nsid, uint32_t buf) {
+    nvme_sqe_t cmd;
+    for (uint32_t i = 0; i < sizeof(cmd); i++) ((uint8_t*)&cmd)[i] = 0;
+    cmd.opcode = NVME_ADMIN_IDENTIFY;
+    cmd.nsid = nsid;
+    cmd.prp1 = buf;
+    cmd.cdw10 = cns;
+    return admin_command(ctrl, &cmd, NULL);
+}
+
+static int create_io_queue(nvme_ctrl_t* ctrl, nvme_queue_t* q) {
+    nvme_sqe_t cmd;
+    for (uint32_t i = 0; i < sizeof(cmd); i++) ((uint8_t*)&cmd)[i] = 0;
+    cmd.opcode = NVME_ADMIN_CREATE_CQ;
+    cmd.prp1 = (uint32_t)q->cq;
+    cmd.cdw10 = ((uint32_t)(q->depth - 1) << 16) | q->qid;
+    cmd.cdw11 = (1u << 1) | 1u;                     /* Interrupts on vector 0, contiguous */
+    if (admin_command(ctrl, &cmd, NULL) != 0) return -1;
+
+    for (uint32_t i = 0; i < sizeof(cmd); i++) ((uint8_t*)&cmd)[i] = 0;
+    cmd.opcode = NVME_ADMIN_CREATE_SQ;
+    cmd.prp1 = (uint32_t)q->sq;
+    cmd.cdw10 = ((uint32_t)(q->depth - 1) << 16) | q->qid;
+    cmd.cdw11 = ((uint32_t)q->qid << 16) | 1u;      /* Paired CQ, contiguous */
+    return admin_command(ctrl, &cmd, NULL);
+}
+
+static void print_dec(uint32_t n) {
+    char buf[12];
+    int i = 0;
+    do {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    } while (n > 0);
+    while (i > 0) vga_putchar(buf[--i]);
+}
+
+static void add_namespace(nvme_ctrl_t* ctrl, uint32_t nsid, uint32_t buf, uint32_t max_sectors,
+                          uint16_t depth) {
+    if (ctrl->nns == NVME_MAX_NAMESPACES) return;
+    if (identify(ctrl, NVME_CNS_NAMESPACE, nsid, buf) != 0) return;
+
+    uint8_t* id = (uint8_t*)buf;
+    uint64_t nsze = *(uint64_t*)id;
+    uint32_t format = id[26] & 0x0F;
+    uint32_t lbads = id[128 + format * 4 + 2];
+    if (nsze == 0 || lbads < BLOCK_SECTOR_SHIFT || lbads > 12) return;
+
+    nvme_ns_t* ns = &ctrl->ns[ctrl->nns];
+    ns->ctrl = ctrl;
+    ns->nsid = nsid;
+    ns->lba_shift = lbads - BLOCK_SECTOR_SHIFT;
+
+    /* nvme0n1, nvme0n2... */
+    block_device_t* blk = &ns->blk;
+    const char* prefix = "nvme0n";
+    uint32_t len = 0;
+    while (prefix[len]) {
+        blk->name[len] = prefix[len];
+        len++;
+    }
+    blk->name[len++] = (char)('0' + nsid % 10);
+    blk->name[len] = '\0';
+
+    blk->sectors = nsze << ns->lba_shift;
+    blk->max_sectors = max_sectors;
+    blk->max_segs = 32;
+    blk->queue_depth = depth - 1u;
+    blk->major = DEV_MAJOR_NVME;
+    blk->minor = ctrl->nns;
+    blk->ops = &nvme_ops;
+    blk->priv = ns;
+    ctrl->nns++;
+    block_register(blk);
+
+    vga_puts("[KERNEL] NVMe ");
+    vga_puts(blk->name);
+    vga_puts(": ");
+    print_dec((uint32_t)(blk->sectors / 2048));
+    vga_puts(" MB, ");
+    print_dec(1u << lbads);
+    vga_puts("-byte blocks, queue depth ");
+    print_dec(blk->queue_depth);
+    vga_putchar('\n');
+}
+
+void nvme_init(void) {
+    pci_device_t* pci = NULL;
+    while ((pci = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_NVM, pci)) != NULL) {
+        if (pci->prog_if == 0x02) break;
+    }
+    if (!pci || pci_bar_is_io(pci, 0)) return;
+
+    /* The queues' doorbells sit right after the first 4KB */
+    uint32_t bar = pci_bar_addr(pci, 0);
+    if (!bar || paging_map_mmio(bar, 0x2000) != 0) return;
+    pci_enable(pci);
+
+    nvme_ctrl_t* ctrl = &controller;
+    ctrl->regs = (volatile uint8_t*)bar;
+    uint32_t cap_lo = REG32(ctrl, NVME_REG_CAP);
+    uint32_t cap_hi = REG32(ctrl, NVME_REG_CAP + 4);
+    uint32_t mqes = (cap_lo & 0xFFFF) + 1;
+    ctrl->stride = 4u << (cap_hi & 0x0F);
+    if (((cap_hi >> 16) & 0x0F) != 0) return;       /* 4KB pages unsupported */
+
+    /* Disable, then describe the admin queue and enable */
+    REG32(ctrl, NVME_REG_CC) = 0;
+    if (!wait_ready(ctrl, false)) return;
+
+    uint16_t admin_depth = mqes < NVME_ADMIN_DEPTH ? (uint16_t)mqes : NVME_ADMIN_DEPTH;
+    if (queue_init(ctrl, &ctrl->admin, 0, admin_depth) != 0) return;
+    REG32(ctrl, NVME_REG_AQA) = ((uint32_t)(admin_depth - 1) << 16) | (admin_depth - 1u);
+    REG32(ctrl, NVME_REG_ASQ) = (uint32_t)ctrl->admin.sq;
+    REG32(ctrl, NVME_REG_ASQ + 4) = 0;
+    REG32(ctrl, NVME_REG_ACQ) = (uint32_t)ctrl->admin.cq;
+    REG32(ctrl, NVME_REG_ACQ + 4) = 0;
+    REG32(ctrl, NVME_REG_INTMS) = 1;
+    REG32(ctrl, NVME_REG_CC) = NVME_CC_EN | NVME_CC_IOSQES | NVME_CC_IOCQES;
+    if (!wait_ready(ctrl, true)) return;
+
+    uint32_t buf = pmm_alloc_page();
+    if (!buf) return;
+    if (identify(ctrl, NVME_CNS_CONTROLLER, 0, buf) != 0) {
+        pmm_free_pages(buf, 1);
+        return;
+    }
+
+    /* MDTS is a power of two in units of the minimum page size */
+    uint8_t* id = (uint8_t*)buf;
+    uint32_t max_sectors = NVME_MAX_SECTORS;
+    if (id[77] && id[77] < 8 && ((uint32_t)PAGE_SIZE << id[77]) / BLOCK_SECTOR_SIZE < max_sectors) {
+        max_sectors = ((uint32_t)PAGE_SIZE << id[77]) / BLOCK_SECTOR_SIZE;
+    }
+    uint32_t namespaces = *(uint32_t*)(id + 516);
+
+    /* Ask for one queue pair per CPU */
+    nvme_sqe_t cmd;
+    for (uint32_t i = 0; i < sizeof(cmd); i++) ((uint8_t*)&cmd)[i] = 0;
+    cmd.opcode = NVME_ADMIN_SET_FEATURES;
+    cmd.cdw10 = NVME_FEAT_NUM_QUEUES;
+    cmd.cdw11 = ((NVME_IO_QUEUES - 1u) << 16) | (NVME_IO_QUEUES - 1u);
+    admin_command(ctrl, &cmd, NULL);
+
+    uint16_t depth = mqes < NVME_IO_DEPTH ? (uint16_t)mqes : NVME_IO_DEPTH;
+    for (uint32_t i = 0; i < NVME_IO_QUEUES; i++) {
+        nvme_queue_t* q = &ctrl->io[i];
+        if (queue_init(ctrl, q, (uint16_t)(i + 1), depth) != 0 || queue_init_slots(q) != 0 ||
+            create_io_queue(ctrl, q) != 0) {
+            break;
+        }
+        ctrl->nio++;
+    }
+    if (ctrl->nio == 0) {
+        pmm_free_pages(buf, 1);
+        return;
+    }
+
+    present = true;
+    for (uint32_t nsid = 1; nsid <= namespaces && nsid <= 9; nsid++) {
+        add_namespace(ctrl, nsid, buf, max_sectors, depth);
+    }
+    pmm_free_pages(buf, 1);
+    if (ctrl->nns == 0) return;
+
+    if (pci->irq < 16) {
+        register_interrupt_handler(IRQ_BASE + pci->irq, nvme_irq);
+        REG32(ctrl, NVME_REG_INTMC) = 1;
+    } else {
+        nvme_set_polled(&ctrl->ns[0].blk, true);
+    }
+}
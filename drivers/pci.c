@@ -0,0 +1,155 @@
+/**
+ * ClaudeOS PCI Bus - pci.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Configuration mechanism #1 and a boot-time bus scan
+ */
+
+#include "types.h"
+#include "pci.h"
+#include "vga.h"
+
+/* I/O helpers */
+static inline void outl(uint16_t port, uint32_t value) {
+    __asm__ volatile ("outl %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint32_t inl(uint16_t port) {
+    uint32_t ret;
+    __asm__ volatile ("inl %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static pci_device_t devices[PCI_MAX_DEVICES];
+static uint32_t device_count = 0;
+
+static uint32_t config_address(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    return 0x80000000u | ((uint32_t)bus << 16) | ((uint32_t)slot << 11) |
+           ((uint32_t)func << 8) | (offset & 0xFC);
+}
+
+static uint32_t config_read(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    outl(PCI_CONFIG_ADDRESS, config_address(bus, slot, func, offset));
+    return inl(PCI_CONFIG_DATA);
+}
+
+uint32_t pci_read32(pci_device_t* dev, uint8_t offset) {
+    return config_read(dev->bus, dev->slot, dev->func, offset);
+}
+
+uint16_t pci_read16(pci_device_t* dev, uint8_t offset) {
+    return (uint16_t)(pci_read32(dev, offset) >> ((offset & 2) * 8));
+}
+
+uint8_t pci_read8(pci_device_t* dev, uint8_t offset) {
+    return (uint8_t)(pci_read32(dev, offset) >> ((offset & 3) * 8));
+}
+
+void pci_write32(pci_device_t* dev, uint8_t offset, uint32_t value) {
+    outl(PCI_CONFIG_ADDRESS, config_address(dev->bus, dev->slot, dev->func, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+void pci_write16(pci_device_t* dev, uint8_t offset, uint16_t value) {
+    uint32_t shift = (offset & 2) * 8;
+    uint32_t word = pci_read32(dev, offset);
+    word = (word & ~(0xFFFFu << shift)) | ((uint32_t)value << shift);
+    pci_write32(dev, offset, word);
+}
+
+bool pci_bar_is_io(pci_device_t* dev, int bar) {
+    return (dev->bar[bar] & 1) != 0;
+}
+
+uint32_t pci_bar_addr(pci_device_t* dev, int bar) {
+    if (bar < 0 || bar > 5) return 0;
+    return pci_bar_is_io(dev, bar) ? dev->bar[bar] & ~0x3u : dev->bar[bar] & ~0xFu;
+}
+
+void pci_enable(pci_device_t* dev) {
+    uint16_t cmd = pci_read16(dev, PCI_COMMAND);
+    cmd |= PCI_CMD_IO | PCI_CMD_MEMORY | PCI_CMD_BUS_MASTER;
+    pci_write16(dev, PCI_COMMAND, cmd);
+}
+
+pci_device_t* pci_next(pci_device_t* prev) {
+    uint32_t i = prev ? (uint32_t)(prev - devices) + 1 : 0;
+    return i < device_count ? &devices[i] : NULL;
+}
+
+pci_device_t* pci_find_class(uint8_t class_code, uint8_t subclass, pci_device_t* prev) {
+    for (pci_device_t* dev = pci_next(prev); dev; dev = pci_next(dev)) {
+        if (dev->class_code == class_code && (subclass == 0xFF || dev->subclass == subclass)) {
+            return dev;
+        }
+    }
+    return NULL;
+}
+
+pci_device_t* pci_find_id(uint16_t vendor, uint16_t device, pci_device_t* prev) {
+    for (pci_device_t* dev = pci_next(prev); dev; dev = pci_next(dev)) {
+        if (dev->vendor == vendor && (device == 0xFFFF || dev->device == device)) {
+            return dev;
+        }
+    }
+    return NULL;
+}
+
+uint8_t pci_find_capability(pci_device_t* dev, uint8_t id, uint8_t start) {
+    if (!(pci_read16(dev, PCI_STATUS) & PCI_STATUS_CAP_LIST)) return 0;
+
+    uint8_t off = start ? pci_read8(dev, start + 1) : pci_read8(dev, PCI_CAP_PTR);
+    for (int guard = 0; off >= 0x40 && guard < 48; guard++) {
+        off &= 0xFC;
+        if (pci_read8(dev, off) == id) return off;
+        off = pci_read8(dev, off + 1);
+    }
+    return 0;
+}
+
+static void probe(uint8_t bus, uint8_t slot, uint8_t func) {
+    uint32_t id = config_read(bus, slot, func, PCI_VENDOR_ID);
+    if ((id & 0xFFFF) == 0xFFFF || device_count >= PCI_MAX_DEVICES) return;
+
+    pci_device_t* dev = &devices[device_count++];
+    dev->bus = bus;
+    dev->slot = slot;
+    dev->func = func;
+    dev->vendor = (uint16_t)id;
+    dev->device = (uint16_t)(id >> 16);
+
+    uint32_t class_reg = config_read(bus, slot, func, 0x08);
+    dev->class_code = (uint8_t)(class_reg >> 24);
+    dev->subclass = (uint8_t)(class_reg >> 16);
+    dev->prog_if = (uint8_t)(class_reg >> 8);
+    dev->irq = (uint8_t)config_read(bus, slot, func, PCI_INTERRUPT_LINE);
+    for (int i = 0; i < 6; i++) {
+        dev->bar[i] = config_read(bus, slot, func, PCI_BAR0 + i * 4);
+    }
+}
+
+void pci_init(void) {
+    device_count = 0;
+    for (uint32_t bus = 0; bus < 256; bus++) {
+        for (uint8_t slot = 0; slot < 32; slot++) {
+            uint32_t id = config_read((uint8_t)bus, slot, 0, PCI_VENDOR_ID);
+            if ((id & 0xFFFF) == 0xFFFF) continue;
+
+            uint8_t header = (uint8_t)(config_read((uint8_t)bus, slot, 0, 0x0C) >> 16);
+            uint8_t funcs = (header & 0x80) ? 8 : 1;
+            for (uint8_t func = 0; func < funcs; func++) {
+                probe((uint8_t)bus, slot, func);
+            }
+        }
+    }
+
+    char num[4];
+    int i = 0;
+    uint32_t n = device_count;
+    do {
+        num[i++] = '0' + (n % 10);
+        n /= 10;
+    } while (n > 0);
+    vga_puts("[KERNEL] PCI bus scanned, ");
+    while (i > 0) vga_putchar(num[--i]);
+    vga_puts(" devices\n");
+}
@@ -0,0 +1,151 @@
+/**
+ * ClaudeOS RAM Disk - ramdisk.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Block devices backed by page frames
+ */
+
+#include "types.h"
+#include "ramdisk.h"
+#include "block.h"
+#include "pmm.h"
+#include "kmalloc.h"
+#include "idt.h"
+#include "vga.h"
+#include "../fs/devfs.h"
+
+typedef struct {
+    block_device_t blk;
+    uint32_t* frames;               /* Per 4KB page; 0 until first written */
+    uint32_t pages;
+    uint32_t used;                  /* Frames allocated */
+} ramdisk_t;
+
+static ramdisk_t disks[RAMDISK_MAX];
+static uint32_t disk_count = 0;
+
+static inline void copy(void* dst, const void* src, uint32_t len) {
+    uint32_t words = len >> 2;
+    __asm__ volatile ("cld; rep movsl" : "+D"(dst), "+S"(src), "+c"(words) : : "memory");
+    len &= 3;
+    __asm__ volatile ("rep movsb" : "+D"(dst), "+S"(src), "+c"(len) : : "memory");
+}
+
+static inline void zero(void* dst, uint32_t len) {
+    uint32_t words = len >> 2;
+    __asm__ volatile ("cld; rep stosl" : "+D"(dst), "+c"(words) : "a"(0) : "memory");
+    len &= 3;
+    __asm__ volatile ("rep stosb" : "+D"(dst), "+c"(len) : "a"(0) : "memory");
+}
+
+/* Frame holding a page, allocated (zeroed) on demand if 'alloc' */
+static uint32_t page_frame(ramdisk_t* rd, uint32_t page, bool alloc) {
+    uint32_t irq = irq_save();
+    uint32_t frame = rd->frames[page];
+    if (!frame && alloc) {
+        frame = pmm_alloc_page();
+        if (frame) {
+            pmm_zero_page(frame);
+            rd->frames[page] = frame;
+            rd->used++;
+        }
+    }
+    irq_restore(irq);
+    return frame;
+}
+
+static int ram_submit(block_device_t* dev, request_t* req) {
+    ramdisk_t* rd = (ramdisk_t*)dev->priv;
+    bool write = req->op == BIO_WRITE;
+    int status = 0;
+
+    if (req->op == BIO_FLUSH) {
+        block_complete(req, 0);
+        return 0;
+    }
+
+    uint64_t pos = req->sector << BLOCK_SECTOR_SHIFT;
+    bio_t* bio;
+    bio_seg_t* seg;
+    uint32_t i;
+    REQ_FOR_EACH_SEG(req, seg, bio, i) {
+        for (uint32_t off = 0; off < seg->len; ) {
+            uint32_t in = (uint32_t)pos & (PAGE_SIZE - 1);
+            uint32_t chunk = PAGE_SIZE - in;
+            if (chunk > seg->len - off) chunk = seg->len - off;
+
+            uint8_t* mem = (uint8_t*)(seg->addr + off);
+            uint32_t frame = page_frame(rd, (uint32_t)(pos >> PAGE_SHIFT), write);
+            uint8_t* disk = (uint8_t*)(frame + in);
+
+            /* A shared page may be both source and destination */
+            if (write) {
+                if (!frame) status = -1;
+                else if (disk != mem) copy(disk, mem, chunk);
+            } else if (!frame) {
+                zero(mem, chunk);
+            } else if (disk != mem) {
+                copy(mem, disk, chunk);
+            }
+            pos += chunk;
+            off += chunk;
+        }
+    }
+
+    if (status) dev->stats.errors++;
+    block_complete(req, status);
+    return 0;
+}
+
+static int ram_share_page(block_device_t* dev, uint64_t sector, uint32_t* frame) {
+    ramdisk_t* rd = (ramdisk_t*)dev->priv;
+    uint32_t f = page_frame(rd, (uint32_t)(sector >> (PAGE_SHIFT - BLOCK_SECTOR_SHIFT)), true);
+    if (!f) return -1;
+    pmm_ref_page(f);
+    *frame = f;
+    return 0;
+}
+
+static const block_ops_t ram_ops = {
+    .submit     = ram_submit,
+    .share_page = ram_share_page,
+};
+
+block_device_t* ramdisk_create(uint32_t mb) {
+    if (disk_count == RAMDISK_MAX || mb == 0 || mb > RAMDISK_MAX_MB) return NULL;
+
+    ramdisk_t* rd = &disks[disk_count];
+    rd->pages = mb * (0x100000 / PAGE_SIZE);
+    rd->frames = (uint32_t*)kmalloc(rd->pages * sizeof(uint32_t));
+    if (!rd->frames) return NULL;
+    for (uint32_t p = 0; p < rd->pages; p++) {
+        rd->frames[p] = 0;
+    }
+    rd->used = 0;
+
+    block_device_t* blk = &rd->blk;
+    blk->name[0] = 'r';
+    blk->name[1] = 'a';
+    blk->name[2] = 'm';
+    blk->name[3] = (char)('0' + disk_count);
+    blk->sectors = (uint64_t)mb << (20 - BLOCK_SECTOR_SHIFT);
+    blk->max_sectors = 1024;
+    blk->queue_depth = 1;
+    blk->major = DEV_MAJOR_RAM;
+    blk->minor = disk_count;
+    blk->ops = &ram_ops;
+    blk->priv = rd;
+    disk_count++;
+    block_register(blk);
+    return blk;
+}
+
+uint32_t ramdisk_pages_used(block_device_t* dev) {
+    if (!dev || dev->ops != &ram_ops) return 0;
+    return ((ramdisk_t*)dev->priv)->used;
+}
+
+void ramdisk_init(void) {
+    if (ramdisk_create(RAMDISK_DEFAULT_MB)) {
+        vga_puts("[KERNEL] RAM disk ram0 ready\n");
+    }
+}
@@ -23,6 +23,7 @@ static inline uint8_t inb(uint16_t port) {
 /* Timer state */
 static volatile uint64_t timer_ticks = 0;
 static timer_callback_t timer_callback = NULL;
+static timer_callback_t timer_hooks[TIMER_MAX_HOOKS];
 
 /**
  * Timer interrupt handler (IRQ0)
@@ -31,6 +32,13 @@ static timer_callback_t timer_callback = NULL;
 static void timer_handler(void) {
     timer_ticks++;
 
+    /* Hooks first: the main callback may switch to another process */
+    for (int i = 0; i < TIMER_MAX_HOOKS; i++) {
+        if (timer_hooks[i]) {
+            timer_hooks[i](timer_ticks);
+        }
+    }
+
     /* Call registered callback if any */
     if (timer_callback) {
         timer_callback(timer_ticks);
@@ -127,3 +135,16 @@ uint64_t timer_get_uptime_ms(void) {
 void timer_set_callback(timer_callback_t callback) {
     timer_callback = callback;
 }
+
+/**
+ * Add a per-tick hook
+ */
+int timer_add_hook(timer_callback_t hook) {
+    for (int i = 0; i < TIMER_MAX_HOOKS; i++) {
+        if (!timer_hooks[i]) {
+            timer_hooks[i] = hook;
+            return 0;
+        }
+    }
+    return -1;
+}
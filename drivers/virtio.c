@@ -0,0 +1,418 @@
+/**
+ * ClaudeOS Virtio - virtio.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Virtio PCI transport and split virtqueue implementation
+ */
+
+#include "types.h"
+#include "virtio.h"
+#include "pci.h"
+#include "pmm.h"
+#include "paging.h"
+#include "kmalloc.h"
+
+/* I/O helpers */
+static inline void outb(uint16_t port, uint8_t value) {
+    __asm__ volatile ("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outw(uint16_t port, uint16_t value) {
+    __asm__ volatile ("outw %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint16_t inw(uint16_t port) {
+    uint16_t ret;
+    __asm__ volatile ("inw %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outl(uint16_t port, uint32_t value) {
+    __asm__ volatile ("outl %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint32_t inl(uint16_t port) {
+    uint32_t ret;
+    __asm__ volatile ("inl %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+/* Full barrier: our stores must be visible before we read the device's */
+static inline void mb(void) {
+    __asm__ volatile ("lock; addl $0, (%%esp)" : : : "memory");
+}
+
+/* x86 keeps stores (and loads) in order; only the compiler may not */
+static inline void wmb(void) {
+    __asm__ volatile ("" : : : "memory");
+}
+
+#define rmb wmb
+
+/* Modern register windows */
+#define MMIO8(base, off)    (*(volatile uint8_t*)((base) + (off)))
+#define MMIO16(base, off)   (*(volatile uint16_t*)((base) + (off)))
+#define MMIO32(base, off)   (*(volatile uint32_t*)((base) + (off)))
+
+/*
+ * ===========================================================================
+ * Transport
+ * ===========================================================================
+ */
+
+static uint8_t get_status(virtio_dev_t* vdev) {
+    return vdev->modern ? MMIO8(vdev->common, VIRTIO_COM_STATUS)
+                        : inb(vdev->io + VIRTIO_LEG_STATUS);
+}
+
+static void set_status(virtio_dev_t* vdev, uint8_t status) {
+    if (vdev->modern) {
+        MMIO8(vdev->common, VIRTIO_COM_STATUS) = status;
+    } else {
+        outb(vdev->io + VIRTIO_LEG_STATUS, status);
+    }
+}
+
+/* Map the window a modern capability describes */
+static volatile uint8_t* cap_window(pci_device_t* pci, uint8_t cap) {
+    uint8_t bar = pci_read8(pci, cap + 4);
+    uint32_t offset = pci_read32(pci, cap + 8);
+    uint32_t length = pci_read32(pci, cap + 12);
+    if (bar > 5 || pci_bar_is_io(pci, bar)) return NULL;
+
+    uint32_t base = pci_bar_addr(pci, bar);
+    if (!base || paging_map_mmio(base + offset, length) != 0) return NULL;
+    return (volatile uint8_t*)(base + offset);
+}
+
+/* Find the modern capabilities; false if the device has none */
+static bool setup_modern(virtio_dev_t* vdev) {
+    pci_device_t* pci = vdev->pci;
+    uint8_t notify_cap = 0;
+
+    for (uint8_t cap = pci_find_capability(pci, VIRTIO_PCI_CAP_VENDOR, 0); cap;
+         cap = pci_find_capability(pci, VIRTIO_PCI_CAP_VENDOR, cap)) {
+        uint8_t type = pci_read8(pci, cap + 3);
+        volatile uint8_t** slot = NULL;
+        switch (type) {
+            case VIRTIO_PCI_CAP_COMMON: slot = &vdev->common; break;
+            case VIRTIO_PCI_CAP_NOTIFY: slot = &vdev->notify_base; notify_cap = cap; break;
+            case VIRTIO_PCI_CAP_ISR:    slot = &vdev->isr; break;
+            case VIRTIO_PCI_CAP_DEVICE: slot = &vdev->device; break;
+        }
+        /* The first capability of each type is the preferred one */
+        if (slot && !*slot) {
+            *slot = cap_window(pci, cap);
+        }
+    }
+
+    if (!vdev->common || !vdev->notify_base || !vdev->isr) return false;
+    vdev->notify_mult = pci_read32(pci, notify_cap + 16);
+    return true;
+}
+
+pci_device_t* virtio_find(uint16_t type, pci_device_t* prev) {
+    pci_device_t* pci = prev;
+    while ((pci = pci_find_id(VIRTIO_PCI_VENDOR, 0xFFFF, pci)) != NULL) {
+        if (pci->device == VIRTIO_PCI_MODERN_BASE + type) return pci;
+        if (pci->device >= VIRTIO_PCI_LEGACY_BASE && pci->device < VIRTIO_PCI_MODERN_BASE &&
+            pci_read16(pci, PCI_SUBSYSTEM_ID) == type) {
+            return pci;
+        }
+    }
+    return NULL;
+}
+
+int virtio_probe(pci_device_t* pci, virtio_dev_t* vdev) {
+    for (uint32_t i = 0; i < sizeof(*vdev); i++) {
+        ((uint8_t*)vdev)[i] = 0;
+    }
+    vdev->pci = pci;
+    pci_enable(pci);
+
+    /* Prefer the modern interface; transitional devices offer both */
+    if (setup_modern(vdev)) {
+        vdev->modern = true;
+    } else if (pci->device < VIRTIO_PCI_MODERN_BASE && pci_bar_is_io(pci, 0)) {
+        vdev->io = (uint16_t)pci_bar_addr(pci, 0);
+    } else {
+        return -1;
+    }
+
+    set_status(vdev, 0);
+    set_status(vdev, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER);
+    return 0;
+}
+
+int virtio_negotiate(virtio_dev_t* vdev, uint64_t wanted) {
+    if (!vdev->modern) {
+        uint32_t offered = inl(vdev->io + VIRTIO_LEG_HOST_FEATURES);
+        vdev->features = offered & (uint32_t)wanted;
+        outl(vdev->io + VIRTIO_LEG_GUEST_FEATURES, (uint32_t)vdev->features);
+        return 0;
+    }
+
+    MMIO32(vdev->common, VIRTIO_COM_DFSELECT) = 0;
+    uint64_t offered = MMIO32(vdev->common, VIRTIO_COM_DF);
+    MMIO32(vdev->common, VIRTIO_COM_DFSELECT) = 1;
+    offered |= (uint64_t)MMIO32(vdev->common, VIRTIO_COM_DF) << 32;
+
+    vdev->features = offered & (wanted | (1ULL << VIRTIO_F_VERSION_1));
+    if (!virtio_has(vdev, VIRTIO_F_VERSION_1)) return -1;
+
+    MMIO32(vdev->common, VIRTIO_COM_GFSELECT) = 0;
+    MMIO32(vdev->common, VIRTIO_COM_GF) = (uint32_t)vdev->features;
+    MMIO32(vdev->common, VIRTIO_COM_GFSELECT) = 1;
+    MMIO32(vdev->common, VIRTIO_COM_GF) = (uint32_t)(vdev->features >> 32);
+
+    set_status(vdev, get_status(vdev) | VIRTIO_STATUS_FEATURES_OK);
+    if (!(get_status(vdev) & VIRTIO_STATUS_FEATURES_OK)) {
+        set_status(vdev, VIRTIO_STATUS_FAILED);
+        return -1;
+    }
+    return 0;
+}
+
+uint8_t virtio_config8(virtio_dev_t* vdev, uint32_t offset) {
+    return vdev->modern ? MMIO8(vdev->device, offset)
+                        : inb(vdev->io + VIRTIO_LEG_CONFIG + offset);
+}
+
+uint16_t virtio_config16(virtio_dev_t* vdev, uint32_t offset) {
+    return vdev->modern ? MMIO16(vdev->device, offset)
+                        : inw(vdev->io + VIRTIO_LEG_CONFIG + offset);
+}
+
+uint32_t virtio_config32(virtio_dev_t* vdev, uint32_t offset) {
+    return vdev->modern ? MMIO32(vdev->device, offset)
+                        : inl(vdev->io + VIRTIO_LEG_CONFIG + offset);
+}
+
+uint64_t virtio_config64(virtio_dev_t* vdev, uint32_t offset) {
+    return (uint64_t)virtio_config32(vdev, offset) |
+           ((uint64_t)virtio_config32(vdev, offset + 4) << 32);
+}
+
+void virtio_ready(virtio_dev_t* vdev) {
+    set_status(vdev, get_status(vdev) | VIRTIO_STATUS_DRIVER_OK);
+}
+
+uint8_t virtio_isr(virtio_dev_t* vdev) {
+    return vdev->modern ? *vdev->isr : inb(vdev->io + VIRTIO_LEG_ISR);
+}
+
+/*
+ * ===========================================================================
+ * Virtqueues
+ * ===========================================================================
+ */
+
+#define ALIGN_PAGE(x)   (((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+/* used_event lives after the avail ring, avail_event after the used ring */
+static volatile uint16_t* used_event(virtq_t* vq) {
+    return (volatile uint16_t*)((uint8_t*)vq->avail + 4 + 2 * vq->size);
+}
+
+static volatile uint16_t* avail_event(virtq_t* vq) {
+    return (volatile uint16_t*)((uint8_t*)vq->used + 4 + 8 * vq->size);
+}
+
+static uint32_t alloc_zeroed(uint32_t bytes) {
+    uint32_t pages = ALIGN_PAGE(bytes) / PAGE_SIZE;
+    uint32_t addr = pmm_alloc_pages(pages);
+    if (addr) {
+        for (uint32_t i = 0; i < pages; i++) {
+            pmm_zero_page(addr + i * PAGE_SIZE);
+        }
+    }
+    return addr;
+}
+
+int virtq_init(virtio_dev_t* vdev, virtq_t* vq, uint16_t index) {
+    uint16_t size;
+    if (vdev->modern) {
+        MMIO16(vdev->common, VIRTIO_COM_Q_SELECT) = index;
+        size = MMIO16(vdev->common, VIRTIO_COM_Q_SIZE);
+        if (size > VIRTQ_MODERN_SIZE) {
+            size = VIRTQ_MODERN_SIZE;
+            MMIO16(vdev->common, VIRTIO_COM_Q_SIZE) = size;
+        }
+    } else {
+        outw(vdev->io + VIRTIO_LEG_QUEUE_SEL, index);
+        size = inw(vdev->io + VIRTIO_LEG_QUEUE_NUM);
+    }
+    if (size == 0 || size > VIRTQ_MAX_SIZE) return -1;
+
+    /* Legacy layout: descriptors and avail ring, then the used ring on a new page */
+    uint32_t avail_off = size * sizeof(virtq_desc_t);
+    uint32_t used_off = ALIGN_PAGE(avail_off + 6 + 2 * size);
+    uint32_t total = used_off + ALIGN_PAGE(6 + 8 * size);
+    uint32_t ring = alloc_zeroed(total);
+    uint32_t tables = alloc_zeroed(VIRTQ_TABLES * VIRTQ_INDIRECT_MAX * sizeof(virtq_desc_t));
+    vq->cookies = (void**)kmalloc(size * sizeof(void*));
+    vq->head_table = (uint8_t*)kmalloc(size);
+    if (!ring || !tables || !vq->cookies || !vq->head_table) return -1;
+
+    vq->vdev = vdev;
+    vq->index = index;
+    vq->size = size;
+    vq->desc = (virtq_desc_t*)ring;
+    vq->avail = (virtq_avail_t*)(ring + avail_off);
+    vq->used = (virtq_used_t*)(ring + used_off);
+    vq->indirect = (virtq_desc_t*)tables;
+    for (uint32_t t = 0; t < VIRTQ_TABLES; t++) {
+        vq->table_free[t] = (uint8_t)t;
+    }
+    vq->tables_free = VIRTQ_TABLES;
+    for (uint16_t i = 0; i < size; i++) {
+        vq->desc[i].next = (uint16_t)(i + 1);
+        vq->head_table[i] = 0xFF;
+        vq->cookies[i] = NULL;
+    }
+    vq->free_head = 0;
+    vq->num_free = size;
+    vq->last_used = 0;
+    vq->kicked_avail = 0;
+    vq->notifies = 0;
+    vq->suppressed = 0;
+
+    if (vdev->modern) {
+        MMIO32(vdev->common, VIRTIO_COM_Q_DESC) = ring;
+        MMIO32(vdev->common, VIRTIO_COM_Q_DESC + 4) = 0;
+        MMIO32(vdev->common, VIRTIO_COM_Q_AVAIL) = ring + avail_off;
+        MMIO32(vdev->common, VIRTIO_COM_Q_AVAIL + 4) = 0;
+        MMIO32(vdev->common, VIRTIO_COM_Q_USED) = ring + used_off;
+        MMIO32(vdev->common, VIRTIO_COM_Q_USED + 4) = 0;
+        uint16_t off = MMIO16(vdev->common, VIRTIO_COM_Q_NOFF);
+        vq->notify = (volatile uint16_t*)(vdev->notify_base + off * vdev->notify_mult);
+        MMIO16(vdev->common, VIRTIO_COM_Q_ENABLE) = 1;
+    } else {
+        outl(vdev->io + VIRTIO_LEG_QUEUE_PFN, ring / PAGE_SIZE);
+    }
+    return 0;
+}
+
+int virtq_add(virtq_t* vq, const virtq_buf_t* bufs, uint32_t count, void* cookie) {
+    if (count == 0) return -1;
+    uint16_t head = vq->free_head;
+
+    if (count > 1 && count <= VIRTQ_INDIRECT_MAX && vq->tables_free > 0 &&
+        virtio_has(vq->vdev, VIRTIO_F_INDIRECT_DESC)) {
+        if (vq->num_free < 1) return -1;
+
+        /* The whole chain goes in a table; the ring holds one descriptor */
+        uint8_t t = vq->table_free[--vq->tables_free];
+        virtq_desc_t* table = &vq->indirect[t * VIRTQ_INDIRECT_MAX];
+        for (uint32_t i = 0; i < count; i++) {
+            table[i].addr = bufs[i].addr;
+            table[i].len = bufs[i].len;
+            table[i].flags = (bufs[i].write ? VIRTQ_DESC_F_WRITE : 0) |
+                             (i + 1 < count ? VIRTQ_DESC_F_NEXT : 0);
+            table[i].next = (uint16_t)(i + 1);
+        }
+
+        vq->free_head = vq->desc[head].next;
+        vq->num_free--;
+        vq->desc[head].addr = (uint32_t)table;
+        vq->desc[head].len = count * sizeof(virtq_desc_t);
+        vq->desc[head].flags = VIRTQ_DESC_F_INDIRECT;
+        vq->head_table[head] = t;
+    } else {
+        if (vq->num_free < count) return -1;
+
+        uint16_t idx = head;
+        uint16_t last = head;
+        for (uint32_t i = 0; i < count; i++) {
+            vq->desc[idx].addr = bufs[i].addr;
+            vq->desc[idx].len = bufs[i].len;
+            vq->desc[idx].flags = (bufs[i].write ? VIRTQ_DESC_F_WRITE : 0) |
+                                  (i + 1 < count ? VIRTQ_DESC_F_NEXT : 0);
+            last = idx;
+            idx = vq->desc[idx].next;
+        }
+        vq->free_head = vq->desc[last].next;
+        vq->num_free -= (uint16_t)count;
+    }
+
+    vq->cookies[head] = cookie;
+    vq->avail->ring[vq->avail->idx % vq->size] = head;
+    wmb();
+    vq->avail->idx++;
+    return 0;
+}
+
+void virtq_kick(virtq_t* vq) {
+    /* Publish avail->idx before sampling what the device asked for */
+    mb();
+    uint16_t new_idx = vq->avail->idx;
+    uint16_t old_idx = vq->kicked_avail;
+    vq->kicked_avail = new_idx;
+    if (new_idx == old_idx) return;
+
+    bool needed;
+    if (virtio_has(vq->vdev, VIRTIO_F_EVENT_IDX)) {
+        /* Kick only if the device's wake-up point lies in what we added */
+        uint16_t event = *avail_event(vq);
+        needed = (uint16_t)(new_idx - event - 1) < (uint16_t)(new_idx - old_idx);
+    } else {
+        needed = !(vq->used->flags & VIRTQ_USED_F_NO_NOTIFY);
+    }
+    if (!needed) {
+        vq->suppressed++;
+        return;
+    }
+
+    vq->notifies++;
+    if (vq->vdev->modern) {
+        *vq->notify = vq->index;
+    } else {
+        outw(vq->vdev->io + VIRTIO_LEG_QUEUE_NOTIFY, vq->index);
+    }
+}
+
+void* virtq_get(virtq_t* vq, uint32_t* len) {
+    if (vq->last_used == *(volatile uint16_t*)&vq->used->idx) return NULL;
+    rmb();
+
+    virtq_used_elem_t* elem = &vq->used->ring[vq->last_used % vq->size];
+    uint16_t head = (uint16_t)elem->id;
+    if (len) *len = elem->len;
+    vq->last_used++;
+
+    void* cookie = vq->cookies[head];
+    vq->cookies[head] = NULL;
+
+    /* Return the chain to the free list */
+    uint16_t last = head;
+    uint16_t n = 1;
+    if (vq->head_table[head] != 0xFF) {
+        vq->table_free[vq->tables_free++] = vq->head_table[head];
+        vq->head_table[head] = 0xFF;
+    } else {
+        while (vq->desc[last].flags & VIRTQ_DESC_F_NEXT) {
+            last = vq->desc[last].next;
+            n++;
+        }
+    }
+    vq->desc[last].next = vq->free_head;
+    vq->free_head = head;
+    vq->num_free += n;
+    return cookie;
+}
+
+bool virtq_enable_irq(virtq_t* vq) {
+    if (virtio_has(vq->vdev, VIRTIO_F_EVENT_IDX)) {
+        /* Interrupt on the next completion after what we have seen */
+        *used_event(vq) = vq->last_used;
+    } else {
+        vq->avail->flags &= ~VIRTQ_AVAIL_F_NO_INTERRUPT;
+    }
+    mb();
+    return vq->last_used != *(volatile uint16_t*)&vq->used->idx;
+}
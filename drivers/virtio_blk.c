@@ -0,0 +1,307 @@
+/**
+ * ClaudeOS Virtio Block Driver - virtio_blk.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: virtio-blk disks (vda, vdb...) under the block layer
+ *
+ * Each request becomes one descriptor chain: a header the device reads,
+ * the data segments, and a status byte it writes. With indirect
+ * descriptors a chain takes a single ring slot, so a queue keeps up to
+ * VIRTQ_TABLES requests in flight. Requests are spread over the
+ * device's queues (VIRTIO_BLK_F_MQ), the doorbell is rung once per
+ * dispatch pass, and with EVENT_IDX both the doorbell and the
+ * completion interrupt are skipped while the other side is busy, so a
+ * deep queue costs far less than one exit and one interrupt per I/O.
+ */
+
+#include "types.h"
+#include "virtio.h"
+#include "block.h"
+#include "pmm.h"
+#include "idt.h"
+#include "vga.h"
+#include "../fs/devfs.h"
+
+/* Feature bits */
+#define VIRTIO_BLK_F_SIZE_MAX   1
+#define VIRTIO_BLK_F_SEG_MAX    2
+#define VIRTIO_BLK_F_RO         5
+#define VIRTIO_BLK_F_FLUSH      9
+#define VIRTIO_BLK_F_MQ         12
+
+/* Configuration space */
+#define VIRTIO_BLK_CFG_CAPACITY 0
+#define VIRTIO_BLK_CFG_SIZE_MAX 8
+#define VIRTIO_BLK_CFG_SEG_MAX  12
+#define VIRTIO_BLK_CFG_NUM_QUEUES 34
+
+/* Request types and status */
+#define VIRTIO_BLK_T_IN         0
+#define VIRTIO_BLK_T_OUT        1
+#define VIRTIO_BLK_T_FLUSH      4
+#define VIRTIO_BLK_S_OK         0
+
+#define VBLK_MAX_DEVICES        4
+#define VBLK_MAX_QUEUES         4
+#define VBLK_SLOTS              VIRTQ_TABLES    /* Requests in flight per queue */
+
+/* What the device reads first and writes last */
+typedef struct {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed)) vblk_hdr_t;
+
+typedef struct {
+    vblk_hdr_t hdr;
+    volatile uint8_t status;
+    request_t* req;
+} vblk_slot_t;
+
+typedef struct {
+    virtq_t vq;
+    vblk_slot_t* slots;             /* VBLK_SLOTS, in DMA-able memory */
+    uint8_t free[VBLK_SLOTS];
+    uint32_t nfree;
+    bool added;                     /* Chains added since the last kick */
+} vblk_queue_t;
+
+typedef struct {
+    block_device_t blk;
+    virtio_dev_t vdev;
+    vblk_queue_t queues[VBLK_MAX_QUEUES];
+    uint32_t nqueues;
+    uint32_t next_queue;
+    uint32_t size_max;              /* Largest segment the device takes */
+} vblk_t;
+
+static vblk_t disks[VBLK_MAX_DEVICES];
+static uint32_t disk_count = 0;
+
+/*
+ * ===========================================================================
+ * Requests
+ * ===========================================================================
+ */
+
+static int vblk_submit(block_device_t* dev, request_t* req) {
+    vblk_t* vb = (vblk_t*)dev->priv;
+    virtq_buf_t bufs[VIRTQ_INDIRECT_MAX];
+    uint32_t n = 1;
+
+    /* Header, data (split to the device's segment limit), status */
+    bio_t* bio;
+    bio_seg_t* seg;
+    uint32_t i;
+    REQ_FOR_EACH_SEG(req, seg, bio, i) {
+        for (uint32_t off = 0; off < seg->len; n++) {
+            uint32_t len = seg->len - off;
+            if (len > vb->size_max) len = vb->size_max;
+            if (n + 1 >= VIRTQ_INDIRECT_MAX) {
+                block_complete(req, -1);
+                return 0;
+            }
+            bufs[n].addr = seg->addr + off;
+            bufs[n].len = len;
+            bufs[n].write = req->op == BIO_READ;
+            off += len;
+        }
+    }
+
+    uint32_t irq = irq_save();
+
+    /* Round-robin over the queues, skipping full ones */
+    vblk_queue_t* q = NULL;
+    for (uint32_t tries = 0; tries < vb->nqueues; tries++) {
+        vblk_queue_t* cand = &vb->queues[vb->next_queue];
+        vb->next_queue = (vb->next_queue + 1) % vb->nqueues;
+        if (cand->nfree > 0) {
+            q = cand;
+            break;
+        }
+    }
+    if (!q) {
+        irq_restore(irq);
+        return -1;
+    }
+
+    uint8_t s = q->free[--q->nfree];
+    vblk_slot_t* slot = &q->slots[s];
+    slot->hdr.type = req->op == BIO_READ ? VIRTIO_BLK_T_IN
+                   : req->op == BIO_WRITE ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_FLUSH;
+    slot->hdr.reserved = 0;
+    slot->hdr.sector = req->op == BIO_FLUSH ? 0 : req->sector;
+    slot->status = 0xFF;
+    slot->req = req;
+
+    bufs[0].addr = (uint32_t)&slot->hdr;
+    bufs[0].len = sizeof(vblk_hdr_t);
+    bufs[0].write = false;
+    bufs[n].addr = (uint32_t)&slot->status;
+    bufs[n].len = 1;
+    bufs[n].write = true;
+
+    if (virtq_add(&q->vq, bufs, n + 1, slot) != 0) {
+        q->free[q->nfree++] = s;
+        irq_restore(irq);
+        return -1;
+    }
+    q->added = true;
+    irq_restore(irq);
+    return 0;
+}
+
+/* One doorbell per queue for the whole dispatch pass */
+static void vblk_commit(block_device_t* dev) {
+    vblk_t* vb = (vblk_t*)dev->priv;
+    uint32_t irq = irq_save();
+    for (uint32_t i = 0; i < vb->nqueues; i++) {
+        vblk_queue_t* q = &vb->queues[i];
+        if (q->added) {
+            q->added = false;
+            virtq_kick(&q->vq);
+        }
+    }
+    irq_restore(irq);
+}
+
+/* Complete everything the device has finished. Interrupts off. */
+static uint32_t vblk_reap(vblk_t* vb) {
+    uint32_t done = 0;
+    for (uint32_t i = 0; i < vb->nqueues; i++) {
+        vblk_queue_t* q = &vb->queues[i];
+        do {
+            vblk_slot_t* slot;
+            while ((slot = (vblk_slot_t*)virtq_get(&q->vq, NULL)) != NULL) {
+                request_t* req = slot->req;
+                int status = slot->status == VIRTIO_BLK_S_OK ? 0 : -1;
+                slot->req = NULL;
+                q->free[q->nfree++] = (uint8_t)(slot - q->slots);
+                done++;
+                block_complete(req, status);
+            }
+        } while (virtq_enable_irq(&q->vq));
+    }
+    return done;
+}
+
+static void vblk_irq(void) {
+    for (uint32_t d = 0; d < disk_count; d++) {
+        vblk_t* vb = &disks[d];
+        if (!(virtio_isr(&vb->vdev) & 1)) continue;  /* Reading acknowledges */
+        if (vblk_reap(vb) > 0) {
+            vb->blk.stats.irqs++;
+        }
+    }
+}
+
+static void vblk_poll(block_device_t* dev) {
+    uint32_t irq = irq_save();
+    vblk_reap((vblk_t*)dev->priv);
+    irq_restore(irq);
+}
+
+static const block_ops_t vblk_ops = {
+    .submit = vblk_submit,
+    .poll   = vblk_poll,
+    .commit = vblk_commit,
+};
+
+/*
+ * ===========================================================================
+ * Probing
+ * ===========================================================================
+ */
+
+static int setup_disk(vblk_t* vb) {
+    virtio_dev_t* vdev = &vb->vdev;
+    uint64_t wanted = (1ULL << VIRTIO_BLK_F_SIZE_MAX) | (1ULL << VIRTIO_BLK_F_SEG_MAX) |
+                      (1ULL << VIRTIO_BLK_F_FLUSH) | (1ULL << VIRTIO_BLK_F_MQ) |
+                      (1ULL << VIRTIO_F_INDIRECT_DESC) | (1ULL << VIRTIO_F_EVENT_IDX);
+    if (virtio_negotiate(vdev, wanted) != 0) return -1;
+
+    vb->nqueues = 1;
+    if (virtio_has(vdev, VIRTIO_BLK_F_MQ)) {
+        uint16_t n = virtio_config16(vdev, VIRTIO_BLK_CFG_NUM_QUEUES);
+        vb->nqueues = n < 1 ? 1 : n > VBLK_MAX_QUEUES ? VBLK_MAX_QUEUES : n;
+    }
+    vb->size_max = virtio_has(vdev, VIRTIO_BLK_F_SIZE_MAX)
+                 ? virtio_config32(vdev, VIRTIO_BLK_CFG_SIZE_MAX) : 0;
+    if (vb->size_max < BLOCK_SECTOR_SIZE) vb->size_max = 0x400000;
+    vb->size_max &= ~(BLOCK_SECTOR_SIZE - 1);
+
+    uint32_t max_segs = VIRTQ_INDIRECT_MAX - 2;
+    if (virtio_has(vdev, VIRTIO_BLK_F_SEG_MAX)) {
+        uint32_t seg_max = virtio_config32(vdev, VIRTIO_BLK_CFG_SEG_MAX);
+        if (seg_max && seg_max < max_segs) max_segs = seg_max;
+    }
+
+    uint32_t slot_bytes = VBLK_SLOTS * sizeof(vblk_slot_t);
+    for (uint32_t i = 0; i < vb->nqueues; i++) {
+        vblk_queue_t* q = &vb->queues[i];
+        if (virtq_init(vdev, &q->vq, (uint16_t)i) != 0) {
+            if (i == 0) return -1;
+            vb->nqueues = i;
+            break;
+        }
+        q->slots = (vblk_slot_t*)pmm_alloc_pages((slot_bytes + PAGE_SIZE - 1) / PAGE_SIZE);
+        if (!q->slots) return -1;
+        for (uint32_t s = 0; s < VBLK_SLOTS; s++) {
+            q->free[s] = (uint8_t)s;
+        }
+        q->nfree = VBLK_SLOTS;
+        q->added = false;
+    }
+
+    block_device_t* blk = &vb->blk;
+    blk->name[0] = 'v';
+    blk->name[1] = 'd';
+    blk->name[2] = (char)('a' + disk_count);
+    blk->sectors = virtio_config64(vdev, VIRTIO_BLK_CFG_CAPACITY);
+    blk->max_segs = max_segs;
+    blk->max_sectors = 1024;
+    blk->queue_depth = vb->nqueues * VBLK_SLOTS;
+    blk->major = DEV_MAJOR_VIRTIO;
+    blk->minor = disk_count * 16;
+    blk->ops = &vblk_ops;
+    blk->priv = vb;
+
+    virtio_ready(vdev);
+    return 0;
+}
+
+static void print_dec(uint32_t n) {
+    char buf[12];
+    int i = 0;
+    do {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    } while (n > 0);
+    while (i > 0) vga_putchar(buf[--i]);
+}
+
+void virtio_blk_init(void) {
+    for (pci_device_t* pci = virtio_find(VIRTIO_ID_BLOCK, NULL);
+         pci && disk_count < VBLK_MAX_DEVICES; pci = virtio_find(VIRTIO_ID_BLOCK, pci)) {
+        vblk_t* vb = &disks[disk_count];
+        if (virtio_probe(pci, &vb->vdev) != 0 || setup_disk(vb) != 0) {
+            continue;
+        }
+
+        /* INTx, shared by all our disks */
+        if (pci->irq < 16) {
+            register_interrupt_handler(IRQ_BASE + pci->irq, vblk_irq);
+        }
+        disk_count++;
+        block_register(&vb->blk);
+
+        vga_puts("[KERNEL] virtio-blk ");
+        vga_puts(vb->blk.name);
+        vga_puts(": ");
+        print_dec((uint32_t)(vb->blk.sectors / 2048));
+        vga_puts(" MB, ");
+        print_dec(vb->nqueues);
+        vga_puts(vb->vdev.modern ? " queue(s), modern" : " queue(s), legacy");
+        vga_puts(virtio_has(&vb->vdev, VIRTIO_F_INDIRECT_DESC) ? ", indirect" : "");
+        vga_puts(virtio_has(&vb->vdev, VIRTIO_F_EVENT_IDX) ? ", event-idx\n" : "\n");
+    }
+}
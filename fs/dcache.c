@@ -0,0 +1,195 @@
+/*
+ * ClaudeOS Dentry Cache - Implementation
+ * Worker1 - Shell+FS Claude
+ *
+ * A fixed pool of entries chained into hash buckets. The bucket is
+ * picked from the parent node's address mixed with an FNV-1a hash of
+ * the name, and the full name hash is kept in the entry so most
+ * mismatches are rejected without a string compare.
+ *
+ * When the pool is full, a clock sweep evicts an entry that has not
+ * been hit since the hand last passed it. dcache_flush() just bumps a
+ * generation number: entries from older generations read as misses
+ * and are reused first.
+ */
+
+#include "dcache.h"
+#include "names.h"
+#include "../include/idt.h"
+
+typedef struct dentry {
+    fs_node_t *parent;
+    fs_node_t *node;            /* NULL for a negative entry */
+    uint32_t hash;              /* FNV-1a of name */
+    uint32_t gen;               /* Valid while == dcache_gen */
+    int referenced;             /* Clock bit */
+    struct dentry *next;        /* Hash chain */
+    char name[FS_NAME_MAX];
+} dentry_t;
+
+static dentry_t dentries[DCACHE_SIZE];
+static dentry_t *buckets[DCACHE_BUCKETS];
+static uint32_t dcache_gen = 1;
+static uint32_t clock_hand = 0;
+static dcache_stats_t stats;
+
+static int name_eq(const char *a, const char *b) {
+    while (*a && *a == *b) { a++; b++; }
+    return *a == *b;
+}
+
+static uint32_t bucket_of(fs_node_t *parent, uint32_t hash) {
+    uint32_t h = hash ^ ((uint32_t)parent * 2654435761u);
+    return (h * 2654435761u) >> (32 - DCACHE_HASH_BITS);
+}
+
+/* Find the entry for a key, valid or stale (interrupts disabled) */
+static dentry_t *find(fs_node_t *parent, const char *name, uint32_t hash) {
+    for (dentry_t *d = buckets[bucket_of(parent, hash)]; d; d = d->next) {
+        if (d->parent == parent && d->hash == hash && name_eq(d->name, name)) {
+            return d;
+        }
+    }
+    return NULL;
+}
+
+static void unhash(dentry_t *d) {
+    dentry_t **link = &buckets[bucket_of(d->parent, d->hash)];
+    while (*link && *link != d) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = d->next;
+    }
+    d->parent = NULL;
+    d->gen = 0;
+}
+
+/* Pick a slot to reuse: unused or stale first, else clock sweep */
+static dentry_t *evict(void) {
+    for (uint32_t scanned = 0; scanned < 2 * DCACHE_SIZE; scanned++) {
+        dentry_t *d = &dentries[clock_hand];
+        clock_hand = (clock_hand + 1) % DCACHE_SIZE;
+
+        if (!d->parent) {
+            return d;
+        }
+        if (d->gen != dcache_gen || !d->referenced) {
+            if (d->gen == dcache_gen) {
+                stats.evictions++;
+            }
+            unhash(d);
+            return d;
+        }
+        d->referenced = 0;
+    }
+
+    /* Every entry was hit during two full sweeps: take the next one */
+    dentry_t *d = &dentries[clock_hand];
+    clock_hand = (clock_hand + 1) % DCACHE_SIZE;
+    stats.evictions++;
+    unhash(d);
+    return d;
+}
+
+void dcache_init(void) {
+    for (int i = 0; i < DCACHE_SIZE; i++) {
+        dentries[i].parent = NULL;
+        dentries[i].gen = 0;
+        dentries[i].next = NULL;
+    }
+    for (int i = 0; i < DCACHE_BUCKETS; i++) {
+        buckets[i] = NULL;
+    }
+    dcache_gen = 1;
+    clock_hand = 0;
+    stats.hits = stats.negative_hits = stats.misses = stats.evictions = 0;
+}
+
+int dcache_lookup(fs_node_t *parent, const char *name, fs_node_t **node) {
+    uint32_t hash = name_hash(name);
+    uint32_t irq = irq_save();
+
+    dentry_t *d = find(parent, name, hash);
+    if (!d || d->gen != dcache_gen) {
+        stats.misses++;
+        irq_restore(irq);
+        return 0;
+    }
+
+    d->referenced = 1;
+    *node = d->node;
+    if (d->node) {
+        stats.hits++;
+    } else {
+        stats.negative_hits++;
+    }
+    irq_restore(irq);
+    return 1;
+}
+
+void dcache_insert(fs_node_t *parent, const char *name, fs_node_t *node) {
+    if (!parent || !name) return;
+
+    uint32_t hash = name_hash(name);
+    uint32_t irq = irq_save();
+
+    dentry_t *d = find(parent, name, hash);
+    if (!d) {
+        d = evict();
+        d->parent = parent;
+        d->hash = hash;
+        int i = 0;
+        while (name[i] && i < FS_NAME_MAX - 1) {
+            d->name[i] = name[i];
+            i++;
+        }
+        d->name[i] = '\0';
+
+        uint32_t b = bucket_of(parent, hash);
+        d->next = buckets[b];
+        buckets[b] = d;
+    }
+
+    d->node = node;
+    d->gen = dcache_gen;
+    d->referenced = 1;
+    irq_restore(irq);
+}
+
+void dcache_invalidate(fs_node_t *parent, const char *name) {
+    if (!parent || !name) return;
+
+    uint32_t irq = irq_save();
+    dentry_t *d = find(parent, name, name_hash(name));
+    if (d) {
+        unhash(d);
+    }
+    irq_restore(irq);
+}
+
+void dcache_invalidate_node(fs_node_t *node) {
+    if (!node) return;
+
+    uint32_t irq = irq_save();
+    for (int i = 0; i < DCACHE_SIZE; i++) {
+        dentry_t *d = &dentries[i];
+        if (d->parent && (d->parent == node || d->node == node)) {
+            unhash(d);
+        }
+    }
+    irq_restore(irq);
+}
+
+void dcache_flush(void) {
+    uint32_t irq = irq_save();
+    dcache_gen++;
+    irq_restore(irq);
+}
+
+void dcache_get_stats(dcache_stats_t *out) {
+    if (!out) return;
+    uint32_t irq = irq_save();
+    *out = stats;
+    irq_restore(irq);
+}
@@ -0,0 +1,55 @@
+/*
+ * ClaudeOS Dentry Cache - Header
+ * Worker1 - Shell+FS Claude
+ *
+ * Caches the result of looking up one path component in a directory,
+ * keyed on (parent node, name). Lookups that found nothing are cached
+ * too (negative entries), so repeated probes for a missing name skip
+ * the directory scan as well.
+ *
+ * Whoever adds or removes a directory entry must invalidate it here.
+ */
+
+#ifndef CLAUDEOS_DCACHE_H
+#define CLAUDEOS_DCACHE_H
+
+#include "vfs.h"
+
+/* Cache geometry */
+#define DCACHE_SIZE       256   /* Entries */
+#define DCACHE_HASH_BITS  7
+#define DCACHE_BUCKETS    (1 << DCACHE_HASH_BITS)
+
+/* Counters (for the lookup benchmark) */
+typedef struct {
+    uint32_t hits;
+    uint32_t negative_hits;
+    uint32_t misses;
+    uint32_t evictions;
+} dcache_stats_t;
+
+/* Initialize an empty cache */
+void dcache_init(void);
+
+/*
+ * Look up 'name' in 'parent'.
+ * Returns 1 on a hit with *node set (NULL for a negative entry), or 0
+ * if the cache knows nothing about the name.
+ */
+int dcache_lookup(fs_node_t *parent, const char *name, fs_node_t **node);
+
+/* Record the result of a directory scan (node may be NULL) */
+void dcache_insert(fs_node_t *parent, const char *name, fs_node_t *node);
+
+/* Forget one name (after it is created or removed) */
+void dcache_invalidate(fs_node_t *parent, const char *name);
+
+/* Forget every entry that names 'node' or looks inside it */
+void dcache_invalidate_node(fs_node_t *node);
+
+/* Forget everything */
+void dcache_flush(void);
+
+void dcache_get_stats(dcache_stats_t *stats);
+
+#endif /* CLAUDEOS_DCACHE_H */
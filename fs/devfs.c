@@ -0,0 +1,152 @@
+/*
+ * ClaudeOS Device Files
+ * Worker1 - Shell+FS Claude
+ *
+ * Device nodes, served as the "devfs" filesystem type and mounted at
+ * /dev. Each device is an fs_node_t whose ops talk to the driver
+ * directly.
+ *
+ *   /dev/kbd - keyboard input (blocking read, pollable)
+ *   /dev/hda, /dev/ram0, ... - block devices (see block.h)
+ */
+
+#include "devfs.h"
+#include "mount.h"
+#include "../include/keyboard.h"
+#include "../include/poll.h"
+#include "../include/idt.h"
+
+#define DEV_MINOR_KBD       0
+
+typedef struct {
+    const char *name;
+    uint8_t type;
+    fs_ops_t *ops;
+    uint32_t major;
+    uint32_t minor;
+    uint32_t size;
+    void *data;
+} devfs_entry_t;
+
+static devfs_entry_t devices[DEVFS_MAX_DEVICES];
+static int device_count = 0;
+
+/* Roots of the mounted instances */
+static fs_node_t *roots[MAX_MOUNTS];
+
+/*
+ * ===========================================================================
+ * /dev/kbd
+ * ===========================================================================
+ */
+
+/* Block for the first character, then take whatever else is buffered */
+static ssize_t kbd_read(fs_node_t *node, void *buf, size_t size, size_t offset) {
+    (void)node; (void)offset;
+    char *dst = (char *)buf;
+    size_t n = 0;
+
+    if (size == 0) return 0;
+
+    dst[n++] = keyboard_getchar();
+    while (n < size && keyboard_haschar()) {
+        dst[n++] = keyboard_getchar();
+    }
+    return (ssize_t)n;
+}
+
+static uint32_t kbd_poll(fs_node_t *node, struct poll_table *pt) {
+    (void)node;
+    poll_wait(pt, keyboard_wait_queue());
+    return keyboard_haschar() ? POLLIN : 0;
+}
+
+static fs_ops_t kbd_ops = {
+    .read = kbd_read,
+    .poll = kbd_poll,
+};
+
+/*
+ * ===========================================================================
+ * Registry
+ * ===========================================================================
+ */
+
+static void make_node(fs_node_t *root, devfs_entry_t *e) {
+    fs_node_t *node = vfs_create_device(root, e->name, e->ops, e->major, e->minor);
+    if (node) {
+        node->type = e->type;
+        node->size = e->size;
+        node->data = e->data;
+    }
+}
+
+int devfs_register(const char *name, uint8_t type, fs_ops_t *ops,
+                   uint32_t major, uint32_t minor, uint32_t size, void *data) {
+    uint32_t irq = irq_save();
+    if (device_count == DEVFS_MAX_DEVICES) {
+        irq_restore(irq);
+        return -1;
+    }
+    devfs_entry_t *e = &devices[device_count++];
+    irq_restore(irq);
+
+    e->name = name;
+    e->type = type;
+    e->ops = ops;
+    e->major = major;
+    e->minor = minor;
+    e->size = size;
+    e->data = data;
+
+    for (int i = 0; i < MAX_MOUNTS; i++) {
+        if (roots[i]) {
+            make_node(roots[i], e);
+        }
+    }
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Initialization
+ * ===========================================================================
+ */
+
+/* Every instance holds the full set of devices */
+static int devfs_mount(superblock_t *sb, const char *source) {
+    (void)source;
+    int slot = 0;
+    while (slot < MAX_MOUNTS && roots[slot]) slot++;
+    if (slot == MAX_MOUNTS) return -1;
+
+    fs_node_t *dev = vfs_create_dir(NULL, "dev");
+    if (!dev) return -1;
+    dev->parent = dev;
+
+    for (int i = 0; i < device_count; i++) {
+        make_node(dev, &devices[i]);
+    }
+    roots[slot] = dev;
+    sb->root = dev;
+    return 0;
+}
+
+static void devfs_unmount(superblock_t *sb) {
+    for (int i = 0; i < MAX_MOUNTS; i++) {
+        if (roots[i] == sb->root) {
+            roots[i] = NULL;
+        }
+    }
+}
+
+static fs_type_t devfs_type = {
+    .name    = "devfs",
+    .mount   = devfs_mount,
+    .unmount = devfs_unmount,
+};
+
+void devfs_init(void) {
+    vfs_register_fs(&devfs_type);
+    devfs_register("kbd", FS_CHARDEV, &kbd_ops, DEV_MAJOR_INPUT, DEV_MINOR_KBD, 0, NULL);
+}
@@ -0,0 +1,35 @@
+/*
+ * ClaudeOS Device Files - Header
+ * Worker1 - Shell+FS Claude
+ *
+ * Drivers publish devices here; every mounted devfs instance shows one
+ * node per registered device, including devices registered after it
+ * was mounted.
+ */
+
+#ifndef CLAUDEOS_DEVFS_H
+#define CLAUDEOS_DEVFS_H
+
+#include "vfs.h"
+
+#define DEVFS_MAX_DEVICES   32
+
+/* Device numbers */
+#define DEV_MAJOR_RAM       1
+#define DEV_MAJOR_IDE0      3
+#define DEV_MAJOR_SCSI      8
+#define DEV_MAJOR_INPUT     13
+#define DEV_MAJOR_VIRTIO    254
+#define DEV_MAJOR_NVME      259
+
+/*
+ * Publish a device: 'type' is FS_CHARDEV or FS_BLOCKDEV, and 'data'
+ * becomes node->data of every node made for it. Returns 0 or -1.
+ */
+int devfs_register(const char *name, uint8_t type, fs_ops_t *ops,
+                   uint32_t major, uint32_t minor, uint32_t size, void *data);
+
+/* Register the "devfs" filesystem type and the built-in devices */
+void devfs_init(void);
+
+#endif /* CLAUDEOS_DEVFS_H */
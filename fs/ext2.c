@@ -0,0 +1,1647 @@
+/*
+ * ClaudeOS ext2 Filesystem - Implementation
+ * Worker1 - Shell+FS Claude
+ *
+ * Mounts an ext2 filesystem from a block device, read-write:
+ *
+ *   mount ext2 /dev/ram0 /mnt
+ *
+ * File data goes through the page cache (readpage/writepage). A page
+ * is read with one request per run of contiguous blocks, so a file
+ * laid out in order reads at close to the speed of the raw device;
+ * write-back of adjacent dirty pages (writepages) is plugged and merges
+ * into requests of many pages. With
+ * 4KB blocks on a memory-backed device the cache borrows the device's
+ * own frames (sharepage) and reading costs no copy at all.
+ *
+ * Metadata (bitmaps, inode tables, directories, indirect blocks) lives
+ * in a small per-mount buffer cache. Every operation writes back what
+ * it dirtied before it returns, data first, so the disk is consistent
+ * between operations; only the superblock's free counts wait for
+ * unmount, as on Linux, which rebuilds them from the group descriptors.
+ *
+ * Allocation keeps files together: a file's inode goes in its
+ * directory's group, its first block in the inode's group, and each
+ * further block right after the previous one. New directories spread
+ * out to the emptier groups.
+ *
+ * Directories are read in full the first time they are looked at and
+ * their nodes stay in memory until unmount, so a node is never looked
+ * up twice. Names past FS_NAME_MAX - 1 characters cannot be reached.
+ * A hard link made on the host appears as separate nodes per name, each
+ * with its own copy of the inode, so such a file is read-only here:
+ * writing through one name would undo what the other wrote. Removing a
+ * name takes the link count from the disk, not from that copy.
+ */
+
+#include "vfs.h"
+#include "dcache.h"
+#include "mount.h"
+#include "names.h"
+#include "pagecache.h"
+#include "ext2.h"
+#include "../include/block.h"
+#include "../include/pmm.h"
+#include "../include/slab.h"
+#include "../include/process.h"
+#include "../include/timer.h"
+#include "../include/idt.h"
+
+#define EXT2_BUFS       32      /* Metadata blocks cached per mount */
+#define EXT2_DIR_INLINE 8       /* Children before the array moves to pages */
+
+/* Features this driver reads and writes */
+#define EXT2_INCOMPAT_SUPP  EXT2_FEATURE_INCOMPAT_FILETYPE
+#define EXT2_RO_COMPAT_SUPP (EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER | \
+                             EXT2_FEATURE_RO_COMPAT_LARGE_FILE)
+
+static void mem_zero(void *dst, uint32_t n) {
+    char *d = (char *)dst;
+    while (n--) *d++ = 0;
+}
+
+static void mem_copy(void *dst, const void *src, uint32_t n) {
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    while (n--) *d++ = *s++;
+}
+
+static int mem_eq(const char *a, const char *b, uint32_t n) {
+    while (n--) {
+        if (*a++ != *b++) return 0;
+    }
+    return 1;
+}
+
+static uint32_t str_len(const char *s) {
+    uint32_t len = 0;
+    while (s[len]) len++;
+    return len;
+}
+
+static int str_eq(const char *a, const char *b) {
+    while (*a && *a == *b) { a++; b++; }
+    return *a == *b;
+}
+
+static uint32_t pages_for(uint32_t bytes) {
+    return PAGE_ALIGN(bytes) >> PAGE_SHIFT;
+}
+
+/*
+ * ===========================================================================
+ * Mount State
+ * ===========================================================================
+ */
+
+/* One cached metadata block */
+typedef struct {
+    uint32_t block;
+    uint32_t pins;              /* Users inside the current operation */
+    bool valid;
+    bool dirty;
+    bool referenced;            /* Second chance for the clock */
+    uint8_t *data;              /* One page frame */
+} ext2_buf_t;
+
+typedef struct {
+    block_device_t *dev;
+    ext2_super_t *sb;           /* In its own page frame */
+    ext2_group_desc_t *gd;      /* The whole descriptor table */
+    uint32_t gd_blocks;
+    uint32_t bs;                /* Block size */
+    uint32_t spb;               /* Sectors per block */
+    uint32_t ppb;               /* Block pointers per block */
+    uint32_t groups;
+    uint32_t inode_size;
+    uint32_t first_ino;
+    bool readonly;              /* Unknown ro_compat features */
+    bool share;                 /* Page-sized blocks on a device that lends frames */
+    bool gd_dirty;
+    uint32_t busy;              /* An operation is running */
+    wait_queue_t wait;
+    ext2_buf_t bufs[EXT2_BUFS];
+    uint32_t clock;
+    uint8_t *scratch;           /* One block for partial-block updates */
+    uint32_t epoch;             /* Time of the last superblock write */
+    fs_node_t *root;
+} ext2_fs_t;
+
+/* Per-node state (node->data) */
+typedef struct {
+    ext2_fs_t *fs;
+    uint32_t ino;
+    uint32_t goal;              /* Where the file's next block should go */
+    bool dirty;                 /* raw differs from the disk */
+    bool loaded;                /* Directories: children read in */
+    uint32_t capacity;          /* Directories: slots in node->children */
+    fs_node_t *inline_children[EXT2_DIR_INLINE];
+    ext2_inode_t raw;
+} ext2_node_t;
+
+static slab_t node_slab = SLAB_INIT(fs_node_t);
+static slab_t info_slab = SLAB_INIT(ext2_node_t);
+
+static fs_ops_t ext2_dir_ops;
+static fs_ops_t ext2_file_ops;
+static fs_ops_t ext2_file_ro_ops;
+static fs_ops_t ext2_link_ops;
+static fs_ops_t ext2_special_ops;
+
+static int dev_read(ext2_fs_t *fs, uint32_t block, void *buf, uint32_t count) {
+    return block_read(fs->dev, (uint64_t)block * fs->spb, buf, count * fs->spb);
+}
+
+static int dev_write(ext2_fs_t *fs, uint32_t block, const void *buf, uint32_t count) {
+    return block_write(fs->dev, (uint64_t)block * fs->spb, buf, count * fs->spb);
+}
+
+static int sb_write(ext2_fs_t *fs) {
+    return block_write(fs->dev, EXT2_SUPER_OFFSET / BLOCK_SECTOR_SIZE, fs->sb,
+                       sizeof(ext2_super_t) / BLOCK_SECTOR_SIZE);
+}
+
+/*
+ * There is no wall clock, so time runs on from the last time the
+ * superblock was written. It is kept past the inode count, since fsck
+ * takes a small deletion time for a link in the orphan list.
+ */
+static uint32_t fs_time(ext2_fs_t *fs) {
+    uint32_t now = fs->epoch + timer_get_uptime_seconds();
+    return now > fs->sb->s_inodes_count ? now : fs->sb->s_inodes_count + 1;
+}
+
+/*
+ * ===========================================================================
+ * Metadata Buffers
+ * ===========================================================================
+ */
+
+static int buf_write(ext2_fs_t *fs, ext2_buf_t *b) {
+    if (!b->dirty) return 0;
+    if (dev_write(fs, b->block, b->data, 1) != 0) return -1;
+    b->dirty = false;
+    return 0;
+}
+
+/*
+ * Pin the cached copy of 'block', reading it in on a miss; with 'fill'
+ * 0 it comes back zeroed instead, for a block about to be initialized.
+ * Unpinned buffers are reused in clock order, dirty ones written first.
+ */
+static ext2_buf_t *buf_get(ext2_fs_t *fs, uint32_t block, int fill) {
+    if (block >= fs->sb->s_blocks_count) return NULL;
+
+    for (uint32_t i = 0; i < EXT2_BUFS; i++) {
+        ext2_buf_t *b = &fs->bufs[i];
+        if (b->valid && b->block == block) {
+            if (!fill) mem_zero(b->data, fs->bs);
+            b->pins++;
+            b->referenced = true;
+            return b;
+        }
+    }
+
+    ext2_buf_t *b = NULL;
+    for (uint32_t scanned = 0; scanned < 2 * EXT2_BUFS && !b; scanned++) {
+        ext2_buf_t *c = &fs->bufs[fs->clock];
+        fs->clock = (fs->clock + 1) % EXT2_BUFS;
+        if (c->pins) continue;
+        if (c->valid && c->referenced) {
+            c->referenced = false;
+            continue;
+        }
+        b = c;
+    }
+    if (!b || (b->valid && buf_write(fs, b) != 0)) return NULL;
+
+    b->valid = false;
+    if (!b->data) {
+        b->data = (uint8_t *)pmm_alloc_page();
+        if (!b->data) return NULL;
+    }
+    if (!fill) {
+        mem_zero(b->data, fs->bs);
+    } else if (dev_read(fs, block, b->data, 1) != 0) {
+        return NULL;
+    }
+
+    b->block = block;
+    b->valid = true;
+    b->dirty = false;
+    b->referenced = true;
+    b->pins = 1;
+    return b;
+}
+
+static void buf_put(ext2_buf_t *b) {
+    b->pins--;
+}
+
+/* A freed block may come back as file data: drop any cached copy */
+static void buf_forget(ext2_fs_t *fs, uint32_t block) {
+    for (uint32_t i = 0; i < EXT2_BUFS; i++) {
+        ext2_buf_t *b = &fs->bufs[i];
+        if (b->valid && b->block == block && !b->pins) {
+            b->valid = false;
+            b->dirty = false;
+        }
+    }
+}
+
+/* Write back everything the operation dirtied */
+static int fs_commit(ext2_fs_t *fs) {
+    int status = 0;
+    for (uint32_t i = 0; i < EXT2_BUFS; i++) {
+        ext2_buf_t *b = &fs->bufs[i];
+        if (b->valid && buf_write(fs, b) != 0) status = -1;
+    }
+    if (fs->gd_dirty) {
+        if (dev_write(fs, fs->sb->s_first_data_block + 1, fs->gd, fs->gd_blocks) != 0) {
+            status = -1;
+        }
+        fs->gd_dirty = false;
+    }
+    return status;
+}
+
+/* Operations on one mount run one at a time; I/O sleeps inside them */
+static void fs_lock(ext2_fs_t *fs) {
+    uint32_t irq = irq_save();
+    while (fs->busy) {
+        wait_queue_sleep(&fs->wait);
+    }
+    fs->busy = 1;
+    irq_restore(irq);
+}
+
+static int fs_unlock(ext2_fs_t *fs) {
+    int status = fs_commit(fs);
+
+    uint32_t irq = irq_save();
+    fs->busy = 0;
+    wait_queue_wake_all(&fs->wait);
+    irq_restore(irq);
+    return status;
+}
+
+/*
+ * ===========================================================================
+ * Inodes and Allocation
+ * ===========================================================================
+ */
+
+static uint32_t inode_group(ext2_fs_t *fs, uint32_t ino) {
+    return (ino - 1) / fs->sb->s_inodes_per_group;
+}
+
+/* First block of group 'g' */
+static uint32_t group_start(ext2_fs_t *fs, uint32_t g) {
+    return fs->sb->s_first_data_block + g * fs->sb->s_blocks_per_group;
+}
+
+/* Blocks in group 'g' (the last one may be short) */
+static uint32_t group_blocks(ext2_fs_t *fs, uint32_t g) {
+    if (g + 1 < fs->groups) return fs->sb->s_blocks_per_group;
+    return fs->sb->s_blocks_count - group_start(fs, g);
+}
+
+/* Pin the inode table block holding 'ino'; *offset is its byte offset */
+static ext2_buf_t *inode_buf(ext2_fs_t *fs, uint32_t ino, uint32_t *offset) {
+    if (ino == 0 || ino > fs->sb->s_inodes_count) return NULL;
+
+    uint32_t byte = ((ino - 1) % fs->sb->s_inodes_per_group) * fs->inode_size;
+    *offset = byte % fs->bs;
+    return buf_get(fs, fs->gd[inode_group(fs, ino)].bg_inode_table + byte / fs->bs, 1);
+}
+
+static int inode_read(ext2_fs_t *fs, uint32_t ino, ext2_inode_t *raw) {
+    uint32_t offset;
+    ext2_buf_t *b = inode_buf(fs, ino, &offset);
+    if (!b) return -1;
+    mem_copy(raw, b->data + offset, sizeof(ext2_inode_t));
+    buf_put(b);
+    return 0;
+}
+
+/* Store a node's inode; 'fresh' clears the rest of a large inode slot */
+static int inode_write(ext2_node_t *en, bool fresh) {
+    uint32_t offset;
+    ext2_buf_t *b = inode_buf(en->fs, en->ino, &offset);
+    if (!b) return -1;
+    if (fresh) mem_zero(b->data + offset, en->fs->inode_size);
+    mem_copy(b->data + offset, &en->raw, sizeof(ext2_inode_t));
+    b->dirty = true;
+    buf_put(b);
+    en->dirty = false;
+    return 0;
+}
+
+static int inode_sync(ext2_node_t *en) {
+    return en->dirty ? inode_write(en, false) : 0;
+}
+
+/* First clear bit in [from, to) of a bitmap, or 'to' if there is none */
+static uint32_t find_zero(const uint8_t *map, uint32_t from, uint32_t to) {
+    uint32_t i = from;
+    while (i < to) {
+        if ((i & 7) == 0 && map[i >> 3] == 0xFF) {
+            i += 8;
+            continue;
+        }
+        if (!(map[i >> 3] & (1 << (i & 7)))) return i;
+        i++;
+    }
+    return to;
+}
+
+/*
+ * Allocate the first free block at or after 'goal' in its group, then
+ * before it, then in the following groups. Returns 0 when full.
+ */
+static uint32_t block_alloc(ext2_fs_t *fs, uint32_t goal) {
+    ext2_super_t *sb = fs->sb;
+    if (goal < sb->s_first_data_block || goal >= sb->s_blocks_count) {
+        goal = sb->s_first_data_block;
+    }
+    uint32_t g0 = (goal - sb->s_first_data_block) / sb->s_blocks_per_group;
+
+    for (uint32_t n = 0; n < fs->groups; n++) {
+        uint32_t g = (g0 + n) % fs->groups;
+        if (!fs->gd[g].bg_free_blocks_count) continue;
+
+        ext2_buf_t *b = buf_get(fs, fs->gd[g].bg_block_bitmap, 1);
+        if (!b) return 0;
+
+        uint32_t count = group_blocks(fs, g);
+        uint32_t from = n == 0 ? goal - group_start(fs, g) : 0;
+        uint32_t bit = find_zero(b->data, from, count);
+        if (bit == count && from) {
+            bit = find_zero(b->data, 0, from);
+            if (bit == from) bit = count;
+        }
+        if (bit == count) {
+            buf_put(b);
+            continue;
+        }
+
+        b->data[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+        b->dirty = true;
+        buf_put(b);
+        fs->gd[g].bg_free_blocks_count--;
+        sb->s_free_blocks_count--;
+        fs->gd_dirty = true;
+        return group_start(fs, g) + bit;
+    }
+    return 0;
+}
+
+static void block_free(ext2_fs_t *fs, uint32_t block) {
+    ext2_super_t *sb = fs->sb;
+    if (block < sb->s_first_data_block || block >= sb->s_blocks_count) return;
+
+    uint32_t g = (block - sb->s_first_data_block) / sb->s_blocks_per_group;
+    uint32_t bit = block - group_start(fs, g);
+    buf_forget(fs, block);
+
+    ext2_buf_t *b = buf_get(fs, fs->gd[g].bg_block_bitmap, 1);
+    if (!b) return;
+    if (b->data[bit >> 3] & (1 << (bit & 7))) {
+        b->data[bit >> 3] &= (uint8_t)~(1 << (bit & 7));
+        b->dirty = true;
+        fs->gd[g].bg_free_blocks_count++;
+        sb->s_free_blocks_count++;
+        fs->gd_dirty = true;
+    }
+    buf_put(b);
+}
+
+/*
+ * Allocate an inode. A file goes in its directory's group if there is
+ * room, so its blocks (which follow the inode) sit next to its
+ * siblings'. A new directory goes to the group with the most free
+ * blocks among those with an average share of free inodes or more.
+ */
+static uint32_t inode_alloc(ext2_fs_t *fs, uint32_t group, bool dir) {
+    ext2_super_t *sb = fs->sb;
+    uint32_t ipg = sb->s_inodes_per_group;
+
+    if (dir) {
+        uint32_t avg = sb->s_free_inodes_count / fs->groups;
+        for (uint32_t g = 0; g < fs->groups; g++) {
+            ext2_group_desc_t *d = &fs->gd[g];
+            if (d->bg_free_inodes_count && d->bg_free_inodes_count >= avg &&
+                d->bg_free_blocks_count > fs->gd[group].bg_free_blocks_count) {
+                group = g;
+            }
+        }
+    }
+
+    for (uint32_t n = 0; n < fs->groups; n++) {
+        uint32_t g = (group + n) % fs->groups;
+        if (!fs->gd[g].bg_free_inodes_count) continue;
+
+        ext2_buf_t *b = buf_get(fs, fs->gd[g].bg_inode_bitmap, 1);
+        if (!b) return 0;
+
+        /* Inodes below first_ino are reserved */
+        uint32_t from = g == 0 ? fs->first_ino - 1 : 0;
+        uint32_t bit = find_zero(b->data, from, ipg);
+        if (bit == ipg || g * ipg + bit + 1 > sb->s_inodes_count) {
+            buf_put(b);
+            continue;
+        }
+
+        b->data[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+        b->dirty = true;
+        buf_put(b);
+        fs->gd[g].bg_free_inodes_count--;
+        if (dir) fs->gd[g].bg_used_dirs_count++;
+        sb->s_free_inodes_count--;
+        fs->gd_dirty = true;
+        return g * ipg + bit + 1;
+    }
+    return 0;
+}
+
+static void inode_free(ext2_fs_t *fs, uint32_t ino, bool dir) {
+    uint32_t g = inode_group(fs, ino);
+    uint32_t bit = (ino - 1) % fs->sb->s_inodes_per_group;
+
+    ext2_buf_t *b = buf_get(fs, fs->gd[g].bg_inode_bitmap, 1);
+    if (!b) return;
+    if (b->data[bit >> 3] & (1 << (bit & 7))) {
+        b->data[bit >> 3] &= (uint8_t)~(1 << (bit & 7));
+        b->dirty = true;
+        fs->gd[g].bg_free_inodes_count++;
+        if (dir && fs->gd[g].bg_used_dirs_count) fs->gd[g].bg_used_dirs_count--;
+        fs->sb->s_free_inodes_count++;
+        fs->gd_dirty = true;
+    }
+    buf_put(b);
+}
+
+/*
+ * ===========================================================================
+ * Block Mapping
+ * ===========================================================================
+ */
+
+/*
+ * Allocate a block for a file, right after its previous one or at the
+ * start of its inode's group. Indirect tables ('table') start zeroed.
+ */
+static uint32_t file_block_alloc(ext2_node_t *en, bool table) {
+    ext2_fs_t *fs = en->fs;
+    uint32_t goal = en->goal ? en->goal : group_start(fs, inode_group(fs, en->ino));
+    uint32_t block = block_alloc(fs, goal);
+    if (!block) return 0;
+
+    if (table) {
+        ext2_buf_t *b = buf_get(fs, block, 0);
+        if (!b) {
+            block_free(fs, block);
+            return 0;
+        }
+        b->dirty = true;
+        buf_put(b);
+    }
+
+    en->goal = block + 1;
+    en->raw.i_blocks += fs->spb;
+    en->dirty = true;
+    return block;
+}
+
+/* The inode's block pointers (aligned, although the struct is packed) */
+static uint32_t *iblock(ext2_node_t *en) {
+    return (uint32_t *)((uint8_t *)&en->raw + __builtin_offsetof(ext2_inode_t, i_block));
+}
+
+/* Free the block in *slot and clear the slot */
+static void file_block_free(ext2_node_t *en, uint32_t *slot) {
+    block_free(en->fs, *slot);
+    *slot = 0;
+    if (en->raw.i_blocks >= en->fs->spb) en->raw.i_blocks -= en->fs->spb;
+    en->dirty = true;
+}
+
+/*
+ * Find the disk block holding block 'lblk' of a file; *out is 0 for a
+ * hole. With 'create' a hole is filled, allocating the block and any
+ * missing indirect tables. Returns 0, or -1 on I/O error or full disk.
+ */
+static int bmap(ext2_node_t *en, uint32_t lblk, int create, uint32_t *out) {
+    ext2_fs_t *fs = en->fs;
+    uint32_t offsets[3];
+    uint32_t depth = 0;
+    uint32_t *slot;
+
+    if (lblk < EXT2_NDIR_BLOCKS) {
+        slot = &iblock(en)[lblk];
+    } else {
+        /* Single, double or triple indirect */
+        lblk -= EXT2_NDIR_BLOCKS;
+        uint32_t span = fs->ppb;
+        depth = 1;
+        while (lblk >= span) {
+            if (depth == 3) return -1;
+            lblk -= span;
+            span *= fs->ppb;
+            depth++;
+        }
+        for (uint32_t d = depth; d-- > 0; ) {
+            offsets[d] = lblk % fs->ppb;
+            lblk /= fs->ppb;
+        }
+        slot = &iblock(en)[EXT2_IND_BLOCK + depth - 1];
+    }
+
+    uint32_t block = *slot;
+    if (!block && create) {
+        block = file_block_alloc(en, depth > 0);
+        if (!block) return -1;
+        *slot = block;
+    }
+
+    for (uint32_t d = 0; d < depth && block; d++) {
+        ext2_buf_t *b = buf_get(fs, block, 1);
+        if (!b) return -1;
+
+        uint32_t *table = (uint32_t *)b->data;
+        block = table[offsets[d]];
+        if (!block && create) {
+            block = file_block_alloc(en, d + 1 < depth);
+            if (!block) {
+                buf_put(b);
+                return -1;
+            }
+            table[offsets[d]] = block;
+            b->dirty = true;
+        }
+        buf_put(b);
+    }
+
+    if (block >= fs->sb->s_blocks_count) return -1;
+    *out = block;
+    return 0;
+}
+
+/*
+ * Free the part of an indirect tree ('depth' levels below *slot) from
+ * entry 'from' on, and the tables that leaves empty.
+ */
+static void trim_tree(ext2_node_t *en, uint32_t *slot, uint32_t depth, uint32_t from) {
+    if (!*slot) return;
+
+    if (depth > 0) {
+        ext2_fs_t *fs = en->fs;
+        uint32_t span = 1;
+        for (uint32_t d = 1; d < depth; d++) span *= fs->ppb;
+
+        ext2_buf_t *b = buf_get(fs, *slot, 1);
+        if (!b) return;                 /* Leak rather than free blindly */
+
+        uint32_t *table = (uint32_t *)b->data;
+        for (uint32_t i = from / span; i < fs->ppb; i++) {
+            if (table[i]) {
+                trim_tree(en, &table[i], depth - 1, i == from / span ? from % span : 0);
+                b->dirty = true;
+            }
+        }
+        buf_put(b);
+        if (from) return;               /* The table still maps earlier blocks */
+    }
+    file_block_free(en, slot);
+}
+
+/* Free every block of a file from block 'from' on */
+static void trim(ext2_node_t *en, uint32_t from) {
+    for (uint32_t i = from; i < EXT2_NDIR_BLOCKS; i++) {
+        if (iblock(en)[i]) file_block_free(en, &iblock(en)[i]);
+    }
+
+    uint64_t base = EXT2_NDIR_BLOCKS;
+    uint64_t span = en->fs->ppb;
+    for (uint32_t depth = 1; depth <= 3; depth++) {
+        if (from < base + span) {
+            uint32_t rel = from > base ? (uint32_t)(from - base) : 0;
+            trim_tree(en, &iblock(en)[EXT2_IND_BLOCK + depth - 1], depth, rel);
+        }
+        base += span;
+        span *= en->fs->ppb;
+    }
+    en->goal = 0;
+}
+
+/* Does i_block hold block numbers? (Not for fast symlinks or devices) */
+static bool has_blocks(ext2_node_t *en) {
+    uint32_t mode = en->raw.i_mode & EXT2_S_IFMT;
+    if (mode == EXT2_S_IFREG || mode == EXT2_S_IFDIR) return true;
+    uint32_t acl = en->raw.i_file_acl ? en->fs->spb : 0;
+    return mode == EXT2_S_IFLNK && en->raw.i_blocks > acl;
+}
+
+/* Drop the inode's reference on its extended attribute block */
+static void xattr_release(ext2_node_t *en) {
+    ext2_fs_t *fs = en->fs;
+    uint32_t block = en->raw.i_file_acl;
+    if (!block) return;
+
+    ext2_buf_t *b = buf_get(fs, block, 1);
+    if (!b) return;
+    uint32_t *header = (uint32_t *)b->data;
+    bool shared = header[0] == EXT2_XATTR_MAGIC && header[1] > 1;
+    if (shared) {
+        header[1]--;
+        b->dirty = true;
+    }
+    buf_put(b);
+
+    if (!shared) block_free(fs, block);
+    en->raw.i_file_acl = 0;
+    if (en->raw.i_blocks >= fs->spb) en->raw.i_blocks -= fs->spb;
+    en->dirty = true;
+}
+
+/* Free a file's blocks and its inode once no name refers to it */
+static void inode_drop(ext2_node_t *en) {
+    ext2_fs_t *fs = en->fs;
+    bool dir = (en->raw.i_mode & EXT2_S_IFMT) == EXT2_S_IFDIR;
+
+    if (has_blocks(en)) trim(en, 0);
+    xattr_release(en);
+
+    en->raw.i_dtime = fs_time(fs);
+    en->raw.i_links_count = 0;
+    en->raw.i_size = 0;
+    en->dirty = true;
+    inode_sync(en);
+    inode_free(fs, en->ino, dir);
+}
+
+/*
+ * One name of a non-directory is gone. Its other names, if any, have
+ * their own copy of the inode and may have dropped links already: the
+ * disk has the count (such a node is read-only, so its copy is clean).
+ */
+static void link_drop(ext2_node_t *en) {
+    if (en->raw.i_links_count > 1) {
+        inode_read(en->fs, en->ino, &en->raw);
+    }
+    if (en->raw.i_links_count) {
+        en->raw.i_links_count--;
+    }
+    en->dirty = true;
+}
+
+static void set_size(ext2_node_t *en, uint32_t size) {
+    ext2_fs_t *fs = en->fs;
+    if (size >= 0x80000000 && !(fs->sb->s_feature_ro_compat & EXT2_FEATURE_RO_COMPAT_LARGE_FILE)) {
+        fs->sb->s_feature_ro_compat |= EXT2_FEATURE_RO_COMPAT_LARGE_FILE;
+    }
+    en->raw.i_size = size;
+    en->raw.i_size_high = 0;
+    en->dirty = true;
+}
+
+/*
+ * ===========================================================================
+ * Nodes
+ * ===========================================================================
+ */
+
+/* A node for inode 'ino' named 'name' in 'parent' (not linked in yet) */
+static fs_node_t *node_new(ext2_fs_t *fs, fs_node_t *parent, const char *name, uint32_t ino,
+                           const ext2_inode_t *raw) {
+    fs_node_t *node = (fs_node_t *)slab_alloc(&node_slab);
+    ext2_node_t *en = (ext2_node_t *)slab_alloc(&info_slab);
+    const char *interned = name_intern(name);
+    if (!node || !en || !interned) {
+        if (node) slab_free(&node_slab, node);
+        if (en) slab_free(&info_slab, en);
+        if (interned) name_release(interned);
+        return NULL;
+    }
+
+    en->fs = fs;
+    en->ino = ino;
+    en->raw = *raw;
+
+    node->name = interned;
+    node->parent = parent;
+    node->data = en;
+    node->inode = ino;
+    node->size = raw->i_size;
+
+    switch (raw->i_mode & EXT2_S_IFMT) {
+        case EXT2_S_IFDIR:
+            node->type = FS_DIRECTORY;
+            node->ops = &ext2_dir_ops;
+            node->children = en->inline_children;
+            en->capacity = EXT2_DIR_INLINE;
+            break;
+        case EXT2_S_IFREG:
+            node->type = FS_FILE;
+            node->ops = fs->readonly || raw->i_links_count > 1 ? &ext2_file_ro_ops
+                                                               : &ext2_file_ops;
+            break;
+        case EXT2_S_IFLNK:
+            node->type = FS_SYMLINK;
+            node->ops = &ext2_link_ops;
+            break;
+        default:
+            /* Device nodes, FIFOs and sockets: listed, removable, no data */
+            node->type = FS_FILE;
+            node->ops = &ext2_special_ops;
+            node->size = 0;
+            break;
+    }
+    return node;
+}
+
+static void node_free(fs_node_t *node) {
+    ext2_node_t *en = (ext2_node_t *)node->data;
+    if (node->type == FS_DIRECTORY && en->capacity > EXT2_DIR_INLINE) {
+        pmm_free_pages((uint32_t)node->children, pages_for(en->capacity * sizeof(fs_node_t *)));
+    }
+    name_release(node->name);
+    slab_free(&info_slab, en);
+    slab_free(&node_slab, node);
+}
+
+/* Make room for one more child in a directory's array */
+static int child_reserve(fs_node_t *dir) {
+    ext2_node_t *den = (ext2_node_t *)dir->data;
+    if ((uint32_t)dir->child_count < den->capacity) return 0;
+
+    uint32_t capacity = den->capacity * 2;
+    fs_node_t **children = (fs_node_t **)pmm_alloc_pages(pages_for(capacity * sizeof(fs_node_t *)));
+    if (!children) return -1;
+    for (int i = 0; i < dir->child_count; i++) {
+        children[i] = dir->children[i];
+    }
+    if (den->capacity > EXT2_DIR_INLINE) {
+        pmm_free_pages((uint32_t)dir->children, pages_for(den->capacity * sizeof(fs_node_t *)));
+    }
+    dir->children = children;
+    den->capacity = capacity;
+    return 0;
+}
+
+/* Add a child (room reserved), replacing any cached "not found" */
+static void child_add(fs_node_t *dir, fs_node_t *child) {
+    dir->children[dir->child_count++] = child;
+    dcache_invalidate(dir, child->name);
+}
+
+static void child_remove(fs_node_t *dir, fs_node_t *child) {
+    int pos = 0;
+    while (dir->children[pos] != child) pos++;
+    dir->children[pos] = dir->children[--dir->child_count];
+    dir->children[dir->child_count] = NULL;
+    dcache_invalidate(dir, child->name);
+}
+
+static fs_node_t *child_find(fs_node_t *dir, const char *name) {
+    uint32_t hash = name_hash(name);
+    for (int i = 0; i < dir->child_count; i++) {
+        fs_node_t *child = dir->children[i];
+        if (name_interned_hash(child->name) == hash && str_eq(child->name, name)) {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+/* Take a removed node out of the namespace; it is freed on last put */
+static void detach(fs_node_t *dir, fs_node_t *child) {
+    child_remove(dir, child);
+    child->parent = NULL;
+    child->flags |= FS_UNLINKED;
+}
+
+/*
+ * ===========================================================================
+ * Directories
+ * ===========================================================================
+ */
+
+static int dirent_ok(const ext2_dirent_t *de, uint32_t off, uint32_t bs) {
+    return de->rec_len >= EXT2_DIRENT_HEADER && (de->rec_len & 3) == 0 &&
+           off + de->rec_len <= bs && EXT2_DIRENT_HEADER + de->name_len <= de->rec_len;
+}
+
+static uint8_t dirent_type(ext2_fs_t *fs, uint16_t mode) {
+    if (!(fs->sb->s_feature_incompat & EXT2_FEATURE_INCOMPAT_FILETYPE)) return EXT2_FT_UNKNOWN;
+    switch (mode & EXT2_S_IFMT) {
+        case EXT2_S_IFREG: return EXT2_FT_REG_FILE;
+        case EXT2_S_IFDIR: return EXT2_FT_DIR;
+        case EXT2_S_IFLNK: return EXT2_FT_SYMLINK;
+        default:           return EXT2_FT_UNKNOWN;
+    }
+}
+
+/* A changed directory is no longer described by its hash index */
+static void dir_changed(ext2_node_t *den) {
+    if (den->raw.i_flags & EXT2_INDEX_FL) {
+        den->raw.i_flags &= ~EXT2_INDEX_FL;
+        den->dirty = true;
+    }
+}
+
+/* Pin block 'lblk' of a directory; NULL for a hole (*err on failure) */
+static ext2_buf_t *dir_block(ext2_node_t *den, uint32_t lblk, int *err) {
+    uint32_t block;
+    if (bmap(den, lblk, 0, &block) != 0) {
+        *err = 1;
+        return NULL;
+    }
+    if (!block) return NULL;
+    ext2_buf_t *b = buf_get(den->fs, block, 1);
+    if (!b) *err = 1;
+    return b;
+}
+
+/* Read a directory's entries into nodes, once */
+static int dir_load(fs_node_t *dir) {
+    ext2_node_t *den = (ext2_node_t *)dir->data;
+    ext2_fs_t *fs = den->fs;
+    if (den->loaded) return 0;
+
+    char name[EXT2_NAME_LEN + 1];
+    uint32_t blocks = den->raw.i_size / fs->bs;
+    int err = 0;
+
+    for (uint32_t lblk = 0; lblk < blocks && !err; lblk++) {
+        ext2_buf_t *b = dir_block(den, lblk, &err);
+        if (!b) continue;
+
+        for (uint32_t off = 0; off < fs->bs && !err; ) {
+            ext2_dirent_t *de = (ext2_dirent_t *)(b->data + off);
+            if (!dirent_ok(de, off, fs->bs)) break;
+            off += de->rec_len;
+
+            if (!de->inode) continue;
+            mem_copy(name, de->name, de->name_len);
+            name[de->name_len] = '\0';
+            if (str_eq(name, ".") || str_eq(name, "..")) continue;
+
+            ext2_inode_t raw;
+            fs_node_t *child = NULL;
+            if (inode_read(fs, de->inode, &raw) != 0 || child_reserve(dir) != 0 ||
+                !(child = node_new(fs, dir, name, de->inode, &raw))) {
+                err = 1;
+                break;
+            }
+            child_add(dir, child);
+        }
+        buf_put(b);
+    }
+
+    if (err) {
+        /* Start over next time */
+        while (dir->child_count > 0) {
+            fs_node_t *child = dir->children[--dir->child_count];
+            dcache_invalidate(dir, child->name);
+            node_free(child);
+        }
+        return -1;
+    }
+    den->loaded = true;
+    return 0;
+}
+
+/*
+ * Find entry 'name'. Its block is left pinned in *buf, and *prev is
+ * the entry before it in that block (NULL if it is the first).
+ */
+static ext2_dirent_t *dirent_find(ext2_node_t *den, const char *name, ext2_buf_t **buf,
+                                  ext2_dirent_t **prev) {
+    ext2_fs_t *fs = den->fs;
+    uint32_t len = str_len(name);
+    uint32_t blocks = den->raw.i_size / fs->bs;
+    int err = 0;
+
+    for (uint32_t lblk = 0; lblk < blocks && !err; lblk++) {
+        ext2_buf_t *b = dir_block(den, lblk, &err);
+        if (!b) continue;
+
+        ext2_dirent_t *p = NULL;
+        for (uint32_t off = 0; off < fs->bs; ) {
+            ext2_dirent_t *de = (ext2_dirent_t *)(b->data + off);
+            if (!dirent_ok(de, off, fs->bs)) break;
+            if (de->inode && de->name_len == len && mem_eq(de->name, name, len)) {
+                *buf = b;
+                *prev = p;
+                return de;
+            }
+            p = de;
+            off += de->rec_len;
+        }
+        buf_put(b);
+    }
+    return NULL;
+}
+
+/*
+ * Add an entry, in the first gap big enough for it: an unused entry or
+ * the slack after a live one. A full directory grows by a block.
+ */
+static int dirent_add(fs_node_t *dir, const char *name, uint32_t ino, uint8_t type) {
+    ext2_node_t *den = (ext2_node_t *)dir->data;
+    ext2_fs_t *fs = den->fs;
+    uint32_t len = str_len(name);
+    uint32_t need = EXT2_DIRENT_SIZE(len);
+    uint32_t blocks = den->raw.i_size / fs->bs;
+    int err = 0;
+
+    ext2_buf_t *b = NULL;
+    ext2_dirent_t *de = NULL;
+    for (uint32_t lblk = 0; lblk < blocks && !de; lblk++) {
+        b = dir_block(den, lblk, &err);
+        if (err) return -1;
+        if (!b) continue;
+
+        for (uint32_t off = 0; off < fs->bs; ) {
+            ext2_dirent_t *d = (ext2_dirent_t *)(b->data + off);
+            if (!dirent_ok(d, off, fs->bs)) break;
+
+            uint32_t used = d->inode ? EXT2_DIRENT_SIZE(d->name_len) : 0;
+            if (d->rec_len >= used + need) {
+                if (used) {
+                    ext2_dirent_t *split = (ext2_dirent_t *)((uint8_t *)d + used);
+                    split->rec_len = (uint16_t)(d->rec_len - used);
+                    d->rec_len = (uint16_t)used;
+                    d = split;
+                }
+                de = d;
+                break;
+            }
+            off += d->rec_len;
+        }
+        if (!de) buf_put(b);
+    }
+
+    if (!de) {
+        uint32_t block;
+        if (bmap(den, blocks, 1, &block) != 0 || !(b = buf_get(fs, block, 0))) return -1;
+        de = (ext2_dirent_t *)b->data;
+        de->rec_len = (uint16_t)fs->bs;
+        set_size(den, den->raw.i_size + fs->bs);
+        dir->size = den->raw.i_size;
+    }
+
+    de->inode = ino;
+    de->name_len = (uint8_t)len;
+    de->file_type = type;
+    mem_copy(de->name, name, len);
+    b->dirty = true;
+    buf_put(b);
+    dir_changed(den);
+    return 0;
+}
+
+/* Remove entry 'name', merging its space into the entry before it */
+static int dirent_remove(ext2_node_t *den, const char *name) {
+    ext2_buf_t *b;
+    ext2_dirent_t *prev;
+    ext2_dirent_t *de = dirent_find(den, name, &b, &prev);
+    if (!de) return -1;
+
+    if (prev) {
+        prev->rec_len = (uint16_t)(prev->rec_len + de->rec_len);
+    } else {
+        de->inode = 0;
+    }
+    b->dirty = true;
+    buf_put(b);
+    dir_changed(den);
+    return 0;
+}
+
+/* Point entry 'name' at another inode */
+static int dirent_retarget(ext2_node_t *den, const char *name, uint32_t ino, uint8_t type) {
+    ext2_buf_t *b;
+    ext2_dirent_t *prev;
+    ext2_dirent_t *de = dirent_find(den, name, &b, &prev);
+    if (!de) return -1;
+
+    de->inode = ino;
+    de->file_type = type;
+    b->dirty = true;
+    buf_put(b);
+    dir_changed(den);
+    return 0;
+}
+
+/* Give a new directory its first block, holding "." and ".." */
+static int dir_init(ext2_node_t *en, uint32_t parent_ino) {
+    ext2_fs_t *fs = en->fs;
+    uint32_t block;
+    if (bmap(en, 0, 1, &block) != 0) return -1;
+
+    ext2_buf_t *b = buf_get(fs, block, 0);
+    if (!b) return -1;
+
+    uint8_t type = dirent_type(fs, EXT2_S_IFDIR);
+    ext2_dirent_t *dot = (ext2_dirent_t *)b->data;
+    dot->inode = en->ino;
+    dot->rec_len = EXT2_DIRENT_SIZE(1);
+    dot->name_len = 1;
+    dot->file_type = type;
+    dot->name[0] = '.';
+
+    ext2_dirent_t *dotdot = (ext2_dirent_t *)(b->data + dot->rec_len);
+    dotdot->inode = parent_ino;
+    dotdot->rec_len = (uint16_t)(fs->bs - dot->rec_len);
+    dotdot->name_len = 2;
+    dotdot->file_type = type;
+    dotdot->name[0] = '.';
+    dotdot->name[1] = '.';
+
+    b->dirty = true;
+    buf_put(b);
+    set_size(en, fs->bs);
+    return 0;
+}
+
+static fs_node_t *ext2_finddir(fs_node_t *dir, const char *name) {
+    ext2_fs_t *fs = ((ext2_node_t *)dir->data)->fs;
+    fs_lock(fs);
+    fs_node_t *child = dir_load(dir) == 0 ? child_find(dir, name) : NULL;
+    fs_unlock(fs);
+    return child;
+}
+
+static fs_node_t *ext2_readdir(fs_node_t *dir, int index) {
+    ext2_fs_t *fs = ((ext2_node_t *)dir->data)->fs;
+    fs_lock(fs);
+    fs_node_t *child = NULL;
+    if (dir_load(dir) == 0 && index >= 0 && index < dir->child_count) {
+        child = dir->children[index];
+    }
+    fs_unlock(fs);
+    return child;
+}
+
+static fs_node_t *ext2_create(fs_node_t *dir, const char *name, uint8_t type) {
+    ext2_node_t *den = (ext2_node_t *)dir->data;
+    ext2_fs_t *fs = den->fs;
+    uint32_t len = str_len(name);
+    bool is_dir = type == FS_DIRECTORY;
+    if (fs->readonly || len == 0 || len >= FS_NAME_MAX || (type != FS_FILE && !is_dir)) {
+        return NULL;
+    }
+
+    fs_lock(fs);
+    fs_node_t *node = NULL;
+    uint32_t ino = 0;
+    if (dir_load(dir) != 0 || child_find(dir, name) || child_reserve(dir) != 0) goto out;
+
+    ino = inode_alloc(fs, inode_group(fs, den->ino), is_dir);
+    if (!ino) goto out;
+
+    ext2_inode_t raw;
+    mem_zero(&raw, sizeof(raw));
+    raw.i_mode = is_dir ? (EXT2_S_IFDIR | 0755) : (EXT2_S_IFREG | 0644);
+    raw.i_links_count = is_dir ? 2 : 1;
+    raw.i_atime = raw.i_ctime = raw.i_mtime = fs_time(fs);
+
+    node = node_new(fs, dir, name, ino, &raw);
+    if (!node) goto out;
+    ext2_node_t *en = (ext2_node_t *)node->data;
+    en->loaded = true;
+
+    if ((is_dir && dir_init(en, den->ino) != 0) || inode_write(en, true) != 0 ||
+        dirent_add(dir, name, ino, dirent_type(fs, raw.i_mode)) != 0) {
+        if (has_blocks(en)) trim(en, 0);
+        node_free(node);
+        node = NULL;
+        goto out;
+    }
+    node->size = en->raw.i_size;
+
+    if (is_dir) {
+        den->raw.i_links_count++;
+        den->dirty = true;
+    }
+    inode_sync(den);
+    child_add(dir, node);
+
+out:
+    if (!node && ino) inode_free(fs, ino, is_dir);
+    fs_unlock(fs);
+    return node;
+}
+
+static int ext2_unlink(fs_node_t *dir, fs_node_t *child) {
+    ext2_node_t *den = (ext2_node_t *)dir->data;
+    ext2_node_t *cen = (ext2_node_t *)child->data;
+    ext2_fs_t *fs = den->fs;
+    if (fs->readonly) return -1;
+
+    fs_lock(fs);
+    int status = -1;
+    if (child->type == FS_DIRECTORY && (dir_load(child) != 0 || child->child_count)) goto out;
+    if (dirent_remove(den, child->name) != 0) goto out;
+
+    if (child->type == FS_DIRECTORY) {
+        cen->raw.i_links_count = 0;
+        den->raw.i_links_count--;
+        den->dirty = true;
+        cen->dirty = true;
+    } else {
+        link_drop(cen);
+    }
+    inode_sync(cen);
+    inode_sync(den);
+
+    detach(dir, child);
+    status = 0;
+out:
+    if (fs_unlock(fs) != 0) status = -1;
+    return status;
+}
+
+/* New name first, old name second: a crash leaves two names, never none */
+static int ext2_rename(fs_node_t *olddir, fs_node_t *child, fs_node_t *newdir,
+                       const char *newname) {
+    ext2_node_t *oen = (ext2_node_t *)olddir->data;
+    ext2_node_t *nen = (ext2_node_t *)newdir->data;
+    ext2_node_t *cen = (ext2_node_t *)child->data;
+    ext2_fs_t *fs = cen->fs;
+    bool is_dir = child->type == FS_DIRECTORY;
+    if (fs->readonly || str_len(newname) >= FS_NAME_MAX) return -1;
+
+    fs_lock(fs);
+    int status = -1;
+    const char *name = NULL;
+    if (dir_load(newdir) != 0) goto out;
+
+    fs_node_t *target = child_find(newdir, newname);
+    if (target == child) {
+        status = 0;
+        goto out;
+    }
+    if (target && ((target->type == FS_DIRECTORY) != is_dir ||
+                   (is_dir && (dir_load(target) != 0 || target->child_count)))) {
+        goto out;
+    }
+
+    name = name_intern(newname);
+    if (!name || (!target && child_reserve(newdir) != 0)) goto out;
+
+    uint8_t type = dirent_type(fs, cen->raw.i_mode);
+    if ((target ? dirent_retarget(nen, newname, cen->ino, type)
+                : dirent_add(newdir, newname, cen->ino, type)) != 0 ||
+        dirent_remove(oen, child->name) != 0) {
+        goto out;
+    }
+
+    if (is_dir && olddir != newdir) {
+        dirent_retarget(cen, "..", nen->ino, type);
+        oen->raw.i_links_count--;
+        nen->raw.i_links_count++;
+        oen->dirty = true;
+        nen->dirty = true;
+    }
+    if (target) {
+        ext2_node_t *ten = (ext2_node_t *)target->data;
+        if (is_dir) {
+            ten->raw.i_links_count = 0;
+            nen->raw.i_links_count--;
+            nen->dirty = true;
+            ten->dirty = true;
+        } else {
+            link_drop(ten);
+        }
+        inode_sync(ten);
+        detach(newdir, target);
+    }
+    inode_sync(cen);
+    inode_sync(oen);
+    inode_sync(nen);
+
+    child_remove(olddir, child);
+    const char *old = child->name;
+    child->name = name;
+    child->parent = newdir;
+    child_add(newdir, child);
+    name_release(old);
+    name = NULL;
+    status = 0;
+
+out:
+    if (name) name_release(name);
+    if (fs_unlock(fs) != 0) status = -1;
+    return status;
+}
+
+/*
+ * ===========================================================================
+ * Files
+ * ===========================================================================
+ */
+
+/*
+ * Read the first 'count' blocks of file page 'pgoff' into 'page', one
+ * request per run of contiguous blocks. Holes and blocks past 'count'
+ * are zeroed.
+ */
+static int page_read(ext2_node_t *en, uint32_t pgoff, uint8_t *page, uint32_t count) {
+    ext2_fs_t *fs = en->fs;
+    uint32_t per = PAGE_SIZE / fs->bs;
+    uint32_t lblk = pgoff * per;
+    uint32_t start = 0, run = 0, at = 0;
+
+    for (uint32_t i = 0; i <= per; i++) {
+        uint32_t block = 0;
+        if (i < count && bmap(en, lblk + i, 0, &block) != 0) return -1;
+        if (run && block == start + run) {
+            run++;
+            continue;
+        }
+
+        if (run) {
+            if (dev_read(fs, start, page + at * fs->bs, run) != 0) return -1;
+        }
+        run = 0;
+        if (block) {
+            start = block;
+            at = i;
+            run = 1;
+        } else if (i < per) {
+            mem_zero(page + i * fs->bs, fs->bs);
+        }
+    }
+    return 0;
+}
+
+/* Blocks of page 'pgoff' inside a file of 'size' bytes */
+static uint32_t page_blocks(ext2_fs_t *fs, uint32_t pgoff, uint32_t size) {
+    uint32_t pos = pgoff << PAGE_SHIFT;
+    if (pos >= size) return 0;
+    uint32_t bytes = size - pos < PAGE_SIZE ? size - pos : PAGE_SIZE;
+    return (bytes + fs->bs - 1) / fs->bs;
+}
+
+static int ext2_readpage(fs_node_t *node, uint32_t pgoff, void *page) {
+    ext2_node_t *en = (ext2_node_t *)node->data;
+    ext2_fs_t *fs = en->fs;
+
+    fs_lock(fs);
+    int status = page_read(en, pgoff, (uint8_t *)page, page_blocks(fs, pgoff, node->size));
+    fs_unlock(fs);
+    return status;
+}
+
+/*
+ * Store up to PCACHE_WB_MAX pages. Their blocks are allocated first
+ * (that may read indirect blocks), then each run of contiguous blocks
+ * in a page goes out as a bio while the queue is plugged, so a file
+ * laid out in order is written with a few large requests.
+ */
+static int pages_write(ext2_node_t *en, uint32_t size, uint32_t pgoff, uint32_t count, uint32_t *frames) {
+    ext2_fs_t *fs = en->fs;
+    uint32_t per = PAGE_SIZE / fs->bs;
+    uint32_t blocks[PCACHE_WB_MAX * (PAGE_SIZE / 1024)];
+
+    for (uint32_t i = 0; i < count * per; i++) {
+        blocks[i] = 0;
+        if (i % per < page_blocks(fs, pgoff + i / per, size) &&
+            bmap(en, pgoff * per + i, 1, &blocks[i]) != 0) {
+            return -1;
+        }
+    }
+
+    int status = 0;
+    bio_t *first = NULL;
+    bio_t **link = &first;
+    block_plug(fs->dev);
+    for (uint32_t i = 0; i < count * per && status == 0; ) {
+        uint32_t run = 1;
+        while (i < count * per && !blocks[i]) i++;
+        if (i == count * per) break;
+        while ((i + run) % per && blocks[i + run] == blocks[i] + run) run++;
+
+        bio_t *bio = bio_alloc();
+        if (!bio) {
+            status = -1;
+            break;
+        }
+        bio->dev = fs->dev;
+        bio->op = BIO_WRITE;
+        bio->sector = (uint64_t)blocks[i] * fs->spb;
+        bio->nsegs = 1;
+        bio->segs[0].addr = frames[i / per] + (i % per) * fs->bs;
+        bio->segs[0].len = run * fs->bs;
+        *link = bio;
+        link = (bio_t **)&bio->priv;
+        block_submit(bio);
+        i += run;
+    }
+    block_unplug(fs->dev);
+
+    while (first) {
+        bio_t *next = (bio_t *)first->priv;
+        block_wait(first);
+        if (first->status != 0) status = -1;
+        bio_free(first);
+        first = next;
+    }
+    return status;
+}
+
+static int ext2_writepages(fs_node_t *node, uint32_t pgoff, uint32_t count, uint32_t *frames) {
+    ext2_node_t *en = (ext2_node_t *)node->data;
+    ext2_fs_t *fs = en->fs;
+    if (page_blocks(fs, pgoff, node->size) == 0) return 0;     /* Truncated away meanwhile */
+
+    fs_lock(fs);
+
+    /* After a remount, carry on from where the file's blocks end */
+    uint32_t per = PAGE_SIZE / fs->bs;
+    uint32_t prev;
+    if (!en->goal && pgoff && bmap(en, pgoff * per - 1, 0, &prev) == 0 && prev) {
+        en->goal = prev + 1;
+    }
+
+    int status = 0;
+    for (uint32_t done = 0; done < count && status == 0; ) {
+        uint32_t n = count - done < PCACHE_WB_MAX ? count - done : PCACHE_WB_MAX;
+        status = pages_write(en, node->size, pgoff + done, n, frames + done);
+        done += n;
+    }
+    if (en->raw.i_size != node->size) {
+        set_size(en, node->size);
+    }
+    en->raw.i_mtime = fs_time(fs);
+    en->dirty = true;
+    if (inode_sync(en) != 0) status = -1;
+    if (fs_unlock(fs) != 0) status = -1;
+    return status;
+}
+
+static int ext2_writepage(fs_node_t *node, uint32_t pgoff, const void *page) {
+    uint32_t frame = (uint32_t)page;
+    return ext2_writepages(node, pgoff, 1, &frame);
+}
+
+/* Lend the device's frame for a page that is one whole, mapped block */
+static int ext2_sharepage(fs_node_t *node, uint32_t pgoff, uint32_t *frame) {
+    ext2_node_t *en = (ext2_node_t *)node->data;
+    ext2_fs_t *fs = en->fs;
+    if (!fs->share) return -1;
+
+    fs_lock(fs);
+    uint32_t block;
+    int status = bmap(en, pgoff, 0, &block);
+    fs_unlock(fs);
+
+    if (status != 0 || !block) return -1;
+    return block_share_page(fs->dev, (uint64_t)block * fs->spb, frame);
+}
+
+static int ext2_truncate(fs_node_t *node, uint32_t size) {
+    ext2_node_t *en = (ext2_node_t *)node->data;
+    ext2_fs_t *fs = en->fs;
+    if (fs->readonly) return -1;
+
+    fs_lock(fs);
+    int status = 0;
+    if (size < node->size) {
+        trim(en, size / fs->bs + (size % fs->bs != 0));
+
+        /* Zero the cut-off tail of the last block, so growing reads zeros */
+        uint32_t tail = size % fs->bs;
+        uint32_t block;
+        if (tail && bmap(en, size / fs->bs, 0, &block) == 0 && block) {
+            if (dev_read(fs, block, fs->scratch, 1) == 0) {
+                mem_zero(fs->scratch + tail, fs->bs - tail);
+                status = dev_write(fs, block, fs->scratch, 1);
+            } else {
+                status = -1;
+            }
+        }
+    }
+
+    node->size = size;
+    set_size(en, size);
+    en->raw.i_mtime = fs_time(fs);
+    if (inode_sync(en) != 0) status = -1;
+    if (fs_unlock(fs) != 0) status = -1;
+    return status;
+}
+
+/* Symbolic links read as their target */
+static ssize_t ext2_readlink(fs_node_t *node, void *buf, size_t size, size_t offset) {
+    ext2_node_t *en = (ext2_node_t *)node->data;
+    ext2_fs_t *fs = en->fs;
+    if (offset >= node->size) return 0;
+    if (size > node->size - offset) size = node->size - offset;
+
+    /* Short targets live in i_block itself */
+    if (!has_blocks(en)) {
+        if (node->size > sizeof(en->raw.i_block)) return -1;
+        mem_copy(buf, (const char *)en->raw.i_block + offset, (uint32_t)size);
+        return (ssize_t)size;
+    }
+    if (offset + size > fs->bs) return -1;
+
+    fs_lock(fs);
+    uint32_t block;
+    int status = bmap(en, 0, 0, &block);
+    if (status == 0 && block) status = dev_read(fs, block, fs->scratch, 1);
+    if (status == 0 && block) mem_copy(buf, fs->scratch + offset, (uint32_t)size);
+    fs_unlock(fs);
+    return status == 0 && block ? (ssize_t)size : -1;
+}
+
+/* Every operation is on the device when it returns; drain its cache */
+static int ext2_fsync(fs_node_t *node) {
+    ext2_node_t *en = (ext2_node_t *)node->data;
+    return block_flush(en->fs->dev);
+}
+
+/*
+ * ===========================================================================
+ * Releasing Nodes
+ * ===========================================================================
+ */
+
+/* An unlinked node is gone; if that was its last name, so is the inode */
+static void ext2_release(fs_node_t *node) {
+    ext2_node_t *en = (ext2_node_t *)node->data;
+    ext2_fs_t *fs = en->fs;
+
+    if (!fs->readonly && en->raw.i_links_count == 0) {
+        fs_lock(fs);
+        inode_drop(en);
+        fs_unlock(fs);
+    }
+
+    if (node->type == FS_DIRECTORY) {
+        while (node->child_count > 0) {
+            node_free(node->children[--node->child_count]);
+        }
+    }
+    node_free(node);
+}
+
+static fs_ops_t ext2_dir_ops = {
+    .readdir = ext2_readdir,
+    .finddir = ext2_finddir,
+    .create  = ext2_create,
+    .unlink  = ext2_unlink,
+    .rename  = ext2_rename,
+    .fsync   = ext2_fsync,
+    .release = ext2_release,
+};
+
+static fs_ops_t ext2_file_ops = {
+    .truncate   = ext2_truncate,
+    .readpage   = ext2_readpage,
+    .writepage  = ext2_writepage,
+    .writepages = ext2_writepages,
+    .sharepage  = ext2_sharepage,
+    .fsync      = ext2_fsync,
+    .release    = ext2_release,
+};
+
+/* Without writepage the page cache refuses writes */
+static fs_ops_t ext2_file_ro_ops = {
+    .readpage = ext2_readpage,
+    .release  = ext2_release,
+};
+
+static fs_ops_t ext2_link_ops = {
+    .read    = ext2_readlink,
+    .release = ext2_release,
+};
+
+static fs_ops_t ext2_special_ops = {
+    .release = ext2_release,
+};
+
+/*
+ * ===========================================================================
+ * Mounting
+ * ===========================================================================
+ */
+
+static void fs_free(ext2_fs_t *fs) {
+    for (uint32_t i = 0; i < EXT2_BUFS; i++) {
+        if (fs->bufs[i].data) pmm_free_pages((uint32_t)fs->bufs[i].data, 1);
+    }
+    if (fs->gd) pmm_free_pages((uint32_t)fs->gd, pages_for(fs->gd_blocks * fs->bs));
+    if (fs->sb) pmm_free_pages((uint32_t)fs->sb, 1);
+    if (fs->scratch) pmm_free_pages((uint32_t)fs->scratch, 1);
+    pmm_free_pages((uint32_t)fs, pages_for(sizeof(ext2_fs_t)));
+}
+
+static int ext2_mount(superblock_t *sb, const char *source) {
+    block_device_t *dev = block_find(source);
+    if (!dev) return -1;
+
+    ext2_fs_t *fs = (ext2_fs_t *)pmm_alloc_pages(pages_for(sizeof(ext2_fs_t)));
+    if (!fs) return -1;
+    mem_zero(fs, sizeof(ext2_fs_t));
+    fs->dev = dev;
+    wait_queue_init(&fs->wait);
+
+    fs->sb = (ext2_super_t *)pmm_alloc_page();
+    fs->scratch = (uint8_t *)pmm_alloc_page();
+    if (!fs->sb || !fs->scratch ||
+        block_read(dev, EXT2_SUPER_OFFSET / BLOCK_SECTOR_SIZE, fs->sb,
+                   sizeof(ext2_super_t) / BLOCK_SECTOR_SIZE) != 0) {
+        goto fail;
+    }
+
+    /* Blocks up to a page; nothing we would misread or corrupt */
+    ext2_super_t *s = fs->sb;
+    if (s->s_magic != EXT2_MAGIC || s->s_log_block_size > 2 ||
+        !s->s_blocks_per_group || !s->s_inodes_per_group ||
+        s->s_first_data_block >= s->s_blocks_count) {
+        goto fail;
+    }
+    fs->bs = 1024u << s->s_log_block_size;
+    fs->spb = fs->bs / BLOCK_SECTOR_SIZE;
+    fs->ppb = fs->bs / sizeof(uint32_t);
+    fs->inode_size = EXT2_GOOD_OLD_INODE_SIZE;
+    fs->first_ino = EXT2_GOOD_OLD_FIRST_INO;
+    if (s->s_rev_level >= 1) {
+        if (s->s_feature_incompat & ~EXT2_INCOMPAT_SUPP) goto fail;
+        fs->readonly = (s->s_feature_ro_compat & ~EXT2_RO_COMPAT_SUPP) != 0;
+        fs->inode_size = s->s_inode_size;
+        fs->first_ino = s->s_first_ino;
+    }
+    if (fs->inode_size < EXT2_GOOD_OLD_INODE_SIZE || fs->inode_size > fs->bs ||
+        (fs->inode_size & (fs->inode_size - 1)) || (uint64_t)s->s_blocks_count * fs->spb > dev->sectors) {
+        goto fail;
+    }
+    fs->share = fs->bs == PAGE_SIZE && dev->ops->share_page && !fs->readonly;
+
+    fs->groups = (s->s_blocks_count - s->s_first_data_block + s->s_blocks_per_group - 1) /
+                 s->s_blocks_per_group;
+    fs->gd_blocks = (fs->groups * sizeof(ext2_group_desc_t) + fs->bs - 1) / fs->bs;
+    fs->gd = (ext2_group_desc_t *)pmm_alloc_pages(pages_for(fs->gd_blocks * fs->bs));
+    if (!fs->gd || dev_read(fs, s->s_first_data_block + 1, fs->gd, fs->gd_blocks) != 0) {
+        goto fail;
+    }
+
+    ext2_inode_t raw;
+    if (inode_read(fs, EXT2_ROOT_INO, &raw) != 0 || (raw.i_mode & EXT2_S_IFMT) != EXT2_S_IFDIR) {
+        goto fail;
+    }
+    fs->root = node_new(fs, NULL, "/", EXT2_ROOT_INO, &raw);
+    if (!fs->root) goto fail;
+    fs->root->parent = fs->root;
+
+    fs->epoch = s->s_wtime > s->s_mtime ? s->s_wtime : s->s_mtime;
+
+    /* Not clean until unmounted */
+    if (!fs->readonly) {
+        s->s_state &= ~EXT2_VALID_FS;
+        s->s_mnt_count++;
+        s->s_mtime = s->s_wtime = fs_time(fs);
+        sb_write(fs);
+    }
+
+    sb->root = fs->root;
+    sb->priv = fs;
+    return 0;
+
+fail:
+    fs_free(fs);
+    return -1;
+}
+
+static void ext2_unmount(superblock_t *sb) {
+    ext2_fs_t *fs = (ext2_fs_t *)sb->priv;
+    if (!fs) return;
+
+    vfs_tree_free(fs->root, node_free);
+
+    fs_lock(fs);
+    if (!fs->readonly) {
+        fs->sb->s_state |= EXT2_VALID_FS;
+        fs->sb->s_wtime = fs_time(fs);
+        sb_write(fs);
+    }
+    fs_unlock(fs);
+    block_flush(fs->dev);
+
+    fs_free(fs);
+    sb->priv = NULL;
+}
+
+static fs_type_t ext2_type = {
+    .name    = "ext2",
+    .mount   = ext2_mount,
+    .unmount = ext2_unmount,
+};
+
+void ext2_init(void) {
+    vfs_register_fs(&ext2_type);
+}
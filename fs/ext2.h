@@ -0,0 +1,152 @@
+/*
+ * ClaudeOS ext2 - On-Disk Format
+ * Worker1 - Shell+FS Claude
+ *
+ * The second extended filesystem as laid out by mke2fs (revision 1).
+ * The disk is cut into block groups; each group has a block bitmap, an
+ * inode bitmap and a slice of the inode table, and groups 0, 1 and the
+ * powers of 3, 5 and 7 also carry a backup of the superblock and the
+ * group descriptor table (sparse_super).
+ */
+
+#ifndef CLAUDEOS_EXT2_H
+#define CLAUDEOS_EXT2_H
+
+#include "../include/types.h"
+
+#define EXT2_MAGIC              0xEF53
+#define EXT2_SUPER_OFFSET       1024    /* Byte offset of the superblock */
+#define EXT2_ROOT_INO           2
+#define EXT2_GOOD_OLD_FIRST_INO 11
+#define EXT2_GOOD_OLD_INODE_SIZE 128
+#define EXT2_NAME_LEN           255
+
+/* Block pointers in an inode */
+#define EXT2_NDIR_BLOCKS        12
+#define EXT2_IND_BLOCK          12
+#define EXT2_DIND_BLOCK         13
+#define EXT2_TIND_BLOCK         14
+#define EXT2_N_BLOCKS           15
+
+/* Features we understand */
+#define EXT2_FEATURE_INCOMPAT_FILETYPE      0x0002
+#define EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER 0x0001
+#define EXT2_FEATURE_RO_COMPAT_LARGE_FILE   0x0002
+
+/* s_state */
+#define EXT2_VALID_FS           0x0001
+
+/* i_flags: directory has a hash index (ignored, cleared on change) */
+#define EXT2_INDEX_FL           0x00001000
+
+/* First word of an extended attribute block; the second is its refcount */
+#define EXT2_XATTR_MAGIC        0xEA020000
+
+/* i_mode */
+#define EXT2_S_IFMT             0xF000
+#define EXT2_S_IFREG            0x8000
+#define EXT2_S_IFDIR            0x4000
+#define EXT2_S_IFLNK            0xA000
+
+/* Directory entry file types (with the filetype feature) */
+#define EXT2_FT_UNKNOWN         0
+#define EXT2_FT_REG_FILE        1
+#define EXT2_FT_DIR             2
+#define EXT2_FT_SYMLINK         7
+
+typedef struct {
+    uint32_t s_inodes_count;
+    uint32_t s_blocks_count;
+    uint32_t s_r_blocks_count;
+    uint32_t s_free_blocks_count;
+    uint32_t s_free_inodes_count;
+    uint32_t s_first_data_block;
+    uint32_t s_log_block_size;          /* Block size is 1024 << this */
+    uint32_t s_log_frag_size;
+    uint32_t s_blocks_per_group;
+    uint32_t s_frags_per_group;
+    uint32_t s_inodes_per_group;
+    uint32_t s_mtime;
+    uint32_t s_wtime;
+    uint16_t s_mnt_count;
+    uint16_t s_max_mnt_count;
+    uint16_t s_magic;
+    uint16_t s_state;                   /* EXT2_VALID_FS when cleanly unmounted */
+    uint16_t s_errors;
+    uint16_t s_minor_rev_level;
+    uint32_t s_lastcheck;
+    uint32_t s_checkinterval;
+    uint32_t s_creator_os;
+    uint32_t s_rev_level;
+    uint16_t s_def_resuid;
+    uint16_t s_def_resgid;
+    /* Revision 1 */
+    uint32_t s_first_ino;
+    uint16_t s_inode_size;
+    uint16_t s_block_group_nr;
+    uint32_t s_feature_compat;
+    uint32_t s_feature_incompat;
+    uint32_t s_feature_ro_compat;
+    uint8_t  s_uuid[16];
+    char     s_volume_name[16];
+    char     s_last_mounted[64];
+    uint32_t s_algo_bitmap;
+    uint8_t  s_padding[820];            /* To 1024 bytes */
+} __attribute__((packed)) ext2_super_t;
+
+typedef struct {
+    uint32_t bg_block_bitmap;
+    uint32_t bg_inode_bitmap;
+    uint32_t bg_inode_table;
+    uint16_t bg_free_blocks_count;
+    uint16_t bg_free_inodes_count;
+    uint16_t bg_used_dirs_count;
+    uint16_t bg_pad;
+    uint32_t bg_reserved[3];
+} __attribute__((packed)) ext2_group_desc_t;
+
+typedef struct {
+    uint16_t i_mode;
+    uint16_t i_uid;
+    uint32_t i_size;
+    uint32_t i_atime;
+    uint32_t i_ctime;
+    uint32_t i_mtime;
+    uint32_t i_dtime;
+    uint16_t i_gid;
+    uint16_t i_links_count;
+    uint32_t i_blocks;                  /* In 512-byte units */
+    uint32_t i_flags;
+    uint32_t i_osd1;
+    uint32_t i_block[EXT2_N_BLOCKS];
+    uint32_t i_generation;
+    uint32_t i_file_acl;
+    uint32_t i_size_high;               /* i_dir_acl before large_file */
+    uint32_t i_faddr;
+    uint8_t  i_osd2[12];
+} __attribute__((packed)) ext2_inode_t;
+
+typedef struct {
+    uint32_t inode;                     /* 0 = unused entry */
+    uint16_t rec_len;                   /* To the next entry */
+    uint8_t  name_len;
+    uint8_t  file_type;                 /* High byte of name_len without filetype */
+    char     name[];
+} __attribute__((packed)) ext2_dirent_t;
+
+/* Header size of a directory entry, and its size with a name, rounded to 4 */
+#define EXT2_DIRENT_HEADER      8
+#define EXT2_DIRENT_SIZE(len)   ((EXT2_DIRENT_HEADER + (len) + 3) & ~3u)
+
+/* Does group 'g' hold a superblock backup under sparse_super? */
+static inline int ext2_group_has_super(uint32_t g) {
+    if (g <= 1) return 1;
+    for (uint32_t base = 3; base <= 7; base += 2) {
+        uint32_t n = base;
+        while (n < g) n *= base;
+        if (n == g) return 1;
+    }
+    return 0;
+}
+
+#endif /* CLAUDEOS_EXT2_H */
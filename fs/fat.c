@@ -0,0 +1,1609 @@
+/*
+ * ClaudeOS FAT32 Filesystem - Implementation
+ * Worker1 - Shell+FS Claude
+ *
+ * Mounts a FAT32 volume read-write, long file names included, for
+ * trading files with other systems:
+ *
+ *   mount vfat /dev/hdb /mnt
+ *
+ * The FAT is read a page (1024 entries) at a time into a small cache
+ * per mount, and a file's cluster chain is walked once, when it is
+ * first opened, into a list of extents (runs of consecutive clusters).
+ * From then on finding a cluster is a binary search over the extents;
+ * a file written in one go is a single extent however large it is.
+ *
+ * File data goes through the page cache. readpages turns a batch of
+ * pages into bios that the block layer merges into one request per
+ * extent, so a large sequential read reaches the device as requests of
+ * many clusters each; writepages does the same for write-back. New
+ * clusters are taken from the FSInfo hint onwards, right after the
+ * file's last cluster when that is free.
+ *
+ * The disk is brought up to date before every operation returns, FAT
+ * copies included; the FSInfo free count is written at unmount. Names
+ * are matched without regard to case, and characters outside ASCII in
+ * long names read as '?'. Names past FS_NAME_MAX - 1 characters cannot
+ * be reached.
+ */
+
+#include "vfs.h"
+#include "dcache.h"
+#include "mount.h"
+#include "names.h"
+#include "pagecache.h"
+#include "fat.h"
+#include "../include/block.h"
+#include "../include/pmm.h"
+#include "../include/slab.h"
+#include "../include/process.h"
+#include "../include/timer.h"
+#include "../include/idt.h"
+
+#define FAT_BUFS            16      /* FAT pages cached per mount */
+#define FAT_PER_PAGE        (PAGE_SIZE / sizeof(uint32_t))
+#define FAT_DIR_INLINE      8       /* Children before the array moves to pages */
+#define FAT_INLINE_EXTENTS  4       /* Extents before the list moves to pages */
+#define FAT_LFN_SLOTS       20      /* Long name entries for FAT_LFN_MAX chars */
+#define FAT_EPOCH_DATE      0x0021  /* 1980-01-01: there is no wall clock */
+
+static void mem_zero(void *dst, uint32_t n) {
+    char *d = (char *)dst;
+    while (n--) *d++ = 0;
+}
+
+static void mem_copy(void *dst, const void *src, uint32_t n) {
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    while (n--) *d++ = *s++;
+}
+
+static int mem_eq(const char *a, const char *b, uint32_t n) {
+    while (n--) {
+        if (*a++ != *b++) return 0;
+    }
+    return 1;
+}
+
+static uint32_t str_len(const char *s) {
+    uint32_t len = 0;
+    while (s[len]) len++;
+    return len;
+}
+
+static char to_upper(char c) {
+    return (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+}
+
+static char to_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+/* FAT names compare without regard to case */
+static int name_eq(const char *a, const char *b) {
+    while (*a && to_upper(*a) == to_upper(*b)) { a++; b++; }
+    return *a == *b;
+}
+
+static uint32_t pages_for(uint32_t bytes) {
+    return PAGE_ALIGN(bytes) >> PAGE_SHIFT;
+}
+
+/*
+ * ===========================================================================
+ * Mount State
+ * ===========================================================================
+ */
+
+/* One cached page of the FAT */
+typedef struct {
+    uint32_t index;             /* Page of the FAT it holds */
+    bool valid;
+    bool dirty;
+    bool referenced;            /* Second chance for the clock */
+    uint32_t *data;             /* One page frame */
+} fat_buf_t;
+
+typedef struct {
+    block_device_t *dev;
+    uint32_t cluster_size;      /* Bytes */
+    uint32_t cluster_sectors;   /* In device (512-byte) sectors */
+    uint32_t cluster_shift;     /* log2 of cluster_sectors */
+    uint64_t fat_start;         /* Device sector of the first FAT */
+    uint32_t fat_sectors;       /* Per copy, in device sectors */
+    uint32_t fats;              /* Copies written on every change */
+    uint32_t active_fat;        /* The copy that is read */
+    uint64_t data_start;        /* Device sector of cluster 2 */
+    uint32_t clusters;          /* Data clusters: 2 .. clusters + 1 */
+    uint32_t root_cluster;
+    uint64_t fsinfo;            /* Device sector of FSInfo, 0 if none */
+    uint32_t free_count;        /* FAT_FSINFO_UNKNOWN until counted */
+    uint32_t next_free;         /* Allocation hint */
+    bool fsinfo_dirty;
+    uint32_t next_ino;
+    uint32_t busy;              /* An operation is running */
+    wait_queue_t wait;
+    fat_buf_t bufs[FAT_BUFS];
+    uint32_t clock;
+    uint8_t *scratch;           /* One page for directory I/O */
+    fs_node_t *root;
+} fat_fs_t;
+
+/* A run of consecutive clusters */
+typedef struct {
+    uint32_t lclus;             /* Its first cluster's index in the file */
+    uint32_t pclus;             /* That cluster's number on disk */
+    uint32_t count;
+} fat_extent_t;
+
+/* Per-node state (node->data) */
+typedef struct {
+    fat_fs_t *fs;
+    uint32_t first;             /* First cluster, 0 for an empty file */
+    uint32_t slot;              /* Short entry's index in the parent */
+    uint32_t lfn;               /* Long name entries just before it */
+    uint32_t valid;             /* Files: bytes on disk that were written */
+    bool loaded;                /* Directories: children read in */
+    bool mapped;                /* The chain is in 'extents' */
+    uint32_t clusters;          /* Length of the chain, once mapped */
+    uint32_t nextents;
+    uint32_t ext_capacity;
+    fat_extent_t *extents;
+    fat_extent_t inline_extents[FAT_INLINE_EXTENTS];
+    uint32_t capacity;          /* Directories: slots in node->children */
+    fs_node_t *inline_children[FAT_DIR_INLINE];
+    fat_dirent_t entry;         /* The short entry as on disk */
+} fat_node_t;
+
+static slab_t node_slab = SLAB_INIT(fs_node_t);
+static slab_t info_slab = SLAB_INIT(fat_node_t);
+
+static fs_ops_t fat_dir_ops;
+static fs_ops_t fat_file_ops;
+
+/* Device sector of a data cluster */
+static uint64_t cluster_sector(fat_fs_t *fs, uint32_t cluster) {
+    return fs->data_start + ((uint64_t)(cluster - FAT_FIRST_CLUSTER) << fs->cluster_shift);
+}
+
+static bool cluster_ok(fat_fs_t *fs, uint32_t cluster) {
+    return cluster >= FAT_FIRST_CLUSTER && cluster < fs->clusters + FAT_FIRST_CLUSTER;
+}
+
+/* Seconds of the day for modification times; the date stays at the epoch */
+static uint16_t fat_time(void) {
+    uint32_t s = timer_get_uptime_seconds() % 86400;
+    return (uint16_t)(((s / 3600) << 11) | (((s / 60) % 60) << 5) | ((s % 60) / 2));
+}
+
+/*
+ * ===========================================================================
+ * The File Allocation Table
+ * ===========================================================================
+ */
+
+static int fat_buf_write(fat_fs_t *fs, fat_buf_t *b) {
+    if (!b->dirty) return 0;
+
+    uint32_t first = b->index * (PAGE_SIZE / BLOCK_SECTOR_SIZE);
+    uint32_t count = fs->fat_sectors - first;
+    if (count > PAGE_SIZE / BLOCK_SECTOR_SIZE) count = PAGE_SIZE / BLOCK_SECTOR_SIZE;
+
+    int status = 0;
+    for (uint32_t copy = 0; copy < fs->fats; copy++) {
+        uint64_t sector = fs->fat_start + (uint64_t)copy * fs->fat_sectors + first;
+        if (block_write(fs->dev, sector, b->data, count) != 0) status = -1;
+    }
+    if (status == 0) b->dirty = false;
+    return status;
+}
+
+/*
+ * The cached FAT page 'index', read in on a miss. Pages are reused in
+ * clock order, dirty ones written back first.
+ */
+static uint32_t *fat_page(fat_fs_t *fs, uint32_t index) {
+    for (uint32_t i = 0; i < FAT_BUFS; i++) {
+        fat_buf_t *b = &fs->bufs[i];
+        if (b->valid && b->index == index) {
+            b->referenced = true;
+            return b->data;
+        }
+    }
+
+    fat_buf_t *b = NULL;
+    for (uint32_t scanned = 0; scanned < 2 * FAT_BUFS && !b; scanned++) {
+        fat_buf_t *c = &fs->bufs[fs->clock];
+        fs->clock = (fs->clock + 1) % FAT_BUFS;
+        if (c->valid && c->referenced) {
+            c->referenced = false;
+            continue;
+        }
+        b = c;
+    }
+    if (b->valid && fat_buf_write(fs, b) != 0) return NULL;
+
+    b->valid = false;
+    if (!b->data) {
+        b->data = (uint32_t *)pmm_alloc_page();
+        if (!b->data) return NULL;
+    }
+
+    uint32_t first = index * (PAGE_SIZE / BLOCK_SECTOR_SIZE);
+    uint32_t count = fs->fat_sectors - first;
+    if (count > PAGE_SIZE / BLOCK_SECTOR_SIZE) count = PAGE_SIZE / BLOCK_SECTOR_SIZE;
+    uint64_t sector = fs->fat_start + (uint64_t)fs->active_fat * fs->fat_sectors + first;
+    if (count < PAGE_SIZE / BLOCK_SECTOR_SIZE) mem_zero(b->data, PAGE_SIZE);
+    if (block_read(fs->dev, sector, b->data, count) != 0) return NULL;
+
+    b->index = index;
+    b->valid = true;
+    b->dirty = false;
+    b->referenced = true;
+    return b->data;
+}
+
+/* Next cluster after 'cluster', FAT_EOC at the end; 1 on a read error */
+static uint32_t fat_get(fat_fs_t *fs, uint32_t cluster) {
+    uint32_t *page = fat_page(fs, cluster / FAT_PER_PAGE);
+    if (!page) return 1;
+    uint32_t next = page[cluster % FAT_PER_PAGE] & FAT_ENTRY_MASK;
+    return next >= FAT_EOC ? FAT_EOC : next;
+}
+
+static int fat_set(fat_fs_t *fs, uint32_t cluster, uint32_t value) {
+    uint32_t index = cluster / FAT_PER_PAGE;
+    uint32_t *page = fat_page(fs, index);
+    if (!page) return -1;
+
+    /* The top four bits are reserved and kept */
+    uint32_t *entry = &page[cluster % FAT_PER_PAGE];
+    *entry = (*entry & ~FAT_ENTRY_MASK) | (value & FAT_ENTRY_MASK);
+    for (uint32_t i = 0; i < FAT_BUFS; i++) {
+        if (fs->bufs[i].valid && fs->bufs[i].index == index) fs->bufs[i].dirty = true;
+    }
+    return 0;
+}
+
+static int fat_commit(fat_fs_t *fs) {
+    int status = 0;
+    for (uint32_t i = 0; i < FAT_BUFS; i++) {
+        fat_buf_t *b = &fs->bufs[i];
+        if (b->valid && fat_buf_write(fs, b) != 0) status = -1;
+    }
+    return status;
+}
+
+/*
+ * Take the first free cluster at or after 'goal', wrapping around; a
+ * goal of 0 starts at the FSInfo hint. The new cluster ends a chain.
+ * Returns 0 when the volume is full.
+ */
+static uint32_t cluster_alloc(fat_fs_t *fs, uint32_t goal) {
+    if (fs->free_count == 0) return 0;
+    if (!cluster_ok(fs, goal)) goal = fs->next_free;
+    if (!cluster_ok(fs, goal)) goal = FAT_FIRST_CLUSTER;
+
+    uint32_t end = fs->clusters + FAT_FIRST_CLUSTER;
+    uint32_t c = goal;
+    for (uint32_t scanned = 0; scanned < fs->clusters; ) {
+        uint32_t *page = fat_page(fs, c / FAT_PER_PAGE);
+        if (!page) return 0;
+
+        /* The rest of this FAT page, in one pass */
+        uint32_t stop = (c / FAT_PER_PAGE + 1) * FAT_PER_PAGE;
+        if (stop > end) stop = end;
+        for (; c < stop; c++, scanned++) {
+            if ((page[c % FAT_PER_PAGE] & FAT_ENTRY_MASK) != FAT_FREE) continue;
+            if (fat_set(fs, c, FAT_EOC_MARK) != 0) return 0;
+            if (fs->free_count != FAT_FSINFO_UNKNOWN) fs->free_count--;
+            fs->next_free = c + 1;
+            fs->fsinfo_dirty = true;
+            return c;
+        }
+        if (c == end) c = FAT_FIRST_CLUSTER;
+    }
+    fs->free_count = 0;
+    return 0;
+}
+
+static void cluster_free(fat_fs_t *fs, uint32_t cluster) {
+    if (!cluster_ok(fs, cluster) || fat_set(fs, cluster, FAT_FREE) != 0) return;
+    if (fs->free_count != FAT_FSINFO_UNKNOWN) fs->free_count++;
+    fs->fsinfo_dirty = true;
+}
+
+/* Operations on one mount run one at a time; I/O sleeps inside them */
+static void fs_lock(fat_fs_t *fs) {
+    uint32_t irq = irq_save();
+    while (fs->busy) {
+        wait_queue_sleep(&fs->wait);
+    }
+    fs->busy = 1;
+    irq_restore(irq);
+}
+
+static int fs_unlock(fat_fs_t *fs) {
+    int status = fat_commit(fs);
+
+    uint32_t irq = irq_save();
+    fs->busy = 0;
+    wait_queue_wake_all(&fs->wait);
+    irq_restore(irq);
+    return status;
+}
+
+/*
+ * ===========================================================================
+ * Cluster Chains
+ * ===========================================================================
+ */
+
+static void extents_free(fat_node_t *fn) {
+    if (fn->ext_capacity > FAT_INLINE_EXTENTS) {
+        pmm_free_pages((uint32_t)fn->extents, pages_for(fn->ext_capacity * sizeof(fat_extent_t)));
+    }
+    fn->extents = fn->inline_extents;
+    fn->ext_capacity = FAT_INLINE_EXTENTS;
+    fn->nextents = 0;
+    fn->clusters = 0;
+    fn->mapped = false;
+}
+
+/* Add 'cluster' as the next cluster of the chain */
+static int extent_append(fat_node_t *fn, uint32_t cluster) {
+    fat_extent_t *last = fn->nextents ? &fn->extents[fn->nextents - 1] : NULL;
+    if (last && last->pclus + last->count == cluster) {
+        last->count++;
+        fn->clusters++;
+        return 0;
+    }
+
+    if (fn->nextents == fn->ext_capacity) {
+        uint32_t capacity = fn->ext_capacity * 2;
+        fat_extent_t *extents = (fat_extent_t *)pmm_alloc_pages(pages_for(capacity * sizeof(fat_extent_t)));
+        if (!extents) return -1;
+        mem_copy(extents, fn->extents, fn->nextents * sizeof(fat_extent_t));
+        if (fn->ext_capacity > FAT_INLINE_EXTENTS) {
+            pmm_free_pages((uint32_t)fn->extents, pages_for(fn->ext_capacity * sizeof(fat_extent_t)));
+        }
+        fn->extents = extents;
+        fn->ext_capacity = capacity;
+    }
+
+    fat_extent_t *e = &fn->extents[fn->nextents++];
+    e->lclus = fn->clusters;
+    e->pclus = cluster;
+    e->count = 1;
+    fn->clusters++;
+    return 0;
+}
+
+/* Walk the chain from the FAT into extents, the first time it is needed */
+static int chain_load(fat_node_t *fn) {
+    if (fn->mapped) return 0;
+    fat_fs_t *fs = fn->fs;
+
+    extents_free(fn);
+    for (uint32_t c = fn->first; c; ) {
+        /* A chain longer than the volume has a loop in it */
+        if (!cluster_ok(fs, c) || fn->clusters == fs->clusters || extent_append(fn, c) != 0) {
+            extents_free(fn);
+            return -1;
+        }
+        uint32_t next = fat_get(fs, c);
+        c = next == FAT_EOC ? 0 : next;
+        if (c == 1) {
+            extents_free(fn);
+            return -1;
+        }
+    }
+    fn->mapped = true;
+    return 0;
+}
+
+/*
+ * Disk cluster of cluster 'lclus' of the file, and in *run how many
+ * clusters from there on are consecutive on disk. 0 past the end.
+ */
+static uint32_t extent_find(fat_node_t *fn, uint32_t lclus, uint32_t *run) {
+    if (lclus >= fn->clusters) return 0;
+
+    uint32_t lo = 0, hi = fn->nextents;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (fn->extents[mid].lclus <= lclus) lo = mid;
+        else hi = mid;
+    }
+    fat_extent_t *e = &fn->extents[lo];
+    *run = e->count - (lclus - e->lclus);
+    return e->pclus + (lclus - e->lclus);
+}
+
+/* Grow a mapped chain to 'clusters', each new one after the last */
+static int chain_grow(fat_node_t *fn, uint32_t clusters) {
+    fat_fs_t *fs = fn->fs;
+    while (fn->clusters < clusters) {
+        fat_extent_t *last = fn->nextents ? &fn->extents[fn->nextents - 1] : NULL;
+        uint32_t tail = last ? last->pclus + last->count - 1 : 0;
+
+        uint32_t c = cluster_alloc(fs, tail ? tail + 1 : 0);
+        if (!c) return -1;
+        if ((tail ? fat_set(fs, tail, c) : 0) != 0 || extent_append(fn, c) != 0) {
+            if (tail) fat_set(fs, tail, FAT_EOC_MARK);
+            cluster_free(fs, c);
+            return -1;
+        }
+        if (!tail) fn->first = c;
+    }
+    return 0;
+}
+
+/* Cut a mapped chain down to 'clusters', freeing the rest */
+static void chain_trim(fat_node_t *fn, uint32_t clusters) {
+    fat_fs_t *fs = fn->fs;
+    if (clusters >= fn->clusters) return;
+
+    uint32_t run;
+    if (clusters) {
+        fat_set(fs, extent_find(fn, clusters - 1, &run), FAT_EOC_MARK);
+    } else {
+        fn->first = 0;
+    }
+
+    while (fn->nextents) {
+        fat_extent_t *e = &fn->extents[fn->nextents - 1];
+        uint32_t keep = e->lclus < clusters ? clusters - e->lclus : 0;
+        for (uint32_t i = keep; i < e->count; i++) {
+            cluster_free(fs, e->pclus + i);
+        }
+        if (keep) {
+            e->count = keep;
+            break;
+        }
+        fn->nextents--;
+    }
+    fn->clusters = clusters;
+}
+
+static uint32_t clusters_for(fat_fs_t *fs, uint32_t bytes) {
+    return (bytes + fs->cluster_size - 1) / fs->cluster_size;
+}
+
+/*
+ * ===========================================================================
+ * Data Transfers
+ * ===========================================================================
+ */
+
+/*
+ * A batch of transfers. Pieces that follow each other on disk share a
+ * bio, and the device stays plugged until the end, so the block layer
+ * merges the bios of one extent into a single request.
+ */
+typedef struct {
+    fat_fs_t *fs;
+    uint32_t op;
+    bio_t *bio;                 /* Being filled */
+    bio_t *first;               /* Submitted, linked through priv */
+    bio_t **link;
+    int status;
+} fat_io_t;
+
+static void io_begin(fat_io_t *io, fat_fs_t *fs, bool write) {
+    io->fs = fs;
+    io->op = write ? BIO_WRITE : BIO_READ;
+    io->bio = NULL;
+    io->first = NULL;
+    io->link = &io->first;
+    io->status = 0;
+    block_plug(fs->dev);
+}
+
+static void io_submit(fat_io_t *io) {
+    if (!io->bio) return;
+    *io->link = io->bio;
+    io->link = (bio_t **)&io->bio->priv;
+    block_submit(io->bio);
+    io->bio = NULL;
+}
+
+/* Queue 'len' bytes (whole sectors) at device sector 'sector' */
+static void io_add(fat_io_t *io, uint64_t sector, uint32_t addr, uint32_t len) {
+    block_device_t *dev = io->fs->dev;
+    uint32_t max_segs = dev->max_segs < BIO_MAX_SEGS ? dev->max_segs : BIO_MAX_SEGS;
+
+    while (len > 0 && io->status == 0) {
+        bio_t *bio = io->bio;
+        uint32_t have = bio ? bio_sectors(bio) : 0;
+        if (bio && (bio->sector + have != sector || have >= dev->max_sectors ||
+                    (bio->nsegs == max_segs &&
+                     bio->segs[bio->nsegs - 1].addr + bio->segs[bio->nsegs - 1].len != addr))) {
+            io_submit(io);
+            bio = NULL;
+            have = 0;
+        }
+        if (!bio) {
+            bio = io->bio = bio_alloc();
+            if (!bio) {
+                io->status = -1;
+                return;
+            }
+            bio->dev = dev;
+            bio->op = io->op;
+            bio->sector = sector;
+            bio->nsegs = 0;
+        }
+
+        uint32_t chunk = (dev->max_sectors - have) << BLOCK_SECTOR_SHIFT;
+        if (chunk > len) chunk = len;
+        bio_seg_t *seg = bio->nsegs ? &bio->segs[bio->nsegs - 1] : NULL;
+        if (seg && seg->addr + seg->len == addr) {
+            seg->len += chunk;
+        } else {
+            seg = &bio->segs[bio->nsegs++];
+            seg->addr = addr;
+            seg->len = chunk;
+        }
+        sector += chunk >> BLOCK_SECTOR_SHIFT;
+        addr += chunk;
+        len -= chunk;
+    }
+}
+
+static int io_end(fat_io_t *io) {
+    io_submit(io);
+    block_unplug(io->fs->dev);
+
+    while (io->first) {
+        bio_t *next = (bio_t *)io->first->priv;
+        block_wait(io->first);
+        if (io->first->status != 0) io->status = -1;
+        bio_free(io->first);
+        io->first = next;
+    }
+    return io->status;
+}
+
+/* Queue bytes [pos, pos + len) of a mapped file (whole sectors) */
+static int io_file(fat_io_t *io, fat_node_t *fn, uint32_t pos, uint32_t addr, uint32_t len) {
+    fat_fs_t *fs = fn->fs;
+    while (len > 0) {
+        uint32_t run;
+        uint32_t cluster = extent_find(fn, pos / fs->cluster_size, &run);
+        if (!cluster) return -1;
+
+        uint32_t in = pos % fs->cluster_size;
+        uint32_t chunk = run * fs->cluster_size - in;
+        if (chunk > len) chunk = len;
+        io_add(io, cluster_sector(fs, cluster) + (in >> BLOCK_SECTOR_SHIFT), addr, chunk);
+        pos += chunk;
+        addr += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+/* Synchronous transfer of bytes [pos, pos + len) of a mapped file */
+static int file_io(fat_node_t *fn, uint32_t pos, void *buf, uint32_t len, bool write) {
+    fat_io_t io;
+    io_begin(&io, fn->fs, write);
+    int status = io_file(&io, fn, pos, (uint32_t)buf, len);
+    if (io_end(&io) != 0) status = -1;
+    return status;
+}
+
+static uint32_t sector_up(uint32_t bytes) {
+    return (bytes + BLOCK_SECTOR_SIZE - 1) & ~(BLOCK_SECTOR_SIZE - 1);
+}
+
+/* Zero bytes [from, to) of a mapped file on disk */
+static int zero_range(fat_node_t *fn, uint32_t from, uint32_t to) {
+    fat_fs_t *fs = fn->fs;
+    if (from >= to) return 0;
+
+    /* The sector 'from' falls in keeps what comes before it */
+    uint32_t in = from % BLOCK_SECTOR_SIZE;
+    if (in) {
+        uint32_t at = from - in;
+        if (file_io(fn, at, fs->scratch, BLOCK_SECTOR_SIZE, false) != 0) return -1;
+        mem_zero(fs->scratch + in, BLOCK_SECTOR_SIZE - in);
+        if (file_io(fn, at, fs->scratch, BLOCK_SECTOR_SIZE, true) != 0) return -1;
+        from = at + BLOCK_SECTOR_SIZE;
+    }
+
+    mem_zero(fs->scratch, PAGE_SIZE);
+    to = sector_up(to);
+    while (from < to) {
+        uint32_t chunk = to - from < PAGE_SIZE ? to - from : PAGE_SIZE;
+        if (file_io(fn, from, fs->scratch, chunk, true) != 0) return -1;
+        from += chunk;
+    }
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Nodes
+ * ===========================================================================
+ */
+
+/* A node for directory entry 'de' named 'name' in 'parent' (not linked in yet) */
+static fs_node_t *node_new(fat_fs_t *fs, fs_node_t *parent, const char *name,
+                           const fat_dirent_t *de, uint32_t slot, uint32_t lfn) {
+    fs_node_t *node = (fs_node_t *)slab_alloc(&node_slab);
+    fat_node_t *fn = (fat_node_t *)slab_alloc(&info_slab);
+    const char *interned = name_intern(name);
+    if (!node || !fn || !interned) {
+        if (node) slab_free(&node_slab, node);
+        if (fn) slab_free(&info_slab, fn);
+        if (interned) name_release(interned);
+        return NULL;
+    }
+
+    fn->fs = fs;
+    fn->entry = *de;
+    fn->first = fat_dirent_cluster(de);
+    fn->slot = slot;
+    fn->lfn = lfn;
+    fn->extents = fn->inline_extents;
+    fn->ext_capacity = FAT_INLINE_EXTENTS;
+
+    node->name = interned;
+    node->parent = parent;
+    node->data = fn;
+    node->inode = ++fs->next_ino;
+
+    if (de->attr & FAT_ATTR_DIRECTORY) {
+        node->type = FS_DIRECTORY;
+        node->ops = &fat_dir_ops;
+        node->children = fn->inline_children;
+        fn->capacity = FAT_DIR_INLINE;
+    } else {
+        node->type = FS_FILE;
+        node->ops = &fat_file_ops;
+        node->size = de->size;
+        fn->valid = de->size;
+    }
+    return node;
+}
+
+static void node_free(fs_node_t *node) {
+    fat_node_t *fn = (fat_node_t *)node->data;
+    if (node->type == FS_DIRECTORY && fn->capacity > FAT_DIR_INLINE) {
+        pmm_free_pages((uint32_t)node->children, pages_for(fn->capacity * sizeof(fs_node_t *)));
+    }
+    extents_free(fn);
+    name_release(node->name);
+    slab_free(&info_slab, fn);
+    slab_free(&node_slab, node);
+}
+
+/* Make room for one more child in a directory's array */
+static int child_reserve(fs_node_t *dir) {
+    fat_node_t *dn = (fat_node_t *)dir->data;
+    if ((uint32_t)dir->child_count < dn->capacity) return 0;
+
+    uint32_t capacity = dn->capacity * 2;
+    fs_node_t **children = (fs_node_t **)pmm_alloc_pages(pages_for(capacity * sizeof(fs_node_t *)));
+    if (!children) return -1;
+    for (int i = 0; i < dir->child_count; i++) {
+        children[i] = dir->children[i];
+    }
+    if (dn->capacity > FAT_DIR_INLINE) {
+        pmm_free_pages((uint32_t)dir->children, pages_for(dn->capacity * sizeof(fs_node_t *)));
+    }
+    dir->children = children;
+    dn->capacity = capacity;
+    return 0;
+}
+
+/*
+ * The dcache is keyed on the spelling that was looked up, and any
+ * spelling of a FAT name finds it: a change to the directory has to
+ * forget every name cached under it, not just the one it touched.
+ */
+static void child_add(fs_node_t *dir, fs_node_t *child) {
+    dir->children[dir->child_count++] = child;
+    dcache_invalidate_node(dir);
+}
+
+static void child_remove(fs_node_t *dir, fs_node_t *child) {
+    int pos = 0;
+    while (dir->children[pos] != child) pos++;
+    dir->children[pos] = dir->children[--dir->child_count];
+    dir->children[dir->child_count] = NULL;
+    dcache_invalidate_node(dir);
+}
+
+static fs_node_t *child_find(fs_node_t *dir, const char *name) {
+    for (int i = 0; i < dir->child_count; i++) {
+        if (name_eq(dir->children[i]->name, name)) return dir->children[i];
+    }
+    return NULL;
+}
+
+/* Take a removed node out of the namespace; it is freed on last put */
+static void detach(fs_node_t *dir, fs_node_t *child) {
+    child_remove(dir, child);
+    child->parent = NULL;
+    child->flags |= FS_UNLINKED;
+}
+
+/*
+ * ===========================================================================
+ * Directory Entries
+ * ===========================================================================
+ */
+
+/* Entries of a mapped directory */
+static uint32_t dir_slots(fat_node_t *dn) {
+    return dn->clusters * (dn->fs->cluster_size / FAT_DIRENT_SIZE);
+}
+
+/*
+ * Store 'count' entries from slot 'slot' on, a sector at a time; with
+ * 'ents' NULL they are marked free instead.
+ */
+static int slots_write(fat_node_t *dn, uint32_t slot, const fat_dirent_t *ents, uint32_t count) {
+    fat_fs_t *fs = dn->fs;
+    uint32_t per = BLOCK_SECTOR_SIZE / FAT_DIRENT_SIZE;
+
+    while (count > 0) {
+        uint32_t at = slot / per * BLOCK_SECTOR_SIZE;
+        if (file_io(dn, at, fs->scratch, BLOCK_SECTOR_SIZE, false) != 0) return -1;
+
+        fat_dirent_t *de = (fat_dirent_t *)fs->scratch;
+        for (; count > 0 && slot / per * BLOCK_SECTOR_SIZE == at; slot++, count--) {
+            if (ents) {
+                de[slot % per] = *ents++;
+            } else {
+                de[slot % per].name[0] = (char)FAT_DIRENT_FREE;
+            }
+        }
+        if (file_io(dn, at, fs->scratch, BLOCK_SECTOR_SIZE, true) != 0) return -1;
+    }
+    return 0;
+}
+
+static int slot_read(fat_node_t *dn, uint32_t slot, fat_dirent_t *de) {
+    uint32_t per = BLOCK_SECTOR_SIZE / FAT_DIRENT_SIZE;
+    if (file_io(dn, slot / per * BLOCK_SECTOR_SIZE, dn->fs->scratch, BLOCK_SECTOR_SIZE, false) != 0) {
+        return -1;
+    }
+    *de = ((fat_dirent_t *)dn->fs->scratch)[slot % per];
+    return 0;
+}
+
+/*
+ * Rewrite a node's short entry (size, first cluster, times). The FAT
+ * goes first, so the entry never points into clusters marked free.
+ */
+static int entry_write(fs_node_t *node) {
+    fat_node_t *fn = (fat_node_t *)node->data;
+    fat_fs_t *fs = fn->fs;
+    if (node == fs->root || !node->parent) return 0;
+
+    fn->entry.cluster_hi = (uint16_t)(fn->first >> 16);
+    fn->entry.cluster_lo = (uint16_t)fn->first;
+    if (fat_commit(fs) != 0) return -1;
+    return slots_write((fat_node_t *)node->parent->data, fn->slot, &fn->entry, 1);
+}
+
+/* A short name as shown: "NAME.EXT", lowercased where the NT flags say so */
+static void short_name(const fat_dirent_t *de, char *out) {
+    uint32_t len = 0;
+    for (int i = 0; i < 8 && de->name[i] != ' '; i++) {
+        char c = (i == 0 && (uint8_t)de->name[0] == FAT_DIRENT_KANJI) ? (char)FAT_DIRENT_FREE : de->name[i];
+        out[len++] = (de->nt_res & FAT_NT_BASE_LOWER) ? to_lower(c) : c;
+    }
+    if (de->name[8] != ' ') {
+        out[len++] = '.';
+        for (int i = 8; i < 11 && de->name[i] != ' '; i++) {
+            out[len++] = (de->nt_res & FAT_NT_EXT_LOWER) ? to_lower(de->name[i]) : de->name[i];
+        }
+    }
+    out[len] = '\0';
+}
+
+/* Characters of long name part 'lfn' in order; 0 ends the name */
+static uint16_t lfn_char(const fat_lfn_t *lfn, uint32_t i) {
+    if (i < 5) return lfn->name1[i];
+    if (i < 11) return lfn->name2[i - 5];
+    return lfn->name3[i - 11];
+}
+
+static void lfn_set(fat_lfn_t *lfn, uint32_t i, uint16_t c) {
+    if (i < 5) lfn->name1[i] = c;
+    else if (i < 11) lfn->name2[i - 5] = c;
+    else lfn->name3[i - 11] = c;
+}
+
+/* Read a directory's entries into nodes, once */
+static int dir_load(fs_node_t *dir) {
+    fat_node_t *dn = (fat_node_t *)dir->data;
+    fat_fs_t *fs = dn->fs;
+    if (dn->loaded) return 0;
+    if (chain_load(dn) != 0) return -1;
+    dir->size = dn->clusters * fs->cluster_size;
+
+    char name[FAT_LFN_MAX + 1];
+    uint32_t lfn_parts = 0;         /* Parts still expected, 0 = none pending */
+    uint32_t lfn_count = 0;
+    uint8_t lfn_sum = 0;
+    bool lfn_ok = false;
+    uint32_t slots = dir_slots(dn);
+    uint32_t per_page = PAGE_SIZE / FAT_DIRENT_SIZE;
+    int err = 0;
+    bool end = false;
+
+    for (uint32_t base = 0; base < slots && !end && !err; base += per_page) {
+        uint32_t count = slots - base < per_page ? slots - base : per_page;
+        if (file_io(dn, base * FAT_DIRENT_SIZE, fs->scratch, count * FAT_DIRENT_SIZE, false) != 0) {
+            err = 1;
+            break;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            fat_dirent_t *de = (fat_dirent_t *)fs->scratch + i;
+            uint8_t first = (uint8_t)de->name[0];
+            if (first == FAT_DIRENT_END) {
+                end = true;
+                break;
+            }
+            if (first == FAT_DIRENT_FREE) {
+                lfn_ok = false;
+                continue;
+            }
+
+            if ((de->attr & 0x3F) == FAT_ATTR_LFN) {
+                fat_lfn_t *lfn = (fat_lfn_t *)de;
+                uint32_t ord = lfn->ord & 0x1F;
+                if (lfn->ord & FAT_LFN_LAST) {
+                    lfn_parts = ord;
+                    lfn_count = 0;
+                    lfn_sum = lfn->checksum;
+                    lfn_ok = ord > 0 && ord <= FAT_LFN_SLOTS;
+                    if (lfn_ok) name[ord * FAT_LFN_CHARS > FAT_LFN_MAX ? FAT_LFN_MAX : ord * FAT_LFN_CHARS] = '\0';
+                } else if (!lfn_parts || ord != lfn_parts || lfn->checksum != lfn_sum) {
+                    lfn_ok = false;
+                }
+                if (lfn_ok) {
+                    for (uint32_t c = 0; c < FAT_LFN_CHARS; c++) {
+                        uint32_t at = (ord - 1) * FAT_LFN_CHARS + c;
+                        uint16_t ch = lfn_char(lfn, c);
+                        if (at >= FAT_LFN_MAX) break;
+                        if (ch == 0) {
+                            name[at] = '\0';
+                            break;
+                        }
+                        name[at] = ch < 0x80 ? (char)ch : '?';
+                    }
+                    lfn_parts = ord - 1;
+                    lfn_count++;
+                }
+                continue;
+            }
+
+            bool has_lfn = lfn_ok && lfn_parts == 0 && lfn_count &&
+                           fat_lfn_checksum(de->name) == lfn_sum;
+            uint32_t lfn = has_lfn ? lfn_count : 0;
+            lfn_ok = false;
+            lfn_parts = 0;
+            lfn_count = 0;
+
+            if (de->attr & FAT_ATTR_VOLUME_ID) continue;
+            if (!has_lfn) short_name(de, name);
+            if (name[0] == '\0' || (name[0] == '.' && (name[1] == '\0' ||
+                                                       (name[1] == '.' && name[2] == '\0')))) {
+                continue;
+            }
+
+            fs_node_t *child = NULL;
+            if (child_reserve(dir) != 0 || !(child = node_new(fs, dir, name, de, base + i, lfn))) {
+                err = 1;
+                break;
+            }
+            dir->children[dir->child_count++] = child;
+        }
+    }
+
+    /* Lookups that failed before the directory was read are cached too */
+    dcache_invalidate_node(dir);
+    if (err) {
+        /* Start over next time */
+        while (dir->child_count > 0) {
+            node_free(dir->children[--dir->child_count]);
+        }
+        return -1;
+    }
+    dn->loaded = true;
+    return 0;
+}
+
+/*
+ * Find 'count' consecutive free entries, growing the directory by a
+ * zeroed cluster when there are none. Returns the first, or -1.
+ */
+static int32_t slots_find(fat_node_t *dn, uint32_t count) {
+    fat_fs_t *fs = dn->fs;
+    uint32_t slots = dir_slots(dn);
+    uint32_t per_page = PAGE_SIZE / FAT_DIRENT_SIZE;
+    uint32_t run = 0, start = 0;
+
+    for (uint32_t base = 0; base < slots; base += per_page) {
+        uint32_t n = slots - base < per_page ? slots - base : per_page;
+        if (file_io(dn, base * FAT_DIRENT_SIZE, fs->scratch, n * FAT_DIRENT_SIZE, false) != 0) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            uint8_t first = (uint8_t)((fat_dirent_t *)fs->scratch)[i].name[0];
+            if (first == FAT_DIRENT_END) {
+                /* Everything from here on is free */
+                if (!run) start = base + i;
+                run += slots - (base + i);
+                base = slots;
+                break;
+            }
+            if (first != FAT_DIRENT_FREE) {
+                run = 0;
+                continue;
+            }
+            if (!run) start = base + i;
+            if (++run == count) return (int32_t)start;
+        }
+    }
+    if (run >= count) return (int32_t)start;
+
+    /* Grow: new clusters read as the end of the directory */
+    if (!run) start = slots;
+    uint32_t per_cluster = fs->cluster_size / FAT_DIRENT_SIZE;
+    uint32_t more = (count - run + per_cluster - 1) / per_cluster;
+    uint32_t old = dn->clusters;
+    if (chain_grow(dn, old + more) != 0 ||
+        zero_range(dn, old * fs->cluster_size, dn->clusters * fs->cluster_size) != 0) {
+        chain_trim(dn, old);
+        return -1;
+    }
+    return (int32_t)start;
+}
+
+/* Valid in a short name as is */
+static bool short_char(char c) {
+    if ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || (uint8_t)c >= 0x80) return true;
+    const char *extra = "!#$%&'()-@^_`{}~";
+    for (; *extra; extra++) {
+        if (c == *extra) return true;
+    }
+    return false;
+}
+
+/*
+ * Does 'name' fit a short entry exactly (8.3, each part in one case)?
+ * Fills the 11-byte short name and the NT case flags.
+ */
+static bool short_exact(const char *name, char *sn, uint8_t *nt) {
+    uint32_t len = str_len(name);
+    uint32_t dot = len;
+    for (uint32_t i = 0; i < len; i++) {
+        if (name[i] == '.') {
+            if (dot != len) return false;
+            dot = i;
+        }
+    }
+    uint32_t ext = dot < len ? len - dot - 1 : 0;
+    if (dot == 0 || dot > 8 || ext > 3 || (dot < len && ext == 0)) return false;
+
+    *nt = 0;
+    for (int part = 0; part < 2; part++) {
+        uint32_t from = part ? dot + 1 : 0;
+        uint32_t to = part ? len : dot;
+        bool lower = false, upper = false;
+        for (uint32_t i = from; i < to; i++) {
+            char c = name[i];
+            if (c >= 'a' && c <= 'z') lower = true;
+            else if (c >= 'A' && c <= 'Z') upper = true;
+            if (!short_char(to_upper(c))) return false;
+        }
+        if (lower && upper) return false;
+        if (lower) *nt |= part ? FAT_NT_EXT_LOWER : FAT_NT_BASE_LOWER;
+    }
+
+    for (int i = 0; i < 11; i++) sn[i] = ' ';
+    for (uint32_t i = 0; i < dot; i++) sn[i] = to_upper(name[i]);
+    for (uint32_t i = 0; i < ext; i++) sn[8 + i] = to_upper(name[dot + 1 + i]);
+    if ((uint8_t)sn[0] == FAT_DIRENT_FREE) sn[0] = (char)FAT_DIRENT_KANJI;
+    return true;
+}
+
+static bool short_taken(fs_node_t *dir, const char *sn) {
+    for (int i = 0; i < dir->child_count; i++) {
+        if (mem_eq(((fat_node_t *)dir->children[i]->data)->entry.name, sn, 11)) return true;
+    }
+    return false;
+}
+
+/*
+ * Make up a unique short name for a long one, the way Windows does:
+ * the first letters and the extension, upper-cased, with "~N" added.
+ */
+static int short_alias(fs_node_t *dir, const char *name, char *sn) {
+    char base[8], ext[3];
+    uint32_t blen = 0, elen = 0;
+    uint32_t len = str_len(name);
+    uint32_t dot = len;
+    for (uint32_t i = len; i > 0; i--) {
+        if (name[i - 1] == '.') {
+            dot = i - 1;
+            break;
+        }
+    }
+    for (uint32_t i = 0; i < dot && blen < 8; i++) {
+        char c = to_upper(name[i]);
+        if (c == ' ' || c == '.') continue;
+        base[blen++] = short_char(c) ? c : '_';
+    }
+    for (uint32_t i = dot + 1; i < len && elen < 3; i++) {
+        char c = to_upper(name[i]);
+        if (c == ' ' || c == '.') continue;
+        ext[elen++] = short_char(c) ? c : '_';
+    }
+    if (blen == 0) base[blen++] = '_';
+
+    for (uint32_t n = 1; n < 1000000; n++) {
+        char tail[8];
+        uint32_t tlen = 0;
+        for (uint32_t v = n; v; v /= 10) tail[tlen++] = (char)('0' + v % 10);
+        tail[tlen++] = '~';
+
+        uint32_t keep = blen + tlen > 8 ? 8 - tlen : blen;
+        for (int i = 0; i < 11; i++) sn[i] = ' ';
+        for (uint32_t i = 0; i < keep; i++) sn[i] = base[i];
+        for (uint32_t i = 0; i < tlen; i++) sn[keep + i] = tail[tlen - 1 - i];
+        for (uint32_t i = 0; i < elen; i++) sn[8 + i] = ext[i];
+        if (!short_taken(dir, sn)) return 0;
+    }
+    return -1;
+}
+
+/*
+ * Add entries for 'name' to a loaded directory: long name parts and
+ * then 'de', whose name field is filled in here. Returns the short
+ * entry's slot and sets *lfn, or -1.
+ */
+static int32_t dirent_add(fs_node_t *dir, const char *name, fat_dirent_t *de, uint32_t *lfn) {
+    fat_node_t *dn = (fat_node_t *)dir->data;
+    fat_dirent_t ents[FAT_LFN_SLOTS + 1];
+    uint32_t len = str_len(name);
+
+    uint32_t parts = 0;
+    if (!short_exact(name, de->name, &de->nt_res) || short_taken(dir, de->name)) {
+        de->nt_res = 0;
+        if (short_alias(dir, name, de->name) != 0) return -1;
+        parts = (len + FAT_LFN_CHARS - 1) / FAT_LFN_CHARS;
+    }
+
+    uint8_t sum = fat_lfn_checksum(de->name);
+    for (uint32_t p = 0; p < parts; p++) {
+        /* Stored last part first */
+        uint32_t ord = parts - p;
+        fat_lfn_t *l = (fat_lfn_t *)&ents[p];
+        mem_zero(l, sizeof(*l));
+        l->ord = (uint8_t)(ord | (p == 0 ? FAT_LFN_LAST : 0));
+        l->attr = FAT_ATTR_LFN;
+        l->checksum = sum;
+        for (uint32_t c = 0; c < FAT_LFN_CHARS; c++) {
+            uint32_t at = (ord - 1) * FAT_LFN_CHARS + c;
+            lfn_set(l, c, at < len ? (uint8_t)name[at] : at == len ? 0 : 0xFFFF);
+        }
+    }
+    ents[parts] = *de;
+
+    int32_t first = slots_find(dn, parts + 1);
+    if (first < 0 || slots_write(dn, (uint32_t)first, ents, parts + 1) != 0) return -1;
+    dir->size = dn->clusters * dn->fs->cluster_size;
+    *lfn = parts;
+    return first + (int32_t)parts;
+}
+
+static int dirent_remove(fs_node_t *dir, fat_node_t *fn) {
+    return slots_write((fat_node_t *)dir->data, fn->slot - fn->lfn, NULL, fn->lfn + 1);
+}
+
+/* First cluster of a directory as its children's ".." records it */
+static uint32_t dotdot_cluster(fs_node_t *dir) {
+    fat_node_t *dn = (fat_node_t *)dir->data;
+    return dir == dn->fs->root ? 0 : dn->first;
+}
+
+/* Give a new directory its first cluster, holding "." and ".." */
+static int dir_init(fat_node_t *fn, fs_node_t *parent) {
+    fat_fs_t *fs = fn->fs;
+    if (chain_grow(fn, 1) != 0) return -1;
+    if (zero_range(fn, 0, fs->cluster_size) != 0) return -1;
+
+    fat_dirent_t dots[2];
+    for (int i = 0; i < 2; i++) {
+        dots[i] = fn->entry;
+        for (int j = 0; j < 11; j++) dots[i].name[j] = ' ';
+        dots[i].name[0] = '.';
+    }
+    dots[1].name[1] = '.';
+    dots[0].cluster_hi = (uint16_t)(fn->first >> 16);
+    dots[0].cluster_lo = (uint16_t)fn->first;
+    uint32_t up = dotdot_cluster(parent);
+    dots[1].cluster_hi = (uint16_t)(up >> 16);
+    dots[1].cluster_lo = (uint16_t)up;
+    return slots_write(fn, 0, dots, 2);
+}
+
+static fs_node_t *fat_finddir(fs_node_t *dir, const char *name) {
+    fat_fs_t *fs = ((fat_node_t *)dir->data)->fs;
+    fs_lock(fs);
+    fs_node_t *child = dir_load(dir) == 0 ? child_find(dir, name) : NULL;
+    fs_unlock(fs);
+    return child;
+}
+
+static fs_node_t *fat_readdir(fs_node_t *dir, int index) {
+    fat_fs_t *fs = ((fat_node_t *)dir->data)->fs;
+    fs_lock(fs);
+    fs_node_t *child = NULL;
+    if (dir_load(dir) == 0 && index >= 0 && index < dir->child_count) {
+        child = dir->children[index];
+    }
+    fs_unlock(fs);
+    return child;
+}
+
+static fs_node_t *fat_create(fs_node_t *dir, const char *name, uint8_t type) {
+    fat_node_t *dn = (fat_node_t *)dir->data;
+    fat_fs_t *fs = dn->fs;
+    uint32_t len = str_len(name);
+    bool is_dir = type == FS_DIRECTORY;
+    if (len == 0 || len >= FS_NAME_MAX || (type != FS_FILE && !is_dir)) return NULL;
+    for (uint32_t i = 0; i < len; i++) {
+        char c = name[i];
+        if ((uint8_t)c < 0x20 || c == '"' || c == '*' || c == ':' || c == '<' || c == '>' ||
+            c == '?' || c == '\\' || c == '|') {
+            return NULL;
+        }
+    }
+
+    fs_lock(fs);
+    fs_node_t *node = NULL;
+    if (dir_load(dir) != 0 || child_find(dir, name) || child_reserve(dir) != 0) goto out;
+
+    fat_dirent_t de;
+    mem_zero(&de, sizeof(de));
+    de.attr = is_dir ? FAT_ATTR_DIRECTORY : FAT_ATTR_ARCHIVE;
+    de.ctime = de.mtime = fat_time();
+    de.cdate = de.mdate = de.adate = FAT_EPOCH_DATE;
+
+    /* The entry's name is only known once it is added */
+    node = node_new(fs, dir, name, &de, 0, 0);
+    if (!node) goto out;
+    fat_node_t *fn = (fat_node_t *)node->data;
+    fn->mapped = true;
+    fn->loaded = true;
+
+    /* Cluster and FAT before the entry that points at them */
+    uint32_t lfn;
+    int32_t slot = -1;
+    if (!is_dir || dir_init(fn, dir) == 0) {
+        fn->entry.cluster_hi = (uint16_t)(fn->first >> 16);
+        fn->entry.cluster_lo = (uint16_t)fn->first;
+        if (fat_commit(fs) == 0) slot = dirent_add(dir, name, &fn->entry, &lfn);
+    }
+    if (slot < 0) {
+        chain_trim(fn, 0);
+        node_free(node);
+        node = NULL;
+        goto out;
+    }
+    fn->slot = (uint32_t)slot;
+    fn->lfn = lfn;
+    if (is_dir) node->size = fs->cluster_size;
+    child_add(dir, node);
+
+out:
+    fs_unlock(fs);
+    return node;
+}
+
+static int fat_unlink(fs_node_t *dir, fs_node_t *child) {
+    fat_fs_t *fs = ((fat_node_t *)dir->data)->fs;
+
+    fs_lock(fs);
+    int status = -1;
+    if (child->type == FS_DIRECTORY && (dir_load(child) != 0 || child->child_count)) goto out;
+    if (dirent_remove(dir, (fat_node_t *)child->data) != 0) goto out;
+
+    /* The clusters go when the last user lets go (fat_release) */
+    detach(dir, child);
+    status = 0;
+out:
+    if (fs_unlock(fs) != 0) status = -1;
+    return status;
+}
+
+/* New name first, old name second: a crash leaves two names, never none */
+static int fat_rename(fs_node_t *olddir, fs_node_t *child, fs_node_t *newdir,
+                      const char *newname) {
+    fat_node_t *cn = (fat_node_t *)child->data;
+    fat_fs_t *fs = cn->fs;
+    bool is_dir = child->type == FS_DIRECTORY;
+    if (str_len(newname) >= FS_NAME_MAX) return -1;
+
+    fs_lock(fs);
+    int status = -1;
+    const char *name = NULL;
+    if (dir_load(newdir) != 0) goto out;
+
+    fs_node_t *target = child_find(newdir, newname);
+    if (target && ((target->type == FS_DIRECTORY) != is_dir ||
+                   (is_dir && (dir_load(target) != 0 || target->child_count)))) {
+        goto out;
+    }
+
+    name = name_intern(newname);
+    if (!name || (!target && child_reserve(newdir) != 0)) goto out;
+
+    /*
+     * Our entries go in while the target's (or, for a change of case
+     * only, our own old ones) still hold the short name, so ours may get
+     * an alias; a failure here has not lost anything yet.
+     */
+    fat_dirent_t de = cn->entry;
+    uint32_t lfn;
+    int32_t slot = dirent_add(newdir, newname, &de, &lfn);
+    if (slot < 0 || dirent_remove(olddir, cn) != 0) goto out;
+    cn->entry = de;
+    cn->slot = (uint32_t)slot;
+    cn->lfn = lfn;
+
+    if (target && target != child) {
+        if (dirent_remove(newdir, (fat_node_t *)target->data) != 0) goto out;
+        detach(newdir, target);
+    }
+
+    if (is_dir && olddir != newdir && chain_load(cn) == 0) {
+        fat_dirent_t dotdot;
+        uint32_t up = dotdot_cluster(newdir);
+        if (slot_read(cn, 1, &dotdot) == 0 && mem_eq(dotdot.name, "..         ", 11)) {
+            dotdot.cluster_hi = (uint16_t)(up >> 16);
+            dotdot.cluster_lo = (uint16_t)up;
+            slots_write(cn, 1, &dotdot, 1);
+        }
+    }
+
+    child_remove(olddir, child);
+    const char *old = child->name;
+    child->name = name;
+    child->parent = newdir;
+    child_add(newdir, child);
+    name_release(old);
+    name = NULL;
+    status = 0;
+
+out:
+    if (name) name_release(name);
+    if (fs_unlock(fs) != 0) status = -1;
+    return status;
+}
+
+/*
+ * ===========================================================================
+ * Files
+ * ===========================================================================
+ */
+
+/* Map the chain when the file is opened, so reads never walk the FAT */
+static int fat_open(fs_node_t *node, int flags) {
+    (void)flags;
+    fat_node_t *fn = (fat_node_t *)node->data;
+    if (fn->mapped) return 0;
+
+    fs_lock(fn->fs);
+    int status = chain_load(fn);
+    fs_unlock(fn->fs);
+    return status;
+}
+
+/*
+ * Read 'count' pages from 'pgoff' into 'frames' as one batch. Only
+ * bytes known to be on disk are read; the rest of each page is zeroed.
+ */
+static int pages_read(fs_node_t *node, uint32_t pgoff, uint32_t count, uint32_t *frames) {
+    fat_node_t *fn = (fat_node_t *)node->data;
+    fat_fs_t *fs = fn->fs;
+    uint32_t limit = fn->valid < node->size ? fn->valid : node->size;
+
+    fs_lock(fs);
+    int status = chain_load(fn);
+    if (status == 0) {
+        fat_io_t io;
+        io_begin(&io, fs, false);
+        for (uint32_t i = 0; i < count && status == 0; i++) {
+            uint32_t pos = (pgoff + i) << PAGE_SHIFT;
+            uint32_t bytes = pos < limit ? limit - pos : 0;
+            if (bytes > PAGE_SIZE) bytes = PAGE_SIZE;
+            if (bytes) status = io_file(&io, fn, pos, frames[i], sector_up(bytes));
+        }
+        if (io_end(&io) != 0) status = -1;
+    }
+    fs_unlock(fs);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t pos = (pgoff + i) << PAGE_SHIFT;
+        uint32_t bytes = pos < limit ? limit - pos : 0;
+        if (bytes < PAGE_SIZE) mem_zero((uint8_t *)frames[i] + bytes, PAGE_SIZE - bytes);
+    }
+    return status;
+}
+
+static int fat_readpage(fs_node_t *node, uint32_t pgoff, void *page) {
+    uint32_t frame = (uint32_t)page;
+    return pages_read(node, pgoff, 1, &frame);
+}
+
+static int fat_readpages(fs_node_t *node, uint32_t pgoff, uint32_t count, uint32_t *frames) {
+    return pages_read(node, pgoff, count, frames);
+}
+
+/*
+ * Write 'count' pages from 'pgoff' as one batch, growing the chain to
+ * cover them first. Adjacent pages in a contiguous chain share bios.
+ */
+static int pages_write(fs_node_t *node, uint32_t pgoff, uint32_t count, uint32_t *frames) {
+    fat_node_t *fn = (fat_node_t *)node->data;
+    fat_fs_t *fs = fn->fs;
+    uint32_t pos = pgoff << PAGE_SHIFT;
+    if (pos >= node->size) return 0;        /* Truncated away meanwhile */
+    uint32_t end = node->size - pos < count * PAGE_SIZE ? node->size : pos + count * PAGE_SIZE;
+
+    fs_lock(fs);
+    int status = -1;
+    if (chain_load(fn) != 0 || chain_grow(fn, clusters_for(fs, end)) != 0) goto out;
+
+    /* Pages never written before these must read back as zeros */
+    if (pos > fn->valid && zero_range(fn, fn->valid, pos) != 0) goto out;
+
+    fat_io_t io;
+    io_begin(&io, fs, true);
+    for (uint32_t i = 0; pos + i * PAGE_SIZE < end; i++) {
+        uint32_t at = pos + i * PAGE_SIZE;
+        uint32_t bytes = end - at < PAGE_SIZE ? end - at : PAGE_SIZE;
+        if (io_file(&io, fn, at, frames[i], sector_up(bytes)) != 0) io.status = -1;
+    }
+    if (io_end(&io) != 0) goto out;
+    if (end > fn->valid) fn->valid = end;
+
+    fn->entry.size = fn->valid;
+    fn->entry.mtime = fat_time();
+    fn->entry.attr |= FAT_ATTR_ARCHIVE;
+    status = entry_write(node);
+out:
+    if (fs_unlock(fs) != 0) status = -1;
+    return status;
+}
+
+static int fat_writepage(fs_node_t *node, uint32_t pgoff, const void *page) {
+    uint32_t frame = (uint32_t)page;
+    return pages_write(node, pgoff, 1, &frame);
+}
+
+static int fat_writepages(fs_node_t *node, uint32_t pgoff, uint32_t count, uint32_t *frames) {
+    return pages_write(node, pgoff, count, frames);
+}
+
+static int fat_truncate(fs_node_t *node, uint32_t size) {
+    fat_node_t *fn = (fat_node_t *)node->data;
+    fat_fs_t *fs = fn->fs;
+
+    fs_lock(fs);
+    int status = chain_load(fn);
+    if (status == 0 && size < fn->valid) {
+        chain_trim(fn, clusters_for(fs, size));
+        fn->valid = size;
+    } else if (status == 0 && size > fn->valid) {
+        /* FAT has no holes: the new part is allocated and zeroed now */
+        status = chain_grow(fn, clusters_for(fs, size));
+        if (status == 0) status = zero_range(fn, fn->valid, size);
+        if (status == 0) fn->valid = size;
+    }
+
+    if (status == 0) {
+        node->size = size;
+        fn->entry.size = size;
+        fn->entry.mtime = fat_time();
+        status = entry_write(node);
+    }
+    if (fs_unlock(fs) != 0) status = -1;
+    return status;
+}
+
+/* Every operation is on the device when it returns; drain its cache */
+static int fat_fsync(fs_node_t *node) {
+    fat_node_t *fn = (fat_node_t *)node->data;
+    return block_flush(fn->fs->dev);
+}
+
+/*
+ * ===========================================================================
+ * Releasing Nodes
+ * ===========================================================================
+ */
+
+/* An unlinked node is gone, and with it its clusters */
+static void fat_release(fs_node_t *node) {
+    fat_node_t *fn = (fat_node_t *)node->data;
+    fat_fs_t *fs = fn->fs;
+
+    fs_lock(fs);
+    if (chain_load(fn) == 0) chain_trim(fn, 0);
+    fs_unlock(fs);
+
+    if (node->type == FS_DIRECTORY) {
+        while (node->child_count > 0) {
+            node_free(node->children[--node->child_count]);
+        }
+    }
+    node_free(node);
+}
+
+static fs_ops_t fat_dir_ops = {
+    .readdir = fat_readdir,
+    .finddir = fat_finddir,
+    .create  = fat_create,
+    .unlink  = fat_unlink,
+    .rename  = fat_rename,
+    .fsync   = fat_fsync,
+    .release = fat_release,
+};
+
+static fs_ops_t fat_file_ops = {
+    .open       = fat_open,
+    .truncate   = fat_truncate,
+    .readpage   = fat_readpage,
+    .writepage  = fat_writepage,
+    .readpages  = fat_readpages,
+    .writepages = fat_writepages,
+    .fsync      = fat_fsync,
+    .release    = fat_release,
+};
+
+/*
+ * ===========================================================================
+ * Mounting
+ * ===========================================================================
+ */
+
+static void fs_free(fat_fs_t *fs) {
+    for (uint32_t i = 0; i < FAT_BUFS; i++) {
+        if (fs->bufs[i].data) pmm_free_pages((uint32_t)fs->bufs[i].data, 1);
+    }
+    if (fs->scratch) pmm_free_pages((uint32_t)fs->scratch, 1);
+    pmm_free_pages((uint32_t)fs, pages_for(sizeof(fat_fs_t)));
+}
+
+static bool power_of_two(uint32_t n) {
+    return n && !(n & (n - 1));
+}
+
+static int fat_mount(superblock_t *sb, const char *source) {
+    block_device_t *dev = block_find(source);
+    if (!dev) return -1;
+
+    fat_fs_t *fs = (fat_fs_t *)pmm_alloc_pages(pages_for(sizeof(fat_fs_t)));
+    if (!fs) return -1;
+    mem_zero(fs, sizeof(fat_fs_t));
+    fs->dev = dev;
+    wait_queue_init(&fs->wait);
+
+    fs->scratch = (uint8_t *)pmm_alloc_page();
+    if (!fs->scratch || block_read(dev, 0, fs->scratch, 1) != 0) goto fail;
+
+    /* FAT32 only: no fixed root directory, no 16-bit FAT size */
+    fat_boot_t *bs = (fat_boot_t *)fs->scratch;
+    uint32_t bps = bs->bytes_per_sector;
+    uint32_t total = bs->sectors16 ? bs->sectors16 : bs->sectors32;
+    if (bs->signature != FAT_SIGNATURE || bps < BLOCK_SECTOR_SIZE || bps > PAGE_SIZE ||
+        !power_of_two(bps) || !power_of_two(bs->sectors_per_cluster) ||
+        !bs->reserved_sectors || !bs->fats || bs->root_entries || bs->fat_size16 ||
+        !bs->fat_size32 || bs->fs_version) {
+        goto fail;
+    }
+
+    uint32_t scale = bps / BLOCK_SECTOR_SIZE;
+    uint32_t meta = bs->reserved_sectors + bs->fats * bs->fat_size32;
+    if (total <= meta || (uint64_t)total * scale > dev->sectors) goto fail;
+
+    fs->cluster_sectors = bs->sectors_per_cluster * scale;
+    fs->cluster_size = fs->cluster_sectors * BLOCK_SECTOR_SIZE;
+    while ((1u << fs->cluster_shift) < fs->cluster_sectors) fs->cluster_shift++;
+    fs->fat_start = (uint64_t)bs->reserved_sectors * scale;
+    fs->fat_sectors = bs->fat_size32 * scale;
+    fs->data_start = (uint64_t)meta * scale;
+    fs->clusters = (total - meta) / bs->sectors_per_cluster;
+    fs->root_cluster = bs->root_cluster;
+
+    /* No more clusters than the FAT can describe */
+    uint32_t fat_entries = fs->fat_sectors * (BLOCK_SECTOR_SIZE / sizeof(uint32_t));
+    if (fs->clusters + FAT_FIRST_CLUSTER > fat_entries) fs->clusters = fat_entries - FAT_FIRST_CLUSTER;
+    if (fs->clusters > FAT_MAX_CLUSTERS) fs->clusters = FAT_MAX_CLUSTERS;
+    if (!fs->clusters || !cluster_ok(fs, fs->root_cluster)) goto fail;
+
+    /* With mirroring off only the active copy is read or written */
+    fs->fats = bs->fats;
+    if (bs->ext_flags & 0x80) {
+        fs->active_fat = bs->ext_flags & 0x0F;
+        if (fs->active_fat >= fs->fats) goto fail;
+        fs->fat_start += (uint64_t)fs->active_fat * fs->fat_sectors;
+        fs->active_fat = 0;
+        fs->fats = 1;
+    }
+
+    fs->free_count = FAT_FSINFO_UNKNOWN;
+    fs->next_free = FAT_FIRST_CLUSTER;
+    if (bs->fsinfo_sector && bs->fsinfo_sector < bs->reserved_sectors) {
+        fs->fsinfo = (uint64_t)bs->fsinfo_sector * scale;
+        fat_fsinfo_t *fi = (fat_fsinfo_t *)fs->scratch;
+        if (block_read(dev, fs->fsinfo, fi, 1) != 0) goto fail;
+        if (fi->lead_sig == FAT_FSINFO_LEAD && fi->struct_sig == FAT_FSINFO_STRUCT) {
+            if (fi->free_count <= fs->clusters) fs->free_count = fi->free_count;
+            if (cluster_ok(fs, fi->next_free)) fs->next_free = fi->next_free;
+        } else {
+            fs->fsinfo = 0;
+        }
+    }
+
+    fat_dirent_t root;
+    mem_zero(&root, sizeof(root));
+    root.attr = FAT_ATTR_DIRECTORY;
+    root.cluster_hi = (uint16_t)(fs->root_cluster >> 16);
+    root.cluster_lo = (uint16_t)fs->root_cluster;
+    fs->root = node_new(fs, NULL, "/", &root, 0, 0);
+    if (!fs->root) goto fail;
+    fs->root->parent = fs->root;
+
+    sb->root = fs->root;
+    sb->priv = fs;
+    return 0;
+
+fail:
+    fs_free(fs);
+    return -1;
+}
+
+static void fat_unmount(superblock_t *sb) {
+    fat_fs_t *fs = (fat_fs_t *)sb->priv;
+    if (!fs) return;
+
+    vfs_tree_free(fs->root, node_free);
+
+    fs_lock(fs);
+    if (fs->fsinfo && fs->fsinfo_dirty) {
+        fat_fsinfo_t *fi = (fat_fsinfo_t *)fs->scratch;
+        if (block_read(fs->dev, fs->fsinfo, fi, 1) == 0) {
+            fi->free_count = fs->free_count;
+            fi->next_free = fs->next_free;
+            block_write(fs->dev, fs->fsinfo, fi, 1);
+        }
+    }
+    fs_unlock(fs);
+    block_flush(fs->dev);
+
+    fs_free(fs);
+    sb->priv = NULL;
+}
+
+static fs_type_t fat_type = {
+    .name    = "vfat",
+    .mount   = fat_mount,
+    .unmount = fat_unmount,
+};
+
+void fat_init(void) {
+    vfs_register_fs(&fat_type);
+}
@@ -0,0 +1,146 @@
+/*
+ * ClaudeOS FAT32 - On-Disk Format
+ * Worker1 - Shell+FS Claude
+ *
+ * FAT32 as written by mkfs.fat and Windows. The volume starts with the
+ * reserved sectors (boot sector, FSInfo and their backups), then the
+ * copies of the File Allocation Table, then the data clusters, numbered
+ * from 2. The FAT holds one 32-bit entry per cluster, of which the low
+ * 28 bits are the next cluster of the chain, 0 for free or EOC and
+ * above for the end of a chain.
+ *
+ * A directory is a chain like any file, made of 32-byte entries. A long
+ * name is stored in up to 20 extra entries just before the 8.3 entry,
+ * last part first, each holding 13 UTF-16 characters and a checksum of
+ * the short name.
+ */
+
+#ifndef CLAUDEOS_FAT_H
+#define CLAUDEOS_FAT_H
+
+#include "../include/types.h"
+
+#define FAT_SIGNATURE           0xAA55  /* Last two bytes of the boot sector */
+
+/* FAT entries */
+#define FAT_ENTRY_MASK          0x0FFFFFFF
+#define FAT_FREE                0
+#define FAT_BAD                 0x0FFFFFF7
+#define FAT_EOC                 0x0FFFFFF8      /* This or above: end of chain */
+#define FAT_EOC_MARK            0x0FFFFFFF      /* What we write */
+#define FAT_FIRST_CLUSTER       2
+#define FAT_MAX_CLUSTERS        0x0FFFFFF5      /* Highest usable is 0x0FFFFFF6 */
+
+/* FSInfo */
+#define FAT_FSINFO_LEAD         0x41615252
+#define FAT_FSINFO_STRUCT       0x61417272
+#define FAT_FSINFO_TRAIL        0xAA550000
+#define FAT_FSINFO_UNKNOWN      0xFFFFFFFF
+
+/* Directory entry attributes */
+#define FAT_ATTR_READ_ONLY      0x01
+#define FAT_ATTR_HIDDEN         0x02
+#define FAT_ATTR_SYSTEM         0x04
+#define FAT_ATTR_VOLUME_ID      0x08
+#define FAT_ATTR_DIRECTORY      0x10
+#define FAT_ATTR_ARCHIVE        0x20
+#define FAT_ATTR_LFN            0x0F    /* RO | HIDDEN | SYSTEM | VOLUME_ID */
+
+/* First name byte */
+#define FAT_DIRENT_END          0x00    /* This and all later entries unused */
+#define FAT_DIRENT_FREE         0xE5
+#define FAT_DIRENT_KANJI        0x05    /* A leading 0xE5 that is really a name */
+
+/* Windows NT case flags (nt_res): the 8.3 parts are lowercase */
+#define FAT_NT_BASE_LOWER       0x08
+#define FAT_NT_EXT_LOWER        0x10
+
+/* Long name entries */
+#define FAT_LFN_LAST            0x40    /* In ord: the last (first stored) part */
+#define FAT_LFN_CHARS           13
+#define FAT_LFN_MAX             255
+#define FAT_DIRENT_SIZE         32
+
+typedef struct {
+    uint8_t  jmp[3];
+    char     oem[8];
+    uint16_t bytes_per_sector;
+    uint8_t  sectors_per_cluster;
+    uint16_t reserved_sectors;
+    uint8_t  fats;
+    uint16_t root_entries;              /* 0 on FAT32 */
+    uint16_t sectors16;
+    uint8_t  media;
+    uint16_t fat_size16;                /* 0 on FAT32 */
+    uint16_t sectors_per_track;
+    uint16_t heads;
+    uint32_t hidden_sectors;
+    uint32_t sectors32;
+    /* FAT32 */
+    uint32_t fat_size32;
+    uint16_t ext_flags;                 /* Bit 7: only FAT (low bits) is active */
+    uint16_t fs_version;
+    uint32_t root_cluster;
+    uint16_t fsinfo_sector;
+    uint16_t backup_boot_sector;
+    uint8_t  reserved[12];
+    uint8_t  drive_number;
+    uint8_t  reserved1;
+    uint8_t  boot_signature;            /* 0x29: the next three fields are valid */
+    uint32_t volume_id;
+    char     volume_label[11];
+    char     fs_type[8];                /* "FAT32   ", informational only */
+    uint8_t  boot_code[420];
+    uint16_t signature;
+} __attribute__((packed)) fat_boot_t;
+
+typedef struct {
+    uint32_t lead_sig;
+    uint8_t  reserved1[480];
+    uint32_t struct_sig;
+    uint32_t free_count;                /* Free clusters, or FAT_FSINFO_UNKNOWN */
+    uint32_t next_free;                 /* Where to start looking, or unknown */
+    uint8_t  reserved2[12];
+    uint32_t trail_sig;
+} __attribute__((packed)) fat_fsinfo_t;
+
+typedef struct {
+    char     name[11];                  /* 8.3, space padded */
+    uint8_t  attr;
+    uint8_t  nt_res;                    /* FAT_NT_*_LOWER */
+    uint8_t  ctime_tenth;
+    uint16_t ctime;
+    uint16_t cdate;
+    uint16_t adate;
+    uint16_t cluster_hi;
+    uint16_t mtime;
+    uint16_t mdate;
+    uint16_t cluster_lo;
+    uint32_t size;
+} __attribute__((packed)) fat_dirent_t;
+
+typedef struct {
+    uint8_t  ord;                       /* Part number from 1, FAT_LFN_LAST on the last */
+    uint16_t name1[5];
+    uint8_t  attr;                      /* FAT_ATTR_LFN */
+    uint8_t  type;                      /* 0 */
+    uint8_t  checksum;                  /* Of the 8.3 name it belongs to */
+    uint16_t name2[6];
+    uint16_t cluster;                   /* 0 */
+    uint16_t name3[2];
+} __attribute__((packed)) fat_lfn_t;
+
+/* Checksum of an 8.3 name, stored in each of its long name entries */
+static inline uint8_t fat_lfn_checksum(const char *name) {
+    uint8_t sum = 0;
+    for (int i = 0; i < 11; i++) {
+        sum = (uint8_t)(((sum & 1) << 7) + (sum >> 1) + (uint8_t)name[i]);
+    }
+    return sum;
+}
+
+static inline uint32_t fat_dirent_cluster(const fat_dirent_t *de) {
+    return ((uint32_t)de->cluster_hi << 16) | de->cluster_lo;
+}
+
+#endif /* CLAUDEOS_FAT_H */
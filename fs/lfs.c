@@ -0,0 +1,2040 @@
+/*
+ * ClaudeOS Log-Structured Filesystem - Implementation
+ * Worker1 - Shell+FS Claude
+ *
+ * Mounts a disk made by "mkfs -t lfs", read-write:
+ *
+ *   mount lfs /dev/ram0 /mnt
+ *
+ * Made for writing many small files fast. Creating, renaming and
+ * removing files only changes nodes in memory. What the page cache
+ * writes back is appended to a segment buffer, and that goes to the
+ * disk as one large request when the segment is full, on fsync or at
+ * the next checkpoint. So a burst of small files costs about what
+ * writing their bytes in order costs. A file of up to 96 bytes lives
+ * in its inode and takes no block at all.
+ *
+ * The inode map (where each inode was last written) is kept in memory.
+ * It is saved by checkpoints, which go to the two checkpoint regions in
+ * turn, every few seconds and at unmount. Mounting rolls forward from
+ * the newer one through the partial segments written after it. After
+ * an unclean shutdown a scan from the root frees inodes that nothing
+ * names and counts again what each segment holds.
+ *
+ * A daemon per mount writes the checkpoints and runs the cleaner: once
+ * free segments run low, it copies what is still live out of the
+ * segments with the best ratio of free space gained to cost (weighted
+ * by age) and reuses them. Writes that would take the last few
+ * segments clean in the foreground first.
+ *
+ * Directories are read in full the first time they are looked at and
+ * written in full when they have changed. Their nodes stay in memory
+ * until unmount.
+ */
+
+#include "vfs.h"
+#include "dcache.h"
+#include "mount.h"
+#include "names.h"
+#include "pagecache.h"
+#include "lfs.h"
+#include "../include/block.h"
+#include "../include/pmm.h"
+#include "../include/slab.h"
+#include "../include/process.h"
+#include "../include/timer.h"
+#include "../include/idt.h"
+
+#define LFS_DIR_INLINE      8       /* Children before the array moves to pages */
+#define LFS_HASH_SIZE       256     /* Inode hash buckets */
+
+/* Cleaning, in free segments */
+#define LFS_RESERVE_SEGS    4       /* Left for the cleaner and checkpoints */
+#define LFS_CLEAN_LOW       8       /* Below this the daemon starts cleaning */
+#define LFS_CLEAN_HIGH      16      /* ... and goes on until this many */
+#define LFS_CLEAN_BATCH     4       /* Segments cleaned per checkpoint */
+#define LFS_CLEAN_MAX_USE   90      /* Fuller segments (percent) are left alone */
+
+#define LFS_DAEMON_MS       1000
+#define LFS_CHECKPOINT_MS   5000
+
+#define LFS_NO_SEG          0xFFFFFFFF
+#define LFS_IMAP_NEW        0xFFFFFFFF  /* Imap block: allocated, not in the log yet */
+
+static void mem_zero(void *dst, uint32_t n) {
+    char *d = (char *)dst;
+    while (n--) *d++ = 0;
+}
+
+static void mem_copy(void *dst, const void *src, uint32_t n) {
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    while (n--) *d++ = *s++;
+}
+
+static uint32_t str_len(const char *s) {
+    uint32_t len = 0;
+    while (s[len]) len++;
+    return len;
+}
+
+static int str_eq(const char *a, const char *b) {
+    while (*a && *a == *b) { a++; b++; }
+    return *a == *b;
+}
+
+static uint32_t pages_for(uint32_t bytes) {
+    return PAGE_ALIGN(bytes) >> PAGE_SHIFT;
+}
+
+static uint32_t blocks_for(uint32_t bytes) {
+    return (bytes + LFS_BLOCK_SIZE - 1) / LFS_BLOCK_SIZE;
+}
+
+static void bit_set(uint32_t *map, uint32_t bit) {
+    map[bit / 32] |= 1u << (bit % 32);
+}
+
+static void bit_clear(uint32_t *map, uint32_t bit) {
+    map[bit / 32] &= ~(1u << (bit % 32));
+}
+
+static bool bit_test(const uint32_t *map, uint32_t bit) {
+    return (map[bit / 32] >> (bit % 32)) & 1;
+}
+
+/*
+ * ===========================================================================
+ * Mount State
+ * ===========================================================================
+ */
+
+/* A file's indirect blocks, loaded as they are needed */
+typedef struct {
+    uint32_t *ind;                      /* LFS_IND_SINGLE */
+    uint32_t *dind;                     /* LFS_IND_DOUBLE */
+    uint32_t *leaf[LFS_PTRS];           /* LFS_IND_LEAF(i) */
+    uint32_t dirty[(LFS_IND_LEAF(LFS_PTRS) + 31) / 32];     /* By indirect number */
+} lfs_map_t;
+
+struct lfs_fs;
+
+/*
+ * Per-inode state (node->data). It can outlive its node: one that
+ * still has to be written stays on the dirty list with node NULL, and
+ * the cleaner and recovery make some with no node at all.
+ */
+typedef struct lfs_node {
+    struct lfs_fs *fs;
+    fs_node_t *node;
+    struct lfs_node *hnext;             /* Inode hash chain */
+    struct lfs_node *dnext;             /* Dirty list */
+    bool dirty;                         /* raw or the map differs from the log */
+    bool entries_dirty;                 /* Directories: children differ from the log */
+    bool loaded;                        /* Directories: children read in */
+    uint32_t capacity;                  /* Directories: slots in node->children */
+    fs_node_t *inline_children[LFS_DIR_INLINE];
+    lfs_map_t *map;
+    lfs_inode_t raw;
+} lfs_node_t;
+
+typedef struct lfs_fs {
+    block_device_t *dev;
+    lfs_super_t sb;
+    uint32_t spb;                       /* Sectors per block */
+
+    lfs_imap_t *imap;                   /* The whole inode map */
+    uint32_t *imap_addr;                /* Where each of its blocks is */
+    uint32_t *imap_dirty;               /* Blocks changed since the checkpoint */
+    uint32_t next_ino;
+
+    lfs_usage_t *usage;                 /* Per segment */
+    uint8_t *seg_free;                  /* Per segment: can be written */
+    uint32_t free_segs;
+
+    /* The log: partial segments fill segment cur_seg through seg_buf */
+    uint32_t seq;                       /* Number of the next partial segment */
+    uint32_t cur_seg;
+    uint32_t seg_off;                   /* Next block to fill */
+    uint32_t part_off;                  /* Summary of the open partial segment */
+    uint8_t *seg_buf;                   /* One segment */
+
+    uint32_t cp_serial;
+    uint32_t cp_next;                   /* Region the next checkpoint goes to */
+    uint32_t cp_seq;                    /* seq at the last checkpoint */
+    uint64_t cp_ms;                     /* ... and when it was written */
+    uint8_t *cp_buf;                    /* One checkpoint region */
+    uint32_t epoch;                     /* Time of the checkpoint mounted from */
+
+    lfs_node_t *hash[LFS_HASH_SIZE];
+    lfs_node_t *dirty_list;
+    fs_node_t *root;
+
+    uint8_t *scratch;                   /* One block */
+    uint8_t *iblock;                    /* The inode block last read ... */
+    uint32_t iblock_addr;               /* ... and where from, 0 for none */
+    uint8_t *clean_buf;                 /* One segment, for the cleaner and replay */
+
+    uint32_t busy;                      /* An operation is running */
+    wait_queue_t wait;
+    wait_queue_t daemon_wait;
+    int32_t daemon;                     /* Its pid, -1 for none */
+    bool stopping;
+} lfs_fs_t;
+
+static slab_t node_slab = SLAB_INIT(fs_node_t);
+static slab_t info_slab = SLAB_INIT(lfs_node_t);
+
+static fs_ops_t lfs_dir_ops;
+static fs_ops_t lfs_file_ops;
+
+static int dev_read(lfs_fs_t *fs, uint32_t block, void *buf, uint32_t count) {
+    return block_read(fs->dev, (uint64_t)block * fs->spb, buf, count * fs->spb);
+}
+
+static int dev_write(lfs_fs_t *fs, uint32_t block, const void *buf, uint32_t count) {
+    return block_write(fs->dev, (uint64_t)block * fs->spb, buf, count * fs->spb);
+}
+
+/* There is no wall clock: time runs on from the mounted checkpoint */
+static uint32_t fs_time(lfs_fs_t *fs) {
+    return fs->epoch + timer_get_uptime_seconds();
+}
+
+static uint32_t seg_addr(lfs_fs_t *fs, uint32_t seg) {
+    return fs->sb.seg_start + seg * fs->sb.seg_blocks;
+}
+
+static uint32_t addr_seg(lfs_fs_t *fs, uint32_t addr) {
+    if (addr < fs->sb.seg_start) return LFS_NO_SEG;
+    uint32_t seg = (addr - fs->sb.seg_start) / fs->sb.seg_blocks;
+    return seg < fs->sb.segs ? seg : LFS_NO_SEG;
+}
+
+/* Bytes at 'addr' became live (data written) or dead (superseded) */
+static void usage_add(lfs_fs_t *fs, uint32_t addr, uint32_t bytes) {
+    uint32_t seg = addr_seg(fs, addr);
+    if (seg == LFS_NO_SEG) return;
+    fs->usage[seg].live += bytes;
+    fs->usage[seg].age = fs->seq;
+}
+
+static void usage_dead(lfs_fs_t *fs, uint32_t addr, uint32_t bytes) {
+    uint32_t seg = addr_seg(fs, addr);
+    if (seg == LFS_NO_SEG) return;
+    lfs_usage_t *u = &fs->usage[seg];
+    u->live = u->live > bytes ? u->live - bytes : 0;
+}
+
+static void imap_mark(lfs_fs_t *fs, uint32_t ino) {
+    bit_set(fs->imap_dirty, ino / LFS_IMAP_PER_BLOCK);
+}
+
+/* Operations on one mount run one at a time; I/O sleeps inside them */
+static void fs_lock(lfs_fs_t *fs) {
+    uint32_t irq = irq_save();
+    while (fs->busy) {
+        wait_queue_sleep(&fs->wait);
+    }
+    fs->busy = 1;
+    irq_restore(irq);
+}
+
+static void fs_unlock(lfs_fs_t *fs) {
+    uint32_t irq = irq_save();
+    fs->busy = 0;
+    wait_queue_wake_all(&fs->wait);
+    irq_restore(irq);
+}
+
+/*
+ * ===========================================================================
+ * The Log
+ * ===========================================================================
+ */
+
+/* A block appended but not written yet: it is only in seg_buf */
+static bool log_pending(lfs_fs_t *fs, uint32_t addr) {
+    uint32_t base = seg_addr(fs, fs->cur_seg);
+    return addr > base + fs->part_off && addr < base + fs->seg_off;
+}
+
+/* Read one block of the log, wherever it is */
+static int block_get(lfs_fs_t *fs, uint32_t addr, void *buf) {
+    if (log_pending(fs, addr)) {
+        mem_copy(buf, fs->seg_buf + (addr - seg_addr(fs, fs->cur_seg)) * LFS_BLOCK_SIZE,
+                 LFS_BLOCK_SIZE);
+        return 0;
+    }
+    return dev_read(fs, addr, buf, 1);
+}
+
+/* Take the next free segment after the current one */
+static uint32_t seg_take(lfs_fs_t *fs) {
+    for (uint32_t i = 1; i <= fs->sb.segs; i++) {
+        uint32_t seg = (fs->cur_seg + i) % fs->sb.segs;
+        if (fs->seg_free[seg]) {
+            fs->seg_free[seg] = 0;
+            fs->free_segs--;
+            return seg;
+        }
+    }
+    return LFS_NO_SEG;
+}
+
+static void seg_begin(lfs_fs_t *fs, uint32_t seg) {
+    fs->cur_seg = seg;
+    fs->seg_off = 0;
+    fs->part_off = 0;
+    fs->usage[seg].age = fs->seq;
+    fs->iblock_addr = 0;                /* May be about to be overwritten */
+}
+
+/*
+ * Write the open partial segment, summary and blocks, in one request.
+ * Its summary says where the next one goes: right after it, or at the
+ * start of a newly taken segment when this one is (nearly) full.
+ */
+static int log_flush(lfs_fs_t *fs) {
+    if (fs->seg_off == fs->part_off) return 0;
+
+    lfs_summary_t *sum = (lfs_summary_t *)(fs->seg_buf + fs->part_off * LFS_BLOCK_SIZE);
+    uint32_t count = fs->seg_off - fs->part_off - 1;
+    uint32_t next_seg = LFS_NO_SEG;
+    uint32_t next = 0;                  /* Out of segments: the log ends here */
+    if (fs->sb.seg_blocks - fs->seg_off >= 2) {
+        next = seg_addr(fs, fs->cur_seg) + fs->seg_off;
+    } else if ((next_seg = seg_take(fs)) != LFS_NO_SEG) {
+        next = seg_addr(fs, next_seg);
+    }
+
+    sum->magic = LFS_SUMMARY_MAGIC;
+    sum->seq = fs->seq;
+    sum->next = next;
+    sum->count = count;
+    sum->time = fs_time(fs);
+    sum->checksum = 0;
+    sum->checksum = lfs_checksum(LFS_CHECKSUM_SEED, sum, (count + 1) * LFS_BLOCK_SIZE);
+
+    if (dev_write(fs, seg_addr(fs, fs->cur_seg) + fs->part_off, sum, count + 1) != 0) {
+        if (next_seg != LFS_NO_SEG) {
+            fs->seg_free[next_seg] = 1;
+            fs->free_segs++;
+        }
+        return -1;
+    }
+
+    fs->seq++;
+    if (next_seg != LFS_NO_SEG) {
+        seg_begin(fs, next_seg);
+    } else {
+        fs->part_off = fs->seg_off;
+    }
+    return 0;
+}
+
+/*
+ * Append one block to the log, described by a summary entry, with
+ * 'live' of its bytes in use. Returns its address, 0 if out of space.
+ */
+static uint32_t log_append(lfs_fs_t *fs, uint32_t kind, uint32_t ino, uint32_t gen,
+                           uint32_t index, const void *data, uint32_t live) {
+    if (fs->seg_off == fs->part_off) {
+        /* Open a partial segment: its summary goes first */
+        if (fs->sb.seg_blocks - fs->seg_off < 2) {
+            uint32_t seg = seg_take(fs);
+            if (seg == LFS_NO_SEG) return 0;
+            seg_begin(fs, seg);
+        }
+        mem_zero(fs->seg_buf + fs->seg_off * LFS_BLOCK_SIZE, LFS_BLOCK_SIZE);
+        fs->seg_off++;
+    }
+
+    lfs_summary_t *sum = (lfs_summary_t *)(fs->seg_buf + fs->part_off * LFS_BLOCK_SIZE);
+    lfs_sum_entry_t *e = &sum->entries[fs->seg_off - fs->part_off - 1];
+    e->ino = ino;
+    e->gen = gen;
+    e->index = index;
+    e->kind = kind;
+
+    uint32_t addr = seg_addr(fs, fs->cur_seg) + fs->seg_off;
+    mem_copy(fs->seg_buf + fs->seg_off * LFS_BLOCK_SIZE, data, LFS_BLOCK_SIZE);
+    fs->seg_off++;
+    usage_add(fs, addr, live);
+
+    if (fs->seg_off == fs->sb.seg_blocks && log_flush(fs) != 0) return 0;
+    return addr;
+}
+
+/*
+ * ===========================================================================
+ * Inodes
+ * ===========================================================================
+ */
+
+static uint32_t hash_of(uint32_t ino) {
+    return ino % LFS_HASH_SIZE;
+}
+
+static lfs_node_t *hash_find(lfs_fs_t *fs, uint32_t ino) {
+    for (lfs_node_t *ln = fs->hash[hash_of(ino)]; ln; ln = ln->hnext) {
+        if (ln->raw.ino == ino) return ln;
+    }
+    return NULL;
+}
+
+static void hash_add(lfs_fs_t *fs, lfs_node_t *ln) {
+    uint32_t b = hash_of(ln->raw.ino);
+    ln->hnext = fs->hash[b];
+    fs->hash[b] = ln;
+}
+
+static void hash_remove(lfs_fs_t *fs, lfs_node_t *ln) {
+    lfs_node_t **link = &fs->hash[hash_of(ln->raw.ino)];
+    while (*link != ln) link = &(*link)->hnext;
+    *link = ln->hnext;
+}
+
+static void mark_dirty(lfs_node_t *ln) {
+    if (ln->dirty) return;
+    ln->dirty = true;
+    ln->dnext = ln->fs->dirty_list;
+    ln->fs->dirty_list = ln;
+}
+
+/* Read inode 'ino' from where the inode map says it is */
+static int inode_read(lfs_fs_t *fs, uint32_t ino, lfs_inode_t *raw) {
+    if (!ino || ino >= fs->sb.inodes) return -1;
+    uint32_t block = fs->imap[ino].block;
+    if (!block || block == LFS_IMAP_NEW) return -1;
+
+    if (fs->iblock_addr != block) {
+        fs->iblock_addr = 0;
+        if (block_get(fs, block, fs->iblock) != 0) return -1;
+        fs->iblock_addr = block;
+    }
+    const lfs_inode_t *in = (const lfs_inode_t *)fs->iblock;
+    for (uint32_t i = 0; i < LFS_INODES_PER_BLOCK; i++) {
+        if (in[i].ino == ino) {
+            *raw = in[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* Take a free inode number, round-robin so numbers are slow to recur */
+static uint32_t inode_alloc(lfs_fs_t *fs) {
+    uint32_t first = LFS_ROOT_INO + 1;
+    uint32_t range = fs->sb.inodes - first;
+    uint32_t start = fs->next_ino >= first ? fs->next_ino - first : 0;
+    for (uint32_t i = 0; i < range; i++) {
+        uint32_t ino = first + (start + i) % range;
+        lfs_imap_t *e = &fs->imap[ino];
+        if (e->block || hash_find(fs, ino)) continue;
+        e->block = LFS_IMAP_NEW;
+        e->gen++;
+        fs->next_ino = ino + 1;
+        return ino;
+    }
+    return 0;
+}
+
+static void map_free(lfs_node_t *ln) {
+    lfs_map_t *m = ln->map;
+    if (!m) return;
+    if (m->ind) pmm_free_pages((uint32_t)m->ind, 1);
+    if (m->dind) pmm_free_pages((uint32_t)m->dind, 1);
+    for (uint32_t i = 0; i < LFS_PTRS; i++) {
+        if (m->leaf[i]) pmm_free_pages((uint32_t)m->leaf[i], 1);
+    }
+    pmm_free_pages((uint32_t)m, pages_for(sizeof(lfs_map_t)));
+    ln->map = NULL;
+}
+
+/* Inode state with no node, in the hash */
+static lfs_node_t *info_new(lfs_fs_t *fs, const lfs_inode_t *raw) {
+    lfs_node_t *ln = (lfs_node_t *)slab_alloc(&info_slab);
+    if (!ln) return NULL;
+    ln->fs = fs;
+    ln->raw = *raw;
+    hash_add(fs, ln);
+    return ln;
+}
+
+static void info_free(lfs_node_t *ln) {
+    hash_remove(ln->fs, ln);
+    map_free(ln);
+    slab_free(&info_slab, ln);
+}
+
+/* The state of inode 'ino', from memory or the log; NULL if not in use */
+static lfs_node_t *info_get(lfs_fs_t *fs, uint32_t ino) {
+    lfs_node_t *ln = hash_find(fs, ino);
+    if (ln) return ln;
+    lfs_inode_t raw;
+    return inode_read(fs, ino, &raw) == 0 ? info_new(fs, &raw) : NULL;
+}
+
+/* Free the node-less state the cleaner loaded and left clean */
+static void temps_drop(lfs_fs_t *fs) {
+    for (uint32_t b = 0; b < LFS_HASH_SIZE; b++) {
+        lfs_node_t *ln = fs->hash[b];
+        while (ln) {
+            lfs_node_t *next = ln->hnext;
+            if (!ln->node && !ln->dirty) info_free(ln);
+            ln = next;
+        }
+    }
+}
+
+/*
+ * ===========================================================================
+ * Block Maps
+ * ===========================================================================
+ */
+
+/* The inode's block pointers (aligned, although the struct is packed): the
+ * direct ones, then the single and double indirect block */
+static uint32_t *iblock(lfs_node_t *ln) {
+    return (uint32_t *)((uint8_t *)&ln->raw + __builtin_offsetof(lfs_inode_t, direct));
+}
+
+static void map_mark(lfs_node_t *ln, int32_t ind) {
+    if (ind >= 0) bit_set(ln->map->dirty, (uint32_t)ind);
+}
+
+/* The indirect block at 'addr', cached in *cache; with 'create', an empty one for 0 */
+static uint32_t *map_load(lfs_fs_t *fs, uint32_t **cache, uint32_t addr, bool create, int *err) {
+    if (*cache) return *cache;
+    if (!addr && !create) return NULL;
+
+    uint32_t *block = (uint32_t *)pmm_alloc_page();
+    if (!block) {
+        *err = 1;
+        return NULL;
+    }
+    if (!addr) {
+        mem_zero(block, LFS_BLOCK_SIZE);
+    } else if (block_get(fs, addr, block) != 0) {
+        pmm_free_pages((uint32_t)block, 1);
+        *err = 1;
+        return NULL;
+    }
+    *cache = block;
+    return block;
+}
+
+/*
+ * Find the slot that holds the address of file block 'lblk', in the
+ * inode or an indirect block; with 'create', missing indirect blocks
+ * are made. *ind is the indirect block the slot is in (-1: the inode).
+ * NULL for a hole under a missing indirect block, or with *err set.
+ */
+static uint32_t *bmap_slot(lfs_node_t *ln, uint32_t lblk, bool create, int32_t *ind, int *err) {
+    lfs_fs_t *fs = ln->fs;
+    *ind = -1;
+    if (lblk < LFS_NDIR) return &iblock(ln)[lblk];
+    lblk -= LFS_NDIR;
+
+    if (!ln->map) {
+        if (!create && !ln->raw.indirect && !ln->raw.dindirect) return NULL;
+        ln->map = (lfs_map_t *)pmm_alloc_pages(pages_for(sizeof(lfs_map_t)));
+        if (!ln->map) {
+            *err = 1;
+            return NULL;
+        }
+        mem_zero(ln->map, sizeof(lfs_map_t));
+    }
+    lfs_map_t *m = ln->map;
+
+    if (lblk < LFS_PTRS) {
+        uint32_t *block = map_load(fs, &m->ind, ln->raw.indirect, create, err);
+        *ind = LFS_IND_SINGLE;
+        return block ? &block[lblk] : NULL;
+    }
+    lblk -= LFS_PTRS;
+    if (lblk >= LFS_PTRS * LFS_PTRS) {
+        *err = 1;
+        return NULL;
+    }
+
+    uint32_t i = lblk / LFS_PTRS;
+    uint32_t *dind = map_load(fs, &m->dind, ln->raw.dindirect, create, err);
+    if (!dind) return NULL;
+    uint32_t *leaf = map_load(fs, &m->leaf[i], dind[i], create, err);
+    *ind = LFS_IND_LEAF(i);
+    return leaf ? &leaf[lblk % LFS_PTRS] : NULL;
+}
+
+static int bmap(lfs_node_t *ln, uint32_t lblk, uint32_t *addr) {
+    int32_t ind;
+    int err = 0;
+    uint32_t *slot = bmap_slot(ln, lblk, false, &ind, &err);
+    *addr = slot ? *slot : 0;
+    return err ? -1 : 0;
+}
+
+/* Point file block 'lblk' at 'addr'; what it pointed at is dead */
+static int bmap_set(lfs_node_t *ln, uint32_t lblk, uint32_t addr) {
+    int32_t ind;
+    int err = 0;
+    uint32_t *slot = bmap_slot(ln, lblk, addr != 0, &ind, &err);
+    if (!slot) return addr ? -1 : 0;
+    if (*slot) usage_dead(ln->fs, *slot, LFS_BLOCK_SIZE);
+    *slot = addr;
+    map_mark(ln, ind);
+    mark_dirty(ln);
+    return 0;
+}
+
+/* Append a changed indirect block, or drop it if empty; *slot points at it */
+static int ind_write(lfs_node_t *ln, uint32_t index, uint32_t **cache, uint32_t *slot) {
+    lfs_fs_t *fs = ln->fs;
+    uint32_t *block = *cache;
+    bool empty = true;
+    for (uint32_t i = 0; i < LFS_PTRS && empty; i++) {
+        if (block[i]) empty = false;
+    }
+
+    uint32_t addr = 0;
+    if (!empty) {
+        addr = log_append(fs, LFS_SUM_INDIRECT, ln->raw.ino, ln->raw.gen, index, block,
+                          LFS_BLOCK_SIZE);
+        if (!addr) return -1;
+    } else {
+        pmm_free_pages((uint32_t)block, 1);
+        *cache = NULL;
+    }
+    if (*slot) usage_dead(fs, *slot, LFS_BLOCK_SIZE);
+    *slot = addr;
+    bit_clear(ln->map->dirty, index);
+    return 0;
+}
+
+/* Write the changed indirect blocks, those under the double one first */
+static int map_flush(lfs_node_t *ln) {
+    lfs_map_t *m = ln->map;
+    if (!m) return 0;
+
+    for (uint32_t i = 0; i < LFS_PTRS; i++) {
+        if (!bit_test(m->dirty, LFS_IND_LEAF(i))) continue;
+        if (ind_write(ln, LFS_IND_LEAF(i), &m->leaf[i], &m->dind[i]) != 0) return -1;
+        bit_set(m->dirty, LFS_IND_DOUBLE);
+    }
+    if (bit_test(m->dirty, LFS_IND_DOUBLE) &&
+        ind_write(ln, LFS_IND_DOUBLE, &m->dind, &iblock(ln)[LFS_NDIR + 1]) != 0) {
+        return -1;
+    }
+    if (bit_test(m->dirty, LFS_IND_SINGLE) &&
+        ind_write(ln, LFS_IND_SINGLE, &m->ind, &iblock(ln)[LFS_NDIR]) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Drop file blocks [from, to); emptied indirect blocks go at the next write */
+static void trim(lfs_node_t *ln, uint32_t from, uint32_t to) {
+    if (ln->raw.flags & LFS_INODE_INLINE) return;
+
+    for (uint32_t lblk = from; lblk < to; lblk++) {
+        int32_t ind;
+        int err = 0;
+        uint32_t *slot = bmap_slot(ln, lblk, false, &ind, &err);
+        if (!slot) {
+            /* No indirect block: skip what it would have held */
+            if (lblk >= LFS_NDIR && lblk < LFS_NDIR + LFS_PTRS) {
+                lblk = LFS_NDIR + LFS_PTRS - 1;
+            } else if (lblk >= LFS_NDIR + LFS_PTRS) {
+                lblk |= LFS_PTRS - 1;   /* Leaves start at a multiple of LFS_PTRS */
+            }
+            continue;
+        }
+        if (*slot) {
+            usage_dead(ln->fs, *slot, LFS_BLOCK_SIZE);
+            *slot = 0;
+            map_mark(ln, ind);
+        }
+    }
+    mark_dirty(ln);
+}
+
+/* Put a file's data (at most LFS_INLINE_MAX bytes) into its inode */
+static int make_inline(lfs_node_t *ln, const void *data, uint32_t size) {
+    trim(ln, 0, blocks_for(ln->raw.size));
+    if (map_flush(ln) != 0) return -1;  /* Only drops blocks: cannot fail */
+    map_free(ln);
+
+    mem_zero(ln->raw.data, LFS_INLINE_MAX);
+    mem_copy(ln->raw.data, data, size);
+    ln->raw.flags |= LFS_INODE_INLINE;
+    mark_dirty(ln);
+    return 0;
+}
+
+/* Move a small file's data out of its inode into block 0 */
+static int inline_spill(lfs_node_t *ln, bool keep) {
+    lfs_fs_t *fs = ln->fs;
+    uint32_t addr = 0;
+    if (keep && ln->raw.size) {
+        mem_zero(fs->scratch, LFS_BLOCK_SIZE);
+        mem_copy(fs->scratch, ln->raw.data,
+                 ln->raw.size < LFS_INLINE_MAX ? ln->raw.size : LFS_INLINE_MAX);
+        addr = log_append(fs, LFS_SUM_DATA, ln->raw.ino, ln->raw.gen, 0, fs->scratch,
+                          LFS_BLOCK_SIZE);
+        if (!addr) return -1;
+    }
+
+    mem_zero(ln->raw.data, LFS_INLINE_MAX);
+    ln->raw.flags &= ~LFS_INODE_INLINE;
+    ln->raw.direct[0] = addr;
+    mark_dirty(ln);
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Nodes
+ * ===========================================================================
+ */
+
+/* A node for inode raw->ino named 'name' in 'parent' (not linked in yet) */
+static fs_node_t *node_new(lfs_fs_t *fs, fs_node_t *parent, const char *name,
+                           const lfs_inode_t *raw) {
+    fs_node_t *node = (fs_node_t *)slab_alloc(&node_slab);
+    const char *interned = name_intern(name);
+    lfs_node_t *ln = hash_find(fs, raw->ino);
+    if (!ln && node && interned) ln = info_new(fs, raw);
+    if (!node || !ln || !interned) {
+        if (node) slab_free(&node_slab, node);
+        if (interned) name_release(interned);
+        return NULL;
+    }
+
+    ln->node = node;
+    node->name = interned;
+    node->parent = parent;
+    node->data = ln;
+    node->inode = ln->raw.ino;
+    node->size = ln->raw.size;
+
+    if (ln->raw.type == LFS_TYPE_DIR) {
+        node->type = FS_DIRECTORY;
+        node->ops = &lfs_dir_ops;
+        node->children = ln->inline_children;
+        ln->capacity = LFS_DIR_INLINE;
+    } else {
+        node->type = FS_FILE;
+        node->ops = &lfs_file_ops;
+    }
+    return node;
+}
+
+/* Free a node; its inode state goes too once it has been written */
+static void node_free(fs_node_t *node) {
+    lfs_node_t *ln = (lfs_node_t *)node->data;
+    if (node->type == FS_DIRECTORY && ln->capacity > LFS_DIR_INLINE) {
+        pmm_free_pages((uint32_t)node->children, pages_for(ln->capacity * sizeof(fs_node_t *)));
+    }
+    ln->capacity = 0;
+    ln->loaded = false;
+    ln->node = NULL;
+    name_release(node->name);
+    slab_free(&node_slab, node);
+    if (!ln->dirty) info_free(ln);
+}
+
+/* Make room for one more child in a directory's array */
+static int child_reserve(fs_node_t *dir) {
+    lfs_node_t *dln = (lfs_node_t *)dir->data;
+    if ((uint32_t)dir->child_count < dln->capacity) return 0;
+
+    uint32_t capacity = dln->capacity * 2;
+    fs_node_t **children = (fs_node_t **)pmm_alloc_pages(pages_for(capacity * sizeof(fs_node_t *)));
+    if (!children) return -1;
+    for (int i = 0; i < dir->child_count; i++) {
+        children[i] = dir->children[i];
+    }
+    if (dln->capacity > LFS_DIR_INLINE) {
+        pmm_free_pages((uint32_t)dir->children, pages_for(dln->capacity * sizeof(fs_node_t *)));
+    }
+    dir->children = children;
+    dln->capacity = capacity;
+    return 0;
+}
+
+/* Add a child (room reserved), replacing any cached "not found" */
+static void child_add(fs_node_t *dir, fs_node_t *child) {
+    dir->children[dir->child_count++] = child;
+    dcache_invalidate(dir, child->name);
+}
+
+static void child_remove(fs_node_t *dir, fs_node_t *child) {
+    int pos = 0;
+    while (dir->children[pos] != child) pos++;
+    dir->children[pos] = dir->children[--dir->child_count];
+    dir->children[dir->child_count] = NULL;
+    dcache_invalidate(dir, child->name);
+}
+
+static fs_node_t *child_find(fs_node_t *dir, const char *name) {
+    uint32_t hash = name_hash(name);
+    for (int i = 0; i < dir->child_count; i++) {
+        fs_node_t *child = dir->children[i];
+        if (name_interned_hash(child->name) == hash && str_eq(child->name, name)) {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+/* Take a removed node out of the namespace; it is freed on last put */
+static void detach(fs_node_t *dir, fs_node_t *child) {
+    child_remove(dir, child);
+    child->parent = NULL;
+    child->flags |= FS_UNLINKED;
+}
+
+/* A directory's entries changed: it is rewritten at the next sync */
+static void dir_changed(lfs_node_t *dln) {
+    dln->entries_dirty = true;
+    dln->raw.mtime = fs_time(dln->fs);
+    mark_dirty(dln);
+}
+
+/*
+ * ===========================================================================
+ * Directories
+ * ===========================================================================
+ */
+
+typedef int (*dirent_fn_t)(void *arg, const lfs_dirent_t *de);
+
+static int walk_buf(const uint8_t *buf, uint32_t len, dirent_fn_t fn, void *arg) {
+    for (uint32_t off = 0; off + LFS_DIRENT_HEADER <= len; ) {
+        const lfs_dirent_t *de = (const lfs_dirent_t *)(buf + off);
+        uint32_t size = LFS_DIRENT_SIZE(de->name_len);
+        if (!de->ino || !de->name_len || off + size > len) break;
+        if (fn(arg, de) != 0) return -1;
+        off += size;
+    }
+    return 0;
+}
+
+/* Call 'fn' on each entry of a directory, stopping if it fails */
+static int dir_walk(lfs_node_t *dln, dirent_fn_t fn, void *arg) {
+    lfs_fs_t *fs = dln->fs;
+    if (dln->raw.flags & LFS_INODE_INLINE) {
+        uint32_t len = dln->raw.size < LFS_INLINE_MAX ? dln->raw.size : LFS_INLINE_MAX;
+        return walk_buf(dln->raw.data, len, fn, arg);
+    }
+
+    uint32_t blocks = blocks_for(dln->raw.size);
+    for (uint32_t lblk = 0; lblk < blocks; lblk++) {
+        uint32_t addr;
+        if (bmap(dln, lblk, &addr) != 0) return -1;
+        if (!addr) continue;
+        if (block_get(fs, addr, fs->scratch) != 0 ||
+            walk_buf(fs->scratch, LFS_BLOCK_SIZE, fn, arg) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int load_entry(void *arg, const lfs_dirent_t *de) {
+    fs_node_t *dir = (fs_node_t *)arg;
+    lfs_node_t *dln = (lfs_node_t *)dir->data;
+    lfs_fs_t *fs = dln->fs;
+    if (de->name_len >= FS_NAME_MAX) return 0;     /* Cannot be reached */
+
+    char name[FS_NAME_MAX];
+    mem_copy(name, de->name, de->name_len);
+    name[de->name_len] = '\0';
+
+    /* Entries for inodes lost in a crash, or named twice, are dropped */
+    lfs_node_t *ln = hash_find(fs, de->ino);
+    lfs_inode_t raw;
+    if ((ln ? ln->node != NULL || !ln->raw.type : inode_read(fs, de->ino, &raw) != 0) ||
+        child_find(dir, name)) {
+        dln->entries_dirty = true;
+        mark_dirty(dln);
+        return 0;
+    }
+
+    fs_node_t *child = NULL;
+    if (child_reserve(dir) != 0 || !(child = node_new(fs, dir, name, ln ? &ln->raw : &raw))) {
+        return -1;
+    }
+    child_add(dir, child);
+    return 0;
+}
+
+/* Read a directory's entries into nodes, once */
+static int dir_load(fs_node_t *dir) {
+    lfs_node_t *dln = (lfs_node_t *)dir->data;
+    if (dln->loaded) return 0;
+
+    if (dir_walk(dln, load_entry, dir) != 0) {
+        /* Start over next time */
+        while (dir->child_count > 0) {
+            fs_node_t *child = dir->children[--dir->child_count];
+            dcache_invalidate(dir, child->name);
+            node_free(child);
+        }
+        return -1;
+    }
+    dln->loaded = true;
+    return 0;
+}
+
+static uint32_t dirent_put(uint8_t *at, fs_node_t *child) {
+    lfs_dirent_t *de = (lfs_dirent_t *)at;
+    uint32_t len = str_len(child->name);
+    de->ino = child->inode;
+    de->type = child->type == FS_DIRECTORY ? LFS_TYPE_DIR : LFS_TYPE_FILE;
+    de->name_len = (uint8_t)len;
+    mem_copy(de->name, child->name, len);
+    return LFS_DIRENT_SIZE(len);
+}
+
+/* Write a directory's entries out in full: into the inode if they fit */
+static int dir_write(lfs_node_t *dln) {
+    lfs_fs_t *fs = dln->fs;
+    fs_node_t *dir = dln->node;
+
+    uint32_t total = 0;
+    for (int i = 0; i < dir->child_count; i++) {
+        total += LFS_DIRENT_SIZE(str_len(dir->children[i]->name));
+    }
+
+    if (total <= LFS_INLINE_MAX) {
+        uint8_t buf[LFS_INLINE_MAX];
+        mem_zero(buf, sizeof(buf));
+        uint32_t off = 0;
+        for (int i = 0; i < dir->child_count; i++) {
+            off += dirent_put(buf + off, dir->children[i]);
+        }
+        if (make_inline(dln, buf, total) != 0) return -1;
+        dln->raw.size = total;
+    } else {
+        uint32_t old_blocks = 0;
+        if (dln->raw.flags & LFS_INODE_INLINE) {
+            inline_spill(dln, false);
+        } else {
+            old_blocks = blocks_for(dln->raw.size);
+        }
+
+        /* Entries never cross a block; a zeroed rest ends each one */
+        uint32_t lblk = 0, off = 0;
+        mem_zero(fs->scratch, LFS_BLOCK_SIZE);
+        for (int i = 0; i <= dir->child_count; i++) {
+            uint32_t size = i < dir->child_count
+                          ? LFS_DIRENT_SIZE(str_len(dir->children[i]->name)) : 0;
+            if (off && (i == dir->child_count || off + size > LFS_BLOCK_SIZE)) {
+                uint32_t addr = log_append(fs, LFS_SUM_DATA, dln->raw.ino, dln->raw.gen, lblk,
+                                           fs->scratch, LFS_BLOCK_SIZE);
+                if (!addr || bmap_set(dln, lblk, addr) != 0) return -1;
+                lblk++;
+                off = 0;
+                mem_zero(fs->scratch, LFS_BLOCK_SIZE);
+            }
+            if (i < dir->child_count) off += dirent_put(fs->scratch + off, dir->children[i]);
+        }
+        trim(dln, lblk, old_blocks);
+        dln->raw.size = lblk * LFS_BLOCK_SIZE;
+    }
+
+    dir->size = dln->raw.size;
+    dln->entries_dirty = false;
+    mark_dirty(dln);
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Writing Back and Checkpoints
+ * ===========================================================================
+ */
+
+/* Inode state written: clean now, and freed if no node holds it */
+static void inode_done(lfs_node_t *ln) {
+    ln->dirty = false;
+    if (!ln->node) info_free(ln);
+}
+
+/* Append one block of up to LFS_INODES_PER_BLOCK inodes */
+static int inodes_block(lfs_fs_t *fs, lfs_node_t **batch, uint32_t count) {
+    lfs_inode_t *in = (lfs_inode_t *)fs->scratch;
+    mem_zero(fs->scratch, LFS_BLOCK_SIZE);
+    uint32_t live = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        in[i] = batch[i]->raw;
+        if (in[i].type) live += LFS_INODE_SIZE;
+    }
+
+    uint32_t addr = log_append(fs, LFS_SUM_INODES, 0, 0, 0, in, live);
+    if (!addr) return -1;
+
+    for (uint32_t i = 0; i < count; i++) {
+        lfs_imap_t *e = &fs->imap[batch[i]->raw.ino];
+        if (e->block && e->block != LFS_IMAP_NEW) usage_dead(fs, e->block, LFS_INODE_SIZE);
+        e->block = batch[i]->raw.type ? addr : 0;
+        imap_mark(fs, batch[i]->raw.ino);
+        inode_done(batch[i]);
+    }
+    return 0;
+}
+
+/*
+ * Write every dirty inode, files before directories, so that a replayed
+ * directory never names an inode the log does not hold yet. A removed
+ * inode goes as a tombstone (type 0) that frees its number on replay.
+ */
+static int inodes_write(lfs_fs_t *fs) {
+    lfs_node_t *lists[2] = { NULL, NULL };
+    while (fs->dirty_list) {
+        lfs_node_t *ln = fs->dirty_list;
+        fs->dirty_list = ln->dnext;
+        lfs_node_t **list = &lists[ln->raw.type == LFS_TYPE_DIR];
+        ln->dnext = *list;
+        *list = ln;
+    }
+
+    int status = 0;
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        lfs_node_t *ln = lists[pass];
+        while (ln) {
+            lfs_node_t *batch[LFS_INODES_PER_BLOCK];
+            uint32_t count = 0;
+            while (ln && count < LFS_INODES_PER_BLOCK) {
+                lfs_node_t *next = ln->dnext;
+                if (!ln->raw.type && fs->imap[ln->raw.ino].block == LFS_IMAP_NEW) {
+                    fs->imap[ln->raw.ino].block = 0;    /* Never reached the log */
+                    inode_done(ln);
+                } else {
+                    batch[count++] = ln;
+                }
+                ln = next;
+            }
+            if (count && status == 0) status = inodes_block(fs, batch, count);
+            if (status != 0) {
+                for (uint32_t i = 0; i < count; i++) {
+                    batch[i]->dirty = false;
+                    mark_dirty(batch[i]);
+                }
+            }
+        }
+    }
+    return status;
+}
+
+/* Append everything changed in memory: directories, indirect blocks, inodes */
+static int log_dirty(lfs_fs_t *fs) {
+    for (lfs_node_t *ln = fs->dirty_list; ln; ln = ln->dnext) {
+        if (ln->entries_dirty) {
+            if (ln->node && ln->raw.type && dir_write(ln) != 0) return -1;
+            ln->entries_dirty = false;
+        }
+        if (map_flush(ln) != 0) return -1;
+    }
+    return inodes_write(fs);
+}
+
+/* Everything changed is on disk and found by roll-forward */
+static int log_sync(lfs_fs_t *fs) {
+    if (log_dirty(fs) != 0 || log_flush(fs) != 0) return -1;
+    return block_flush(fs->dev);
+}
+
+static bool log_changed(lfs_fs_t *fs) {
+    return fs->dirty_list || fs->seq != fs->cp_seq || fs->seg_off != fs->part_off;
+}
+
+/*
+ * Write a checkpoint: the changed inode map blocks go to the log, then
+ * the map of them, segment usage and the log position go to the older
+ * region. Segments emptied since the last one can be written again.
+ */
+static int checkpoint(lfs_fs_t *fs, bool clean) {
+    if (log_dirty(fs) != 0) return -1;
+    for (uint32_t i = 0; i < fs->sb.imap_blocks; i++) {
+        if (!bit_test(fs->imap_dirty, i)) continue;
+        uint32_t addr = log_append(fs, LFS_SUM_IMAP, 0, 0, i, fs->imap + i * LFS_IMAP_PER_BLOCK,
+                                   LFS_BLOCK_SIZE);
+        if (!addr) return -1;
+        if (fs->imap_addr[i]) usage_dead(fs, fs->imap_addr[i], LFS_BLOCK_SIZE);
+        fs->imap_addr[i] = addr;
+        bit_clear(fs->imap_dirty, i);
+    }
+    if (log_flush(fs) != 0 || block_flush(fs->dev) != 0) return -1;
+
+    uint32_t bytes = fs->sb.cp_blocks * LFS_BLOCK_SIZE;
+    mem_zero(fs->cp_buf, bytes);
+    lfs_checkpoint_t *cp = (lfs_checkpoint_t *)fs->cp_buf;
+    cp->magic = LFS_CP_MAGIC;
+    cp->serial = fs->cp_serial + 1;
+    cp->seq = fs->seq;
+    cp->seg = fs->cur_seg;
+    cp->head = seg_addr(fs, fs->cur_seg) + fs->seg_off;
+    cp->next_ino = fs->next_ino;
+    cp->time = fs_time(fs);
+    cp->clean = clean;
+    uint8_t *at = fs->cp_buf + sizeof(lfs_checkpoint_t);
+    mem_copy(at, fs->imap_addr, fs->sb.imap_blocks * sizeof(uint32_t));
+    mem_copy(at + fs->sb.imap_blocks * sizeof(uint32_t), fs->usage,
+             fs->sb.segs * sizeof(lfs_usage_t));
+    cp->checksum = lfs_checksum(LFS_CHECKSUM_SEED, fs->cp_buf, bytes);
+
+    if (dev_write(fs, fs->sb.cp[fs->cp_next], fs->cp_buf, fs->sb.cp_blocks) != 0 ||
+        block_flush(fs->dev) != 0) {
+        return -1;
+    }
+    fs->cp_serial++;
+    fs->cp_next ^= 1;
+    fs->cp_seq = fs->seq;
+    fs->cp_ms = timer_get_uptime_ms();
+
+    for (uint32_t seg = 0; seg < fs->sb.segs; seg++) {
+        if (!fs->seg_free[seg] && seg != fs->cur_seg && !fs->usage[seg].live) {
+            fs->seg_free[seg] = 1;
+            fs->free_segs++;
+        }
+    }
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Cleaner
+ * ===========================================================================
+ */
+
+/*
+ * The segment that gives the most free space for the copying, weighted
+ * by how long it has been left alone (cold data stays put once copied):
+ * (1 - u) * age / (1 + u), with u the fraction in use.
+ */
+static uint32_t clean_pick(lfs_fs_t *fs) {
+    uint32_t seg_bytes = (fs->sb.seg_blocks - 1) * LFS_BLOCK_SIZE;
+    uint32_t best = LFS_NO_SEG;
+    uint64_t best_score = 0;
+
+    for (uint32_t seg = 0; seg < fs->sb.segs; seg++) {
+        lfs_usage_t *u = &fs->usage[seg];
+        if (seg == fs->cur_seg || fs->seg_free[seg] || !u->live ||
+            (uint64_t)u->live * 100 >= (uint64_t)seg_bytes * LFS_CLEAN_MAX_USE) {
+            continue;
+        }
+        uint64_t score = (uint64_t)(seg_bytes - u->live) * (fs->seq - u->age + 1) /
+                         (seg_bytes + u->live);
+        if (best == LFS_NO_SEG || score > best_score) {
+            best = seg;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+static bool summary_ok(lfs_summary_t *sum, uint32_t room) {
+    if (sum->magic != LFS_SUMMARY_MAGIC || !sum->count || sum->count > room) return false;
+    uint32_t saved = sum->checksum;
+    sum->checksum = 0;
+    uint32_t check = lfs_checksum(LFS_CHECKSUM_SEED, sum, (sum->count + 1) * LFS_BLOCK_SIZE);
+    sum->checksum = saved;
+    return check == saved;
+}
+
+/* The inode a data or indirect block was written for, if it still has it */
+static lfs_node_t *block_owner(lfs_fs_t *fs, const lfs_sum_entry_t *e) {
+    if (!e->ino || e->ino >= fs->sb.inodes) return NULL;
+    lfs_imap_t *m = &fs->imap[e->ino];
+    if (!m->block || m->gen != e->gen) return NULL;
+    lfs_node_t *ln = info_get(fs, e->ino);
+    if (!ln || !ln->raw.type || (ln->raw.flags & LFS_INODE_INLINE)) return NULL;
+    return ln;
+}
+
+/* An indirect block still in use is loaded and marked to be rewritten */
+static int ind_touch(lfs_node_t *ln, uint32_t index, uint32_t addr) {
+    uint32_t lblk;                      /* A file block under it */
+    if (index == LFS_IND_SINGLE) {
+        if (ln->raw.indirect != addr) return 0;
+        lblk = LFS_NDIR;
+    } else if (index == LFS_IND_DOUBLE) {
+        if (ln->raw.dindirect != addr) return 0;
+        lblk = LFS_NDIR + LFS_PTRS;
+    } else if (index - LFS_IND_LEAF(0) < LFS_PTRS && ln->raw.dindirect) {
+        lblk = LFS_NDIR + LFS_PTRS + (index - LFS_IND_LEAF(0)) * LFS_PTRS;
+    } else {
+        return 0;
+    }
+
+    /* Looking the file block up loads the indirect blocks above it */
+    int32_t ind;
+    int err = 0;
+    bmap_slot(ln, lblk, false, &ind, &err);
+    if (err) return -1;
+    if (index >= LFS_IND_LEAF(0) && ln->map->dind[index - LFS_IND_LEAF(0)] != addr) return 0;
+    map_mark(ln, (int32_t)index);
+    mark_dirty(ln);
+    return 0;
+}
+
+/* Keep a block of the segment being cleaned if it is still in use */
+static int clean_block(lfs_fs_t *fs, const lfs_sum_entry_t *e, uint32_t addr,
+                       const uint8_t *data) {
+    switch (e->kind) {
+        case LFS_SUM_IMAP:
+            if (e->index < fs->sb.imap_blocks && fs->imap_addr[e->index] == addr) {
+                bit_set(fs->imap_dirty, e->index);
+            }
+            return 0;
+
+        case LFS_SUM_INODES: {
+            const lfs_inode_t *in = (const lfs_inode_t *)data;
+            for (uint32_t i = 0; i < LFS_INODES_PER_BLOCK; i++) {
+                uint32_t ino = in[i].ino;
+                if (!ino || ino >= fs->sb.inodes || fs->imap[ino].block != addr) continue;
+                lfs_node_t *ln = hash_find(fs, ino);
+                if (!ln && !(ln = info_new(fs, &in[i]))) return -1;
+                mark_dirty(ln);
+            }
+            return 0;
+        }
+
+        case LFS_SUM_DATA: {
+            lfs_node_t *ln = block_owner(fs, e);
+            uint32_t cur;
+            if (!ln || bmap(ln, e->index, &cur) != 0 || cur != addr) return 0;
+            uint32_t moved = log_append(fs, LFS_SUM_DATA, e->ino, e->gen, e->index, data,
+                                        LFS_BLOCK_SIZE);
+            return moved ? bmap_set(ln, e->index, moved) : -1;
+        }
+
+        case LFS_SUM_INDIRECT: {
+            lfs_node_t *ln = block_owner(fs, e);
+            return ln ? ind_touch(ln, e->index, addr) : 0;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Copy what is still live out of a segment; it is free once the next
+ * checkpoint is on disk. Its partial segments are walked in log order:
+ * the chain ends where one goes on in another segment.
+ */
+static int clean_segment(lfs_fs_t *fs, uint32_t seg) {
+    uint32_t base = seg_addr(fs, seg);
+    if (dev_read(fs, base, fs->clean_buf, fs->sb.seg_blocks) != 0) return -1;
+
+    uint32_t off = 0;
+    uint32_t seq = 0;
+    for (;;) {
+        if (off + 2 > fs->sb.seg_blocks) break;
+        lfs_summary_t *sum = (lfs_summary_t *)(fs->clean_buf + off * LFS_BLOCK_SIZE);
+        if ((off && sum->seq != seq) || !summary_ok(sum, fs->sb.seg_blocks - off - 1)) {
+            return -1;                  /* Cannot tell what is live here */
+        }
+        for (uint32_t k = 0; k < sum->count; k++) {
+            if (clean_block(fs, &sum->entries[k], base + off + 1 + k,
+                            fs->clean_buf + (off + 1 + k) * LFS_BLOCK_SIZE) != 0) {
+                return -1;
+            }
+        }
+        seq = sum->seq + 1;
+        if (sum->next != base + off + 1 + sum->count) break;
+        off += 1 + sum->count;
+    }
+    fs->usage[seg].live = 0;
+    return 0;
+}
+
+/* Clean until 'target' segments are free, or cleaning stops gaining any */
+static int clean(lfs_fs_t *fs, uint32_t target) {
+    while (fs->free_segs < target) {
+        uint32_t before = fs->free_segs;
+        uint32_t picked = 0;
+        int status = 0;
+        while (picked < LFS_CLEAN_BATCH && status == 0) {
+            uint32_t seg = clean_pick(fs);
+            if (seg == LFS_NO_SEG) break;
+            status = clean_segment(fs, seg);
+            picked++;
+        }
+        if (status == 0 && picked) status = checkpoint(fs, false);
+        temps_drop(fs);
+        if (status != 0) return -1;
+        if (!picked || fs->free_segs <= before) break;
+    }
+    return 0;
+}
+
+/* Segments emptied since the last checkpoint, free once one is written */
+static bool segs_pending(lfs_fs_t *fs) {
+    for (uint32_t seg = 0; seg < fs->sb.segs; seg++) {
+        if (!fs->seg_free[seg] && seg != fs->cur_seg && !fs->usage[seg].live) return true;
+    }
+    return false;
+}
+
+/*
+ * Called before an operation adds to the log. The last few segments
+ * are kept for the cleaner: once down to them, clean in the foreground
+ * first. Returns -1 if the disk is full.
+ */
+static int space_check(lfs_fs_t *fs) {
+    if (fs->free_segs < LFS_CLEAN_LOW) {
+        uint32_t irq = irq_save();
+        wait_queue_wake_all(&fs->daemon_wait);
+        irq_restore(irq);
+    }
+    if (fs->free_segs > LFS_RESERVE_SEGS) return 0;
+
+    if (segs_pending(fs) && checkpoint(fs, false) != 0) return -1;
+    if (fs->free_segs <= LFS_RESERVE_SEGS) clean(fs, LFS_RESERVE_SEGS + 1);
+    return fs->free_segs > LFS_RESERVE_SEGS ? 0 : -1;
+}
+
+/* Checkpoints every few seconds; cleaning when free segments run low */
+static void lfs_daemon(void) {
+    lfs_fs_t *fs = (lfs_fs_t *)process_current()->arg;
+
+    for (;;) {
+        uint32_t irq = irq_save();
+        if (!fs->stopping) wait_queue_sleep_timeout(&fs->daemon_wait, LFS_DAEMON_MS);
+        bool stop = fs->stopping;
+        irq_restore(irq);
+        if (stop) return;
+
+        fs_lock(fs);
+        if (fs->free_segs < LFS_CLEAN_LOW) clean(fs, LFS_CLEAN_HIGH);
+        if (timer_get_uptime_ms() - fs->cp_ms >= LFS_CHECKPOINT_MS && log_changed(fs)) {
+            checkpoint(fs, false);
+        }
+        fs_unlock(fs);
+    }
+}
+
+/*
+ * ===========================================================================
+ * Directory Operations
+ * ===========================================================================
+ */
+
+static fs_node_t *lfs_finddir(fs_node_t *dir, const char *name) {
+    lfs_fs_t *fs = ((lfs_node_t *)dir->data)->fs;
+    fs_lock(fs);
+    fs_node_t *child = dir_load(dir) == 0 ? child_find(dir, name) : NULL;
+    fs_unlock(fs);
+    return child;
+}
+
+static fs_node_t *lfs_readdir(fs_node_t *dir, int index) {
+    lfs_fs_t *fs = ((lfs_node_t *)dir->data)->fs;
+    fs_lock(fs);
+    fs_node_t *child = NULL;
+    if (dir_load(dir) == 0 && index >= 0 && index < dir->child_count) {
+        child = dir->children[index];
+    }
+    fs_unlock(fs);
+    return child;
+}
+
+/* Only memory changes: the inode and the entry reach the log on sync */
+static fs_node_t *lfs_create(fs_node_t *dir, const char *name, uint8_t type) {
+    lfs_node_t *dln = (lfs_node_t *)dir->data;
+    lfs_fs_t *fs = dln->fs;
+    uint32_t len = str_len(name);
+    bool is_dir = type == FS_DIRECTORY;
+    if (len == 0 || len >= FS_NAME_MAX || (type != FS_FILE && !is_dir)) return NULL;
+
+    fs_lock(fs);
+    fs_node_t *node = NULL;
+    if (dir_load(dir) != 0 || child_find(dir, name) || child_reserve(dir) != 0 ||
+        space_check(fs) != 0) {
+        goto out;
+    }
+
+    uint32_t ino = inode_alloc(fs);
+    if (!ino) goto out;
+
+    lfs_inode_t raw;
+    mem_zero(&raw, sizeof(raw));
+    raw.ino = ino;
+    raw.type = is_dir ? LFS_TYPE_DIR : LFS_TYPE_FILE;
+    raw.nlink = 1;
+    raw.mtime = fs_time(fs);
+    raw.gen = fs->imap[ino].gen;
+    raw.flags = LFS_INODE_INLINE;
+
+    node = node_new(fs, dir, name, &raw);
+    if (!node) {
+        fs->imap[ino].block = 0;
+        goto out;
+    }
+    lfs_node_t *ln = (lfs_node_t *)node->data;
+    ln->loaded = true;
+    mark_dirty(ln);
+
+    child_add(dir, node);
+    dir_changed(dln);
+
+out:
+    fs_unlock(fs);
+    return node;
+}
+
+static int lfs_unlink(fs_node_t *dir, fs_node_t *child) {
+    lfs_node_t *dln = (lfs_node_t *)dir->data;
+    lfs_fs_t *fs = dln->fs;
+
+    fs_lock(fs);
+    int status = -1;
+    if (child->type == FS_DIRECTORY && (dir_load(child) != 0 || child->child_count)) goto out;
+
+    /* The inode itself goes on release */
+    ((lfs_node_t *)child->data)->raw.nlink = 0;
+    detach(dir, child);
+    dir_changed(dln);
+    status = 0;
+out:
+    fs_unlock(fs);
+    return status;
+}
+
+static int lfs_rename(fs_node_t *olddir, fs_node_t *child, fs_node_t *newdir,
+                      const char *newname) {
+    lfs_fs_t *fs = ((lfs_node_t *)child->data)->fs;
+    bool is_dir = child->type == FS_DIRECTORY;
+    if (str_len(newname) >= FS_NAME_MAX) return -1;
+
+    fs_lock(fs);
+    int status = -1;
+    const char *name = NULL;
+    if (dir_load(newdir) != 0) goto out;
+
+    fs_node_t *target = child_find(newdir, newname);
+    if (target == child) {
+        status = 0;
+        goto out;
+    }
+    if (target && ((target->type == FS_DIRECTORY) != is_dir ||
+                   (is_dir && (dir_load(target) != 0 || target->child_count)))) {
+        goto out;
+    }
+
+    name = name_intern(newname);
+    if (!name || (!target && child_reserve(newdir) != 0)) goto out;
+
+    if (target) {
+        ((lfs_node_t *)target->data)->raw.nlink = 0;
+        detach(newdir, target);
+    }
+    child_remove(olddir, child);
+    const char *old = child->name;
+    child->name = name;
+    child->parent = newdir;
+    child_add(newdir, child);
+    name_release(old);
+    name = NULL;
+
+    dir_changed((lfs_node_t *)olddir->data);
+    dir_changed((lfs_node_t *)newdir->data);
+    status = 0;
+
+out:
+    if (name) name_release(name);
+    fs_unlock(fs);
+    return status;
+}
+
+/*
+ * ===========================================================================
+ * Files
+ * ===========================================================================
+ */
+
+static int page_read(lfs_node_t *ln, uint32_t pgoff, uint8_t *page) {
+    if (ln->raw.flags & LFS_INODE_INLINE) {
+        mem_zero(page, PAGE_SIZE);
+        if (pgoff == 0) {
+            mem_copy(page, ln->raw.data,
+                     ln->raw.size < LFS_INLINE_MAX ? ln->raw.size : LFS_INLINE_MAX);
+        }
+        return 0;
+    }
+
+    uint32_t addr;
+    if (bmap(ln, pgoff, &addr) != 0) return -1;
+    if (!addr) {
+        mem_zero(page, PAGE_SIZE);
+        return 0;
+    }
+    return block_get(ln->fs, addr, page);
+}
+
+static int lfs_readpage(fs_node_t *node, uint32_t pgoff, void *page) {
+    lfs_node_t *ln = (lfs_node_t *)node->data;
+    fs_lock(ln->fs);
+    int status = page_read(ln, pgoff, (uint8_t *)page);
+    fs_unlock(ln->fs);
+    return status;
+}
+
+/*
+ * Read-ahead: the block addresses are looked up first (that may read
+ * indirect blocks), then one bio per page goes out while the queue is
+ * plugged, so pages written together reach the device as one request.
+ */
+static int lfs_readpages(fs_node_t *node, uint32_t pgoff, uint32_t count, uint32_t *frames) {
+    lfs_node_t *ln = (lfs_node_t *)node->data;
+    lfs_fs_t *fs = ln->fs;
+    int status = 0;
+
+    fs_lock(fs);
+    for (uint32_t done = 0; done < count && status == 0; ) {
+        uint32_t addrs[PCACHE_RA_MAX];
+        uint32_t n = count - done < PCACHE_RA_MAX ? count - done : PCACHE_RA_MAX;
+        for (uint32_t i = 0; i < n && status == 0; i++) {
+            addrs[i] = 0;
+            if (ln->raw.flags & LFS_INODE_INLINE) continue;
+            status = bmap(ln, pgoff + done + i, &addrs[i]);
+            if (status == 0 && addrs[i] && log_pending(fs, addrs[i])) addrs[i] = 0;
+        }
+
+        bio_t *first = NULL;
+        bio_t **link = &first;
+        block_plug(fs->dev);
+        for (uint32_t i = 0; i < n && status == 0; i++) {
+            uint8_t *page = (uint8_t *)frames[done + i];
+            if (!addrs[i]) {
+                status = page_read(ln, pgoff + done + i, page);   /* No I/O */
+                continue;
+            }
+            bio_t *bio = bio_alloc();
+            if (!bio) {
+                status = -1;
+                break;
+            }
+            bio->dev = fs->dev;
+            bio->op = BIO_READ;
+            bio->sector = (uint64_t)addrs[i] * fs->spb;
+            bio->nsegs = 1;
+            bio->segs[0].addr = (uint32_t)page;
+            bio->segs[0].len = PAGE_SIZE;
+            *link = bio;
+            link = (bio_t **)&bio->priv;
+            block_submit(bio);
+        }
+        block_unplug(fs->dev);
+
+        while (first) {
+            bio_t *next = (bio_t *)first->priv;
+            block_wait(first);
+            if (first->status != 0) status = -1;
+            bio_free(first);
+            first = next;
+        }
+        done += n;
+    }
+    fs_unlock(fs);
+    return status;
+}
+
+/* Append the page to the log (or keep a small file in its inode) */
+static int lfs_writepage(fs_node_t *node, uint32_t pgoff, const void *page) {
+    lfs_node_t *ln = (lfs_node_t *)node->data;
+    lfs_fs_t *fs = ln->fs;
+    if ((pgoff << PAGE_SHIFT) >= node->size) return 0;     /* Truncated away meanwhile */
+
+    fs_lock(fs);
+    int status = -1;
+    if (space_check(fs) != 0) goto out;
+
+    if (node->size <= LFS_INLINE_MAX) {
+        if (make_inline(ln, page, node->size) != 0) goto out;
+    } else {
+        if ((ln->raw.flags & LFS_INODE_INLINE) && inline_spill(ln, pgoff != 0) != 0) goto out;
+        uint32_t addr = log_append(fs, LFS_SUM_DATA, ln->raw.ino, ln->raw.gen, pgoff, page,
+                                   LFS_BLOCK_SIZE);
+        if (!addr) goto out;
+        if (bmap_set(ln, pgoff, addr) != 0) {
+            usage_dead(fs, addr, LFS_BLOCK_SIZE);
+            goto out;
+        }
+    }
+
+    ln->raw.size = node->size;
+    ln->raw.mtime = fs_time(fs);
+    mark_dirty(ln);
+    status = 0;
+out:
+    fs_unlock(fs);
+    return status;
+}
+
+static int lfs_truncate(fs_node_t *node, uint32_t size) {
+    lfs_node_t *ln = (lfs_node_t *)node->data;
+    lfs_fs_t *fs = ln->fs;
+
+    fs_lock(fs);
+    int status = 0;
+    if (ln->raw.flags & LFS_INODE_INLINE) {
+        if (size > LFS_INLINE_MAX) {
+            status = space_check(fs);
+            if (status == 0) status = inline_spill(ln, true);
+        } else if (size < ln->raw.size) {
+            mem_zero(ln->raw.data + size, LFS_INLINE_MAX - size);
+        }
+    } else if (size < ln->raw.size) {
+        trim(ln, blocks_for(size), blocks_for(ln->raw.size));
+
+        /* The cut-off tail of the last block must read back as zeros */
+        uint32_t tail = size % LFS_BLOCK_SIZE;
+        uint32_t addr = 0;
+        if (tail || size <= LFS_INLINE_MAX) status = bmap(ln, size / LFS_BLOCK_SIZE, &addr);
+        if (status == 0 && addr && (status = block_get(fs, addr, fs->scratch)) == 0) {
+            mem_zero(fs->scratch + tail, LFS_BLOCK_SIZE - tail);
+            if (size <= LFS_INLINE_MAX) {
+                status = make_inline(ln, fs->scratch, size);
+            } else if ((status = space_check(fs)) == 0) {
+                uint32_t moved = log_append(fs, LFS_SUM_DATA, ln->raw.ino, ln->raw.gen,
+                                            size / LFS_BLOCK_SIZE, fs->scratch, LFS_BLOCK_SIZE);
+                status = moved ? bmap_set(ln, size / LFS_BLOCK_SIZE, moved) : -1;
+            }
+        } else if (status == 0 && size <= LFS_INLINE_MAX) {
+            mem_zero(fs->scratch, LFS_INLINE_MAX);
+            status = make_inline(ln, fs->scratch, size);
+        }
+    }
+
+    if (status == 0) {
+        node->size = size;
+        ln->raw.size = size;
+        ln->raw.mtime = fs_time(fs);
+        mark_dirty(ln);
+    }
+    fs_unlock(fs);
+    return status;
+}
+
+/* What has been written back is on disk when this returns */
+static int lfs_fsync(fs_node_t *node) {
+    lfs_fs_t *fs = ((lfs_node_t *)node->data)->fs;
+    fs_lock(fs);
+    int status = log_sync(fs);
+    fs_unlock(fs);
+    return status;
+}
+
+/*
+ * ===========================================================================
+ * Releasing Nodes
+ * ===========================================================================
+ */
+
+/* An unlinked node is gone: its blocks now, its inode as a tombstone */
+static void lfs_release(fs_node_t *node) {
+    lfs_node_t *ln = (lfs_node_t *)node->data;
+    lfs_fs_t *fs = ln->fs;
+
+    fs_lock(fs);
+    if (node->type == FS_DIRECTORY) {
+        while (node->child_count > 0) {
+            node_free(node->children[--node->child_count]);
+        }
+    }
+    if (ln->raw.nlink == 0) {
+        trim(ln, 0, blocks_for(ln->raw.size));
+        map_flush(ln);
+        map_free(ln);
+        mem_zero(ln->raw.data, LFS_INLINE_MAX);
+        ln->raw.type = 0;
+        ln->raw.size = 0;
+        ln->raw.flags = 0;
+        ln->entries_dirty = false;
+        mark_dirty(ln);
+    }
+    node_free(node);
+    fs_unlock(fs);
+}
+
+static fs_ops_t lfs_dir_ops = {
+    .readdir = lfs_readdir,
+    .finddir = lfs_finddir,
+    .create  = lfs_create,
+    .unlink  = lfs_unlink,
+    .rename  = lfs_rename,
+    .fsync   = lfs_fsync,
+    .release = lfs_release,
+};
+
+static fs_ops_t lfs_file_ops = {
+    .truncate  = lfs_truncate,
+    .readpage  = lfs_readpage,
+    .writepage = lfs_writepage,
+    .readpages = lfs_readpages,
+    .fsync     = lfs_fsync,
+    .release   = lfs_release,
+};
+
+/*
+ * ===========================================================================
+ * Mounting and Recovery
+ * ===========================================================================
+ */
+
+/* Take the newer of the two checkpoint regions that are intact */
+static int cp_load(lfs_fs_t *fs, bool *clean) {
+    uint32_t bytes = fs->sb.cp_blocks * LFS_BLOCK_SIZE;
+    lfs_checkpoint_t *cp = (lfs_checkpoint_t *)fs->cp_buf;
+    int best = -1;
+    uint32_t serial = 0;
+
+    for (int r = 0; r < 2; r++) {
+        if (dev_read(fs, fs->sb.cp[r], fs->cp_buf, fs->sb.cp_blocks) != 0) continue;
+        uint32_t saved = cp->checksum;
+        cp->checksum = 0;
+        if (cp->magic == LFS_CP_MAGIC &&
+            lfs_checksum(LFS_CHECKSUM_SEED, fs->cp_buf, bytes) == saved &&
+            (best < 0 || cp->serial > serial)) {
+            best = r;
+            serial = cp->serial;
+        }
+    }
+    if (best < 0 || dev_read(fs, fs->sb.cp[best], fs->cp_buf, fs->sb.cp_blocks) != 0) return -1;
+
+    if (cp->seg >= fs->sb.segs || cp->head < seg_addr(fs, cp->seg) ||
+        cp->head > seg_addr(fs, cp->seg) + fs->sb.seg_blocks) {
+        return -1;
+    }
+    fs->cp_serial = cp->serial;
+    fs->cp_next = (uint32_t)best ^ 1;
+    fs->seq = fs->cp_seq = cp->seq;
+    fs->next_ino = cp->next_ino;
+    fs->epoch = cp->time;
+    fs->cur_seg = cp->seg;
+    fs->seg_off = fs->part_off = cp->head - seg_addr(fs, cp->seg);
+    *clean = cp->clean != 0;
+
+    uint8_t *at = fs->cp_buf + sizeof(lfs_checkpoint_t);
+    mem_copy(fs->imap_addr, at, fs->sb.imap_blocks * sizeof(uint32_t));
+    mem_copy(fs->usage, at + fs->sb.imap_blocks * sizeof(uint32_t),
+             fs->sb.segs * sizeof(lfs_usage_t));
+    return 0;
+}
+
+/*
+ * Replay the partial segments written after the checkpoint: the inodes
+ * they hold become current. Stops at the first one that is missing,
+ * torn or out of sequence. Returns how many were replayed.
+ */
+static uint32_t roll_forward(lfs_fs_t *fs) {
+    uint32_t count = 0;
+    lfs_summary_t *sum = (lfs_summary_t *)fs->clean_buf;
+
+    while (fs->sb.seg_blocks - fs->seg_off >= 2) {
+        uint32_t room = fs->sb.seg_blocks - fs->seg_off - 1;
+        uint32_t head = seg_addr(fs, fs->cur_seg) + fs->seg_off;
+        if (dev_read(fs, head, sum, 1) != 0 || sum->magic != LFS_SUMMARY_MAGIC ||
+            sum->seq != fs->seq || !sum->count || sum->count > room ||
+            dev_read(fs, head + 1, fs->clean_buf + LFS_BLOCK_SIZE, sum->count) != 0 ||
+            !summary_ok(sum, room)) {
+            break;
+        }
+
+        for (uint32_t k = 0; k < sum->count; k++) {
+            if (sum->entries[k].kind != LFS_SUM_INODES) continue;
+            const lfs_inode_t *in =
+                (const lfs_inode_t *)(fs->clean_buf + (k + 1) * LFS_BLOCK_SIZE);
+            for (uint32_t i = 0; i < LFS_INODES_PER_BLOCK; i++) {
+                uint32_t ino = in[i].ino;
+                if (!ino || ino >= fs->sb.inodes) continue;
+                fs->imap[ino].block = in[i].type ? head + 1 + k : 0;
+                fs->imap[ino].gen = in[i].gen;
+                imap_mark(fs, ino);
+            }
+        }
+        fs->seq++;
+        count++;
+
+        /* Follow the log: on in this segment, or into the one it took */
+        uint32_t end = fs->seg_off + 1 + sum->count;
+        uint32_t next_seg = addr_seg(fs, sum->next);
+        if (end + 2 <= fs->sb.seg_blocks && sum->next == head + 1 + sum->count) {
+            fs->seg_off = fs->part_off = end;
+        } else if (next_seg != LFS_NO_SEG && next_seg != fs->cur_seg &&
+                   sum->next == seg_addr(fs, next_seg)) {
+            if (fs->seg_free[next_seg]) {
+                fs->seg_free[next_seg] = 0;
+                fs->free_segs--;
+            }
+            seg_begin(fs, next_seg);
+        } else {
+            fs->seg_off = fs->part_off = end;     /* It ran out of segments there */
+            break;
+        }
+    }
+    return count;
+}
+
+typedef struct {
+    lfs_fs_t *fs;
+    uint32_t *seen;                     /* Bitmap by inode number */
+    uint32_t *queue;
+    uint32_t tail;
+} lfs_scan_t;
+
+static int scan_entry(void *arg, const lfs_dirent_t *de) {
+    lfs_scan_t *scan = (lfs_scan_t *)arg;
+    uint32_t ino = de->ino;
+    if (ino >= scan->fs->sb.inodes || !scan->fs->imap[ino].block || bit_test(scan->seen, ino)) {
+        return 0;
+    }
+    bit_set(scan->seen, ino);
+    scan->queue[scan->tail++] = ino;
+    return 0;
+}
+
+static void count_ptrs(lfs_fs_t *fs, const uint32_t *block) {
+    for (uint32_t i = 0; i < LFS_PTRS; i++) {
+        if (block[i]) usage_add(fs, block[i], LFS_BLOCK_SIZE);
+    }
+}
+
+/* Count an inode's blocks into the usage of their segments */
+static int count_blocks(lfs_node_t *ln) {
+    lfs_fs_t *fs = ln->fs;
+    if (ln->raw.flags & LFS_INODE_INLINE) return 0;
+    for (uint32_t i = 0; i < LFS_NDIR; i++) {
+        if (ln->raw.direct[i]) usage_add(fs, ln->raw.direct[i], LFS_BLOCK_SIZE);
+    }
+    if (!ln->raw.indirect && !ln->raw.dindirect) return 0;
+
+    /* Loading block 0 of each indirect block brings in the map */
+    int32_t ind;
+    int err = 0;
+    if (ln->raw.indirect) {
+        usage_add(fs, ln->raw.indirect, LFS_BLOCK_SIZE);
+        if (!bmap_slot(ln, LFS_NDIR, false, &ind, &err)) return -1;
+        count_ptrs(fs, ln->map->ind);
+    }
+    if (ln->raw.dindirect) {
+        usage_add(fs, ln->raw.dindirect, LFS_BLOCK_SIZE);
+        for (uint32_t i = 0; i < LFS_PTRS; i++) {
+            bmap_slot(ln, LFS_NDIR + LFS_PTRS + i * LFS_PTRS, false, &ind, &err);
+            if (err || !ln->map->dind) return -1;
+            if (!ln->map->dind[i]) continue;
+            usage_add(fs, ln->map->dind[i], LFS_BLOCK_SIZE);
+            count_ptrs(fs, ln->map->leaf[i]);
+        }
+    }
+    return 0;
+}
+
+/*
+ * After a crash: free the inodes no directory names any more (files
+ * removed while open, or made just before), and count again what each
+ * segment holds, since the checkpoint's figures are out of date.
+ */
+static int recover(lfs_fs_t *fs) {
+    uint32_t n = fs->sb.inodes;
+    uint32_t seen_pages = pages_for((n + 31) / 32 * sizeof(uint32_t));
+    uint32_t queue_pages = pages_for(n * sizeof(uint32_t));
+    lfs_scan_t scan = { fs, (uint32_t *)pmm_alloc_pages(seen_pages),
+                        (uint32_t *)pmm_alloc_pages(queue_pages), 0 };
+    int status = -1;
+    if (!scan.seen || !scan.queue) goto out;
+    mem_zero(scan.seen, seen_pages * PAGE_SIZE);
+
+    for (uint32_t seg = 0; seg < fs->sb.segs; seg++) {
+        fs->usage[seg].live = 0;
+    }
+    for (uint32_t i = 0; i < fs->sb.imap_blocks; i++) {
+        if (fs->imap_addr[i]) usage_add(fs, fs->imap_addr[i], LFS_BLOCK_SIZE);
+    }
+
+    /* Breadth first from the root: each inode is queued once */
+    bit_set(scan.seen, LFS_ROOT_INO);
+    scan.queue[scan.tail++] = LFS_ROOT_INO;
+    for (uint32_t head = 0; head < scan.tail; head++) {
+        uint32_t ino = scan.queue[head];
+        lfs_inode_t raw;
+        lfs_node_t *ln;
+        if (inode_read(fs, ino, &raw) != 0 || !(ln = info_new(fs, &raw))) goto out;
+
+        usage_add(fs, fs->imap[ino].block, LFS_INODE_SIZE);
+        int err = count_blocks(ln);
+        if (!err && raw.type == LFS_TYPE_DIR) err = dir_walk(ln, scan_entry, &scan);
+        info_free(ln);
+        if (err) goto out;
+    }
+
+    for (uint32_t ino = LFS_ROOT_INO + 1; ino < n; ino++) {
+        if (fs->imap[ino].block && !bit_test(scan.seen, ino)) {
+            fs->imap[ino].block = 0;
+            imap_mark(fs, ino);
+        }
+    }
+    status = 0;
+out:
+    if (scan.seen) pmm_free_pages((uint32_t)scan.seen, seen_pages);
+    if (scan.queue) pmm_free_pages((uint32_t)scan.queue, queue_pages);
+    return status;
+}
+
+static void fs_free(lfs_fs_t *fs) {
+    /* Inode state a failed checkpoint left behind */
+    for (uint32_t b = 0; b < LFS_HASH_SIZE; b++) {
+        while (fs->hash[b]) info_free(fs->hash[b]);
+    }
+
+    lfs_super_t *s = &fs->sb;
+    if (fs->imap) pmm_free_pages((uint32_t)fs->imap, s->imap_blocks);
+    if (fs->imap_addr) pmm_free_pages((uint32_t)fs->imap_addr, pages_for(s->imap_blocks * 4));
+    if (fs->imap_dirty) pmm_free_pages((uint32_t)fs->imap_dirty, pages_for(s->imap_blocks / 8 + 4));
+    if (fs->usage) pmm_free_pages((uint32_t)fs->usage, pages_for(s->segs * sizeof(lfs_usage_t)));
+    if (fs->seg_free) pmm_free_pages((uint32_t)fs->seg_free, pages_for(s->segs));
+    if (fs->seg_buf) pmm_free_pages((uint32_t)fs->seg_buf, s->seg_blocks);
+    if (fs->clean_buf) pmm_free_pages((uint32_t)fs->clean_buf, s->seg_blocks);
+    if (fs->cp_buf) pmm_free_pages((uint32_t)fs->cp_buf, s->cp_blocks);
+    if (fs->scratch) pmm_free_pages((uint32_t)fs->scratch, 1);
+    if (fs->iblock) pmm_free_pages((uint32_t)fs->iblock, 1);
+    pmm_free_pages((uint32_t)fs, pages_for(sizeof(lfs_fs_t)));
+}
+
+static bool super_ok(lfs_fs_t *fs) {
+    lfs_super_t *s = &fs->sb;
+    return s->magic == LFS_MAGIC && s->version == LFS_VERSION &&
+           s->block_size == LFS_BLOCK_SIZE &&
+           s->seg_blocks >= 4 && s->seg_blocks <= LFS_SEG_MAX_BLOCKS &&
+           s->segs > LFS_RESERVE_SEGS + 1 && s->inodes > LFS_ROOT_INO + 1 &&
+           s->imap_blocks == (s->inodes + LFS_IMAP_PER_BLOCK - 1) / LFS_IMAP_PER_BLOCK &&
+           (uint64_t)s->cp_blocks * LFS_BLOCK_SIZE >= sizeof(lfs_checkpoint_t) +
+               (uint64_t)s->imap_blocks * 4 + (uint64_t)s->segs * sizeof(lfs_usage_t) &&
+           s->cp[0] + s->cp_blocks <= s->seg_start && s->cp[1] + s->cp_blocks <= s->seg_start &&
+           s->cp[0] && s->cp[1] &&
+           (uint64_t)s->seg_start + (uint64_t)s->segs * s->seg_blocks <= s->blocks &&
+           (uint64_t)s->blocks * fs->spb <= fs->dev->sectors;
+}
+
+static int lfs_mount(superblock_t *sb, const char *source) {
+    block_device_t *dev = block_find(source);
+    if (!dev) return -1;
+
+    lfs_fs_t *fs = (lfs_fs_t *)pmm_alloc_pages(pages_for(sizeof(lfs_fs_t)));
+    if (!fs) return -1;
+    mem_zero(fs, sizeof(lfs_fs_t));
+    fs->dev = dev;
+    fs->spb = LFS_BLOCK_SIZE / BLOCK_SECTOR_SIZE;
+    fs->daemon = -1;
+    wait_queue_init(&fs->wait);
+    wait_queue_init(&fs->daemon_wait);
+
+    fs->scratch = (uint8_t *)pmm_alloc_page();
+    fs->iblock = (uint8_t *)pmm_alloc_page();
+    if (!fs->scratch || !fs->iblock || dev_read(fs, 0, fs->scratch, 1) != 0) goto fail;
+    mem_copy(&fs->sb, fs->scratch, sizeof(lfs_super_t));
+    if (!super_ok(fs)) {
+        mem_zero(&fs->sb, sizeof(lfs_super_t));     /* fs_free goes by it */
+        goto fail;
+    }
+
+    lfs_super_t *s = &fs->sb;
+    fs->imap = (lfs_imap_t *)pmm_alloc_pages(s->imap_blocks);
+    fs->imap_addr = (uint32_t *)pmm_alloc_pages(pages_for(s->imap_blocks * 4));
+    fs->imap_dirty = (uint32_t *)pmm_alloc_pages(pages_for(s->imap_blocks / 8 + 4));
+    fs->usage = (lfs_usage_t *)pmm_alloc_pages(pages_for(s->segs * sizeof(lfs_usage_t)));
+    fs->seg_free = (uint8_t *)pmm_alloc_pages(pages_for(s->segs));
+    fs->seg_buf = (uint8_t *)pmm_alloc_pages(s->seg_blocks);
+    fs->clean_buf = (uint8_t *)pmm_alloc_pages(s->seg_blocks);
+    fs->cp_buf = (uint8_t *)pmm_alloc_pages(s->cp_blocks);
+    if (!fs->imap || !fs->imap_addr || !fs->imap_dirty || !fs->usage || !fs->seg_free ||
+        !fs->seg_buf || !fs->clean_buf || !fs->cp_buf) {
+        goto fail;
+    }
+    mem_zero(fs->imap_dirty, pages_for(s->imap_blocks / 8 + 4) * PAGE_SIZE);
+
+    bool clean;
+    if (cp_load(fs, &clean) != 0) goto fail;
+    for (uint32_t i = 0; i < s->imap_blocks; i++) {
+        lfs_imap_t *part = fs->imap + i * LFS_IMAP_PER_BLOCK;
+        if (!fs->imap_addr[i]) {
+            mem_zero(part, LFS_BLOCK_SIZE);
+        } else if (dev_read(fs, fs->imap_addr[i], part, 1) != 0) {
+            goto fail;
+        }
+    }
+    for (uint32_t seg = 0; seg < s->segs; seg++) {
+        fs->seg_free[seg] = seg != fs->cur_seg && !fs->usage[seg].live;
+        fs->free_segs += fs->seg_free[seg];
+    }
+
+    if ((roll_forward(fs) || !clean) && recover(fs) != 0) goto fail;
+
+    lfs_inode_t raw;
+    if (inode_read(fs, LFS_ROOT_INO, &raw) != 0 || raw.type != LFS_TYPE_DIR) goto fail;
+    fs->root = node_new(fs, NULL, "/", &raw);
+    if (!fs->root) goto fail;
+    fs->root->parent = fs->root;
+
+    /* Not clean until unmounted; recovery's work is kept */
+    if (checkpoint(fs, false) != 0) {
+        node_free(fs->root);
+        goto fail;
+    }
+    fs->daemon = process_create_arg("lfsd", lfs_daemon, PRIORITY_LOW, fs);
+
+    sb->root = fs->root;
+    sb->priv = fs;
+    return 0;
+
+fail:
+    fs_free(fs);
+    return -1;
+}
+
+static void tree_sync(fs_node_t *node) {
+    if (node->type == FS_DIRECTORY) {
+        for (int i = 0; i < node->child_count; i++) {
+            tree_sync(node->children[i]);
+        }
+    } else if (pcache_backed(node)) {
+        pcache_sync(node);
+    }
+}
+
+static void lfs_unmount(superblock_t *sb) {
+    lfs_fs_t *fs = (lfs_fs_t *)sb->priv;
+    if (!fs) return;
+
+    if (fs->daemon >= 0) {
+        uint32_t irq = irq_save();
+        fs->stopping = true;
+        wait_queue_wake_all(&fs->daemon_wait);
+        irq_restore(irq);
+        process_wait((uint32_t)fs->daemon);
+    }
+
+    /* File data into the log, then the last checkpoint, marked clean */
+    tree_sync(fs->root);
+    fs_lock(fs);
+    checkpoint(fs, true);
+    fs_unlock(fs);
+
+    vfs_tree_free(fs->root, node_free);
+    fs_free(fs);
+    sb->priv = NULL;
+}
+
+static fs_type_t lfs_type = {
+    .name    = "lfs",
+    .mount   = lfs_mount,
+    .unmount = lfs_unmount,
+};
+
+void lfs_init(void) {
+    vfs_register_fs(&lfs_type);
+}
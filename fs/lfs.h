@@ -0,0 +1,167 @@
+/*
+ * ClaudeOS Log-Structured Filesystem - On-Disk Format
+ * Worker1 - Shell+FS Claude
+ *
+ * ClaudeOS's own disk format, made for many small writes. Nothing is
+ * updated in place: file data, indirect blocks, inodes and pieces of
+ * the inode map are appended to a log that is written a segment at a
+ * time. Block 0 holds the superblock, followed by two checkpoint
+ * regions written in turn, then the segments.
+ *
+ * A segment is filled by one or more partial segments, each a summary
+ * block naming what the blocks after it are, then those blocks. A
+ * checkpoint records where the inode map blocks are, how full each
+ * segment is and where the log goes on; after a crash the partial
+ * segments written since are replayed ("rolled forward") from there.
+ */
+
+#ifndef CLAUDEOS_LFS_H
+#define CLAUDEOS_LFS_H
+
+#include "../include/types.h"
+
+#define LFS_MAGIC               0x3153464C      /* "LFS1" */
+#define LFS_SUMMARY_MAGIC       0x4D55534C      /* "LSUM" */
+#define LFS_CP_MAGIC            0x5043534C      /* "LSCP" */
+#define LFS_VERSION             1
+
+#define LFS_BLOCK_SIZE          4096
+#define LFS_ROOT_INO            1
+#define LFS_INODE_SIZE          128
+#define LFS_INODES_PER_BLOCK    32
+#define LFS_IMAP_PER_BLOCK      512             /* 8-byte entries */
+#define LFS_PTRS                1024            /* Block pointers per indirect block */
+#define LFS_SEG_MAX_BLOCKS      128             /* One summary block describes them all */
+
+/* Inode block pointers, or the data of a small file in their place */
+#define LFS_NDIR                22
+#define LFS_INLINE_MAX          96
+
+/* Inode types; 0 in the last copy of a deleted inode */
+#define LFS_TYPE_FILE           1
+#define LFS_TYPE_DIR            2
+
+/* Inode flags */
+#define LFS_INODE_INLINE        0x0001  /* Data is in the inode, no blocks */
+
+/* What a block of a partial segment holds (summary entry kind) */
+#define LFS_SUM_DATA            1       /* Block 'index' of inode 'ino' */
+#define LFS_SUM_INDIRECT        2       /* Indirect block 'index' of 'ino' (see below) */
+#define LFS_SUM_INODES          3       /* A block of inodes */
+#define LFS_SUM_IMAP            4       /* Inode map block 'index' */
+
+/*
+ * Indirect block numbers: 0 is the single indirect block, 1 the double
+ * indirect block and 2 + i the i-th block under it.
+ */
+#define LFS_IND_SINGLE          0
+#define LFS_IND_DOUBLE          1
+#define LFS_IND_LEAF(i)         (2 + (i))
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t blocks;
+    uint32_t seg_blocks;                /* Blocks per segment */
+    uint32_t segs;
+    uint32_t seg_start;                 /* First block of segment 0 */
+    uint32_t inodes;                    /* Entries in the inode map */
+    uint32_t imap_blocks;
+    uint32_t cp_blocks;                 /* Size of a checkpoint region */
+    uint32_t cp[2];                     /* Where the two regions start */
+    char     label[16];
+} __attribute__((packed)) lfs_super_t;
+
+/*
+ * Head of a checkpoint region. It is followed by the address of every
+ * inode map block (0 for one never written: all free) and the usage of
+ * every segment; the checksum covers the whole region.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t serial;                    /* The valid region with the higher one wins */
+    uint32_t seq;                       /* Number of the next partial segment */
+    uint32_t seg;                       /* Segment the log is in */
+    uint32_t head;                      /* Block where the next one goes (may be its end) */
+    uint32_t next_ino;                  /* Where to look for a free inode number */
+    uint32_t time;
+    uint32_t clean;                     /* Written at unmount: nothing to recover */
+    uint32_t checksum;
+} __attribute__((packed)) lfs_checkpoint_t;
+
+typedef struct {
+    uint32_t live;                      /* Bytes still in use */
+    uint32_t age;                       /* Sequence number of the last write */
+} __attribute__((packed)) lfs_usage_t;
+
+typedef struct {
+    uint32_t block;                     /* Inode block holding the inode, 0 if free */
+    uint32_t gen;                       /* Generation of the number's current user */
+} __attribute__((packed)) lfs_imap_t;
+
+typedef struct {
+    uint32_t ino;
+    uint32_t gen;
+    uint32_t index;
+    uint32_t kind;                      /* LFS_SUM_* */
+} __attribute__((packed)) lfs_sum_entry_t;
+
+/* First block of a partial segment */
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;                       /* Partial segments are numbered in log order */
+    uint32_t next;                      /* Block where the next one goes */
+    uint32_t count;                     /* Blocks after this one */
+    uint32_t checksum;                  /* Of this block (with 0 here) and those blocks */
+    uint32_t time;
+    uint32_t reserved[2];
+    lfs_sum_entry_t entries[];          /* One per block */
+} __attribute__((packed)) lfs_summary_t;
+
+typedef struct {
+    uint32_t ino;
+    uint16_t type;                      /* LFS_TYPE_* */
+    uint16_t nlink;
+    uint32_t size;                      /* Bytes; a directory's entries */
+    uint32_t mtime;
+    uint32_t gen;
+    uint32_t flags;                     /* LFS_INODE_* */
+    uint32_t reserved[2];
+    union {
+        struct {
+            uint32_t direct[LFS_NDIR];
+            uint32_t indirect;
+            uint32_t dindirect;
+        };
+        uint8_t data[LFS_INLINE_MAX];   /* With LFS_INODE_INLINE */
+    };
+} __attribute__((packed)) lfs_inode_t;
+
+/*
+ * Directory entry. A directory's data is a run of these, each padded
+ * to 4 bytes; none crosses a block, and ino 0 ends a block early. There
+ * are no "." and ".." entries.
+ */
+typedef struct {
+    uint32_t ino;
+    uint8_t  type;                      /* LFS_TYPE_* */
+    uint8_t  name_len;
+    char     name[];
+} __attribute__((packed)) lfs_dirent_t;
+
+#define LFS_DIRENT_HEADER       6
+#define LFS_DIRENT_SIZE(len)    ((LFS_DIRENT_HEADER + (len) + 3) & ~3u)
+
+/* Checksum of summaries and checkpoints (FNV-1a over 32-bit words) */
+static inline uint32_t lfs_checksum(uint32_t sum, const void *data, uint32_t bytes) {
+    const uint32_t *w = (const uint32_t *)data;
+    for (uint32_t i = 0; i < bytes / 4; i++) {
+        sum = (sum ^ w[i]) * 16777619u;
+    }
+    return sum;
+}
+
+#define LFS_CHECKSUM_SEED       2166136261u
+
+#endif /* CLAUDEOS_LFS_H */
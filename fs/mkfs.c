@@ -0,0 +1,529 @@
+/*
+ * ClaudeOS mkfs - Implementation
+ * Worker1 - Shell+FS Claude
+ *
+ * The ext2 layout matches what mke2fs writes for a revision 1
+ * filesystem with the filetype and sparse_super features: in each
+ * group, an optional superblock and descriptor backup, the two bitmaps,
+ * then the group's inode table. Group 0 also holds the root directory
+ * and lost+found, one block each.
+ *
+ * FAT32 follows mkfs.fat: 32 reserved sectors (boot sector, FSInfo,
+ * backups at 6 and 7), two FATs, and the root directory in cluster 2.
+ *
+ * The log-structured format is the superblock, the two checkpoint
+ * regions and 256KB segments. Segment 0 starts the log with one partial
+ * segment holding the root inode and the first inode map block.
+ */
+
+#include "mkfs.h"
+#include "ext2.h"
+#include "fat.h"
+#include "lfs.h"
+#include "../include/pmm.h"
+#include "../include/timer.h"
+
+#define MKFS_BYTES_PER_INODE    4096
+#define MKFS_ZERO_PAGES         16      /* Zero buffer for inode tables */
+#define MKFS_MIN_LAST_GROUP     50      /* Data blocks a short last group needs */
+#define MKFS_FAT_RESERVED       32      /* Sectors before the first FAT */
+#define MKFS_FAT_MIN_CLUSTERS   65525   /* Fewer and others take it for FAT16 */
+#define MKFS_LFS_SEG_BLOCKS     64      /* 256KB segments */
+#define MKFS_LFS_MIN_SEGS       8
+
+static void mem_zero(void *dst, uint32_t n) {
+    char *d = (char *)dst;
+    while (n--) *d++ = 0;
+}
+
+static void mem_copy(void *dst, const void *src, uint32_t n) {
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    while (n--) *d++ = *s++;
+}
+
+static int str_eq(const char *a, const char *b) {
+    while (*a && *a == *b) { a++; b++; }
+    return *a == *b;
+}
+
+static void set_bits(uint8_t *map, uint32_t from, uint32_t to) {
+    for (uint32_t i = from; i < to; i++) {
+        map[i >> 3] |= (uint8_t)(1 << (i & 7));
+    }
+}
+
+/*
+ * ===========================================================================
+ * ext2
+ * ===========================================================================
+ */
+
+typedef struct {
+    block_device_t *dev;
+    uint32_t bs;                /* Block size */
+    uint32_t spb;               /* Sectors per block */
+} ext2_mk_t;
+
+static int put_blocks(ext2_mk_t *mk, uint32_t block, const void *buf, uint32_t count) {
+    return block_write(mk->dev, (uint64_t)block * mk->spb, buf, count * mk->spb);
+}
+
+/* Metadata blocks at the start of group 'g' before its inode table ends */
+static uint32_t group_overhead(uint32_t g, uint32_t gdt_blocks, uint32_t itb) {
+    return (ext2_group_has_super(g) ? 1 + gdt_blocks : 0) + 2 + itb;
+}
+
+static void add_dirent(uint8_t *block, uint32_t *pos, uint32_t ino, const char *name,
+                       uint8_t type, uint32_t rec_len) {
+    ext2_dirent_t *de = (ext2_dirent_t *)(block + *pos);
+    uint32_t len = 0;
+    while (name[len]) len++;
+    de->inode = ino;
+    de->rec_len = (uint16_t)rec_len;
+    de->name_len = (uint8_t)len;
+    de->file_type = type;
+    mem_copy(de->name, name, len);
+    *pos += rec_len;
+}
+
+int mkfs_ext2(block_device_t *dev, const mkfs_opts_t *opts, mkfs_result_t *result) {
+    if (!dev) return -1;
+
+    uint64_t bytes = dev->sectors << BLOCK_SECTOR_SHIFT;
+    uint32_t bs = opts && opts->block_size ? opts->block_size
+                : (dev->ops->share_page || bytes >= (512ULL << 20)) ? 4096 : 1024;
+    if (bs != 1024 && bs != 2048 && bs != 4096) return -1;
+    uint32_t per_inode = opts && opts->bytes_per_inode ? opts->bytes_per_inode
+                       : MKFS_BYTES_PER_INODE;
+    if (per_inode < bs) per_inode = bs;
+
+    ext2_mk_t mk = { dev, bs, bs >> BLOCK_SECTOR_SHIFT };
+    uint64_t total64 = bytes / bs;
+    uint32_t total = total64 > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)total64;
+    uint32_t first = bs == 1024 ? 1 : 0;
+    uint32_t bpg = bs * 8;
+    uint32_t per_block = bs / EXT2_GOOD_OLD_INODE_SIZE;
+    if (total < 64) return -1;
+
+    /* Groups and inodes; a last group too small to be useful is dropped */
+    uint32_t groups, ipg, itb, gdt_blocks;
+    for (;;) {
+        groups = (total - first + bpg - 1) / bpg;
+        uint32_t inodes = (uint32_t)(((uint64_t)total * bs) / per_inode);
+        ipg = (inodes + groups - 1) / groups;
+        if (ipg < EXT2_GOOD_OLD_FIRST_INO + 5) ipg = EXT2_GOOD_OLD_FIRST_INO + 5;
+        ipg = (ipg + per_block - 1) / per_block * per_block;
+        ipg = (ipg + 7) & ~7u;
+        if (ipg > bpg) ipg = bpg;
+        itb = ipg / per_block;
+        gdt_blocks = (groups * sizeof(ext2_group_desc_t) + bs - 1) / bs;
+
+        uint32_t last = total - first - (groups - 1) * bpg;
+        uint32_t need = group_overhead(groups - 1, gdt_blocks, itb) + MKFS_MIN_LAST_GROUP;
+        if (groups == 1 || last >= need) break;
+        total -= last;
+    }
+    if (group_overhead(0, gdt_blocks, itb) + 2 + MKFS_MIN_LAST_GROUP > total - first) {
+        return -1;
+    }
+
+    /* Buffers: one block of bitmap/directory scratch, the descriptors,
+     * a zeroed run for inode tables and one for the superblock */
+    uint32_t gdt_pages = (gdt_blocks * bs + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t block_pages = (bs + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t scratch = pmm_alloc_pages(block_pages);
+    uint32_t gdt_mem = pmm_alloc_pages(gdt_pages);
+    uint32_t zeros = pmm_alloc_pages(MKFS_ZERO_PAGES);
+    uint32_t super_mem = pmm_alloc_pages(1);
+    int status = -1;
+    if (!scratch || !gdt_mem || !zeros || !super_mem) goto out;
+
+    uint8_t *buf = (uint8_t *)scratch;
+    ext2_group_desc_t *gdt = (ext2_group_desc_t *)gdt_mem;
+    ext2_super_t *sb = (ext2_super_t *)super_mem;
+    mem_zero(gdt, gdt_pages * PAGE_SIZE);
+    mem_zero((void *)zeros, MKFS_ZERO_PAGES * PAGE_SIZE);
+    mem_zero(sb, PAGE_SIZE);
+
+    /* Lay out the groups and write their bitmaps and inode tables */
+    uint32_t free_blocks = 0;
+    uint32_t root_block = 0;
+    for (uint32_t g = 0; g < groups; g++) {
+        uint32_t start = first + g * bpg;
+        uint32_t count = g == groups - 1 ? total - start : bpg;
+        uint32_t meta = ext2_group_has_super(g) ? 1 + gdt_blocks : 0;
+        uint32_t used = meta + 2 + itb;
+
+        gdt[g].bg_block_bitmap = start + meta;
+        gdt[g].bg_inode_bitmap = start + meta + 1;
+        gdt[g].bg_inode_table = start + meta + 2;
+        gdt[g].bg_free_inodes_count = (uint16_t)ipg;
+        if (g == 0) {
+            root_block = start + used;
+            used += 2;                                      /* Root, lost+found */
+            gdt[g].bg_free_inodes_count = (uint16_t)(ipg - EXT2_GOOD_OLD_FIRST_INO);
+            gdt[g].bg_used_dirs_count = 2;
+        }
+        gdt[g].bg_free_blocks_count = (uint16_t)(count - used);
+        free_blocks += count - used;
+
+        /* Block bitmap: metadata at the front, padding past the end */
+        mem_zero(buf, bs);
+        set_bits(buf, 0, used);
+        set_bits(buf, count, bs * 8);
+        if (put_blocks(&mk, gdt[g].bg_block_bitmap, buf, 1) != 0) goto out;
+
+        mem_zero(buf, bs);
+        if (g == 0) set_bits(buf, 0, EXT2_GOOD_OLD_FIRST_INO);
+        set_bits(buf, ipg, bs * 8);
+        if (put_blocks(&mk, gdt[g].bg_inode_bitmap, buf, 1) != 0) goto out;
+
+        uint32_t chunk = MKFS_ZERO_PAGES * PAGE_SIZE / bs;
+        for (uint32_t b = 0; b < itb; b += chunk) {
+            uint32_t n = itb - b < chunk ? itb - b : chunk;
+            if (put_blocks(&mk, gdt[g].bg_inode_table + b, (void *)zeros, n) != 0) goto out;
+        }
+    }
+
+    /* Root directory and lost+found */
+    uint32_t pos = 0;
+    mem_zero(buf, bs);
+    add_dirent(buf, &pos, EXT2_ROOT_INO, ".", EXT2_FT_DIR, 12);
+    add_dirent(buf, &pos, EXT2_ROOT_INO, "..", EXT2_FT_DIR, 12);
+    add_dirent(buf, &pos, EXT2_GOOD_OLD_FIRST_INO, "lost+found", EXT2_FT_DIR, bs - pos);
+    if (put_blocks(&mk, root_block, buf, 1) != 0) goto out;
+
+    pos = 0;
+    mem_zero(buf, bs);
+    add_dirent(buf, &pos, EXT2_GOOD_OLD_FIRST_INO, ".", EXT2_FT_DIR, 12);
+    add_dirent(buf, &pos, EXT2_ROOT_INO, "..", EXT2_FT_DIR, bs - pos);
+    if (put_blocks(&mk, root_block + 1, buf, 1) != 0) goto out;
+
+    /* Their inodes, in the first inode table block(s) of group 0 */
+    uint32_t itable_bytes = EXT2_GOOD_OLD_FIRST_INO * EXT2_GOOD_OLD_INODE_SIZE;
+    uint32_t itable_blocks = (itable_bytes + bs - 1) / bs;
+    uint8_t *itable = (uint8_t *)zeros;
+    ext2_inode_t *root = (ext2_inode_t *)(itable + (EXT2_ROOT_INO - 1) * EXT2_GOOD_OLD_INODE_SIZE);
+    ext2_inode_t *lpf = (ext2_inode_t *)(itable + (EXT2_GOOD_OLD_FIRST_INO - 1) *
+                                         EXT2_GOOD_OLD_INODE_SIZE);
+    root->i_mode = EXT2_S_IFDIR | 0755;
+    root->i_links_count = 3;
+    root->i_size = bs;
+    root->i_blocks = bs / 512;
+    root->i_block[0] = root_block;
+    lpf->i_mode = EXT2_S_IFDIR | 0700;
+    lpf->i_links_count = 2;
+    lpf->i_size = bs;
+    lpf->i_blocks = bs / 512;
+    lpf->i_block[0] = root_block + 1;
+    int err = put_blocks(&mk, gdt[0].bg_inode_table, itable, itable_blocks);
+    mem_zero(itable, itable_blocks * bs);
+    if (err != 0) goto out;
+
+    /* Superblock and descriptors, primary then backups */
+    sb->s_inodes_count = ipg * groups;
+    sb->s_blocks_count = total;
+    sb->s_free_blocks_count = free_blocks;
+    sb->s_free_inodes_count = ipg * groups - EXT2_GOOD_OLD_FIRST_INO;
+    sb->s_first_data_block = first;
+    sb->s_log_block_size = bs == 1024 ? 0 : bs == 2048 ? 1 : 2;
+    sb->s_log_frag_size = sb->s_log_block_size;
+    sb->s_blocks_per_group = bpg;
+    sb->s_frags_per_group = bpg;
+    sb->s_inodes_per_group = ipg;
+    sb->s_max_mnt_count = 0xFFFF;
+    sb->s_magic = EXT2_MAGIC;
+    sb->s_state = 1;
+    sb->s_errors = 1;
+    sb->s_rev_level = 1;
+    sb->s_first_ino = EXT2_GOOD_OLD_FIRST_INO;
+    sb->s_inode_size = EXT2_GOOD_OLD_INODE_SIZE;
+    sb->s_feature_incompat = EXT2_FEATURE_INCOMPAT_FILETYPE;
+    sb->s_feature_ro_compat = EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER;
+    uint64_t seed = timer_read_tsc();
+    for (int i = 0; i < 16; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        sb->s_uuid[i] = (uint8_t)(seed >> 56);
+    }
+    if (opts && opts->label) {
+        for (int i = 0; i < 16 && opts->label[i]; i++) {
+            sb->s_volume_name[i] = opts->label[i];
+        }
+    }
+
+    for (uint32_t g = 0; g < groups; g++) {
+        if (!ext2_group_has_super(g)) continue;
+        uint32_t start = first + g * bpg;
+        sb->s_block_group_nr = (uint16_t)g;
+        /* The primary sits 1024 bytes in, whatever the block size */
+        uint64_t sector = g == 0 ? EXT2_SUPER_OFFSET / BLOCK_SECTOR_SIZE : (uint64_t)start * mk.spb;
+        if (block_write(dev, sector, sb, sizeof(ext2_super_t) / BLOCK_SECTOR_SIZE) != 0) goto out;
+        if (put_blocks(&mk, start + 1, gdt, gdt_blocks) != 0) goto out;
+    }
+
+    status = block_flush(dev) == 0 ? 0 : -1;
+    if (result) {
+        result->block_size = bs;
+        result->blocks = total;
+        result->inodes = ipg * groups;
+        result->groups = groups;
+    }
+
+out:
+    if (scratch) pmm_free_pages(scratch, block_pages);
+    if (gdt_mem) pmm_free_pages(gdt_mem, gdt_pages);
+    if (zeros) pmm_free_pages(zeros, MKFS_ZERO_PAGES);
+    if (super_mem) pmm_free_pages(super_mem, 1);
+    return status;
+}
+
+/*
+ * ===========================================================================
+ * FAT32
+ * ===========================================================================
+ */
+
+int mkfs_vfat(block_device_t *dev, const mkfs_opts_t *opts, mkfs_result_t *result) {
+    if (!dev) return -1;
+
+    uint64_t sectors64 = dev->sectors;
+    uint32_t total = sectors64 > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)sectors64;
+
+    /* The largest cluster up to 4KB that still gives a proper FAT32 */
+    uint32_t cs = opts && opts->block_size ? opts->block_size : 4096;
+    if (!opts || !opts->block_size) {
+        while (cs > BLOCK_SECTOR_SIZE && total / (cs / BLOCK_SECTOR_SIZE) < MKFS_FAT_MIN_CLUSTERS) {
+            cs /= 2;
+        }
+    }
+    if (cs < BLOCK_SECTOR_SIZE || cs > 32768 || (cs & (cs - 1))) return -1;
+    uint32_t spc = cs / BLOCK_SECTOR_SIZE;
+
+    /* FAT size for the clusters that are left after the FATs themselves */
+    uint32_t fats = 2;
+    uint32_t fat_sectors = 1;
+    uint32_t clusters = 0;
+    for (;;) {
+        if (total <= MKFS_FAT_RESERVED + fats * fat_sectors) return -1;
+        clusters = (total - MKFS_FAT_RESERVED - fats * fat_sectors) / spc;
+        uint32_t need = ((clusters + FAT_FIRST_CLUSTER) * 4 + BLOCK_SECTOR_SIZE - 1) / BLOCK_SECTOR_SIZE;
+        if (need <= fat_sectors) break;
+        fat_sectors = need;
+    }
+    if (clusters < 16 || clusters > FAT_MAX_CLUSTERS) return -1;
+    uint32_t data_start = MKFS_FAT_RESERVED + fats * fat_sectors;
+
+    uint32_t zeros = pmm_alloc_pages(MKFS_ZERO_PAGES);
+    uint32_t boot_mem = pmm_alloc_pages(1);
+    int status = -1;
+    if (!zeros || !boot_mem) goto out;
+    mem_zero((void *)zeros, MKFS_ZERO_PAGES * PAGE_SIZE);
+    mem_zero((void *)boot_mem, PAGE_SIZE);
+
+    /* Reserved area, FATs and the root cluster start out zeroed */
+    uint32_t chunk = MKFS_ZERO_PAGES * PAGE_SIZE / BLOCK_SECTOR_SIZE;
+    for (uint32_t s = 0; s < data_start + spc; s += chunk) {
+        uint32_t n = data_start + spc - s < chunk ? data_start + spc - s : chunk;
+        if (block_write(dev, s, (void *)zeros, n) != 0) goto out;
+    }
+
+    /* First FAT sector: media, clean-shutdown marker, the root's chain */
+    uint32_t *fat = (uint32_t *)zeros;
+    fat[0] = 0x0FFFFFF8;
+    fat[1] = FAT_EOC_MARK;
+    fat[2] = FAT_EOC_MARK;
+    for (uint32_t copy = 0; copy < fats; copy++) {
+        if (block_write(dev, MKFS_FAT_RESERVED + copy * fat_sectors, fat, 1) != 0) goto out;
+    }
+    mem_zero(fat, BLOCK_SECTOR_SIZE);
+
+    fat_boot_t *bs = (fat_boot_t *)boot_mem;
+    bs->jmp[0] = 0xEB;
+    bs->jmp[1] = 0x58;
+    bs->jmp[2] = 0x90;
+    mem_copy(bs->oem, "CLAUDEOS", 8);
+    bs->bytes_per_sector = BLOCK_SECTOR_SIZE;
+    bs->sectors_per_cluster = (uint8_t)spc;
+    bs->reserved_sectors = MKFS_FAT_RESERVED;
+    bs->fats = (uint8_t)fats;
+    bs->media = 0xF8;
+    bs->sectors_per_track = 32;
+    bs->heads = 64;
+    bs->sectors32 = total;
+    bs->fat_size32 = fat_sectors;
+    bs->root_cluster = FAT_FIRST_CLUSTER;
+    bs->fsinfo_sector = 1;
+    bs->backup_boot_sector = 6;
+    bs->drive_number = 0x80;
+    bs->boot_signature = 0x29;
+    bs->volume_id = (uint32_t)timer_read_tsc();
+    mem_copy(bs->volume_label, "NO NAME    ", 11);
+    if (opts && opts->label) {
+        mem_copy(bs->volume_label, "           ", 11);
+        for (int i = 0; i < 11 && opts->label[i]; i++) {
+            char c = opts->label[i];
+            bs->volume_label[i] = (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+        }
+    }
+    mem_copy(bs->fs_type, "FAT32   ", 8);
+    bs->signature = FAT_SIGNATURE;
+
+    fat_fsinfo_t *fi = (fat_fsinfo_t *)(boot_mem + BLOCK_SECTOR_SIZE);
+    fi->lead_sig = FAT_FSINFO_LEAD;
+    fi->struct_sig = FAT_FSINFO_STRUCT;
+    fi->free_count = clusters - 1;
+    fi->next_free = FAT_FIRST_CLUSTER + 1;
+    fi->trail_sig = FAT_FSINFO_TRAIL;
+
+    /* Boot sector and FSInfo, then their backups */
+    if (block_write(dev, 0, bs, 2) != 0 || block_write(dev, 6, bs, 2) != 0) goto out;
+
+    /* A label also lives in the root directory */
+    if (opts && opts->label) {
+        fat_dirent_t *de = (fat_dirent_t *)zeros;
+        mem_copy(de->name, bs->volume_label, 11);
+        de->attr = FAT_ATTR_VOLUME_ID;
+        de->mdate = 0x0021;
+        int err = block_write(dev, data_start, de, 1);
+        mem_zero(de, sizeof(*de));
+        if (err != 0) goto out;
+    }
+
+    status = block_flush(dev) == 0 ? 0 : -1;
+    if (result) {
+        result->block_size = cs;
+        result->blocks = clusters;
+        result->inodes = 0;
+        result->groups = 0;
+    }
+
+out:
+    if (zeros) pmm_free_pages(zeros, MKFS_ZERO_PAGES);
+    if (boot_mem) pmm_free_pages(boot_mem, 1);
+    return status;
+}
+
+/*
+ * ===========================================================================
+ * Log-Structured
+ * ===========================================================================
+ */
+
+int mkfs_lfs(block_device_t *dev, const mkfs_opts_t *opts, mkfs_result_t *result) {
+    if (!dev) return -1;
+    if (opts && opts->block_size && opts->block_size != LFS_BLOCK_SIZE) return -1;
+
+    uint32_t spb = LFS_BLOCK_SIZE / BLOCK_SECTOR_SIZE;
+    uint64_t blocks64 = dev->sectors / spb;
+    uint32_t blocks = blocks64 > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)blocks64;
+
+    /* One inode per MKFS_BYTES_PER_INODE, in whole inode map blocks */
+    uint32_t per_inode = opts && opts->bytes_per_inode ? opts->bytes_per_inode
+                                                       : MKFS_BYTES_PER_INODE;
+    uint64_t inodes64 = (uint64_t)blocks * LFS_BLOCK_SIZE / per_inode;
+    if (inodes64 > 0x01000000) inodes64 = 0x01000000;
+    uint32_t imap_blocks = ((uint32_t)inodes64 + LFS_IMAP_PER_BLOCK - 1) / LFS_IMAP_PER_BLOCK;
+    if (imap_blocks == 0) imap_blocks = 1;
+    uint32_t inodes = imap_blocks * LFS_IMAP_PER_BLOCK;
+
+    /* A checkpoint holds the imap block addresses and every segment's usage */
+    uint32_t max_segs = blocks / MKFS_LFS_SEG_BLOCKS;
+    uint32_t cp_bytes = sizeof(lfs_checkpoint_t) + imap_blocks * 4 + max_segs * sizeof(lfs_usage_t);
+    uint32_t cp_blocks = (cp_bytes + LFS_BLOCK_SIZE - 1) / LFS_BLOCK_SIZE;
+    uint32_t seg_start = 1 + 2 * cp_blocks;
+    if (blocks <= seg_start) return -1;
+    uint32_t segs = (blocks - seg_start) / MKFS_LFS_SEG_BLOCKS;
+    if (segs < MKFS_LFS_MIN_SEGS) return -1;
+
+    /* Superblock, checkpoint region, and the first four blocks of the log */
+    uint32_t mem = pmm_alloc_pages(1 + cp_blocks + 4);
+    int status = -1;
+    if (!mem) return -1;
+    mem_zero((void *)mem, (1 + cp_blocks + 4) * PAGE_SIZE);
+    lfs_super_t *sb = (lfs_super_t *)mem;
+    uint8_t *cp_buf = (uint8_t *)(mem + PAGE_SIZE);
+    uint8_t *log = cp_buf + cp_blocks * LFS_BLOCK_SIZE;
+
+    sb->magic = LFS_MAGIC;
+    sb->version = LFS_VERSION;
+    sb->block_size = LFS_BLOCK_SIZE;
+    sb->blocks = seg_start + segs * MKFS_LFS_SEG_BLOCKS;
+    sb->seg_blocks = MKFS_LFS_SEG_BLOCKS;
+    sb->segs = segs;
+    sb->seg_start = seg_start;
+    sb->inodes = inodes;
+    sb->imap_blocks = imap_blocks;
+    sb->cp_blocks = cp_blocks;
+    sb->cp[0] = 1;
+    sb->cp[1] = 1 + cp_blocks;
+    if (opts && opts->label) {
+        for (int i = 0; i < 16 && opts->label[i]; i++) {
+            sb->label[i] = opts->label[i];
+        }
+    }
+
+    /* Partial segment 0: the root directory (empty, inline) and imap block 0 */
+    lfs_summary_t *sum = (lfs_summary_t *)log;
+    lfs_inode_t *root = (lfs_inode_t *)(log + LFS_BLOCK_SIZE);
+    lfs_imap_t *imap = (lfs_imap_t *)(log + 2 * LFS_BLOCK_SIZE);
+    root->ino = LFS_ROOT_INO;
+    root->type = LFS_TYPE_DIR;
+    root->nlink = 1;
+    root->gen = 1;
+    root->flags = LFS_INODE_INLINE;
+    imap[LFS_ROOT_INO].block = seg_start + 1;
+    imap[LFS_ROOT_INO].gen = 1;
+
+    sum->magic = LFS_SUMMARY_MAGIC;
+    sum->seq = 0;
+    sum->next = seg_start + 3;
+    sum->count = 2;
+    sum->entries[0].kind = LFS_SUM_INODES;
+    sum->entries[1].kind = LFS_SUM_IMAP;
+    sum->checksum = lfs_checksum(LFS_CHECKSUM_SEED, sum, 3 * LFS_BLOCK_SIZE);
+
+    /* The log goes on after it; the zeroed fourth block ends replay there */
+    lfs_checkpoint_t *cp = (lfs_checkpoint_t *)cp_buf;
+    cp->magic = LFS_CP_MAGIC;
+    cp->serial = 1;
+    cp->seq = 1;
+    cp->seg = 0;
+    cp->head = seg_start + 3;
+    cp->next_ino = LFS_ROOT_INO + 1;
+    cp->clean = 1;
+    uint32_t *imap_addr = (uint32_t *)(cp_buf + sizeof(lfs_checkpoint_t));
+    lfs_usage_t *usage = (lfs_usage_t *)(imap_addr + imap_blocks);
+    imap_addr[0] = seg_start + 2;
+    usage[0].live = LFS_INODE_SIZE + LFS_BLOCK_SIZE;
+    cp->checksum = lfs_checksum(LFS_CHECKSUM_SEED, cp_buf, cp_blocks * LFS_BLOCK_SIZE);
+
+    if (block_write(dev, (uint64_t)seg_start * spb, log, 4 * spb) != 0 ||
+        block_write(dev, (uint64_t)sb->cp[0] * spb, cp_buf, cp_blocks * spb) != 0) {
+        goto out;
+    }
+    mem_zero(cp_buf, cp_blocks * LFS_BLOCK_SIZE);
+    if (block_write(dev, (uint64_t)sb->cp[1] * spb, cp_buf, cp_blocks * spb) != 0 ||
+        block_write(dev, 0, sb, spb) != 0) {
+        goto out;
+    }
+
+    status = block_flush(dev) == 0 ? 0 : -1;
+    if (result) {
+        result->block_size = LFS_BLOCK_SIZE;
+        result->blocks = sb->blocks;
+        result->inodes = inodes;
+        result->groups = segs;
+    }
+
+out:
+    pmm_free_pages(mem, 1 + cp_blocks + 4);
+    return status;
+}
+
+int mkfs(const char *type, block_device_t *dev, const mkfs_opts_t *opts, mkfs_result_t *result) {
+    if (str_eq(type, "ext2")) return mkfs_ext2(dev, opts, result);
+    if (str_eq(type, "vfat")) return mkfs_vfat(dev, opts, result);
+    if (str_eq(type, "lfs")) return mkfs_lfs(dev, opts, result);
+    return -1;
+}
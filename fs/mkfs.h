@@ -0,0 +1,53 @@
+/*
+ * ClaudeOS mkfs - Header
+ * Worker1 - Shell+FS Claude
+ *
+ * Writes empty filesystems onto block devices, so a RAM disk or a
+ * scratch disk can be formatted and mounted without host tools.
+ */
+
+#ifndef CLAUDEOS_MKFS_H
+#define CLAUDEOS_MKFS_H
+
+#include "../include/types.h"
+#include "../include/block.h"
+
+typedef struct {
+    uint32_t block_size;        /* Block or cluster size, 0 picks one for the device */
+    uint32_t bytes_per_inode;   /* ext2: 0 for the default */
+    const char *label;          /* Volume label, or NULL */
+} mkfs_opts_t;
+
+/* What was written, for reporting (FAT: clusters as blocks, no inodes;
+ * lfs: segments as groups) */
+typedef struct {
+    uint32_t block_size;
+    uint32_t blocks;
+    uint32_t inodes;
+    uint32_t groups;
+} mkfs_result_t;
+
+/*
+ * Format 'dev' as an empty ext2 filesystem (root and lost+found).
+ * Memory-backed devices get 4KB blocks, so their pages can be shared
+ * with the page cache. Returns 0 or -1; 'result' may be NULL.
+ */
+int mkfs_ext2(block_device_t *dev, const mkfs_opts_t *opts, mkfs_result_t *result);
+
+/*
+ * Format 'dev' as an empty FAT32 volume. Clusters are the largest size
+ * up to 4KB that leaves the 65525 clusters FAT32 needs, or 512 bytes
+ * on devices too small for that.
+ */
+int mkfs_vfat(block_device_t *dev, const mkfs_opts_t *opts, mkfs_result_t *result);
+
+/*
+ * Format 'dev' as an empty log-structured filesystem (see lfs.h), with
+ * 4KB blocks and 256KB segments.
+ */
+int mkfs_lfs(block_device_t *dev, const mkfs_opts_t *opts, mkfs_result_t *result);
+
+/* Format by type name ("ext2", "vfat", "lfs"); returns -1 for an unknown type */
+int mkfs(const char *type, block_device_t *dev, const mkfs_opts_t *opts, mkfs_result_t *result);
+
+#endif /* CLAUDEOS_MKFS_H */
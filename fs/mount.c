@@ -0,0 +1,223 @@
+/*
+ * ClaudeOS Mount Table - Implementation
+ * Worker1 - Shell+FS Claude
+ *
+ * A small fixed table of mounts. It is only searched when a lookup
+ * reaches a node flagged as a mountpoint or mounted root, so ordinary
+ * path walks never pay for it.
+ */
+
+#include "mount.h"
+#include "dcache.h"
+#include "pagecache.h"
+#include "../include/idt.h"
+
+typedef struct {
+    superblock_t sb;
+    fs_node_t *mountpoint;      /* Covered directory (NULL for "/") */
+    int in_use;
+} mount_t;
+
+static mount_t mounts[MAX_MOUNTS];
+static fs_type_t *fs_types = NULL;
+
+extern void vfs_set_root(fs_node_t *root);
+
+static int str_eq(const char *a, const char *b) {
+    while (*a && *a == *b) { a++; b++; }
+    return *a == *b;
+}
+
+static void str_copy(char *dst, const char *src, int max) {
+    int i = 0;
+    while (src && src[i] && i < max - 1) {
+        dst[i] = src[i];
+        i++;
+    }
+    dst[i] = '\0';
+}
+
+/*
+ * ===========================================================================
+ * Filesystem Types
+ * ===========================================================================
+ */
+
+int vfs_register_fs(fs_type_t *type) {
+    if (!type || !type->name || !type->mount) return -1;
+
+    for (fs_type_t *t = fs_types; t; t = t->next) {
+        if (t == type || str_eq(t->name, type->name)) return -1;
+    }
+    type->next = fs_types;
+    fs_types = type;
+    return 0;
+}
+
+static fs_type_t *find_type(const char *name) {
+    for (fs_type_t *t = fs_types; t; t = t->next) {
+        if (str_eq(t->name, name)) return t;
+    }
+    return NULL;
+}
+
+/*
+ * ===========================================================================
+ * Crossing Mount Points
+ * ===========================================================================
+ */
+
+fs_node_t *mount_crossing(fs_node_t *mountpoint) {
+    for (int i = 0; i < MAX_MOUNTS; i++) {
+        if (mounts[i].in_use && mounts[i].mountpoint == mountpoint) {
+            return mounts[i].sb.root;
+        }
+    }
+    return mountpoint;
+}
+
+fs_node_t *mount_covered(fs_node_t *root) {
+    for (int i = 0; i < MAX_MOUNTS; i++) {
+        if (mounts[i].in_use && mounts[i].sb.root == root) {
+            return mounts[i].mountpoint;
+        }
+    }
+    return NULL;
+}
+
+superblock_t *mount_instance(fs_node_t *root) {
+    for (int i = 0; i < MAX_MOUNTS; i++) {
+        if (mounts[i].in_use && mounts[i].sb.root == root) {
+            return &mounts[i].sb;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * ===========================================================================
+ * Mount / Unmount
+ * ===========================================================================
+ */
+
+int vfs_mount(const char *type, const char *source, const char *target) {
+    fs_type_t *t = type ? find_type(type) : NULL;
+    if (!t || !target) return -1;
+
+    /* The first mount is the root filesystem */
+    fs_node_t *mountpoint = NULL;
+    fs_node_t *root = vfs_get_root();
+    if (root) {
+        mountpoint = vfs_lookup(target);
+        if (!mountpoint || mountpoint->type != FS_DIRECTORY || mountpoint == root) {
+            return -1;
+        }
+    } else if (!str_eq(target, "/")) {
+        return -1;
+    }
+
+    mount_t *m = NULL;
+    for (int i = 0; i < MAX_MOUNTS; i++) {
+        if (!mounts[i].in_use) {
+            m = &mounts[i];
+            break;
+        }
+    }
+    if (!m) return -1;
+
+    m->sb.type = t;
+    m->sb.root = NULL;
+    m->sb.priv = NULL;
+    m->sb.refs = 0;
+    str_copy(m->sb.source, source ? source : "none", MOUNT_SOURCE_MAX);
+    if (t->mount(&m->sb, m->sb.source) != 0 || !m->sb.root) {
+        return -1;
+    }
+
+    uint32_t irq = irq_save();
+    m->mountpoint = mountpoint;
+    m->in_use = 1;
+    m->sb.root->flags |= FS_MOUNTROOT;
+    if (mountpoint) {
+        mountpoint->flags |= FS_MOUNTPOINT;
+    }
+    irq_restore(irq);
+
+    /* Keeps the covered directory, and its instance, busy */
+    vfs_node_get(mountpoint);
+
+    if (!mountpoint) {
+        vfs_set_root(m->sb.root);
+    }
+    return 0;
+}
+
+int vfs_umount(const char *target) {
+    fs_node_t *root = target ? vfs_lookup(target) : NULL;
+    if (!root || !(root->flags & FS_MOUNTROOT)) return -1;
+
+    mount_t *m = NULL;
+    for (int i = 0; i < MAX_MOUNTS; i++) {
+        if (mounts[i].in_use && mounts[i].sb.root == root) {
+            m = &mounts[i];
+            break;
+        }
+    }
+
+    if (!m || !m->mountpoint) return -1;
+
+    /*
+     * Not while any node inside is referenced: open files (unlinked ones
+     * too), working directories, mappings and mounts stacked on top
+     */
+    uint32_t irq = irq_save();
+    if (m->sb.refs) {
+        irq_restore(irq);
+        return -1;
+    }
+    m->in_use = 0;
+    root->flags &= ~FS_MOUNTROOT;
+    m->mountpoint->flags &= ~FS_MOUNTPOINT;
+    irq_restore(irq);
+    vfs_node_put(m->mountpoint);
+
+    /* Cached names inside the instance must not outlive it */
+    dcache_flush();
+
+    if (m->sb.type->unmount) {
+        m->sb.type->unmount(&m->sb);
+    }
+    return 0;
+}
+
+int vfs_sync(void) {
+    int status = pcache_sync(NULL);
+
+    for (int i = 0; i < MAX_MOUNTS; i++) {
+        uint32_t irq = irq_save();
+        fs_node_t *root = mounts[i].in_use ? mounts[i].sb.root : NULL;
+        if (root) vfs_node_get(root);   /* Keeps it mounted while we sleep */
+        irq_restore(irq);
+        if (!root) continue;
+
+        if (root->ops && root->ops->fsync && root->ops->fsync(root) != 0) status = -1;
+        vfs_node_put(root);
+    }
+    return status;
+}
+
+int vfs_mount_info(int index, mount_info_t *info) {
+    if (index < 0 || !info) return -1;
+
+    for (int i = 0; i < MAX_MOUNTS; i++) {
+        if (!mounts[i].in_use || index-- > 0) continue;
+
+        if (vfs_get_path(mounts[i].sb.root, info->path, FS_PATH_MAX) < 0) {
+            str_copy(info->path, "?", FS_PATH_MAX);
+        }
+        info->type = mounts[i].sb.type->name;
+        str_copy(info->source, mounts[i].sb.source, MOUNT_SOURCE_MAX);
+        return 0;
+    }
+    return -1;
+}
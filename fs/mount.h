@@ -0,0 +1,81 @@
+/*
+ * ClaudeOS Mount Table - Header
+ * Worker1 - Shell+FS Claude
+ *
+ * Filesystem types register themselves by name. Mounting a type creates
+ * a new instance (a superblock with its own root node) and attaches it
+ * over a directory of the namespace; the root filesystem is the
+ * instance mounted at "/".
+ *
+ * Path lookup crosses mounts through two node flags: FS_MOUNTPOINT on a
+ * covered directory sends a walk into the mounted root, and FS_MOUNTROOT
+ * on that root sends ".." back out through the covered directory. Nodes
+ * without either flag never touch the mount table.
+ */
+
+#ifndef CLAUDEOS_MOUNT_H
+#define CLAUDEOS_MOUNT_H
+
+#include "vfs.h"
+
+#define MAX_MOUNTS          16
+#define MOUNT_SOURCE_MAX    32
+
+struct fs_type;
+
+/* One mounted filesystem instance */
+typedef struct superblock {
+    struct fs_type *type;
+    fs_node_t *root;            /* Set by the type's mount hook */
+    char source[MOUNT_SOURCE_MAX]; /* Device or label it was mounted from */
+    void *priv;                 /* Filesystem-specific state */
+    uint32_t refs;              /* Node references held inside (see vfs_node_get) */
+} superblock_t;
+
+/* A filesystem implementation */
+typedef struct fs_type {
+    const char *name;
+    /* Build an instance from 'source': set sb->root. Returns 0 or -1 */
+    int (*mount)(superblock_t *sb, const char *source);
+    /* Tear an instance down (optional) */
+    void (*unmount)(superblock_t *sb);
+    struct fs_type *next;
+} fs_type_t;
+
+/* One row of the mount table, for listing */
+typedef struct {
+    char path[FS_PATH_MAX];
+    const char *type;
+    char source[MOUNT_SOURCE_MAX];
+} mount_info_t;
+
+/* Make a filesystem type available to vfs_mount() */
+int vfs_register_fs(fs_type_t *type);
+
+/*
+ * Mount a new instance of 'type' over the directory 'target'. The first
+ * mount must be at "/" and becomes the root. Returns 0 or -1.
+ */
+int vfs_mount(const char *type, const char *source, const char *target);
+
+/* Detach the filesystem mounted at 'target' (fails while in use) */
+int vfs_umount(const char *target);
+
+/*
+ * Write back every dirty cached page and have each mounted filesystem
+ * make its buffered state durable. Returns 0, or -1 if anything failed.
+ */
+int vfs_sync(void);
+
+/* Describe mount number 'index'; returns -1 past the end */
+int vfs_mount_info(int index, mount_info_t *info);
+
+/* Lookup helpers: the root mounted on a mountpoint, and the directory a
+ * mounted root covers (NULL for the root filesystem) */
+fs_node_t *mount_crossing(fs_node_t *mountpoint);
+fs_node_t *mount_covered(fs_node_t *root);
+
+/* The instance a mounted root belongs to (NULL if 'root' is not one) */
+superblock_t *mount_instance(fs_node_t *root);
+
+#endif /* CLAUDEOS_MOUNT_H */
@@ -0,0 +1,147 @@
+/*
+ * ClaudeOS Interned Names - Implementation
+ * Worker1 - Shell+FS Claude
+ *
+ * A chained hash table of reference-counted strings. Each string is
+ * allocated from a slab cache for its size rounded up to 16 bytes, so
+ * a short name costs 16 or 32 bytes with its header instead of a
+ * 64-byte array per node.
+ */
+
+#include "names.h"
+#include "vfs.h"
+#include "../include/slab.h"
+#include "../include/idt.h"
+
+#define NAME_BUCKETS    (1 << NAME_HASH_BITS)
+#define NAME_ALIGN      16
+#define NAME_CLASSES    ((sizeof(fs_name_t) + FS_NAME_MAX + NAME_ALIGN - 1) / NAME_ALIGN)
+
+static fs_name_t *buckets[NAME_BUCKETS];
+static slab_t name_slabs[NAME_CLASSES];
+static name_stats_t stats;
+
+uint32_t name_hash(const char *name) {
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Hash and length of at most FS_NAME_MAX - 1 characters of 'name' */
+static uint32_t hash_prefix(const char *name, uint32_t *len) {
+    uint32_t h = 2166136261u;
+    uint32_t n = 0;
+    while (name[n] && n < FS_NAME_MAX - 1) {
+        h ^= (uint8_t)name[n++];
+        h *= 16777619u;
+    }
+    *len = n;
+    return h;
+}
+
+static int prefix_eq(const char *interned, const char *name, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        if (interned[i] != name[i]) return 0;
+    }
+    return interned[len] == '\0';
+}
+
+/* Cache for a name of 'len' characters */
+static slab_t *class_of(uint32_t len) {
+    uint32_t c = (uint32_t)(sizeof(fs_name_t) + len + 1 + NAME_ALIGN - 1) / NAME_ALIGN - 1;
+    slab_t *slab = &name_slabs[c];
+    if (!slab->size) {
+        slab->size = (c + 1) * NAME_ALIGN;
+    }
+    return slab;
+}
+
+static uint32_t str_len(const char *s) {
+    uint32_t len = 0;
+    while (s[len]) len++;
+    return len;
+}
+
+const char *name_intern(const char *name) {
+    if (!name) return NULL;
+
+    uint32_t len;
+    uint32_t hash = hash_prefix(name, &len);
+    fs_name_t **bucket = &buckets[hash & (NAME_BUCKETS - 1)];
+
+    uint32_t irq = irq_save();
+    for (fs_name_t *n = *bucket; n; n = n->next) {
+        if (n->hash == hash && prefix_eq(n->str, name, len)) {
+            n->refs++;
+            stats.refs++;
+            irq_restore(irq);
+            return n->str;
+        }
+    }
+    irq_restore(irq);
+
+    slab_t *slab = class_of(len);
+    fs_name_t *n = (fs_name_t *)slab_alloc(slab);
+    if (!n) return NULL;
+
+    n->hash = hash;
+    n->refs = 1;
+    for (uint32_t i = 0; i < len; i++) {
+        n->str[i] = name[i];
+    }
+    n->str[len] = '\0';
+
+    /* Another caller may have interned it while we allocated */
+    irq = irq_save();
+    for (fs_name_t *m = *bucket; m; m = m->next) {
+        if (m->hash == hash && prefix_eq(m->str, name, len)) {
+            m->refs++;
+            stats.refs++;
+            irq_restore(irq);
+            slab_free(slab, n);
+            return m->str;
+        }
+    }
+    n->next = *bucket;
+    *bucket = n;
+    stats.names++;
+    stats.refs++;
+    stats.bytes += slab->size;
+    irq_restore(irq);
+    return n->str;
+}
+
+void name_release(const char *name) {
+    if (!name) return;
+
+    fs_name_t *n = (fs_name_t *)(name - sizeof(fs_name_t));
+    uint32_t irq = irq_save();
+    stats.refs--;
+    if (--n->refs > 0) {
+        irq_restore(irq);
+        return;
+    }
+
+    fs_name_t **link = &buckets[n->hash & (NAME_BUCKETS - 1)];
+    while (*link != n) {
+        link = &(*link)->next;
+    }
+    *link = n->next;
+
+    slab_t *slab = class_of(str_len(n->str));
+    stats.names--;
+    stats.bytes -= slab->size;
+    irq_restore(irq);
+
+    slab_free(slab, n);
+}
+
+void name_get_stats(name_stats_t *out) {
+    if (!out) return;
+    uint32_t irq = irq_save();
+    *out = stats;
+    irq_restore(irq);
+}
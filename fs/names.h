@@ -0,0 +1,56 @@
+/*
+ * ClaudeOS Interned Names - Header
+ * Worker1 - Shell+FS Claude
+ *
+ * Directory entry names are stored once in a shared string table, with
+ * their hash computed when they are interned. A node's name points into
+ * the table, so it costs a pointer instead of a fixed array, the many
+ * files called "README" or ".profile" share one copy, and directory
+ * indexes never rehash a name they already hold.
+ *
+ * Names are reference counted; the last release returns the storage.
+ * Nodes that never sit in a directory (pipes, shm segments) may point
+ * at a string literal instead and must not release it.
+ */
+
+#ifndef CLAUDEOS_NAMES_H
+#define CLAUDEOS_NAMES_H
+
+#include "../include/types.h"
+
+#define NAME_HASH_BITS  10
+
+/* One interned string; 'str' is what nodes point at */
+typedef struct fs_name {
+    struct fs_name *next;       /* Hash chain */
+    uint32_t hash;              /* name_hash(str) */
+    uint32_t refs;
+    char str[];
+} fs_name_t;
+
+typedef struct {
+    uint32_t names;             /* Distinct names held */
+    uint32_t refs;              /* Total references to them */
+    uint32_t bytes;             /* Storage used, headers included */
+} name_stats_t;
+
+/* FNV-1a of a NUL-terminated string */
+uint32_t name_hash(const char *name);
+
+/*
+ * Take a reference on the interned copy of 'name' (truncated to
+ * FS_NAME_MAX - 1 characters). Returns NULL if out of memory.
+ */
+const char *name_intern(const char *name);
+
+/* Drop a reference taken by name_intern() */
+void name_release(const char *name);
+
+/* Precomputed hash of an interned name */
+static inline uint32_t name_interned_hash(const char *name) {
+    return ((const fs_name_t *)(name - sizeof(fs_name_t)))->hash;
+}
+
+void name_get_stats(name_stats_t *stats);
+
+#endif /* CLAUDEOS_NAMES_H */
@@ -0,0 +1,651 @@
+/*
+ * ClaudeOS Page Cache - Implementation
+ * Worker1 - Shell+FS Claude
+ *
+ * Each cached page has a descriptor in a fixed table, hashed on
+ * (node, page offset). A page under I/O is LOCKED: it cannot be
+ * reclaimed, and anyone else who wants it sleeps on io_wait until the
+ * I/O finishes.
+ *
+ * The clock hand sweeps the descriptor table. Recently used pages get
+ * a second chance, and pages mapped into a process (frame refcount
+ * above one) are never reclaimed. Clean pages go first. A dirty page is
+ * written back before it is reused.
+ *
+ * Read-ahead is per open file. While reads stay sequential, each new
+ * batch doubles the window, up to PCACHE_RA_MAX pages. A seek
+ * elsewhere turns read-ahead off until the reader is sequential again.
+ * There is no asynchronous I/O yet, so a batch is read synchronously;
+ * it still lets the filesystem issue larger, contiguous requests. A
+ * filesystem with readpages gets each run of missing pages in one call,
+ * and the pages of a large read() go out the same way.
+ *
+ * Writes only dirty the cached page. A flusher thread writes pages back
+ * once they have been dirty for PCACHE_DIRTY_EXPIRE_MS, or sooner, oldest
+ * first, while more than PCACHE_DIRTY_BG pages are dirty; a writer that
+ * finds PCACHE_DIRTY_MAX dirty pages writes some back itself. Each
+ * write-back takes the run of adjacent dirty pages around the page, so a
+ * filesystem with writepages can send it as one large request.
+ *
+ * On a memory-backed device the filesystem can lend the device's own
+ * frame (sharepage) instead of copying into a new one. Such a SHARED
+ * page holds one extra reference, owned by the device.
+ */
+
+#include "pagecache.h"
+#include "../include/pmm.h"
+#include "../include/process.h"
+#include "../include/idt.h"
+#include "../include/timer.h"
+
+#define PG_USED         0x01
+#define PG_UPTODATE     0x02
+#define PG_DIRTY        0x04
+#define PG_REFERENCED   0x08
+#define PG_LOCKED       0x10    /* Being read or written back */
+#define PG_SHARED       0x20    /* Frame lent by the device (sharepage) */
+#define PG_WMAPPED      0x40    /* Handed to a shared, writable mapping */
+
+#define PCACHE_BUCKETS  (1 << PCACHE_HASH_BITS)
+
+typedef struct cpage {
+    fs_node_t *node;
+    uint32_t pgoff;
+    uint32_t frame;
+    uint32_t flags;
+    uint32_t dirtied;           /* Uptime (ms) when it last became dirty */
+    struct cpage *next;         /* Hash chain / free list */
+} cpage_t;
+
+static cpage_t pages[PCACHE_MAX_PAGES];
+static cpage_t *buckets[PCACHE_BUCKETS];
+static cpage_t *free_descs = NULL;
+static uint32_t clock_hand = 0;
+static wait_queue_t io_wait;
+static wait_queue_t flush_wait;         /* The flusher sleeps here */
+static pcache_stats_t stats;
+
+static void mem_copy(void *dst, const void *src, uint32_t n) {
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    while (n--) *d++ = *s++;
+}
+
+static void mem_zero(void *dst, uint32_t n) {
+    char *d = (char *)dst;
+    while (n--) *d++ = 0;
+}
+
+static uint32_t bucket_of(fs_node_t *node, uint32_t pgoff) {
+    uint32_t h = ((uint32_t)node >> 4) ^ (pgoff * 2654435761u);
+    return (h * 2654435761u) >> (32 - PCACHE_HASH_BITS);
+}
+
+static cpage_t *find(fs_node_t *node, uint32_t pgoff) {
+    for (cpage_t *pg = buckets[bucket_of(node, pgoff)]; pg; pg = pg->next) {
+        if (pg->node == node && pg->pgoff == pgoff) {
+            return pg;
+        }
+    }
+    return NULL;
+}
+
+static void unhash(cpage_t *pg) {
+    cpage_t **link = &buckets[bucket_of(pg->node, pg->pgoff)];
+    while (*link && *link != pg) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = pg->next;
+    }
+}
+
+static int is_mapped(cpage_t *pg) {
+    return pmm_page_refcount(pg->frame) > ((pg->flags & PG_SHARED) ? 2 : 1);
+}
+
+static void set_dirty(cpage_t *pg) {
+    if (!(pg->flags & PG_DIRTY)) {
+        pg->flags |= PG_DIRTY;
+        pg->dirtied = (uint32_t)timer_get_uptime_ms();
+        stats.dirty++;
+    }
+}
+
+/* Return a descriptor that is not (or no longer) hashed */
+static void free_desc(cpage_t *pg) {
+    pmm_unref_page(pg->frame);
+    pg->flags = 0;
+    pg->node = NULL;
+    pg->next = free_descs;
+    free_descs = pg;
+    stats.pages--;
+}
+
+/* Remove a page from the cache and release our frame reference */
+static void drop(cpage_t *pg) {
+    unhash(pg);
+    if (pg->flags & PG_DIRTY) {
+        stats.dirty--;
+    }
+    free_desc(pg);
+}
+
+/* Can this page join a write-back? */
+static int writable(cpage_t *pg) {
+    return pg && (pg->flags & PG_DIRTY) && !(pg->flags & PG_LOCKED);
+}
+
+/*
+ * Write a dirty page back together with the dirty pages next to it, up
+ * to PCACHE_WB_MAX in all (interrupts disabled). The pages are locked
+ * for the duration, so they survive if the write sleeps. A page that is
+ * still mapped shared and writable stays dirty, since it can be written
+ * through the mapping at any time; it counts as newly dirtied.
+ */
+static int writeback(cpage_t *pg) {
+    fs_node_t *node = pg->node;
+    if (!node->ops || !node->ops->writepage) {
+        return -1;
+    }
+
+    uint32_t first = pg->pgoff;
+    while (first > 0 && pg->pgoff - first < PCACHE_WB_MAX - 1 && writable(find(node, first - 1))) {
+        first--;
+    }
+    cpage_t *batch[PCACHE_WB_MAX];
+    uint32_t frames[PCACHE_WB_MAX];
+    uint32_t count = 0;
+    while (count < PCACHE_WB_MAX) {
+        cpage_t *next = find(node, first + count);
+        if (!writable(next)) break;
+        next->flags = (next->flags | PG_LOCKED) & ~PG_DIRTY;
+        batch[count] = next;
+        frames[count++] = next->frame;
+    }
+    stats.dirty -= count;
+
+    int result = 0;
+    if (count > 1 && node->ops->writepages) {
+        result = node->ops->writepages(node, first, count, frames);
+    } else {
+        for (uint32_t i = 0; i < count; i++) {
+            if (node->ops->writepage(node, first + i, (const void *)frames[i]) != 0) result = -1;
+        }
+    }
+    stats.writebacks += count;
+    stats.clusters++;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!is_mapped(batch[i])) batch[i]->flags &= ~PG_WMAPPED;
+        if (result != 0 || (batch[i]->flags & PG_WMAPPED)) set_dirty(batch[i]);
+        batch[i]->flags &= ~PG_LOCKED;
+    }
+    wait_queue_wake_all(&io_wait);
+    return result;
+}
+
+/*
+ * Find a page to reclaim. Clean pages are taken on the first two
+ * sweeps. After that a dirty page is written back and taken.
+ */
+static int reclaim_one(void) {
+    for (uint32_t scanned = 0; scanned < 3 * PCACHE_MAX_PAGES; scanned++) {
+        cpage_t *pg = &pages[clock_hand];
+        clock_hand = (clock_hand + 1) % PCACHE_MAX_PAGES;
+
+        if (!(pg->flags & PG_USED) || (pg->flags & PG_LOCKED) || is_mapped(pg)) {
+            continue;
+        }
+        if (pg->flags & PG_REFERENCED) {
+            pg->flags &= ~PG_REFERENCED;
+            continue;
+        }
+        if (pg->flags & PG_DIRTY) {
+            if (scanned < 2 * PCACHE_MAX_PAGES || writeback(pg) != 0) {
+                continue;
+            }
+            if (pg->flags & (PG_DIRTY | PG_LOCKED)) {
+                continue;       /* Redirtied while we slept */
+            }
+        }
+
+        drop(pg);
+        stats.evictions++;
+        return 1;
+    }
+    return 0;
+}
+
+/* Get a descriptor and a frame for a new page, reclaiming if needed */
+static cpage_t *alloc_page(void) {
+    while (!free_descs || pmm_free_count() < PCACHE_MIN_FREE) {
+        if (!reclaim_one()) {
+            if (!free_descs) return NULL;
+            break;              /* Low on memory but nothing to give back */
+        }
+    }
+
+    uint32_t frame = pmm_alloc_page();
+    if (!frame) return NULL;
+
+    cpage_t *pg = free_descs;
+    free_descs = pg->next;
+    pg->frame = frame;
+    pg->flags = PG_USED;
+    pg->next = NULL;
+    stats.pages++;
+    return pg;
+}
+
+/*
+ * Find or load a page (interrupts disabled). With 'fill' the page is
+ * read from the filesystem; without it the caller is about to
+ * overwrite it entirely, so it starts zeroed. Returns NULL on I/O
+ * error or when memory runs out.
+ */
+static cpage_t *get_page(fs_node_t *node, uint32_t pgoff, int fill, int *was_cached) {
+    for (;;) {
+        cpage_t *pg = find(node, pgoff);
+        if (!pg) break;
+        if (pg->flags & PG_LOCKED) {
+            wait_queue_sleep(&io_wait);
+            continue;           /* It may have been dropped meanwhile */
+        }
+        pg->flags |= PG_REFERENCED;
+        if (was_cached) *was_cached = 1;
+        return pg;
+    }
+
+    cpage_t *pg = alloc_page();
+    if (!pg) return NULL;
+
+    /* Reclaim may have slept: someone else could have loaded it */
+    if (find(node, pgoff)) {
+        free_desc(pg);
+        return get_page(node, pgoff, fill, was_cached);
+    }
+
+    pg->node = node;
+    pg->pgoff = pgoff;
+    pg->flags |= PG_LOCKED | PG_REFERENCED;
+    uint32_t b = bucket_of(node, pgoff);
+    pg->next = buckets[b];
+    buckets[b] = pg;
+
+    int result = 0;
+    uint32_t lent;
+    if (fill && (pgoff << PAGE_SHIFT) < node->size && node->ops->sharepage &&
+        node->ops->sharepage(node, pgoff, &lent) == 0) {
+        /* Zero-copy: the device's frame becomes the cached page */
+        pmm_unref_page(pg->frame);
+        pg->frame = lent;
+        pg->flags |= PG_SHARED;
+    } else if (fill && (pgoff << PAGE_SHIFT) < node->size) {
+        result = node->ops->readpage(node, pgoff, (void *)pg->frame);
+    } else {
+        pmm_zero_page(pg->frame);
+    }
+
+    if (result != 0) {
+        drop(pg);               /* Waiters will retry the read */
+        wait_queue_wake_all(&io_wait);
+        return NULL;
+    }
+
+    pg->flags = (pg->flags & ~PG_LOCKED) | PG_UPTODATE;
+    wait_queue_wake_all(&io_wait);
+    if (was_cached) *was_cached = 0;
+    return pg;
+}
+
+/*
+ * Load the uncached run of pages starting at 'first' (and before 'end')
+ * with one readpages call, so the filesystem can read it as a single
+ * request. Returns how many pages were loaded.
+ */
+static uint32_t read_batch(fs_node_t *node, uint32_t first, uint32_t end) {
+    cpage_t *batch[PCACHE_RA_MAX];
+    uint32_t frames[PCACHE_RA_MAX];
+    uint32_t count = 0;
+
+    while (first + count < end && count < PCACHE_RA_MAX && !find(node, first + count)) {
+        if (!free_descs || pmm_free_count() < PCACHE_MIN_FREE) break;
+        cpage_t *pg = alloc_page();
+        if (!pg) break;
+        if (find(node, first + count)) {
+            free_desc(pg);      /* Loaded by someone else while we reclaimed */
+            break;
+        }
+
+        pg->node = node;
+        pg->pgoff = first + count;
+        pg->flags |= PG_LOCKED | PG_REFERENCED;
+        uint32_t b = bucket_of(node, pg->pgoff);
+        pg->next = buckets[b];
+        buckets[b] = pg;
+        batch[count] = pg;
+        frames[count] = pg->frame;
+        count++;
+    }
+    if (count == 0) return 0;
+
+    int result = node->ops->readpages(node, first, count, frames);
+    for (uint32_t i = 0; i < count; i++) {
+        if (result != 0) {
+            drop(batch[i]);
+        } else {
+            batch[i]->flags = (batch[i]->flags & ~PG_LOCKED) | PG_UPTODATE;
+        }
+    }
+    wait_queue_wake_all(&io_wait);
+    return result == 0 ? count : 0;
+}
+
+/*
+ * Load pages [first, end) that are not cached yet. Those before 'ahead'
+ * belong to the read itself and are not counted as read-ahead.
+ */
+static void read_ahead(fs_node_t *node, uint32_t first, uint32_t end, uint32_t ahead) {
+    if (!node->size) return;
+    uint32_t last_page = (node->size - 1) >> PAGE_SHIFT;
+    if (end > last_page + 1) end = last_page + 1;
+
+    for (uint32_t p = first; p < end; p++) {
+        if (find(node, p)) continue;
+        if (!free_descs || pmm_free_count() < PCACHE_MIN_FREE) break;
+
+        if (node->ops->readpages) {
+            uint32_t n = read_batch(node, p, end);
+            if (n == 0) break;
+            if (p + n > ahead) stats.readahead += p + n - (p > ahead ? p : ahead);
+            p += n - 1;
+            continue;
+        }
+
+        int cached;
+        if (!get_page(node, p, 1, &cached)) break;
+        if (!cached && p >= ahead) stats.readahead++;
+    }
+}
+
+/*
+ * Decide how far to read ahead of a read of pages [first, last]. Returns
+ * the end of the range to have cached, or 0 for none. A new batch is
+ * started once the reader is within half a window of the last one.
+ */
+static uint32_t ra_update(pcache_ra_t *ra, uint32_t first, uint32_t last) {
+    int sequential = first == ra->next_pgoff || first + 1 == ra->next_pgoff;
+    ra->next_pgoff = last + 1;
+
+    if (!sequential) {
+        ra->window = 0;
+        ra->ra_end = 0;
+        return 0;
+    }
+    if (ra->window && last + ra->window / 2 < ra->ra_end) {
+        return 0;               /* Still well inside the last batch */
+    }
+
+    ra->window = ra->window ? ra->window * 2 : PCACHE_RA_MIN;
+    if (ra->window > PCACHE_RA_MAX) ra->window = PCACHE_RA_MAX;
+    ra->ra_end = last + 1 + ra->window;
+    return ra->ra_end;
+}
+
+/*
+ * ===========================================================================
+ * Flusher
+ * ===========================================================================
+ */
+
+static int32_t flusher_pid = -1;
+
+/* The page that has been dirty longest, of those not under I/O */
+static cpage_t *oldest_dirty(void) {
+    cpage_t *oldest = NULL;
+    for (int i = 0; i < PCACHE_MAX_PAGES; i++) {
+        cpage_t *pg = &pages[i];
+        if (writable(pg) && (!oldest || (int32_t)(pg->dirtied - oldest->dirtied) < 0)) {
+            oldest = pg;
+        }
+    }
+    return oldest;
+}
+
+/*
+ * Write back the oldest dirty pages until no more than 'target' are
+ * dirty and, with 'expired', none has been dirty for longer than
+ * PCACHE_DIRTY_EXPIRE_MS (interrupts disabled). At most as many pages
+ * as were dirty at the start are written, so pages kept dirty by a
+ * mapping or an error wait for the next call.
+ */
+static void flush_dirty(uint32_t target, bool expired) {
+    uint32_t now = (uint32_t)timer_get_uptime_ms();
+    uint32_t limit = stats.writebacks + stats.dirty;
+    while ((int32_t)(limit - stats.writebacks) > 0) {
+        cpage_t *pg = oldest_dirty();
+        if (!pg) return;
+        bool old = expired && now - pg->dirtied >= PCACHE_DIRTY_EXPIRE_MS;
+        if (stats.dirty <= target && !old) return;
+        writeback(pg);
+    }
+}
+
+/*
+ * Wake every PCACHE_FLUSH_MS, or when writers pass PCACHE_DIRTY_BG, and
+ * write back expired pages. Past the threshold, keep going down to half
+ * of it so writers are not woken against it on every call.
+ */
+static void flusher(void) {
+    for (;;) {
+        uint32_t irq = irq_save();
+        wait_queue_sleep_timeout(&flush_wait, PCACHE_FLUSH_MS);
+        flush_dirty(stats.dirty > PCACHE_DIRTY_BG ? PCACHE_DIRTY_BG / 2 : PCACHE_MAX_PAGES, true);
+        irq_restore(irq);
+    }
+}
+
+/*
+ * ===========================================================================
+ * Public Interface
+ * ===========================================================================
+ */
+
+void pcache_init(void) {
+    free_descs = NULL;
+    for (int i = PCACHE_MAX_PAGES - 1; i >= 0; i--) {
+        pages[i].flags = 0;
+        pages[i].node = NULL;
+        pages[i].next = free_descs;
+        free_descs = &pages[i];
+    }
+    for (int i = 0; i < PCACHE_BUCKETS; i++) {
+        buckets[i] = NULL;
+    }
+    clock_hand = 0;
+    wait_queue_init(&io_wait);
+    wait_queue_init(&flush_wait);
+    mem_zero(&stats, sizeof(stats));
+}
+
+void pcache_start_flusher(void) {
+    if (flusher_pid < 0) {
+        flusher_pid = process_create("flushd", flusher, PRIORITY_NORMAL);
+    }
+}
+
+int pcache_backed(fs_node_t *node) {
+    return node && node->type == FS_FILE && node->ops && node->ops->readpage;
+}
+
+ssize_t pcache_read(fs_node_t *node, void *buf, size_t size, size_t offset, pcache_ra_t *ra) {
+    if (!pcache_backed(node)) return -1;
+    if (offset >= node->size) return 0;
+    if (size > node->size - offset) size = node->size - offset;
+    if (size == 0) return 0;
+
+    uint32_t first = (uint32_t)offset >> PAGE_SHIFT;
+    uint32_t last = (uint32_t)(offset + size - 1) >> PAGE_SHIFT;
+
+    uint32_t irq = irq_save();
+
+    uint32_t ra_end = ra ? ra_update(ra, first, last) : 0;
+
+    char *dst = (char *)buf;
+    size_t done = 0;
+    for (uint32_t p = first; p <= last; p++) {
+        int cached;
+        cpage_t *pg = get_page(node, p, 1, &cached);
+        if (!pg) break;
+        if (cached) stats.hits++;
+        else stats.misses++;
+
+        uint32_t in_page = (uint32_t)(offset + done) & (PAGE_SIZE - 1);
+        uint32_t chunk = PAGE_SIZE - in_page;
+        if (chunk > size - done) chunk = size - done;
+        mem_copy(dst + done, (char *)pg->frame + in_page, chunk);
+        done += chunk;
+
+        /*
+         * Start the read-ahead as soon as the first page is in. With
+         * readpages the rest of the read goes out in the same batches.
+         */
+        if (p == first && node->ops->readpages && last > first) {
+            read_ahead(node, first + 1, ra_end > last + 1 ? ra_end : last + 1, last + 1);
+        } else if (p == first && ra_end) {
+            read_ahead(node, last + 1, ra_end, last + 1);
+        }
+    }
+
+    irq_restore(irq);
+    return done > 0 ? (ssize_t)done : -1;
+}
+
+ssize_t pcache_write(fs_node_t *node, const void *buf, size_t size, size_t offset) {
+    if (!pcache_backed(node) || !node->ops->writepage) return -1;
+    if (size > 0xFFFFFFFF - offset) size = 0xFFFFFFFF - offset;
+
+    uint32_t irq = irq_save();
+
+    const char *src = (const char *)buf;
+    size_t done = 0;
+    while (done < size) {
+        uint32_t pos = (uint32_t)(offset + done);
+        uint32_t in_page = pos & (PAGE_SIZE - 1);
+        uint32_t chunk = PAGE_SIZE - in_page;
+        if (chunk > size - done) chunk = size - done;
+
+        /* Whole-page overwrites and pages past EOF need no read */
+        int fill = chunk != PAGE_SIZE && (pos & PAGE_MASK) < node->size;
+        cpage_t *pg = get_page(node, pos >> PAGE_SHIFT, fill, NULL);
+        if (!pg) break;
+
+        mem_copy((char *)pg->frame + in_page, src + done, chunk);
+        set_dirty(pg);
+        done += chunk;
+
+        if (pos + chunk > node->size) {
+            node->size = pos + chunk;
+        }
+    }
+
+    /* Write-back is the flusher's job, until the hard limit is passed */
+    if (stats.dirty > PCACHE_DIRTY_BG) {
+        wait_queue_wake_all(&flush_wait);
+    }
+    if (stats.dirty > PCACHE_DIRTY_MAX) {
+        stats.throttled++;
+        flush_dirty(PCACHE_DIRTY_MAX, false);
+    }
+
+    irq_restore(irq);
+    return done > 0 || size == 0 ? (ssize_t)done : -1;
+}
+
+int pcache_map_page(fs_node_t *node, uint32_t pgoff, uint32_t *frame, int write) {
+    if (!pcache_backed(node) || !frame) return -1;
+    if ((pgoff << PAGE_SHIFT) >= node->size) return -1;
+
+    uint32_t irq = irq_save();
+    cpage_t *pg = get_page(node, pgoff, 1, NULL);
+    if (!pg) {
+        irq_restore(irq);
+        return -1;
+    }
+
+    /* A shared, writable mapping can write the frame behind our back */
+    if (write && node->ops->writepage) {
+        pg->flags |= PG_WMAPPED;
+        set_dirty(pg);
+    }
+
+    pmm_ref_page(pg->frame);
+    *frame = pg->frame;
+    irq_restore(irq);
+    return 0;
+}
+
+int pcache_sync(fs_node_t *node) {
+    int result = 0;
+    uint32_t irq = irq_save();
+    for (int i = 0; i < PCACHE_MAX_PAGES; i++) {
+        cpage_t *pg = &pages[i];
+        if (!(pg->flags & PG_USED) || (node && pg->node != node)) continue;
+
+        /* A write-back the flusher started must be done before we are */
+        while (pg->flags & PG_LOCKED) {
+            wait_queue_sleep(&io_wait);
+        }
+        if (writable(pg) && (!node || pg->node == node) && writeback(pg) != 0) {
+            result = -1;
+        }
+    }
+    irq_restore(irq);
+    return result;
+}
+
+void pcache_truncate(fs_node_t *node, uint32_t size) {
+    if (!node) return;
+
+    uint32_t keep = (uint32_t)PAGE_ALIGN(size) >> PAGE_SHIFT;
+    uint32_t in_page = size & (PAGE_SIZE - 1);
+
+    uint32_t irq = irq_save();
+    for (int i = 0; i < PCACHE_MAX_PAGES; i++) {
+        cpage_t *pg = &pages[i];
+        if (!(pg->flags & PG_USED) || pg->node != node) continue;
+        while (pg->flags & PG_LOCKED) {
+            wait_queue_sleep(&io_wait);
+        }
+        if (pg->node != node) continue;
+
+        if (pg->pgoff >= keep) {
+            drop(pg);
+        } else if (in_page && pg->pgoff == keep - 1) {
+            mem_zero((char *)pg->frame + in_page, PAGE_SIZE - in_page);
+        }
+    }
+    irq_restore(irq);
+}
+
+void pcache_invalidate(fs_node_t *node) {
+    pcache_truncate(node, 0);
+}
+
+uint32_t pcache_shrink(uint32_t count) {
+    uint32_t freed = 0;
+    uint32_t irq = irq_save();
+    while (freed < count && reclaim_one()) {
+        freed++;
+    }
+    irq_restore(irq);
+    return freed;
+}
+
+void pcache_get_stats(pcache_stats_t *out) {
+    if (!out) return;
+    uint32_t irq = irq_save();
+    *out = stats;
+    irq_restore(irq);
+}
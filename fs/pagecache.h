@@ -0,0 +1,89 @@
+/*
+ * ClaudeOS Page Cache - Header
+ * Worker1 - Shell+FS Claude
+ *
+ * Caches file pages of filesystems that implement the readpage and
+ * writepage hooks, indexed by (node, page offset). vfs_read(),
+ * vfs_write() and mmap all go through it for such files, so a page is
+ * read from the backing store once and shared by every user.
+ *
+ * Clean pages are reclaimed with a clock sweep when the cache is full
+ * or free frames run low. Writes are write-back: a flusher thread
+ * writes dirty pages out by age and by how many are dirty, in runs of
+ * adjacent pages, and a synced file is written out at once. Data is
+ * lost in a crash for at most PCACHE_DIRTY_EXPIRE_MS + PCACHE_FLUSH_MS,
+ * plus whatever the filesystem itself buffers.
+ */
+
+#ifndef CLAUDEOS_PAGECACHE_H
+#define CLAUDEOS_PAGECACHE_H
+
+#include "vfs.h"
+
+#define PCACHE_MAX_PAGES    1024    /* Cache size limit (4MB) */
+#define PCACHE_MIN_FREE     128     /* Reclaim when fewer free frames remain */
+#define PCACHE_HASH_BITS    8
+#define PCACHE_RA_MIN       4       /* First read-ahead window (pages) */
+#define PCACHE_RA_MAX       32      /* Largest read-ahead window */
+#define PCACHE_WB_MAX       32      /* Most pages written back at once */
+
+/* Write-back thresholds */
+#define PCACHE_FLUSH_MS         1000                        /* Flusher period */
+#define PCACHE_DIRTY_EXPIRE_MS  5000                        /* Oldest a dirty page gets */
+#define PCACHE_DIRTY_BG         (PCACHE_MAX_PAGES / 10)     /* 10%: flusher starts early */
+#define PCACHE_DIRTY_MAX        (PCACHE_MAX_PAGES * 4 / 10) /* 40%: writers write back */
+
+/* Per-open-file read-ahead state (kept in the fd table) */
+typedef struct {
+    uint32_t next_pgoff;        /* Page a sequential reader asks for next */
+    uint32_t window;            /* Current read-ahead size, 0 = off */
+    uint32_t ra_end;            /* First page past the last batch */
+} pcache_ra_t;
+
+typedef struct {
+    uint32_t pages;             /* Pages currently cached */
+    uint32_t dirty;             /* Of which dirty */
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t readahead;         /* Pages read ahead of demand */
+    uint32_t writebacks;        /* Pages written back */
+    uint32_t clusters;          /* Write-backs they took */
+    uint32_t throttled;         /* Writes that had to write back */
+    uint32_t evictions;
+} pcache_stats_t;
+
+/* Initialize an empty cache */
+void pcache_init(void);
+
+/* Start the flusher thread (once the scheduler is up) */
+void pcache_start_flusher(void);
+
+/* Does this node's filesystem use the cache? */
+int pcache_backed(fs_node_t *node);
+
+/* Read and write through the cache (ra may be NULL) */
+ssize_t pcache_read(fs_node_t *node, void *buf, size_t size, size_t offset, pcache_ra_t *ra);
+ssize_t pcache_write(fs_node_t *node, const void *buf, size_t size, size_t offset);
+
+/*
+ * Hand out the cached frame for mmap, with a reference for the caller.
+ * 'write' is set for MAP_SHARED with PROT_WRITE: the page then stays
+ * dirty for as long as it is mapped.
+ */
+int pcache_map_page(fs_node_t *node, uint32_t pgoff, uint32_t *frame, int write);
+
+/* Write back a file's dirty pages (or every file's, for NULL) */
+int pcache_sync(fs_node_t *node);
+
+/* Drop cached pages past a new end of file */
+void pcache_truncate(fs_node_t *node, uint32_t size);
+
+/* Drop every cached page of a file without writing it back */
+void pcache_invalidate(fs_node_t *node);
+
+/* Reclaim up to 'pages' clean pages; returns how many were freed */
+uint32_t pcache_shrink(uint32_t pages);
+
+void pcache_get_stats(pcache_stats_t *stats);
+
+#endif /* CLAUDEOS_PAGECACHE_H */
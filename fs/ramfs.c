@@ -7,139 +7,684 @@
  */
 
 #include "vfs.h"
+#include "dcache.h"
+#include "mount.h"
+#include "names.h"
+#include "../include/pmm.h"
+#include "../include/slab.h"
+#include "../include/idt.h"
 
 /* Simple string functions */
-static void str_copy(char *dst, const char *src, int max) {
-    int i = 0;
-    while (src[i] && i < max - 1) {
-        dst[i] = src[i];
-        i++;
-    }
-    dst[i] = '\0';
-}
-
 static int str_len(const char *s) {
     int len = 0;
     while (s[len]) len++;
     return len;
 }
 
+static int str_eq(const char *a, const char *b) {
+    while (*a && *a == *b) { a++; b++; }
+    return *a == *b;
+}
+
 /*
  * ===========================================================================
- * Static Allocation (no malloc yet)
+ * Node Allocation
  * ===========================================================================
  */
 
-/* Pre-allocated nodes and children arrays */
-static fs_node_t nodes[FS_MAX_FILES];
-static fs_node_t *children_arrays[FS_MAX_FILES][FS_MAX_CHILDREN];
-static int node_count = 0;
-
-/* Pre-allocated file content buffers */
-#define FILE_BUF_SIZE 1024
-#define MAX_FILE_BUFS 16
-static char file_buffers[MAX_FILE_BUFS][FILE_BUF_SIZE];
-static int file_buf_count = 0;
+/*
+ * Nodes and directory headers are carved out of whole page frames, so
+ * the number of files is bounded only by memory.
+ */
+static slab_t node_slab = SLAB_INIT(fs_node_t);
 
 static uint32_t next_inode = 1;
 
+/* A zeroed node holding a reference on its interned name */
+static fs_node_t *alloc_node(const char *name) {
+    fs_node_t *node = (fs_node_t *)slab_alloc(&node_slab);
+    if (!node) return NULL;
+
+    node->name = name_intern(name);
+    if (!node->name) {
+        slab_free(&node_slab, node);
+        return NULL;
+    }
+    return node;
+}
+
+static void free_node(fs_node_t *node) {
+    name_release(node->name);
+    slab_free(&node_slab, node);
+}
+
 /*
  * ===========================================================================
- * Node Creation
+ * Directories
  * ===========================================================================
  */
 
-static fs_node_t *alloc_node(void) {
-    if (node_count >= FS_MAX_FILES) {
-        return NULL;
+/*
+ * A directory keeps its children in a dense array in creation order
+ * (node->children, which readdir indexes) and, once it outgrows the
+ * small inline array, an open-addressed hash index over that array.
+ * Index slots hold (position + 1), 0 meaning empty, and the index is
+ * kept at most half full. Both arrays live in page frames and double
+ * when full.
+ */
+#define DIR_INLINE      8       /* Children before the hash index is built */
+
+typedef struct {
+    fs_node_t *inline_children[DIR_INLINE];
+    uint32_t capacity;          /* Slots in node->children */
+    uint32_t *index;            /* Hash index, NULL while inline */
+    uint32_t index_mask;        /* Index slots - 1 */
+} ramfs_dir_t;
+
+static slab_t dir_slab = SLAB_INIT(ramfs_dir_t);
+
+static uint32_t pages_for(uint32_t bytes) {
+    return PAGE_ALIGN(bytes) >> PAGE_SHIFT;
+}
+
+static void index_insert(ramfs_dir_t *dir, fs_node_t *child, uint32_t pos) {
+    uint32_t i = name_interned_hash(child->name) & dir->index_mask;
+    while (dir->index[i]) {
+        i = (i + 1) & dir->index_mask;
+    }
+    dir->index[i] = pos + 1;
+}
+
+/* Double the child array and rebuild the index at twice its size */
+static int dir_grow(fs_node_t *node, ramfs_dir_t *dir) {
+    uint32_t capacity = dir->capacity * 2;
+    uint32_t slots = capacity * 2;
+
+    fs_node_t **children = (fs_node_t **)pmm_alloc_pages(pages_for(capacity * sizeof(fs_node_t *)));
+    if (!children) return -1;
+    uint32_t *index = (uint32_t *)pmm_alloc_pages(pages_for(slots * sizeof(uint32_t)));
+    if (!index) {
+        pmm_free_pages((uint32_t)children, pages_for(capacity * sizeof(fs_node_t *)));
+        return -1;
     }
-    fs_node_t *node = &nodes[node_count];
 
-    /* Clear the node */
-    for (int i = 0; i < (int)sizeof(fs_node_t); i++) {
-        ((char *)node)[i] = 0;
+    for (int i = 0; i < node->child_count; i++) {
+        children[i] = node->children[i];
+    }
+    for (uint32_t i = 0; i < slots; i++) {
+        index[i] = 0;
     }
 
-    /* Set up children array pointer */
-    node->children = children_arrays[node_count];
-    for (int i = 0; i < FS_MAX_CHILDREN; i++) {
-        node->children[i] = NULL;
+    if (dir->index) {
+        pmm_free_pages((uint32_t)node->children, pages_for(dir->capacity * sizeof(fs_node_t *)));
+        pmm_free_pages((uint32_t)dir->index, pages_for((dir->index_mask + 1) * sizeof(uint32_t)));
     }
 
-    node_count++;
-    return node;
+    node->children = children;
+    dir->capacity = capacity;
+    dir->index = index;
+    dir->index_mask = slots - 1;
+
+    for (int i = 0; i < node->child_count; i++) {
+        index_insert(dir, children[i], (uint32_t)i);
+    }
+    return 0;
+}
+
+/* Set up an empty directory */
+static int dir_init(fs_node_t *node) {
+    ramfs_dir_t *dir = (ramfs_dir_t *)slab_alloc(&dir_slab);
+    if (!dir) return -1;
+
+    dir->capacity = DIR_INLINE;
+    node->data = dir;
+    node->children = dir->inline_children;
+    node->child_count = 0;
+    return 0;
+}
+
+/* Add a child, replacing any cached "not found" for its name */
+static int dir_add(fs_node_t *parent, fs_node_t *child) {
+    ramfs_dir_t *dir = (ramfs_dir_t *)parent->data;
+    if (!dir) return -1;
+
+    if ((uint32_t)parent->child_count == dir->capacity && dir_grow(parent, dir) != 0) {
+        return -1;
+    }
+
+    uint32_t pos = (uint32_t)parent->child_count++;
+    parent->children[pos] = child;
+    if (dir->index) {
+        index_insert(dir, child, pos);
+    }
+
+    dcache_invalidate(parent, child->name);
+    return 0;
+}
+
+/* Index slot holding position 'pos' (child is the node stored there) */
+static uint32_t index_find(ramfs_dir_t *dir, fs_node_t *child, uint32_t pos) {
+    uint32_t i = name_interned_hash(child->name) & dir->index_mask;
+    while (dir->index[i] != pos + 1) {
+        i = (i + 1) & dir->index_mask;
+    }
+    return i;
+}
+
+/*
+ * Empty index slot i. Later entries of the probe run move back into
+ * the hole unless their home slot lies after it, so every remaining
+ * entry stays reachable from its home without tombstones.
+ */
+static void index_delete(fs_node_t *node, ramfs_dir_t *dir, uint32_t i) {
+    uint32_t j = i;
+    for (;;) {
+        j = (j + 1) & dir->index_mask;
+        if (!dir->index[j]) break;
+
+        uint32_t home = name_interned_hash(node->children[dir->index[j] - 1]->name) & dir->index_mask;
+        int stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            dir->index[i] = dir->index[j];
+            i = j;
+        }
+    }
+    dir->index[i] = 0;
+}
+
+/*
+ * Remove a child. The last child moves into its position, so removal
+ * is O(1) but reorders readdir.
+ */
+static void dir_remove(fs_node_t *parent, fs_node_t *child) {
+    ramfs_dir_t *dir = (ramfs_dir_t *)parent->data;
+
+    uint32_t pos = 0;
+    while (parent->children[pos] != child) pos++;
+    uint32_t last = (uint32_t)parent->child_count - 1;
+
+    if (dir->index) {
+        index_delete(parent, dir, index_find(dir, child, pos));
+        if (pos != last) {
+            dir->index[index_find(dir, parent->children[last], last)] = pos + 1;
+        }
+    }
+    parent->children[pos] = parent->children[last];
+    parent->children[last] = NULL;
+    parent->child_count--;
+
+    dcache_invalidate(parent, child->name);
 }
 
-static char *alloc_file_buffer(void) {
-    if (file_buf_count >= MAX_FILE_BUFS) {
+/* Free a directory's arrays */
+static void dir_free(fs_node_t *node) {
+    ramfs_dir_t *dir = (ramfs_dir_t *)node->data;
+    if (!dir) return;
+    if (dir->index) {
+        pmm_free_pages((uint32_t)node->children, pages_for(dir->capacity * sizeof(fs_node_t *)));
+        pmm_free_pages((uint32_t)dir->index, pages_for((dir->index_mask + 1) * sizeof(uint32_t)));
+    }
+    slab_free(&dir_slab, dir);
+    node->data = NULL;
+    node->children = NULL;
+}
+
+static fs_node_t *ramfs_finddir(fs_node_t *node, const char *name) {
+    ramfs_dir_t *dir = (ramfs_dir_t *)node->data;
+    if (!dir) return NULL;
+
+    /* Stored names carry their hash, so most mismatches skip the compare */
+    uint32_t hash = name_hash(name);
+    if (!dir->index) {
+        for (int i = 0; i < node->child_count; i++) {
+            fs_node_t *child = node->children[i];
+            if (name_interned_hash(child->name) == hash && str_eq(child->name, name)) {
+                return child;
+            }
+        }
         return NULL;
     }
-    char *buf = file_buffers[file_buf_count++];
-    /* Clear buffer */
-    for (int i = 0; i < FILE_BUF_SIZE; i++) {
-        buf[i] = 0;
+
+    uint32_t i = hash & dir->index_mask;
+    while (dir->index[i]) {
+        fs_node_t *child = node->children[dir->index[i] - 1];
+        if (name_interned_hash(child->name) == hash && str_eq(child->name, name)) {
+            return child;
+        }
+        i = (i + 1) & dir->index_mask;
+    }
+    return NULL;
+}
+
+static fs_node_t *ramfs_readdir(fs_node_t *node, int index) {
+    if (index < 0 || index >= node->child_count) return NULL;
+    return node->children[index];
+}
+
+static fs_ops_t ramfs_dir_ops;
+
+/*
+ * ===========================================================================
+ * Files
+ * ===========================================================================
+ */
+
+/*
+ * Files of up to FS_INLINE_MAX bytes keep their data inside the node
+ * (FS_INLINE). Growing past that moves it out to page frames indexed by
+ * a radix tree, and truncating to zero brings the file back inline.
+ *
+ * A tree of height 0 is a single data page; each extra level is a page
+ * of 1024 slots, so height 1 covers 4MB and height 2 the full 32-bit
+ * range. Missing pages are holes and read as zeros. Writing allocates
+ * only the pages it touches and never moves existing data.
+ */
+#define RADIX_SHIFT     10
+#define RADIX_SLOTS     (1 << RADIX_SHIFT)
+#define RADIX_MAX_HEIGHT 2
+
+typedef struct {
+    uint32_t root;              /* Data page or top table (0 = empty) */
+    uint32_t height;            /* Table levels above the data pages */
+} ramfs_file_t;
+
+static slab_t file_slab = SLAB_INIT(ramfs_file_t);
+
+static uint32_t zeroed_page(void) {
+    uint32_t page = pmm_alloc_page();
+    if (page) pmm_zero_page(page);
+    return page;
+}
+
+/* Highest page index a tree of this height can hold */
+static uint32_t radix_max_index(uint32_t height) {
+    return height >= RADIX_MAX_HEIGHT ? 0xFFFFFFFF >> PAGE_SHIFT
+                                      : (1u << (RADIX_SHIFT * height)) - 1;
+}
+
+/*
+ * Find the slot holding file page 'pgoff'. With 'create', missing
+ * tables are allocated and the tree grows taller as needed; otherwise
+ * NULL means the page is a hole.
+ */
+static uint32_t *radix_slot(ramfs_file_t *f, uint32_t pgoff, int create) {
+    while (pgoff > radix_max_index(f->height)) {
+        if (!create) return NULL;
+        if (f->root) {
+            uint32_t table = zeroed_page();
+            if (!table) return NULL;
+            ((uint32_t *)table)[0] = f->root;
+            f->root = table;
+        }
+        f->height++;
+    }
+
+    uint32_t *slot = &f->root;
+    for (uint32_t level = f->height; level > 0; level--) {
+        if (!*slot) {
+            if (!create) return NULL;
+            *slot = zeroed_page();
+            if (!*slot) return NULL;
+        }
+        uint32_t idx = (pgoff >> (RADIX_SHIFT * (level - 1))) & (RADIX_SLOTS - 1);
+        slot = &((uint32_t *)*slot)[idx];
     }
-    return buf;
+    return slot;
+}
+
+/* Free a subtree; data pages are unreferenced (mappings keep theirs) */
+static void radix_free(uint32_t page, uint32_t level) {
+    if (!page) return;
+    if (level > 0) {
+        uint32_t *table = (uint32_t *)page;
+        for (uint32_t i = 0; i < RADIX_SLOTS; i++) {
+            radix_free(table[i], level - 1);
+        }
+    }
+    pmm_unref_page(page);
+}
+
+static void *mem_copy(void *dst, const void *src, uint32_t n) {
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    while (n--) *d++ = *s++;
+    return dst;
+}
+
+static void mem_zero(void *dst, uint32_t n) {
+    char *d = (char *)dst;
+    while (n--) *d++ = 0;
+}
+
+/* Move inline data out to a page tree so the file can grow */
+static int file_spill(fs_node_t *node) {
+    ramfs_file_t *f = (ramfs_file_t *)slab_alloc(&file_slab);
+    if (!f) return -1;
+
+    if (node->size > 0) {
+        f->root = zeroed_page();
+        if (!f->root) {
+            slab_free(&file_slab, f);
+            return -1;
+        }
+        mem_copy((void *)f->root, node->inline_data, node->size);
+    }
+
+    node->data = f;
+    node->flags &= ~FS_INLINE;
+    return 0;
+}
+
+static ssize_t ramfs_read(fs_node_t *node, void *buf, size_t size, size_t offset) {
+    if (offset >= node->size) return 0;
+    if (size > node->size - offset) size = node->size - offset;
+
+    if (node->flags & FS_INLINE) {
+        mem_copy(buf, node->inline_data + offset, size);
+        return (ssize_t)size;
+    }
+
+    ramfs_file_t *f = (ramfs_file_t *)node->data;
+    if (!f) return 0;
+
+    char *dst = (char *)buf;
+    size_t done = 0;
+    while (done < size) {
+        uint32_t pos = offset + done;
+        uint32_t in_page = pos & (PAGE_SIZE - 1);
+        uint32_t chunk = PAGE_SIZE - in_page;
+        if (chunk > size - done) chunk = size - done;
+
+        uint32_t *slot = radix_slot(f, pos >> PAGE_SHIFT, 0);
+        if (slot && *slot) {
+            mem_copy(dst + done, (char *)*slot + in_page, chunk);
+        } else {
+            mem_zero(dst + done, chunk);
+        }
+        done += chunk;
+    }
+    return (ssize_t)done;
+}
+
+static ssize_t ramfs_write(fs_node_t *node, const void *buf, size_t size, size_t offset) {
+    if (offset > 0xFFFFFFFF) return -1;
+    if (size > 0xFFFFFFFF - offset) size = 0xFFFFFFFF - offset;
+
+    if (node->flags & FS_INLINE) {
+        if (offset <= FS_INLINE_MAX && size <= FS_INLINE_MAX - offset) {
+            mem_copy(node->inline_data + offset, buf, size);
+            if (offset + size > node->size) {
+                node->size = offset + size;
+            }
+            return (ssize_t)size;
+        }
+        if (file_spill(node) != 0) return -1;
+    }
+
+    ramfs_file_t *f = (ramfs_file_t *)node->data;
+    if (!f) return -1;
+
+    const char *src = (const char *)buf;
+    size_t done = 0;
+    while (done < size) {
+        uint32_t pos = offset + done;
+        uint32_t in_page = pos & (PAGE_SIZE - 1);
+        uint32_t chunk = PAGE_SIZE - in_page;
+        if (chunk > size - done) chunk = size - done;
+
+        uint32_t *slot = radix_slot(f, pos >> PAGE_SHIFT, 1);
+        if (slot && !*slot) {
+            *slot = zeroed_page();
+        }
+        if (!slot || !*slot) break;     /* Out of memory: short write */
+
+        mem_copy((char *)*slot + in_page, src + done, chunk);
+        done += chunk;
+    }
+
+    if (done > 0 && offset + done > node->size) {
+        node->size = offset + done;
+    }
+    return done > 0 || size == 0 ? (ssize_t)done : -1;
+}
+
+/*
+ * Set the file size. Shrinking frees whole pages past the new end and
+ * zeroes the tail of the last partial page, so growing again later
+ * reads zeros there. Growing just extends the size with a hole.
+ */
+static int ramfs_truncate(fs_node_t *node, uint32_t size) {
+    if (node->flags & FS_INLINE) {
+        if (size <= FS_INLINE_MAX) {
+            if (size < node->size) {
+                mem_zero(node->inline_data + size, node->size - size);
+            }
+            node->size = size;
+            return 0;
+        }
+        if (file_spill(node) != 0) return -1;
+    }
+
+    ramfs_file_t *f = (ramfs_file_t *)node->data;
+    if (!f) return -1;
+
+    if (size == 0) {
+        /* Empty again: drop the tree and go back inline */
+        radix_free(f->root, f->height);
+        slab_free(&file_slab, f);
+        node->data = NULL;
+        mem_zero(node->inline_data, FS_INLINE_MAX);
+        node->flags |= FS_INLINE;
+    } else if (size < node->size) {
+        uint32_t first = (uint32_t)PAGE_ALIGN(size) >> PAGE_SHIFT;
+        uint32_t last = (node->size - 1) >> PAGE_SHIFT;
+        for (uint32_t pg = first; pg <= last; pg++) {
+            uint32_t *slot = radix_slot(f, pg, 0);
+            if (slot && *slot) {
+                pmm_unref_page(*slot);
+                *slot = 0;
+            }
+        }
+
+        uint32_t in_page = size & (PAGE_SIZE - 1);
+        uint32_t *slot = in_page ? radix_slot(f, size >> PAGE_SHIFT, 0) : NULL;
+        if (slot && *slot) {
+            mem_zero((char *)*slot + in_page, PAGE_SIZE - in_page);
+        }
+    }
+
+    node->size = size;
+    return 0;
+}
+
+/*
+ * Hand out the frame behind a file page, with a reference for the
+ * mapping. Reads, writes and every mapping share that one frame; a
+ * hole gets a fresh zero page first.
+ */
+static int ramfs_mmap(fs_node_t *node, uint32_t pgoff, uint32_t *frame) {
+    if (node->type != FS_FILE) return -1;
+    if ((pgoff << PAGE_SHIFT) >= node->size) return -1;
+
+    /* A mapping needs a real frame */
+    if ((node->flags & FS_INLINE) && file_spill(node) != 0) return -1;
+
+    ramfs_file_t *f = (ramfs_file_t *)node->data;
+    if (!f) return -1;
+
+    uint32_t *slot = radix_slot(f, pgoff, 1);
+    if (slot && !*slot) {
+        *slot = zeroed_page();
+    }
+    if (!slot || !*slot) return -1;
+
+    pmm_ref_page(*slot);
+    *frame = *slot;
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Removing and Renaming
+ * ===========================================================================
+ */
+
+/*
+ * Unlinked nodes leave their directory at once but are only freed by
+ * ramfs_release(), which the VFS calls when the last open file, working
+ * directory or mapping lets go of them.
+ */
+static void ramfs_release(fs_node_t *node) {
+    if (node->type == FS_DIRECTORY) {
+        dir_free(node);
+    } else if (node->type == FS_FILE) {
+        ramfs_truncate(node, 0);
+    }
+    free_node(node);
+}
+
+static int removable(fs_node_t *child) {
+    /* Device nodes belong to their driver and are never freed here */
+    if (child->type != FS_FILE && child->type != FS_DIRECTORY) return 0;
+    return child->type != FS_DIRECTORY || child->child_count == 0;
+}
+
+static void detach(fs_node_t *dir, fs_node_t *child) {
+    dir_remove(dir, child);
+    child->parent = NULL;
+    child->flags |= FS_UNLINKED;
+}
+
+static int ramfs_unlink(fs_node_t *dir, fs_node_t *child) {
+    if (!removable(child)) return -1;
+
+    uint32_t irq = irq_save();
+    detach(dir, child);
+    irq_restore(irq);
+    return 0;
+}
+
+/* Atomic: other processes see the old name or the new one, never neither */
+static int ramfs_rename(fs_node_t *olddir, fs_node_t *child, fs_node_t *newdir,
+                        const char *newname) {
+    ramfs_dir_t *dir = (ramfs_dir_t *)newdir->data;
+    if (!dir) return -1;
+
+    const char *name = name_intern(newname);
+    if (!name) return -1;
+
+    uint32_t irq = irq_save();
+
+    fs_node_t *target = ramfs_finddir(newdir, newname);
+    int ok = target != child;
+    if (ok && target && (!removable(target) ||
+                         (target->type == FS_DIRECTORY) != (child->type == FS_DIRECTORY))) {
+        ok = 0;
+    }
+
+    /* Make room first so nothing below can fail */
+    if (ok && !target && olddir != newdir && (uint32_t)newdir->child_count == dir->capacity &&
+        dir_grow(newdir, dir) != 0) {
+        ok = 0;
+    }
+
+    if (!ok) {
+        irq_restore(irq);
+        name_release(name);
+        return target == child ? 0 : -1;
+    }
+
+    if (target) {
+        detach(newdir, target);
+    }
+    dir_remove(olddir, child);
+    const char *old = child->name;
+    child->name = name;
+    child->parent = newdir;
+    dir_add(newdir, child);
+
+    irq_restore(irq);
+    name_release(old);
+    return 0;
+}
+
+static fs_ops_t ramfs_dir_ops = {
+    .readdir = ramfs_readdir,
+    .finddir = ramfs_finddir,
+    .unlink  = ramfs_unlink,
+    .rename  = ramfs_rename,
+    .release = ramfs_release,
+};
+
+static fs_ops_t ramfs_file_ops = {
+    .read     = ramfs_read,
+    .write    = ramfs_write,
+    .mmap     = ramfs_mmap,
+    .truncate = ramfs_truncate,
+    .release  = ramfs_release,
+};
+
+/* Link a new node under its parent; on failure the node is freed */
+static fs_node_t *link_child(fs_node_t *parent, fs_node_t *node) {
+    if (parent && dir_add(parent, node) != 0) {
+        ramfs_release(node);
+        return NULL;
+    }
+    return node;
 }
 
 /* Create a directory node */
 fs_node_t *vfs_create_dir(fs_node_t *parent, const char *name) {
-    fs_node_t *node = alloc_node();
+    fs_node_t *node = alloc_node(name);
     if (!node) return NULL;
 
-    str_copy(node->name, name, FS_NAME_MAX);
     node->type = FS_DIRECTORY;
     node->inode = next_inode++;
     node->parent = parent;
-    node->child_count = 0;
     node->size = 0;
-    node->data = NULL;
-    node->ops = NULL;
-
-    /* Add to parent's children */
-    if (parent && parent->child_count < FS_MAX_CHILDREN) {
-        parent->children[parent->child_count++] = node;
+    node->ops = &ramfs_dir_ops;
+    if (dir_init(node) != 0) {
+        free_node(node);
+        return NULL;
     }
 
-    return node;
+    return link_child(parent, node);
 }
 
 /* Create a file node with content */
 fs_node_t *vfs_create_file(fs_node_t *parent, const char *name, const char *content) {
-    fs_node_t *node = alloc_node();
+    fs_node_t *node = alloc_node(name);
     if (!node) return NULL;
 
-    str_copy(node->name, name, FS_NAME_MAX);
     node->type = FS_FILE;
+    node->flags = FS_INLINE;
     node->inode = next_inode++;
     node->parent = parent;
-    node->child_count = 0;
-    node->ops = NULL;
-
-    /* Copy content to buffer */
-    if (content) {
-        char *buf = alloc_file_buffer();
-        if (buf) {
-            int len = str_len(content);
-            if (len >= FILE_BUF_SIZE) len = FILE_BUF_SIZE - 1;
-            for (int i = 0; i < len; i++) {
-                buf[i] = content[i];
-            }
-            buf[len] = '\0';
-            node->data = buf;
-            node->size = len;
-        }
-    } else {
-        node->data = NULL;
-        node->size = 0;
-    }
+    node->ops = &ramfs_file_ops;
 
-    /* Add to parent's children */
-    if (parent && parent->child_count < FS_MAX_CHILDREN) {
-        parent->children[parent->child_count++] = node;
+    if (content && ramfs_write(node, content, (size_t)str_len(content), 0) < 0) {
+        ramfs_truncate(node, 0);
+        free_node(node);
+        return NULL;
     }
 
-    return node;
+    return link_child(parent, node);
+}
+
+/* Create a device node driven entirely by 'ops' */
+fs_node_t *vfs_create_device(fs_node_t *parent, const char *name, fs_ops_t *ops,
+                             uint32_t major, uint32_t minor) {
+    fs_node_t *node = alloc_node(name);
+    if (!node) return NULL;
+
+    node->type = FS_CHARDEV;
+    node->inode = next_inode++;
+    node->parent = parent;
+    node->ops = ops;
+    node->major = major;
+    node->minor = minor;
+
+    return link_child(parent, node);
 }
 
 /*
@@ -148,26 +693,33 @@ fs_node_t *vfs_create_file(fs_node_t *parent, const char *name, const char *cont
  * ===========================================================================
  */
 
-/* External function to set root */
-extern void vfs_set_root(fs_node_t *root);
-
-void ramfs_init(void) {
-    /* Create root directory */
-    fs_node_t *root = alloc_node();
-    str_copy(root->name, "/", FS_NAME_MAX);
-    root->type = FS_DIRECTORY;
-    root->inode = next_inode++;
+/* Each mount is an independent tree with its own root directory */
+static int ramfs_mount(superblock_t *sb, const char *source) {
+    (void)source;
+    fs_node_t *root = vfs_create_dir(NULL, "/");
+    if (!root) return -1;
     root->parent = root;  /* Root is its own parent */
-    root->child_count = 0;
+    sb->root = root;
+    return 0;
+}
 
-    vfs_set_root(root);
+static fs_type_t ramfs_type = {
+    .name  = "ramfs",
+    .mount = ramfs_mount,
+};
+
+void ramfs_init(void) {
+    /* Register, then mount an instance as the root filesystem */
+    vfs_register_fs(&ramfs_type);
+    if (vfs_mount("ramfs", "rootfs", "/") != 0) return;
+    fs_node_t *root = vfs_get_root();
 
     /*
      * Create initial directory structure:
      *
      * /
      * ├── bin/
-     * ├── dev/
+     * ├── dev/          (devfs is mounted here)
      * ├── etc/
      * │   ├── motd
      * │   └── hostname
@@ -175,15 +727,20 @@ void ramfs_init(void) {
      * │   └── claude/
      * │       ├── .profile
      * │       └── welcome.txt
-     * └── tmp/
+     * ├── mnt/
+     * ├── tmp/
+     * └── usr/
      */
 
     /* /bin - for future external programs */
     vfs_create_dir(root, "bin");
 
-    /* /dev - device files (future) */
+    /* /dev - mountpoint for device files */
     vfs_create_dir(root, "dev");
 
+    /* /mnt - for mounting further filesystems */
+    vfs_create_dir(root, "mnt");
+
     /* /etc - configuration files */
     fs_node_t *etc = vfs_create_dir(root, "etc");
     vfs_create_file(etc, "motd",
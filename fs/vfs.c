@@ -4,6 +4,14 @@
  */
 
 #include "vfs.h"
+#include "dcache.h"
+#include "pagecache.h"
+#include "mount.h"
+#include "../include/process.h"
+#include "../include/pmm.h"
+#include "../include/slab.h"
+#include "../include/idt.h"
+#include "../include/poll.h"
 
 /* Simple string functions (no libc in kernel) */
 static int str_len(const char *s) {
@@ -32,38 +40,316 @@ static void str_ncpy(char *dst, const char *src, int n) {
 
 /*
  * ===========================================================================
- * File Descriptor Table
+ * File Descriptor Tables
  * ===========================================================================
  */
 
-#define MAX_OPEN_FILES 16
-
-typedef struct {
+/*
+ * An open file description: what open() creates. It holds the offset
+ * and flags, and is shared by every descriptor dup()ed from it and by
+ * children that inherit it, so they all move the same offset.
+ */
+typedef struct file {
     fs_node_t *node;
     int flags;
     size_t offset;
-    int in_use;
-} file_desc_t;
+    uint32_t refs;              /* Descriptors referring to this */
+    pcache_ra_t ra;             /* Read-ahead state (page-cached files) */
+} file_t;
+
+/*
+ * Each process owns a table mapping descriptor numbers to descriptions.
+ * The first FD_INLINE slots live in the table itself; opening past them
+ * moves the slots to a page frame holding FD_MAX of them.
+ *
+ * A bit per slot in 'used' marks it taken, and a bit per word in 'full'
+ * marks a used[] word with no zero bit left, so the lowest free fd is
+ * two count-trailing-zeros away. Slots 0-2 are always reserved: an
+ * empty standard stream slot means the console.
+ */
+#define FD_INLINE   32
+#define FD_MAX      (PAGE_SIZE / sizeof(file_t *))
+#define FD_WORDS    (FD_MAX / 32)
+
+typedef struct fd_table {
+    file_t **fds;               /* inline_fds, or a page once grown */
+    uint32_t capacity;
+    uint32_t used[FD_WORDS];
+    uint32_t full;
+    file_t *inline_fds[FD_INLINE];
+} fd_table_t;
+
+static slab_t file_slab = SLAB_INIT(file_t);
+static slab_t fd_table_slab = SLAB_INIT(fd_table_t);
+
+/* Used outside any process (boot, idle) */
+static fd_table_t kernel_files;
+
+/* Free an unlinked node if nothing references it any more */
+static void node_reap(fs_node_t *node) {
+    uint32_t irq = irq_save();
+    int dead = node->refcount == 0 && (node->flags & FS_UNLINKED);
+    irq_restore(irq);
+    if (!dead) return;
+
+    dcache_invalidate_node(node);
+    if (pcache_backed(node)) {
+        pcache_invalidate(node);
+    }
+    if (node->ops && node->ops->release) {
+        node->ops->release(node);
+    }
+}
+
+/* Root directory of the filesystem instance holding 'node' */
+static fs_node_t *instance_root(fs_node_t *node) {
+    while (node->parent && node->parent != node) {
+        node = node->parent;
+    }
+    return node;
+}
+
+void vfs_node_get(fs_node_t *node) {
+    if (!node) return;
+
+    uint32_t irq = irq_save();
+    /* Still reachable from its root, since nobody could have unlinked it */
+    if (!node->sb) {
+        node->sb = mount_instance(instance_root(node));
+    }
+    node->refcount++;
+    if (node->sb) {
+        node->sb->refs++;
+    }
+    irq_restore(irq);
+}
+
+void vfs_node_put(fs_node_t *node) {
+    if (!node) return;
 
-static file_desc_t fd_table[MAX_OPEN_FILES];
+    uint32_t irq = irq_save();
+    node->refcount--;
+    superblock_t *sb = node->sb;
+    irq_restore(irq);
+
+    /* The instance stays busy until the release hook is done with it */
+    node_reap(node);
+    if (sb) {
+        irq = irq_save();
+        sb->refs--;
+        irq_restore(irq);
+    }
+}
 
-static int fd_alloc(void) {
-    /* Skip 0, 1, 2 for stdin/stdout/stderr */
-    for (int i = 3; i < MAX_OPEN_FILES; i++) {
-        if (!fd_table[i].in_use) {
-            fd_table[i].in_use = 1;
-            return i;
+void vfs_tree_free(fs_node_t *root, void (*free_node)(fs_node_t *node)) {
+    if (root->type == FS_DIRECTORY) {
+        while (root->child_count > 0) {
+            vfs_tree_free(root->children[--root->child_count], free_node);
         }
+    } else if (pcache_backed(root)) {
+        pcache_sync(root);
+        pcache_invalidate(root);
+    }
+    free_node(root);
+}
+
+static void node_ref(fs_node_t *node, int flags) {
+    if (!node) return;
+
+    vfs_node_get(node);
+    if (node->ops && node->ops->open) {
+        node->ops->open(node, flags);
+    }
+}
+
+static void node_unref(fs_node_t *node) {
+    if (!node) return;
+
+    if (node->ops && node->ops->close) {
+        node->ops->close(node);
+    }
+    vfs_node_put(node);
+}
+
+static file_t *file_new(fs_node_t *node, int flags) {
+    file_t *file = (file_t *)slab_alloc(&file_slab);
+    if (!file) return NULL;
+    file->node = node;
+    file->flags = flags;
+    file->refs = 1;
+    node_ref(node, flags);
+    return file;
+}
+
+static void file_put(file_t *file) {
+    uint32_t irq = irq_save();
+    int last = --file->refs == 0;
+    irq_restore(irq);
+
+    if (last) {
+        epoll_file_closed(file);
+        node_unref(file->node);
+        slab_free(&file_slab, file);
+    }
+}
+
+static void table_init(fd_table_t *t) {
+    t->fds = t->inline_fds;
+    t->capacity = FD_INLINE;
+    for (uint32_t i = 0; i < FD_WORDS; i++) {
+        t->used[i] = 0;
+    }
+    t->full = 0;
+    for (uint32_t i = 0; i < FD_INLINE; i++) {
+        t->inline_fds[i] = NULL;
+    }
+    t->used[0] = 0x7;           /* stdin, stdout, stderr */
+}
+
+static fd_table_t *current_table(void) {
+    process_t *proc = process_current();
+    return proc && proc->files ? proc->files : &kernel_files;
+}
+
+static fd_table_t *proc_table(process_t *proc) {
+    return proc && proc->files ? proc->files : &kernel_files;
+}
+
+/* Move the slots out to a page frame (interrupts disabled) */
+static int table_grow(fd_table_t *t) {
+    if (t->capacity == FD_MAX) return -1;
+
+    uint32_t page = pmm_alloc_page();
+    if (!page) return -1;
+    pmm_zero_page(page);
+
+    file_t **fds = (file_t **)page;
+    for (uint32_t i = 0; i < t->capacity; i++) {
+        fds[i] = t->fds[i];
+    }
+    t->fds = fds;
+    t->capacity = FD_MAX;
+    return 0;
+}
+
+static void fd_mark(fd_table_t *t, uint32_t fd) {
+    uint32_t w = fd / 32;
+    t->used[w] |= 1u << (fd % 32);
+    if (t->used[w] == 0xFFFFFFFF) {
+        t->full |= 1u << w;
+    }
+}
+
+static void fd_unmark(fd_table_t *t, uint32_t fd) {
+    if (fd <= 2) return;        /* Standard stream slots stay reserved */
+    t->used[fd / 32] &= ~(1u << (fd % 32));
+    t->full &= ~(1u << (fd / 32));
+}
+
+/* Put a description in slot fd, growing the table (interrupts disabled) */
+static int fd_install(fd_table_t *t, uint32_t fd, file_t *file) {
+    if (fd >= FD_MAX) return -1;
+    if (fd >= t->capacity && table_grow(t) != 0) return -1;
+    t->fds[fd] = file;
+    fd_mark(t, fd);
+    return 0;
+}
+
+/* Install in the lowest free slot; returns the fd or -1 */
+static int fd_alloc(fd_table_t *t, file_t *file) {
+    uint32_t irq = irq_save();
+    if (t->full == 0xFFFFFFFF) {
+        irq_restore(irq);
+        return -1;
+    }
+    uint32_t w = __builtin_ctz(~t->full);
+    uint32_t fd = w * 32 + __builtin_ctz(~t->used[w]);
+    int ret = fd_install(t, fd, file) == 0 ? (int)fd : -1;
+    irq_restore(irq);
+    return ret;
+}
+
+/* Take a description out of its slot (the caller drops the reference) */
+static file_t *fd_detach(fd_table_t *t, int fd) {
+    if (fd < 0 || (uint32_t)fd >= t->capacity) return NULL;
+
+    uint32_t irq = irq_save();
+    file_t *file = t->fds[fd];
+    if (file) {
+        t->fds[fd] = NULL;
+        fd_unmark(t, fd);
     }
-    return -1;
+    irq_restore(irq);
+    return file;
+}
+
+static file_t *fd_file(int fd) {
+    fd_table_t *t = current_table();
+    if (fd < 0 || (uint32_t)fd >= t->capacity) return NULL;
+    return t->fds[fd];
 }
 
-static void fd_free(int fd) {
-    if (fd >= 0 && fd < MAX_OPEN_FILES) {
-        fd_table[fd].in_use = 0;
-        fd_table[fd].node = NULL;
-        fd_table[fd].offset = 0;
+int vfs_files_create(process_t *proc, process_t *parent, int share_all) {
+    fd_table_t *t = (fd_table_t *)slab_alloc(&fd_table_slab);
+    if (!t) return -1;
+    table_init(t);
+
+    fd_table_t *from = proc_table(parent);
+    uint32_t irq = irq_save();
+    uint32_t limit = share_all ? from->capacity : 3;
+    for (uint32_t fd = 0; fd < limit; fd++) {
+        file_t *file = from->fds[fd];
+        if (file && fd_install(t, fd, file) == 0) {
+            file->refs++;
+        }
     }
+    irq_restore(irq);
+
+    proc->files = t;
+    return 0;
+}
+
+void vfs_files_release(process_t *proc) {
+    fd_table_t *t = proc->files;
+    if (!t) return;
+
+    for (uint32_t fd = 0; fd < t->capacity; fd++) {
+        file_t *file = fd_detach(t, fd);
+        if (file) {
+            file_put(file);
+        }
+    }
+
+    uint32_t irq = irq_save();
+    proc->files = NULL;
+    irq_restore(irq);
+
+    if (t->fds != t->inline_fds) {
+        pmm_unref_page((uint32_t)t->fds);
+    }
+    slab_free(&fd_table_slab, t);
+}
+
+int vfs_dup_into(process_t *proc, int oldfd, int newfd) {
+    file_t *file = fd_file(oldfd);
+    if (!file || newfd < 0 || (uint32_t)newfd >= FD_MAX) return -1;
+
+    fd_table_t *t = proc_table(proc);
+    if (t == current_table() && oldfd == newfd) return newfd;
+
+    file_t *old = fd_detach(t, newfd);
+
+    uint32_t irq = irq_save();
+    int ret = fd_install(t, newfd, file);
+    if (ret == 0) {
+        file->refs++;
+    }
+    irq_restore(irq);
+
+    if (old) {
+        file_put(old);
+    }
+    return ret == 0 ? newfd : -1;
 }
 
 /*
@@ -108,16 +394,71 @@ static const char *path_next_component(const char *path, char *component, int ma
     return path;
 }
 
-/* Lookup a node by path */
+/* Scan a directory for a child by name (dcache miss path) */
+static fs_node_t *dir_find_child(fs_node_t *dir, const char *name) {
+    if (dir->ops && dir->ops->finddir) {
+        return dir->ops->finddir(dir, name);
+    }
+
+    /* Default finddir for ramfs */
+    for (int i = 0; i < dir->child_count; i++) {
+        if (str_cmp(dir->children[i]->name, name) == 0) {
+            return dir->children[i];
+        }
+    }
+    return NULL;
+}
+
+/* Where a relative path starts: a directory fd, or the cwd for AT_FDCWD */
+static fs_node_t *at_base(int dirfd) {
+    if (dirfd == AT_FDCWD) {
+        process_t *proc = process_current();
+        return proc && proc->cwd ? proc->cwd : fs_root;
+    }
+    file_t *file = fd_file(dirfd);
+    return file && file->node->type == FS_DIRECTORY ? file->node : NULL;
+}
+
+/* Lookup a node by path (relative paths start at the cwd) */
 fs_node_t *vfs_lookup(const char *path) {
+    return vfs_lookupat(AT_FDCWD, path);
+}
+
+fs_node_t *vfs_lookupat(int dirfd, const char *path) {
     if (!path || !fs_root) return NULL;
 
-    /* Handle root */
-    if (path[0] == '/' && path[1] == '\0') {
-        return fs_root;
+    /* Absolute paths ignore dirfd */
+    fs_node_t *base = path[0] == '/' ? fs_root : at_base(dirfd);
+    return vfs_lookup_from(base, path);
+}
+
+/*
+ * Resolve everything but the last component of a path.
+ * Returns the parent directory and points *name at the last component,
+ * or NULL if the parent does not exist or the path ends in a slash.
+ */
+static fs_node_t *lookup_parent(int dirfd, const char *path, const char **name) {
+    char parent_path[FS_PATH_MAX];
+    int slash = str_len(path) - 1;
+    while (slash >= 0 && path[slash] != '/') slash--;
+
+    fs_node_t *parent;
+    if (slash < 0) {
+        parent = at_base(dirfd);
+    } else if (slash == 0) {
+        parent = fs_root;
+    } else {
+        if (slash >= FS_PATH_MAX) return NULL;
+        str_ncpy(parent_path, path, slash + 1);
+        parent = vfs_lookupat(dirfd, parent_path);
     }
 
-    return vfs_lookup_from(fs_root, path);
+    *name = path + slash + 1;
+    if (!parent || parent->type != FS_DIRECTORY || !**name) return NULL;
+
+    /* Nothing can be created in a removed directory */
+    if (parent->flags & FS_UNLINKED) return NULL;
+    return parent;
 }
 
 fs_node_t *vfs_lookup_from(fs_node_t *start, const char *path) {
@@ -138,6 +479,10 @@ fs_node_t *vfs_lookup_from(fs_node_t *start, const char *path) {
             continue;  /* Current directory */
         }
         if (component[0] == '.' && component[1] == '.' && component[2] == '\0') {
+            /* From a mounted root, ".." leaves through the covered directory */
+            while ((current->flags & FS_MOUNTROOT) && mount_covered(current)) {
+                current = mount_covered(current);
+            }
             if (current->parent) {
                 current = current->parent;
             }
@@ -149,125 +494,171 @@ fs_node_t *vfs_lookup_from(fs_node_t *start, const char *path) {
             return NULL;
         }
 
-        /* Find child */
-        if (current->ops && current->ops->finddir) {
-            current = current->ops->finddir(current, component);
-        } else {
-            /* Default finddir for ramfs */
-            fs_node_t *found = NULL;
-            for (int i = 0; i < current->child_count; i++) {
-                if (str_cmp(current->children[i]->name, component) == 0) {
-                    found = current->children[i];
-                    break;
-                }
-            }
-            current = found;
+        /* One hash probe per component; scan the directory on a miss */
+        fs_node_t *child;
+        if (!dcache_lookup(current, component, &child)) {
+            child = dir_find_child(current, component);
+            dcache_insert(current, component, child);
         }
+        current = child;
 
         if (!current) return NULL;
+
+        /* Step into whatever is mounted here */
+        while (current->flags & FS_MOUNTPOINT) {
+            current = mount_crossing(current);
+        }
     }
 
     return current;
 }
 
+/*
+ * ===========================================================================
+ * Standard Streams
+ * ===========================================================================
+ */
+
+fs_node_t *vfs_stdio_node(int fd) {
+    if (fd < 0 || fd > 2) return NULL;
+    file_t *file = fd_file(fd);
+    return file ? file->node : NULL;
+}
+
 /*
  * ===========================================================================
  * File Operations
  * ===========================================================================
  */
 
+static int node_truncate(fs_node_t *node, uint32_t size) {
+    if (!node || node->type != FS_FILE || !node->ops || !node->ops->truncate) {
+        return -1;
+    }
+    if (pcache_backed(node)) {
+        pcache_truncate(node, size);
+    }
+    return node->ops->truncate(node, size);
+}
+
+/* Make a new file or directory on the parent's filesystem */
+static fs_node_t *create_node(fs_node_t *parent, const char *name, uint8_t type) {
+    if (parent->ops && parent->ops->create) {
+        return parent->ops->create(parent, name, type);
+    }
+    return type == FS_DIRECTORY ? vfs_create_dir(parent, name)
+                                : vfs_create_file(parent, name, NULL);
+}
+
 int vfs_open(const char *path, int flags) {
-    fs_node_t *node = vfs_lookup(path);
+    return vfs_openat(AT_FDCWD, path, flags);
+}
+
+int vfs_openat(int dirfd, const char *path, int flags) {
+    fs_node_t *node = vfs_lookupat(dirfd, path);
+    if (!node && (flags & O_CREAT)) {
+        /* Create a missing file (the parent must exist) */
+        const char *name;
+        fs_node_t *parent = lookup_parent(dirfd, path, &name);
+        node = parent ? create_node(parent, name, FS_FILE) : NULL;
+    }
     if (!node) return -1;
 
-    int fd = fd_alloc();
-    if (fd < 0) return -1;
+    if ((flags & O_TRUNC) && node->type == FS_FILE && node_truncate(node, 0) != 0) {
+        return -1;
+    }
+
+    return vfs_open_node(node, flags);
+}
 
-    fd_table[fd].node = node;
-    fd_table[fd].flags = flags;
-    fd_table[fd].offset = 0;
+int vfs_open_node(fs_node_t *node, int flags) {
+    if (!node) return -1;
 
-    if (node->ops && node->ops->open) {
-        node->ops->open(node, flags);
-    }
+    file_t *file = file_new(node, flags);
+    if (!file) return -1;
 
+    int fd = fd_alloc(current_table(), file);
+    if (fd < 0) {
+        file_put(file);
+    }
     return fd;
 }
 
-int vfs_close(int fd) {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !fd_table[fd].in_use) {
-        return -1;
-    }
+int vfs_dup(int oldfd) {
+    file_t *file = fd_file(oldfd);
+    if (!file) return -1;
 
-    fs_node_t *node = fd_table[fd].node;
-    if (node && node->ops && node->ops->close) {
-        node->ops->close(node);
+    uint32_t irq = irq_save();
+    file->refs++;
+    irq_restore(irq);
+
+    int fd = fd_alloc(current_table(), file);
+    if (fd < 0) {
+        file_put(file);
     }
+    return fd;
+}
+
+int vfs_dup2(int oldfd, int newfd) {
+    return vfs_dup_into(process_current(), oldfd, newfd);
+}
+
+int vfs_close(int fd) {
+    file_t *file = fd_detach(current_table(), fd);
+    if (!file) return -1;
 
-    fd_free(fd);
+    file_put(file);
     return 0;
 }
 
 ssize_t vfs_read(int fd, void *buf, size_t size) {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !fd_table[fd].in_use) {
-        return -1;
-    }
-
-    fs_node_t *node = fd_table[fd].node;
-    if (!node) return -1;
+    file_t *file = fd_file(fd);
+    if (!file) return -1;
 
+    fs_node_t *node = file->node;
     ssize_t read = 0;
 
-    if (node->ops && node->ops->read) {
-        read = node->ops->read(node, buf, size, fd_table[fd].offset);
-    } else if (node->type == FS_FILE && node->data) {
-        /* Default read for ramfs */
-        size_t avail = node->size - fd_table[fd].offset;
-        if (size > avail) size = avail;
-        char *src = (char *)node->data + fd_table[fd].offset;
-        char *dst = (char *)buf;
-        for (size_t i = 0; i < size; i++) {
-            dst[i] = src[i];
-        }
-        read = size;
+    if (pcache_backed(node)) {
+        read = pcache_read(node, buf, size, file->offset, &file->ra);
+    } else if (node->ops && node->ops->read) {
+        read = node->ops->read(node, buf, size, file->offset);
     }
 
     if (read > 0) {
-        fd_table[fd].offset += read;
+        file->offset += read;
     }
 
     return read;
 }
 
 ssize_t vfs_write(int fd, const void *buf, size_t size) {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !fd_table[fd].in_use) {
-        return -1;
-    }
-
-    fs_node_t *node = fd_table[fd].node;
-    if (!node) return -1;
+    file_t *file = fd_file(fd);
+    if (!file) return -1;
 
+    fs_node_t *node = file->node;
     ssize_t written = 0;
 
-    if (node->ops && node->ops->write) {
-        written = node->ops->write(node, buf, size, fd_table[fd].offset);
+    /* Appends always land at the current end of file */
+    if (file->flags & O_APPEND) {
+        file->offset = node->size;
+    }
+
+    if (pcache_backed(node)) {
+        written = pcache_write(node, buf, size, file->offset);
+    } else if (node->ops && node->ops->write) {
+        written = node->ops->write(node, buf, size, file->offset);
     }
-    /* Note: default ramfs doesn't support write - would need memory allocation */
 
     if (written > 0) {
-        fd_table[fd].offset += written;
+        file->offset += written;
     }
 
     return written;
 }
 
 int vfs_seek(int fd, int offset, int whence) {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !fd_table[fd].in_use) {
-        return -1;
-    }
-
-    fs_node_t *node = fd_table[fd].node;
-    if (!node) return -1;
+    file_t *file = fd_file(fd);
+    if (!file) return -1;
 
     size_t new_offset;
 
@@ -276,48 +667,276 @@ int vfs_seek(int fd, int offset, int whence) {
             new_offset = offset;
             break;
         case SEEK_CUR:
-            new_offset = fd_table[fd].offset + offset;
+            new_offset = file->offset + offset;
             break;
         case SEEK_END:
-            new_offset = node->size + offset;
+            new_offset = file->node->size + offset;
             break;
         default:
             return -1;
     }
 
-    fd_table[fd].offset = new_offset;
+    file->offset = new_offset;
     return new_offset;
 }
 
+int vfs_truncate(const char *path, uint32_t size) {
+    return node_truncate(vfs_lookup(path), size);
+}
+
+int vfs_ftruncate(int fd, uint32_t size) {
+    file_t *file = fd_file(fd);
+    if (!file) return -1;
+    return node_truncate(file->node, size);
+}
+
+int vfs_fsync(int fd) {
+    fs_node_t *node = vfs_fd_node(fd);
+    if (!node) return -1;
+    int status = pcache_backed(node) ? pcache_sync(node) : 0;
+    if (node->ops && node->ops->fsync && node->ops->fsync(node) != 0) status = -1;
+    return status;
+}
+
+fs_node_t *vfs_fd_node(int fd) {
+    file_t *file = fd_file(fd);
+    return file ? file->node : NULL;
+}
+
+int vfs_fd_flags(int fd) {
+    file_t *file = fd_file(fd);
+    return file ? file->flags : -1;
+}
+
+file_t *vfs_fd_file(int fd) {
+    return fd_file(fd);
+}
+
+/*
+ * ===========================================================================
+ * Readiness Polling
+ * ===========================================================================
+ */
+
+uint32_t vfs_poll_node(fs_node_t *node, struct poll_table *pt) {
+    if (!node) return POLLNVAL;
+    if (node->ops && node->ops->poll) {
+        return node->ops->poll(node, pt);
+    }
+    /* Plain files never block */
+    return POLLIN | POLLOUT;
+}
+
+uint32_t vfs_poll(int fd, struct poll_table *pt) {
+    return vfs_poll_node(vfs_fd_node(fd), pt);
+}
+
+/*
+ * ===========================================================================
+ * Memory Mapping
+ * ===========================================================================
+ */
+
+int vfs_can_map(fs_node_t *node) {
+    return node && node->ops && (node->ops->mmap || pcache_backed(node));
+}
+
+int vfs_map_page(fs_node_t *node, uint32_t pgoff, uint32_t *frame, int write) {
+    if (!vfs_can_map(node) || !frame) return -1;
+    if (pcache_backed(node)) {
+        return pcache_map_page(node, pgoff, frame, write);
+    }
+    return node->ops->mmap(node, pgoff, frame);
+}
+
 /*
  * ===========================================================================
  * Directory Operations
  * ===========================================================================
  */
 
-static fs_dirent_t dirent_buf;
+/* Child at position 'index', or NULL past the end */
+static fs_node_t *dir_child_at(fs_node_t *dir, int index) {
+    if (dir->ops && dir->ops->readdir) {
+        return dir->ops->readdir(dir, index);
+    }
+    if (index >= 0 && index < dir->child_count) {
+        return dir->children[index];
+    }
+    return NULL;
+}
 
-fs_dirent_t *vfs_readdir(const char *path, int index) {
+static void fill_dirent(fs_dirent_t *entry, fs_node_t *child) {
+    str_ncpy(entry->name, child->name, FS_NAME_MAX);
+    entry->inode = child->inode;
+    entry->type = child->type;
+}
+
+static void fill_stat(fs_stat_t *stat, fs_node_t *node) {
+    stat->st_ino = node->inode;
+    stat->st_type = node->type;
+    stat->st_size = node->size;
+    stat->st_nlink = 1;
+}
+
+int vfs_readdir(const char *path, int index, fs_dirent_t *entry) {
     fs_node_t *node = vfs_lookup(path);
-    if (!node || node->type != FS_DIRECTORY) {
+    if (!node || node->type != FS_DIRECTORY || !entry) {
+        return -1;
+    }
+
+    fs_node_t *child = dir_child_at(node, index);
+    if (!child) return -1;
+
+    fill_dirent(entry, child);
+    return 0;
+}
+
+int vfs_mkdir(const char *path) {
+    return vfs_mkdirat(AT_FDCWD, path);
+}
+
+int vfs_mkdirat(int dirfd, const char *path) {
+    const char *name;
+    fs_node_t *parent = lookup_parent(dirfd, path, &name);
+    if (!parent || vfs_lookup_from(parent, name)) return -1;
+    return create_node(parent, name, FS_DIRECTORY) ? 0 : -1;
+}
+
+/*
+ * ===========================================================================
+ * Removing and Renaming
+ * ===========================================================================
+ */
+
+/*
+ * Resolve a path to a name in its parent directory. Fails for "." and
+ * "..", and for mountpoints and mounted roots, which only umount can
+ * detach.
+ */
+static fs_node_t *lookup_entry(int dirfd, const char *path, fs_node_t **parent,
+                               const char **name) {
+    *parent = lookup_parent(dirfd, path, name);
+    if (!*parent || str_cmp(*name, ".") == 0 || str_cmp(*name, "..") == 0) {
         return NULL;
     }
 
-    fs_node_t *child = NULL;
+    fs_node_t *node = vfs_lookup_from(*parent, *name);
+    if (!node || node->parent != *parent ||
+        (node->flags & (FS_MOUNTPOINT | FS_MOUNTROOT))) {
+        return NULL;
+    }
+    return node;
+}
+
+static int remove_entry(int dirfd, const char *path, int want_dir) {
+    fs_node_t *parent;
+    const char *name;
+    fs_node_t *node = lookup_entry(dirfd, path, &parent, &name);
+    if (!node || (node->type == FS_DIRECTORY) != want_dir) return -1;
+    if (!parent->ops || !parent->ops->unlink) return -1;
+
+    if (parent->ops->unlink(parent, node) != 0) return -1;
+    node_reap(node);
+    return 0;
+}
+
+int vfs_unlink(const char *path) {
+    return remove_entry(AT_FDCWD, path, 0);
+}
+
+int vfs_unlinkat(int dirfd, const char *path) {
+    return remove_entry(dirfd, path, 0);
+}
+
+int vfs_rmdir(const char *path) {
+    return remove_entry(AT_FDCWD, path, 1);
+}
+
+/* Is 'node' 'dir' or somewhere below it (within one instance)? */
+static int is_within(fs_node_t *node, fs_node_t *dir) {
+    for (;;) {
+        if (node == dir) return 1;
+        if (!node->parent || node->parent == node) return 0;
+        node = node->parent;
+    }
+}
+
+int vfs_rename(const char *oldpath, const char *newpath) {
+    return vfs_renameat(AT_FDCWD, oldpath, AT_FDCWD, newpath);
+}
+
+int vfs_renameat(int olddirfd, const char *oldpath, int newdirfd, const char *newpath) {
+    fs_node_t *olddir, *newdir;
+    const char *oldname, *newname;
+    fs_node_t *node = lookup_entry(olddirfd, oldpath, &olddir, &oldname);
+    if (!node) return -1;
+
+    newdir = lookup_parent(newdirfd, newpath, &newname);
+    if (!newdir || str_cmp(newname, ".") == 0 || str_cmp(newname, "..") == 0 ||
+        str_len(newname) >= FS_NAME_MAX) {
+        return -1;
+    }
+
+    /* Names only move within one filesystem, and never into themselves */
+    if (instance_root(olddir) != instance_root(newdir)) return -1;
+    if (node->type == FS_DIRECTORY && is_within(newdir, node)) return -1;
+    if (!olddir->ops || !olddir->ops->rename) return -1;
+
+    /* An existing target must be an ordinary entry of the same kind */
+    fs_node_t *target = vfs_lookup_from(newdir, newname);
+    if (target == node) {
+        /* Nothing to do, unless only the spelling changes (FAT ignores case) */
+        if (olddir != newdir || str_cmp(node->name, newname) == 0) return 0;
+        target = NULL;
+    }
+    if (target && (target->parent != newdir ||
+                   (target->flags & (FS_MOUNTPOINT | FS_MOUNTROOT)) ||
+                   (target->type == FS_DIRECTORY) != (node->type == FS_DIRECTORY))) {
+        return -1;
+    }
 
-    if (node->ops && node->ops->readdir) {
-        child = node->ops->readdir(node, index);
-    } else if (index < node->child_count) {
-        child = node->children[index];
+    if (olddir->ops->rename(olddir, node, newdir, newname) != 0) return -1;
+    if (target) {
+        node_reap(target);
     }
+    return 0;
+}
+
+/* Open directory description behind fd, or NULL */
+static file_t *dir_fd_file(int fd) {
+    file_t *file = fd_file(fd);
+    return file && file->node->type == FS_DIRECTORY ? file : NULL;
+}
 
-    if (!child) return NULL;
+int vfs_getdents(int fd, fs_dirent_t *entries, int count) {
+    file_t *file = dir_fd_file(fd);
+    if (!file || !entries || count < 0) return -1;
 
-    str_ncpy(dirent_buf.name, child->name, FS_NAME_MAX);
-    dirent_buf.inode = child->inode;
-    dirent_buf.type = child->type;
+    int n = 0;
+    while (n < count) {
+        fs_node_t *child = dir_child_at(file->node, (int)file->offset);
+        if (!child) break;
+        fill_dirent(&entries[n++], child);
+        file->offset++;
+    }
+    return n;
+}
 
-    return &dirent_buf;
+int vfs_readdirplus(int fd, fs_direntplus_t *entries, int count) {
+    file_t *file = dir_fd_file(fd);
+    if (!file || !entries || count < 0) return -1;
+
+    int n = 0;
+    while (n < count) {
+        fs_node_t *child = dir_child_at(file->node, (int)file->offset);
+        if (!child) break;
+        fill_dirent(&entries[n].dirent, child);
+        fill_stat(&entries[n].stat, child);
+        n++;
+        file->offset++;
+    }
+    return n;
 }
 
 /*
@@ -327,40 +946,167 @@ fs_dirent_t *vfs_readdir(const char *path, int index) {
  */
 
 int vfs_stat(const char *path, fs_stat_t *stat) {
-    fs_node_t *node = vfs_lookup(path);
+    return vfs_statat(AT_FDCWD, path, stat);
+}
+
+int vfs_statat(int dirfd, const char *path, fs_stat_t *stat) {
+    fs_node_t *node = vfs_lookupat(dirfd, path);
     if (!node || !stat) return -1;
 
-    stat->st_ino = node->inode;
-    stat->st_type = node->type;
-    stat->st_size = node->size;
-    stat->st_nlink = 1;
+    fill_stat(stat, node);
+    return 0;
+}
 
+/*
+ * ===========================================================================
+ * Working Directory
+ * ===========================================================================
+ */
+
+/* Make 'dir' the current process's cwd (NULL leaves it at the root) */
+static int set_cwd(fs_node_t *dir) {
+    if (!dir || dir->type != FS_DIRECTORY) return -1;
+
+    process_t *proc = process_current();
+    if (!proc) return -1;
+
+    node_ref(dir, O_RDONLY);
+    fs_node_t *old = proc->cwd;
+    proc->cwd = dir;
+    node_unref(old);
     return 0;
 }
 
+int vfs_chdir(const char *path) {
+    return set_cwd(vfs_lookup(path));
+}
+
+int vfs_fchdir(int fd) {
+    return set_cwd(vfs_fd_node(fd));
+}
+
+int vfs_getcwd(char *buf, size_t size) {
+    process_t *proc = process_current();
+    return vfs_get_path(proc && proc->cwd ? proc->cwd : fs_root, buf, size);
+}
+
+void vfs_cwd_inherit(process_t *child, process_t *parent) {
+    child->cwd = parent ? parent->cwd : NULL;
+    node_ref(child->cwd, O_RDONLY);
+}
+
+void vfs_cwd_release(process_t *proc) {
+    fs_node_t *cwd = proc->cwd;
+    proc->cwd = NULL;
+    node_unref(cwd);
+}
+
+/*
+ * ===========================================================================
+ * Path Utilities
+ * ===========================================================================
+ */
+
+int vfs_get_path(fs_node_t *node, char *buf, size_t size) {
+    if (!node || !buf || size < 2) return -1;
+
+    /* Fill from the end, one component per parent link */
+    size_t pos = size - 1;
+    buf[pos] = '\0';
+    fs_node_t *n = node;
+    while (n && n != fs_root) {
+        /* A mounted root is named by the directory it covers */
+        if (n->flags & FS_MOUNTROOT) {
+            n = mount_covered(n);
+            continue;
+        }
+
+        size_t len = (size_t)str_len(n->name);
+        if (len + 1 > pos) return -1;
+        pos -= len;
+        for (size_t i = 0; i < len; i++) {
+            buf[pos + i] = n->name[i];
+        }
+        buf[--pos] = '/';
+        n = n->parent != n ? n->parent : NULL;
+    }
+    if (pos == size - 1) {
+        buf[--pos] = '/';
+    }
+
+    /* Slide to the front of the buffer */
+    size_t i = 0;
+    while ((buf[i] = buf[pos + i])) i++;
+    return (int)i;
+}
+
+int vfs_normalize_path(const char *path, char *out, size_t size) {
+    if (!path || !out || size < 2) return -1;
+
+    /* Relative paths are taken from the cwd */
+    size_t len = 1;
+    out[0] = '/';
+    if (path[0] != '/') {
+        int cwd_len = vfs_getcwd(out, size);
+        if (cwd_len < 0) return -1;
+        len = (size_t)cwd_len;
+    }
+
+    char component[FS_NAME_MAX];
+    while ((path = path_next_component(path, component, FS_NAME_MAX)) != NULL) {
+        if (str_cmp(component, ".") == 0) {
+            continue;
+        }
+        if (str_cmp(component, "..") == 0) {
+            /* Drop the last component; ".." of the root is the root */
+            while (len > 1 && out[len - 1] != '/') len--;
+            if (len > 1) len--;
+            continue;
+        }
+
+        size_t clen = (size_t)str_len(component);
+        size_t sep = out[len - 1] == '/' ? 0 : 1;
+        if (len + sep + clen + 1 > size) return -1;
+        if (sep) out[len++] = '/';
+        for (size_t i = 0; i < clen; i++) {
+            out[len++] = component[i];
+        }
+    }
+
+    out[len] = '\0';
+    return (int)len;
+}
+
 /*
  * ===========================================================================
  * VFS Init
  * ===========================================================================
  */
 
-/* External: ramfs will set up the root */
+/* Filesystem types (each registers itself) */
 extern void ramfs_init(void);
+extern void devfs_init(void);
+extern void ext2_init(void);
+extern void fat_init(void);
+extern void lfs_init(void);
 
 void vfs_init(void) {
-    /* Clear file descriptor table */
-    for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        fd_table[i].in_use = 0;
-        fd_table[i].node = NULL;
-        fd_table[i].offset = 0;
-        fd_table[i].flags = 0;
-    }
+    /* Descriptors opened outside any process */
+    table_init(&kernel_files);
 
-    /* Reserve stdin, stdout, stderr */
-    fd_table[0].in_use = 1;  /* stdin */
-    fd_table[1].in_use = 1;  /* stdout */
-    fd_table[2].in_use = 1;  /* stderr */
+    /* Start with empty dentry and page caches */
+    dcache_init();
+    pcache_init();
 
-    /* Initialize the RAM filesystem */
+    /* Root filesystem with the initial tree */
     ramfs_init();
+
+    /* Device nodes get their own filesystem at /dev */
+    devfs_init();
+    vfs_mount("devfs", "devfs", "/dev");
+
+    /* Disk filesystems, mounted on demand */
+    ext2_init();
+    fat_init();
+    lfs_init();
 }
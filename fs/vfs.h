@@ -2,8 +2,8 @@
  * ClaudeOS Virtual Filesystem - Header
  * Worker1 - Shell+FS Claude
  *
- * Provides a unified interface for filesystem operations.
- * Currently supports in-memory ramfs, can be extended for disk-based fs.
+ * Provides a unified interface for filesystem operations. Filesystems
+ * register a type and are mounted into one namespace (see mount.h).
  */
 
 #ifndef CLAUDEOS_VFS_H
@@ -17,6 +17,13 @@
 #define FS_CHARDEV   0x03
 #define FS_BLOCKDEV  0x04
 #define FS_SYMLINK   0x05
+#define FS_PIPE      0x06
+
+/* Node flags (see mount.h) */
+#define FS_MOUNTPOINT 0x10000   /* A filesystem is mounted on this directory */
+#define FS_MOUNTROOT  0x20000   /* Root directory of a mounted filesystem */
+#define FS_UNLINKED   0x40000   /* Removed from its directory, freed on last put */
+#define FS_INLINE     0x80000   /* File data is held in node->inline_data */
 
 /* Open flags */
 #define O_RDONLY     0x0000
@@ -26,6 +33,9 @@
 #define O_TRUNC      0x0200
 #define O_APPEND     0x0400
 
+/* "Relative to the working directory" in place of a directory fd */
+#define AT_FDCWD     (-100)
+
 /* Seek origins */
 #define SEEK_SET     0
 #define SEEK_CUR     1
@@ -34,11 +44,13 @@
 /* Limits */
 #define FS_NAME_MAX  64
 #define FS_PATH_MAX  256
-#define FS_MAX_FILES 128
-#define FS_MAX_CHILDREN 32
+#define FS_INLINE_MAX 60        /* Largest file kept inside its node */
 
 /* Forward declaration */
 struct fs_node;
+struct poll_table;
+struct file;
+struct superblock;
 
 /* File operations function pointers */
 typedef struct {
@@ -48,28 +60,84 @@ typedef struct {
     ssize_t (*write)(struct fs_node *node, const void *buf, size_t size, size_t offset);
     struct fs_node* (*readdir)(struct fs_node *node, int index);
     struct fs_node* (*finddir)(struct fs_node *node, const char *name);
+    /* Return the page frame backing file page 'pgoff', with a reference
+     * taken for the caller (used by mmap for zero-copy mappings) */
+    int (*mmap)(struct fs_node *node, uint32_t pgoff, uint32_t *frame);
+    /* Return the current POLL* readiness mask and poll_wait() on every
+     * wait queue that is woken when it may change (see poll.h) */
+    uint32_t (*poll)(struct fs_node *node, struct poll_table *pt);
+    /* Set the file size (shrink frees data, grow leaves a hole) */
+    int (*truncate)(struct fs_node *node, uint32_t size);
+    /* Block-backed files: fill or store one whole page of file data.
+     * Files with readpage are read, written and mapped through the
+     * page cache (see pagecache.h) */
+    int (*readpage)(struct fs_node *node, uint32_t pgoff, void *page);
+    int (*writepage)(struct fs_node *node, uint32_t pgoff, const void *page);
+    /* Optional: fill 'count' consecutive pages from 'pgoff' (frames[i]
+     * holds page pgoff + i) at once, so read-ahead can go to the device
+     * as a few large requests instead of one per page */
+    int (*readpages)(struct fs_node *node, uint32_t pgoff, uint32_t count, uint32_t *frames);
+    /* Optional: store 'count' consecutive pages the same way, so
+     * write-back of adjacent dirty pages becomes a few large requests */
+    int (*writepages)(struct fs_node *node, uint32_t pgoff, uint32_t count, uint32_t *frames);
+    /* Optional, instead of readpage: lend the frame that already holds
+     * page 'pgoff' on a memory-backed device, with a reference for the
+     * caller. The cache uses it in place; writes to it reach the device */
+    int (*sharepage)(struct fs_node *node, uint32_t pgoff, uint32_t *frame);
+    /* Directories: make an empty FS_FILE or FS_DIRECTORY named 'name'
+     * and link it in. Without it, new names are in-memory ramfs nodes */
+    struct fs_node* (*create)(struct fs_node *dir, const char *name, uint8_t type);
+    /* Directories: detach 'child' (an empty directory or a file) and
+     * flag it FS_UNLINKED; the node lives on until its last reference */
+    int (*unlink)(struct fs_node *dir, struct fs_node *child);
+    /* Directories: move 'child' to newdir/newname in one step, replacing
+     * an existing target of the same kind */
+    int (*rename)(struct fs_node *olddir, struct fs_node *child,
+                  struct fs_node *newdir, const char *newname);
+    /* Optional: make what has been written back to the filesystem
+     * (by writepage) durable, for filesystems that buffer it */
+    int (*fsync)(struct fs_node *node);
+    /* Free an unlinked node once nothing references it */
+    void (*release)(struct fs_node *node);
 } fs_ops_t;
 
-/* Filesystem node (inode-like structure) */
+/*
+ * Filesystem node (inode-like structure)
+ *
+ * Kept small, since every file and directory has one: the name is an
+ * interned string (see names.h), and fields only one kind of node needs
+ * share a union. A small file's data lives in the union itself, so the
+ * whole node is 96 bytes on i386.
+ */
 typedef struct fs_node {
-    char name[FS_NAME_MAX];     /* Filename */
-    uint8_t type;               /* FS_FILE, FS_DIRECTORY, etc. */
-    uint32_t flags;             /* Permissions, etc. */
+    const char *name;           /* Filename (interned for directory entries) */
+    struct fs_node *parent;     /* Parent directory */
+    fs_ops_t *ops;              /* Operations */
+    void *data;                 /* Filesystem-private state */
     uint32_t size;              /* File size in bytes */
     uint32_t inode;             /* Inode number */
+    uint32_t flags;             /* FS_MOUNTPOINT, FS_INLINE, etc. */
+    struct superblock *sb;      /* Instance it belongs to (set on first reference) */
 
-    /* For in-memory filesystem */
-    void *data;                 /* File contents (for files) */
-    struct fs_node *parent;     /* Parent directory */
-    struct fs_node **children;  /* Children (for directories) */
-    int child_count;            /* Number of children */
+    /* Open files, working directories and mappings using the node */
+    uint16_t refcount;
 
-    /* Operations */
-    fs_ops_t *ops;
+    uint8_t type;               /* FS_FILE, FS_DIRECTORY, etc. */
 
-    /* Device info (for device files) */
-    uint32_t major;
-    uint32_t minor;
+    union {
+        /* FS_DIRECTORY */
+        struct {
+            struct fs_node **children;
+            int child_count;
+        };
+        /* FS_CHARDEV, FS_BLOCKDEV */
+        struct {
+            uint32_t major;
+            uint32_t minor;
+        };
+        /* FS_FILE with FS_INLINE: bytes past size are zero */
+        uint8_t inline_data[FS_INLINE_MAX];
+    };
 } fs_node_t;
 
 /* File stat structure */
@@ -87,6 +155,12 @@ typedef struct {
     uint8_t type;
 } fs_dirent_t;
 
+/* Directory entry with its stat data (readdirplus) */
+typedef struct {
+    fs_dirent_t dirent;
+    fs_stat_t stat;
+} fs_direntplus_t;
+
 /*
  * ===========================================================================
  * VFS Interface Functions
@@ -99,27 +173,137 @@ void vfs_init(void);
 /* Get the root filesystem node */
 fs_node_t *vfs_get_root(void);
 
-/* Path operations */
+/*
+ * Path operations. Relative paths start at the current process's
+ * working directory; the *at() variants start them at the directory
+ * open as dirfd instead (or the cwd for AT_FDCWD).
+ */
 fs_node_t *vfs_lookup(const char *path);
+fs_node_t *vfs_lookupat(int dirfd, const char *path);
 fs_node_t *vfs_lookup_from(fs_node_t *start, const char *path);
 
 /* File operations */
 int vfs_open(const char *path, int flags);
+int vfs_openat(int dirfd, const char *path, int flags);
 int vfs_close(int fd);
 ssize_t vfs_read(int fd, void *buf, size_t size);
 ssize_t vfs_write(int fd, const void *buf, size_t size);
 int vfs_seek(int fd, int offset, int whence);
+int vfs_truncate(const char *path, uint32_t size);
+int vfs_ftruncate(int fd, uint32_t size);
+
+/* Write back cached dirty pages of an open file and make them durable */
+int vfs_fsync(int fd);
+
+/* Get the node behind an open file descriptor (NULL if not open) */
+fs_node_t *vfs_fd_node(int fd);
+
+/* Get the O_* flags a descriptor was opened with (-1 if not open) */
+int vfs_fd_flags(int fd);
+
+/* Get the open file description a descriptor refers to (NULL if not open) */
+struct file *vfs_fd_file(int fd);
+
+/* Open an already-resolved node (pipes, devices) */
+int vfs_open_node(fs_node_t *node, int flags);
+
+/*
+ * Pin a node while using it outside of an open file (e.g. a mapping).
+ * The put that drops the last reference to an unlinked node frees it.
+ * References also count against the node's instance, which cannot be
+ * unmounted while any are held.
+ */
+void vfs_node_get(fs_node_t *node);
+void vfs_node_put(fs_node_t *node);
+
+/*
+ * For a filesystem's unmount hook: write back and drop the cached pages
+ * of every file under 'root', then free the nodes bottom up with
+ * 'free_node'. Only safe once vfs_umount() has found the instance idle.
+ */
+void vfs_tree_free(fs_node_t *root, void (*free_node)(fs_node_t *node));
+
+/*
+ * Descriptors are per process and name a shared open file description
+ * (node, flags, offset). dup/dup2 make another descriptor for the same
+ * description, so both move one offset. New fds take the lowest free
+ * number from 3 up.
+ */
+int vfs_dup(int oldfd);
+int vfs_dup2(int oldfd, int newfd);
+
+struct process;
+
+/* Make newfd in another process's table share our oldfd (for spawning) */
+int vfs_dup_into(struct process *proc, int oldfd, int newfd);
+
+/*
+ * Give a new process its table. It shares the parent's standard streams,
+ * or with share_all every descriptor (fork semantics).
+ */
+int vfs_files_create(struct process *proc, struct process *parent, int share_all);
+
+/* Close every descriptor of an exiting process and free its table */
+void vfs_files_release(struct process *proc);
+
+/*
+ * Standard streams. An empty slot 0-2 means the console; a process can
+ * point them at any node (e.g. a pipe end) with vfs_dup_into/vfs_dup2.
+ * Returns the node, or NULL for the console.
+ */
+fs_node_t *vfs_stdio_node(int fd);
+
+/* Readiness polling (POLLNVAL if fd is not open) */
+uint32_t vfs_poll(int fd, struct poll_table *pt);
+uint32_t vfs_poll_node(fs_node_t *node, struct poll_table *pt);
+
+/* Memory mapping support */
+int vfs_can_map(fs_node_t *node);
+int vfs_map_page(fs_node_t *node, uint32_t pgoff, uint32_t *frame, int write);
 
 /* Directory operations */
-fs_dirent_t *vfs_readdir(const char *path, int index);
+int vfs_readdir(const char *path, int index, fs_dirent_t *entry);
 int vfs_mkdir(const char *path);
+int vfs_mkdirat(int dirfd, const char *path);
+
+/*
+ * Remove a name. unlink takes files, rmdir empty directories; open
+ * files keep their data until closed. rename atomically replaces an
+ * existing target of the same kind, within one filesystem.
+ */
+int vfs_unlink(const char *path);
+int vfs_unlinkat(int dirfd, const char *path);
+int vfs_rmdir(const char *path);
+int vfs_rename(const char *oldpath, const char *newpath);
+int vfs_renameat(int olddirfd, const char *oldpath, int newdirfd, const char *newpath);
+
+/*
+ * Batched iteration over a directory opened with vfs_open(). The fd
+ * offset is the index of the next entry, so SEEK_SET 0 rewinds. Both
+ * return the number of entries stored, 0 at the end, or -1.
+ */
+int vfs_getdents(int fd, fs_dirent_t *entries, int count);
+int vfs_readdirplus(int fd, fs_direntplus_t *entries, int count);
 
 /* Stat */
 int vfs_stat(const char *path, fs_stat_t *stat);
+int vfs_statat(int dirfd, const char *path, fs_stat_t *stat);
+
+/*
+ * Working directory. Each process holds a reference on its cwd node,
+ * inherited from its parent (none = the root).
+ */
+int vfs_chdir(const char *path);
+int vfs_fchdir(int fd);
+int vfs_getcwd(char *buf, size_t size);
+void vfs_cwd_inherit(struct process *child, struct process *parent);
+void vfs_cwd_release(struct process *proc);
 
 /* Create file (for ramfs) */
 fs_node_t *vfs_create_file(fs_node_t *parent, const char *name, const char *content);
 fs_node_t *vfs_create_dir(fs_node_t *parent, const char *name);
+fs_node_t *vfs_create_device(fs_node_t *parent, const char *name, fs_ops_t *ops,
+                             uint32_t major, uint32_t minor);
 
 /*
  * ===========================================================================
@@ -127,13 +311,13 @@ fs_node_t *vfs_create_dir(fs_node_t *parent, const char *name);
  * ===========================================================================
  */
 
-/* Get absolute path from node */
+/* Get absolute path from node (returns its length, or -1) */
 int vfs_get_path(fs_node_t *node, char *buf, size_t size);
 
 /* Check if path is absolute */
 int vfs_is_absolute(const char *path);
 
-/* Normalize path (resolve . and ..) */
+/* Normalize path (make absolute, resolve . and .. by name; returns length or -1) */
 int vfs_normalize_path(const char *path, char *out, size_t size);
 
 #endif /* CLAUDEOS_VFS_H */
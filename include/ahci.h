@@ -0,0 +1,124 @@
+/**
+ * ClaudeOS AHCI Driver - ahci.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: SATA disks behind an AHCI host bus adapter, with NCQ
+ *
+ * Each implemented port with a SATA disk gets a command list of up to
+ * 32 slots, a FIS receive area and one command table per slot. With
+ * Native Command Queuing every slot can hold an outstanding READ/WRITE
+ * FPDMA QUEUED command; the interrupt handler completes whichever tags
+ * the device has cleared from PxSACT.
+ */
+
+#ifndef _CLAUDEOS_AHCI_H
+#define _CLAUDEOS_AHCI_H
+
+#include "types.h"
+
+/* HBA (generic host control) registers */
+#define AHCI_CAP            0x00
+#define AHCI_GHC            0x04
+#define AHCI_IS             0x08
+#define AHCI_PI             0x0C
+#define AHCI_VS             0x10
+
+#define AHCI_CAP_NCS_SHIFT  8       /* Command slots - 1, 5 bits */
+#define AHCI_CAP_SSS        (1u << 27)  /* Staggered spin-up */
+#define AHCI_CAP_SNCQ       (1u << 30)  /* Native Command Queuing */
+
+#define AHCI_GHC_HR         (1u << 0)
+#define AHCI_GHC_IE         (1u << 1)
+#define AHCI_GHC_AE         (1u << 31)
+
+/* Port registers (0x100 + port * 0x80) */
+#define AHCI_PORT_BASE      0x100
+#define AHCI_PORT_SIZE      0x80
+#define AHCI_PxCLB          0x00
+#define AHCI_PxCLBU         0x04
+#define AHCI_PxFB           0x08
+#define AHCI_PxFBU          0x0C
+#define AHCI_PxIS           0x10
+#define AHCI_PxIE           0x14
+#define AHCI_PxCMD          0x18
+#define AHCI_PxTFD          0x20
+#define AHCI_PxSIG          0x24
+#define AHCI_PxSSTS         0x28
+#define AHCI_PxSERR         0x30
+#define AHCI_PxSACT         0x34
+#define AHCI_PxCI           0x38
+
+#define AHCI_PxCMD_ST       (1u << 0)
+#define AHCI_PxCMD_SUD      (1u << 1)
+#define AHCI_PxCMD_POD      (1u << 2)
+#define AHCI_PxCMD_FRE      (1u << 4)
+#define AHCI_PxCMD_FR       (1u << 14)
+#define AHCI_PxCMD_CR       (1u << 15)
+
+/* Port interrupt bits */
+#define AHCI_PxIS_DHRS      (1u << 0)   /* D2H register FIS */
+#define AHCI_PxIS_PSS       (1u << 1)   /* PIO setup FIS */
+#define AHCI_PxIS_DSS       (1u << 2)   /* DMA setup FIS */
+#define AHCI_PxIS_SDBS      (1u << 3)   /* Set device bits FIS (NCQ done) */
+#define AHCI_PxIS_TFES      (1u << 30)  /* Task file error */
+#define AHCI_PxIS_ERRORS    0x7DC00050u /* Any fatal or non-fatal error */
+
+#define AHCI_SIG_ATA        0x00000101
+
+/* FIS types */
+#define FIS_TYPE_REG_H2D    0x27
+
+/* Commands beyond those in ata.h */
+#define ATA_CMD_READ_FPDMA  0x60
+#define ATA_CMD_WRITE_FPDMA 0x61
+
+#define AHCI_MAX_SLOTS      32
+#define AHCI_MAX_PRDS       56      /* Per command table (1KB each) */
+
+/* Command list entry */
+typedef struct {
+    uint16_t flags;                 /* CFL, A, W, P, R, B, C, PMP */
+    uint16_t prdtl;                 /* PRD entries */
+    volatile uint32_t prdbc;        /* Bytes transferred */
+    uint32_t ctba;
+    uint32_t ctbau;
+    uint32_t reserved[4];
+} __attribute__((packed)) ahci_cmd_header_t;
+
+#define AHCI_CMD_WRITE      (1 << 6)
+#define AHCI_CMD_CLEAR_BUSY (1 << 10)
+
+typedef struct {
+    uint32_t dba;
+    uint32_t dbau;
+    uint32_t reserved;
+    uint32_t dbc;                   /* Byte count - 1; bit 31 interrupts */
+} __attribute__((packed)) ahci_prd_t;
+
+typedef struct {
+    uint8_t cfis[64];
+    uint8_t acmd[16];
+    uint8_t reserved[48];
+    ahci_prd_t prdt[AHCI_MAX_PRDS];
+} __attribute__((packed)) ahci_cmd_table_t;
+
+/* Host to device register FIS */
+typedef struct {
+    uint8_t type;
+    uint8_t flags;                  /* 0x80: command register update */
+    uint8_t command;
+    uint8_t feature_lo;
+    uint8_t lba0, lba1, lba2;
+    uint8_t device;
+    uint8_t lba3, lba4, lba5;
+    uint8_t feature_hi;
+    uint8_t count_lo;
+    uint8_t count_hi;
+    uint8_t icc;
+    uint8_t control;
+    uint8_t reserved[4];
+} __attribute__((packed)) fis_reg_h2d_t;
+
+/* Probe AHCI controllers and register their disks (sda, sdb...) */
+void ahci_init(void);
+
+#endif /* _CLAUDEOS_AHCI_H */
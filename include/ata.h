@@ -0,0 +1,106 @@
+/**
+ * ClaudeOS ATA/IDE Driver - ata.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Parallel ATA disks with PCI bus-master DMA
+ *
+ * Disks are found with IDENTIFY on both channels of the PCI IDE
+ * controller (or the legacy ports if there is none) and registered with
+ * the block layer as hda..hdd. Requests go out as bus-master DMA from a
+ * PRD table and complete on the channel interrupt (IRQ14/15 in
+ * compatibility mode); PIO remains for controllers without bus-master
+ * support and for buffers the DMA engine cannot reach.
+ */
+
+#ifndef _CLAUDEOS_ATA_H
+#define _CLAUDEOS_ATA_H
+
+#include "types.h"
+#include "block.h"
+
+/* Legacy (compatibility mode) channel resources */
+#define ATA_PRIMARY_IO      0x1F0
+#define ATA_PRIMARY_CTRL    0x3F6
+#define ATA_SECONDARY_IO    0x170
+#define ATA_SECONDARY_CTRL  0x376
+
+/* Task file registers (offsets from the I/O base) */
+#define ATA_REG_DATA        0
+#define ATA_REG_ERROR       1
+#define ATA_REG_FEATURES    1
+#define ATA_REG_SECCOUNT    2
+#define ATA_REG_LBA0        3
+#define ATA_REG_LBA1        4
+#define ATA_REG_LBA2        5
+#define ATA_REG_DRIVE       6
+#define ATA_REG_STATUS      7
+#define ATA_REG_COMMAND     7
+
+/* Status bits */
+#define ATA_SR_BSY          0x80
+#define ATA_SR_DRDY         0x40
+#define ATA_SR_DF           0x20
+#define ATA_SR_DRQ          0x08
+#define ATA_SR_ERR          0x01
+
+/* Device control register */
+#define ATA_CTL_NIEN        0x02    /* Mask the device interrupt */
+#define ATA_CTL_SRST        0x04    /* Software reset */
+
+/* Commands */
+#define ATA_CMD_READ_PIO        0x20
+#define ATA_CMD_READ_PIO_EXT    0x24
+#define ATA_CMD_READ_DMA        0xC8
+#define ATA_CMD_READ_DMA_EXT    0x25
+#define ATA_CMD_WRITE_PIO       0x30
+#define ATA_CMD_WRITE_PIO_EXT   0x34
+#define ATA_CMD_WRITE_DMA       0xCA
+#define ATA_CMD_WRITE_DMA_EXT   0x35
+#define ATA_CMD_FLUSH           0xE7
+#define ATA_CMD_FLUSH_EXT       0xEA
+#define ATA_CMD_IDENTIFY        0xEC
+#define ATA_CMD_SET_FEATURES    0xEF
+
+/* Bus-master IDE registers (offsets from BAR4, +8 for the secondary) */
+#define BMIDE_CMD           0
+#define BMIDE_STATUS        2
+#define BMIDE_PRDT          4
+
+#define BMIDE_CMD_START     0x01
+#define BMIDE_CMD_READ      0x08    /* Device to memory */
+#define BMIDE_SR_ACTIVE     0x01
+#define BMIDE_SR_ERR        0x02
+#define BMIDE_SR_IRQ        0x04
+#define BMIDE_SR_DMA0       0x20    /* Master is DMA capable */
+#define BMIDE_SR_DMA1       0x40    /* Slave is DMA capable */
+
+/* One physical region descriptor */
+typedef struct {
+    uint32_t addr;
+    uint16_t bytes;                 /* 0 means 64KB */
+    uint16_t flags;                 /* PRD_EOT on the last entry */
+} __attribute__((packed)) ata_prd_t;
+
+#define PRD_EOT             0x8000
+#define PRD_MAX             512     /* One page of descriptors */
+
+typedef struct {
+    uint32_t dma_requests;
+    uint32_t pio_requests;
+    uint32_t errors;
+    uint64_t cpu_cycles;            /* TSC cycles spent in the driver */
+} ata_stats_t;
+
+/* Probe the controller and register any disks found */
+void ata_init(void);
+
+/**
+ * Allow or forbid DMA for a disk (e.g. to compare with PIO)
+ * @return 0, or -1 if the device is not an ATA disk or cannot do DMA
+ */
+int ata_set_dma(block_device_t* dev, bool enable);
+
+/* Counters for all ATA disks */
+void ata_get_stats(ata_stats_t* stats);
+void ata_reset_stats(void);
+
+#endif /* _CLAUDEOS_ATA_H */
@@ -0,0 +1,224 @@
+/**
+ * ClaudeOS Block Layer - block.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Block device registry, bio requests and I/O scheduling
+ *
+ * Filesystems describe I/O as bios: a start sector and a list of memory
+ * segments. Bios are merged into requests for adjacent sectors, held in
+ * a per-device scheduler queue, and handed to the driver a request at a
+ * time. While a device is plugged nothing is dispatched, so a burst of
+ * small sequential bios leaves as a few large requests.
+ *
+ * Drivers complete requests with block_complete(), from their interrupt
+ * handler or straight from submit() for synchronous devices.
+ */
+
+#ifndef _CLAUDEOS_BLOCK_H
+#define _CLAUDEOS_BLOCK_H
+
+#include "types.h"
+#include "process.h"
+
+#define BLOCK_SECTOR_SIZE   512
+#define BLOCK_SECTOR_SHIFT  9
+#define BLOCK_NAME_MAX      16
+#define BIO_MAX_SEGS        16      /* Segments in one bio */
+#define REQ_MAX_SEGS        128     /* Segments in one merged request */
+
+/* Bio operations */
+#define BIO_READ            0
+#define BIO_WRITE           1
+#define BIO_FLUSH           2       /* Drain the device's write cache */
+
+struct block_device;
+struct bio;
+
+/* One contiguous piece of a transfer (kernel addresses are physical) */
+typedef struct {
+    uint32_t addr;
+    uint32_t len;                   /* Multiple of the sector size */
+} bio_seg_t;
+
+typedef void (*bio_end_t)(struct bio* bio);
+
+typedef struct bio {
+    struct block_device* dev;
+    uint32_t op;                    /* BIO_READ / BIO_WRITE / BIO_FLUSH */
+    uint64_t sector;
+    uint32_t nsegs;
+    bio_seg_t segs[BIO_MAX_SEGS];
+    volatile int done;
+    int status;                     /* 0, or -1 on an I/O error */
+    bio_end_t end;                  /* Completion callback (optional) */
+    void* priv;
+    struct bio* next;               /* Next bio of the same request */
+} bio_t;
+
+/* A run of bios for consecutive sectors, dispatched as one command */
+typedef struct request {
+    struct block_device* dev;
+    uint32_t op;
+    uint64_t sector;
+    uint32_t sectors;
+    uint32_t nsegs;
+    bio_t* bio;                     /* First bio (in sector order) */
+    bio_t* bio_tail;
+    uint64_t deadline;              /* Tick by which it should be dispatched */
+    struct request* next;           /* Scheduler links */
+    struct request* prev;
+    struct request* fifo_next;
+    struct request* fifo_prev;
+    void* driver_data;              /* Owned by the driver while in flight */
+} request_t;
+
+/* Iterate over every segment of a request, in sector order */
+#define REQ_FOR_EACH_SEG(rq, sg, bi, idx) \
+    for ((bi) = (rq)->bio; (bi); (bi) = (bi)->next) \
+        for ((idx) = 0, (sg) = &(bi)->segs[0]; (idx) < (bi)->nsegs; (idx)++, (sg)++)
+
+/**
+ * An I/O scheduler
+ * It owns the queue of requests waiting for dispatch. The block layer
+ * asks it for a merge candidate before adding a new request.
+ */
+typedef struct block_sched {
+    const char* name;
+    /* Per-device state, handed over zeroed in dev->sched_data (<= PAGE_SIZE) */
+    uint32_t data_size;
+    /* Queued request that 'bio' could extend at its back or front */
+    request_t* (*find_merge)(struct block_device* dev, bio_t* bio, int* front);
+    /* A request grew: re-sort it if needed */
+    void (*merged)(struct block_device* dev, request_t* req);
+    void (*add)(struct block_device* dev, request_t* req);
+    /* Remove and return the next request to dispatch (NULL if none) */
+    request_t* (*next)(struct block_device* dev);
+    struct block_sched* list_next;
+} block_sched_t;
+
+/* Driver entry points */
+typedef struct {
+    /**
+     * Start a request; call block_complete() when it finishes
+     * @return 0 if accepted, -1 if the device cannot take it right now
+     *         (it is retried after the next completion)
+     */
+    int (*submit)(struct block_device* dev, request_t* req);
+    /* Reap completions without interrupts (optional; used at boot) */
+    void (*poll)(struct block_device* dev);
+    /**
+     * Tell the device about everything submitted since the last call
+     * (optional). Called once per dispatch pass, so drivers with a
+     * doorbell can ring it once for a batch of requests.
+     */
+    void (*commit)(struct block_device* dev);
+    /**
+     * Lend the frame that stores the page at 'sector' (optional; memory
+     * backed devices), with a reference taken for the caller. Writes to
+     * the frame are writes to the device.
+     * @return 0, or -1 if it cannot
+     */
+    int (*share_page)(struct block_device* dev, uint64_t sector, uint32_t* frame);
+} block_ops_t;
+
+typedef struct {
+    uint32_t bios;
+    uint32_t requests;              /* Dispatched to the driver */
+    uint32_t merges;                /* Bios absorbed into a queued request */
+    uint32_t read_sectors;
+    uint32_t write_sectors;
+    uint32_t errors;
+    uint32_t irqs;                  /* Completion interrupts (driver counted) */
+} block_stats_t;
+
+typedef struct block_device {
+    char name[BLOCK_NAME_MAX];      /* "hda", "ram0"... */
+    uint64_t sectors;               /* Capacity */
+    uint32_t max_sectors;           /* Largest request the driver takes */
+    uint32_t max_segs;              /* Most segments per request */
+    uint32_t queue_depth;           /* Requests the driver keeps in flight */
+    bool polled;                    /* No completion interrupt: waiters poll */
+    uint32_t major;
+    uint32_t minor;
+    const block_ops_t* ops;
+    void* priv;                     /* Driver state */
+
+    /* Queue state (block layer) */
+    block_sched_t* sched;
+    void* sched_data;
+    uint32_t plugged;
+    uint32_t queued;                /* Requests held by the scheduler */
+    uint32_t inflight;
+    bool dispatching;
+    request_t* retry;               /* Refused by the driver, goes first */
+    wait_queue_t wait;              /* Bio waiters */
+    block_stats_t stats;
+
+    struct block_device* next;
+} block_device_t;
+
+/**
+ * Set up a device's queue (scheduler "noop" until changed)
+ * Called by block_register(); also usable for private devices.
+ */
+void block_device_init(block_device_t* dev);
+
+/**
+ * Add a device to the registry and create /dev/<name>
+ * @return 0 on success, -1 if the name is taken
+ */
+int block_register(block_device_t* dev);
+
+/* Find a registered device by name (with or without "/dev/") */
+block_device_t* block_find(const char* name);
+
+/* Walk the registry (NULL starts, returns NULL at the end) */
+block_device_t* block_next(block_device_t* dev);
+
+/* Schedulers */
+void block_register_sched(block_sched_t* sched);
+int block_set_sched(block_device_t* dev, const char* name);
+
+/* For schedulers: may 'bio' join 'req' at its back (or front)? */
+bool block_can_merge(request_t* req, bio_t* bio, int front);
+
+/* Bios from the block layer's cache (zeroed) */
+bio_t* bio_alloc(void);
+void bio_free(bio_t* bio);
+
+/* Sectors covered by a bio */
+uint32_t bio_sectors(bio_t* bio);
+
+/**
+ * Queue a bio. It completes asynchronously: bio->done is set and
+ * bio->end called; block_wait() sleeps until then.
+ */
+void block_submit(bio_t* bio);
+void block_wait(bio_t* bio);
+
+/* Hold dispatch so that queued bios can merge, then release it */
+void block_plug(block_device_t* dev);
+void block_unplug(block_device_t* dev);
+
+/* Driver: a request finished (status 0 or -1) */
+void block_complete(request_t* req, int status);
+
+/**
+ * Synchronous transfers of whole sectors
+ * @return 0 on success, -1 on error or out-of-range sectors
+ */
+int block_read(block_device_t* dev, uint64_t sector, void* buf, uint32_t count);
+int block_write(block_device_t* dev, uint64_t sector, const void* buf, uint32_t count);
+int block_flush(block_device_t* dev);
+
+/**
+ * Borrow the device's own frame for the page-aligned page at 'sector'
+ * (memory-backed devices only), with a reference for the caller. Queued
+ * I/O is drained first so the frame is current.
+ * @return 0, or -1 if the device cannot share
+ */
+int block_share_page(block_device_t* dev, uint64_t sector, uint32_t* frame);
+
+/* Initialize the block layer and its built-in schedulers */
+void block_init(void);
+
+#endif /* _CLAUDEOS_BLOCK_H */
@@ -0,0 +1,116 @@
+/**
+ * ClaudeOS Futexes - futex.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Fast user-level locking (futex) and the mutex/condition
+ *              variable built on it
+ */
+
+#ifndef _CLAUDEOS_FUTEX_H
+#define _CLAUDEOS_FUTEX_H
+
+#include "types.h"
+
+/* SYS_FUTEX operations */
+#define FUTEX_WAIT      0   /* Sleep if *uaddr == val */
+#define FUTEX_WAKE      1   /* Wake up to val waiters */
+
+/* Number of hash buckets for waiters (power of two) */
+#define FUTEX_HASH_BITS 6
+#define FUTEX_HASH_SIZE (1 << FUTEX_HASH_BITS)
+
+/**
+ * Initialize the futex wait buckets
+ */
+void futex_init(void);
+
+/**
+ * Sleep until woken, if the word at uaddr still holds val
+ *
+ * Waiters are keyed on the physical page and offset of uaddr, so two
+ * mappings of the same shared page wait on the same futex.
+ *
+ * @param uaddr Futex word (4-byte aligned)
+ * @param val Expected value
+ * @return 0 when woken, SYSCALL_EAGAIN if *uaddr != val, or an error code
+ */
+int32_t futex_wait(volatile uint32_t* uaddr, uint32_t val);
+
+/**
+ * Wake processes waiting on a futex word
+ * @param uaddr Futex word
+ * @param count Maximum number of waiters to wake
+ * @return Number of processes woken, or an error code
+ */
+int32_t futex_wake(volatile uint32_t* uaddr, int32_t count);
+
+/*
+ * ===========================================================================
+ * Mutex and condition variable
+ *
+ * Both only enter the kernel when there is contention: locking a free
+ * mutex, unlocking one nobody waits on, and signalling a condition with
+ * no waiters are a single atomic instruction each.
+ * ===========================================================================
+ */
+
+/* 0 = unlocked, 1 = locked, 2 = locked with (possible) waiters */
+typedef struct {
+    volatile uint32_t state;
+} futex_mutex_t;
+
+typedef struct {
+    volatile uint32_t seq;      /* Bumped by every signal/broadcast */
+    volatile uint32_t waiters;  /* Processes inside futex_cond_wait() */
+} futex_cond_t;
+
+#define FUTEX_MUTEX_INIT    { 0 }
+#define FUTEX_COND_INIT     { 0, 0 }
+
+static inline void futex_mutex_lock(futex_mutex_t* m) {
+    uint32_t c = __sync_val_compare_and_swap(&m->state, 0, 1);
+    if (c == 0) {
+        return;
+    }
+    do {
+        /* Mark contended, then sleep while someone else holds it */
+        if (c == 2 || __sync_val_compare_and_swap(&m->state, 1, 2) != 0) {
+            futex_wait(&m->state, 2);
+        }
+    } while ((c = __sync_val_compare_and_swap(&m->state, 0, 2)) != 0);
+}
+
+static inline bool futex_mutex_trylock(futex_mutex_t* m) {
+    return __sync_val_compare_and_swap(&m->state, 0, 1) == 0;
+}
+
+static inline void futex_mutex_unlock(futex_mutex_t* m) {
+    if (__sync_fetch_and_sub(&m->state, 1) != 1) {
+        m->state = 0;
+        futex_wake(&m->state, 1);
+    }
+}
+
+static inline void futex_cond_wait(futex_cond_t* c, futex_mutex_t* m) {
+    uint32_t seq = c->seq;
+    __sync_fetch_and_add(&c->waiters, 1);
+    futex_mutex_unlock(m);
+    futex_wait(&c->seq, seq);
+    __sync_fetch_and_sub(&c->waiters, 1);
+    futex_mutex_lock(m);
+}
+
+static inline void futex_cond_signal(futex_cond_t* c) {
+    if (c->waiters) {
+        __sync_fetch_and_add(&c->seq, 1);
+        futex_wake(&c->seq, 1);
+    }
+}
+
+static inline void futex_cond_broadcast(futex_cond_t* c) {
+    if (c->waiters) {
+        __sync_fetch_and_add(&c->seq, 1);
+        futex_wake(&c->seq, 0x7FFFFFFF);
+    }
+}
+
+#endif /* _CLAUDEOS_FUTEX_H */
@@ -81,4 +81,18 @@ void idt_set_gate(uint8_t num, uint32_t base, uint16_t selector, uint8_t flags);
 typedef void (*interrupt_handler_t)(void);
 void register_interrupt_handler(uint8_t num, interrupt_handler_t handler);
 
+/* Disable interrupts, returning the previous EFLAGS for irq_restore() */
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushf\n\tpop %0\n\tcli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+/* Re-enable interrupts if they were enabled when irq_save() was called */
+static inline void irq_restore(uint32_t flags) {
+    if (flags & 0x200) {
+        __asm__ volatile ("sti" : : : "memory");
+    }
+}
+
 #endif /* _CLAUDEOS_IDT_H */
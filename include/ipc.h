@@ -0,0 +1,88 @@
+/**
+ * ClaudeOS IPC - ipc.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Synchronous message passing between processes
+ *
+ * L4-style rendezvous IPC: a send blocks until the receiver takes the
+ * message, a call is a send followed by waiting for the reply, and the
+ * message is copied straight from the sender's buffer into the
+ * receiver's with no kernel buffering in between. When the partner is
+ * already waiting, the kernel switches to it directly and donates the
+ * rest of the time slice instead of going through the run queue.
+ */
+
+#ifndef _CLAUDEOS_IPC_H
+#define _CLAUDEOS_IPC_H
+
+#include "types.h"
+
+/* Inline message words (the "message registers") */
+#define IPC_MSG_WORDS   4
+
+/* Per-process IPC states */
+#define IPC_IDLE        0
+#define IPC_SENDING     1   /* Queued on the receiver, plain send */
+#define IPC_CALLING     2   /* Queued on the receiver, wants a reply */
+#define IPC_RECEIVING   3   /* Blocked in ipc_recv() */
+#define IPC_REPLY_WAIT  4   /* Call delivered, waiting for the reply */
+
+/*
+ * A message. Small messages fit entirely in 'label' and 'words'. A bulk
+ * payload in 'buf' is copied once, directly into the receiver's 'buf';
+ * on receive 'len' is the buffer capacity and is set to the bytes
+ * actually delivered.
+ */
+typedef struct ipc_msg {
+    uint32_t label;                 /* Message type / opcode */
+    uint32_t words[IPC_MSG_WORDS];  /* Inline payload */
+    void* buf;                      /* Optional bulk payload */
+    uint32_t len;                   /* Bulk length / receive capacity */
+} ipc_msg_t;
+
+struct process;
+
+/**
+ * Reset a process's IPC state (called when a slot is set up)
+ */
+void ipc_process_init(struct process* proc);
+
+/**
+ * Fail every IPC partner blocked on a process (called on exit)
+ */
+void ipc_release(struct process* proc);
+
+/**
+ * Send a message, blocking until the receiver has taken it
+ * @param dest Receiver PID
+ * @param msg Message to send
+ * @return 0 on success, or a negative SYSCALL_E* code
+ */
+int32_t ipc_send(uint32_t dest, ipc_msg_t* msg);
+
+/**
+ * Receive a message
+ * @param from Sender PID to accept, or 0 for any sender
+ * @param msg Receive buffer (set buf/len to accept a bulk payload)
+ * @return Sender PID, or a negative SYSCALL_E* code
+ */
+int32_t ipc_recv(uint32_t from, ipc_msg_t* msg);
+
+/**
+ * Send a message and wait for the reply
+ * The reply is received into 'msg'.
+ * @param dest Server PID
+ * @param msg Request on entry, reply on return
+ * @return 0 on success, or a negative SYSCALL_E* code
+ */
+int32_t ipc_call(uint32_t dest, ipc_msg_t* msg);
+
+/**
+ * Reply to a process blocked in ipc_call() on us
+ * Switches straight back to the caller.
+ * @param to Caller PID (as returned by ipc_recv())
+ * @param msg Reply message
+ * @return 0 on success, or a negative SYSCALL_E* code
+ */
+int32_t ipc_reply(uint32_t to, ipc_msg_t* msg);
+
+#endif /* _CLAUDEOS_IPC_H */
@@ -8,6 +8,7 @@
 #define _CLAUDEOS_KEYBOARD_H
 
 #include "types.h"
+#include "process.h"
 
 /* Keyboard I/O ports */
 #define KB_DATA_PORT    0x60
@@ -62,4 +63,7 @@ char keyboard_getchar(void);
 /* Check if a key is available */
 bool keyboard_haschar(void);
 
+/* Wait queue woken on every keystroke (for blocking reads and poll) */
+wait_queue_t* keyboard_wait_queue(void);
+
 #endif /* _CLAUDEOS_KEYBOARD_H */
@@ -0,0 +1,105 @@
+/**
+ * ClaudeOS Memory Mapping - mman.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: mmap/munmap/mprotect for files and anonymous memory
+ */
+
+#ifndef _CLAUDEOS_MMAN_H
+#define _CLAUDEOS_MMAN_H
+
+#include "types.h"
+
+/* Protection bits */
+#define PROT_NONE       0x0
+#define PROT_READ       0x1
+#define PROT_WRITE      0x2
+#define PROT_EXEC       0x4
+
+/* Mapping flags */
+#define MAP_SHARED      0x01    /* Writes go straight to the file's pages */
+#define MAP_PRIVATE     0x02    /* Copy-on-write private mapping */
+#define MAP_ANONYMOUS   0x20    /* Zero-filled memory, no file */
+
+/* Maximum number of mapped regions system-wide */
+#define MAX_VM_AREAS    256
+
+struct fs_node;
+struct process;
+
+/* A mapped region of the mmap window */
+typedef struct vm_area {
+    uint32_t start;             /* First byte (page aligned) */
+    uint32_t end;               /* One past the last byte (page aligned) */
+    int prot;                   /* PROT_* */
+    int flags;                  /* MAP_* */
+    struct fs_node* node;       /* Backing file (NULL if anonymous) */
+    uint32_t pgoff;             /* File page mapped at 'start' */
+    struct process* owner;      /* Process that created the mapping */
+    struct vm_area* next;       /* Next area (sorted by start) */
+} vm_area_t;
+
+/* Argument block for SYS_MMAP (too many arguments for registers) */
+typedef struct {
+    uint32_t addr;
+    uint32_t length;
+    int32_t  prot;
+    int32_t  flags;
+    int32_t  fd;
+    uint32_t offset;
+} mmap_args_t;
+
+/**
+ * Initialize the mmap subsystem and install the page fault resolver
+ */
+void mmap_init(void);
+
+/**
+ * Map a file or anonymous memory into the current process
+ * Pages are populated lazily on first access.
+ * @param addr Preferred address (0 = any; used only if the range is free)
+ * @param length Length in bytes (rounded up to whole pages)
+ * @param prot PROT_* protection
+ * @param flags MAP_SHARED or MAP_PRIVATE, optionally MAP_ANONYMOUS
+ * @param fd File descriptor (ignored for MAP_ANONYMOUS)
+ * @param offset File offset (must be page aligned)
+ * @return Mapped address, or a negative SYSCALL_E* code
+ */
+int32_t mmap_map(uint32_t addr, uint32_t length, int prot, int flags, int fd, uint32_t offset);
+
+/**
+ * Map a node directly (kernel objects such as shared memory segments)
+ * @param node Node to map, or NULL for anonymous memory
+ * Other parameters and return value as for mmap_map()
+ */
+int32_t mmap_map_node(uint32_t addr, uint32_t length, int prot, int flags,
+                      struct fs_node* node, uint32_t offset);
+
+/**
+ * Remove mappings in [addr, addr+length), splitting areas as needed
+ * @return 0 on success, negative SYSCALL_E* code on failure
+ */
+int32_t mmap_unmap(uint32_t addr, uint32_t length);
+
+/**
+ * Change protection of mappings in [addr, addr+length)
+ * @return 0 on success, negative SYSCALL_E* code on failure
+ */
+int32_t mmap_protect(uint32_t addr, uint32_t length, int prot);
+
+/**
+ * Tear down every mapping owned by a process (called on exit)
+ */
+void mmap_release(struct process* proc);
+
+/**
+ * Find the area containing an address
+ * @return The area, or NULL if the address is not mapped
+ */
+vm_area_t* mmap_lookup(uint32_t addr);
+
+/**
+ * Check whether a node is mapped anywhere
+ */
+bool mmap_node_mapped(struct fs_node* node);
+
+#endif /* _CLAUDEOS_MMAN_H */
@@ -0,0 +1,92 @@
+/**
+ * ClaudeOS NVMe Driver - nvme.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: NVMe controllers and namespaces under the block layer
+ *
+ * The controller is brought up through its admin queue (IDENTIFY, queue
+ * creation), then every namespace shares the I/O submission/completion
+ * queue pairs - one per CPU, which on ClaudeOS means one. Requests are
+ * written into the submission queue as they are dispatched and the tail
+ * doorbell is rung once per dispatch pass. Completions are reaped from
+ * the interrupt handler or, in polled mode, by the waiting thread.
+ */
+
+#ifndef _CLAUDEOS_NVME_H
+#define _CLAUDEOS_NVME_H
+
+#include "types.h"
+#include "block.h"
+
+/* Controller registers */
+#define NVME_REG_CAP        0x00    /* 64-bit */
+#define NVME_REG_VS         0x08
+#define NVME_REG_INTMS      0x0C
+#define NVME_REG_INTMC      0x10
+#define NVME_REG_CC         0x14
+#define NVME_REG_CSTS       0x1C
+#define NVME_REG_AQA        0x24
+#define NVME_REG_ASQ        0x28    /* 64-bit */
+#define NVME_REG_ACQ        0x30    /* 64-bit */
+#define NVME_REG_DOORBELL   0x1000
+
+#define NVME_CC_EN          (1u << 0)
+#define NVME_CC_IOSQES      (6u << 16)  /* 64-byte submission entries */
+#define NVME_CC_IOCQES      (4u << 20)  /* 16-byte completion entries */
+#define NVME_CSTS_RDY       (1u << 0)
+#define NVME_CSTS_CFS       (1u << 1)
+
+/* Admin commands */
+#define NVME_ADMIN_CREATE_SQ    0x01
+#define NVME_ADMIN_CREATE_CQ    0x05
+#define NVME_ADMIN_IDENTIFY     0x06
+#define NVME_ADMIN_SET_FEATURES 0x09
+
+#define NVME_FEAT_NUM_QUEUES    0x07
+#define NVME_CNS_NAMESPACE      0
+#define NVME_CNS_CONTROLLER     1
+
+/* I/O commands */
+#define NVME_CMD_FLUSH      0x00
+#define NVME_CMD_WRITE      0x01
+#define NVME_CMD_READ       0x02
+
+/* Submission queue entry */
+typedef struct {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t cid;
+    uint32_t nsid;
+    uint64_t reserved;
+    uint64_t mptr;
+    uint64_t prp1;
+    uint64_t prp2;
+    uint32_t cdw10;
+    uint32_t cdw11;
+    uint32_t cdw12;
+    uint32_t cdw13;
+    uint32_t cdw14;
+    uint32_t cdw15;
+} __attribute__((packed)) nvme_sqe_t;
+
+/* Completion queue entry */
+typedef struct {
+    uint32_t result;
+    uint32_t reserved;
+    uint16_t sq_head;
+    uint16_t sq_id;
+    uint16_t cid;
+    uint16_t status;                /* Bit 0 is the phase tag */
+} __attribute__((packed)) nvme_cqe_t;
+
+/* Probe NVMe controllers and register their namespaces (nvme0n1...) */
+void nvme_init(void);
+
+/**
+ * Switch a namespace's controller between interrupt-driven and polled
+ * completion. Polled waiters spin reaping the completion queue instead
+ * of sleeping, trading CPU for latency.
+ * @return 0, or -1 if the device is not an NVMe namespace
+ */
+int nvme_set_polled(block_device_t* dev, bool polled);
+
+#endif /* _CLAUDEOS_NVME_H */
@@ -0,0 +1,70 @@
+/**
+ * ClaudeOS Paging - paging.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: x86 two-level paging, identity map and mapping primitives
+ *
+ * ClaudeOS runs every process in one shared kernel address space. The
+ * low 32MB (kernel, heap and page frame pool) is identity mapped so that
+ * physical and virtual addresses are interchangeable there; the window
+ * at MMAP_BASE..MMAP_END is handed out page by page by mmap().
+ */
+
+#ifndef _CLAUDEOS_PAGING_H
+#define _CLAUDEOS_PAGING_H
+
+#include "types.h"
+
+/* Page table entry flags */
+#define PTE_PRESENT     0x001
+#define PTE_WRITABLE    0x002
+#define PTE_USER        0x004
+#define PTE_PWT         0x008   /* Write-through */
+#define PTE_PCD         0x010   /* Cache disable */
+#define PTE_ACCESSED    0x020
+#define PTE_DIRTY       0x040
+#define PTE_COW         0x200   /* Software bit: copy-on-write page */
+#define PTE_FRAME       0xFFFFF000
+
+/* Identity-mapped region */
+#define PAGING_IDENTITY_END 0x2000000   /* 32MB */
+
+/* Virtual window used for mmap() */
+#define MMAP_BASE       0x40000000
+#define MMAP_END        0x80000000
+
+/* Initialize paging: build the identity map and enable CR0.PG/WP */
+void paging_init(void);
+
+/**
+ * Map a single page
+ * @param virt Page-aligned virtual address
+ * @param phys Page-aligned physical address
+ * @param flags PTE_* flags (PTE_PRESENT is implied)
+ * @return 0 on success, -1 if a page table could not be allocated
+ */
+int paging_map(uint32_t virt, uint32_t phys, uint32_t flags);
+
+/**
+ * Unmap a single page
+ * @return The previous page table entry (0 if nothing was mapped)
+ */
+uint32_t paging_unmap(uint32_t virt);
+
+/* Get the page table entry for a virtual address (0 if unmapped) */
+uint32_t paging_get_pte(uint32_t virt);
+
+/**
+ * Replace the flags of an existing entry, keeping its frame
+ * Passing flags without PTE_PRESENT parks the frame in a non-present
+ * entry (used by mprotect(PROT_NONE)); paging_unmap() still returns it.
+ */
+void paging_set_flags(uint32_t virt, uint32_t flags);
+
+/* Identity map a device register window (uncached) */
+int paging_map_mmio(uint32_t phys, uint32_t size);
+
+/* Page fault handler hook (installed by mmap) */
+typedef int (*page_fault_handler_t)(uint32_t fault_addr, bool present);
+void paging_set_fault_handler(page_fault_handler_t handler);
+
+#endif /* _CLAUDEOS_PAGING_H */
@@ -0,0 +1,99 @@
+/**
+ * ClaudeOS PCI Bus - pci.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: PCI configuration space access and device enumeration
+ *
+ * Uses configuration mechanism #1 (ports 0xCF8/0xCFC). The bus is
+ * scanned once at boot; drivers then look devices up by class or ID.
+ */
+
+#ifndef _CLAUDEOS_PCI_H
+#define _CLAUDEOS_PCI_H
+
+#include "types.h"
+
+#define PCI_CONFIG_ADDRESS  0xCF8
+#define PCI_CONFIG_DATA     0xCFC
+#define PCI_MAX_DEVICES     32
+
+/* Configuration space registers */
+#define PCI_VENDOR_ID       0x00
+#define PCI_DEVICE_ID       0x02
+#define PCI_COMMAND         0x04
+#define PCI_STATUS          0x06
+#define PCI_PROG_IF         0x09
+#define PCI_SUBCLASS        0x0A
+#define PCI_CLASS           0x0B
+#define PCI_HEADER_TYPE     0x0E
+#define PCI_BAR0            0x10
+#define PCI_SUBSYSTEM_ID    0x2E
+#define PCI_CAP_PTR         0x34
+#define PCI_INTERRUPT_LINE  0x3C
+
+/* Command register bits */
+#define PCI_CMD_IO          0x0001
+#define PCI_CMD_MEMORY      0x0002
+#define PCI_CMD_BUS_MASTER  0x0004
+#define PCI_CMD_INTX_OFF    0x0400
+
+#define PCI_STATUS_CAP_LIST 0x0010
+
+/* Classes used by the storage drivers */
+#define PCI_CLASS_STORAGE   0x01
+#define PCI_SUBCLASS_IDE    0x01
+#define PCI_SUBCLASS_SATA   0x06
+#define PCI_SUBCLASS_NVM    0x08
+
+typedef struct {
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t func;
+    uint8_t irq;                    /* Interrupt line (legacy PIC) */
+    uint16_t vendor;
+    uint16_t device;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+    uint32_t bar[6];                /* Raw BAR values */
+} pci_device_t;
+
+/* Raw configuration space access */
+uint32_t pci_read32(pci_device_t* dev, uint8_t offset);
+uint16_t pci_read16(pci_device_t* dev, uint8_t offset);
+uint8_t pci_read8(pci_device_t* dev, uint8_t offset);
+void pci_write32(pci_device_t* dev, uint8_t offset, uint32_t value);
+void pci_write16(pci_device_t* dev, uint8_t offset, uint16_t value);
+
+/**
+ * Base address of a BAR, with the type bits masked off
+ * @return I/O port or physical memory address (0 if unset)
+ */
+uint32_t pci_bar_addr(pci_device_t* dev, int bar);
+bool pci_bar_is_io(pci_device_t* dev, int bar);
+
+/* Turn on I/O and memory decoding and bus mastering (DMA) */
+void pci_enable(pci_device_t* dev);
+
+/**
+ * Find a device by class (0xFF subclass matches any)
+ * @param prev Previous match to continue from, or NULL
+ */
+pci_device_t* pci_find_class(uint8_t class_code, uint8_t subclass, pci_device_t* prev);
+
+/* Find a device by vendor and device ID (0xFFFF device matches any) */
+pci_device_t* pci_find_id(uint16_t vendor, uint16_t device, pci_device_t* prev);
+
+/**
+ * Offset of a capability in the device's capability list
+ * @param start 0, or a previous result to find the next one of that ID
+ * @return Offset, or 0 if not found
+ */
+uint8_t pci_find_capability(pci_device_t* dev, uint8_t id, uint8_t start);
+
+/* Walk every device found (NULL starts, returns NULL at the end) */
+pci_device_t* pci_next(pci_device_t* prev);
+
+/* Scan the bus */
+void pci_init(void);
+
+#endif /* _CLAUDEOS_PCI_H */
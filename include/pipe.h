@@ -0,0 +1,32 @@
+/**
+ * ClaudeOS Pipes - pipe.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Kernel pipe objects (page-sized ring buffer)
+ */
+
+#ifndef _CLAUDEOS_PIPE_H
+#define _CLAUDEOS_PIPE_H
+
+#include "types.h"
+
+/* Pipe capacity (one page frame) */
+#define PIPE_BUF_SIZE   4096
+
+struct fs_node;
+
+/**
+ * Create a pipe
+ *
+ * Each end is an fs_node_t driven through the normal VFS calls. Opening
+ * an end (vfs_open_node, dup2, stdio redirection) takes a reference and
+ * closing it drops one. Readers block while the pipe is empty and see
+ * EOF (0) once every write end is closed; writers block while it is full
+ * and get -1 once every read end is closed.
+ *
+ * @param read_end Receives the read end node
+ * @param write_end Receives the write end node
+ * @return 0 on success, -1 if out of memory
+ */
+int pipe_create(struct fs_node** read_end, struct fs_node** write_end);
+
+#endif /* _CLAUDEOS_PIPE_H */
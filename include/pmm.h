@@ -0,0 +1,63 @@
+/**
+ * ClaudeOS Physical Memory Manager - pmm.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Reference-counted page frame allocator
+ */
+
+#ifndef _CLAUDEOS_PMM_H
+#define _CLAUDEOS_PMM_H
+
+#include "types.h"
+
+/* Page geometry */
+#define PAGE_SIZE       4096
+#define PAGE_SHIFT      12
+#define PAGE_MASK       (~(PAGE_SIZE - 1))
+#define PAGE_ALIGN(x)   (((x) + PAGE_SIZE - 1) & PAGE_MASK)
+
+/* Page frame pool (sits above the kmalloc heap, below the paging limit) */
+#define PMM_POOL_START  0x800000    /* 8MB mark */
+#define PMM_POOL_END    0x2000000   /* 32MB mark */
+#define PMM_POOL_PAGES  ((PMM_POOL_END - PMM_POOL_START) / PAGE_SIZE)
+
+/* Initialize the page frame allocator */
+void pmm_init(void);
+
+/**
+ * Allocate a single page frame
+ * @return Physical address of the frame (refcount 1), or 0 if out of memory
+ */
+uint32_t pmm_alloc_page(void);
+
+/**
+ * Allocate physically contiguous page frames
+ * @param count Number of pages
+ * @return Physical address of the first frame, or 0 if no run is available
+ */
+uint32_t pmm_alloc_pages(uint32_t count);
+
+/**
+ * Free a run of frames obtained from pmm_alloc_pages()
+ * Drops one reference on each frame
+ */
+void pmm_free_pages(uint32_t addr, uint32_t count);
+
+/* Take/drop a reference on a frame (frame is freed when it reaches 0) */
+void pmm_ref_page(uint32_t addr);
+void pmm_unref_page(uint32_t addr);
+
+/* Get the reference count of a frame (0 = free) */
+uint16_t pmm_page_refcount(uint32_t addr);
+
+/* Check whether an address lies inside the frame pool */
+bool pmm_owns(uint32_t addr);
+
+/* Fill a frame with zeroes / copy one frame to another */
+void pmm_zero_page(uint32_t addr);
+void pmm_copy_page(uint32_t dst, uint32_t src);
+
+/* Pool statistics (in pages) */
+uint32_t pmm_free_count(void);
+uint32_t pmm_used_count(void);
+
+#endif /* _CLAUDEOS_PMM_H */
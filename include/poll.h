@@ -0,0 +1,136 @@
+/**
+ * ClaudeOS Readiness Polling - poll.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: poll() and epoll-style interest sets over file descriptors
+ *
+ * Pollable objects implement fs_ops_t.poll: it returns the current
+ * readiness mask and calls poll_wait() for every wait queue that is
+ * woken when that readiness may change. poll() uses this to sleep on
+ * all sources at once; epoll keeps the registrations across calls and
+ * collects only the sources that signalled into a ready list.
+ */
+
+#ifndef _CLAUDEOS_POLL_H
+#define _CLAUDEOS_POLL_H
+
+#include "types.h"
+#include "process.h"
+
+/* Readiness events */
+#define POLLIN      0x001   /* Data to read */
+#define POLLOUT     0x004   /* Writing will not block */
+#define POLLERR     0x008   /* Error condition */
+#define POLLHUP     0x010   /* Peer closed */
+#define POLLNVAL    0x020   /* Not an open descriptor */
+
+/* epoll event flags (share the POLL* bits) */
+#define EPOLLIN     POLLIN
+#define EPOLLOUT    POLLOUT
+#define EPOLLERR    POLLERR
+#define EPOLLHUP    POLLHUP
+#define EPOLLET     0x80000000  /* Edge-triggered */
+
+/* epoll_ctl operations */
+#define EPOLL_CTL_ADD   1
+#define EPOLL_CTL_DEL   2
+#define EPOLL_CTL_MOD   3
+
+/* Limits */
+#define POLL_MAX_FDS        32      /* Descriptors per poll() call */
+#define POLL_MAX_WAITS      64      /* Wait queues per poll() call */
+#define EPOLL_MAX_INSTANCES 16
+#define EPOLL_MAX_ITEMS     128     /* Registered descriptors, system-wide */
+#define EPOLL_ITEM_WAITS    2       /* Wait queues per registered descriptor */
+
+typedef struct {
+    int32_t fd;
+    int16_t events;             /* Requested POLL* events */
+    int16_t revents;            /* Returned POLL* events */
+} pollfd_t;
+
+typedef struct {
+    uint32_t events;            /* EPOLL* events */
+    uint32_t data;              /* Caller's cookie, returned as-is */
+} epoll_event_t;
+
+/* Argument blocks for the epoll syscalls (more than three arguments) */
+typedef struct {
+    int32_t epfd;
+    int32_t op;
+    int32_t fd;
+    epoll_event_t* event;
+} epoll_ctl_args_t;
+
+typedef struct {
+    int32_t epfd;
+    epoll_event_t* events;
+    int32_t max_events;
+    int32_t timeout_ms;         /* -1 = forever, 0 = don't block */
+} epoll_wait_args_t;
+
+/*
+ * Passed to fs_ops_t.poll. 'queue' registers a wait queue; it is NULL
+ * when the caller only wants the current readiness mask.
+ */
+typedef struct poll_table {
+    void (*queue)(struct poll_table* pt, wait_queue_t* wq);
+    void* priv;
+} poll_table_t;
+
+/* Register a wait queue with a poll table (for fs_ops_t.poll) */
+static inline void poll_wait(poll_table_t* pt, wait_queue_t* wq) {
+    if (pt && pt->queue && wq) {
+        pt->queue(pt, wq);
+    }
+}
+
+/* Watchers registered by one poll() call */
+typedef struct poll_wait_set {
+    wait_queue_t* queues[POLL_MAX_WAITS];
+    wait_entry_t entries[POLL_MAX_WAITS];
+    uint32_t count;
+} poll_wait_set_t;
+
+/**
+ * Remove every watcher of a poll() call from its wait queue
+ */
+void poll_set_release(poll_wait_set_t* set);
+
+/**
+ * Wait for readiness on a set of descriptors
+ * @param fds Descriptors and requested events; revents is filled in
+ * @param nfds Number of entries (at most POLL_MAX_FDS)
+ * @param timeout_ms -1 = forever, 0 = don't block
+ * @return Number of descriptors with events, 0 on timeout, or error code
+ */
+int32_t poll_fds(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms);
+
+/**
+ * Create an epoll instance
+ * @return Descriptor, or error code
+ */
+int32_t epoll_create(void);
+
+/**
+ * Add, modify or remove a descriptor in an interest set
+ * @return 0 on success, or error code
+ */
+int32_t epoll_ctl(int32_t epfd, int32_t op, int32_t fd, epoll_event_t* event);
+
+/**
+ * Wait for events on an interest set
+ * Only descriptors that signalled since the last call are examined, so
+ * the cost is proportional to the number of ready descriptors.
+ * @return Number of events stored, 0 on timeout, or error code
+ */
+int32_t epoll_wait(int32_t epfd, epoll_event_t* events, int32_t max_events, int32_t timeout_ms);
+
+struct file;
+
+/**
+ * Drop an open file description from every interest set
+ * Called when its last descriptor, in any process, is closed.
+ */
+void epoll_file_closed(struct file* file);
+
+#endif /* _CLAUDEOS_POLL_H */
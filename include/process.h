@@ -12,8 +12,8 @@
 /* Maximum number of processes */
 #define MAX_PROCESSES   64
 
-/* Process stack size (4KB) */
-#define PROCESS_STACK_SIZE  4096
+/* Process stack size (16KB, allocated from the page frame pool) */
+#define PROCESS_STACK_SIZE  16384
 
 /* Process states */
 typedef enum {
@@ -53,6 +53,28 @@ typedef struct {
     uint32_t ss;            /* Only present on privilege change */
 } __attribute__((packed)) cpu_registers_t;
 
+struct process;
+struct fs_node;
+struct poll_wait_set;
+
+/*
+ * Wait queue entry. A sleeper's entry lives on its stack and is removed
+ * when it is woken. An entry with a 'notify' callback is a persistent
+ * watcher (poll/epoll): wakeups call it and leave it queued.
+ */
+typedef struct wait_entry {
+    struct process* proc;           /* Sleeping process */
+    uint32_t key;                   /* Wait key (0 unless keyed sleep) */
+    void (*notify)(struct wait_entry* entry);  /* Watcher callback */
+    void* priv;                     /* Watcher data */
+    struct wait_entry* next;
+} wait_entry_t;
+
+/* Queue of processes blocked on an event */
+typedef struct {
+    wait_entry_t* head;
+} wait_queue_t;
+
 /* Process control block (PCB) */
 typedef struct process {
     uint32_t pid;                   /* Process ID */
@@ -80,6 +102,26 @@ typedef struct process {
 
     /* Entry point for new processes */
     void (*entry)(void);            /* Process entry function */
+    void* arg;                      /* Argument for the entry function */
+
+    /* Blocking */
+    wait_queue_t* blocked_on;       /* Queue we are sleeping on (if any) */
+    wait_entry_t* wait_entry;       /* Our entry in that queue */
+    wait_queue_t exit_wait;         /* Processes waiting for us to exit */
+
+    /* Open file descriptors (see vfs.h; NULL = the kernel's table) */
+    struct fd_table* files;
+    struct fs_node* cwd;            /* Working directory (NULL = root) */
+
+    /* Watchers registered by a poll() in progress */
+    struct poll_wait_set* poll_set;
+
+    /* Synchronous IPC (see ipc.h) */
+    uint32_t ipc_state;             /* IPC_IDLE, IPC_SENDING, ... */
+    uint32_t ipc_peer;              /* Partner PID (0 = any sender) */
+    struct ipc_msg* ipc_msg;        /* Message being sent / receive buffer */
+    int32_t ipc_result;             /* Outcome reported to a woken party */
+    wait_queue_t ipc_senders;       /* Senders waiting for us to receive */
 } process_t;
 
 /* Process entry point function type */
@@ -99,6 +141,25 @@ void process_init(void);
  */
 int32_t process_create(const char* name, process_entry_t entry, process_priority_t priority);
 
+/**
+ * Create a new process with an argument
+ * The entry function can fetch the argument via process_current()->arg.
+ * @param name Process name (for identification)
+ * @param entry Entry point function
+ * @param priority Process priority
+ * @param arg Argument for the entry function
+ * @return Process ID, or -1 on failure
+ */
+int32_t process_create_arg(const char* name, process_entry_t entry,
+                           process_priority_t priority, void* arg);
+
+/**
+ * Wait for a process to exit and reclaim its slot
+ * @param pid Process ID to wait for
+ * @return Exit code of the process, or -1 if no such process
+ */
+int32_t process_wait(uint32_t pid);
+
 /**
  * Exit the current process
  * @param exit_code Exit status code
@@ -129,6 +190,19 @@ void process_sleep(uint32_t ms);
  */
 void process_block(void);
 
+/**
+ * Block current process until woken or a timeout expires
+ * @param ms Timeout in milliseconds
+ * @return true if woken before the timeout, false if it expired
+ */
+bool process_block_timeout(uint32_t ms);
+
+/**
+ * Make a blocked (or timed-blocked) process runnable
+ * @param proc Process to wake
+ */
+void process_wake(process_t* proc);
+
 /**
  * Unblock a process (make it ready)
  * @param pid Process ID to unblock
@@ -148,6 +222,15 @@ int32_t process_kill(uint32_t pid);
  */
 void schedule(void);
 
+/**
+ * Switch directly to another process, bypassing the run queue
+ * The rest of the current time slice is donated to 'next'. Call with
+ * interrupts disabled, after making 'next' READY and setting the state
+ * the current process should be left in (a RUNNING caller becomes READY).
+ * @param next Process to run
+ */
+void process_handoff(process_t* next);
+
 /**
  * Yield CPU to next process
  * Voluntary context switch
@@ -175,4 +258,60 @@ uint32_t process_list(uint32_t* pids, uint32_t max_count);
  */
 const char* process_state_name(process_state_t state);
 
+/**
+ * Initialize a wait queue
+ */
+void wait_queue_init(wait_queue_t* wq);
+
+/**
+ * Block the current process on a wait queue until woken
+ * Call with interrupts disabled, after testing the wait condition, so a
+ * wakeup cannot slip in between the test and going to sleep.
+ * @param wq Wait queue to sleep on
+ */
+void wait_queue_sleep(wait_queue_t* wq);
+
+/**
+ * Like wait_queue_sleep(), tagging the entry with a key so that several
+ * unrelated events can share one queue (e.g. a futex hash bucket)
+ * @param wq Wait queue to sleep on
+ * @param key Key matched by wait_queue_wake_key()
+ */
+void wait_queue_sleep_key(wait_queue_t* wq, uint32_t key);
+
+/**
+ * Like wait_queue_sleep(), giving up after a timeout
+ * @param wq Wait queue to sleep on
+ * @param ms Timeout in milliseconds
+ * @return true if woken, false if the timeout expired
+ */
+bool wait_queue_sleep_timeout(wait_queue_t* wq, uint32_t ms);
+
+/**
+ * Add a watcher entry (with 'notify' set) to a wait queue
+ */
+void wait_queue_add(wait_queue_t* wq, wait_entry_t* entry);
+
+/**
+ * Remove an entry from a wait queue (no-op if it is not queued)
+ */
+void wait_queue_remove(wait_queue_t* wq, wait_entry_t* entry);
+
+/**
+ * Wake every process sleeping on a wait queue
+ */
+void wait_queue_wake_all(wait_queue_t* wq);
+
+/**
+ * Wake the first process sleeping on a wait queue
+ */
+void wait_queue_wake_one(wait_queue_t* wq);
+
+/**
+ * Wake up to 'max' processes sleeping on a wait queue with a given key,
+ * oldest first
+ * @return Number of processes woken
+ */
+int wait_queue_wake_key(wait_queue_t* wq, uint32_t key, int max);
+
 #endif /* _CLAUDEOS_PROCESS_H */
@@ -0,0 +1,40 @@
+/**
+ * ClaudeOS RAM Disk - ramdisk.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Memory-backed block devices (ram0, ram1...)
+ *
+ * A RAM disk is an array of page frames, one per 4KB of capacity,
+ * allocated the first time a page is written; pages never written read
+ * as zeros and cost nothing. Transfers are plain copies completed in
+ * submit(), so the device has no seek or interrupt cost and measures
+ * the filesystem and cache code above it alone.
+ *
+ * The page cache can adopt a RAM disk frame as its own copy of a file
+ * page (see block_share_page()), so a filesystem on a RAM disk reads
+ * without copying at all.
+ */
+
+#ifndef _CLAUDEOS_RAMDISK_H
+#define _CLAUDEOS_RAMDISK_H
+
+#include "types.h"
+#include "block.h"
+
+#define RAMDISK_MAX         4
+#define RAMDISK_DEFAULT_MB  16      /* Size of ram0, created at boot */
+#define RAMDISK_MAX_MB      256
+
+/* Create ram0 */
+void ramdisk_init(void);
+
+/**
+ * Create and register the next RAM disk
+ * @param mb Capacity in megabytes (1..RAMDISK_MAX_MB)
+ * @return The device, or NULL if none is left or the size is invalid
+ */
+block_device_t* ramdisk_create(uint32_t mb);
+
+/* Page frames a RAM disk currently holds (0 if 'dev' is not one) */
+uint32_t ramdisk_pages_used(block_device_t* dev);
+
+#endif /* _CLAUDEOS_RAMDISK_H */
@@ -0,0 +1,54 @@
+/**
+ * ClaudeOS Shared Memory - shm.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Shared memory segments mapped through the mmap window
+ */
+
+#ifndef _CLAUDEOS_SHM_H
+#define _CLAUDEOS_SHM_H
+
+#include "types.h"
+
+/* Segment limits */
+#define MAX_SHM_SEGMENTS    32
+#define SHM_MAX_PAGES       1024    /* 4MB per segment (one page of frames) */
+
+/**
+ * Initialize the shared memory segment table
+ */
+void shm_init(void);
+
+/**
+ * Create a shared memory segment
+ * Pages are allocated zero-filled on first touch by any mapping.
+ * @param size Size in bytes (rounded up to whole pages)
+ * @return Segment ID, or a negative SYSCALL_E* code
+ */
+int32_t shm_create(uint32_t size);
+
+/**
+ * Map a segment into the mmap window
+ * Every mapping of a segment shares the same physical pages.
+ * @param id Segment ID
+ * @param prot PROT_* protection
+ * @return Mapped address, or a negative SYSCALL_E* code
+ */
+int32_t shm_map(int32_t id, int prot);
+
+/**
+ * Unmap a segment mapping
+ * @param addr Address returned by shm_map()
+ * @return 0 on success, or a negative SYSCALL_E* code
+ */
+int32_t shm_unmap(uint32_t addr);
+
+/**
+ * Destroy a segment
+ * The ID becomes invalid immediately; the pages are released once the
+ * last mapping is gone.
+ * @param id Segment ID
+ * @return 0 on success, or a negative SYSCALL_E* code
+ */
+int32_t shm_destroy(int32_t id);
+
+#endif /* _CLAUDEOS_SHM_H */
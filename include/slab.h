@@ -0,0 +1,37 @@
+/**
+ * ClaudeOS Object Caches - slab.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Fixed-size object allocator carved out of page frames
+ */
+
+#ifndef _CLAUDEOS_SLAB_H
+#define _CLAUDEOS_SLAB_H
+
+#include "types.h"
+
+typedef struct slab_obj {
+    struct slab_obj* next;
+} slab_obj_t;
+
+/**
+ * A cache of objects of one size
+ * Declare statically with SLAB_INIT; pages are taken from the frame
+ * allocator on demand and never returned.
+ */
+typedef struct {
+    uint32_t size;              /* Object size in bytes */
+    slab_obj_t* free;           /* Free objects */
+} slab_t;
+
+#define SLAB_INIT(type)     { sizeof(type), NULL }
+
+/**
+ * Allocate a zeroed object
+ * @return The object, or NULL if out of memory
+ */
+void* slab_alloc(slab_t* slab);
+
+/* Return an object to its cache */
+void slab_free(slab_t* slab, void* ptr);
+
+#endif /* _CLAUDEOS_SLAB_H */
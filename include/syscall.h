@@ -18,7 +18,7 @@
 #define SYS_YIELD       5   /* Yield CPU */
 #define SYS_FORK        6   /* Fork process (not implemented) */
 #define SYS_EXEC        7   /* Execute program (not implemented) */
-#define SYS_WAIT        8   /* Wait for child (not implemented) */
+#define SYS_WAIT        8   /* Wait for a process to exit */
 #define SYS_OPEN        9   /* Open file */
 #define SYS_CLOSE       10  /* Close file */
 #define SYS_STAT        11  /* Get file status */
@@ -29,9 +29,39 @@
 #define SYS_GETCWD      16  /* Get current directory */
 #define SYS_GETTIME     17  /* Get system time */
 #define SYS_UPTIME      18  /* Get system uptime */
+#define SYS_MMAP        19  /* Map file/anonymous memory (args in mmap_args_t) */
+#define SYS_MUNMAP      20  /* Remove a mapping */
+#define SYS_MPROTECT    21  /* Change mapping protection */
+#define SYS_PIPE        22  /* Create a pipe */
+#define SYS_DUP2        23  /* Duplicate a file descriptor */
+#define SYS_FUTEX       24  /* Futex wait/wake */
+#define SYS_SHM_CREATE  25  /* Create a shared memory segment */
+#define SYS_SHM_MAP     26  /* Map a shared memory segment */
+#define SYS_SHM_UNMAP   27  /* Unmap a shared memory segment */
+#define SYS_SHM_DESTROY 28  /* Destroy a shared memory segment */
+#define SYS_IPC_SEND    29  /* Send an IPC message */
+#define SYS_IPC_RECV    30  /* Receive an IPC message */
+#define SYS_IPC_CALL    31  /* Send and wait for the reply */
+#define SYS_IPC_REPLY   32  /* Reply to a caller */
+#define SYS_POLL        33  /* Wait for readiness on descriptors */
+#define SYS_EPOLL_CREATE 34 /* Create an epoll instance */
+#define SYS_EPOLL_CTL   35  /* Change an interest set (args in epoll_ctl_args_t) */
+#define SYS_EPOLL_WAIT  36  /* Wait on an interest set (args in epoll_wait_args_t) */
+#define SYS_TIMERFD     37  /* Create a periodic timer descriptor */
+#define SYS_GETDENTS    38  /* Read a batch of directory entries */
+#define SYS_READDIRPLUS 39  /* Read directory entries with stat data */
+#define SYS_LSEEK       40  /* Move a file offset */
+#define SYS_FTRUNCATE   41  /* Set the size of an open file */
+#define SYS_DUP         42  /* Duplicate a descriptor onto the lowest free fd */
+#define SYS_OPENAT      43  /* Open relative to a directory fd */
+#define SYS_MKDIRAT     44  /* Create a directory relative to a directory fd */
+#define SYS_FSTATAT     45  /* Get file status relative to a directory fd */
+#define SYS_RENAME      46  /* Move or rename a file or directory */
+#define SYS_FSYNC       47  /* Make an open file's data durable */
+#define SYS_SYNC        48  /* Write back all cached data */
 
 /* System call count */
-#define SYS_MAX         19
+#define SYS_MAX         49
 
 /* Standard file descriptors */
 #define STDIN_FD        0
@@ -48,6 +78,10 @@
 #define SYSCALL_EACCES     -6   /* Permission denied */
 #define SYSCALL_EEXIST     -7   /* File exists */
 #define SYSCALL_ENOTSUP    -8   /* Not supported */
+#define SYSCALL_EPIPE      -9   /* Broken pipe */
+#define SYSCALL_EMFILE     -10  /* Too many open files */
+#define SYSCALL_EAGAIN     -11  /* Try again (futex value changed) */
+#define SYSCALL_ESRCH      -12  /* No such process */
 
 /**
  * Initialize system call handler
@@ -125,4 +159,313 @@ int32_t sys_uptime(void);
  */
 uint64_t sys_gettime(void);
 
+/**
+ * Map a file or anonymous memory
+ * @param args Mapping request (see mman.h)
+ * @return Mapped address, or negative error code
+ */
+int32_t sys_mmap(const void* args);
+
+/**
+ * Unmap a region
+ * @param addr Page-aligned start address
+ * @param length Length in bytes
+ * @return 0 on success, or error code
+ */
+int32_t sys_munmap(void* addr, uint32_t length);
+
+/**
+ * Change protection of a region
+ * @param addr Page-aligned start address
+ * @param length Length in bytes
+ * @param prot PROT_* flags
+ * @return 0 on success, or error code
+ */
+int32_t sys_mprotect(void* addr, uint32_t length, int32_t prot);
+
+/**
+ * Wait for a process to exit
+ * @param pid Process ID
+ * @return Exit code, or error code
+ */
+int32_t sys_wait(uint32_t pid);
+
+/**
+ * Create a pipe
+ * @param fds Receives the read end (fds[0]) and write end (fds[1])
+ * @return 0 on success, or error code
+ */
+int32_t sys_pipe(int32_t fds[2]);
+
+/**
+ * Duplicate a file descriptor onto another
+ * @param oldfd Source descriptor
+ * @param newfd Target descriptor (closed first if open)
+ * @return newfd on success, or error code
+ */
+int32_t sys_dup2(int32_t oldfd, int32_t newfd);
+
+/**
+ * Futex operation
+ * @param uaddr Futex word
+ * @param op FUTEX_WAIT or FUTEX_WAKE
+ * @param val Expected value (WAIT) or number of waiters to wake (WAKE)
+ * @return 0 / number woken on success, or error code
+ */
+int32_t sys_futex(volatile uint32_t* uaddr, int32_t op, uint32_t val);
+
+/**
+ * Create a shared memory segment
+ * @param size Size in bytes
+ * @return Segment ID, or error code
+ */
+int32_t sys_shm_create(uint32_t size);
+
+/**
+ * Map a shared memory segment
+ * @param id Segment ID
+ * @param prot PROT_* protection
+ * @return Mapped address, or error code
+ */
+void* sys_shm_map(int32_t id, int32_t prot);
+
+/**
+ * Unmap a shared memory segment
+ * @param addr Address returned by sys_shm_map()
+ * @return 0 on success, or error code
+ */
+int32_t sys_shm_unmap(void* addr);
+
+/**
+ * Destroy a shared memory segment
+ * @param id Segment ID
+ * @return 0 on success, or error code
+ */
+int32_t sys_shm_destroy(int32_t id);
+
+struct ipc_msg;
+
+/**
+ * Send an IPC message (blocks until received)
+ * @param dest Receiver PID
+ * @param msg Message
+ * @return 0 on success, or error code
+ */
+int32_t sys_ipc_send(uint32_t dest, struct ipc_msg* msg);
+
+/**
+ * Receive an IPC message
+ * @param from Sender PID, or 0 for any
+ * @param msg Receive buffer
+ * @return Sender PID, or error code
+ */
+int32_t sys_ipc_recv(uint32_t from, struct ipc_msg* msg);
+
+/**
+ * Send an IPC message and wait for the reply
+ * @param dest Server PID
+ * @param msg Request on entry, reply on return
+ * @return 0 on success, or error code
+ */
+int32_t sys_ipc_call(uint32_t dest, struct ipc_msg* msg);
+
+/**
+ * Reply to an IPC caller
+ * @param to Caller PID
+ * @param msg Reply
+ * @return 0 on success, or error code
+ */
+int32_t sys_ipc_reply(uint32_t to, struct ipc_msg* msg);
+
+/**
+ * Wait for readiness on a set of descriptors
+ * @param fds pollfd_t array (see poll.h)
+ * @param nfds Number of entries
+ * @param timeout_ms -1 = forever, 0 = don't block
+ * @return Number of ready descriptors, 0 on timeout, or error code
+ */
+int32_t sys_poll(void* fds, uint32_t nfds, int32_t timeout_ms);
+
+/**
+ * Create an epoll instance
+ * @return Descriptor, or error code
+ */
+int32_t sys_epoll_create(void);
+
+/**
+ * Add, modify or remove a descriptor in an interest set
+ * @param args Request (epoll_ctl_args_t, see poll.h)
+ * @return 0 on success, or error code
+ */
+int32_t sys_epoll_ctl(const void* args);
+
+/**
+ * Wait for events on an interest set
+ * @param args Request (epoll_wait_args_t, see poll.h)
+ * @return Number of events, 0 on timeout, or error code
+ */
+int32_t sys_epoll_wait(const void* args);
+
+/**
+ * Create a periodic timer descriptor
+ * @param interval_ms Period in milliseconds
+ * @return Descriptor, or error code
+ */
+int32_t sys_timerfd(uint32_t interval_ms);
+
+/**
+ * Open a file or directory
+ * @param path Absolute path, or relative to the working directory
+ * @param flags O_* flags
+ * @return File descriptor, or error code
+ */
+int32_t sys_open(const char* path, int32_t flags);
+
+/**
+ * Close a file descriptor
+ * @param fd File descriptor
+ * @return 0 on success, or error code
+ */
+int32_t sys_close(int32_t fd);
+
+/**
+ * Read directory entries from an open directory
+ * @param fd Directory opened with sys_open()
+ * @param entries fs_dirent_t array
+ * @param count Capacity of the array
+ * @return Entries stored, 0 at the end, or error code
+ */
+int32_t sys_getdents(int32_t fd, void* entries, uint32_t count);
+
+/**
+ * Read directory entries with their stat data
+ * @param fd Directory opened with sys_open()
+ * @param entries fs_direntplus_t array
+ * @param count Capacity of the array
+ * @return Entries stored, 0 at the end, or error code
+ */
+int32_t sys_readdirplus(int32_t fd, void* entries, uint32_t count);
+
+/**
+ * Move a file offset
+ * @param fd File descriptor
+ * @param offset Byte offset relative to whence
+ * @param whence SEEK_SET, SEEK_CUR or SEEK_END
+ * @return New offset, or error code
+ */
+int32_t sys_lseek(int32_t fd, int32_t offset, int32_t whence);
+
+/**
+ * Set the size of an open file
+ * @param fd File descriptor
+ * @param size New size in bytes (growing leaves a hole)
+ * @return 0 on success, or error code
+ */
+int32_t sys_ftruncate(int32_t fd, uint32_t size);
+
+/**
+ * Write back an open file's cached data and wait until it is durable
+ * @param fd File descriptor
+ * @return 0 on success, or error code
+ */
+int32_t sys_fsync(int32_t fd);
+
+/**
+ * Write back the cached data of every file and filesystem
+ * @return 0 on success, or error code
+ */
+int32_t sys_sync(void);
+
+/**
+ * Duplicate a file descriptor
+ * The new descriptor shares the open file (and its offset) with fd.
+ * @param fd File descriptor
+ * @return Lowest free descriptor number, or error code
+ */
+int32_t sys_dup(int32_t fd);
+
+/**
+ * Get file status
+ * @param path File path
+ * @param stat Receives an fs_stat_t
+ * @return 0 on success, or error code
+ */
+int32_t sys_stat(const char* path, void* stat);
+
+/**
+ * Create a directory (the parent must exist)
+ * @param path Directory path
+ * @return 0 on success, or error code
+ */
+int32_t sys_mkdir(const char* path);
+
+/**
+ * Change the working directory
+ * @param path Directory path
+ * @return 0 on success, or error code
+ */
+int32_t sys_chdir(const char* path);
+
+/**
+ * Get the working directory
+ * @param buf Receives the absolute path
+ * @param size Size of buf
+ * @return Length of the path, or error code
+ */
+int32_t sys_getcwd(char* buf, uint32_t size);
+
+/**
+ * Remove a file (its data lives on while it is still open or mapped)
+ * @param path File path
+ * @return 0 on success, or error code
+ */
+int32_t sys_unlink(const char* path);
+
+/**
+ * Remove an empty directory
+ * @param path Directory path
+ * @return 0 on success, or error code
+ */
+int32_t sys_rmdir(const char* path);
+
+/**
+ * Atomically rename, replacing an existing target of the same kind
+ * @param oldpath Current path
+ * @param newpath New path (same filesystem)
+ * @return 0 on success, or error code
+ */
+int32_t sys_rename(const char* oldpath, const char* newpath);
+
+/*
+ * The *at() calls resolve a relative path from the directory open as
+ * dirfd, or from the working directory for AT_FDCWD (-100), so a
+ * program can work inside a directory without rebuilding full paths.
+ */
+
+/**
+ * Open relative to a directory
+ * @param dirfd Directory fd or AT_FDCWD
+ * @param path File path
+ * @param flags O_* flags
+ * @return File descriptor, or error code
+ */
+int32_t sys_openat(int32_t dirfd, const char* path, int32_t flags);
+
+/**
+ * Create a directory relative to a directory
+ * @param dirfd Directory fd or AT_FDCWD
+ * @param path Directory path
+ * @return 0 on success, or error code
+ */
+int32_t sys_mkdirat(int32_t dirfd, const char* path);
+
+/**
+ * Get file status relative to a directory
+ * @param dirfd Directory fd or AT_FDCWD
+ * @param path File path
+ * @param stat Receives an fs_stat_t
+ * @return 0 on success, or error code
+ */
+int32_t sys_fstatat(int32_t dirfd, const char* path, void* stat);
+
 #endif /* _CLAUDEOS_SYSCALL_H */
@@ -87,4 +87,24 @@ typedef void (*timer_callback_t)(uint64_t ticks);
  */
 void timer_set_callback(timer_callback_t callback);
 
+/* Maximum number of per-tick hooks */
+#define TIMER_MAX_HOOKS 4
+
+/**
+ * Add a hook called on every tick, before the main callback
+ * @param hook Function to call
+ * @return 0 on success, -1 if all hook slots are taken
+ */
+int timer_add_hook(timer_callback_t hook);
+
+/**
+ * Read the CPU time-stamp counter (cycle-resolution timing for benchmarks)
+ * @return Cycles since reset
+ */
+static inline uint64_t timer_read_tsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
 #endif /* _CLAUDEOS_TIMER_H */
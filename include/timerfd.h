@@ -0,0 +1,32 @@
+/**
+ * ClaudeOS Timer Descriptors - timerfd.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Periodic timers readable and pollable as file descriptors
+ */
+
+#ifndef _CLAUDEOS_TIMERFD_H
+#define _CLAUDEOS_TIMERFD_H
+
+#include "types.h"
+
+/* Maximum number of timer descriptors */
+#define MAX_TIMERFDS    16
+
+/**
+ * Initialize timer descriptors and hook the timer tick
+ */
+void timerfd_init(void);
+
+/**
+ * Create a periodic timer descriptor
+ *
+ * The descriptor becomes readable (POLLIN) each time the period elapses.
+ * A read returns the number of expirations since the last read as a
+ * uint32_t, blocking until there is at least one.
+ *
+ * @param interval_ms Period in milliseconds
+ * @return Descriptor, or a negative SYSCALL_E* code
+ */
+int32_t timerfd_create(uint32_t interval_ms);
+
+#endif /* _CLAUDEOS_TIMERFD_H */
@@ -0,0 +1,224 @@
+/**
+ * ClaudeOS Virtio - virtio.h
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Virtio PCI transport (legacy and modern) and split virtqueues
+ *
+ * A virtio device is found on PCI and driven through one of two
+ * register layouts: the legacy I/O port block in BAR0, or the modern
+ * vendor capabilities pointing into memory BARs. Drivers see the same
+ * API either way: negotiate features, read device config, set up
+ * queues and exchange buffers with virtq_add()/virtq_get().
+ *
+ * Interrupts arrive on the legacy INTx line (there is no MSI-X without
+ * an APIC); reading the ISR register acknowledges them.
+ */
+
+#ifndef _CLAUDEOS_VIRTIO_H
+#define _CLAUDEOS_VIRTIO_H
+
+#include "types.h"
+#include "pci.h"
+
+#define VIRTIO_PCI_VENDOR       0x1AF4
+#define VIRTIO_PCI_LEGACY_BASE  0x1000  /* Transitional IDs 0x1000-0x103F */
+#define VIRTIO_PCI_MODERN_BASE  0x1040  /* 0x1040 + device type */
+
+/* Device types */
+#define VIRTIO_ID_NET           1
+#define VIRTIO_ID_BLOCK         2
+
+/* Device status bits */
+#define VIRTIO_STATUS_ACK       0x01
+#define VIRTIO_STATUS_DRIVER    0x02
+#define VIRTIO_STATUS_DRIVER_OK 0x04
+#define VIRTIO_STATUS_FEATURES_OK 0x08
+#define VIRTIO_STATUS_FAILED    0x80
+
+/* Transport feature bits */
+#define VIRTIO_F_INDIRECT_DESC  28
+#define VIRTIO_F_EVENT_IDX      29
+#define VIRTIO_F_VERSION_1      32
+
+/* Legacy register block (BAR0, I/O) */
+#define VIRTIO_LEG_HOST_FEATURES    0x00
+#define VIRTIO_LEG_GUEST_FEATURES   0x04
+#define VIRTIO_LEG_QUEUE_PFN        0x08
+#define VIRTIO_LEG_QUEUE_NUM        0x0C
+#define VIRTIO_LEG_QUEUE_SEL        0x0E
+#define VIRTIO_LEG_QUEUE_NOTIFY     0x10
+#define VIRTIO_LEG_STATUS           0x12
+#define VIRTIO_LEG_ISR              0x13
+#define VIRTIO_LEG_CONFIG           0x14
+
+/* Modern capability types (PCI vendor capability 0x09) */
+#define VIRTIO_PCI_CAP_VENDOR       0x09
+#define VIRTIO_PCI_CAP_COMMON       1
+#define VIRTIO_PCI_CAP_NOTIFY       2
+#define VIRTIO_PCI_CAP_ISR          3
+#define VIRTIO_PCI_CAP_DEVICE       4
+
+/* Modern common configuration layout */
+#define VIRTIO_COM_DFSELECT     0x00
+#define VIRTIO_COM_DF           0x04
+#define VIRTIO_COM_GFSELECT     0x08
+#define VIRTIO_COM_GF           0x0C
+#define VIRTIO_COM_NUM_QUEUES   0x12
+#define VIRTIO_COM_STATUS       0x14
+#define VIRTIO_COM_Q_SELECT     0x16
+#define VIRTIO_COM_Q_SIZE       0x18
+#define VIRTIO_COM_Q_ENABLE     0x1C
+#define VIRTIO_COM_Q_NOFF       0x1E
+#define VIRTIO_COM_Q_DESC       0x20
+#define VIRTIO_COM_Q_AVAIL      0x28
+#define VIRTIO_COM_Q_USED       0x30
+
+/* Split ring layout */
+#define VIRTQ_DESC_F_NEXT       1
+#define VIRTQ_DESC_F_WRITE      2   /* Device writes this buffer */
+#define VIRTQ_DESC_F_INDIRECT   4
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 1
+#define VIRTQ_USED_F_NO_NOTIFY  1
+
+#define VIRTQ_MAX_SIZE          1024    /* Largest ring we accept (legacy size is fixed) */
+#define VIRTQ_MODERN_SIZE       256     /* Size we ask for when we may choose */
+#define VIRTQ_INDIRECT_MAX      64      /* Descriptors in one indirect table */
+#define VIRTQ_TABLES            64      /* Indirect tables per queue */
+
+typedef struct {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) virtq_desc_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];                /* Then used_event (EVENT_IDX) */
+} __attribute__((packed)) virtq_avail_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed)) virtq_used_elem_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    virtq_used_elem_t ring[];       /* Then avail_event (EVENT_IDX) */
+} __attribute__((packed)) virtq_used_t;
+
+struct virtio_dev;
+
+/* One buffer handed to the device */
+typedef struct {
+    uint32_t addr;                  /* Physical */
+    uint32_t len;
+    bool write;                     /* Device writes it (an "in" buffer) */
+} virtq_buf_t;
+
+typedef struct virtq {
+    struct virtio_dev* vdev;
+    uint16_t index;
+    uint16_t size;
+    virtq_desc_t* desc;
+    virtq_avail_t* avail;
+    virtq_used_t* used;
+    virtq_desc_t* indirect;         /* VIRTQ_TABLES tables of VIRTQ_INDIRECT_MAX */
+    uint8_t table_free[VIRTQ_TABLES];
+    uint32_t tables_free;
+    uint8_t* head_table;            /* Per head descriptor: its table, or 0xFF */
+    void** cookies;                 /* Per head descriptor */
+    uint16_t free_head;
+    uint16_t num_free;
+    uint16_t last_used;
+    uint16_t kicked_avail;          /* avail->idx at the last notify */
+    volatile uint16_t* notify;      /* Modern doorbell */
+    uint32_t notifies;
+    uint32_t suppressed;            /* Kicks skipped thanks to EVENT_IDX */
+} virtq_t;
+
+typedef struct virtio_dev {
+    pci_device_t* pci;
+    bool modern;
+    uint16_t io;                    /* Legacy: I/O base */
+    volatile uint8_t* common;       /* Modern: capability windows */
+    volatile uint8_t* isr;
+    volatile uint8_t* device;
+    volatile uint8_t* notify_base;
+    uint32_t notify_mult;
+    uint64_t features;              /* Negotiated */
+} virtio_dev_t;
+
+/**
+ * Find the next virtio device of a type
+ * @param prev Previous match, or NULL
+ */
+pci_device_t* virtio_find(uint16_t type, pci_device_t* prev);
+
+/**
+ * Pick the device's transport and reset it
+ * @return 0 on success, -1 if it cannot be driven
+ */
+int virtio_probe(pci_device_t* pci, virtio_dev_t* vdev);
+
+/**
+ * Negotiate features: accept the subset of 'wanted' the device offers
+ * @return 0, or -1 if the device rejected the result
+ */
+int virtio_negotiate(virtio_dev_t* vdev, uint64_t wanted);
+
+static inline bool virtio_has(virtio_dev_t* vdev, uint32_t bit) {
+    return (vdev->features >> bit) & 1;
+}
+
+/* Device-specific configuration space */
+uint8_t virtio_config8(virtio_dev_t* vdev, uint32_t offset);
+uint16_t virtio_config16(virtio_dev_t* vdev, uint32_t offset);
+uint32_t virtio_config32(virtio_dev_t* vdev, uint32_t offset);
+uint64_t virtio_config64(virtio_dev_t* vdev, uint32_t offset);
+
+/**
+ * Allocate and register queue 'index' (at most VIRTQ_MAX_SIZE entries)
+ * @return 0 on success, -1 on failure
+ */
+int virtq_init(virtio_dev_t* vdev, virtq_t* vq, uint16_t index);
+
+/* Set DRIVER_OK: queues are live */
+void virtio_ready(virtio_dev_t* vdev);
+
+/* Read (and so acknowledge) the interrupt status */
+uint8_t virtio_isr(virtio_dev_t* vdev);
+
+/*
+ * The calls below do not lock: a driver serializes each queue itself
+ * (interrupts off), since completions are reaped from its IRQ handler.
+ */
+
+/**
+ * Queue a buffer chain; out buffers must precede in buffers. Uses one
+ * ring slot and an indirect table when the device supports them.
+ * @return 0, or -1 if the ring is full
+ */
+int virtq_add(virtq_t* vq, const virtq_buf_t* bufs, uint32_t count, void* cookie);
+
+/* Notify the device of new buffers, unless EVENT_IDX says it need not be */
+void virtq_kick(virtq_t* vq);
+
+/**
+ * Take one completed chain
+ * @return Its cookie, or NULL if nothing has completed
+ */
+void* virtq_get(virtq_t* vq, uint32_t* len);
+
+/**
+ * Re-arm the completion interrupt after draining the used ring
+ * @return true if more completions arrived meanwhile (drain again)
+ */
+bool virtq_enable_irq(virtq_t* vq);
+
+/* Probe virtio-blk disks and register them as vda, vdb... */
+void virtio_blk_init(void);
+
+#endif /* _CLAUDEOS_VIRTIO_H */
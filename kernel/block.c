@@ -0,0 +1,753 @@
+/**
+ * ClaudeOS Block Layer - block.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Bio submission, request merging, plugging and schedulers
+ *
+ * Every queue operation runs with interrupts disabled, since drivers
+ * complete requests from their interrupt handlers. The driver's submit
+ * hook is called with interrupts restored, so a synchronous (PIO or
+ * memory) driver does not hold them off for a whole transfer; the
+ * 'dispatching' flag keeps completions from re-entering the dispatch
+ * loop meanwhile.
+ */
+
+#include "types.h"
+#include "block.h"
+#include "slab.h"
+#include "pmm.h"
+#include "paging.h"
+#include "timer.h"
+#include "idt.h"
+#include "process.h"
+#include "../fs/vfs.h"
+#include "../fs/devfs.h"
+
+/* Deadline scheduler tuning (timer ticks at 100 Hz) */
+#define READ_EXPIRE     50          /* 500ms */
+#define WRITE_EXPIRE    500         /* 5s */
+#define WRITES_STARVED  2           /* Read batches before writes must go */
+
+static block_device_t* devices = NULL;
+static block_sched_t* schedulers = NULL;
+
+static slab_t bio_slab = SLAB_INIT(bio_t);
+static slab_t request_slab = SLAB_INIT(request_t);
+
+static bool str_eq(const char* a, const char* b) {
+    while (*a && *a == *b) { a++; b++; }
+    return *a == *b;
+}
+
+/*
+ * ===========================================================================
+ * Bios and Requests
+ * ===========================================================================
+ */
+
+bio_t* bio_alloc(void) {
+    return (bio_t*)slab_alloc(&bio_slab);
+}
+
+void bio_free(bio_t* bio) {
+    slab_free(&bio_slab, bio);
+}
+
+uint32_t bio_sectors(bio_t* bio) {
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < bio->nsegs; i++) {
+        bytes += bio->segs[i].len;
+    }
+    return bytes >> BLOCK_SECTOR_SHIFT;
+}
+
+bool block_can_merge(request_t* req, bio_t* bio, int front) {
+    block_device_t* dev = req->dev;
+    uint32_t sectors = bio_sectors(bio);
+
+    if (req->op != bio->op || bio->op == BIO_FLUSH) return false;
+    if (req->sectors + sectors > dev->max_sectors) return false;
+    if (req->nsegs + bio->nsegs > dev->max_segs) return false;
+    return front ? bio->sector + sectors == req->sector
+                 : req->sector + req->sectors == bio->sector;
+}
+
+/* End every bio of a request */
+static void end_bios(request_t* req, int status) {
+    bio_t* bio = req->bio;
+    while (bio) {
+        bio_t* next = bio->next;
+        bio->next = NULL;
+        bio->status = status;
+        bio->done = 1;
+        if (bio->end) {
+            bio->end(bio);
+        }
+        bio = next;
+    }
+}
+
+/*
+ * ===========================================================================
+ * Dispatch
+ * ===========================================================================
+ */
+
+/*
+ * Feed the driver until it is full or the queue is empty. 'force'
+ * ignores plugging (a waiter needs its bio to move).
+ */
+static void run_queue(block_device_t* dev, bool force) {
+    uint32_t irq = irq_save();
+    if (dev->dispatching) {
+        irq_restore(irq);
+        return;
+    }
+    dev->dispatching = true;
+
+    uint32_t sent = 0;
+    while ((force || !dev->plugged) && dev->inflight < dev->queue_depth) {
+        request_t* req = dev->retry;
+        if (req) {
+            dev->retry = NULL;
+        } else {
+            req = dev->sched->next(dev);
+            if (!req) break;
+            dev->queued--;
+        }
+
+        dev->inflight++;
+        dev->stats.requests++;
+        irq_restore(irq);
+        int accepted = dev->ops->submit(dev, req);
+        irq = irq_save();
+
+        if (accepted != 0) {
+            dev->inflight--;
+            dev->stats.requests--;
+            dev->retry = req;
+            break;
+        }
+        sent++;
+    }
+
+    dev->dispatching = false;
+    irq_restore(irq);
+
+    if (sent && dev->ops->commit) {
+        dev->ops->commit(dev);
+    }
+}
+
+void block_complete(request_t* req, int status) {
+    block_device_t* dev = req->dev;
+
+    if (status != 0) {
+        dev->stats.errors++;
+    }
+    end_bios(req, status);
+    slab_free(&request_slab, req);
+
+    uint32_t irq = irq_save();
+    dev->inflight--;
+    wait_queue_wake_all(&dev->wait);
+    irq_restore(irq);
+
+    run_queue(dev, false);
+}
+
+void block_submit(bio_t* bio) {
+    block_device_t* dev = bio->dev;
+    uint32_t sectors = bio_sectors(bio);
+
+    bio->done = 0;
+    bio->status = 0;
+    bio->next = NULL;
+
+    if (bio->op != BIO_FLUSH &&
+        (sectors == 0 || bio->sector + sectors > dev->sectors || bio->nsegs > dev->max_segs)) {
+        bio->status = -1;
+        bio->done = 1;
+        if (bio->end) bio->end(bio);
+        return;
+    }
+
+    uint32_t irq = irq_save();
+    dev->stats.bios++;
+    if (bio->op == BIO_READ) {
+        dev->stats.read_sectors += sectors;
+    } else if (bio->op == BIO_WRITE) {
+        dev->stats.write_sectors += sectors;
+    }
+
+    /* Extend a queued request if this bio continues or precedes it */
+    int front = 0;
+    request_t* req = bio->op == BIO_FLUSH ? NULL : dev->sched->find_merge(dev, bio, &front);
+    if (req) {
+        if (front) {
+            bio->next = req->bio;
+            req->bio = bio;
+            req->sector = bio->sector;
+        } else {
+            req->bio_tail->next = bio;
+            req->bio_tail = bio;
+        }
+        req->sectors += sectors;
+        req->nsegs += bio->nsegs;
+        dev->stats.merges++;
+        dev->sched->merged(dev, req);
+        irq_restore(irq);
+    } else {
+        irq_restore(irq);
+
+        req = (request_t*)slab_alloc(&request_slab);
+        if (!req) {
+            bio->status = -1;
+            bio->done = 1;
+            if (bio->end) bio->end(bio);
+            return;
+        }
+        req->dev = dev;
+        req->op = bio->op;
+        req->sector = bio->sector;
+        req->sectors = sectors;
+        req->nsegs = bio->nsegs;
+        req->bio = req->bio_tail = bio;
+        req->deadline = timer_get_ticks() + (bio->op == BIO_READ ? READ_EXPIRE : WRITE_EXPIRE);
+
+        irq = irq_save();
+        dev->sched->add(dev, req);
+        dev->queued++;
+        irq_restore(irq);
+    }
+
+    run_queue(dev, false);
+}
+
+static bool bio_done(block_device_t* dev, void* arg) {
+    (void)dev;
+    return ((bio_t*)arg)->done != 0;
+}
+
+static bool queue_idle(block_device_t* dev, void* arg) {
+    (void)arg;
+    return !dev->queued && !dev->inflight && !dev->retry;
+}
+
+/* Sleep (or poll, before interrupts are up) until 'cond' holds */
+static void wait_for(block_device_t* dev, bool (*cond)(block_device_t*, void*), void* arg) {
+    /* What we wait on may be sitting behind someone's plug */
+    run_queue(dev, true);
+
+    for (;;) {
+        uint32_t irq = irq_save();
+        if (cond(dev, arg)) {
+            irq_restore(irq);
+            return;
+        }
+        if (process_current() && (irq & 0x200) && !dev->polled) {
+            wait_queue_sleep(&dev->wait);
+            irq_restore(irq);
+            run_queue(dev, true);
+            continue;
+        }
+        irq_restore(irq);
+
+        /* Boot time, interrupts off or a polled queue: reap by hand */
+        if (dev->ops->poll) {
+            dev->ops->poll(dev);
+        } else if (irq & 0x200) {
+            __asm__ volatile ("hlt");
+        }
+        run_queue(dev, true);
+    }
+}
+
+void block_wait(bio_t* bio) {
+    wait_for(bio->dev, bio_done, bio);
+}
+
+void block_plug(block_device_t* dev) {
+    uint32_t irq = irq_save();
+    dev->plugged++;
+    irq_restore(irq);
+}
+
+void block_unplug(block_device_t* dev) {
+    uint32_t irq = irq_save();
+    bool last = dev->plugged > 0 && --dev->plugged == 0;
+    irq_restore(irq);
+
+    if (last) {
+        run_queue(dev, false);
+    }
+}
+
+/*
+ * ===========================================================================
+ * Synchronous Transfers
+ * ===========================================================================
+ */
+
+static int block_rw(block_device_t* dev, uint32_t op, uint64_t sector, uint32_t buf,
+                    uint32_t count) {
+    if (!dev || sector + count > dev->sectors) return -1;
+
+    /* One bio per max_sectors chunk, all queued before any is waited on */
+    bio_t* first = NULL;
+    bio_t** link = &first;
+    int status = 0;
+
+    block_plug(dev);
+    while (count > 0) {
+        uint32_t n = count < dev->max_sectors ? count : dev->max_sectors;
+        bio_t* bio = bio_alloc();
+        if (!bio) {
+            status = -1;
+            break;
+        }
+        bio->dev = dev;
+        bio->op = op;
+        bio->sector = sector;
+        bio->nsegs = 1;
+        bio->segs[0].addr = buf;
+        bio->segs[0].len = n << BLOCK_SECTOR_SHIFT;
+        *link = bio;
+        link = (bio_t**)&bio->priv;
+        block_submit(bio);
+
+        sector += n;
+        buf += n << BLOCK_SECTOR_SHIFT;
+        count -= n;
+    }
+    block_unplug(dev);
+
+    while (first) {
+        bio_t* next = (bio_t*)first->priv;
+        block_wait(first);
+        if (first->status != 0) status = -1;
+        bio_free(first);
+        first = next;
+    }
+    return status;
+}
+
+int block_read(block_device_t* dev, uint64_t sector, void* buf, uint32_t count) {
+    return block_rw(dev, BIO_READ, sector, (uint32_t)buf, count);
+}
+
+int block_write(block_device_t* dev, uint64_t sector, const void* buf, uint32_t count) {
+    return block_rw(dev, BIO_WRITE, sector, (uint32_t)buf, count);
+}
+
+int block_flush(block_device_t* dev) {
+    if (!dev) return -1;
+
+    /* Everything queued before the flush must reach the device first */
+    wait_for(dev, queue_idle, NULL);
+
+    bio_t* bio = bio_alloc();
+    if (!bio) return -1;
+    bio->dev = dev;
+    bio->op = BIO_FLUSH;
+    block_submit(bio);
+    block_wait(bio);
+
+    int status = bio->status;
+    bio_free(bio);
+    return status;
+}
+
+int block_share_page(block_device_t* dev, uint64_t sector, uint32_t* frame) {
+    uint32_t per_page = PAGE_SIZE >> BLOCK_SECTOR_SHIFT;
+    if (!dev || !dev->ops->share_page || (sector & (per_page - 1)) ||
+        sector + per_page > dev->sectors) {
+        return -1;
+    }
+
+    /* A write still in the queue would land after we look */
+    wait_for(dev, queue_idle, NULL);
+    return dev->ops->share_page(dev, sector, frame);
+}
+
+/*
+ * ===========================================================================
+ * noop: FIFO order, merging only
+ * ===========================================================================
+ */
+
+typedef struct {
+    request_t* head;
+    request_t* tail;
+} noop_data_t;
+
+static noop_data_t* noop_of(block_device_t* dev) {
+    return (noop_data_t*)dev->sched_data;
+}
+
+static request_t* noop_find_merge(block_device_t* dev, bio_t* bio, int* front) {
+    for (request_t* req = noop_of(dev)->tail; req; req = req->prev) {
+        if (block_can_merge(req, bio, 0)) {
+            *front = 0;
+            return req;
+        }
+        if (block_can_merge(req, bio, 1)) {
+            *front = 1;
+            return req;
+        }
+    }
+    return NULL;
+}
+
+static void noop_merged(block_device_t* dev, request_t* req) {
+    (void)dev; (void)req;
+}
+
+static void noop_add(block_device_t* dev, request_t* req) {
+    noop_data_t* q = noop_of(dev);
+    req->next = NULL;
+    req->prev = q->tail;
+    if (q->tail) {
+        q->tail->next = req;
+    } else {
+        q->head = req;
+    }
+    q->tail = req;
+}
+
+static request_t* noop_next(block_device_t* dev) {
+    noop_data_t* q = noop_of(dev);
+    request_t* req = q->head;
+    if (req) {
+        q->head = req->next;
+        if (q->head) {
+            q->head->prev = NULL;
+        } else {
+            q->tail = NULL;
+        }
+    }
+    return req;
+}
+
+static block_sched_t noop_sched = {
+    .name       = "noop",
+    .data_size  = sizeof(noop_data_t),
+    .find_merge = noop_find_merge,
+    .merged     = noop_merged,
+    .add        = noop_add,
+    .next       = noop_next,
+};
+
+/*
+ * ===========================================================================
+ * deadline: sector-sorted sweeps with per-direction expiry
+ * ===========================================================================
+ */
+
+/*
+ * Requests sit on one list sorted by sector and on a FIFO per
+ * direction. Dispatch sweeps upward from the end of the last request,
+ * preferring reads, unless the oldest request of the chosen direction
+ * has passed its deadline; then the sweep restarts from it. Writes are
+ * chosen after WRITES_STARVED read picks while any are waiting.
+ */
+typedef struct {
+    request_t* sorted;
+    request_t* fifo_head[2];
+    request_t* fifo_tail[2];
+    uint32_t count[2];
+    uint64_t next_sector;
+    uint32_t starved;
+} deadline_data_t;
+
+static deadline_data_t* dl_of(block_device_t* dev) {
+    return (deadline_data_t*)dev->sched_data;
+}
+
+static void dl_sort_insert(deadline_data_t* q, request_t* req) {
+    request_t** link = &q->sorted;
+    request_t* prev = NULL;
+    while (*link && (*link)->sector < req->sector) {
+        prev = *link;
+        link = &(*link)->next;
+    }
+    req->next = *link;
+    req->prev = prev;
+    if (*link) (*link)->prev = req;
+    *link = req;
+}
+
+static void dl_sort_remove(deadline_data_t* q, request_t* req) {
+    if (req->prev) {
+        req->prev->next = req->next;
+    } else {
+        q->sorted = req->next;
+    }
+    if (req->next) req->next->prev = req->prev;
+}
+
+static request_t* dl_find_merge(block_device_t* dev, bio_t* bio, int* front) {
+    for (request_t* req = dl_of(dev)->sorted; req; req = req->next) {
+        if (block_can_merge(req, bio, 0)) {
+            *front = 0;
+            return req;
+        }
+        if (block_can_merge(req, bio, 1)) {
+            *front = 1;
+            return req;
+        }
+        if (req->sector > bio->sector + bio_sectors(bio)) break;
+    }
+    return NULL;
+}
+
+static void dl_merged(block_device_t* dev, request_t* req) {
+    /* A front merge lowers the start sector */
+    deadline_data_t* q = dl_of(dev);
+    dl_sort_remove(q, req);
+    dl_sort_insert(q, req);
+}
+
+static uint32_t dl_dir(request_t* req) {
+    return req->op == BIO_READ ? 0 : 1;
+}
+
+static void dl_add(block_device_t* dev, request_t* req) {
+    deadline_data_t* q = dl_of(dev);
+    uint32_t d = dl_dir(req);
+
+    dl_sort_insert(q, req);
+    req->fifo_next = NULL;
+    req->fifo_prev = q->fifo_tail[d];
+    if (q->fifo_tail[d]) {
+        q->fifo_tail[d]->fifo_next = req;
+    } else {
+        q->fifo_head[d] = req;
+    }
+    q->fifo_tail[d] = req;
+    q->count[d]++;
+}
+
+static void dl_remove(deadline_data_t* q, request_t* req) {
+    uint32_t d = dl_dir(req);
+    dl_sort_remove(q, req);
+    if (req->fifo_prev) {
+        req->fifo_prev->fifo_next = req->fifo_next;
+    } else {
+        q->fifo_head[d] = req->fifo_next;
+    }
+    if (req->fifo_next) {
+        req->fifo_next->fifo_prev = req->fifo_prev;
+    } else {
+        q->fifo_tail[d] = req->fifo_prev;
+    }
+    q->count[d]--;
+}
+
+static request_t* dl_next(block_device_t* dev) {
+    deadline_data_t* q = dl_of(dev);
+    if (!q->count[0] && !q->count[1]) return NULL;
+
+    uint32_t d;
+    if (q->count[0] && (!q->count[1] || q->starved < WRITES_STARVED)) {
+        d = 0;
+        if (q->count[1]) q->starved++;
+    } else {
+        d = 1;
+        q->starved = 0;
+    }
+
+    /* Expired: serve the oldest; otherwise continue the sweep (wrapping) */
+    request_t* req = q->fifo_head[d];
+    if (req->deadline > timer_get_ticks()) {
+        request_t* wrap = NULL;
+        req = NULL;
+        for (request_t* r = q->sorted; r; r = r->next) {
+            if (dl_dir(r) != d) continue;
+            if (!wrap) wrap = r;
+            if (r->sector >= q->next_sector) {
+                req = r;
+                break;
+            }
+        }
+        if (!req) req = wrap;
+    }
+
+    dl_remove(q, req);
+    q->next_sector = req->sector + req->sectors;
+    return req;
+}
+
+static block_sched_t deadline_sched = {
+    .name       = "deadline",
+    .data_size  = sizeof(deadline_data_t),
+    .find_merge = dl_find_merge,
+    .merged     = dl_merged,
+    .add        = dl_add,
+    .next       = dl_next,
+};
+
+void block_register_sched(block_sched_t* sched) {
+    sched->list_next = schedulers;
+    schedulers = sched;
+}
+
+/* Switch schedulers; only while nothing is queued */
+int block_set_sched(block_device_t* dev, const char* name) {
+    block_sched_t* sched = schedulers;
+    while (sched && !str_eq(sched->name, name)) {
+        sched = sched->list_next;
+    }
+    if (!sched || sched->data_size > PAGE_SIZE) return -1;
+    if (sched == dev->sched) return 0;
+
+    /* Get the new state first, so a failure keeps the old scheduler */
+    uint32_t data = pmm_alloc_page();
+    if (!data) return -1;
+    pmm_zero_page(data);
+
+    uint32_t irq = irq_save();
+    if (dev->sched && (dev->retry || dev->inflight || dev->queued)) {
+        irq_restore(irq);
+        pmm_free_pages(data, 1);
+        return -1;
+    }
+    uint32_t old = (uint32_t)dev->sched_data;
+    dev->sched = sched;
+    dev->sched_data = (void*)data;
+    irq_restore(irq);
+
+    if (old) pmm_free_pages(old, 1);
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * /dev Nodes
+ * ===========================================================================
+ */
+
+/*
+ * Byte-addressed access for /dev/<name>. Whole sectors of a buffer in
+ * the identity map go straight to the device; partial sectors and
+ * buffers elsewhere (e.g. the mmap window) bounce through a page.
+ */
+static ssize_t blockdev_rw(fs_node_t* node, uint8_t* buf, size_t size, size_t offset,
+                           bool write) {
+    block_device_t* dev = (block_device_t*)node->data;
+    uint64_t capacity = dev->sectors << BLOCK_SECTOR_SHIFT;
+    if (offset >= capacity) return 0;
+    if (size > capacity - offset) size = capacity - offset;
+
+    uint32_t bounce = 0;
+    size_t done = 0;
+    while (done < size) {
+        uint64_t pos = offset + done;
+        uint64_t sector = pos >> BLOCK_SECTOR_SHIFT;
+        uint32_t in = pos & (BLOCK_SECTOR_SIZE - 1);
+        size_t left = size - done;
+        uint32_t addr = (uint32_t)(buf + done);
+
+        if (in == 0 && left >= BLOCK_SECTOR_SIZE && addr + left <= PAGING_IDENTITY_END) {
+            uint32_t count = left >> BLOCK_SECTOR_SHIFT;
+            int err = write ? block_write(dev, sector, buf + done, count)
+                            : block_read(dev, sector, buf + done, count);
+            if (err) break;
+            done += (size_t)count << BLOCK_SECTOR_SHIFT;
+            continue;
+        }
+
+        if (!bounce && !(bounce = pmm_alloc_page())) break;
+
+        /* Up to a page, starting at a sector boundary */
+        uint32_t chunk = PAGE_SIZE - in;
+        if (chunk > left) chunk = left;
+        uint32_t count = (in + chunk + BLOCK_SECTOR_SIZE - 1) >> BLOCK_SECTOR_SHIFT;
+        if (sector + count > dev->sectors) count = dev->sectors - sector;
+
+        /* Writes of part of a sector read it first */
+        bool whole = in == 0 && (chunk & (BLOCK_SECTOR_SIZE - 1)) == 0;
+        if ((!write || !whole) && block_read(dev, sector, (void*)bounce, count) != 0) break;
+
+        uint8_t* b = (uint8_t*)bounce + in;
+        if (write) {
+            for (uint32_t i = 0; i < chunk; i++) b[i] = buf[done + i];
+            if (block_write(dev, sector, (void*)bounce, count) != 0) break;
+        } else {
+            for (uint32_t i = 0; i < chunk; i++) buf[done + i] = b[i];
+        }
+        done += chunk;
+    }
+
+    if (bounce) pmm_free_pages(bounce, 1);
+    return done > 0 || size == 0 ? (ssize_t)done : -1;
+}
+
+static ssize_t blockdev_read(fs_node_t* node, void* buf, size_t size, size_t offset) {
+    return blockdev_rw(node, (uint8_t*)buf, size, offset, false);
+}
+
+static ssize_t blockdev_write(fs_node_t* node, const void* buf, size_t size, size_t offset) {
+    return blockdev_rw(node, (uint8_t*)buf, size, offset, true);
+}
+
+static fs_ops_t blockdev_ops = {
+    .read  = blockdev_read,
+    .write = blockdev_write,
+};
+
+/*
+ * ===========================================================================
+ * Registry
+ * ===========================================================================
+ */
+
+void block_device_init(block_device_t* dev) {
+    if (!dev->max_sectors) dev->max_sectors = 256;
+    if (!dev->max_segs || dev->max_segs > REQ_MAX_SEGS) dev->max_segs = REQ_MAX_SEGS;
+    if (!dev->queue_depth) dev->queue_depth = 1;
+    dev->plugged = 0;
+    dev->queued = 0;
+    dev->inflight = 0;
+    dev->dispatching = false;
+    dev->retry = NULL;
+    wait_queue_init(&dev->wait);
+    dev->sched = NULL;
+    dev->sched_data = NULL;
+    block_set_sched(dev, "noop");
+}
+
+block_device_t* block_find(const char* name) {
+    if (name[0] == '/' && name[1] == 'd' && name[2] == 'e' && name[3] == 'v' && name[4] == '/') {
+        name += 5;
+    }
+    for (block_device_t* dev = devices; dev; dev = dev->next) {
+        if (str_eq(dev->name, name)) return dev;
+    }
+    return NULL;
+}
+
+block_device_t* block_next(block_device_t* dev) {
+    return dev ? dev->next : devices;
+}
+
+int block_register(block_device_t* dev) {
+    if (block_find(dev->name)) return -1;
+
+    block_device_init(dev);
+
+    /* Append, so devices list in probe order */
+    block_device_t** link = &devices;
+    while (*link) link = &(*link)->next;
+    dev->next = NULL;
+    *link = dev;
+
+    uint64_t bytes = dev->sectors << BLOCK_SECTOR_SHIFT;
+    devfs_register(dev->name, FS_BLOCKDEV, &blockdev_ops, dev->major, dev->minor,
+                   bytes > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)bytes, dev);
+    return 0;
+}
+
+void block_init(void) {
+    block_register_sched(&noop_sched);
+    block_register_sched(&deadline_sched);
+}
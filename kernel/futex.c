@@ -0,0 +1,102 @@
+/**
+ * ClaudeOS Futexes - futex.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Futex wait/wake hashed on physical address
+ */
+
+#include "types.h"
+#include "futex.h"
+#include "paging.h"
+#include "pmm.h"
+#include "process.h"
+#include "syscall.h"
+#include "idt.h"
+
+/* Waiters, hashed by futex key; several keys may share a bucket */
+static wait_queue_t futex_buckets[FUTEX_HASH_SIZE];
+
+/**
+ * Compute the key (physical address) of a futex word
+ * The word must already be present (the caller has read it).
+ */
+static bool futex_key(volatile uint32_t* uaddr, uint32_t* key) {
+    uint32_t va = (uint32_t)uaddr;
+    uint32_t pte = paging_get_pte(va & PAGE_MASK);
+    if (!(pte & PTE_PRESENT)) {
+        return false;
+    }
+    *key = (pte & PTE_FRAME) | (va & ~PAGE_MASK);
+    return true;
+}
+
+static wait_queue_t* futex_bucket(uint32_t key) {
+    /* Fibonacci hashing on the word index */
+    uint32_t hash = (key >> 2) * 0x9E3779B9u;
+    return &futex_buckets[hash >> (32 - FUTEX_HASH_BITS)];
+}
+
+static bool futex_addr_ok(volatile uint32_t* uaddr) {
+    return uaddr && ((uint32_t)uaddr & 3) == 0;
+}
+
+/**
+ * Initialize the futex wait buckets
+ */
+void futex_init(void) {
+    for (int i = 0; i < FUTEX_HASH_SIZE; i++) {
+        wait_queue_init(&futex_buckets[i]);
+    }
+}
+
+/**
+ * Sleep if the futex word still holds the expected value
+ */
+int32_t futex_wait(volatile uint32_t* uaddr, uint32_t val) {
+    if (!futex_addr_ok(uaddr)) {
+        return SYSCALL_EINVAL;
+    }
+
+    /* The value check and going to sleep must be atomic against wakers */
+    uint32_t irq = irq_save();
+
+    /* Reading the word also faults in a not-yet-populated mmap page */
+    if (*uaddr != val) {
+        irq_restore(irq);
+        return SYSCALL_EAGAIN;
+    }
+
+    uint32_t key;
+    if (!futex_key(uaddr, &key)) {
+        irq_restore(irq);
+        return SYSCALL_EINVAL;
+    }
+
+    wait_queue_sleep_key(futex_bucket(key), key);
+
+    irq_restore(irq);
+    return SYSCALL_SUCCESS;
+}
+
+/**
+ * Wake waiters on a futex word
+ */
+int32_t futex_wake(volatile uint32_t* uaddr, int32_t count) {
+    if (!futex_addr_ok(uaddr)) {
+        return SYSCALL_EINVAL;
+    }
+    if (count <= 0) {
+        return 0;
+    }
+
+    uint32_t irq = irq_save();
+
+    /* Nobody can be waiting on a page that was never touched */
+    uint32_t key;
+    int32_t woken = 0;
+    if (futex_key(uaddr, &key)) {
+        woken = wait_queue_wake_key(futex_bucket(key), key, count);
+    }
+
+    irq_restore(irq);
+    return woken;
+}
@@ -0,0 +1,231 @@
+/**
+ * ClaudeOS IPC - ipc.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Synchronous message passing with direct handoff
+ *
+ * Fast path (partner already waiting): copy the message into the
+ * partner's buffer and process_handoff() to it, so a call/reply round
+ * trip is two direct switches with no run queue scan. Slow path: the
+ * sender queues itself on the receiver's ipc_senders wait queue and the
+ * receiver pulls the message when it next calls ipc_recv().
+ */
+
+#include "types.h"
+#include "ipc.h"
+#include "process.h"
+#include "syscall.h"
+#include "idt.h"
+
+/**
+ * Copy a message: inline words always, bulk payload up to the capacity
+ * of the destination buffer
+ */
+static void ipc_copy(ipc_msg_t* dst, const ipc_msg_t* src) {
+    dst->label = src->label;
+    for (int i = 0; i < IPC_MSG_WORDS; i++) {
+        dst->words[i] = src->words[i];
+    }
+
+    uint32_t n = 0;
+    if (src->buf && dst->buf) {
+        n = src->len < dst->len ? src->len : dst->len;
+        const uint8_t* from = (const uint8_t*)src->buf;
+        uint8_t* to = (uint8_t*)dst->buf;
+        for (uint32_t i = 0; i < n; i++) {
+            to[i] = from[i];
+        }
+    }
+    dst->len = n;
+}
+
+/**
+ * Wake a blocked partner with a result
+ */
+static void ipc_complete(process_t* proc, int32_t result) {
+    proc->ipc_state = IPC_IDLE;
+    proc->ipc_result = result;
+    if (proc->state == PROCESS_STATE_BLOCKED) {
+        proc->state = PROCESS_STATE_READY;
+    }
+}
+
+/**
+ * Reset a process's IPC state
+ */
+void ipc_process_init(process_t* proc) {
+    proc->ipc_state = IPC_IDLE;
+    proc->ipc_peer = 0;
+    proc->ipc_msg = NULL;
+    proc->ipc_result = 0;
+    wait_queue_init(&proc->ipc_senders);
+}
+
+/**
+ * Fail every IPC partner blocked on an exiting process
+ */
+void ipc_release(process_t* proc) {
+    uint32_t irq = irq_save();
+
+    /* A reply must never be delivered to us now */
+    proc->ipc_state = IPC_IDLE;
+
+    /* Queued senders and callers */
+    wait_entry_t* entry = proc->ipc_senders.head;
+    proc->ipc_senders.head = NULL;
+    while (entry) {
+        wait_entry_t* next = entry->next;
+        ipc_complete(entry->proc, SYSCALL_ESRCH);
+        entry = next;
+    }
+
+    /* Callers waiting for our reply, receivers waiting for us to send */
+    uint32_t pids[MAX_PROCESSES];
+    uint32_t count = process_list(pids, MAX_PROCESSES);
+    for (uint32_t i = 0; i < count; i++) {
+        process_t* p = process_get(pids[i]);
+        if (p && p->ipc_peer == proc->pid &&
+            (p->ipc_state == IPC_REPLY_WAIT || p->ipc_state == IPC_RECEIVING)) {
+            ipc_complete(p, SYSCALL_ESRCH);
+        }
+    }
+
+    irq_restore(irq);
+}
+
+/**
+ * Common path for send and call
+ */
+static int32_t ipc_transfer(uint32_t dest_pid, ipc_msg_t* msg, bool call) {
+    process_t* self = process_current();
+    if (!self || !msg) {
+        return SYSCALL_EINVAL;
+    }
+
+    uint32_t irq = irq_save();
+
+    process_t* dest = process_get(dest_pid);
+    if (!dest || dest == self || dest->state == PROCESS_STATE_TERMINATED) {
+        irq_restore(irq);
+        return SYSCALL_ESRCH;
+    }
+
+    self->ipc_msg = msg;
+    self->ipc_peer = dest->pid;
+    self->ipc_result = SYSCALL_SUCCESS;
+
+    if (dest->ipc_state == IPC_RECEIVING &&
+        (dest->ipc_peer == 0 || dest->ipc_peer == self->pid)) {
+        /* Fast path: receiver is waiting, deliver and switch to it */
+        ipc_copy(dest->ipc_msg, msg);
+        dest->ipc_peer = self->pid;
+        ipc_complete(dest, SYSCALL_SUCCESS);
+
+        if (call) {
+            self->ipc_state = IPC_REPLY_WAIT;
+            self->state = PROCESS_STATE_BLOCKED;
+        }
+        process_handoff(dest);
+    } else {
+        /* Slow path: queue up until the receiver asks for a message */
+        self->ipc_state = call ? IPC_CALLING : IPC_SENDING;
+        wait_queue_sleep_key(&dest->ipc_senders, self->pid);
+    }
+
+    /* A caller only gets here once the reply (or an error) is in */
+    while (self->ipc_state == IPC_REPLY_WAIT) {
+        process_block();
+    }
+
+    irq_restore(irq);
+    return self->ipc_result;
+}
+
+/**
+ * Send a message
+ */
+int32_t ipc_send(uint32_t dest, ipc_msg_t* msg) {
+    return ipc_transfer(dest, msg, false);
+}
+
+/**
+ * Send a message and wait for the reply
+ */
+int32_t ipc_call(uint32_t dest, ipc_msg_t* msg) {
+    return ipc_transfer(dest, msg, true);
+}
+
+/**
+ * Receive a message
+ */
+int32_t ipc_recv(uint32_t from, ipc_msg_t* msg) {
+    process_t* self = process_current();
+    if (!self || !msg) {
+        return SYSCALL_EINVAL;
+    }
+
+    uint32_t irq = irq_save();
+
+    if (from && !process_get(from)) {
+        irq_restore(irq);
+        return SYSCALL_ESRCH;
+    }
+
+    /* Take a queued sender if there is one */
+    for (wait_entry_t** link = &self->ipc_senders.head; *link; link = &(*link)->next) {
+        process_t* sender = (*link)->proc;
+        if (from && sender->pid != from) {
+            continue;
+        }
+
+        *link = (*link)->next;
+        ipc_copy(msg, sender->ipc_msg);
+
+        if (sender->ipc_state == IPC_CALLING) {
+            sender->ipc_state = IPC_REPLY_WAIT;   /* Stays blocked */
+        } else {
+            ipc_complete(sender, SYSCALL_SUCCESS);
+        }
+
+        irq_restore(irq);
+        return (int32_t)sender->pid;
+    }
+
+    /* Nobody waiting: block until a sender delivers directly */
+    self->ipc_msg = msg;
+    self->ipc_peer = from;
+    self->ipc_result = SYSCALL_SUCCESS;
+    self->ipc_state = IPC_RECEIVING;
+    while (self->ipc_state == IPC_RECEIVING) {
+        process_block();
+    }
+
+    int32_t result = self->ipc_result < 0 ? self->ipc_result : (int32_t)self->ipc_peer;
+    irq_restore(irq);
+    return result;
+}
+
+/**
+ * Reply to a caller and switch straight back to it
+ */
+int32_t ipc_reply(uint32_t to, ipc_msg_t* msg) {
+    process_t* self = process_current();
+    if (!self || !msg) {
+        return SYSCALL_EINVAL;
+    }
+
+    uint32_t irq = irq_save();
+
+    process_t* client = process_get(to);
+    if (!client || client->state == PROCESS_STATE_TERMINATED ||
+        client->ipc_state != IPC_REPLY_WAIT || client->ipc_peer != self->pid) {
+        irq_restore(irq);
+        return SYSCALL_ESRCH;
+    }
+
+    ipc_copy(client->ipc_msg, msg);
+    ipc_complete(client, SYSCALL_SUCCESS);
+    process_handoff(client);
+
+    irq_restore(irq);
+    return SYSCALL_SUCCESS;
+}
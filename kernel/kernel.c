@@ -13,9 +13,23 @@
 #include "timer.h"
 #include "process.h"
 #include "syscall.h"
+#include "pmm.h"
+#include "paging.h"
+#include "mman.h"
+#include "shm.h"
+#include "futex.h"
+#include "timerfd.h"
+#include "block.h"
+#include "pci.h"
+#include "ata.h"
+#include "virtio.h"
+#include "ahci.h"
+#include "nvme.h"
+#include "ramdisk.h"
 
 /* External functions from other components */
 extern void vfs_init(void);      /* From /fs/ramfs.c */
+extern void pcache_start_flusher(void);  /* From /fs/pagecache.c */
 extern void shell_main(void);    /* From /shell/shell.c */
 
 /* Kernel version */
@@ -68,8 +82,16 @@ void kernel_main(void) {
     /* Initialize kernel heap */
     kmalloc_init();
 
+    /* Initialize page frame allocator and enable paging */
+    pmm_init();
+    paging_init();
+    mmap_init();
+    shm_init();
+    futex_init();
+
     /* Initialize PIT timer (100 Hz) */
     timer_init();
+    timerfd_init();
 
     /* Initialize system call interface */
     syscall_init();
@@ -77,9 +99,23 @@ void kernel_main(void) {
     /* Initialize virtual filesystem */
     vfs_init();
 
+    /* Block layer (disk drivers register with it) */
+    block_init();
+    ramdisk_init();
+
+    /* Find disk controllers */
+    pci_init();
+    ata_init();
+    virtio_blk_init();
+    ahci_init();
+    nvme_init();
+
     /* Initialize process scheduler */
     process_init();
 
+    /* Background write-back of dirty file pages */
+    pcache_start_flusher();
+
     /* All systems go! */
     vga_puts("\n");
     vga_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
@@ -11,6 +11,7 @@
 #include "types.h"
 #include "kmalloc.h"
 #include "vga.h"
+#include "idt.h"
 
 /* Current allocation pointer */
 static uint32_t heap_current = HEAP_START;
@@ -36,8 +37,12 @@ void* kmalloc(size_t size) {
     /* Align to 4 bytes for efficiency */
     size = (size + 3) & ~3;
 
+    /* Processes are preempted, so the bump must be atomic */
+    uint32_t irq = irq_save();
+
     /* Check if we have enough space */
     if (heap_current + size > HEAP_END) {
+        irq_restore(irq);
         vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_RED);
         vga_puts("\n*** KERNEL: OUT OF MEMORY ***\n");
         return NULL;
@@ -47,6 +52,7 @@ void* kmalloc(size_t size) {
     void* ptr = (void*)heap_current;
     heap_current += size;
 
+    irq_restore(irq);
     return ptr;
 }
 
@@ -58,6 +64,8 @@ void* kmalloc_aligned(size_t size, size_t alignment) {
         return NULL;
     }
 
+    uint32_t irq = irq_save();
+
     /* Align current pointer */
     uint32_t aligned = (heap_current + alignment - 1) & ~(alignment - 1);
 
@@ -66,6 +74,7 @@ void* kmalloc_aligned(size_t size, size_t alignment) {
 
     /* Check if we have enough space */
     if (aligned + size > HEAP_END) {
+        irq_restore(irq);
         vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_RED);
         vga_puts("\n*** KERNEL: OUT OF MEMORY ***\n");
         return NULL;
@@ -74,6 +83,7 @@ void* kmalloc_aligned(size_t size, size_t alignment) {
     /* Bump allocate from aligned position */
     heap_current = aligned + size;
 
+    irq_restore(irq);
     return (void*)aligned;
 }
 
@@ -0,0 +1,478 @@
+/**
+ * ClaudeOS Memory Mapping - mmap.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Demand-paged file and anonymous mappings
+ *
+ * Mappings live in the shared mmap window (MMAP_BASE..MMAP_END) and are
+ * populated lazily by the page fault handler:
+ *
+ *   - MAP_SHARED file pages map the filesystem's own frame, so reads and
+ *     writes through the mapping touch the file data with no copy.
+ *   - MAP_PRIVATE file pages map the same frame read-only and marked
+ *     PTE_COW; the first write copies the page.
+ *   - Anonymous pages are zero-filled on first touch.
+ */
+
+#include "types.h"
+#include "mman.h"
+#include "paging.h"
+#include "pmm.h"
+#include "process.h"
+#include "syscall.h"
+#include "idt.h"
+#include "vga.h"
+#include "../fs/vfs.h"
+
+/* Area pool and the sorted list of active areas */
+static vm_area_t area_pool[MAX_VM_AREAS];
+static vm_area_t* free_areas = NULL;
+static vm_area_t* area_list = NULL;
+
+static vm_area_t* area_alloc(void) {
+    vm_area_t* area = free_areas;
+    if (area) {
+        free_areas = area->next;
+        area->next = NULL;
+    }
+    return area;
+}
+
+static void area_free(vm_area_t* area) {
+    /* The mapping pinned its file; an unlinked one may be freed here */
+    if (area->node) {
+        vfs_node_put(area->node);
+    }
+    area->node = NULL;
+    area->owner = NULL;
+    area->next = free_areas;
+    free_areas = area;
+}
+
+/**
+ * Find the area containing an address
+ */
+static vm_area_t* find_area(uint32_t addr) {
+    for (vm_area_t* a = area_list; a && a->start <= addr; a = a->next) {
+        if (addr < a->end) {
+            return a;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Insert an area keeping the list sorted by start address
+ */
+static void insert_area(vm_area_t* area) {
+    vm_area_t** link = &area_list;
+    while (*link && (*link)->start < area->start) {
+        link = &(*link)->next;
+    }
+    area->next = *link;
+    *link = area;
+}
+
+/**
+ * Check that [start, end) does not overlap any area
+ */
+static bool range_free(uint32_t start, uint32_t end) {
+    if (start < MMAP_BASE || end > MMAP_END || end <= start) {
+        return false;
+    }
+    for (vm_area_t* a = area_list; a && a->start < end; a = a->next) {
+        if (a->end > start) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Check that no area overlapping [start, end) belongs to another process
+ */
+static bool range_owned(uint32_t start, uint32_t end) {
+    struct process* self = process_current();
+    for (vm_area_t* a = area_list; a && a->start < end; a = a->next) {
+        if (a->end > start && a->owner != self) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * First-fit search for a free virtual range
+ */
+static uint32_t find_gap(uint32_t length) {
+    uint32_t candidate = MMAP_BASE;
+    for (vm_area_t* a = area_list; a; a = a->next) {
+        if (a->start >= candidate + length) {
+            break;
+        }
+        if (a->end > candidate) {
+            candidate = a->end;
+        }
+    }
+    if (candidate + length > MMAP_END || candidate + length < candidate) {
+        return 0;
+    }
+    return candidate;
+}
+
+/**
+ * Split an area at 'addr' so that a new area starts there
+ * @return The upper half, or NULL if no split was needed/possible
+ */
+static vm_area_t* split_area(vm_area_t* area, uint32_t addr) {
+    if (addr <= area->start || addr >= area->end) {
+        return NULL;
+    }
+
+    vm_area_t* upper = area_alloc();
+    if (!upper) {
+        return NULL;
+    }
+
+    *upper = *area;
+    if (upper->node) {
+        vfs_node_get(upper->node);
+    }
+    upper->start = addr;
+    upper->pgoff = area->pgoff + ((addr - area->start) >> PAGE_SHIFT);
+    area->end = addr;
+    area->next = upper;
+    return upper;
+}
+
+/**
+ * PTE flags for a page in an area
+ */
+static uint32_t area_pte_flags(vm_area_t* area, bool cow) {
+    if (area->prot == PROT_NONE) {
+        return 0;   /* Parked: frame kept, page not present */
+    }
+
+    uint32_t flags = PTE_PRESENT;
+    if (cow) {
+        flags |= PTE_COW;
+    } else if (area->prot & PROT_WRITE) {
+        flags |= PTE_WRITABLE;
+    }
+    return flags;
+}
+
+/**
+ * Drop the frames of pages in [start, end)
+ */
+static void unmap_pages(uint32_t start, uint32_t end) {
+    for (uint32_t va = start; va < end; va += PAGE_SIZE) {
+        uint32_t old = paging_unmap(va);
+        if (old & PTE_FRAME) {
+            pmm_unref_page(old & PTE_FRAME);
+        }
+    }
+}
+
+/**
+ * Page fault resolver
+ */
+static int mmap_fault(uint32_t fault_addr, bool present) {
+    vm_area_t* area = find_area(fault_addr);
+    if (!area || area->prot == PROT_NONE) {
+        return -1;
+    }
+
+    uint32_t va = fault_addr & PAGE_MASK;
+    uint32_t pte = paging_get_pte(va);
+
+    if (!present) {
+        /* Parked page (was PROT_NONE): just make it present again */
+        if (pte & PTE_FRAME) {
+            paging_set_flags(va, area_pte_flags(area, (pte & PTE_COW) != 0));
+            return 0;
+        }
+
+        uint32_t frame;
+        bool cow = false;
+
+        if (!area->node) {
+            /* Anonymous: zero-fill on demand */
+            frame = pmm_alloc_page();
+            if (!frame) return -1;
+            pmm_zero_page(frame);
+        } else {
+            uint32_t pgoff = area->pgoff + ((va - area->start) >> PAGE_SHIFT);
+            int write = (area->flags & MAP_SHARED) && (area->prot & PROT_WRITE);
+            if (vfs_map_page(area->node, pgoff, &frame, write) != 0) {
+                return -1;
+            }
+            cow = (area->flags & MAP_PRIVATE) != 0;
+        }
+
+        if (paging_map(va, frame, area_pte_flags(area, cow)) != 0) {
+            pmm_unref_page(frame);
+            return -1;
+        }
+        return 0;
+    }
+
+    /* Present page: only a write to a copy-on-write page is resolvable */
+    if (!(area->prot & PROT_WRITE) || !(pte & PTE_COW)) {
+        return -1;
+    }
+
+    uint32_t old = pte & PTE_FRAME;
+    if (pmm_page_refcount(old) == 1) {
+        /* Last user of the frame: take it over */
+        paging_set_flags(va, PTE_PRESENT | PTE_WRITABLE);
+        return 0;
+    }
+
+    uint32_t copy = pmm_alloc_page();
+    if (!copy) return -1;
+    pmm_copy_page(copy, old);
+    paging_map(va, copy, PTE_WRITABLE);
+    pmm_unref_page(old);
+    return 0;
+}
+
+/**
+ * Initialize mmap
+ */
+void mmap_init(void) {
+    free_areas = NULL;
+    area_list = NULL;
+    for (int i = MAX_VM_AREAS - 1; i >= 0; i--) {
+        area_free(&area_pool[i]);
+    }
+
+    paging_set_fault_handler(mmap_fault);
+}
+
+/**
+ * Create a mapping
+ */
+int32_t mmap_map(uint32_t addr, uint32_t length, int prot, int flags, int fd, uint32_t offset) {
+    fs_node_t* node = NULL;
+    if (!(flags & MAP_ANONYMOUS)) {
+        node = vfs_fd_node(fd);
+        if (!node) {
+            return SYSCALL_EBADF;
+        }
+        if (node->type != FS_FILE) {
+            return SYSCALL_EACCES;
+        }
+        /* Shared writes land in the file, so the fd must allow writing */
+        if ((flags & MAP_SHARED) && (prot & PROT_WRITE) &&
+            !(vfs_fd_flags(fd) & (O_WRONLY | O_RDWR))) {
+            return SYSCALL_EACCES;
+        }
+    }
+    return mmap_map_node(addr, length, prot, flags, node, offset);
+}
+
+/**
+ * Create a mapping of a node (or anonymous memory if node is NULL)
+ */
+int32_t mmap_map_node(uint32_t addr, uint32_t length, int prot, int flags,
+                      struct fs_node* node, uint32_t offset) {
+    if (length == 0 || (offset & ~PAGE_MASK)) {
+        return SYSCALL_EINVAL;
+    }
+
+    /* Exactly one of MAP_SHARED / MAP_PRIVATE */
+    int share = flags & (MAP_SHARED | MAP_PRIVATE);
+    if (share != MAP_SHARED && share != MAP_PRIVATE) {
+        return SYSCALL_EINVAL;
+    }
+
+    if (node && !vfs_can_map(node)) {
+        return SYSCALL_ENOTSUP;
+    }
+
+    length = PAGE_ALIGN(length);
+    if (length == 0) {
+        return SYSCALL_EINVAL;  /* Wrapped around */
+    }
+
+    uint32_t irq = irq_save();
+
+    uint32_t start = addr & PAGE_MASK;
+    if (!start || !range_free(start, start + length)) {
+        start = find_gap(length);
+    }
+
+    vm_area_t* area = start ? area_alloc() : NULL;
+    if (!area) {
+        irq_restore(irq);
+        return SYSCALL_ENOMEM;
+    }
+
+    area->start = start;
+    area->end = start + length;
+    area->prot = prot;
+    area->flags = flags;
+    area->node = node;
+    if (node) {
+        vfs_node_get(node);
+    }
+    area->pgoff = offset >> PAGE_SHIFT;
+    area->owner = process_current();
+    insert_area(area);
+
+    irq_restore(irq);
+    return (int32_t)start;
+}
+
+/**
+ * Split areas so that none straddles 'start' or 'end'
+ * @return false if an area could not be split (pool exhausted)
+ */
+static bool split_range(uint32_t start, uint32_t end) {
+    vm_area_t* area = find_area(start);
+    if (area && area->start < start && !split_area(area, start)) {
+        return false;
+    }
+    area = find_area(end - 1);
+    if (area && area->end > end && !split_area(area, end)) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Remove mappings
+ */
+int32_t mmap_unmap(uint32_t addr, uint32_t length) {
+    if ((addr & ~PAGE_MASK) || length == 0) {
+        return SYSCALL_EINVAL;
+    }
+
+    uint32_t start = addr;
+    uint32_t end = addr + PAGE_ALIGN(length);
+
+    uint32_t irq = irq_save();
+
+    if (!range_owned(start, end)) {
+        irq_restore(irq);
+        return SYSCALL_EACCES;
+    }
+    if (!split_range(start, end)) {
+        irq_restore(irq);
+        return SYSCALL_ENOMEM;
+    }
+
+    vm_area_t** link = &area_list;
+    while (*link && (*link)->start < end) {
+        vm_area_t* area = *link;
+        if (area->start < start) {
+            link = &area->next;
+            continue;
+        }
+
+        unmap_pages(area->start, area->end);
+        *link = area->next;
+        area_free(area);
+    }
+
+    irq_restore(irq);
+    return SYSCALL_SUCCESS;
+}
+
+/**
+ * Change protection
+ */
+int32_t mmap_protect(uint32_t addr, uint32_t length, int prot) {
+    if ((addr & ~PAGE_MASK) || length == 0) {
+        return SYSCALL_EINVAL;
+    }
+
+    uint32_t start = addr;
+    uint32_t end = addr + PAGE_ALIGN(length);
+
+    uint32_t irq = irq_save();
+
+    if (!range_owned(start, end)) {
+        irq_restore(irq);
+        return SYSCALL_EACCES;
+    }
+
+    /* Every page in the range must be mapped */
+    uint32_t covered = start;
+    for (vm_area_t* a = area_list; a && a->start < end; a = a->next) {
+        if (a->end <= covered) continue;
+        if (a->start > covered) break;
+        covered = a->end;
+    }
+    if (covered < end || !split_range(start, end)) {
+        irq_restore(irq);
+        return SYSCALL_ENOMEM;
+    }
+
+    for (vm_area_t* area = area_list; area && area->start < end; area = area->next) {
+        if (area->start < start) continue;
+
+        /* Shared file pages becoming writable refault, so the cache sees it */
+        if (area->node && (area->flags & MAP_SHARED) &&
+            (prot & PROT_WRITE) && !(area->prot & PROT_WRITE)) {
+            unmap_pages(area->start, area->end);
+        }
+        area->prot = prot;
+        for (uint32_t va = area->start; va < area->end; va += PAGE_SIZE) {
+            uint32_t pte = paging_get_pte(va);
+            if (pte & PTE_FRAME) {
+                paging_set_flags(va, area_pte_flags(area, (pte & PTE_COW) != 0));
+            }
+        }
+    }
+
+    irq_restore(irq);
+    return SYSCALL_SUCCESS;
+}
+
+/**
+ * Release all mappings of a process
+ */
+void mmap_release(struct process* proc) {
+    uint32_t irq = irq_save();
+
+    vm_area_t** link = &area_list;
+    while (*link) {
+        vm_area_t* area = *link;
+        if (area->owner == proc) {
+            unmap_pages(area->start, area->end);
+            *link = area->next;
+            area_free(area);
+        } else {
+            link = &area->next;
+        }
+    }
+
+    irq_restore(irq);
+}
+
+/**
+ * Look up the area containing an address
+ */
+vm_area_t* mmap_lookup(uint32_t addr) {
+    uint32_t irq = irq_save();
+    vm_area_t* area = find_area(addr);
+    irq_restore(irq);
+    return area;
+}
+
+/**
+ * Check whether any area still maps a node
+ */
+bool mmap_node_mapped(struct fs_node* node) {
+    uint32_t irq = irq_save();
+    bool mapped = false;
+    for (vm_area_t* a = area_list; a; a = a->next) {
+        if (a->node == node) {
+            mapped = true;
+            break;
+        }
+    }
+    irq_restore(irq);
+    return mapped;
+}
@@ -0,0 +1,191 @@
+/**
+ * ClaudeOS Paging - paging.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Page directory setup, mapping primitives and page faults
+ */
+
+#include "types.h"
+#include "paging.h"
+#include "pmm.h"
+#include "idt.h"
+#include "vga.h"
+
+/* Number of page tables needed for the identity map */
+#define IDENTITY_TABLES (PAGING_IDENTITY_END / (1024 * 4096))
+
+/* Kernel page directory and the identity-map page tables */
+static uint32_t page_directory[1024] __attribute__((aligned(4096)));
+static uint32_t identity_tables[IDENTITY_TABLES][1024] __attribute__((aligned(4096)));
+
+static page_fault_handler_t fault_handler = NULL;
+
+extern void kernel_panic(const char* message);
+
+static inline void invlpg(uint32_t virt) {
+    __asm__ volatile ("invlpg (%0)" : : "r"(virt) : "memory");
+}
+
+static inline uint32_t read_cr2(void) {
+    uint32_t val;
+    __asm__ volatile ("mov %%cr2, %0" : "=r"(val));
+    return val;
+}
+
+/**
+ * Get (optionally creating) the page table covering a virtual address
+ */
+static uint32_t* get_table(uint32_t virt, bool create) {
+    uint32_t pde = page_directory[virt >> 22];
+
+    if (pde & PTE_PRESENT) {
+        return (uint32_t*)(pde & PTE_FRAME);
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    /* Page tables come from the (identity-mapped) frame pool */
+    uint32_t table = pmm_alloc_page();
+    if (!table) {
+        return NULL;
+    }
+    pmm_zero_page(table);
+    page_directory[virt >> 22] = table | PTE_PRESENT | PTE_WRITABLE;
+    return (uint32_t*)table;
+}
+
+/**
+ * Page fault handler (INT 14)
+ */
+static void page_fault_isr(void) {
+    uint32_t addr = read_cr2();
+    uint32_t pte = paging_get_pte(addr);
+
+    if (fault_handler && fault_handler(addr, (pte & PTE_PRESENT) != 0) == 0) {
+        return;
+    }
+
+    /* Unresolvable fault */
+    char hex[11] = "0x00000000";
+    for (int i = 9; i >= 2; i--) {
+        int digit = addr & 0xF;
+        hex[i] = digit < 10 ? '0' + digit : 'A' + digit - 10;
+        addr >>= 4;
+    }
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_RED);
+    vga_puts("\n*** PAGE FAULT at ");
+    vga_puts(hex);
+    vga_puts(" ***\n");
+    kernel_panic("Unhandled page fault");
+}
+
+/**
+ * Initialize paging
+ */
+void paging_init(void) {
+    for (uint32_t i = 0; i < 1024; i++) {
+        page_directory[i] = 0;
+    }
+
+    /* Identity map the low region: kernel, heap, VGA and frame pool */
+    for (uint32_t t = 0; t < IDENTITY_TABLES; t++) {
+        for (uint32_t i = 0; i < 1024; i++) {
+            uint32_t phys = (t * 1024 + i) * PAGE_SIZE;
+            identity_tables[t][i] = phys | PTE_PRESENT | PTE_WRITABLE;
+        }
+        page_directory[t] = (uint32_t)identity_tables[t] | PTE_PRESENT | PTE_WRITABLE;
+    }
+
+    register_interrupt_handler(INT_PAGE_FAULT, page_fault_isr);
+
+    /* Load CR3 and enable paging with supervisor write-protect (CR0.WP)
+     * so read-only PTEs are honoured by kernel-mode writes too. */
+    __asm__ volatile (
+        "mov %0, %%cr3\n"
+        "mov %%cr0, %%eax\n"
+        "or $0x80010000, %%eax\n"
+        "mov %%eax, %%cr0\n"
+        : : "r"((uint32_t)page_directory) : "eax", "memory"
+    );
+
+    vga_puts("[KERNEL] Paging enabled (32MB identity map, mmap window at 0x40000000)\n");
+}
+
+/**
+ * Map a page
+ */
+int paging_map(uint32_t virt, uint32_t phys, uint32_t flags) {
+    uint32_t irq = irq_save();
+    uint32_t* table = get_table(virt, true);
+    if (!table) {
+        irq_restore(irq);
+        return -1;
+    }
+
+    table[(virt >> 12) & 0x3FF] = (phys & PTE_FRAME) | (flags & 0xFFF) | PTE_PRESENT;
+    invlpg(virt);
+    irq_restore(irq);
+    return 0;
+}
+
+/**
+ * Unmap a page
+ */
+uint32_t paging_unmap(uint32_t virt) {
+    uint32_t irq = irq_save();
+    uint32_t* table = get_table(virt, false);
+    uint32_t old = 0;
+
+    if (table) {
+        old = table[(virt >> 12) & 0x3FF];
+        table[(virt >> 12) & 0x3FF] = 0;
+        invlpg(virt);
+    }
+    irq_restore(irq);
+    return old;
+}
+
+/**
+ * Look up a PTE
+ */
+uint32_t paging_get_pte(uint32_t virt) {
+    uint32_t* table = get_table(virt, false);
+    if (!table) return 0;
+    return table[(virt >> 12) & 0x3FF];
+}
+
+/**
+ * Change mapping flags
+ */
+void paging_set_flags(uint32_t virt, uint32_t flags) {
+    uint32_t* table = get_table(virt, false);
+    if (!table) return;
+
+    uint32_t* pte = &table[(virt >> 12) & 0x3FF];
+    if (*pte & PTE_FRAME) {
+        *pte = (*pte & PTE_FRAME) | (flags & 0xFFF);
+        invlpg(virt);
+    }
+}
+
+/**
+ * Identity map MMIO registers with caching disabled
+ */
+int paging_map_mmio(uint32_t phys, uint32_t size) {
+    uint32_t start = phys & PAGE_MASK;
+    uint32_t end = PAGE_ALIGN(phys + size);
+
+    for (uint32_t addr = start; addr < end; addr += PAGE_SIZE) {
+        if (paging_map(addr, addr, PTE_WRITABLE | PTE_PCD | PTE_PWT) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Install the page fault resolver
+ */
+void paging_set_fault_handler(page_fault_handler_t handler) {
+    fault_handler = handler;
+}
@@ -0,0 +1,233 @@
+/**
+ * ClaudeOS Pipes - pipe.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Page-sized ring buffer with reader/writer wait queues
+ */
+
+#include "types.h"
+#include "pipe.h"
+#include "process.h"
+#include "slab.h"
+#include "pmm.h"
+#include "idt.h"
+#include "poll.h"
+#include "../fs/vfs.h"
+
+typedef struct {
+    uint8_t* buf;               /* Ring buffer (one page frame) */
+    uint32_t head;              /* Next byte to read */
+    uint32_t count;             /* Bytes buffered */
+    uint32_t readers;           /* Open read ends */
+    uint32_t writers;           /* Open write ends */
+    wait_queue_t read_wait;     /* Readers waiting for data */
+    wait_queue_t write_wait;    /* Writers waiting for space */
+    fs_node_t read_node;
+    fs_node_t write_node;
+} pipe_t;
+
+static slab_t pipe_slab = SLAB_INIT(pipe_t);
+static uint32_t next_pipe_ino = 1;
+
+/* Release the ring once both sides are gone */
+static void pipe_maybe_free(pipe_t* pipe) {
+    if (pipe->readers == 0 && pipe->writers == 0 && pipe->buf) {
+        pmm_free_pages((uint32_t)pipe->buf, 1);
+        pipe->buf = NULL;
+        slab_free(&pipe_slab, pipe);
+    }
+}
+
+/*
+ * ===========================================================================
+ * Read End
+ * ===========================================================================
+ */
+
+static int pipe_read_open(fs_node_t* node, int flags) {
+    (void)flags;
+    pipe_t* pipe = (pipe_t*)node->data;
+    uint32_t irq = irq_save();
+    pipe->readers++;
+    irq_restore(irq);
+    return 0;
+}
+
+static int pipe_read_close(fs_node_t* node) {
+    pipe_t* pipe = (pipe_t*)node->data;
+    uint32_t irq = irq_save();
+    if (pipe->readers > 0 && --pipe->readers == 0) {
+        /* Writers blocked on a full pipe must see the broken pipe */
+        wait_queue_wake_all(&pipe->write_wait);
+    }
+    pipe_maybe_free(pipe);
+    irq_restore(irq);
+    return 0;
+}
+
+static ssize_t pipe_read(fs_node_t* node, void* buf, size_t size, size_t offset) {
+    (void)offset;
+    pipe_t* pipe = (pipe_t*)node->data;
+    uint8_t* dst = (uint8_t*)buf;
+
+    if (size == 0) return 0;
+
+    uint32_t irq = irq_save();
+
+    /* Block until data arrives or every writer is gone */
+    while (pipe->count == 0 && pipe->writers > 0) {
+        wait_queue_sleep(&pipe->read_wait);
+    }
+
+    uint32_t n = pipe->count < size ? pipe->count : (uint32_t)size;
+    for (uint32_t i = 0; i < n; i++) {
+        dst[i] = pipe->buf[pipe->head];
+        pipe->head = (pipe->head + 1) % PIPE_BUF_SIZE;
+    }
+    pipe->count -= n;
+
+    if (n > 0) {
+        wait_queue_wake_all(&pipe->write_wait);
+    }
+
+    irq_restore(irq);
+    return n;
+}
+
+static uint32_t pipe_read_poll(fs_node_t* node, poll_table_t* pt) {
+    pipe_t* pipe = (pipe_t*)node->data;
+    poll_wait(pt, &pipe->read_wait);
+
+    uint32_t mask = 0;
+    if (pipe->count > 0) mask |= POLLIN;
+    if (pipe->writers == 0) mask |= POLLHUP;
+    return mask;
+}
+
+static fs_ops_t pipe_read_ops = {
+    .open  = pipe_read_open,
+    .close = pipe_read_close,
+    .read  = pipe_read,
+    .poll  = pipe_read_poll,
+};
+
+/*
+ * ===========================================================================
+ * Write End
+ * ===========================================================================
+ */
+
+static int pipe_write_open(fs_node_t* node, int flags) {
+    (void)flags;
+    pipe_t* pipe = (pipe_t*)node->data;
+    uint32_t irq = irq_save();
+    pipe->writers++;
+    irq_restore(irq);
+    return 0;
+}
+
+static int pipe_write_close(fs_node_t* node) {
+    pipe_t* pipe = (pipe_t*)node->data;
+    uint32_t irq = irq_save();
+    if (pipe->writers > 0 && --pipe->writers == 0) {
+        /* Readers blocked on an empty pipe must see EOF */
+        wait_queue_wake_all(&pipe->read_wait);
+    }
+    pipe_maybe_free(pipe);
+    irq_restore(irq);
+    return 0;
+}
+
+static ssize_t pipe_write(fs_node_t* node, const void* buf, size_t size, size_t offset) {
+    (void)offset;
+    pipe_t* pipe = (pipe_t*)node->data;
+    const uint8_t* src = (const uint8_t*)buf;
+    uint32_t written = 0;
+
+    if (size == 0) return 0;
+
+    uint32_t irq = irq_save();
+
+    while (written < size) {
+        /* Backpressure: wait for the reader to drain some data */
+        while (pipe->count == PIPE_BUF_SIZE && pipe->readers > 0) {
+            wait_queue_sleep(&pipe->write_wait);
+        }
+        if (pipe->readers == 0) {
+            break;  /* Broken pipe */
+        }
+
+        uint32_t tail = (pipe->head + pipe->count) % PIPE_BUF_SIZE;
+        while (written < size && pipe->count < PIPE_BUF_SIZE) {
+            pipe->buf[tail] = src[written++];
+            tail = (tail + 1) % PIPE_BUF_SIZE;
+            pipe->count++;
+        }
+
+        wait_queue_wake_all(&pipe->read_wait);
+    }
+
+    irq_restore(irq);
+    return written > 0 ? (ssize_t)written : -1;
+}
+
+static uint32_t pipe_write_poll(fs_node_t* node, poll_table_t* pt) {
+    pipe_t* pipe = (pipe_t*)node->data;
+    poll_wait(pt, &pipe->write_wait);
+
+    uint32_t mask = 0;
+    if (pipe->count < PIPE_BUF_SIZE) mask |= POLLOUT;
+    if (pipe->readers == 0) mask |= POLLERR;
+    return mask;
+}
+
+static fs_ops_t pipe_write_ops = {
+    .open  = pipe_write_open,
+    .close = pipe_write_close,
+    .write = pipe_write,
+    .poll  = pipe_write_poll,
+};
+
+/*
+ * ===========================================================================
+ * Creation
+ * ===========================================================================
+ */
+
+static void pipe_init_node(fs_node_t* node, pipe_t* pipe, fs_ops_t* ops, uint32_t ino) {
+    for (uint32_t i = 0; i < sizeof(fs_node_t); i++) {
+        ((char*)node)[i] = 0;
+    }
+    node->name = "pipe";
+    node->type = FS_PIPE;
+    node->inode = ino;
+    node->data = pipe;
+    node->ops = ops;
+}
+
+int pipe_create(fs_node_t** read_end, fs_node_t** write_end) {
+    if (!read_end || !write_end) return -1;
+
+    pipe_t* pipe = (pipe_t*)slab_alloc(&pipe_slab);
+    if (!pipe) return -1;
+
+    pipe->buf = (uint8_t*)pmm_alloc_page();
+    if (!pipe->buf) {
+        slab_free(&pipe_slab, pipe);
+        return -1;
+    }
+
+    pipe->head = 0;
+    pipe->count = 0;
+    pipe->readers = 0;
+    pipe->writers = 0;
+    wait_queue_init(&pipe->read_wait);
+    wait_queue_init(&pipe->write_wait);
+
+    uint32_t ino = next_pipe_ino++;
+    pipe_init_node(&pipe->read_node, pipe, &pipe_read_ops, ino);
+    pipe_init_node(&pipe->write_node, pipe, &pipe_write_ops, ino);
+
+    *read_end = &pipe->read_node;
+    *write_end = &pipe->write_node;
+    return 0;
+}
@@ -0,0 +1,183 @@
+/**
+ * ClaudeOS Physical Memory Manager - pmm.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Reference-counted page frame allocator
+ *
+ * Frames in [PMM_POOL_START, PMM_POOL_END) are tracked by a 16-bit
+ * reference count each; a count of 0 means the frame is free. Shared
+ * mappings and copy-on-write take extra references, and a frame goes
+ * back to the pool when its last reference is dropped.
+ */
+
+#include "types.h"
+#include "pmm.h"
+#include "idt.h"
+#include "vga.h"
+
+/* Per-frame reference counts */
+static uint16_t frame_refs[PMM_POOL_PAGES];
+static uint32_t free_frames = 0;
+static uint32_t next_hint = 0;     /* Next-fit search start */
+
+static inline uint32_t frame_index(uint32_t addr) {
+    return (addr - PMM_POOL_START) >> PAGE_SHIFT;
+}
+
+static inline uint32_t frame_addr(uint32_t index) {
+    return PMM_POOL_START + (index << PAGE_SHIFT);
+}
+
+/**
+ * Initialize the page frame allocator
+ */
+void pmm_init(void) {
+    for (uint32_t i = 0; i < PMM_POOL_PAGES; i++) {
+        frame_refs[i] = 0;
+    }
+    free_frames = PMM_POOL_PAGES;
+    next_hint = 0;
+
+    vga_puts("[KERNEL] Page frame allocator initialized (24MB at 0x800000)\n");
+}
+
+/**
+ * Allocate a single frame
+ */
+uint32_t pmm_alloc_page(void) {
+    return pmm_alloc_pages(1);
+}
+
+/**
+ * Allocate a contiguous run of frames (next-fit)
+ */
+uint32_t pmm_alloc_pages(uint32_t count) {
+    if (count == 0 || count > PMM_POOL_PAGES) return 0;
+
+    uint32_t flags = irq_save();
+
+    if (free_frames < count) {
+        irq_restore(flags);
+        return 0;
+    }
+
+    uint32_t start = next_hint;
+    uint32_t scanned = 0;
+    uint32_t run = 0;
+    uint32_t run_start = start;
+
+    while (scanned < PMM_POOL_PAGES + count) {
+        uint32_t i = (start + scanned) % PMM_POOL_PAGES;
+        scanned++;
+
+        /* A run cannot wrap around the end of the pool */
+        if (i == 0) run = 0;
+
+        if (frame_refs[i] != 0) {
+            run = 0;
+            continue;
+        }
+
+        if (run == 0) run_start = i;
+        run++;
+
+        if (run == count) {
+            for (uint32_t j = run_start; j < run_start + count; j++) {
+                frame_refs[j] = 1;
+            }
+            free_frames -= count;
+            next_hint = (run_start + count) % PMM_POOL_PAGES;
+            irq_restore(flags);
+            return frame_addr(run_start);
+        }
+    }
+
+    irq_restore(flags);
+    return 0;
+}
+
+/**
+ * Free a run of frames
+ */
+void pmm_free_pages(uint32_t addr, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        pmm_unref_page(addr + i * PAGE_SIZE);
+    }
+}
+
+/**
+ * Take a reference on a frame
+ */
+void pmm_ref_page(uint32_t addr) {
+    if (!pmm_owns(addr)) return;
+
+    uint32_t flags = irq_save();
+    uint32_t idx = frame_index(addr);
+    if (frame_refs[idx] != 0 && frame_refs[idx] != 0xFFFF) {
+        frame_refs[idx]++;
+    }
+    irq_restore(flags);
+}
+
+/**
+ * Drop a reference on a frame, freeing it on the last one
+ */
+void pmm_unref_page(uint32_t addr) {
+    if (!pmm_owns(addr)) return;
+
+    uint32_t flags = irq_save();
+    uint32_t idx = frame_index(addr);
+    if (frame_refs[idx] != 0) {
+        frame_refs[idx]--;
+        if (frame_refs[idx] == 0) {
+            free_frames++;
+        }
+    }
+    irq_restore(flags);
+}
+
+/**
+ * Get frame reference count
+ */
+uint16_t pmm_page_refcount(uint32_t addr) {
+    if (!pmm_owns(addr)) return 0;
+    return frame_refs[frame_index(addr)];
+}
+
+/**
+ * Check if an address is a pool frame
+ */
+bool pmm_owns(uint32_t addr) {
+    return addr >= PMM_POOL_START && addr < PMM_POOL_END;
+}
+
+/**
+ * Zero a frame (frames are identity mapped)
+ */
+void pmm_zero_page(uint32_t addr) {
+    uint32_t* p = (uint32_t*)(addr & PAGE_MASK);
+    for (uint32_t i = 0; i < PAGE_SIZE / 4; i++) {
+        p[i] = 0;
+    }
+}
+
+/**
+ * Copy one frame to another
+ */
+void pmm_copy_page(uint32_t dst, uint32_t src) {
+    uint32_t* d = (uint32_t*)(dst & PAGE_MASK);
+    const uint32_t* s = (const uint32_t*)(src & PAGE_MASK);
+    for (uint32_t i = 0; i < PAGE_SIZE / 4; i++) {
+        d[i] = s[i];
+    }
+}
+
+/**
+ * Pool statistics
+ */
+uint32_t pmm_free_count(void) {
+    return free_frames;
+}
+
+uint32_t pmm_used_count(void) {
+    return PMM_POOL_PAGES - free_frames;
+}
@@ -0,0 +1,543 @@
+/**
+ * ClaudeOS Readiness Polling - poll.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: poll() and epoll-style interest sets over file descriptors
+ *
+ * poll() registers a watcher on every source's wait queue for the
+ * duration of the call and sleeps once for all of them.
+ *
+ * An epoll instance keeps its watchers registered between calls. A
+ * watcher's callback only moves its item onto the instance's ready
+ * list, so epoll_wait() looks at the items that signalled and never
+ * scans the whole interest set.
+ */
+
+#include "types.h"
+#include "poll.h"
+#include "process.h"
+#include "timer.h"
+#include "syscall.h"
+#include "idt.h"
+#include "../fs/vfs.h"
+
+/*
+ * ===========================================================================
+ * poll()
+ * ===========================================================================
+ */
+
+/* Watcher callback: wake the polling process */
+static void poll_notify(wait_entry_t* entry) {
+    process_wake(entry->proc);
+}
+
+/* poll_table queue function: add a watcher for the current process */
+static void poll_queue(poll_table_t* pt, wait_queue_t* wq) {
+    poll_wait_set_t* set = (poll_wait_set_t*)pt->priv;
+    if (set->count >= POLL_MAX_WAITS) {
+        return;
+    }
+
+    wait_entry_t* entry = &set->entries[set->count];
+    entry->proc = process_current();
+    entry->key = 0;
+    entry->notify = poll_notify;
+    entry->priv = NULL;
+    set->queues[set->count] = wq;
+    set->count++;
+
+    wait_queue_add(wq, entry);
+}
+
+/**
+ * Remove every watcher of a poll() call
+ */
+void poll_set_release(poll_wait_set_t* set) {
+    for (uint32_t i = 0; i < set->count; i++) {
+        wait_queue_remove(set->queues[i], &set->entries[i]);
+    }
+    set->count = 0;
+}
+
+/* Milliseconds left until a deadline (0 once it has passed) */
+static uint32_t ms_until(uint64_t deadline) {
+    uint64_t now = timer_get_ticks();
+    return now >= deadline ? 0 : (uint32_t)(deadline - now) * MS_PER_TICK;
+}
+
+/**
+ * Wait for readiness on a set of descriptors
+ */
+int32_t poll_fds(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms) {
+    if ((!fds && nfds) || nfds > POLL_MAX_FDS) {
+        return SYSCALL_EINVAL;
+    }
+
+    process_t* self = process_current();
+    poll_wait_set_t set;
+    set.count = 0;
+    poll_table_t pt = { poll_queue, &set };
+    poll_table_t* register_pt = self ? &pt : NULL;
+
+    uint64_t deadline = 0;
+    if (timeout_ms > 0) {
+        deadline = timer_get_ticks() + (uint32_t)timeout_ms / MS_PER_TICK + 1;
+    }
+
+    uint32_t irq = irq_save();
+    if (self) {
+        self->poll_set = &set;
+    }
+
+    int32_t ready;
+    for (;;) {
+        ready = 0;
+        for (uint32_t i = 0; i < nfds; i++) {
+            uint32_t want = (uint16_t)fds[i].events | POLLERR | POLLHUP | POLLNVAL;
+            uint32_t mask = vfs_poll(fds[i].fd, register_pt) & want;
+            fds[i].revents = (int16_t)mask;
+            if (mask) {
+                ready++;
+            }
+        }
+
+        /* Watchers stay registered until we return */
+        register_pt = NULL;
+
+        if (ready || timeout_ms == 0 || !self) {
+            break;
+        }
+
+        if (timeout_ms < 0) {
+            process_block();
+        } else {
+            uint32_t left = ms_until(deadline);
+            if (left == 0 || !process_block_timeout(left)) {
+                timeout_ms = 0;     /* One last look, then give up */
+            }
+        }
+    }
+
+    if (self) {
+        poll_set_release(&set);
+        self->poll_set = NULL;
+    }
+    irq_restore(irq);
+    return ready;
+}
+
+/*
+ * ===========================================================================
+ * epoll
+ * ===========================================================================
+ */
+
+struct epoll;
+
+typedef struct epitem {
+    struct epoll* ep;
+    struct file* file;          /* Open file it was added through */
+    fs_node_t* node;            /* Watched object */
+    int32_t fd;                 /* Descriptor it was added as */
+    uint32_t events;            /* Requested EPOLL* events */
+    uint32_t data;              /* Caller's cookie */
+    wait_queue_t* queues[EPOLL_ITEM_WAITS];
+    wait_entry_t waits[EPOLL_ITEM_WAITS];
+    uint32_t nwaits;
+    bool ready;                 /* On the ready list */
+    struct epitem* next;        /* Interest list / free list */
+    struct epitem* ready_next;  /* Ready list */
+} epitem_t;
+
+typedef struct epoll {
+    bool in_use;
+    uint32_t refs;              /* Open descriptors */
+    epitem_t* items;            /* Interest list */
+    epitem_t* ready_head;       /* Items that signalled */
+    epitem_t* ready_tail;
+    wait_queue_t wait;          /* epoll_wait() sleepers and outer pollers */
+    fs_node_t node;
+} epoll_t;
+
+static epoll_t epolls[EPOLL_MAX_INSTANCES];
+static epitem_t item_pool[EPOLL_MAX_ITEMS];
+static epitem_t* free_items = NULL;
+static bool epoll_ready = false;
+
+static void epoll_setup(void) {
+    free_items = NULL;
+    for (int i = EPOLL_MAX_ITEMS - 1; i >= 0; i--) {
+        item_pool[i].next = free_items;
+        free_items = &item_pool[i];
+    }
+    epoll_ready = true;
+}
+
+/* Append an item to its instance's ready list */
+static void ep_queue_ready(epitem_t* item) {
+    epoll_t* ep = item->ep;
+    if (item->ready) {
+        return;
+    }
+    item->ready = true;
+    item->ready_next = NULL;
+    if (ep->ready_tail) {
+        ep->ready_tail->ready_next = item;
+    } else {
+        ep->ready_head = item;
+    }
+    ep->ready_tail = item;
+}
+
+/* Watcher callback: the source may have become ready */
+static void ep_item_notify(wait_entry_t* entry) {
+    epitem_t* item = (epitem_t*)entry->priv;
+    ep_queue_ready(item);
+    wait_queue_wake_all(&item->ep->wait);
+}
+
+/* poll_table queue function: attach an item's watcher to a source queue */
+static void ep_item_queue(poll_table_t* pt, wait_queue_t* wq) {
+    epitem_t* item = (epitem_t*)pt->priv;
+    if (item->nwaits >= EPOLL_ITEM_WAITS) {
+        return;
+    }
+
+    wait_entry_t* entry = &item->waits[item->nwaits];
+    entry->proc = NULL;
+    entry->key = 0;
+    entry->notify = ep_item_notify;
+    entry->priv = item;
+    item->queues[item->nwaits] = wq;
+    item->nwaits++;
+
+    wait_queue_add(wq, entry);
+}
+
+/* Detach an item from its sources and the ready list, and free it */
+static void ep_item_remove(epoll_t* ep, epitem_t* item) {
+    for (uint32_t i = 0; i < item->nwaits; i++) {
+        wait_queue_remove(item->queues[i], &item->waits[i]);
+    }
+    item->nwaits = 0;
+
+    epitem_t** link = &ep->items;
+    while (*link && *link != item) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = item->next;
+    }
+
+    if (item->ready) {
+        epitem_t* prev = NULL;
+        for (epitem_t* r = ep->ready_head; r; prev = r, r = r->ready_next) {
+            if (r != item) continue;
+            if (prev) prev->ready_next = r->ready_next;
+            else ep->ready_head = r->ready_next;
+            if (ep->ready_tail == r) ep->ready_tail = prev;
+            break;
+        }
+        item->ready = false;
+    }
+
+    item->next = free_items;
+    free_items = item;
+}
+
+static epitem_t* ep_find(epoll_t* ep, int32_t fd, struct file* file) {
+    for (epitem_t* item = ep->items; item; item = item->next) {
+        if (item->fd == fd && item->file == file) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Node operations: an epoll instance is itself a pollable descriptor
+ * (readable while it has ready items), so instances can be nested.
+ */
+
+static int ep_open(fs_node_t* node, int flags) {
+    (void)flags;
+    epoll_t* ep = (epoll_t*)node->data;
+    uint32_t irq = irq_save();
+    ep->refs++;
+    irq_restore(irq);
+    return 0;
+}
+
+static int ep_close(fs_node_t* node) {
+    epoll_t* ep = (epoll_t*)node->data;
+    uint32_t irq = irq_save();
+    if (ep->refs > 0 && --ep->refs == 0) {
+        while (ep->items) {
+            ep_item_remove(ep, ep->items);
+        }
+        ep->in_use = false;
+    }
+    irq_restore(irq);
+    return 0;
+}
+
+static uint32_t ep_poll(fs_node_t* node, poll_table_t* pt) {
+    epoll_t* ep = (epoll_t*)node->data;
+    poll_wait(pt, &ep->wait);
+    return ep->ready_head ? POLLIN : 0;
+}
+
+static fs_ops_t epoll_ops = {
+    .open  = ep_open,
+    .close = ep_close,
+    .poll  = ep_poll,
+};
+
+static epoll_t* ep_from_fd(int32_t epfd) {
+    fs_node_t* node = vfs_fd_node(epfd);
+    if (!node || node->ops != &epoll_ops) {
+        return NULL;
+    }
+    return (epoll_t*)node->data;
+}
+
+/**
+ * Create an epoll instance
+ */
+int32_t epoll_create(void) {
+    uint32_t irq = irq_save();
+
+    if (!epoll_ready) {
+        epoll_setup();
+    }
+
+    epoll_t* ep = NULL;
+    for (int i = 0; i < EPOLL_MAX_INSTANCES; i++) {
+        if (!epolls[i].in_use) {
+            ep = &epolls[i];
+            break;
+        }
+    }
+    if (!ep) {
+        irq_restore(irq);
+        return SYSCALL_ENOMEM;
+    }
+
+    uint8_t* raw = (uint8_t*)&ep->node;
+    for (uint32_t i = 0; i < sizeof(fs_node_t); i++) {
+        raw[i] = 0;
+    }
+    ep->node.name = "epoll";
+    ep->node.type = FS_CHARDEV;
+    ep->node.data = ep;
+    ep->node.ops = &epoll_ops;
+
+    ep->in_use = true;
+    ep->refs = 0;
+    ep->items = NULL;
+    ep->ready_head = NULL;
+    ep->ready_tail = NULL;
+    wait_queue_init(&ep->wait);
+
+    int fd = vfs_open_node(&ep->node, O_RDONLY);
+    if (fd < 0) {
+        ep->in_use = false;
+        irq_restore(irq);
+        return SYSCALL_EMFILE;
+    }
+
+    irq_restore(irq);
+    return fd;
+}
+
+/**
+ * Add, modify or remove a descriptor in an interest set
+ */
+int32_t epoll_ctl(int32_t epfd, int32_t op, int32_t fd, epoll_event_t* event) {
+    uint32_t irq = irq_save();
+
+    epoll_t* ep = ep_from_fd(epfd);
+    struct file* file = vfs_fd_file(fd);
+    fs_node_t* node = vfs_fd_node(fd);
+    if (!ep || !file) {
+        irq_restore(irq);
+        return SYSCALL_EBADF;
+    }
+    if (node == &ep->node || (op != EPOLL_CTL_DEL && !event)) {
+        irq_restore(irq);
+        return SYSCALL_EINVAL;
+    }
+
+    epitem_t* item = ep_find(ep, fd, file);
+    int32_t result = SYSCALL_SUCCESS;
+
+    switch (op) {
+        case EPOLL_CTL_ADD: {
+            if (item) {
+                result = SYSCALL_EINVAL;    /* Already registered */
+                break;
+            }
+            item = free_items;
+            if (!item) {
+                result = SYSCALL_ENOMEM;
+                break;
+            }
+            free_items = item->next;
+
+            item->ep = ep;
+            item->file = file;
+            item->node = node;
+            item->fd = fd;
+            item->events = event->events;
+            item->data = event->data;
+            item->nwaits = 0;
+            item->ready = false;
+            item->ready_next = NULL;
+            item->next = ep->items;
+            ep->items = item;
+
+            /* Register with the source; report it if already ready */
+            poll_table_t pt = { ep_item_queue, item };
+            uint32_t mask = vfs_poll_node(node, &pt);
+            if (mask & (item->events | POLLERR | POLLHUP)) {
+                ep_queue_ready(item);
+                wait_queue_wake_all(&ep->wait);
+            }
+            break;
+        }
+
+        case EPOLL_CTL_MOD:
+            if (!item) {
+                result = SYSCALL_EINVAL;
+                break;
+            }
+            item->events = event->events;
+            item->data = event->data;
+            if (vfs_poll_node(node, NULL) & (item->events | POLLERR | POLLHUP)) {
+                ep_queue_ready(item);
+                wait_queue_wake_all(&ep->wait);
+            }
+            break;
+
+        case EPOLL_CTL_DEL:
+            if (!item) {
+                result = SYSCALL_EINVAL;
+                break;
+            }
+            ep_item_remove(ep, item);
+            break;
+
+        default:
+            result = SYSCALL_EINVAL;
+            break;
+    }
+
+    irq_restore(irq);
+    return result;
+}
+
+/**
+ * Wait for events on an interest set
+ */
+int32_t epoll_wait(int32_t epfd, epoll_event_t* events, int32_t max_events, int32_t timeout_ms) {
+    if (!events || max_events <= 0) {
+        return SYSCALL_EINVAL;
+    }
+
+    uint64_t deadline = 0;
+    if (timeout_ms > 0) {
+        deadline = timer_get_ticks() + (uint32_t)timeout_ms / MS_PER_TICK + 1;
+    }
+
+    uint32_t irq = irq_save();
+
+    epoll_t* ep = ep_from_fd(epfd);
+    if (!ep) {
+        irq_restore(irq);
+        return SYSCALL_EBADF;
+    }
+
+    int32_t n = 0;
+    for (;;) {
+        /* Take the current ready list; level-triggered items that are
+         * still ready go back on the end for the next call */
+        epitem_t* list = ep->ready_head;
+        ep->ready_head = NULL;
+        ep->ready_tail = NULL;
+
+        while (list && n < max_events) {
+            epitem_t* item = list;
+            list = item->ready_next;
+            item->ready = false;
+            item->ready_next = NULL;
+
+            uint32_t mask = vfs_poll_node(item->node, NULL) &
+                            (item->events | POLLERR | POLLHUP);
+            if (!mask) {
+                continue;
+            }
+
+            events[n].events = mask;
+            events[n].data = item->data;
+            n++;
+
+            if (!(item->events & EPOLLET)) {
+                ep_queue_ready(item);
+            }
+        }
+
+        /* Out of room: keep the unexamined items ahead of the requeued */
+        if (list) {
+            epitem_t* tail = list;
+            while (tail->ready_next) {
+                tail = tail->ready_next;
+            }
+            tail->ready_next = ep->ready_head;
+            if (!ep->ready_head) {
+                ep->ready_tail = tail;
+            }
+            ep->ready_head = list;
+        }
+
+        if (n > 0 || timeout_ms == 0 || !process_current()) {
+            break;
+        }
+
+        if (timeout_ms < 0) {
+            wait_queue_sleep(&ep->wait);
+        } else {
+            uint32_t left = ms_until(deadline);
+            if (left == 0 || !wait_queue_sleep_timeout(&ep->wait, left)) {
+                timeout_ms = 0;     /* One last look, then give up */
+            }
+        }
+    }
+
+    irq_restore(irq);
+    return n;
+}
+
+/**
+ * Drop a file nobody has open any more from every interest set
+ */
+void epoll_file_closed(struct file* file) {
+    if (!epoll_ready || !file) {
+        return;
+    }
+
+    uint32_t irq = irq_save();
+    for (int i = 0; i < EPOLL_MAX_INSTANCES; i++) {
+        if (!epolls[i].in_use) {
+            continue;
+        }
+        epitem_t* item = epolls[i].items;
+        while (item) {
+            epitem_t* next = item->next;
+            if (item->file == file) {
+                ep_item_remove(&epolls[i], item);
+            }
+            item = next;
+        }
+    }
+    irq_restore(irq);
+}
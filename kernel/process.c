@@ -9,6 +9,12 @@
 #include "timer.h"
 #include "kmalloc.h"
 #include "vga.h"
+#include "mman.h"
+#include "pmm.h"
+#include "idt.h"
+#include "ipc.h"
+#include "poll.h"
+#include "../fs/vfs.h"
 
 /* Process table */
 static process_t process_table[MAX_PROCESSES];
@@ -16,6 +22,16 @@ static process_t* current_process = NULL;
 static uint32_t next_pid = 1;
 static bool scheduler_enabled = false;
 
+/* Stack switch - defined in switch.asm */
+extern void context_switch(uint32_t* old_esp, uint32_t new_esp);
+
+/* Read the current code segment selector (used for new process frames) */
+static inline uint32_t read_cs(void) {
+    uint32_t cs;
+    __asm__ volatile ("mov %%cs, %0" : "=r"(cs));
+    return cs & 0xFFFF;
+}
+
 /* Idle process (runs when no other process is ready) */
 static void idle_process_entry(void) {
     while (1) {
@@ -52,8 +68,21 @@ const char* process_state_name(process_state_t state) {
     return "UNKNOWN";
 }
 
+/**
+ * Release a terminated process's resources and free its slot
+ */
+static void reap_process(process_t* proc) {
+    if (proc->stack) {
+        pmm_free_pages((uint32_t)proc->stack, PROCESS_STACK_SIZE / PAGE_SIZE);
+        proc->stack = NULL;
+    }
+    proc->state = PROCESS_STATE_FREE;
+    proc->pid = 0;
+}
+
 /**
  * Find a free process slot
+ * Falls back to reclaiming a terminated process nobody waited for.
  */
 static process_t* find_free_slot(void) {
     for (uint32_t i = 0; i < MAX_PROCESSES; i++) {
@@ -61,16 +90,25 @@ static process_t* find_free_slot(void) {
             return &process_table[i];
         }
     }
+    for (uint32_t i = 2; i < MAX_PROCESSES; i++) {
+        process_t* proc = &process_table[i];
+        if (proc->state == PROCESS_STATE_TERMINATED &&
+            proc != current_process && !proc->exit_wait.head) {
+            reap_process(proc);
+            return proc;
+        }
+    }
     return NULL;
 }
 
 /**
  * Find next ready process (round-robin)
+ * The idle process (slot 0) is skipped; schedule() falls back to it.
  */
 static process_t* find_next_ready(void) {
     if (!current_process) {
         /* Start from beginning if no current process */
-        for (uint32_t i = 0; i < MAX_PROCESSES; i++) {
+        for (uint32_t i = 1; i < MAX_PROCESSES; i++) {
             if (process_table[i].state == PROCESS_STATE_READY) {
                 return &process_table[i];
             }
@@ -82,7 +120,7 @@ static process_t* find_next_ready(void) {
     uint32_t start_idx = current_process - process_table;
     for (uint32_t i = 1; i <= MAX_PROCESSES; i++) {
         uint32_t idx = (start_idx + i) % MAX_PROCESSES;
-        if (process_table[idx].state == PROCESS_STATE_READY) {
+        if (idx != 0 && process_table[idx].state == PROCESS_STATE_READY) {
             return &process_table[idx];
         }
     }
@@ -147,6 +185,14 @@ void process_init(void) {
         process_table[i].state = PROCESS_STATE_FREE;
         process_table[i].pid = 0;
         process_table[i].stack = NULL;
+        process_table[i].arg = NULL;
+        process_table[i].blocked_on = NULL;
+        process_table[i].wait_entry = NULL;
+        wait_queue_init(&process_table[i].exit_wait);
+        process_table[i].files = NULL;
+        process_table[i].cwd = NULL;
+        process_table[i].poll_set = NULL;
+        ipc_process_init(&process_table[i]);
     }
 
     /* Create idle process (PID 0) */
@@ -170,7 +216,7 @@ void process_init(void) {
 
         /* Push initial values (will be popped by context switch) */
         *(--stack_top) = 0x202;                     /* EFLAGS (IF=1) */
-        *(--stack_top) = 0x08;                      /* CS */
+        *(--stack_top) = read_cs();                 /* CS */
         *(--stack_top) = (uint32_t)idle_process_entry; /* EIP */
         *(--stack_top) = 0;                         /* EAX */
         *(--stack_top) = 0;                         /* ECX */
@@ -212,17 +258,29 @@ void process_init(void) {
  * Create a new process
  */
 int32_t process_create(const char* name, process_entry_t entry, process_priority_t priority) {
+    return process_create_arg(name, entry, priority, NULL);
+}
+
+/**
+ * Create a new process with an argument
+ */
+int32_t process_create_arg(const char* name, process_entry_t entry,
+                           process_priority_t priority, void* arg) {
     if (!entry) return -1;
 
+    uint32_t flags = irq_save();
+
     /* Find free slot */
     process_t* proc = find_free_slot();
     if (!proc) {
+        irq_restore(flags);
         return -1;  /* No free slots */
     }
 
     /* Allocate stack */
-    proc->stack = (uint8_t*)kmalloc(PROCESS_STACK_SIZE);
+    proc->stack = (uint8_t*)pmm_alloc_pages(PROCESS_STACK_SIZE / PAGE_SIZE);
     if (!proc->stack) {
+        irq_restore(flags);
         return -1;  /* Out of memory */
     }
     proc->stack_size = PROCESS_STACK_SIZE;
@@ -232,19 +290,35 @@ int32_t process_create(const char* name, process_entry_t entry, process_priority
     proc->state = PROCESS_STATE_READY;
     proc->priority = priority;
     proc->entry = entry;
+    proc->arg = arg;
     proc->time_slice = 10;  /* 100ms time slice */
     proc->total_ticks = 0;
     proc->wake_time = 0;
     proc->parent = current_process;
     proc->exit_code = 0;
+    proc->blocked_on = NULL;
+    proc->wait_entry = NULL;
+    wait_queue_init(&proc->exit_wait);
+    proc->poll_set = NULL;
+    ipc_process_init(proc);
     proc_strcpy(proc->name, name, 32);
 
+    /* Inherit the parent's standard streams and working directory */
+    if (vfs_files_create(proc, current_process, 0) != 0) {
+        pmm_free_pages((uint32_t)proc->stack, PROCESS_STACK_SIZE / PAGE_SIZE);
+        proc->stack = NULL;
+        proc->state = PROCESS_STATE_FREE;
+        irq_restore(flags);
+        return -1;
+    }
+    vfs_cwd_inherit(proc, current_process);
+
     /* Set up initial stack for context switch */
     uint32_t* stack_top = (uint32_t*)(proc->stack + PROCESS_STACK_SIZE);
 
     /* Push initial values (simulates interrupt frame) */
     *(--stack_top) = 0x202;                     /* EFLAGS (IF=1, enable interrupts) */
-    *(--stack_top) = 0x08;                      /* CS (kernel code segment) */
+    *(--stack_top) = read_cs();                 /* CS (kernel code segment) */
     *(--stack_top) = (uint32_t)process_wrapper; /* EIP (entry wrapper) */
     *(--stack_top) = 0;                         /* EAX */
     *(--stack_top) = 0;                         /* ECX */
@@ -259,7 +333,51 @@ int32_t process_create(const char* name, process_entry_t entry, process_priority
     proc->ebp = 0;
     proc->eip = (uint32_t)process_wrapper;
 
-    return proc->pid;
+    int32_t pid = proc->pid;
+    irq_restore(flags);
+    return pid;
+}
+
+/**
+ * Common teardown for exiting and killed processes
+ * The stack is kept until the process is reaped, since an exiting
+ * process is still running on it.
+ */
+static void process_terminate(process_t* proc, int32_t exit_code) {
+    /* Leave any wait queue we were sleeping on */
+    if (proc->blocked_on && proc->wait_entry) {
+        wait_entry_t** link = &proc->blocked_on->head;
+        while (*link && *link != proc->wait_entry) {
+            link = &(*link)->next;
+        }
+        if (*link) {
+            *link = proc->wait_entry->next;
+        }
+        proc->blocked_on = NULL;
+        proc->wait_entry = NULL;
+    }
+
+    /* Drop watchers left behind by an interrupted poll() */
+    if (proc->poll_set) {
+        poll_set_release(proc->poll_set);
+        proc->poll_set = NULL;
+    }
+
+    proc->state = PROCESS_STATE_TERMINATED;
+    proc->exit_code = exit_code;
+
+    /* Tear down memory mappings */
+    mmap_release(proc);
+
+    /* Close every descriptor (signals EOF down a pipeline) */
+    vfs_files_release(proc);
+    vfs_cwd_release(proc);
+
+    /* Fail IPC partners blocked on us */
+    ipc_release(proc);
+
+    /* Wake anyone in process_wait() */
+    wait_queue_wake_all(&proc->exit_wait);
 }
 
 /**
@@ -274,14 +392,8 @@ void process_exit(int32_t exit_code) {
         return;
     }
 
-    current_process->state = PROCESS_STATE_TERMINATED;
-    current_process->exit_code = exit_code;
-
-    /* Free stack memory */
-    if (current_process->stack) {
-        kfree(current_process->stack);
-        current_process->stack = NULL;
-    }
+    irq_save();  /* Not restored: we never run again */
+    process_terminate(current_process, exit_code);
 
     /* Switch to another process */
     schedule();
@@ -330,6 +442,35 @@ void process_block(void) {
     schedule();
 }
 
+/**
+ * Block current process with a timeout
+ * The timed wait is a SLEEPING state, so the timer wakes us if nobody
+ * else does first.
+ */
+bool process_block_timeout(uint32_t ms) {
+    if (!current_process) return false;
+
+    uint64_t ticks = ms / MS_PER_TICK;
+    if (ticks == 0) ticks = 1;
+
+    uint64_t deadline = timer_get_ticks() + ticks;
+    current_process->wake_time = deadline;
+    current_process->state = PROCESS_STATE_SLEEPING;
+    schedule();
+
+    return timer_get_ticks() < deadline;
+}
+
+/**
+ * Wake a blocked or timed-blocked process
+ */
+void process_wake(process_t* proc) {
+    if (proc && (proc->state == PROCESS_STATE_BLOCKED ||
+                 proc->state == PROCESS_STATE_SLEEPING)) {
+        proc->state = PROCESS_STATE_READY;
+    }
+}
+
 /**
  * Unblock a process
  */
@@ -350,14 +491,11 @@ int32_t process_kill(uint32_t pid) {
     process_t* proc = process_get(pid);
     if (!proc) return -1;
 
-    proc->state = PROCESS_STATE_TERMINATED;
-    proc->exit_code = -1;  /* Killed */
+    if (proc->state == PROCESS_STATE_TERMINATED) return -1;
 
-    /* Free stack */
-    if (proc->stack) {
-        kfree(proc->stack);
-        proc->stack = NULL;
-    }
+    uint32_t flags = irq_save();
+    process_terminate(proc, -1);  /* Killed */
+    irq_restore(flags);
 
     /* If killing current process, switch away */
     if (proc == current_process) {
@@ -373,13 +511,21 @@ int32_t process_kill(uint32_t pid) {
 void schedule(void) {
     if (!scheduler_enabled) return;
 
+    uint32_t flags = irq_save();
+
     process_t* next = find_next_ready();
 
-    /* If no ready process, use idle */
+    /* If nothing else is ready, keep running the current process */
+    if (!next && current_process && current_process->state == PROCESS_STATE_RUNNING) {
+        next = current_process;
+    }
+
+    /* Otherwise fall back to idle */
     if (!next) {
         next = &process_table[0];  /* Idle process */
         if (next->state == PROCESS_STATE_FREE) {
             /* No idle process available - should never happen */
+            irq_restore(flags);
             return;
         }
     }
@@ -387,6 +533,7 @@ void schedule(void) {
     /* If same process, just reset time slice */
     if (next == current_process) {
         current_process->time_slice = 10;
+        irq_restore(flags);
         return;
     }
 
@@ -403,15 +550,32 @@ void schedule(void) {
     current_process->state = PROCESS_STATE_RUNNING;
     current_process->time_slice = 10;  /* Reset time slice */
 
-    /* Note: In a real implementation, we would do actual context switching
-     * by saving/restoring registers. For now, we rely on the cooperative
-     * model where processes yield or block voluntarily.
-     *
-     * A full implementation would need assembly code to:
-     * 1. Save current ESP/EBP to prev->esp/ebp
-     * 2. Load next->esp/ebp to ESP/EBP
-     * 3. Return (which would jump to next process)
-     */
+    /* Save our registers and stack on prev, resume next. Returns once
+     * something switches back to prev. */
+    context_switch(&prev->esp, next->esp);
+
+    irq_restore(flags);
+}
+
+/**
+ * Switch directly to a chosen process, donating our time slice
+ */
+void process_handoff(process_t* next) {
+    process_t* prev = current_process;
+    if (!scheduler_enabled || !prev || !next || next == prev) {
+        schedule();
+        return;
+    }
+
+    if (prev->state == PROCESS_STATE_RUNNING) {
+        prev->state = PROCESS_STATE_READY;
+    }
+
+    next->state = PROCESS_STATE_RUNNING;
+    next->time_slice = prev->time_slice > 0 ? prev->time_slice : 1;
+    current_process = next;
+
+    context_switch(&prev->esp, next->esp);
 }
 
 /**
@@ -451,3 +615,209 @@ uint32_t process_list(uint32_t* pids, uint32_t max_count) {
     }
     return count;
 }
+
+/**
+ * Wait for a process to exit
+ */
+int32_t process_wait(uint32_t pid) {
+    if (pid <= 1) return -1;
+
+    uint32_t flags = irq_save();
+
+    process_t* proc = process_get(pid);
+    if (!proc || proc == current_process) {
+        irq_restore(flags);
+        return -1;
+    }
+
+    while (proc->pid == pid && proc->state != PROCESS_STATE_TERMINATED) {
+        wait_queue_sleep(&proc->exit_wait);
+    }
+
+    /* Another waiter got there first and reaped it */
+    if (proc->pid != pid) {
+        irq_restore(flags);
+        return -1;
+    }
+
+    int32_t code = proc->exit_code;
+    reap_process(proc);
+
+    irq_restore(flags);
+    return code;
+}
+
+/*
+ * ===========================================================================
+ * Wait Queues
+ * ===========================================================================
+ */
+
+/**
+ * Initialize a wait queue
+ */
+void wait_queue_init(wait_queue_t* wq) {
+    wq->head = NULL;
+}
+
+/**
+ * Queue ourselves, block (optionally with a timeout) and dequeue
+ * @return true if woken, false if the timeout expired
+ */
+static bool wait_queue_block(wait_queue_t* wq, uint32_t key, uint32_t timeout_ms) {
+    if (!current_process) return false;
+
+    /* Append so that wakeups are first come, first served */
+    wait_entry_t entry;
+    entry.proc = current_process;
+    entry.key = key;
+    entry.notify = NULL;
+    entry.priv = NULL;
+    entry.next = NULL;
+
+    wait_entry_t** tail = &wq->head;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = &entry;
+
+    current_process->blocked_on = wq;
+    current_process->wait_entry = &entry;
+
+    bool woken = true;
+    if (timeout_ms) {
+        woken = process_block_timeout(timeout_ms);
+    } else {
+        process_block();
+    }
+
+    /* Woken or timed out: make sure we are off the queue */
+    wait_entry_t** link = &wq->head;
+    while (*link && *link != &entry) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = entry.next;
+        woken = false;  /* Still queued, so only the timeout woke us */
+    }
+
+    current_process->blocked_on = NULL;
+    current_process->wait_entry = NULL;
+    return woken;
+}
+
+/**
+ * Sleep on a wait queue (interrupts must be disabled)
+ */
+void wait_queue_sleep(wait_queue_t* wq) {
+    wait_queue_block(wq, 0, 0);
+}
+
+/**
+ * Sleep on a wait queue with a key (interrupts must be disabled)
+ */
+void wait_queue_sleep_key(wait_queue_t* wq, uint32_t key) {
+    wait_queue_block(wq, key, 0);
+}
+
+/**
+ * Sleep on a wait queue with a timeout (interrupts must be disabled)
+ */
+bool wait_queue_sleep_timeout(wait_queue_t* wq, uint32_t ms) {
+    return wait_queue_block(wq, 0, ms ? ms : 1);
+}
+
+/**
+ * Add a watcher entry to a wait queue
+ */
+void wait_queue_add(wait_queue_t* wq, wait_entry_t* entry) {
+    uint32_t flags = irq_save();
+    entry->next = wq->head;
+    wq->head = entry;
+    irq_restore(flags);
+}
+
+/**
+ * Remove an entry from a wait queue
+ */
+void wait_queue_remove(wait_queue_t* wq, wait_entry_t* entry) {
+    uint32_t flags = irq_save();
+    wait_entry_t** link = &wq->head;
+    while (*link && *link != entry) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = entry->next;
+    }
+    irq_restore(flags);
+}
+
+/**
+ * Wake everything on a wait queue
+ * Sleepers are dequeued; watchers are notified and stay queued.
+ */
+void wait_queue_wake_all(wait_queue_t* wq) {
+    uint32_t flags = irq_save();
+
+    wait_entry_t** link = &wq->head;
+    while (*link) {
+        wait_entry_t* entry = *link;
+        if (entry->notify) {
+            link = &entry->next;
+            entry->notify(entry);
+        } else {
+            *link = entry->next;
+            process_wake(entry->proc);
+        }
+    }
+
+    irq_restore(flags);
+}
+
+/**
+ * Wake the first sleeper on a wait queue (watchers are all notified)
+ */
+void wait_queue_wake_one(wait_queue_t* wq) {
+    uint32_t flags = irq_save();
+
+    bool woke = false;
+    wait_entry_t** link = &wq->head;
+    while (*link) {
+        wait_entry_t* entry = *link;
+        if (entry->notify) {
+            link = &entry->next;
+            entry->notify(entry);
+        } else if (!woke) {
+            *link = entry->next;
+            process_wake(entry->proc);
+            woke = true;
+        } else {
+            link = &entry->next;
+        }
+    }
+
+    irq_restore(flags);
+}
+
+/**
+ * Wake processes sleeping on a wait queue with a matching key
+ */
+int wait_queue_wake_key(wait_queue_t* wq, uint32_t key, int max) {
+    uint32_t flags = irq_save();
+    int woken = 0;
+
+    wait_entry_t** link = &wq->head;
+    while (*link && woken < max) {
+        wait_entry_t* entry = *link;
+        if (entry->notify || entry->key != key) {
+            link = &entry->next;
+            continue;
+        }
+        *link = entry->next;
+        process_wake(entry->proc);
+        woken++;
+    }
+
+    irq_restore(flags);
+    return woken;
+}
@@ -0,0 +1,198 @@
+/**
+ * ClaudeOS Shared Memory - shm.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Shared memory segments mapped through the mmap window
+ *
+ * A segment is a node with only an mmap operation. Mapping it creates an
+ * ordinary MAP_SHARED area, so pages are populated lazily by the mmap
+ * fault handler and every mapping sees the same frames.
+ */
+
+#include "types.h"
+#include "shm.h"
+#include "mman.h"
+#include "pmm.h"
+#include "syscall.h"
+#include "idt.h"
+#include "../fs/vfs.h"
+
+typedef enum {
+    SHM_FREE = 0,
+    SHM_ACTIVE,
+    SHM_REMOVED     /* Destroyed, waiting for its last mapping to go */
+} shm_state_t;
+
+typedef struct {
+    shm_state_t state;
+    uint32_t npages;
+    uint32_t* frames;           /* One page of frame addresses (0 = untouched) */
+    fs_node_t node;             /* Mapped through mmap_map_node() */
+} shm_segment_t;
+
+static shm_segment_t segments[MAX_SHM_SEGMENTS];
+
+static int shm_map_page(fs_node_t* node, uint32_t pgoff, uint32_t* frame);
+
+static fs_ops_t shm_ops = {
+    .mmap = shm_map_page,
+};
+
+/**
+ * Supply (allocating on first touch) a segment page to the fault handler
+ */
+static int shm_map_page(fs_node_t* node, uint32_t pgoff, uint32_t* frame) {
+    shm_segment_t* seg = (shm_segment_t*)node->data;
+    if (!seg || seg->state == SHM_FREE || pgoff >= seg->npages) {
+        return -1;
+    }
+
+    if (!seg->frames[pgoff]) {
+        uint32_t page = pmm_alloc_page();
+        if (!page) return -1;
+        pmm_zero_page(page);
+        seg->frames[pgoff] = page;
+    }
+
+    pmm_ref_page(seg->frames[pgoff]);
+    *frame = seg->frames[pgoff];
+    return 0;
+}
+
+/**
+ * Release a segment's pages and its slot
+ */
+static void shm_release(shm_segment_t* seg) {
+    for (uint32_t i = 0; i < seg->npages; i++) {
+        if (seg->frames[i]) {
+            pmm_unref_page(seg->frames[i]);
+        }
+    }
+    pmm_free_pages((uint32_t)seg->frames, 1);
+    seg->frames = NULL;
+    seg->npages = 0;
+    seg->state = SHM_FREE;
+}
+
+static shm_segment_t* shm_get(int32_t id) {
+    if (id < 0 || id >= MAX_SHM_SEGMENTS || segments[id].state != SHM_ACTIVE) {
+        return NULL;
+    }
+    return &segments[id];
+}
+
+/**
+ * Initialize the shared memory segment table
+ */
+void shm_init(void) {
+    for (int i = 0; i < MAX_SHM_SEGMENTS; i++) {
+        segments[i].state = SHM_FREE;
+        segments[i].npages = 0;
+        segments[i].frames = NULL;
+    }
+}
+
+/**
+ * Create a shared memory segment
+ */
+int32_t shm_create(uint32_t size) {
+    uint32_t npages = PAGE_ALIGN(size) >> PAGE_SHIFT;
+    if (size == 0 || npages == 0 || npages > SHM_MAX_PAGES) {
+        return SYSCALL_EINVAL;
+    }
+
+    uint32_t irq = irq_save();
+
+    /* Find a free slot, reclaiming destroyed segments nobody maps anymore */
+    int32_t id = -1;
+    for (int i = 0; i < MAX_SHM_SEGMENTS && id < 0; i++) {
+        if (segments[i].state == SHM_REMOVED && !mmap_node_mapped(&segments[i].node)) {
+            shm_release(&segments[i]);
+        }
+        if (segments[i].state == SHM_FREE) {
+            id = i;
+        }
+    }
+
+    uint32_t table = id >= 0 ? pmm_alloc_page() : 0;
+    if (!table) {
+        irq_restore(irq);
+        return SYSCALL_ENOMEM;
+    }
+    pmm_zero_page(table);
+
+    shm_segment_t* seg = &segments[id];
+    seg->state = SHM_ACTIVE;
+    seg->npages = npages;
+    seg->frames = (uint32_t*)table;
+
+    uint8_t* raw = (uint8_t*)&seg->node;
+    for (uint32_t i = 0; i < sizeof(fs_node_t); i++) {
+        raw[i] = 0;
+    }
+    seg->node.name = "shm";
+    seg->node.type = FS_FILE;
+    seg->node.inode = (uint32_t)id;
+    seg->node.size = npages << PAGE_SHIFT;
+    seg->node.data = seg;
+    seg->node.ops = &shm_ops;
+
+    irq_restore(irq);
+    return id;
+}
+
+/**
+ * Map a segment into the mmap window
+ */
+int32_t shm_map(int32_t id, int prot) {
+    shm_segment_t* seg = shm_get(id);
+    if (!seg) {
+        return SYSCALL_EINVAL;
+    }
+    return mmap_map_node(0, seg->npages << PAGE_SHIFT, prot, MAP_SHARED, &seg->node, 0);
+}
+
+/**
+ * Unmap a segment mapping
+ */
+int32_t shm_unmap(uint32_t addr) {
+    uint32_t irq = irq_save();
+    vm_area_t* area = mmap_lookup(addr);
+    if (!area || area->start != addr || !area->node || area->node->ops != &shm_ops) {
+        irq_restore(irq);
+        return SYSCALL_EINVAL;
+    }
+
+    /*
+     * mprotect may have split the mapping and munmap may have cut it
+     * short: drop the areas that still continue it, and nothing past them
+     */
+    uint32_t end = area->end;
+    for (vm_area_t* a = area->next; a && a->start == end && a->node == area->node &&
+         a->pgoff == area->pgoff + ((end - addr) >> PAGE_SHIFT); a = a->next) {
+        end = a->end;
+    }
+    irq_restore(irq);
+    return mmap_unmap(addr, end - addr);
+}
+
+/**
+ * Destroy a segment
+ */
+int32_t shm_destroy(int32_t id) {
+    uint32_t irq = irq_save();
+
+    shm_segment_t* seg = shm_get(id);
+    if (!seg) {
+        irq_restore(irq);
+        return SYSCALL_EINVAL;
+    }
+
+    if (mmap_node_mapped(&seg->node)) {
+        seg->state = SHM_REMOVED;
+    } else {
+        shm_release(seg);
+    }
+
+    irq_restore(irq);
+    return SYSCALL_SUCCESS;
+}
@@ -0,0 +1,46 @@
+/**
+ * ClaudeOS Object Caches - slab.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Free lists of equal-sized objects carved out of page frames
+ */
+
+#include "types.h"
+#include "slab.h"
+#include "pmm.h"
+#include "idt.h"
+
+void* slab_alloc(slab_t* slab) {
+    uint32_t flags = irq_save();
+
+    if (!slab->free) {
+        uint32_t page = pmm_alloc_page();
+        if (!page) {
+            irq_restore(flags);
+            return NULL;
+        }
+        for (uint32_t off = 0; off + slab->size <= PAGE_SIZE; off += slab->size) {
+            slab_obj_t* obj = (slab_obj_t*)(page + off);
+            obj->next = slab->free;
+            slab->free = obj;
+        }
+    }
+
+    slab_obj_t* obj = slab->free;
+    slab->free = obj->next;
+    irq_restore(flags);
+
+    for (uint32_t i = 0; i < slab->size; i++) {
+        ((uint8_t*)obj)[i] = 0;
+    }
+    return obj;
+}
+
+void slab_free(slab_t* slab, void* ptr) {
+    if (!ptr) return;
+
+    uint32_t flags = irq_save();
+    slab_obj_t* obj = (slab_obj_t*)ptr;
+    obj->next = slab->free;
+    slab->free = obj;
+    irq_restore(flags);
+}
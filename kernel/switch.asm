@@ -0,0 +1,34 @@
+; ============================================================================
+; ClaudeOS Context Switch - switch.asm
+; Author: Worker1 (Kernel+Driver Claude)
+; Description: Kernel stack switch between processes
+; ============================================================================
+
+section .text
+
+; ============================================================================
+; void context_switch(uint32_t* old_esp, uint32_t new_esp)
+;
+; Saves the current context as an interrupt-style frame (EFLAGS, CS, EIP,
+; then PUSHAD) on the current stack, stores ESP in *old_esp, loads new_esp
+; and resumes the frame found there with POPAD + IRETD. New processes are
+; created with the same frame layout by process_create().
+; ============================================================================
+global context_switch
+context_switch:
+    mov eax, [esp + 4]      ; old_esp pointer
+    mov edx, [esp + 8]      ; new stack pointer
+
+    pushfd                  ; EFLAGS
+    push cs                 ; CS
+    push .resume            ; EIP
+    pushad                  ; EAX, ECX, EDX, EBX, ESP, EBP, ESI, EDI
+
+    mov [eax], esp          ; Save old stack
+    mov esp, edx            ; Switch to new stack
+
+    popad
+    iretd
+
+.resume:
+    ret
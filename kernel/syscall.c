@@ -10,12 +10,15 @@
 #include "process.h"
 #include "timer.h"
 #include "vga.h"
-
-/* Forward declarations for VFS functions */
-extern int32_t fs_open(const char* path, int flags);
-extern int32_t fs_close(int32_t fd);
-extern int32_t fs_read(int32_t fd, void* buf, uint32_t count);
-extern int32_t fs_write(int32_t fd, const void* buf, uint32_t count);
+#include "mman.h"
+#include "pipe.h"
+#include "shm.h"
+#include "futex.h"
+#include "ipc.h"
+#include "poll.h"
+#include "timerfd.h"
+#include "../fs/vfs.h"
+#include "../fs/mount.h"
 
 /* String length helper */
 static uint32_t str_len(const char* s) {
@@ -41,15 +44,18 @@ static int32_t do_sys_read(int32_t fd, void* buf, uint32_t count) {
         return SYSCALL_EINVAL;
     }
 
-    if (fd == STDIN_FD) {
+    if (fd == STDIN_FD && !vfs_stdio_node(STDIN_FD)) {
         /* Read from keyboard - for now just return 0 (no input) */
         /* In a full implementation, this would block until input available */
         return 0;
     }
 
-    /* Try VFS for other file descriptors */
-    /* Note: VFS integration would go here */
-    return SYSCALL_EBADF;
+    /* Redirected stdin, pipes and files go through the VFS */
+    if (!vfs_fd_node(fd)) {
+        return SYSCALL_EBADF;
+    }
+    ssize_t n = vfs_read(fd, buf, count);
+    return n < 0 ? SYSCALL_ERROR : (int32_t)n;
 }
 
 /**
@@ -61,7 +67,7 @@ static int32_t do_sys_write(int32_t fd, const void* buf, uint32_t count) {
         return SYSCALL_EINVAL;
     }
 
-    if (fd == STDOUT_FD || fd == STDERR_FD) {
+    if ((fd == STDOUT_FD || fd == STDERR_FD) && !vfs_stdio_node(fd)) {
         /* Write to VGA display */
         const char* str = (const char*)buf;
         for (uint32_t i = 0; i < count; i++) {
@@ -71,8 +77,189 @@ static int32_t do_sys_write(int32_t fd, const void* buf, uint32_t count) {
         return count;
     }
 
-    /* Try VFS for other file descriptors */
-    return SYSCALL_EBADF;
+    /* Redirected output, pipes and files go through the VFS */
+    if (!vfs_fd_node(fd)) {
+        return SYSCALL_EBADF;
+    }
+    ssize_t n = vfs_write(fd, buf, count);
+    if (n < 0) {
+        return vfs_fd_node(fd)->type == FS_PIPE ? SYSCALL_EPIPE : SYSCALL_ERROR;
+    }
+    return (int32_t)n;
+}
+
+/**
+ * SYS_OPENAT - Open a file or directory relative to a directory fd
+ */
+static int32_t do_sys_openat(int32_t dirfd, const char* path, int32_t flags) {
+    if (!path) {
+        return SYSCALL_EINVAL;
+    }
+    if (path[0] != '/' && dirfd != AT_FDCWD && !vfs_fd_node(dirfd)) {
+        return SYSCALL_EBADF;
+    }
+    int fd = vfs_openat(dirfd, path, flags);
+    if (fd < 0) {
+        return vfs_lookupat(dirfd, path) ? SYSCALL_EMFILE : SYSCALL_ENOENT;
+    }
+    return fd;
+}
+
+/**
+ * SYS_OPEN - Open a file or directory
+ */
+static int32_t do_sys_open(const char* path, int32_t flags) {
+    return do_sys_openat(AT_FDCWD, path, flags);
+}
+
+/**
+ * SYS_FSTATAT - Get file status relative to a directory fd
+ */
+static int32_t do_sys_fstatat(int32_t dirfd, const char* path, fs_stat_t* stat) {
+    if (!path || !stat) {
+        return SYSCALL_EINVAL;
+    }
+    return vfs_statat(dirfd, path, stat) < 0 ? SYSCALL_ENOENT : SYSCALL_SUCCESS;
+}
+
+/**
+ * SYS_STAT - Get file status
+ */
+static int32_t do_sys_stat(const char* path, fs_stat_t* stat) {
+    return do_sys_fstatat(AT_FDCWD, path, stat);
+}
+
+/**
+ * SYS_MKDIRAT - Create a directory relative to a directory fd
+ */
+static int32_t do_sys_mkdirat(int32_t dirfd, const char* path) {
+    if (!path) {
+        return SYSCALL_EINVAL;
+    }
+    if (vfs_mkdirat(dirfd, path) < 0) {
+        return vfs_lookupat(dirfd, path) ? SYSCALL_EEXIST : SYSCALL_ENOENT;
+    }
+    return SYSCALL_SUCCESS;
+}
+
+/**
+ * SYS_MKDIR - Create a directory
+ */
+static int32_t do_sys_mkdir(const char* path) {
+    return do_sys_mkdirat(AT_FDCWD, path);
+}
+
+/**
+ * SYS_UNLINK - Remove a file
+ */
+static int32_t do_sys_unlink(const char* path) {
+    if (!path) {
+        return SYSCALL_EINVAL;
+    }
+    if (vfs_unlink(path) < 0) {
+        return vfs_lookup(path) ? SYSCALL_EINVAL : SYSCALL_ENOENT;
+    }
+    return SYSCALL_SUCCESS;
+}
+
+/**
+ * SYS_RMDIR - Remove an empty directory
+ */
+static int32_t do_sys_rmdir(const char* path) {
+    if (!path) {
+        return SYSCALL_EINVAL;
+    }
+    if (vfs_rmdir(path) < 0) {
+        return vfs_lookup(path) ? SYSCALL_EINVAL : SYSCALL_ENOENT;
+    }
+    return SYSCALL_SUCCESS;
+}
+
+/**
+ * SYS_RENAME - Move or rename a file or directory
+ */
+static int32_t do_sys_rename(const char* oldpath, const char* newpath) {
+    if (!oldpath || !newpath) {
+        return SYSCALL_EINVAL;
+    }
+    if (vfs_rename(oldpath, newpath) < 0) {
+        return vfs_lookup(oldpath) ? SYSCALL_EINVAL : SYSCALL_ENOENT;
+    }
+    return SYSCALL_SUCCESS;
+}
+
+/**
+ * SYS_CHDIR - Change the working directory
+ */
+static int32_t do_sys_chdir(const char* path) {
+    if (!path) {
+        return SYSCALL_EINVAL;
+    }
+    fs_node_t* node = vfs_lookup(path);
+    if (!node) {
+        return SYSCALL_ENOENT;
+    }
+    return vfs_chdir(path) < 0 ? SYSCALL_EINVAL : SYSCALL_SUCCESS;
+}
+
+/**
+ * SYS_GETCWD - Get the working directory as an absolute path
+ */
+static int32_t do_sys_getcwd(char* buf, uint32_t size) {
+    if (!buf) {
+        return SYSCALL_EINVAL;
+    }
+    int len = vfs_getcwd(buf, size);
+    return len < 0 ? SYSCALL_EINVAL : len;
+}
+
+/**
+ * SYS_CLOSE - Close a file descriptor
+ */
+static int32_t do_sys_close(int32_t fd) {
+    return vfs_close(fd) < 0 ? SYSCALL_EBADF : SYSCALL_SUCCESS;
+}
+
+/**
+ * SYS_LSEEK - Move a file offset (seeking past the end leaves a hole)
+ */
+static int32_t do_sys_lseek(int32_t fd, int32_t offset, int32_t whence) {
+    if (fd < 3 || !vfs_fd_node(fd)) {
+        return SYSCALL_EBADF;
+    }
+    int32_t pos = vfs_seek(fd, offset, whence);
+    return pos < 0 ? SYSCALL_EINVAL : pos;
+}
+
+/**
+ * SYS_FTRUNCATE - Set the size of an open file
+ */
+static int32_t do_sys_ftruncate(int32_t fd, uint32_t size) {
+    fs_node_t* node = vfs_fd_node(fd);
+    if (!node) {
+        return SYSCALL_EBADF;
+    }
+    if (node->type != FS_FILE) {
+        return SYSCALL_EINVAL;
+    }
+    return vfs_ftruncate(fd, size) < 0 ? SYSCALL_ENOTSUP : SYSCALL_SUCCESS;
+}
+
+/**
+ * SYS_FSYNC - Write back an open file and make it durable
+ */
+static int32_t do_sys_fsync(int32_t fd) {
+    if (!vfs_fd_node(fd)) {
+        return SYSCALL_EBADF;
+    }
+    return vfs_fsync(fd) < 0 ? SYSCALL_ERROR : SYSCALL_SUCCESS;
+}
+
+/**
+ * SYS_SYNC - Write back everything the page cache and filesystems hold
+ */
+static int32_t do_sys_sync(void) {
+    return vfs_sync() < 0 ? SYSCALL_ERROR : SYSCALL_SUCCESS;
 }
 
 /**
@@ -123,6 +310,222 @@ static int32_t do_sys_gettime(void) {
     return (int32_t)(timer_get_ticks() & 0xFFFFFFFF);
 }
 
+/**
+ * SYS_MMAP - Map a file or anonymous memory
+ */
+static int32_t do_sys_mmap(const mmap_args_t* args) {
+    if (!args) {
+        return SYSCALL_EINVAL;
+    }
+    return mmap_map(args->addr, args->length, args->prot, args->flags,
+                    args->fd, args->offset);
+}
+
+/**
+ * SYS_MUNMAP - Remove a mapping
+ */
+static int32_t do_sys_munmap(uint32_t addr, uint32_t length) {
+    return mmap_unmap(addr, length);
+}
+
+/**
+ * SYS_MPROTECT - Change mapping protection
+ */
+static int32_t do_sys_mprotect(uint32_t addr, uint32_t length, int32_t prot) {
+    return mmap_protect(addr, length, prot);
+}
+
+/**
+ * SYS_WAIT - Wait for a process to exit
+ */
+static int32_t do_sys_wait(uint32_t pid) {
+    if (!process_get(pid)) {
+        return SYSCALL_EINVAL;
+    }
+    return process_wait(pid);
+}
+
+/**
+ * SYS_PIPE - Create a pipe, returning its ends in fds[0] and fds[1]
+ */
+static int32_t do_sys_pipe(int32_t* fds) {
+    if (!fds) {
+        return SYSCALL_EINVAL;
+    }
+
+    fs_node_t* read_end;
+    fs_node_t* write_end;
+    if (pipe_create(&read_end, &write_end) != 0) {
+        return SYSCALL_ENOMEM;
+    }
+
+    int rfd = vfs_open_node(read_end, O_RDONLY);
+    if (rfd < 0) {
+        return SYSCALL_EMFILE;
+    }
+    int wfd = vfs_open_node(write_end, O_WRONLY);
+    if (wfd < 0) {
+        vfs_close(rfd);
+        return SYSCALL_EMFILE;
+    }
+
+    fds[0] = rfd;
+    fds[1] = wfd;
+    return SYSCALL_SUCCESS;
+}
+
+/**
+ * SYS_DUP2 - Duplicate oldfd onto newfd
+ */
+static int32_t do_sys_dup2(int32_t oldfd, int32_t newfd) {
+    int32_t result = vfs_dup2(oldfd, newfd);
+    return result < 0 ? SYSCALL_EBADF : result;
+}
+
+/**
+ * SYS_DUP - Duplicate fd onto the lowest free descriptor
+ */
+static int32_t do_sys_dup(int32_t fd) {
+    if (!vfs_fd_node(fd)) {
+        return SYSCALL_EBADF;
+    }
+    int32_t result = vfs_dup(fd);
+    return result < 0 ? SYSCALL_EMFILE : result;
+}
+
+/**
+ * SYS_FUTEX - Wait on or wake a futex word
+ */
+static int32_t do_sys_futex(volatile uint32_t* uaddr, int32_t op, uint32_t val) {
+    switch (op) {
+        case FUTEX_WAIT:
+            return futex_wait(uaddr, val);
+        case FUTEX_WAKE:
+            return futex_wake(uaddr, (int32_t)val);
+        default:
+            return SYSCALL_EINVAL;
+    }
+}
+
+/**
+ * SYS_SHM_CREATE - Create a shared memory segment
+ */
+static int32_t do_sys_shm_create(uint32_t size) {
+    return shm_create(size);
+}
+
+/**
+ * SYS_SHM_MAP - Map a shared memory segment
+ */
+static int32_t do_sys_shm_map(int32_t id, int32_t prot) {
+    return shm_map(id, prot);
+}
+
+/**
+ * SYS_SHM_UNMAP - Unmap a shared memory segment
+ */
+static int32_t do_sys_shm_unmap(uint32_t addr) {
+    return shm_unmap(addr);
+}
+
+/**
+ * SYS_SHM_DESTROY - Destroy a shared memory segment
+ */
+static int32_t do_sys_shm_destroy(int32_t id) {
+    return shm_destroy(id);
+}
+
+/**
+ * SYS_IPC_SEND - Send a message
+ */
+static int32_t do_sys_ipc_send(uint32_t dest, ipc_msg_t* msg) {
+    return ipc_send(dest, msg);
+}
+
+/**
+ * SYS_IPC_RECV - Receive a message
+ */
+static int32_t do_sys_ipc_recv(uint32_t from, ipc_msg_t* msg) {
+    return ipc_recv(from, msg);
+}
+
+/**
+ * SYS_IPC_CALL - Send a message and wait for the reply
+ */
+static int32_t do_sys_ipc_call(uint32_t dest, ipc_msg_t* msg) {
+    return ipc_call(dest, msg);
+}
+
+/**
+ * SYS_IPC_REPLY - Reply to a caller
+ */
+static int32_t do_sys_ipc_reply(uint32_t to, ipc_msg_t* msg) {
+    return ipc_reply(to, msg);
+}
+
+/**
+ * SYS_POLL - Wait for readiness on descriptors
+ */
+static int32_t do_sys_poll(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms) {
+    return poll_fds(fds, nfds, timeout_ms);
+}
+
+/**
+ * SYS_EPOLL_CREATE - Create an epoll instance
+ */
+static int32_t do_sys_epoll_create(void) {
+    return epoll_create();
+}
+
+/**
+ * SYS_EPOLL_CTL - Change an interest set
+ */
+static int32_t do_sys_epoll_ctl(const epoll_ctl_args_t* args) {
+    if (!args) {
+        return SYSCALL_EINVAL;
+    }
+    return epoll_ctl(args->epfd, args->op, args->fd, args->event);
+}
+
+/**
+ * SYS_EPOLL_WAIT - Wait on an interest set
+ */
+static int32_t do_sys_epoll_wait(const epoll_wait_args_t* args) {
+    if (!args) {
+        return SYSCALL_EINVAL;
+    }
+    return epoll_wait(args->epfd, args->events, args->max_events, args->timeout_ms);
+}
+
+/**
+ * SYS_TIMERFD - Create a periodic timer descriptor
+ */
+static int32_t do_sys_timerfd(uint32_t interval_ms) {
+    return timerfd_create(interval_ms);
+}
+
+/**
+ * SYS_GETDENTS - Read a batch of directory entries
+ */
+static int32_t do_sys_getdents(int32_t fd, fs_dirent_t* entries, uint32_t count) {
+    if (!entries) {
+        return SYSCALL_EINVAL;
+    }
+    int n = vfs_getdents(fd, entries, (int)count);
+    return n < 0 ? SYSCALL_EBADF : n;
+}
+
+/**
+ * SYS_READDIRPLUS - Read a batch of directory entries with stat data
+ */
+static int32_t do_sys_readdirplus(int32_t fd, fs_direntplus_t* entries, uint32_t count) {
+    if (!entries) {
+        return SYSCALL_EINVAL;
+    }
+    int n = vfs_readdirplus(fd, entries, (int)count);
+    return n < 0 ? SYSCALL_EBADF : n;
+}
+
 /**
  * System call dispatch table
  */
@@ -137,17 +540,47 @@ static syscall_fn_t syscall_table[SYS_MAX] = {
     [SYS_YIELD]   = (syscall_fn_t)do_sys_yield,
     [SYS_FORK]    = NULL,  /* Not implemented */
     [SYS_EXEC]    = NULL,  /* Not implemented */
-    [SYS_WAIT]    = NULL,  /* Not implemented */
-    [SYS_OPEN]    = NULL,  /* TODO: VFS integration */
-    [SYS_CLOSE]   = NULL,  /* TODO: VFS integration */
-    [SYS_STAT]    = NULL,  /* TODO: VFS integration */
-    [SYS_MKDIR]   = NULL,  /* TODO: VFS integration */
-    [SYS_RMDIR]   = NULL,  /* TODO: VFS integration */
-    [SYS_UNLINK]  = NULL,  /* TODO: VFS integration */
-    [SYS_CHDIR]   = NULL,  /* TODO: VFS integration */
-    [SYS_GETCWD]  = NULL,  /* TODO: VFS integration */
+    [SYS_WAIT]    = (syscall_fn_t)do_sys_wait,
+    [SYS_OPEN]    = (syscall_fn_t)do_sys_open,
+    [SYS_CLOSE]   = (syscall_fn_t)do_sys_close,
+    [SYS_STAT]    = (syscall_fn_t)do_sys_stat,
+    [SYS_MKDIR]   = (syscall_fn_t)do_sys_mkdir,
+    [SYS_RMDIR]   = (syscall_fn_t)do_sys_rmdir,
+    [SYS_UNLINK]  = (syscall_fn_t)do_sys_unlink,
+    [SYS_CHDIR]   = (syscall_fn_t)do_sys_chdir,
+    [SYS_GETCWD]  = (syscall_fn_t)do_sys_getcwd,
     [SYS_GETTIME] = (syscall_fn_t)do_sys_gettime,
     [SYS_UPTIME]  = (syscall_fn_t)do_sys_uptime,
+    [SYS_MMAP]    = (syscall_fn_t)do_sys_mmap,
+    [SYS_MUNMAP]  = (syscall_fn_t)do_sys_munmap,
+    [SYS_MPROTECT] = (syscall_fn_t)do_sys_mprotect,
+    [SYS_PIPE]    = (syscall_fn_t)do_sys_pipe,
+    [SYS_DUP2]    = (syscall_fn_t)do_sys_dup2,
+    [SYS_FUTEX]   = (syscall_fn_t)do_sys_futex,
+    [SYS_SHM_CREATE]  = (syscall_fn_t)do_sys_shm_create,
+    [SYS_SHM_MAP]     = (syscall_fn_t)do_sys_shm_map,
+    [SYS_SHM_UNMAP]   = (syscall_fn_t)do_sys_shm_unmap,
+    [SYS_SHM_DESTROY] = (syscall_fn_t)do_sys_shm_destroy,
+    [SYS_IPC_SEND]    = (syscall_fn_t)do_sys_ipc_send,
+    [SYS_IPC_RECV]    = (syscall_fn_t)do_sys_ipc_recv,
+    [SYS_IPC_CALL]    = (syscall_fn_t)do_sys_ipc_call,
+    [SYS_IPC_REPLY]   = (syscall_fn_t)do_sys_ipc_reply,
+    [SYS_POLL]        = (syscall_fn_t)do_sys_poll,
+    [SYS_EPOLL_CREATE] = (syscall_fn_t)do_sys_epoll_create,
+    [SYS_EPOLL_CTL]   = (syscall_fn_t)do_sys_epoll_ctl,
+    [SYS_EPOLL_WAIT]  = (syscall_fn_t)do_sys_epoll_wait,
+    [SYS_TIMERFD]     = (syscall_fn_t)do_sys_timerfd,
+    [SYS_GETDENTS]    = (syscall_fn_t)do_sys_getdents,
+    [SYS_READDIRPLUS] = (syscall_fn_t)do_sys_readdirplus,
+    [SYS_LSEEK]       = (syscall_fn_t)do_sys_lseek,
+    [SYS_FTRUNCATE]   = (syscall_fn_t)do_sys_ftruncate,
+    [SYS_DUP]         = (syscall_fn_t)do_sys_dup,
+    [SYS_OPENAT]      = (syscall_fn_t)do_sys_openat,
+    [SYS_MKDIRAT]     = (syscall_fn_t)do_sys_mkdirat,
+    [SYS_FSTATAT]     = (syscall_fn_t)do_sys_fstatat,
+    [SYS_RENAME]      = (syscall_fn_t)do_sys_rename,
+    [SYS_FSYNC]       = (syscall_fn_t)do_sys_fsync,
+    [SYS_SYNC]        = (syscall_fn_t)do_sys_sync,
 };
 
 /**
@@ -317,4 +750,577 @@ uint64_t sys_gettime(void) {
     return (uint64_t)low;
 }
 
+int32_t sys_mmap(const void* args) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $19, %%eax\n"  /* SYS_MMAP = 19 */
+        "mov %1, %%ebx\n"   /* args in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(args)
+        : "eax", "ebx"
+    );
+    return result;
+}
+
+int32_t sys_munmap(void* addr, uint32_t length) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $20, %%eax\n"  /* SYS_MUNMAP = 20 */
+        "mov %1, %%ebx\n"   /* addr in EBX */
+        "mov %2, %%ecx\n"   /* length in ECX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(addr), "r"(length)
+        : "eax", "ebx", "ecx"
+    );
+    return result;
+}
+
+int32_t sys_mprotect(void* addr, uint32_t length, int32_t prot) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $21, %%eax\n"  /* SYS_MPROTECT = 21 */
+        "mov %1, %%ebx\n"   /* addr in EBX */
+        "mov %2, %%ecx\n"   /* length in ECX */
+        "mov %3, %%edx\n"   /* prot in EDX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(addr), "r"(length), "r"(prot)
+        : "eax", "ebx", "ecx", "edx"
+    );
+    return result;
+}
+
+int32_t sys_wait(uint32_t pid) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $8, %%eax\n"   /* SYS_WAIT = 8 */
+        "mov %1, %%ebx\n"   /* pid in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(pid)
+        : "eax", "ebx"
+    );
+    return result;
+}
+
+int32_t sys_pipe(int32_t fds[2]) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $22, %%eax\n"  /* SYS_PIPE = 22 */
+        "mov %1, %%ebx\n"   /* fds in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(fds)
+        : "eax", "ebx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_dup2(int32_t oldfd, int32_t newfd) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $23, %%eax\n"  /* SYS_DUP2 = 23 */
+        "mov %1, %%ebx\n"   /* oldfd in EBX */
+        "mov %2, %%ecx\n"   /* newfd in ECX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(oldfd), "r"(newfd)
+        : "eax", "ebx", "ecx"
+    );
+    return result;
+}
+
+int32_t sys_futex(volatile uint32_t* uaddr, int32_t op, uint32_t val) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $24, %%eax\n"  /* SYS_FUTEX = 24 */
+        "mov %1, %%ebx\n"   /* uaddr in EBX */
+        "mov %2, %%ecx\n"   /* op in ECX */
+        "mov %3, %%edx\n"   /* val in EDX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(uaddr), "r"(op), "r"(val)
+        : "eax", "ebx", "ecx", "edx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_shm_create(uint32_t size) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $25, %%eax\n"  /* SYS_SHM_CREATE = 25 */
+        "mov %1, %%ebx\n"   /* size in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(size)
+        : "eax", "ebx"
+    );
+    return result;
+}
+
+void* sys_shm_map(int32_t id, int32_t prot) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $26, %%eax\n"  /* SYS_SHM_MAP = 26 */
+        "mov %1, %%ebx\n"   /* id in EBX */
+        "mov %2, %%ecx\n"   /* prot in ECX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(id), "r"(prot)
+        : "eax", "ebx", "ecx"
+    );
+    return (void*)result;
+}
+
+int32_t sys_shm_unmap(void* addr) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $27, %%eax\n"  /* SYS_SHM_UNMAP = 27 */
+        "mov %1, %%ebx\n"   /* addr in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(addr)
+        : "eax", "ebx"
+    );
+    return result;
+}
+
+int32_t sys_shm_destroy(int32_t id) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $28, %%eax\n"  /* SYS_SHM_DESTROY = 28 */
+        "mov %1, %%ebx\n"   /* id in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(id)
+        : "eax", "ebx"
+    );
+    return result;
+}
+
+int32_t sys_ipc_send(uint32_t dest, struct ipc_msg* msg) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $29, %%eax\n"  /* SYS_IPC_SEND = 29 */
+        "mov %1, %%ebx\n"   /* dest in EBX */
+        "mov %2, %%ecx\n"   /* msg in ECX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(dest), "r"(msg)
+        : "eax", "ebx", "ecx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_ipc_recv(uint32_t from, struct ipc_msg* msg) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $30, %%eax\n"  /* SYS_IPC_RECV = 30 */
+        "mov %1, %%ebx\n"   /* from in EBX */
+        "mov %2, %%ecx\n"   /* msg in ECX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(from), "r"(msg)
+        : "eax", "ebx", "ecx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_ipc_call(uint32_t dest, struct ipc_msg* msg) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $31, %%eax\n"  /* SYS_IPC_CALL = 31 */
+        "mov %1, %%ebx\n"   /* dest in EBX */
+        "mov %2, %%ecx\n"   /* msg in ECX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(dest), "r"(msg)
+        : "eax", "ebx", "ecx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_ipc_reply(uint32_t to, struct ipc_msg* msg) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $32, %%eax\n"  /* SYS_IPC_REPLY = 32 */
+        "mov %1, %%ebx\n"   /* to in EBX */
+        "mov %2, %%ecx\n"   /* msg in ECX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(to), "r"(msg)
+        : "eax", "ebx", "ecx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_poll(void* fds, uint32_t nfds, int32_t timeout_ms) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $33, %%eax\n"  /* SYS_POLL = 33 */
+        "mov %1, %%ebx\n"   /* fds in EBX */
+        "mov %2, %%ecx\n"   /* nfds in ECX */
+        "mov %3, %%edx\n"   /* timeout in EDX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(fds), "r"(nfds), "r"(timeout_ms)
+        : "eax", "ebx", "ecx", "edx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_epoll_create(void) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $34, %%eax\n"  /* SYS_EPOLL_CREATE = 34 */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        :
+        : "eax"
+    );
+    return result;
+}
+
+int32_t sys_epoll_ctl(const void* args) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $35, %%eax\n"  /* SYS_EPOLL_CTL = 35 */
+        "mov %1, %%ebx\n"   /* args in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(args)
+        : "eax", "ebx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_epoll_wait(const void* args) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $36, %%eax\n"  /* SYS_EPOLL_WAIT = 36 */
+        "mov %1, %%ebx\n"   /* args in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(args)
+        : "eax", "ebx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_timerfd(uint32_t interval_ms) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $37, %%eax\n"  /* SYS_TIMERFD = 37 */
+        "mov %1, %%ebx\n"   /* interval in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(interval_ms)
+        : "eax", "ebx"
+    );
+    return result;
+}
+
+int32_t sys_open(const char* path, int32_t flags) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $9, %%eax\n"   /* SYS_OPEN = 9 */
+        "mov %1, %%ebx\n"   /* path in EBX */
+        "mov %2, %%ecx\n"   /* flags in ECX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(path), "r"(flags)
+        : "eax", "ebx", "ecx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_close(int32_t fd) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $10, %%eax\n"  /* SYS_CLOSE = 10 */
+        "mov %1, %%ebx\n"   /* fd in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(fd)
+        : "eax", "ebx"
+    );
+    return result;
+}
+
+int32_t sys_getdents(int32_t fd, void* entries, uint32_t count) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $38, %%eax\n"  /* SYS_GETDENTS = 38 */
+        "mov %1, %%ebx\n"   /* fd in EBX */
+        "mov %2, %%ecx\n"   /* entries in ECX */
+        "mov %3, %%edx\n"   /* count in EDX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(fd), "r"(entries), "r"(count)
+        : "eax", "ebx", "ecx", "edx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_readdirplus(int32_t fd, void* entries, uint32_t count) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $39, %%eax\n"  /* SYS_READDIRPLUS = 39 */
+        "mov %1, %%ebx\n"   /* fd in EBX */
+        "mov %2, %%ecx\n"   /* entries in ECX */
+        "mov %3, %%edx\n"   /* count in EDX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(fd), "r"(entries), "r"(count)
+        : "eax", "ebx", "ecx", "edx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_lseek(int32_t fd, int32_t offset, int32_t whence) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $40, %%eax\n"  /* SYS_LSEEK = 40 */
+        "mov %1, %%ebx\n"   /* fd in EBX */
+        "mov %2, %%ecx\n"   /* offset in ECX */
+        "mov %3, %%edx\n"   /* whence in EDX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(fd), "r"(offset), "r"(whence)
+        : "eax", "ebx", "ecx", "edx"
+    );
+    return result;
+}
+
+int32_t sys_ftruncate(int32_t fd, uint32_t size) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $41, %%eax\n"  /* SYS_FTRUNCATE = 41 */
+        "mov %1, %%ebx\n"   /* fd in EBX */
+        "mov %2, %%ecx\n"   /* size in ECX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(fd), "r"(size)
+        : "eax", "ebx", "ecx"
+    );
+    return result;
+}
+
+int32_t sys_fsync(int32_t fd) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $47, %%eax\n"  /* SYS_FSYNC = 47 */
+        "mov %1, %%ebx\n"   /* fd in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(fd)
+        : "eax", "ebx"
+    );
+    return result;
+}
+
+int32_t sys_sync(void) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $48, %%eax\n"  /* SYS_SYNC = 48 */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        :
+        : "eax"
+    );
+    return result;
+}
+
+int32_t sys_dup(int32_t fd) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $42, %%eax\n"  /* SYS_DUP = 42 */
+        "mov %1, %%ebx\n"   /* fd in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(fd)
+        : "eax", "ebx"
+    );
+    return result;
+}
+
+int32_t sys_stat(const char* path, void* stat) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $11, %%eax\n"  /* SYS_STAT = 11 */
+        "mov %1, %%ebx\n"   /* path in EBX */
+        "mov %2, %%ecx\n"   /* stat in ECX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(path), "r"(stat)
+        : "eax", "ebx", "ecx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_mkdir(const char* path) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $12, %%eax\n"  /* SYS_MKDIR = 12 */
+        "mov %1, %%ebx\n"   /* path in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(path)
+        : "eax", "ebx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_chdir(const char* path) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $15, %%eax\n"  /* SYS_CHDIR = 15 */
+        "mov %1, %%ebx\n"   /* path in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(path)
+        : "eax", "ebx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_getcwd(char* buf, uint32_t size) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $16, %%eax\n"  /* SYS_GETCWD = 16 */
+        "mov %1, %%ebx\n"   /* buf in EBX */
+        "mov %2, %%ecx\n"   /* size in ECX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(buf), "r"(size)
+        : "eax", "ebx", "ecx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_openat(int32_t dirfd, const char* path, int32_t flags) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $43, %%eax\n"  /* SYS_OPENAT = 43 */
+        "mov %1, %%ebx\n"   /* dirfd in EBX */
+        "mov %2, %%ecx\n"   /* path in ECX */
+        "mov %3, %%edx\n"   /* flags in EDX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(dirfd), "r"(path), "r"(flags)
+        : "eax", "ebx", "ecx", "edx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_mkdirat(int32_t dirfd, const char* path) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $44, %%eax\n"  /* SYS_MKDIRAT = 44 */
+        "mov %1, %%ebx\n"   /* dirfd in EBX */
+        "mov %2, %%ecx\n"   /* path in ECX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(dirfd), "r"(path)
+        : "eax", "ebx", "ecx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_fstatat(int32_t dirfd, const char* path, void* stat) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $45, %%eax\n"  /* SYS_FSTATAT = 45 */
+        "mov %1, %%ebx\n"   /* dirfd in EBX */
+        "mov %2, %%ecx\n"   /* path in ECX */
+        "mov %3, %%edx\n"   /* stat in EDX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(dirfd), "r"(path), "r"(stat)
+        : "eax", "ebx", "ecx", "edx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_unlink(const char* path) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $14, %%eax\n"  /* SYS_UNLINK = 14 */
+        "mov %1, %%ebx\n"   /* path in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(path)
+        : "eax", "ebx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_rmdir(const char* path) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $13, %%eax\n"  /* SYS_RMDIR = 13 */
+        "mov %1, %%ebx\n"   /* path in EBX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(path)
+        : "eax", "ebx", "memory"
+    );
+    return result;
+}
+
+int32_t sys_rename(const char* oldpath, const char* newpath) {
+    int32_t result;
+    __asm__ volatile (
+        "mov $46, %%eax\n"  /* SYS_RENAME = 46 */
+        "mov %1, %%ebx\n"   /* oldpath in EBX */
+        "mov %2, %%ecx\n"   /* newpath in ECX */
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(result)
+        : "r"(oldpath), "r"(newpath)
+        : "eax", "ebx", "ecx", "memory"
+    );
+    return result;
+}
+
 #endif /* ENABLE_USERSPACE_SYSCALLS */
@@ -0,0 +1,166 @@
+/**
+ * ClaudeOS Timer Descriptors - timerfd.c
+ * Author: Worker1 (Kernel+Driver Claude)
+ * Description: Periodic timers readable and pollable as file descriptors
+ */
+
+#include "types.h"
+#include "timerfd.h"
+#include "timer.h"
+#include "process.h"
+#include "poll.h"
+#include "syscall.h"
+#include "idt.h"
+#include "../fs/vfs.h"
+
+typedef struct {
+    bool in_use;
+    uint32_t refs;              /* Open descriptors */
+    uint64_t interval;          /* Period in ticks */
+    uint64_t next_expiry;       /* Tick of the next expiration */
+    uint32_t expirations;       /* Expirations not yet read */
+    wait_queue_t wait;          /* Readers and pollers */
+    fs_node_t node;
+} timerfd_t;
+
+static timerfd_t timerfds[MAX_TIMERFDS];
+
+/**
+ * Per-tick hook: count expirations and wake readers
+ */
+static void timerfd_tick(uint64_t ticks) {
+    for (int i = 0; i < MAX_TIMERFDS; i++) {
+        timerfd_t* t = &timerfds[i];
+        if (!t->in_use || ticks < t->next_expiry) {
+            continue;
+        }
+        while (ticks >= t->next_expiry) {
+            t->expirations++;
+            t->next_expiry += t->interval;
+        }
+        wait_queue_wake_all(&t->wait);
+    }
+}
+
+/*
+ * ===========================================================================
+ * Node Operations
+ * ===========================================================================
+ */
+
+static int timerfd_open(fs_node_t* node, int flags) {
+    (void)flags;
+    timerfd_t* t = (timerfd_t*)node->data;
+    uint32_t irq = irq_save();
+    t->refs++;
+    irq_restore(irq);
+    return 0;
+}
+
+static int timerfd_close(fs_node_t* node) {
+    timerfd_t* t = (timerfd_t*)node->data;
+    uint32_t irq = irq_save();
+    if (t->refs > 0 && --t->refs == 0) {
+        t->in_use = false;
+    }
+    irq_restore(irq);
+    return 0;
+}
+
+static ssize_t timerfd_read(fs_node_t* node, void* buf, size_t size, size_t offset) {
+    (void)offset;
+    timerfd_t* t = (timerfd_t*)node->data;
+    if (size < sizeof(uint32_t)) {
+        return -1;
+    }
+
+    uint32_t irq = irq_save();
+    while (t->expirations == 0) {
+        wait_queue_sleep(&t->wait);
+    }
+    *(uint32_t*)buf = t->expirations;
+    t->expirations = 0;
+    irq_restore(irq);
+
+    return sizeof(uint32_t);
+}
+
+static uint32_t timerfd_poll(fs_node_t* node, poll_table_t* pt) {
+    timerfd_t* t = (timerfd_t*)node->data;
+    poll_wait(pt, &t->wait);
+    return t->expirations ? POLLIN : 0;
+}
+
+static fs_ops_t timerfd_ops = {
+    .open  = timerfd_open,
+    .close = timerfd_close,
+    .read  = timerfd_read,
+    .poll  = timerfd_poll,
+};
+
+/*
+ * ===========================================================================
+ * Public Interface
+ * ===========================================================================
+ */
+
+/**
+ * Initialize timer descriptors
+ */
+void timerfd_init(void) {
+    for (int i = 0; i < MAX_TIMERFDS; i++) {
+        timerfds[i].in_use = false;
+        timerfds[i].refs = 0;
+    }
+    timer_add_hook(timerfd_tick);
+}
+
+/**
+ * Create a periodic timer descriptor
+ */
+int32_t timerfd_create(uint32_t interval_ms) {
+    uint64_t interval = interval_ms / MS_PER_TICK;
+    if (interval == 0) {
+        interval = 1;
+    }
+
+    uint32_t irq = irq_save();
+
+    timerfd_t* t = NULL;
+    for (int i = 0; i < MAX_TIMERFDS; i++) {
+        if (!timerfds[i].in_use) {
+            t = &timerfds[i];
+            break;
+        }
+    }
+    if (!t) {
+        irq_restore(irq);
+        return SYSCALL_ENOMEM;
+    }
+
+    uint8_t* raw = (uint8_t*)&t->node;
+    for (uint32_t i = 0; i < sizeof(fs_node_t); i++) {
+        raw[i] = 0;
+    }
+    t->node.name = "timer";
+    t->node.type = FS_CHARDEV;
+    t->node.data = t;
+    t->node.ops = &timerfd_ops;
+
+    t->in_use = true;
+    t->refs = 0;
+    t->interval = interval;
+    t->next_expiry = timer_get_ticks() + interval;
+    t->expirations = 0;
+    wait_queue_init(&t->wait);
+
+    int fd = vfs_open_node(&t->node, O_RDONLY);
+    if (fd < 0) {
+        t->in_use = false;
+        irq_restore(irq);
+        return SYSCALL_EMFILE;
+    }
+
+    irq_restore(irq);
+    return fd;
+}
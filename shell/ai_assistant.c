@@ -124,7 +124,7 @@ static void ai_itoa(uint32_t num, char *buf) {
 static const ai_command_info_t command_db[] = {
     /* Filesystem commands */
     {
-        "ls", "ls [directory]",
+        "ls", "ls [-l] [directory]",
         "List files and directories in the current or specified directory",
         "ls /home/claude",
         "filesystem"
@@ -0,0 +1,1347 @@
+/*
+ * ClaudeOS Shell - Benchmarks
+ * Worker1 - Shell Claude
+ *
+ * Micro-benchmarks for kernel primitives, timed with the TSC.
+ *
+ * Usage:
+ *   bench ipc [iterations]     - IPC call/reply ping-pong latency
+ *   bench lookup [iterations]  - Path lookup cost, cached vs uncached
+ *   bench dir [entries]        - Insert and lookup cost in a large directory
+ *   bench pcache [pages]       - Page cache reads, sequential vs random
+ *   bench fd [count]           - Descriptor open/close with many fds open
+ *   bench churn [rounds]       - Temp file create/write/delete, frames in use
+ *   bench small [files]        - Memory per small file (inline data, interned names)
+ *   bench blk [bios]           - Block queue: requests with and without plugging,
+ *                                head travel under noop vs deadline
+ *   bench disk [MB]            - hda sequential read, PIO vs DMA throughput and CPU
+ *   bench iops <dev> [ios] [poll] - Random 4K reads at queue depth 1..32, IOPS and IRQs
+ *   bench ram [MB]             - ram0: copy vs shared-page cost, and mkfs time
+ *   bench ext2 [MB]            - ram0: file write/read through ext2 vs the raw device
+ *   bench fat [MB]             - ram0: FAT32 file write/read, requests per cold read
+ *   bench lfs [files]          - ram0: small-file creates on lfs vs ext2, requests and KB written
+ *   bench wb [pages]           - ram0: write burst and fsync on ext2, pages per write-back
+ */
+
+#include "shell.h"
+#include "../include/io.h"
+#include "../include/timer.h"
+#include "../include/process.h"
+#include "../include/ipc.h"
+#include "../include/pmm.h"
+#include "../include/block.h"
+#include "../include/ata.h"
+#include "../include/nvme.h"
+#include "../include/ramdisk.h"
+#include "../fs/vfs.h"
+#include "../fs/mount.h"
+#include "../fs/dcache.h"
+#include "../fs/pagecache.h"
+#include "../fs/names.h"
+#include "../fs/mkfs.h"
+
+/* String compare (no libc in freestanding mode) */
+static int bench_strcmp(const char *s1, const char *s2) {
+    while (*s1 && *s2 && *s1 == *s2) { s1++; s2++; }
+    return *s1 - *s2;
+}
+
+static uint32_t bench_atoi(const char *s) {
+    uint32_t n = 0;
+    while (*s >= '0' && *s <= '9') {
+        n = n * 10 + (uint32_t)(*s++ - '0');
+    }
+    return n;
+}
+
+static void bench_print_u64(uint64_t num) {
+    char buf[24];
+    int i = 0;
+    do {
+        buf[i++] = '0' + (char)(num % 10);
+        num /= 10;
+    } while (num > 0);
+    while (i > 0) {
+        display_putchar(buf[--i]);
+    }
+}
+
+/* Print "<label>: <avg> cycles/op (<n> ops)" */
+static void bench_report(const char *label, uint64_t cycles, uint32_t ops) {
+    display_print("  ");
+    display_print(label);
+    display_print(": ");
+    bench_print_u64(ops ? cycles / ops : 0);
+    display_print(" cycles/op (");
+    bench_print_u64(ops);
+    display_print(" ops)\n");
+}
+
+/*
+ * ===========================================================================
+ * IPC ping-pong
+ * ===========================================================================
+ */
+
+#define BENCH_IPC_PING  1
+#define BENCH_IPC_QUIT  2
+
+/* Echo server: bump the first word and reply until told to quit */
+static void bench_ipc_server(void) {
+    ipc_msg_t msg;
+    for (;;) {
+        msg.buf = NULL;
+        msg.len = 0;
+        int32_t client = ipc_recv(0, &msg);
+        if (client < 0) {
+            return;
+        }
+        uint32_t label = msg.label;
+        msg.words[0]++;
+        ipc_reply((uint32_t)client, &msg);
+        if (label == BENCH_IPC_QUIT) {
+            return;
+        }
+    }
+}
+
+static int bench_ipc(uint32_t iterations) {
+    int32_t server = process_create("ipc-bench", bench_ipc_server, PRIORITY_NORMAL);
+    if (server < 0) {
+        display_print("bench: cannot start IPC server\n");
+        return 1;
+    }
+
+    ipc_msg_t msg;
+    msg.label = BENCH_IPC_PING;
+    msg.words[0] = 0;
+    msg.buf = NULL;
+    msg.len = 0;
+
+    /* First call waits for the server to reach ipc_recv() */
+    if (ipc_call((uint32_t)server, &msg) != 0) {
+        display_print("bench: IPC call failed\n");
+        process_kill((uint32_t)server);
+        process_wait((uint32_t)server);
+        return 1;
+    }
+
+    uint64_t start = timer_read_tsc();
+    for (uint32_t i = 0; i < iterations; i++) {
+        ipc_call((uint32_t)server, &msg);
+    }
+    uint64_t cycles = timer_read_tsc() - start;
+
+    msg.label = BENCH_IPC_QUIT;
+    ipc_call((uint32_t)server, &msg);
+    process_wait((uint32_t)server);
+
+    if (msg.words[0] != iterations + 2) {
+        display_print("bench: IPC echo count mismatch\n");
+        return 1;
+    }
+
+    bench_report("ipc call/reply round trip", cycles, iterations);
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Path lookup
+ * ===========================================================================
+ */
+
+#define BENCH_LOOKUP_STEP   4   /* Entries added to the leaf per round */
+#define BENCH_LOOKUP_MAX    16
+
+/* Find or create a directory under 'parent' */
+static fs_node_t *bench_dir_node(fs_node_t *parent, const char *path, const char *name) {
+    fs_node_t *dir = vfs_lookup(path);
+    if (!dir && parent) {
+        dir = vfs_create_dir(parent, name);
+    }
+    return dir;
+}
+
+/* "f<n>" and "/tmp/lk/a/b/f<n>" */
+static void bench_entry_name(char *name, char *path, uint32_t n) {
+    const char *prefix = "/tmp/lk/a/b/";
+    int p = 0;
+    while (*prefix) path[p++] = *prefix++;
+
+    char digits[12];
+    int d = 0;
+    do {
+        digits[d++] = '0' + (char)(n % 10);
+        n /= 10;
+    } while (n > 0);
+
+    int i = 0;
+    name[i++] = 'f';
+    while (d > 0) name[i++] = digits[--d];
+    name[i] = '\0';
+
+    for (i = 0; name[i]; i++) path[p++] = name[i];
+    path[p] = '\0';
+}
+
+/*
+ * Resolve /tmp/lk/a/b/f<last> while the leaf directory grows. Uncached
+ * lookups flush the dentry cache first and so scan every directory on
+ * the way; cached lookups should cost the same at every size.
+ */
+static int bench_lookup(uint32_t iterations) {
+    fs_node_t *lk = bench_dir_node(vfs_lookup("/tmp"), "/tmp/lk", "lk");
+    fs_node_t *a = lk ? bench_dir_node(lk, "/tmp/lk/a", "a") : NULL;
+    fs_node_t *b = a ? bench_dir_node(a, "/tmp/lk/a/b", "b") : NULL;
+    if (!b) {
+        display_print("bench: cannot create /tmp/lk/a/b\n");
+        return 1;
+    }
+
+    char name[16];
+    char path[32];
+    for (uint32_t size = BENCH_LOOKUP_STEP; size <= BENCH_LOOKUP_MAX; size += BENCH_LOOKUP_STEP) {
+        for (uint32_t n = 0; n < size; n++) {
+            bench_entry_name(name, path, n);
+            if (!vfs_lookup(path) && !vfs_create_file(b, name, NULL)) {
+                display_print("bench: out of filesystem nodes\n");
+                return 1;
+            }
+        }
+
+        bench_entry_name(name, path, size - 1);
+        fs_node_t *target = vfs_lookup(path);
+
+        uint64_t start = timer_read_tsc();
+        for (uint32_t i = 0; i < iterations; i++) {
+            dcache_flush();
+            vfs_lookup(path);
+        }
+        uint64_t cold = timer_read_tsc() - start;
+
+        start = timer_read_tsc();
+        for (uint32_t i = 0; i < iterations; i++) {
+            if (vfs_lookup(path) != target) {
+                display_print("bench: lookup returned the wrong node\n");
+                return 1;
+            }
+        }
+        uint64_t warm = timer_read_tsc() - start;
+
+        display_print("  ");
+        bench_print_u64(size);
+        display_print(" entries in leaf directory:\n");
+        bench_report("  uncached", cold, iterations);
+        bench_report("  cached", warm, iterations);
+    }
+
+    dcache_stats_t stats;
+    dcache_get_stats(&stats);
+    display_print("  dcache: ");
+    bench_print_u64(stats.hits);
+    display_print(" hits, ");
+    bench_print_u64(stats.negative_hits);
+    display_print(" negative hits, ");
+    bench_print_u64(stats.misses);
+    display_print(" misses, ");
+    bench_print_u64(stats.evictions);
+    display_print(" evictions\n");
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Large directory
+ * ===========================================================================
+ */
+
+/* "e<n>" */
+static void bench_dir_name(char *name, uint32_t n) {
+    char digits[12];
+    int d = 0;
+    do {
+        digits[d++] = '0' + (char)(n % 10);
+        n /= 10;
+    } while (n > 0);
+
+    int i = 0;
+    name[i++] = 'e';
+    while (d > 0) name[i++] = digits[--d];
+    name[i] = '\0';
+}
+
+/*
+ * Grow /tmp/bigdir to 'entries' files, then look every one of them up
+ * through the directory's finddir (below the dentry cache). Entries are
+ * kept between runs, so a second run only measures lookups.
+ */
+static int bench_dir(uint32_t entries) {
+    fs_node_t *dir = bench_dir_node(vfs_lookup("/tmp"), "/tmp/bigdir", "bigdir");
+    if (!dir || !dir->ops || !dir->ops->finddir) {
+        display_print("bench: cannot create /tmp/bigdir\n");
+        return 1;
+    }
+
+    char name[16];
+    uint32_t have = (uint32_t)dir->child_count;
+    if (have < entries) {
+        uint64_t start = timer_read_tsc();
+        for (uint32_t n = have; n < entries; n++) {
+            bench_dir_name(name, n);
+            if (!vfs_create_file(dir, name, NULL)) {
+                display_print("bench: out of memory at ");
+                bench_print_u64(n);
+                display_print(" entries\n");
+                return 1;
+            }
+        }
+        bench_report("insert", timer_read_tsc() - start, entries - have);
+    }
+
+    uint64_t start = timer_read_tsc();
+    for (uint32_t n = 0; n < entries; n++) {
+        bench_dir_name(name, n);
+        if (!dir->ops->finddir(dir, name)) {
+            display_print("bench: entry missing\n");
+            return 1;
+        }
+    }
+    bench_report("lookup", timer_read_tsc() - start, entries);
+
+    display_print("  directory now holds ");
+    bench_print_u64((uint64_t)dir->child_count);
+    display_print(" entries\n");
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Page cache
+ * ===========================================================================
+ */
+
+/* Synthetic block-backed file: each readpage is one "device read" */
+static uint32_t bench_readpages = 0;
+
+static int bench_readpage(fs_node_t *node, uint32_t pgoff, void *page) {
+    (void)node;
+    uint32_t *words = (uint32_t *)page;
+    for (uint32_t i = 0; i < PAGE_SIZE / sizeof(uint32_t); i++) {
+        words[i] = pgoff;
+    }
+    bench_readpages++;
+    return 0;
+}
+
+static fs_ops_t bench_file_ops = {
+    .readpage = bench_readpage,
+};
+
+static uint32_t bench_gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Read every page once, in order or with a stride, and check the data */
+static int bench_pcache_pass(fs_node_t *node, uint32_t pages, uint32_t stride,
+                             const char *label) {
+    static uint32_t buf[PAGE_SIZE / sizeof(uint32_t)];
+
+    int fd = vfs_open_node(node, O_RDONLY);
+    if (fd < 0) {
+        display_print("bench: cannot open file\n");
+        return 1;
+    }
+
+    pcache_stats_t before, after;
+    pcache_get_stats(&before);
+    bench_readpages = 0;
+
+    uint64_t start = timer_read_tsc();
+    uint32_t pg = 0;
+    for (uint32_t i = 0; i < pages; i++) {
+        vfs_seek(fd, (int)(pg * PAGE_SIZE), SEEK_SET);
+        if (vfs_read(fd, buf, PAGE_SIZE) != PAGE_SIZE || buf[0] != pg) {
+            display_print("bench: bad page data\n");
+            vfs_close(fd);
+            return 1;
+        }
+        pg = (pg + stride) % pages;
+    }
+    uint64_t cycles = timer_read_tsc() - start;
+    vfs_close(fd);
+
+    pcache_get_stats(&after);
+    bench_report(label, cycles, pages);
+    display_print("    device reads: ");
+    bench_print_u64(bench_readpages);
+    display_print(", read ahead: ");
+    bench_print_u64(after.readahead - before.readahead);
+    display_print(", hits: ");
+    bench_print_u64(after.hits - before.hits);
+    display_print("\n");
+    return 0;
+}
+
+/*
+ * Read a synthetic file through the page cache: sequentially (read-ahead
+ * kicks in), with a stride (read-ahead stays off), then sequentially
+ * again with everything cached.
+ */
+static int bench_pcache(uint32_t pages) {
+    if (pages > PCACHE_MAX_PAGES / 2) {
+        pages = PCACHE_MAX_PAGES / 2;
+    }
+
+    static fs_node_t node;
+    uint8_t *raw = (uint8_t *)&node;
+    for (uint32_t i = 0; i < sizeof(node); i++) {
+        raw[i] = 0;
+    }
+    node.name = "pc";
+    node.type = FS_FILE;
+    node.size = pages * PAGE_SIZE;
+    node.ops = &bench_file_ops;
+
+    /* A stride coprime to the page count visits every page once */
+    uint32_t stride = 7;
+    while (bench_gcd(stride, pages) != 1) stride += 2;
+
+    int result = bench_pcache_pass(&node, pages, 1, "sequential, cold");
+    if (result == 0) {
+        pcache_invalidate(&node);
+        result = bench_pcache_pass(&node, pages, stride, "strided, cold");
+    }
+    if (result == 0) {
+        result = bench_pcache_pass(&node, pages, 1, "sequential, cached");
+    }
+
+    pcache_invalidate(&node);
+    return result;
+}
+
+/*
+ * ===========================================================================
+ * File descriptors
+ * ===========================================================================
+ */
+
+#define BENCH_FD_MAX    1000
+
+/*
+ * Hold 'count' descriptors open, then time close/reopen of the lowest
+ * one, which the allocator must hand straight back.
+ */
+static int bench_fd(uint32_t count) {
+    static int fds[BENCH_FD_MAX];
+    if (count > BENCH_FD_MAX) {
+        count = BENCH_FD_MAX;
+    }
+
+    fs_node_t *node = vfs_lookup("/");
+    uint32_t opened = 0;
+    uint64_t start = timer_read_tsc();
+    while (opened < count) {
+        int fd = vfs_open_node(node, O_RDONLY);
+        if (fd < 0) break;
+        fds[opened++] = fd;
+    }
+    bench_report("open", timer_read_tsc() - start, opened);
+
+    int status = 0;
+    if (opened > 0) {
+        start = timer_read_tsc();
+        for (uint32_t i = 0; i < 1000; i++) {
+            vfs_close(fds[0]);
+            if (vfs_open_node(node, O_RDONLY) != fds[0]) {
+                display_print("bench: lowest fd not reused\n");
+                status = 1;
+                break;
+            }
+        }
+        bench_report("close+reopen", timer_read_tsc() - start, 1000);
+    }
+
+    for (uint32_t i = 0; i < opened; i++) {
+        vfs_close(fds[i]);
+    }
+
+    display_print("  held ");
+    bench_print_u64(opened);
+    display_print(" descriptors\n");
+    return status;
+}
+
+/*
+ * ===========================================================================
+ * Temp file churn
+ * ===========================================================================
+ */
+
+#define BENCH_CHURN_FILES   16
+
+/*
+ * Create, fill and delete a batch of files in /tmp per round, the way a
+ * compiler or editor uses temp files. One file per round is still open
+ * when it is unlinked, so deferred frees are exercised too. Frames in
+ * use should be the same after the first round and after the last.
+ */
+static int bench_churn(uint32_t rounds) {
+    static char data[PAGE_SIZE + 100];
+    for (uint32_t i = 0; i < sizeof(data); i++) {
+        data[i] = (char)('a' + i % 26);
+    }
+
+    char path[32] = "/tmp/churn";
+    uint32_t after_first = 0;
+    uint64_t start = timer_read_tsc();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (uint32_t n = 0; n < BENCH_CHURN_FILES; n++) {
+            bench_dir_name(path + 10, n);
+            int fd = vfs_open(path, O_WRONLY | O_CREAT | O_TRUNC);
+            if (fd < 0 || vfs_write(fd, data, sizeof(data)) != (ssize_t)sizeof(data)) {
+                display_print("bench: cannot write ");
+                display_print(path);
+                display_print("\n");
+                return 1;
+            }
+            if (n == 0) {
+                /* Unlink while open: freed at close */
+                vfs_unlink(path);
+            }
+            vfs_close(fd);
+        }
+        for (uint32_t n = 1; n < BENCH_CHURN_FILES; n++) {
+            bench_dir_name(path + 10, n);
+            if (vfs_unlink(path) != 0) {
+                display_print("bench: cannot remove ");
+                display_print(path);
+                display_print("\n");
+                return 1;
+            }
+        }
+        if (r == 0) {
+            after_first = pmm_used_count();
+        }
+    }
+    bench_report("file", timer_read_tsc() - start, rounds * BENCH_CHURN_FILES);
+
+    display_print("  frames in use after first round: ");
+    bench_print_u64(after_first);
+    display_print(", after last: ");
+    bench_print_u64(pmm_used_count());
+    display_print("\n");
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Small files
+ * ===========================================================================
+ */
+
+/*
+ * Fill a fresh /tmp/small with 'files' config-sized files and report
+ * the frames they took per file, then remove them again. Each file is
+ * one node with its bytes inline; the names "e0", "e1"... are new, so
+ * this also counts one interned name per file.
+ */
+static int bench_small(uint32_t files) {
+    static const char content[] = "key=value\nmode=0644\nowner=claude\n";
+
+    if (vfs_mkdir("/tmp/small") != 0) {
+        display_print("bench: cannot create /tmp/small\n");
+        return 1;
+    }
+    fs_node_t *dir = vfs_lookup("/tmp/small");
+
+    char name[16];
+    uint32_t used = pmm_used_count();
+    uint32_t made = 0;
+    uint64_t start = timer_read_tsc();
+    while (made < files) {
+        bench_dir_name(name, made);
+        if (!vfs_create_file(dir, name, content)) break;
+        made++;
+    }
+    bench_report("create", timer_read_tsc() - start, made);
+    used = pmm_used_count() - used;
+
+    name_stats_t ns;
+    name_get_stats(&ns);
+    display_print("  ");
+    bench_print_u64(made);
+    display_print(" files in ");
+    bench_print_u64(used);
+    display_print(" frames (");
+    bench_print_u64(made ? (uint64_t)used * PAGE_SIZE / made : 0);
+    display_print(" bytes/file, node ");
+    bench_print_u64(sizeof(fs_node_t));
+    display_print(", names ");
+    bench_print_u64(ns.bytes);
+    display_print(" bytes total)\n");
+
+    char path[32] = "/tmp/small/";
+    for (uint32_t n = 0; n < made; n++) {
+        bench_dir_name(path + 11, n);
+        vfs_unlink(path);
+    }
+    vfs_rmdir("/tmp/small");
+    return made == files ? 0 : 1;
+}
+
+/*
+ * ===========================================================================
+ * Block Queue
+ * ===========================================================================
+ */
+
+/*
+ * A device that does no I/O: it completes each request at once and
+ * records how far the "head" moved to reach it. It is never registered,
+ * so the run does not show up in /dev or lsblk.
+ */
+static uint64_t null_head;
+static uint64_t null_travel;
+
+static int null_submit(block_device_t *dev, request_t *req) {
+    (void)dev;
+    uint64_t dist = req->sector > null_head ? req->sector - null_head : null_head - req->sector;
+    null_travel += dist;
+    null_head = req->sector + req->sectors;
+    block_complete(req, 0);
+    return 0;
+}
+
+static const block_ops_t null_ops = { .submit = null_submit };
+
+/* Queue 'count' 4K reads (in 'order' if given), optionally plugged */
+static uint32_t bench_blk_run(block_device_t *dev, const uint32_t *order, uint32_t count,
+                              bool plug, uint64_t *cycles) {
+    static bio_t *bios[1024];
+    uint32_t before = dev->stats.requests;
+
+    null_head = 0;
+    null_travel = 0;
+    uint64_t start = timer_read_tsc();
+    if (plug) block_plug(dev);
+    for (uint32_t i = 0; i < count; i++) {
+        bio_t *bio = bio_alloc();
+        bios[i] = bio;
+        if (!bio) break;
+        bio->dev = dev;
+        bio->op = BIO_READ;
+        bio->sector = (uint64_t)(order ? order[i] : i) * 8;
+        bio->nsegs = 1;
+        bio->segs[0].addr = 0x100000;
+        bio->segs[0].len = 4096;
+        block_submit(bio);
+    }
+    if (plug) block_unplug(dev);
+    *cycles = timer_read_tsc() - start;
+
+    for (uint32_t i = 0; i < count && bios[i]; i++) {
+        block_wait(bios[i]);
+        bio_free(bios[i]);
+    }
+    return dev->stats.requests - before;
+}
+
+static int bench_blk(uint32_t count) {
+    static block_device_t dev;
+    static uint32_t order[1024];
+
+    if (count > 1024) count = 1024;
+    if (!dev.ops) {
+        dev.sectors = 8 * 1024;
+        dev.ops = &null_ops;
+        dev.queue_depth = 1;
+        block_device_init(&dev);
+    }
+
+    uint64_t cycles;
+    uint32_t reqs = bench_blk_run(&dev, NULL, count, false, &cycles);
+    display_print("  sequential, unplugged: ");
+    bench_print_u64(reqs);
+    display_print(" requests for ");
+    bench_print_u64(count);
+    display_print(" bios\n");
+    bench_report("submit", cycles, count);
+
+    reqs = bench_blk_run(&dev, NULL, count, true, &cycles);
+    display_print("  sequential, plugged:   ");
+    bench_print_u64(reqs);
+    display_print(" requests for ");
+    bench_print_u64(count);
+    display_print(" bios\n");
+    bench_report("submit", cycles, count);
+
+    /* Scattered 4K reads: every block of the range once, in LCG order */
+    for (uint32_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    uint32_t seed = 12345;
+    for (uint32_t i = count; i > 1; i--) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t j = (seed >> 16) % i;
+        uint32_t t = order[i - 1];
+        order[i - 1] = order[j];
+        order[j] = t;
+    }
+
+    static const char *scheds[] = { "noop", "deadline" };
+    for (int s = 0; s < 2; s++) {
+        block_set_sched(&dev, scheds[s]);
+        reqs = bench_blk_run(&dev, order, count, true, &cycles);
+        display_print("  random, ");
+        display_print(scheds[s]);
+        display_print(": ");
+        bench_print_u64(reqs);
+        display_print(" requests, head travel ");
+        bench_print_u64(null_travel);
+        display_print(" sectors\n");
+    }
+    block_set_sched(&dev, "noop");
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Disk Transfer Modes
+ * ===========================================================================
+ */
+
+/*
+ * Read the first 'mb' megabytes of hda in 64KB requests, once by PIO
+ * and once by DMA. Throughput comes from the 100Hz tick; CPU use is the
+ * share of the elapsed TSC cycles spent inside the ATA driver (while a
+ * DMA transfer runs, the shell sleeps and the CPU is free).
+ */
+static int bench_disk(uint32_t mb) {
+    block_device_t *dev = block_find("hda");
+    if (!dev || ata_set_dma(dev, false) != 0) {
+        display_print("bench: no ATA disk (hda)\n");
+        return 1;
+    }
+
+    uint32_t chunk = 128;                           /* Sectors per read */
+    uint64_t total = (uint64_t)mb * 2048;
+    if (total > dev->sectors) total = dev->sectors - dev->sectors % chunk;
+    uint32_t buf = pmm_alloc_pages(16);
+    if (!buf) {
+        display_print("bench: out of memory\n");
+        return 1;
+    }
+
+    static const char *modes[] = { "PIO", "DMA" };
+    int status = 0;
+    for (int m = 0; m < 2; m++) {
+        if (ata_set_dma(dev, m == 1) != 0) {
+            display_print("  DMA: not available on this controller\n");
+            break;
+        }
+        ata_reset_stats();
+        uint64_t ticks = timer_get_ticks();
+        uint64_t tsc = timer_read_tsc();
+        for (uint64_t s = 0; s < total; s += chunk) {
+            if (block_read(dev, s, (void *)buf, chunk) != 0) {
+                status = 1;
+                break;
+            }
+        }
+        tsc = timer_read_tsc() - tsc;
+        ticks = timer_get_ticks() - ticks;
+        if (ticks == 0) ticks = 1;
+
+        ata_stats_t st;
+        ata_get_stats(&st);
+        display_print("  ");
+        display_print(modes[m]);
+        display_print(": ");
+        bench_print_u64(total * BLOCK_SECTOR_SIZE * 100 / 1024 / ticks);
+        display_print(" KB/s, CPU ");
+        bench_print_u64(tsc ? st.cpu_cycles * 100 / tsc : 0);
+        display_print("% (");
+        bench_print_u64(st.pio_requests + st.dma_requests);
+        display_print(" commands, ");
+        bench_print_u64(st.errors);
+        display_print(" errors)\n");
+    }
+
+    /* Leave the disk on DMA when it has it */
+    ata_set_dma(dev, true);
+    pmm_free_pages(buf, 16);
+    return status;
+}
+
+/*
+ * ===========================================================================
+ * Queue Depth
+ * ===========================================================================
+ */
+
+#define IOPS_MAX_DEPTH  32
+
+/*
+ * Keep 'depth' random 4K reads in flight on a disk: whenever the oldest
+ * completes it is resubmitted elsewhere. Reports IOPS and completion
+ * interrupts per 100 I/Os, which fall as the driver batches. With 'poll'
+ * an NVMe disk reaps completions by spinning instead of by interrupt.
+ */
+static int bench_iops(const char *name, uint32_t ios, bool poll) {
+    block_device_t *dev = block_find(name);
+    if (!dev || dev->sectors < 8) {
+        display_print("bench: no such block device\n");
+        return 1;
+    }
+    if (poll && nvme_set_polled(dev, true) != 0) {
+        display_print("bench: polled completion needs an NVMe disk\n");
+        return 1;
+    }
+
+    uint32_t buf = pmm_alloc_pages(IOPS_MAX_DEPTH);
+    if (!buf) {
+        display_print("bench: out of memory\n");
+        return 1;
+    }
+
+    static bio_t *bios[IOPS_MAX_DEPTH];
+    static const uint32_t depths[] = { 1, 4, 16, 32 };
+    uint64_t blocks = dev->sectors / 8;
+    uint32_t seed = 2463534242u;
+    int status = 0;
+    if (ios == 0) ios = 1;
+
+    for (uint32_t i = 0; i < IOPS_MAX_DEPTH; i++) {
+        bios[i] = bio_alloc();
+        if (!bios[i]) status = 1;
+    }
+
+    for (uint32_t d = 0; d < sizeof(depths) / sizeof(depths[0]) && status == 0; d++) {
+        uint32_t depth = depths[d];
+        uint32_t irqs = dev->stats.irqs;
+        uint64_t ticks = timer_get_ticks();
+        uint32_t submitted = 0;
+
+        /* Each slot is waited for in submission order, then reused */
+        block_plug(dev);
+        for (uint32_t n = 0; n < ios + depth; n++) {
+            uint32_t i = n % depth;
+            bio_t *bio = bios[i];
+            if (n >= depth) {
+                if (n - depth >= ios) continue;
+                block_wait(bio);
+                if (bio->status != 0) status = 1;
+            }
+            if (submitted < ios) {
+                seed ^= seed << 13;
+                seed ^= seed >> 17;
+                seed ^= seed << 5;
+                bio->dev = dev;
+                bio->op = BIO_READ;
+                bio->sector = (seed % blocks) * 8;
+                bio->nsegs = 1;
+                bio->segs[0].addr = buf + i * PAGE_SIZE;
+                bio->segs[0].len = PAGE_SIZE;
+                bio->end = NULL;
+                block_submit(bio);
+                submitted++;
+            }
+            if (n + 1 == depth) block_unplug(dev);
+        }
+
+        ticks = timer_get_ticks() - ticks;
+        if (ticks == 0) ticks = 1;
+        display_print("  depth ");
+        bench_print_u64(depth);
+        display_print(": ");
+        bench_print_u64((uint64_t)ios * 100 / ticks);
+        display_print(" IOPS, ");
+        bench_print_u64((uint64_t)(dev->stats.irqs - irqs) * 100 / ios);
+        display_print(" irqs per 100 I/Os\n");
+    }
+
+    for (uint32_t i = 0; i < IOPS_MAX_DEPTH; i++) {
+        if (bios[i]) bio_free(bios[i]);
+    }
+    pmm_free_pages(buf, IOPS_MAX_DEPTH);
+    if (poll) nvme_set_polled(dev, false);
+    return status;
+}
+
+/*
+ * ===========================================================================
+ * RAM Disk
+ * ===========================================================================
+ */
+
+static void bench_ram_line(const char *what, uint64_t cycles, uint64_t pages) {
+    display_print(what);
+    bench_print_u64(pages ? cycles / pages : 0);
+    display_print(" cycles/page\n");
+}
+
+/*
+ * Time the first 'mb' megabytes of ram0 through the block layer in 64KB
+ * transfers, against handing out the device's frames as the page cache
+ * would, then format it. Overwrites whatever ram0 holds.
+ */
+static int bench_ram(uint32_t mb) {
+    block_device_t *dev = block_find("ram0");
+    if (!dev || !dev->ops->share_page) {
+        display_print("bench: no RAM disk (ram0)\n");
+        return 1;
+    }
+
+    uint32_t chunk = 128;                           /* Sectors per transfer */
+    uint64_t total = (uint64_t)mb * 2048;
+    if (total > dev->sectors) total = dev->sectors - dev->sectors % chunk;
+    uint64_t pages = total / 8;
+    uint32_t buf = pmm_alloc_pages(16);
+    if (!buf || !pages) {
+        display_print("bench: out of memory\n");
+        if (buf) pmm_free_pages(buf, 16);
+        return 1;
+    }
+
+    int status = 0;
+    for (int pass = 0; pass < 3 && status == 0; pass++) {
+        uint64_t start = timer_read_tsc();
+        for (uint64_t s = 0; s < total && status == 0; s += pass < 2 ? chunk : 8) {
+            if (pass == 0) {
+                status = block_write(dev, s, (void *)buf, chunk);
+            } else if (pass == 1) {
+                status = block_read(dev, s, (void *)buf, chunk);
+            } else {
+                uint32_t frame;
+                status = block_share_page(dev, s, &frame);
+                if (status == 0) pmm_unref_page(frame);
+            }
+        }
+        static const char *labels[] = { "  write (copy): ", "  read (copy):  ", "  share:        " };
+        bench_ram_line(labels[pass], timer_read_tsc() - start, pages);
+    }
+
+    mkfs_result_t res;
+    uint64_t start = timer_read_tsc();
+    if (status == 0 && mkfs_ext2(dev, NULL, &res) == 0) {
+        uint64_t cycles = timer_read_tsc() - start;
+        display_print("  mkfs ext2:    ");
+        bench_print_u64(cycles / 1000);
+        display_print(" Kcycles (");
+        bench_print_u64(res.blocks);
+        display_print(" blocks, ");
+        bench_print_u64(res.inodes);
+        display_print(" inodes)\n");
+    } else {
+        status = 1;
+    }
+    display_print("  frames in use: ");
+    bench_print_u64(ramdisk_pages_used(dev));
+    display_putchar('\n');
+
+    pmm_free_pages(buf, 16);
+    return status ? 1 : 0;
+}
+
+/*
+ * ===========================================================================
+ * ext2
+ * ===========================================================================
+ */
+
+#define BENCH_EXT2_FILE "/mnt/bench"
+
+/*
+ * Format ram0 with 'bs'-byte blocks, mount it on /mnt and write an
+ * 'pages'-page file in 64KB calls, then remount (a cold page cache) and
+ * read it back the same way.
+ */
+static int bench_ext2_pass(block_device_t *dev, uint32_t bs, uint32_t buf, uint32_t pages) {
+    mkfs_opts_t opts = { bs, 0, NULL };
+    if (mkfs_ext2(dev, &opts, NULL) != 0 || vfs_mount("ext2", dev->name, "/mnt") != 0) {
+        return -1;
+    }
+
+    uint32_t chunk = 16 * PAGE_SIZE;
+    uint64_t cycles[2];
+    int status = 0;
+    for (int pass = 0; pass < 2 && status == 0; pass++) {
+        int fd = vfs_open(BENCH_EXT2_FILE, pass == 0 ? O_CREAT | O_WRONLY : O_RDONLY);
+        if (fd < 0) {
+            status = -1;
+            break;
+        }
+        uint64_t start = timer_read_tsc();
+        for (uint32_t p = 0; p < pages && status == 0; p += 16) {
+            ssize_t n = pass == 0 ? vfs_write(fd, (void *)buf, chunk) : vfs_read(fd, (void *)buf, chunk);
+            if (n != (ssize_t)chunk) status = -1;
+        }
+        if (pass == 0 && vfs_fsync(fd) != 0) status = -1;
+        cycles[pass] = timer_read_tsc() - start;
+        vfs_close(fd);
+
+        /* Remount so the read starts from the disk */
+        if (vfs_umount("/mnt") != 0) return -1;
+        if (pass == 0 && vfs_mount("ext2", dev->name, "/mnt") != 0) return -1;
+    }
+    if (status != 0) return -1;
+
+    display_print(bs == PAGE_SIZE ? "  ext2 4K write:  " : "  ext2 1K write:  ");
+    bench_print_u64(cycles[0] / pages);
+    display_print(" cycles/page\n");
+    display_print(bs == PAGE_SIZE ? "  ext2 4K read:   " : "  ext2 1K read:   ");
+    bench_print_u64(cycles[1] / pages);
+    display_print(" cycles/page\n");
+    return 0;
+}
+
+/*
+ * Sequential file throughput on ext2 against the raw device: 1KB blocks
+ * read by copying, 4KB blocks through ram0's own frames. Overwrites
+ * whatever ram0 holds; /mnt must be free.
+ */
+static int bench_ext2(uint32_t mb) {
+    block_device_t *dev = block_find("ram0");
+    if (!dev) {
+        display_print("bench: no RAM disk (ram0)\n");
+        return 1;
+    }
+
+    /* Leave room for the filesystem's own blocks */
+    uint32_t max_mb = (uint32_t)(dev->sectors >> 11) / 2;
+    if (mb > max_mb) mb = max_mb;
+    uint32_t pages = mb * 256;
+    uint32_t buf = pmm_alloc_pages(16);
+    if (!buf || !pages) {
+        display_print("bench: out of memory\n");
+        if (buf) pmm_free_pages(buf, 16);
+        return 1;
+    }
+
+    uint64_t start = timer_read_tsc();
+    int status = 0;
+    for (uint32_t p = 0; p < pages && status == 0; p += 16) {
+        status = block_read(dev, (uint64_t)p * 8, (void *)buf, 128);
+    }
+    bench_ram_line("  raw read:       ", timer_read_tsc() - start, pages);
+
+    if (status == 0 && (bench_ext2_pass(dev, 1024, buf, pages) != 0 ||
+                        bench_ext2_pass(dev, PAGE_SIZE, buf, pages) != 0)) {
+        display_print("bench: cannot use ext2 on ram0 at /mnt\n");
+        status = 1;
+    }
+
+    pmm_free_pages(buf, 16);
+    return status ? 1 : 0;
+}
+
+/*
+ * ===========================================================================
+ * FAT32
+ * ===========================================================================
+ */
+
+/*
+ * Sequential file throughput on a fresh FAT32 volume on ram0, with the
+ * number of device requests the cold read took: the cluster chain is
+ * mapped once at open, so a contiguous file should need only a few per
+ * read-ahead window, not one per cluster. Overwrites whatever ram0
+ * holds; /mnt must be free.
+ */
+static int bench_fat(uint32_t mb) {
+    block_device_t *dev = block_find("ram0");
+    if (!dev) {
+        display_print("bench: no RAM disk (ram0)\n");
+        return 1;
+    }
+
+    uint32_t max_mb = (uint32_t)(dev->sectors >> 11) / 2;
+    if (mb > max_mb) mb = max_mb;
+    uint32_t pages = mb * 256;
+    uint32_t buf = pmm_alloc_pages(16);
+    if (!buf || !pages) {
+        display_print("bench: out of memory\n");
+        if (buf) pmm_free_pages(buf, 16);
+        return 1;
+    }
+
+    mkfs_result_t res;
+    int status = 0;
+    if (mkfs_vfat(dev, NULL, &res) != 0 || vfs_mount("vfat", dev->name, "/mnt") != 0) {
+        display_print("bench: cannot use vfat on ram0 at /mnt\n");
+        pmm_free_pages(buf, 16);
+        return 1;
+    }
+
+    uint32_t chunk = 16 * PAGE_SIZE;
+    uint64_t cycles[2];
+    uint32_t requests = 0;
+    for (int pass = 0; pass < 2 && status == 0; pass++) {
+        int fd = vfs_open(BENCH_EXT2_FILE, pass == 0 ? O_CREAT | O_WRONLY : O_RDONLY);
+        if (fd < 0) {
+            vfs_umount("/mnt");
+            status = -1;
+            break;
+        }
+        uint32_t before = dev->stats.requests;
+        uint64_t start = timer_read_tsc();
+        for (uint32_t p = 0; p < pages && status == 0; p += 16) {
+            ssize_t n = pass == 0 ? vfs_write(fd, (void *)buf, chunk) : vfs_read(fd, (void *)buf, chunk);
+            if (n != (ssize_t)chunk) status = -1;
+        }
+        if (pass == 0 && vfs_fsync(fd) != 0) status = -1;
+        cycles[pass] = timer_read_tsc() - start;
+        requests = dev->stats.requests - before;
+        vfs_close(fd);
+
+        /* Remount so the read starts from the disk */
+        if (vfs_umount("/mnt") != 0 || (pass == 0 && vfs_mount("vfat", dev->name, "/mnt") != 0)) {
+            status = -1;
+        }
+    }
+
+    if (status == 0) {
+        display_print("  ");
+        bench_print_u64(res.blocks);
+        display_print(" clusters of ");
+        bench_print_u64(res.block_size);
+        display_print(" bytes\n");
+        display_print("  vfat write:     ");
+        bench_print_u64(cycles[0] / pages);
+        display_print(" cycles/page\n");
+        display_print("  vfat read:      ");
+        bench_print_u64(cycles[1] / pages);
+        display_print(" cycles/page, ");
+        bench_print_u64(requests);
+        display_print(" requests for ");
+        bench_print_u64(mb);
+        display_print(" MB\n");
+    } else {
+        display_print("bench: vfat transfer failed\n");
+    }
+
+    pmm_free_pages(buf, 16);
+    return status ? 1 : 0;
+}
+
+/*
+ * ===========================================================================
+ * Log-Structured Filesystem
+ * ===========================================================================
+ */
+
+/*
+ * Format ram0 as 'type', mount it on /mnt and create 'files' 1000-byte
+ * files in /mnt/small, then unmount so everything reaches the disk.
+ * Reports the cost per file and the requests and sectors it took.
+ */
+static int bench_lfs_pass(block_device_t *dev, const char *type, uint32_t files) {
+    static char data[1000];
+    if (mkfs(type, dev, NULL, NULL) != 0 || vfs_mount(type, dev->name, "/mnt") != 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < sizeof(data); i++) data[i] = (char)('a' + i % 26);
+
+    uint32_t requests = dev->stats.requests;
+    uint32_t sectors = dev->stats.write_sectors;
+    uint64_t start = timer_read_tsc();
+    int status = vfs_mkdir("/mnt/small");
+    char path[32] = "/mnt/small/";
+    uint32_t made = 0;
+    while (status == 0 && made < files) {
+        bench_dir_name(path + 11, made);
+        int fd = vfs_open(path, O_CREAT | O_WRONLY);
+        if (fd < 0) break;
+        if (vfs_write(fd, data, sizeof(data)) != (ssize_t)sizeof(data)) status = -1;
+        vfs_close(fd);
+        made++;
+    }
+    if (vfs_umount("/mnt") != 0) status = -1;
+    uint64_t cycles = timer_read_tsc() - start;
+    if (status != 0 || made != files) return -1;
+
+    display_print(type[0] == 'l' ? "  lfs:   " : "  ext2:  ");
+    bench_print_u64(cycles / files);
+    display_print(" cycles/file, ");
+    bench_print_u64(dev->stats.requests - requests);
+    display_print(" requests, ");
+    bench_print_u64((dev->stats.write_sectors - sectors) / 2);
+    display_print(" KB written\n");
+    return 0;
+}
+
+/*
+ * Many small files through the log against ext2's in-place layout. lfs
+ * gathers the data, inodes and directory of a burst of creates into a
+ * few segment-sized writes. Overwrites whatever ram0 holds; /mnt must
+ * be free.
+ */
+static int bench_lfs(uint32_t files) {
+    block_device_t *dev = block_find("ram0");
+    if (!dev) {
+        display_print("bench: no RAM disk (ram0)\n");
+        return 1;
+    }
+    if (bench_lfs_pass(dev, "ext2", files) != 0 || bench_lfs_pass(dev, "lfs", files) != 0) {
+        display_print("bench: cannot create files on ram0 at /mnt\n");
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Write-back
+ * ===========================================================================
+ */
+
+/*
+ * A burst of 'pages' pages written to a new file on ext2 on ram0 in 64KB
+ * calls, then the fsync that makes it durable. Up to PCACHE_DIRTY_MAX
+ * pages the writes only fill the cache; past that, writers are
+ * throttled into writing back themselves. Also shows how many pages a
+ * write-back carried. Overwrites whatever ram0 holds; /mnt must be free.
+ */
+static int bench_wb(uint32_t pages) {
+    block_device_t *dev = block_find("ram0");
+    if (!dev) {
+        display_print("bench: no RAM disk (ram0)\n");
+        return 1;
+    }
+    pages = (pages + 15) & ~15u;
+    uint32_t max_pages = (uint32_t)(dev->sectors >> 3) / 2;
+    if (pages > max_pages) pages = max_pages & ~15u;
+    uint32_t buf = pmm_alloc_pages(16);
+    if (!buf || !pages) {
+        display_print("bench: out of memory\n");
+        if (buf) pmm_free_pages(buf, 16);
+        return 1;
+    }
+
+    mkfs_opts_t opts = { PAGE_SIZE, 0, NULL };
+    int fd = -1;
+    if (mkfs_ext2(dev, &opts, NULL) != 0 || vfs_mount("ext2", dev->name, "/mnt") != 0 ||
+        (fd = vfs_open(BENCH_EXT2_FILE, O_CREAT | O_WRONLY)) < 0) {
+        display_print("bench: cannot use ext2 on ram0 at /mnt\n");
+        pmm_free_pages(buf, 16);
+        return 1;
+    }
+
+    pcache_stats_t before, after;
+    pcache_get_stats(&before);
+    uint32_t requests = dev->stats.requests;
+    int status = 0;
+    uint64_t start = timer_read_tsc();
+    for (uint32_t p = 0; p < pages && status == 0; p += 16) {
+        if (vfs_write(fd, (void *)buf, 16 * PAGE_SIZE) != 16 * PAGE_SIZE) status = -1;
+    }
+    uint64_t written = timer_read_tsc() - start;
+    if (status == 0 && vfs_fsync(fd) != 0) status = -1;
+    uint64_t synced = timer_read_tsc() - start - written;
+    pcache_get_stats(&after);
+    requests = dev->stats.requests - requests;
+    vfs_close(fd);
+    if (vfs_umount("/mnt") != 0) status = -1;
+    pmm_free_pages(buf, 16);
+
+    if (status != 0) {
+        display_print("bench: write-back failed\n");
+        return 1;
+    }
+    uint32_t clusters = after.clusters - before.clusters;
+    bench_ram_line("  write burst:    ", written, pages);
+    bench_ram_line("  fsync:          ", synced, pages);
+    display_print("  ");
+    bench_print_u64(after.writebacks - before.writebacks);
+    display_print(" pages in ");
+    bench_print_u64(clusters);
+    display_print(" write-backs (");
+    bench_print_u64(clusters ? (after.writebacks - before.writebacks) / clusters : 0);
+    display_print(" pages each), ");
+    bench_print_u64(requests);
+    display_print(" requests, ");
+    bench_print_u64(after.throttled - before.throttled);
+    display_print(" throttled writes\n");
+    return 0;
+}
+
+/*
+ * ===========================================================================
+ * Entry Point
+ * ===========================================================================
+ */
+
+/* bench - Run a kernel micro-benchmark */
+int builtin_bench(int argc, char **argv) {
+    if (argc < 2) {
+        display_print("Usage: bench <ipc|lookup|dir|pcache|fd|churn|small|blk|disk|iops|ram|ext2|fat|lfs|wb> [iterations]\n");
+        return 1;
+    }
+
+    uint32_t iterations = argc > 2 ? bench_atoi(argv[2]) : 10000;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    if (bench_strcmp(argv[1], "ipc") == 0) {
+        return bench_ipc(iterations);
+    }
+    if (bench_strcmp(argv[1], "lookup") == 0) {
+        return bench_lookup(iterations);
+    }
+    if (bench_strcmp(argv[1], "dir") == 0) {
+        return bench_dir(iterations);
+    }
+    if (bench_strcmp(argv[1], "pcache") == 0) {
+        return bench_pcache(iterations);
+    }
+    if (bench_strcmp(argv[1], "fd") == 0) {
+        return bench_fd(iterations);
+    }
+    if (bench_strcmp(argv[1], "churn") == 0) {
+        return bench_churn(iterations);
+    }
+    if (bench_strcmp(argv[1], "small") == 0) {
+        return bench_small(iterations);
+    }
+    if (bench_strcmp(argv[1], "blk") == 0) {
+        return bench_blk(iterations);
+    }
+    if (bench_strcmp(argv[1], "disk") == 0) {
+        return bench_disk(argc > 2 ? iterations : 16);
+    }
+    if (bench_strcmp(argv[1], "ram") == 0) {
+        return bench_ram(argc > 2 ? iterations : 8);
+    }
+    if (bench_strcmp(argv[1], "ext2") == 0) {
+        return bench_ext2(argc > 2 ? iterations : 4);
+    }
+    if (bench_strcmp(argv[1], "fat") == 0) {
+        return bench_fat(argc > 2 ? iterations : 4);
+    }
+    if (bench_strcmp(argv[1], "lfs") == 0) {
+        return bench_lfs(argc > 2 ? iterations : 1000);
+    }
+    if (bench_strcmp(argv[1], "wb") == 0) {
+        return bench_wb(argc > 2 ? iterations : 256);
+    }
+    if (bench_strcmp(argv[1], "iops") == 0) {
+        if (argc < 3) {
+            display_print("Usage: bench iops <dev> [ios] [poll]\n");
+            return 1;
+        }
+        bool poll = argc > 4 && bench_strcmp(argv[4], "poll") == 0;
+        return bench_iops(argv[2], argc > 3 ? bench_atoi(argv[3]) : 4096, poll);
+    }
+
+    display_print("bench: unknown benchmark '");
+    display_print(argv[1]);
+    display_print("'\n");
+    return 1;
+}
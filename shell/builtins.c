@@ -15,7 +15,12 @@
 #include "../include/timer.h"
 #include "../include/process.h"
 #include "../include/ai.h"
+#include "../include/syscall.h"
 #include "../fs/vfs.h"
+#include "../fs/mount.h"
+#include "../include/block.h"
+#include "../include/ramdisk.h"
+#include "../fs/mkfs.h"
 
 /* String utilities (no libc in freestanding mode) */
 static int strcmp(const char *s1, const char *s2) {
@@ -52,12 +57,22 @@ int builtin_date(int argc, char **argv);
 int builtin_uptime(int argc, char **argv);
 int builtin_mkdir(int argc, char **argv);
 int builtin_touch(int argc, char **argv);
+int builtin_rm(int argc, char **argv);
+int builtin_rmdir(int argc, char **argv);
+int builtin_mv(int argc, char **argv);
 int builtin_write(int argc, char **argv);
+int builtin_mount(int argc, char **argv);
+int builtin_umount(int argc, char **argv);
+int builtin_sync(int argc, char **argv);
+int builtin_lsblk(int argc, char **argv);
+int builtin_mkfs(int argc, char **argv);
+int builtin_ramdisk(int argc, char **argv);
 int builtin_reboot(int argc, char **argv);
 int builtin_sleep(int argc, char **argv);
 int builtin_ps(int argc, char **argv);
 int builtin_kill(int argc, char **argv);
 int builtin_claude(int argc, char **argv);
+int builtin_bench(int argc, char **argv);
 
 /* Command table - add new builtins here */
 static shell_command_t builtin_commands[] = {
@@ -78,13 +93,23 @@ static shell_command_t builtin_commands[] = {
     {"uptime",  "Show system uptime",                builtin_uptime},
     {"mkdir",   "Create a directory",                builtin_mkdir},
     {"touch",   "Create empty file",                 builtin_touch},
+    {"rm",      "Remove files",                      builtin_rm},
+    {"rmdir",   "Remove empty directories",          builtin_rmdir},
+    {"mv",      "Move or rename a file",             builtin_mv},
     {"write",   "Write text to file",                builtin_write},
+    {"mount",   "List or attach filesystems",        builtin_mount},
+    {"umount",  "Detach a mounted filesystem",       builtin_umount},
+    {"sync",    "Write cached data to disk",         builtin_sync},
+    {"lsblk",   "List block devices or set a scheduler", builtin_lsblk},
+    {"mkfs",    "Format a block device",             builtin_mkfs},
+    {"ramdisk", "Create a RAM disk of N megabytes",  builtin_ramdisk},
     {"reboot",  "Reboot the system",                 builtin_reboot},
     /* Phase 4 commands */
     {"sleep",   "Sleep for N milliseconds",          builtin_sleep},
     {"ps",      "List running processes",            builtin_ps},
     {"kill",    "Terminate a process by PID",        builtin_kill},
     {"claude",  "AI assistant - ask me anything!",   builtin_claude},
+    {"bench",   "Run a kernel micro-benchmark",      builtin_bench},
     {NULL, NULL, NULL}  /* Sentinel */
 };
 
@@ -166,128 +191,155 @@ int builtin_exit(int argc, char **argv) {
 /* pwd - Print working directory */
 int builtin_pwd(int argc, char **argv) {
     (void)argc; (void)argv;
-    if (g_shell_state && g_shell_state->cwd) {
-        display_print(g_shell_state->cwd);
-        display_putchar('\n');
-    } else {
-        display_print("/\n");
+    char cwd[FS_PATH_MAX];
+    if (vfs_getcwd(cwd, sizeof(cwd)) < 0) {
+        display_print("pwd: path too long\n");
+        return 1;
     }
+    display_print(cwd);
+    display_putchar('\n');
     return 0;
 }
 
 /* cd - Change directory */
 int builtin_cd(int argc, char **argv) {
-    if (!g_shell_state) return 1;
-
-    const char *target;
-    char full_path[256];
-
-    if (argc < 2) {
-        /* cd with no args goes to home */
-        target = "/home/claude";
-    } else {
-        /* Handle relative paths */
-        if (argv[1][0] != '/') {
-            int i = 0;
-            const char *cwd = g_shell_state->cwd ? g_shell_state->cwd : "/";
-            while (*cwd && i < 254) full_path[i++] = *cwd++;
-            if (i > 0 && full_path[i-1] != '/') full_path[i++] = '/';
-            const char *rel = argv[1];
-            while (*rel && i < 255) full_path[i++] = *rel++;
-            full_path[i] = '\0';
-            target = full_path;
-        } else {
-            target = argv[1];
-        }
-    }
+    /* cd with no args goes to home */
+    const char *target = argc < 2 ? "/home/claude" : argv[1];
 
     /* Validate path exists and is a directory */
     fs_stat_t stat;
     if (vfs_stat(target, &stat) != 0) {
         display_print("cd: ");
-        display_print(argv[1] ? argv[1] : target);
+        display_print(target);
         display_print(": No such file or directory\n");
         return 1;
     }
 
     if (stat.st_type != FS_DIRECTORY) {
         display_print("cd: ");
-        display_print(argv[1] ? argv[1] : target);
+        display_print(target);
         display_print(": Not a directory\n");
         return 1;
     }
 
-    /* Update cwd */
-    g_shell_state->cwd = shell_strdup(target);
+    /* The process keeps the directory node; later lookups start there */
+    if (vfs_chdir(target) != 0) {
+        display_print("cd: ");
+        display_print(target);
+        display_print(": Operation failed\n");
+        return 1;
+    }
     return 0;
 }
 
+static void print_int(uint32_t num);
+
+/* Entries fetched per getdents/readdirplus call */
+#define LS_BATCH 8
+
+/* ls -l line: type, size and name from readdirplus */
+static void ls_print_long(const fs_direntplus_t *entry) {
+    char type = '-';
+    if (entry->stat.st_type == FS_DIRECTORY) type = 'd';
+    else if (entry->stat.st_type == FS_CHARDEV) type = 'c';
+    else if (entry->stat.st_type == FS_PIPE) type = 'p';
+
+    display_putchar(type);
+    display_print("  ");
+
+    /* Right-align sizes up to 8 digits */
+    uint32_t size = entry->stat.st_size;
+    int digits = 1;
+    for (uint32_t n = size; n >= 10; n /= 10) digits++;
+    for (int i = digits; i < 8; i++) display_putchar(' ');
+    print_int(size);
+
+    display_print("  ");
+    display_print(entry->dirent.name);
+    if (entry->dirent.type == FS_DIRECTORY) {
+        display_print("/");
+    }
+    display_putchar('\n');
+}
+
 /* ls - List directory contents */
 int builtin_ls(int argc, char **argv) {
-    const char *path;
-    char full_path[256];
-
-    /* Determine path to list */
-    if (argc > 1) {
-        /* If relative path and we have cwd, make absolute */
-        if (argv[1][0] != '/' && g_shell_state && g_shell_state->cwd) {
-            /* Build absolute path */
-            int i = 0;
-            const char *cwd = g_shell_state->cwd;
-            while (*cwd && i < 254) full_path[i++] = *cwd++;
-            if (i > 0 && full_path[i-1] != '/') full_path[i++] = '/';
-            const char *rel = argv[1];
-            while (*rel && i < 255) full_path[i++] = *rel++;
-            full_path[i] = '\0';
-            path = full_path;
+    const char *arg = NULL;
+    int long_format = 0;
+
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "-l") == 0) {
+            long_format = 1;
         } else {
-            path = argv[1];
+            arg = argv[a];
         }
-    } else {
-        /* No argument - use cwd */
-        path = (g_shell_state && g_shell_state->cwd) ? g_shell_state->cwd : "/";
     }
 
+    /* Default to the working directory */
+    const char *path = arg ? arg : ".";
+
     /* Check if path exists and is a directory */
-    fs_stat_t stat;
-    if (vfs_stat(path, &stat) != 0) {
+    fs_node_t *node = vfs_lookup(path);
+    if (!node) {
         display_print("ls: cannot access '");
         display_print(path);
         display_print("': No such file or directory\n");
         return 1;
     }
 
-    if (stat.st_type != FS_DIRECTORY) {
+    if (node->type != FS_DIRECTORY) {
         /* It's a file - just print its name */
-        display_print(argv[1] ? argv[1] : path);
+        display_print(arg ? arg : path);
         display_putchar('\n');
         return 0;
     }
 
-    /* List directory contents */
+    /* Open the directory and read it in batches */
+    int fd = vfs_open_node(node, O_RDONLY);
+    if (fd < 0) {
+        display_print("ls: cannot open '");
+        display_print(path);
+        display_print("'\n");
+        return 1;
+    }
+
     int index = 0;
-    fs_dirent_t *entry;
 
-    while ((entry = vfs_readdir(path, index)) != NULL) {
-        /* Color/indicator based on type */
-        if (entry->type == FS_DIRECTORY) {
-            display_print(entry->name);
-            display_print("/");
-        } else {
-            display_print(entry->name);
+    if (long_format) {
+        fs_direntplus_t entries[LS_BATCH];
+        int n;
+        while ((n = vfs_readdirplus(fd, entries, LS_BATCH)) > 0) {
+            for (int i = 0; i < n; i++) {
+                ls_print_long(&entries[i]);
+            }
+            index += n;
         }
-        display_print("  ");
-        index++;
+    } else {
+        fs_dirent_t entries[LS_BATCH];
+        int n;
+        while ((n = vfs_getdents(fd, entries, LS_BATCH)) > 0) {
+            for (int i = 0; i < n; i++) {
+                /* Color/indicator based on type */
+                display_print(entries[i].name);
+                if (entries[i].type == FS_DIRECTORY) {
+                    display_print("/");
+                }
+                display_print("  ");
+                index++;
 
-        /* Newline every 4 items for readability */
-        if (index % 4 == 0) {
+                /* Newline every 4 items for readability */
+                if (index % 4 == 0) {
+                    display_putchar('\n');
+                }
+            }
+        }
+
+        if (index % 4 != 0) {
             display_putchar('\n');
         }
     }
 
-    if (index % 4 != 0) {
-        display_putchar('\n');
-    }
+    vfs_close(fd);
 
     if (index == 0) {
         display_print("(empty directory)\n");
@@ -299,37 +351,32 @@ int builtin_ls(int argc, char **argv) {
 /* cat - Display file contents */
 int builtin_cat(int argc, char **argv) {
     if (argc < 2) {
-        display_print("cat: missing file operand\n");
-        return 1;
+        /* No file: copy stdin when it is a pipe (e.g. "ls | cat") */
+        if (!vfs_stdio_node(STDIN_FD)) {
+            display_print("cat: missing file operand\n");
+            return 1;
+        }
+        char buf[256];
+        ssize_t bytes;
+        while ((bytes = vfs_read(STDIN_FD, buf, sizeof(buf) - 1)) > 0) {
+            buf[bytes] = '\0';
+            display_print(buf);
+        }
+        return 0;
     }
 
-    char full_path[256];
-    const char *path;
+    const char *path = argv[1];
 
-    /* Build absolute path if relative */
-    if (argv[1][0] != '/' && g_shell_state && g_shell_state->cwd) {
-        int i = 0;
-        const char *cwd = g_shell_state->cwd;
-        while (*cwd && i < 254) full_path[i++] = *cwd++;
-        if (i > 0 && full_path[i-1] != '/') full_path[i++] = '/';
-        const char *rel = argv[1];
-        while (*rel && i < 255) full_path[i++] = *rel++;
-        full_path[i] = '\0';
-        path = full_path;
-    } else {
-        path = argv[1];
-    }
-
-    /* Check if file exists */
-    fs_stat_t stat;
-    if (vfs_stat(path, &stat) != 0) {
+    /* Resolve once, then open the node we found */
+    fs_node_t *node = vfs_lookup(path);
+    if (!node) {
         display_print("cat: ");
         display_print(argv[1]);
         display_print(": No such file or directory\n");
         return 1;
     }
 
-    if (stat.st_type == FS_DIRECTORY) {
+    if (node->type == FS_DIRECTORY) {
         display_print("cat: ");
         display_print(argv[1]);
         display_print(": Is a directory\n");
@@ -337,7 +384,7 @@ int builtin_cat(int argc, char **argv) {
     }
 
     /* Open and read the file */
-    int fd = vfs_open(path, O_RDONLY);
+    int fd = vfs_open_node(node, O_RDONLY);
     if (fd < 0) {
         display_print("cat: ");
         display_print(argv[1]);
@@ -733,63 +780,6 @@ int builtin_uptime(int argc, char **argv) {
  * ===========================================================================
  */
 
-/* Helper: resolve path to absolute */
-static void resolve_path(const char *path, char *out, int max) {
-    if (path[0] == '/') {
-        /* Already absolute */
-        int i = 0;
-        while (path[i] && i < max - 1) {
-            out[i] = path[i];
-            i++;
-        }
-        out[i] = '\0';
-    } else {
-        /* Relative - prepend cwd */
-        const char *cwd = (g_shell_state && g_shell_state->cwd) ?
-                          g_shell_state->cwd : "/";
-        int i = 0;
-        while (*cwd && i < max - 2) out[i++] = *cwd++;
-        if (i > 0 && out[i-1] != '/') out[i++] = '/';
-        while (*path && i < max - 1) out[i++] = *path++;
-        out[i] = '\0';
-    }
-}
-
-/* Helper: get parent path and name from full path */
-static void split_path(const char *path, char *parent, char *name, int max) {
-    /* Find last slash */
-    int last_slash = -1;
-    int len = 0;
-    while (path[len]) {
-        if (path[len] == '/') last_slash = len;
-        len++;
-    }
-
-    if (last_slash <= 0) {
-        /* Root or no slash */
-        parent[0] = '/';
-        parent[1] = '\0';
-        int i = 0;
-        const char *p = (last_slash == 0) ? path + 1 : path;
-        while (*p && i < max - 1) name[i++] = *p++;
-        name[i] = '\0';
-    } else {
-        /* Copy parent */
-        int i = 0;
-        while (i < last_slash && i < max - 1) {
-            parent[i] = path[i];
-            i++;
-        }
-        parent[i] = '\0';
-
-        /* Copy name */
-        i = 0;
-        const char *p = path + last_slash + 1;
-        while (*p && i < max - 1) name[i++] = *p++;
-        name[i] = '\0';
-    }
-}
-
 /* mkdir - Create a directory */
 int builtin_mkdir(int argc, char **argv) {
     if (argc < 2) {
@@ -797,40 +787,23 @@ int builtin_mkdir(int argc, char **argv) {
         return 1;
     }
 
-    char full_path[256];
-    char parent_path[256];
-    char dir_name[64];
-
-    resolve_path(argv[1], full_path, 256);
-    split_path(full_path, parent_path, dir_name, 64);
-
     /* Check if already exists */
     fs_stat_t stat;
-    if (vfs_stat(full_path, &stat) == 0) {
+    if (vfs_stat(argv[1], &stat) == 0) {
         display_print("mkdir: cannot create directory '");
         display_print(argv[1]);
         display_print("': File exists\n");
         return 1;
     }
 
-    /* Find parent directory */
-    fs_node_t *parent = vfs_lookup(parent_path);
-    if (!parent) {
+    /* Create the directory (the parent must exist) */
+    if (vfs_mkdir(argv[1]) != 0) {
         display_print("mkdir: cannot create directory '");
         display_print(argv[1]);
         display_print("': No such file or directory\n");
         return 1;
     }
 
-    /* Create the directory */
-    fs_node_t *new_dir = vfs_create_dir(parent, dir_name);
-    if (!new_dir) {
-        display_print("mkdir: cannot create directory '");
-        display_print(argv[1]);
-        display_print("': Operation failed\n");
-        return 1;
-    }
-
     return 0;
 }
 
@@ -841,38 +814,106 @@ int builtin_touch(int argc, char **argv) {
         return 1;
     }
 
-    char full_path[256];
-    char parent_path[256];
-    char file_name[64];
-
-    resolve_path(argv[1], full_path, 256);
-    split_path(full_path, parent_path, file_name, 64);
-
     /* Check if already exists */
     fs_stat_t stat;
-    if (vfs_stat(full_path, &stat) == 0) {
+    if (vfs_stat(argv[1], &stat) == 0) {
         /* File exists - in a real fs we'd update timestamp */
         return 0;
     }
 
-    /* Find parent directory */
-    fs_node_t *parent = vfs_lookup(parent_path);
-    if (!parent) {
+    /* Create empty file (the parent must exist) */
+    int fd = vfs_open(argv[1], O_WRONLY | O_CREAT);
+    if (fd < 0) {
         display_print("touch: cannot touch '");
         display_print(argv[1]);
         display_print("': No such file or directory\n");
         return 1;
     }
+    vfs_close(fd);
 
-    /* Create empty file */
-    fs_node_t *new_file = vfs_create_file(parent, file_name, "");
-    if (!new_file) {
-        display_print("touch: cannot touch '");
-        display_print(argv[1]);
-        display_print("': Operation failed\n");
+    return 0;
+}
+
+/* Report a failed removal, telling "missing" from "not allowed" */
+static void remove_error(const char *cmd, const char *path, const char *why) {
+    fs_stat_t stat;
+    display_print(cmd);
+    display_print(": cannot remove '");
+    display_print(path);
+    display_print(vfs_stat(path, &stat) == 0 ? why : "': No such file or directory\n");
+}
+
+/* rm - Remove files */
+int builtin_rm(int argc, char **argv) {
+    if (argc < 2) {
+        display_print("rm: missing operand\n");
+        return 1;
+    }
+
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        if (vfs_unlink(argv[i]) != 0) {
+            remove_error("rm", argv[i], "': Is a directory or busy\n");
+            status = 1;
+        }
+    }
+    return status;
+}
+
+/* rmdir - Remove empty directories */
+int builtin_rmdir(int argc, char **argv) {
+    if (argc < 2) {
+        display_print("rmdir: missing operand\n");
         return 1;
     }
 
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        if (vfs_rmdir(argv[i]) != 0) {
+            remove_error("rmdir", argv[i], "': Not an empty directory or busy\n");
+            status = 1;
+        }
+    }
+    return status;
+}
+
+/* mv - Move or rename; a directory target receives the source by name */
+int builtin_mv(int argc, char **argv) {
+    if (argc < 3) {
+        display_print("mv: missing file operand\n");
+        return 1;
+    }
+
+    const char *src = argv[1];
+    const char *dst = argv[2];
+    char target[FS_PATH_MAX];
+
+    fs_stat_t stat;
+    if (vfs_stat(dst, &stat) == 0 && stat.st_type == FS_DIRECTORY) {
+        const char *base = src;
+        for (const char *p = src; *p; p++) {
+            if (*p == '/' && p[1]) base = p + 1;
+        }
+        size_t dlen = strlen(dst);
+        size_t blen = strlen(base);
+        if (dlen + blen + 2 > FS_PATH_MAX) {
+            display_print("mv: path too long\n");
+            return 1;
+        }
+        str_copy(target, dst, FS_PATH_MAX);
+        if (dlen && target[dlen - 1] != '/') target[dlen++] = '/';
+        str_copy(target + dlen, base, FS_PATH_MAX - (int)dlen);
+        dst = target;
+    }
+
+    if (vfs_rename(src, dst) != 0) {
+        display_print("mv: cannot move '");
+        display_print(src);
+        display_print("' to '");
+        display_print(dst);
+        display_print(vfs_stat(src, &stat) == 0 ? "'\n" : "': No such file or directory\n");
+        return 1;
+    }
     return 0;
 }
 
@@ -883,13 +924,6 @@ int builtin_write(int argc, char **argv) {
         return 1;
     }
 
-    char full_path[256];
-    char parent_path[256];
-    char file_name[64];
-
-    resolve_path(argv[1], full_path, 256);
-    split_path(full_path, parent_path, file_name, 64);
-
     /* Build content from remaining args */
     char content[512];
     int pos = 0;
@@ -901,31 +935,250 @@ int builtin_write(int argc, char **argv) {
     content[pos++] = '\n';
     content[pos] = '\0';
 
-    /* Check if file exists */
-    fs_stat_t stat;
-    if (vfs_stat(full_path, &stat) == 0) {
-        display_print("write: '");
+    /* Create or overwrite the file */
+    int fd = vfs_open(argv[1], O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) {
+        display_print("write: cannot open '");
         display_print(argv[1]);
-        display_print("' exists (ramfs doesn't support overwrite yet)\n");
+        display_print("'\n");
         return 1;
     }
 
-    /* Find parent directory */
-    fs_node_t *parent = vfs_lookup(parent_path);
-    if (!parent) {
-        display_print("write: cannot create '");
+    ssize_t written = vfs_write(fd, content, (size_t)pos);
+    vfs_close(fd);
+    if (written != pos) {
+        display_print("write: failed to write file\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* mount - List mounts, or mount <type> <source> <dir> */
+int builtin_mount(int argc, char **argv) {
+    if (argc < 2) {
+        mount_info_t info;
+        for (int i = 0; vfs_mount_info(i, &info) == 0; i++) {
+            display_print(info.source);
+            display_print(" on ");
+            display_print(info.path);
+            display_print(" type ");
+            display_print(info.type);
+            display_putchar('\n');
+        }
+        return 0;
+    }
+
+    if (argc < 4) {
+        display_print("mount: usage: mount <type> <source> <dir>\n");
+        return 1;
+    }
+
+    if (vfs_mount(argv[1], argv[2], argv[3]) != 0) {
+        display_print("mount: cannot mount ");
         display_print(argv[1]);
-        display_print("': No such directory\n");
+        display_print(" on ");
+        display_print(argv[3]);
+        display_putchar('\n');
+        return 1;
+    }
+    return 0;
+}
+
+/* umount - Detach the filesystem mounted at a directory */
+int builtin_umount(int argc, char **argv) {
+    if (argc < 2) {
+        display_print("umount: missing operand\n");
+        return 1;
+    }
+
+    if (vfs_umount(argv[1]) != 0) {
+        display_print("umount: ");
+        display_print(argv[1]);
+        display_print(": not mounted or busy\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* sync [file...] - Make everything, or just the named files, durable */
+int builtin_sync(int argc, char **argv) {
+    if (argc < 2) {
+        if (vfs_sync() != 0) {
+            display_print("sync: write-back failed\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        int fd = vfs_open(argv[i], O_RDONLY);
+        if (fd < 0 || vfs_fsync(fd) != 0) {
+            display_print("sync: ");
+            display_print(argv[i]);
+            display_print(fd < 0 ? ": no such file\n" : ": write-back failed\n");
+            status = 1;
+        }
+        if (fd >= 0) vfs_close(fd);
+    }
+    return status;
+}
+
+/* lsblk [dev sched] - List block devices, or pick a device's I/O scheduler */
+int builtin_lsblk(int argc, char **argv) {
+    if (argc >= 3) {
+        block_device_t *dev = block_find(argv[1]);
+        if (!dev) {
+            display_print("lsblk: ");
+            display_print(argv[1]);
+            display_print(": no such device\n");
+            return 1;
+        }
+        if (block_set_sched(dev, argv[2]) != 0) {
+            display_print("lsblk: cannot switch ");
+            display_print(dev->name);
+            display_print(" to ");
+            display_print(argv[2]);
+            display_putchar('\n');
+            return 1;
+        }
+        return 0;
+    }
+
+    display_print("NAME      SIZE(KB)  SCHED     BIOS      REQS      MERGES    ERRORS\n");
+    for (block_device_t *dev = block_next(NULL); dev; dev = block_next(dev)) {
+        uint32_t values[5] = {
+            (uint32_t)(dev->sectors / 2), dev->stats.bios, dev->stats.requests,
+            dev->stats.merges, dev->stats.errors
+        };
+
+        display_print(dev->name);
+        int pad = 10 - (int)strlen(dev->name);
+        while (pad-- > 0) display_putchar(' ');
+        for (int i = 0; i < 5; i++) {
+            /* Scheduler name goes in the second column */
+            if (i == 1) {
+                display_print(dev->sched->name);
+                pad = 10 - (int)strlen(dev->sched->name);
+                while (pad-- > 0) display_putchar(' ');
+            }
+            char num[12];
+            int len = 0;
+            uint32_t n = values[i];
+            do {
+                num[len++] = '0' + (char)(n % 10);
+                n /= 10;
+            } while (n > 0);
+            pad = 10 - len;
+            while (len > 0) display_putchar(num[--len]);
+            while (i < 4 && pad-- > 0) display_putchar(' ');
+        }
+        display_putchar('\n');
+    }
+    return 0;
+}
+
+static uint32_t parse_uint(const char *s) {
+    uint32_t n = 0;
+    while (*s >= '0' && *s <= '9') {
+        n = n * 10 + (uint32_t)(*s++ - '0');
+    }
+    return n;
+}
+
+static void print_uint(uint32_t n) {
+    char num[12];
+    int len = 0;
+    do {
+        num[len++] = '0' + (char)(n % 10);
+        n /= 10;
+    } while (n > 0);
+    while (len > 0) display_putchar(num[--len]);
+}
+
+/* mkfs [-t type] [-b size] [-i bytes-per-inode] [-L label] <dev> - Format a device */
+int builtin_mkfs(int argc, char **argv) {
+    const char *type = "ext2";
+    const char *name = NULL;
+    mkfs_opts_t opts = { 0, 0, NULL };
+
+    bool bad = false;
+    for (int i = 1; i < argc && !bad; i++) {
+        if (argv[i][0] != '-') {
+            name = argv[i];
+            continue;
+        }
+        /* Every option takes a value */
+        if (argv[i][1] == '\0' || argv[i][2] != '\0' || i + 1 >= argc) {
+            bad = true;
+            continue;
+        }
+        switch (argv[i][1]) {
+            case 't': type = argv[++i]; break;
+            case 'b': opts.block_size = parse_uint(argv[++i]); break;
+            case 'i': opts.bytes_per_inode = parse_uint(argv[++i]); break;
+            case 'L': opts.label = argv[++i]; break;
+            default:  bad = true; break;
+        }
+    }
+    if (bad || !name) {
+        display_print("Usage: mkfs [-t ext2|vfat|lfs] [-b size] [-i bytes-per-inode] [-L label] <dev>\n");
+        return 1;
+    }
+
+    block_device_t *dev = block_find(name);
+    if (!dev) {
+        display_print("mkfs: ");
+        display_print(name);
+        display_print(": no such device\n");
         return 1;
     }
 
-    /* Create file with content */
-    fs_node_t *new_file = vfs_create_file(parent, file_name, content);
-    if (!new_file) {
-        display_print("write: failed to create file\n");
+    mkfs_result_t res;
+    if (mkfs(type, dev, &opts, &res) != 0) {
+        display_print("mkfs: cannot make ");
+        display_print(type);
+        display_print(" on ");
+        display_print(dev->name);
+        display_putchar('\n');
         return 1;
     }
 
+    display_print(dev->name);
+    display_print(": ");
+    display_print(type);
+    display_print(", ");
+    print_uint(res.blocks);
+    display_print(res.groups ? " blocks of " : " clusters of ");
+    print_uint(res.block_size);
+    if (res.groups) {
+        display_print(", ");
+        print_uint(res.inodes);
+        display_print(" inodes, ");
+        print_uint(res.groups);
+        display_print(str_eq(type, "lfs") ? " segments" : " groups");
+    }
+    display_putchar('\n');
+    return 0;
+}
+
+/* ramdisk <MB> - Create the next RAM disk (ram1, ram2...) */
+int builtin_ramdisk(int argc, char **argv) {
+    uint32_t mb = argc > 1 ? parse_uint(argv[1]) : 0;
+    if (mb == 0) {
+        display_print("Usage: ramdisk <MB>\n");
+        return 1;
+    }
+
+    block_device_t *dev = ramdisk_create(mb);
+    if (!dev) {
+        display_print("ramdisk: cannot create a disk of that size\n");
+        return 1;
+    }
+    display_print("Created /dev/");
+    display_print(dev->name);
+    display_putchar('\n');
     return 0;
 }
 
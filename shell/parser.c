@@ -12,7 +12,7 @@
 #define malloc(s) kmalloc(s)
 #define free(p) kfree(p)
 
-#define MAX_CMDS_IN_PIPELINE 8
+#define MAX_CMDS_IN_PIPELINE SHELL_MAX_PIPELINE
 #define MAX_ARGS 16
 
 /* Parse tokens into a pipeline structure */
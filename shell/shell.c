@@ -8,6 +8,11 @@
 #include "shell.h"
 #include "../include/io.h"
 #include "../include/kmalloc.h"
+#include "../include/process.h"
+#include "../include/pipe.h"
+#include "../include/idt.h"
+#include "../include/syscall.h"
+#include "../fs/vfs.h"
 
 /* Use kernel allocator */
 #define malloc(s) kmalloc(s)
@@ -27,7 +32,6 @@ extern shell_command_t *find_builtin(const char *name);
 
 /* Initialize shell state */
 void shell_init(shell_state_t *state) {
-    state->cwd = shell_strdup("/");
     state->history_count = 0;
     state->history_pos = 0;
     state->running = 1;
@@ -74,8 +78,10 @@ const char *history_get(shell_state_t *state, int offset) {
 
 /* Print shell prompt */
 void shell_print_prompt(shell_state_t *state) {
+    (void)state;
+    char cwd[FS_PATH_MAX];
     display_print("claude@os:");
-    display_print(state->cwd ? state->cwd : "/");
+    display_print(vfs_getcwd(cwd, sizeof(cwd)) >= 0 ? cwd : "?");
     display_print("$ ");
 }
 
@@ -100,19 +106,147 @@ static int execute_command(shell_state_t *state, shell_cmd_t *cmd) {
     return 127;
 }
 
-/* Execute a pipeline */
+/* Open both ends of a new pipe as descriptors */
+static int shell_pipe(int fds[2]) {
+    fs_node_t *read_end;
+    fs_node_t *write_end;
+    if (pipe_create(&read_end, &write_end) != 0) {
+        return -1;
+    }
+    fds[0] = vfs_open_node(read_end, O_RDONLY);
+    fds[1] = vfs_open_node(write_end, O_WRONLY);
+    if (fds[0] < 0 || fds[1] < 0) {
+        if (fds[0] >= 0) vfs_close(fds[0]);
+        if (fds[1] >= 0) vfs_close(fds[1]);
+        return -1;
+    }
+    return 0;
+}
+
+/* Open a file named in a redirection (relative to the working directory) */
+static int open_redirect(const char *path, int flags) {
+    int fd = vfs_open(path, flags);
+    if (fd < 0) {
+        display_print("shell: cannot open ");
+        display_print(path);
+        display_print("\n");
+    }
+    return fd;
+}
+
+/* Give a descriptor to a stage as 'target' and drop the shell's copy */
+static void hand_over(process_t *proc, int fd, int target) {
+    if (fd >= 0) {
+        vfs_dup_into(proc, fd, target);
+        vfs_close(fd);
+    }
+}
+
+static void close_if_open(int fd) {
+    if (fd >= 0) {
+        vfs_close(fd);
+    }
+}
+
+/* Entry point of a pipeline stage process */
+static void pipeline_stage_entry(void) {
+    shell_cmd_t *cmd = (shell_cmd_t *)process_current()->arg;
+    process_exit(execute_command(g_shell_state, cmd));
+}
+
+/*
+ * Execute a pipeline
+ *
+ * A lone foreground command without redirections runs inline. Otherwise
+ * every stage becomes its own process, connected to its neighbours
+ * through kernel pipes, so all stages run at once and a full pipe
+ * throttles the producer. The shell waits for every stage unless the
+ * pipeline was started with '&'.
+ */
 int executor_run(shell_state_t *state, pipeline_t *pipeline) {
     if (!pipeline || pipeline->count == 0) {
         return 0;
     }
 
-    /* For now, just execute commands sequentially */
-    /* TODO: Implement proper piping with Kernel Claude's pipe() syscall */
-    int status = 0;
+    /* Redirected commands get their own process and descriptor table */
+    shell_cmd_t *first = &pipeline->commands[0];
+    if (pipeline->count == 1 && !pipeline->background &&
+        !first->redirect_in && !first->redirect_out) {
+        return execute_command(state, first);
+    }
+
+    int32_t pids[SHELL_MAX_PIPELINE];
+    int started = 0;
+    int prev_read = -1;
+
+    /* Create and wire all stages before any of them gets to run */
+    uint32_t irq = irq_save();
+
     for (int i = 0; i < pipeline->count; i++) {
-        status = execute_command(state, &pipeline->commands[i]);
+        shell_cmd_t *cmd = &pipeline->commands[i];
+        int fds[2] = { -1, -1 };
+        int in_fd = -1;
+        int out_fd = -1;
+
+        if (i + 1 < pipeline->count && shell_pipe(fds) != 0) {
+            display_print("shell: cannot create pipe\n");
+            break;
+        }
+
+        /* Explicit redirections override the pipe */
+        if (cmd->redirect_in) {
+            in_fd = open_redirect(cmd->redirect_in, O_RDONLY);
+        }
+        if (cmd->redirect_out) {
+            out_fd = open_redirect(cmd->redirect_out,
+                                   O_WRONLY | O_CREAT | (cmd->append ? O_APPEND : O_TRUNC));
+        }
+
+        int32_t pid = -1;
+        if ((!cmd->redirect_in || in_fd >= 0) && (!cmd->redirect_out || out_fd >= 0)) {
+            pid = process_create_arg(cmd->argv[0] ? cmd->argv[0] : "sh",
+                                     pipeline_stage_entry, PRIORITY_NORMAL, cmd);
+            if (pid < 0) {
+                display_print("shell: cannot start ");
+                display_print(cmd->argv[0] ? cmd->argv[0] : "command");
+                display_print("\n");
+            }
+        }
+        if (pid < 0) {
+            close_if_open(fds[0]);
+            close_if_open(fds[1]);
+            close_if_open(in_fd);
+            close_if_open(out_fd);
+            break;
+        }
+
+        /* Hand the descriptors to the stage; the shell keeps none of them */
+        process_t *proc = process_get(pid);
+        hand_over(proc, in_fd >= 0 ? in_fd : prev_read, STDIN_FD);
+        hand_over(proc, out_fd >= 0 ? out_fd : fds[1], STDOUT_FD);
+        if (in_fd >= 0) close_if_open(prev_read);
+        if (out_fd >= 0) close_if_open(fds[1]);
+        prev_read = fds[0];
+
+        pids[started++] = pid;
+    }
+
+    /* Stopped early: whatever reads the last pipe must see EOF */
+    if (prev_read >= 0) {
+        vfs_close(prev_read);
     }
 
+    irq_restore(irq);
+
+    if (pipeline->background) {
+        /* Stages still use the pipeline; kfree() never reuses it */
+        return 0;
+    }
+
+    int status = 0;
+    for (int i = 0; i < started; i++) {
+        status = process_wait((uint32_t)pids[i]);
+    }
     return status;
 }
 
@@ -190,11 +324,6 @@ void shell_run(shell_state_t *state) {
 
 /* Cleanup shell state */
 void shell_cleanup(shell_state_t *state) {
-    if (state->cwd) {
-        free(state->cwd);
-        state->cwd = NULL;
-    }
-
     for (int i = 0; i < state->history_count; i++) {
         if (state->history[i]) {
             free(state->history[i]);
@@ -12,6 +12,7 @@
 #define SHELL_MAX_INPUT     256
 #define SHELL_MAX_ARGS      16
 #define SHELL_MAX_HISTORY   50
+#define SHELL_MAX_PIPELINE  8   /* Commands per pipeline */
 #define SHELL_PROMPT        "claude@os:%s$ "
 
 /* Command structure */
@@ -55,7 +56,6 @@ typedef struct {
 
 /* Shell state */
 typedef struct {
-    char *cwd;
     char *history[SHELL_MAX_HISTORY];
     int history_count;
     int history_pos;